@@ -37,6 +37,7 @@
 
 #include "gbinder_bridge.h"
 #include "gbinder_buffer.h"
+#include "gbinder_capture.h"
 #include "gbinder_client.h"
 #include "gbinder_fmq.h"
 #include "gbinder_local_object.h"
@@ -48,6 +49,7 @@
 #include "gbinder_remote_request.h"
 #include "gbinder_servicename.h"
 #include "gbinder_servicemanager.h"
+#include "gbinder_stats.h"
 #include "gbinder_writer.h"
 
 #endif /* GBINDER_H */
@@ -76,6 +76,11 @@ void
 gbinder_bridge_free(
     GBinderBridge* bridge); /* Since 1.1.5 */
 
+void
+gbinder_bridge_set_looper_dispatch(
+    GBinderBridge* bridge,
+    gboolean enable); /* Since 1.1.25 */
+
 G_END_DECLS
 
 #endif /* GBINDER_BRIDGE_H */
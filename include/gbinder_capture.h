@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GBINDER_CAPTURE_H
+#define GBINDER_CAPTURE_H
+
+#include "gbinder_types.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Binary capture of the transactions passing through this process,
+ * suitable for replaying (see test/binder-replay). Capture is off by
+ * default and costs a single atomic read per transaction until it's
+ * started. Only one capture can be active at a time.
+ *
+ * The capture starts with GBINDER_CAPTURE_MAGIC followed by records,
+ * each one consisting of GBinderCaptureRecord, the transaction data
+ * and the object offsets (guint32 each), both padded to 8 bytes. All
+ * numbers are in the native byte order. Objects are sanitized, i.e.
+ * everything except the type and flags (the first 8 bytes) is zeroed,
+ * so that no pointers, handles or file descriptors end up in the
+ * capture. Memory referenced by buffer objects isn't captured.
+ *
+ * Since 1.1.25
+ */
+
+#define GBINDER_CAPTURE_MAGIC "GBCAP\0\0\1"
+#define GBINDER_CAPTURE_MAGIC_SIZE (8)
+
+typedef enum gbinder_capture_dir {
+    GBINDER_CAPTURE_OUTGOING,   /* Sent by this process, handle is valid */
+    GBINDER_CAPTURE_INCOMING    /* Received by local objects */
+} GBINDER_CAPTURE_DIR;
+
+typedef struct gbinder_capture_record {
+    guint32 size;               /* The whole record, including padding */
+    guint8 dir;                 /* GBINDER_CAPTURE_DIR */
+    guint8 pointer_size;        /* Of the binder protocol, 4 or 8 */
+    guint16 reserved1;
+    guint64 usec;               /* Monotonic time */
+    guint32 handle;
+    guint32 code;
+    guint32 flags;              /* GBINDER_TX_FLAG_xxx */
+    guint32 data_size;
+    guint32 offsets_count;
+    guint32 reserved2;
+} GBinderCaptureRecord;
+
+/* Streams the capture to a file, which gets truncated */
+gboolean
+gbinder_capture_start_file(
+    const char* path);
+
+/* Keeps the most recent records in memory, up to max_bytes */
+gboolean
+gbinder_capture_start_ring(
+    gsize max_bytes);
+
+gboolean
+gbinder_capture_active(
+    void);
+
+/* Returns the ring buffer contents (including the magic) or NULL */
+GBytes*
+gbinder_capture_stop(
+    void)
+    G_GNUC_WARN_UNUSED_RESULT;
+
+G_END_DECLS
+
+#endif /* GBINDER_CAPTURE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
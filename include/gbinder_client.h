@@ -50,6 +50,30 @@ void
     int status,
     void* user_data);
 
+/* Since 1.1.25 */
+typedef struct gbinder_client_batch_tx {
+    guint32 code;
+    guint32 flags; /* GBINDER_TX_FLAG_ONEWAY or zero */
+    GBinderLocalRequest* req; /* NULL for an empty request */
+} GBinderClientBatchTx;
+
+typedef
+void
+(*GBinderClientBatchReplyFunc)(
+    GBinderClient* client,
+    GBinderRemoteReply* const* replies,
+    const int* status,
+    guint count,
+    void* user_data); /* Since 1.1.25 */
+
+typedef
+void
+(*GBinderClientBroadcastFunc)(
+    GBinderClient* const* clients,
+    const int* status,
+    guint count,
+    void* user_data); /* Since 1.1.25 */
+
 GBinderClient*
 gbinder_client_new(
     GBinderRemoteObject* object,
@@ -92,6 +116,34 @@ gbinder_client_new_request2(
     GBinderClient* client,
     guint32 code); /* since 1.0.42 */
 
+GBinderLocalRequest*
+gbinder_client_new_request3(
+    GBinderClient* client,
+    guint32 code,
+    gsize size_hint); /* since 1.1.25 */
+
+void
+gbinder_client_set_adaptive_size(
+    GBinderClient* client,
+    gboolean enable); /* since 1.1.25 */
+
+void
+gbinder_client_set_max_pending(
+    GBinderClient* client,
+    guint max_in_flight,
+    guint max_queued); /* since 1.1.25 */
+
+void
+gbinder_client_set_coalesce_oneway(
+    GBinderClient* client,
+    guint32 code,
+    gboolean enable); /* since 1.1.25 */
+
+void
+gbinder_client_set_timeout(
+    GBinderClient* client,
+    guint timeout_ms); /* since 1.1.25 */
+
 GBinderRemoteReply*
 gbinder_client_transact_sync_reply(
     GBinderClient* client,
@@ -115,6 +167,89 @@ gbinder_client_transact(
     GDestroyNotify destroy,
     void* user_data);
 
+gulong
+gbinder_client_transact_with_timeout(
+    GBinderClient* client,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    guint timeout_ms,
+    GBinderClientReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data); /* since 1.1.25 */
+
+gboolean
+gbinder_client_open_fmq_channel(
+    GBinderClient* client,
+    guint32 code,
+    gsize size); /* since 1.1.25 */
+
+int
+gbinder_client_transact_fmq_oneway(
+    GBinderClient* client,
+    guint32 code,
+    GBinderLocalRequest* req); /* since 1.1.25 */
+
+void
+gbinder_client_set_chunking(
+    GBinderClient* client,
+    guint32 code,
+    gsize chunk_size); /* since 1.1.25 */
+
+/* Lane of the calls which don't specify one in their flags */
+void
+gbinder_client_set_lane(
+    GBinderClient* client,
+    guint32 flags); /* since 1.1.25 */
+
+/* Executes gbinder_client_transact() calls one by one, in order */
+void
+gbinder_client_set_ordered(
+    GBinderClient* client,
+    gboolean enable); /* since 1.1.25 */
+
+void
+gbinder_client_set_single_flight(
+    GBinderClient* client,
+    guint32 code,
+    gboolean enable); /* since 1.1.25 */
+
+void
+gbinder_client_set_reply_cache(
+    GBinderClient* client,
+    guint32 code,
+    guint ttl_ms); /* since 1.1.25 */
+
+void
+gbinder_client_invalidate_cache(
+    GBinderClient* client); /* since 1.1.25 */
+
+GBinderRemoteReply*
+gbinder_client_transact_chunked(
+    GBinderClient* client,
+    guint32 code,
+    GBinderLocalRequest* req,
+    int* status); /* since 1.1.25 */
+
+gulong
+gbinder_client_transact_batch(
+    GBinderClient* client,
+    const GBinderClientBatchTx* txs,
+    guint count,
+    GBinderClientBatchReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data); /* Since 1.1.25 */
+
+gulong
+gbinder_client_broadcast(
+    GBinderClient* const* clients,
+    guint count,
+    guint32 code,
+    GBinderLocalRequest* req,
+    GBinderClientBroadcastFunc func,
+    GDestroyNotify destroy,
+    void* user_data); /* Since 1.1.25 */
+
 void
 gbinder_client_cancel(
     GBinderClient* client,
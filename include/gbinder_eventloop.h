@@ -181,6 +181,39 @@ void
 gbinder_eventloop_set(
     const GBinderEventLoopIntegration* loop);
 
+/**
+ * Built-in epoll based event loop integration (since 1.1.25), for the
+ * programs which don't run GLib main loop. Pass the value returned by
+ * gbinder_eventloop_epoll() to gbinder_eventloop_set() and then either
+ * start the dedicated dispatcher thread with gbinder_eventloop_epoll_start()
+ * or add the descriptor returned by gbinder_eventloop_epoll_fd() to your
+ * own epoll set (for EPOLLIN) and call gbinder_eventloop_epoll_dispatch()
+ * whenever it becomes readable. gbinder_eventloop_epoll_dispatch() never
+ * blocks and returns the number of handled events.
+ *
+ * The thread dispatching the events is the one where libgbinder invokes
+ * its callbacks, i.e. it becomes the main thread for libgbinder.
+ */
+const GBinderEventLoopIntegration*
+gbinder_eventloop_epoll(
+    void); /* Since 1.1.25 */
+
+int
+gbinder_eventloop_epoll_fd(
+    void); /* Since 1.1.25 */
+
+guint
+gbinder_eventloop_epoll_dispatch(
+    void); /* Since 1.1.25 */
+
+gboolean
+gbinder_eventloop_epoll_start(
+    void); /* Since 1.1.25 */
+
+void
+gbinder_eventloop_epoll_stop(
+    void); /* Since 1.1.25 */
+
 G_END_DECLS
 
 #endif /* GBINDER_EVENTLOOP_H */
@@ -45,9 +45,20 @@ typedef enum gbinder_fmq_type {
 
 typedef enum gbinder_fmq_flags {
     GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG = 0x1,
-    GBINDER_FMQ_FLAG_NO_RESET_POINTERS    = 0x2
+    GBINDER_FMQ_FLAG_NO_RESET_POINTERS    = 0x2,
+    GBINDER_FMQ_FLAG_ALIGN_COUNTERS       = 0x4, /* Since 1.1.25 */
+    GBINDER_FMQ_FLAG_PREFAULT             = 0x8, /* Since 1.1.25 */
+    GBINDER_FMQ_FLAG_HUGE_PAGES           = 0x10 /* Since 1.1.25 */
 } GBINDER_FMQ_FLAGS;
 
+/*
+ * GBINDER_FMQ_FLAG_PREFAULT populates the mappings upfront, to avoid
+ * page faults on the first touch. GBINDER_FMQ_FLAG_HUGE_PAGES backs
+ * the queue with 2MB pages if the system has them available, falling
+ * back to regular pages otherwise. It's ignored if the ring buffer
+ * memory is supplied by the caller.
+ */
+
 GBinderFmq*
 gbinder_fmq_new(
     gsize item_size,
@@ -106,6 +117,39 @@ gbinder_fmq_end_write(
     GBinderFmq* fmq,
     gsize items);
 
+/*
+ * Zero copy read/write across the ring boundary, similar to Android's
+ * MessageQueue::beginRead/beginWrite with MemTransaction. If the items
+ * wrap around the end of the ring buffer, the second region holds the
+ * rest of them, otherwise it's empty (NULL pointer and zero items).
+ * The regions returned for reading must not be written to. Still has
+ * to be finished with gbinder_fmq_end_read or gbinder_fmq_end_write
+ * with the same total number of items.
+ *
+ * Since 1.1.25
+ */
+typedef struct gbinder_fmq_mem_region {
+    void* ptr;
+    gsize items;
+} GBinderFmqMemRegion;
+
+typedef struct gbinder_fmq_mem_transaction {
+    GBinderFmqMemRegion first;
+    GBinderFmqMemRegion second;
+} GBinderFmqMemTransaction;
+
+gboolean
+gbinder_fmq_begin_read_tx(
+    GBinderFmq* fmq,
+    gsize items,
+    GBinderFmqMemTransaction* tx);
+
+gboolean
+gbinder_fmq_begin_write_tx(
+    GBinderFmq* fmq,
+    gsize items,
+    GBinderFmqMemTransaction* tx);
+
 /* Regular read/write functions (non-zero-copy) */
 gboolean
 gbinder_fmq_read(
@@ -119,6 +163,59 @@ gbinder_fmq_write(
     const void* data,
     gsize items);
 
+/*
+ * Batch read/write. Transfer as many items as are available (or fit),
+ * up to max_items, and return the number of items actually transferred.
+ * The counters are synchronized once per batch rather than per item.
+ *
+ * Since 1.1.25
+ */
+gsize
+gbinder_fmq_read_batch(
+    GBinderFmq* fmq,
+    void* data,
+    gsize max_items);
+
+gsize
+gbinder_fmq_write_batch(
+    GBinderFmq* fmq,
+    const void* data,
+    gsize max_items);
+
+/*
+ * Unsynchronized queues (GBINDER_FMQ_TYPE_UNSYNC_WRITE) can have any
+ * number of readers. Each GBinderFmq tracks its own read position, and
+ * gbinder_fmq_new_reader creates another reader of the same queue, which
+ * starts with whatever gets written next. The writer never waits for the
+ * readers.
+ *
+ * A reader which has fallen behind by more than the queue size skips
+ * everything that has been overwritten, and the number of skipped items
+ * is added to gbinder_fmq_lost_items (a running total). gbinder_fmq_read
+ * and the batch read return FALSE (zero) if the items got overwritten
+ * while being copied. After gbinder_fmq_end_read, the zero copy reader
+ * can tell the same by checking whether the number of lost items has
+ * changed.
+ *
+ * gbinder_fmq_resync skips all but the most recent max_items items (all
+ * of them if it's zero) and returns the number of items skipped. Those
+ * are not counted as lost.
+ *
+ * Since 1.1.25
+ */
+GBinderFmq*
+gbinder_fmq_new_reader(
+    GBinderFmq* fmq);
+
+guint64
+gbinder_fmq_lost_items(
+    GBinderFmq* fmq);
+
+gsize
+gbinder_fmq_resync(
+    GBinderFmq* fmq,
+    gsize max_items);
+
 /*
  * Functions for waiting and waking message queue.
  * Requires configured event flag in message queue.
@@ -141,6 +238,122 @@ gbinder_fmq_wake(
     GBinderFmq* fmq,
     guint32 bit_mask);
 
+/*
+ * Waits until any of the masks[i] bits gets set in the event flag of
+ * fmqs[i] (up to 128 queues). Returns the number of queues that have
+ * been signaled, with their (cleared) bits in states[i] and zeros for
+ * the rest, -ETIMEDOUT or another negative errno. Uses futex_waitv on
+ * Linux 5.16+, older kernels get the other queues polled every 1ms
+ * while sleeping on the first one.
+ *
+ * Since 1.1.25
+ */
+int
+gbinder_fmq_wait_any(
+    GBinderFmq* const* fmqs,
+    const guint32* masks,
+    guint32* states,
+    gsize count,
+    int timeout_ms);
+
+/*
+ * Blocking read/write, similar to Android's MessageQueue::readBlocking
+ * and writeBlocking. Both transfer all items or nothing. Items must fit in
+ * the queue.
+ *
+ * The read waits on write_notification. After a read, it wakes the writer
+ * with read_notification. The write waits on read_notification and then
+ * wakes the reader with write_notification. Zero notification bits mean
+ * don't wake or don't wait. Negative timeout means wait forever.
+ *
+ * Return 0 on success, -ETIMEDOUT if the queue didn't get enough data or
+ * space in time, or another negative errno on error.
+ * Requires configured event flag.
+ *
+ * Since 1.1.25
+ */
+#define GBINDER_FMQ_NOT_EMPTY (0x01)
+#define GBINDER_FMQ_NOT_FULL  (0x02)
+
+int
+gbinder_fmq_read_blocking(
+    GBinderFmq* fmq,
+    void* data,
+    gsize items,
+    guint32 read_notification,
+    guint32 write_notification,
+    int timeout_ms);
+
+int
+gbinder_fmq_write_blocking(
+    GBinderFmq* fmq,
+    const void* data,
+    gsize items,
+    guint32 read_notification,
+    guint32 write_notification,
+    int timeout_ms);
+
+/*
+ * Optional bounded spinning before going to sleep in the futex. While
+ * spinning, gbinder_fmq_wait_timeout() polls the event flag and returns
+ * -EAGAIN as soon as the read or write counter moves, saving a context
+ * switch when the other side is only slightly behind. Zero spin_ns
+ * (the default) disables spinning.
+ *
+ * GBINDER_FMQ_SPIN_LAZY_WAKE makes gbinder_fmq_wake() skip the syscall
+ * unless a waiter is actually sleeping. That reserves bit 31 of the event
+ * flag and is only safe if all waiters on this queue are libgbinder
+ * objects with this flag set. Set both ends before the queue is used.
+ *
+ * Since 1.1.25
+ */
+typedef enum gbinder_fmq_spin_flags {
+    GBINDER_FMQ_SPIN_NONE = 0,
+    GBINDER_FMQ_SPIN_LAZY_WAKE = 0x01
+} GBINDER_FMQ_SPIN_FLAGS;
+
+void
+gbinder_fmq_set_spin(
+    GBinderFmq* fmq,
+    guint spin_ns,
+    GBINDER_FMQ_SPIN_FLAGS flags);
+
+/*
+ * Invokes the callback on the libgbinder event loop when any of the
+ * bits in bit_mask gets set in the event flag. The bits are cleared,
+ * just like gbinder_fmq_wait() does, and passed to the callback as
+ * state. Bits set while the callback is pending are merged into one
+ * invocation.
+ *
+ * All watches are serviced by a single internal thread (on older
+ * kernels without futex_waitv, one thread per watch). The watch holds
+ * a reference to the queue until it's removed. To guarantee that the
+ * callback won't get invoked after gbinder_fmq_remove_watch returns,
+ * call it on the event loop thread.
+ *
+ * Requires configured event flag.
+ *
+ * Since 1.1.25
+ */
+typedef
+void
+(*GBinderFmqWatchFunc)(
+    GBinderFmq* fmq,
+    guint32 state,
+    void* user_data);
+
+gulong
+gbinder_fmq_add_watch(
+    GBinderFmq* fmq,
+    guint32 bit_mask,
+    GBinderFmqWatchFunc func,
+    void* user_data);
+
+void
+gbinder_fmq_remove_watch(
+    GBinderFmq* fmq,
+    gulong id);
+
 G_END_DECLS
 
 #endif /* GBINDER_FMQ_H */
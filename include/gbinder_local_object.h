@@ -37,6 +37,40 @@
 
 G_BEGIN_DECLS
 
+/*
+ * Table-driven dispatch (since 1.1.25). The handler is selected by the
+ * transaction code and the interface, NULL interface stands for the
+ * first interface of the object. The user_data passed to the handler
+ * is the one given to gbinder_local_object_new(). Transactions which
+ * don't match any entry are passed to the GBinderLocalTransactFunc,
+ * or rejected without calling any user code if there isn't one.
+ *
+ * GBINDER_LOCAL_METHOD_FLAG_ONEWAY rejects two-way calls.
+ * GBINDER_LOCAL_METHOD_FLAG_LOOPER tells that the handler is thread
+ * safe and can be invoked directly on the looper thread.
+ */
+typedef struct gbinder_local_method {
+    const char* iface;
+    guint32 code;
+    guint32 flags;
+    GBinderLocalTransactFunc handler;
+} GBinderLocalMethod;
+
+#define GBINDER_LOCAL_METHOD_FLAG_ONEWAY (0x01)
+#define GBINDER_LOCAL_METHOD_FLAG_LOOPER (0x02)
+
+/*
+ * Priority classes for main thread dispatch (since 1.1.25). When several
+ * incoming transactions are waiting to be handled on the main thread,
+ * the ones with higher priority are handled first. Transactions of the
+ * same priority are handled in the order of arrival.
+ */
+typedef enum gbinder_local_priority {
+    GBINDER_LOCAL_PRIORITY_LOW,
+    GBINDER_LOCAL_PRIORITY_NORMAL,
+    GBINDER_LOCAL_PRIORITY_HIGH
+} GBINDER_LOCAL_PRIORITY;
+
 GBinderLocalObject*
 gbinder_local_object_new(
     GBinderIpc* ipc,
@@ -45,6 +79,22 @@ gbinder_local_object_new(
     void* user_data) /* Since 1.0.30 */
     G_GNUC_WARN_UNUSED_RESULT;
 
+/*
+ * Callback objects (since 1.1.25) are meant for listeners which are
+ * passed to other processes. Such an object is kept alive by the kernel
+ * references, the caller may drop its own reference as soon as it has
+ * been written to a parcel. Once the kernel releases the last reference,
+ * the handler is cleared and the object goes away. The one which never
+ * gets sent anywhere has to be released with gbinder_local_object_drop().
+ */
+GBinderLocalObject*
+gbinder_local_object_new_callback(
+    GBinderIpc* ipc,
+    const char* iface,
+    GBinderLocalTransactFunc handler,
+    void* user_data) /* Since 1.1.25 */
+    G_GNUC_WARN_UNUSED_RESULT;
+
 GBinderLocalObject*
 gbinder_local_object_ref(
     GBinderLocalObject* obj);
@@ -61,6 +111,69 @@ GBinderLocalReply*
 gbinder_local_object_new_reply(
     GBinderLocalObject* obj);
 
+GBinderLocalReply*
+gbinder_local_object_new_reply2(
+    GBinderLocalObject* obj,
+    gsize size_hint); /* Since 1.1.25 */
+
+void
+gbinder_local_object_set_looper_dispatch(
+    GBinderLocalObject* obj,
+    gboolean enable); /* Since 1.1.25 */
+
+void
+gbinder_local_object_set_serial_dispatch(
+    GBinderLocalObject* obj,
+    gboolean enable); /* Since 1.1.25 */
+
+void
+gbinder_local_object_accept_fmq_channel(
+    GBinderLocalObject* obj,
+    guint32 code); /* Since 1.1.25 */
+
+void
+gbinder_local_object_accept_chunked(
+    GBinderLocalObject* obj,
+    guint32 code,
+    gsize max_size); /* Since 1.1.25 */
+
+gboolean
+gbinder_local_object_add_methods(
+    GBinderLocalObject* obj,
+    const GBinderLocalMethod* methods,
+    gsize count); /* Since 1.1.25 */
+
+void
+gbinder_local_object_set_priority(
+    GBinderLocalObject* obj,
+    GBINDER_LOCAL_PRIORITY priority); /* Since 1.1.25 */
+
+void
+gbinder_local_object_set_code_priority(
+    GBinderLocalObject* obj,
+    guint32 code,
+    GBINDER_LOCAL_PRIORITY priority); /* Since 1.1.25 */
+
+/*
+ * Scheduling hints for the kernel (since 1.1.25), written along with
+ * the object. The minimum policy (SCHED_OTHER, SCHED_BATCH, SCHED_FIFO
+ * or SCHED_RR) and priority (nice value or realtime priority) apply to
+ * the threads handling the incoming transactions, RT inheritance lets
+ * them inherit the realtime priority of the caller. Transactions which
+ * are dispatched to the main thread carry that priority over. Both must
+ * be set before the object is written to a parcel.
+ */
+gboolean
+gbinder_local_object_set_min_sched(
+    GBinderLocalObject* obj,
+    int policy,
+    int priority); /* Since 1.1.25 */
+
+void
+gbinder_local_object_set_inherit_rt(
+    GBinderLocalObject* obj,
+    gboolean inherit); /* Since 1.1.25 */
+
 G_END_DECLS
 
 #endif /* GBINDER_LOCAL_OBJECT_H */
@@ -45,11 +45,29 @@ void
 gbinder_local_request_unref(
     GBinderLocalRequest* request);
 
+GBinderLocalRequest*
+gbinder_local_request_copy(
+    GBinderLocalRequest* request); /* Since 1.1.25 */
+
 void
 gbinder_local_request_init_writer(
     GBinderLocalRequest* request,
     GBinderWriter* writer);
 
+/*
+ * Trace id (since 1.1.25) to be sent along with the request to the
+ * devices which have TraceContext enabled. Zero means that a new id
+ * gets generated for each transaction.
+ */
+void
+gbinder_local_request_set_trace_id(
+    GBinderLocalRequest* request,
+    guint64 id); /* Since 1.1.25 */
+
+guint64
+gbinder_local_request_trace_id(
+    GBinderLocalRequest* request); /* Since 1.1.25 */
+
 void
 gbinder_local_request_cleanup(
     GBinderLocalRequest* request,
@@ -124,6 +124,17 @@ gbinder_reader_read_dup_fd(
     GBinderReader* reader) /* Since 1.0.18 */
     G_GNUC_WARN_UNUSED_RESULT;
 
+/*
+ * Same as gbinder_reader_read_dup_fd() but for the fds received from
+ * the driver it moves the ownership to the caller without dup(), the
+ * library won't close the fd when the buffer is freed. Either way, the
+ * caller has to close the returned fd.
+ */
+int
+gbinder_reader_take_fd(
+    GBinderReader* reader) /* Since 1.1.25 */
+    G_GNUC_WARN_UNUSED_RESULT;
+
 gboolean
 gbinder_reader_read_nullable_object(
     GBinderReader* reader,
@@ -147,6 +158,16 @@ gbinder_reader_read_parcelable(
     GBinderReader* reader,
     gsize* size); /* Since 1.1.19 */
 
+/*
+ * Sets up the second reader to read the contents of a non-null parcelable
+ * and moves the first one past it, skipping whatever the second reader
+ * doesn't consume (e.g. fields added by newer versions of the parcelable).
+ */
+gboolean
+gbinder_reader_read_parcelable_reader(
+    GBinderReader* reader,
+    GBinderReader* parcelable); /* Since 1.1.25 */
+
 const void*
 gbinder_reader_read_hidl_struct1(
     GBinderReader* reader,
@@ -181,6 +202,12 @@ const char*
 gbinder_reader_read_hidl_string_c(
     GBinderReader* reader); /* Since 1.0.23 */
 
+/* Points to the parcel data, the length comes from the descriptor */
+const char*
+gbinder_reader_read_hidl_string_len(
+    GBinderReader* reader,
+    gsize* len); /* Since 1.1.25 */
+
 #define gbinder_reader_skip_hidl_string(reader) \
     (gbinder_reader_read_hidl_string_c(reader) != NULL)
 
@@ -188,6 +215,35 @@ char**
 gbinder_reader_read_hidl_string_vec(
     GBinderReader* reader);
 
+/* Strings point to the parcel data, only the array needs to be g_free'd */
+const char**
+gbinder_reader_read_hidl_string_vec_c(
+    GBinderReader* reader,
+    gsize* count) /* Since 1.1.25 */
+    G_GNUC_WARN_UNUSED_RESULT;
+
+/* Validates the whole struct, the result points to the parcel data */
+const void*
+gbinder_reader_read_hidl_schema(
+    GBinderReader* reader,
+    const GBinderHidlSchema* schema); /* Since 1.1.25 */
+
+/* Read-only view of the memory, mappings are cached per GBinderIpc */
+GBytes*
+gbinder_reader_read_hidl_memory(
+    GBinderReader* reader); /* Since 1.1.25 */
+
+/*
+ * Maps the queue described by MQDescriptor (the counterpart of
+ * gbinder_writer_append_fmq_descriptor). The fds are duplicated, the
+ * queue stays usable after the parcel is gone. NULL if the descriptor
+ * is invalid. Reader of an unsynchronized queue starts with whatever
+ * gets written next.
+ */
+GBinderFmq*
+gbinder_reader_read_fmq(
+    GBinderReader* reader); /* Since 1.1.25 */
+
 gboolean
 gbinder_reader_skip_buffer(
     GBinderReader* reader);
@@ -217,6 +273,11 @@ gbinder_reader_read_string16_utf16(
     GBinderReader* reader,
     gsize* len); /* Since 1.0.26 */
 
+gboolean
+gbinder_reader_read_string16_equal(
+    GBinderReader* reader,
+    const char* utf8); /* Since 1.1.25 */
+
 gboolean
 gbinder_reader_skip_string16(
     GBinderReader* reader);
@@ -226,6 +287,48 @@ gbinder_reader_read_byte_array(
     GBinderReader* reader,
     gsize* len); /* Since 1.0.12 */
 
+/*
+ * GBytes variants of the above (since 1.1.25) keep the data alive after
+ * the parcel is gone, without copying it if possible. Small pieces and
+ * the data which would otherwise keep the binder mapping occupied while
+ * it's running short of space (see BufferEvictWatermark) are copied.
+ */
+GBytes*
+gbinder_reader_read_byte_array_bytes(
+    GBinderReader* reader); /* Since 1.1.25 */
+
+GBytes*
+gbinder_reader_read_hidl_vec_bytes(
+    GBinderReader* reader,
+    gsize* count,
+    gsize* elemsize); /* Since 1.1.25 */
+
+const gint32*
+gbinder_reader_read_int32_array(
+    GBinderReader* reader,
+    gsize* count); /* Since 1.1.25 */
+
+const gint64*
+gbinder_reader_read_int64_array(
+    GBinderReader* reader,
+    gsize* count); /* Since 1.1.25 */
+
+const gfloat*
+gbinder_reader_read_float_array(
+    GBinderReader* reader,
+    gsize* count); /* Since 1.1.25 */
+
+const gdouble*
+gbinder_reader_read_double_array(
+    GBinderReader* reader,
+    gsize* count); /* Since 1.1.25 */
+
+/* Large blobs are mapped read-only, the mapping goes with GBytes */
+GBytes*
+gbinder_reader_read_blob(
+    GBinderReader* reader,
+    gsize size); /* Since 1.1.25 */
+
 const void*
 gbinder_reader_get_data(
     const GBinderReader* reader,
@@ -244,6 +347,96 @@ gbinder_reader_copy(
     GBinderReader* dest,
     const GBinderReader* src); /* Since 1.0.16 */
 
+/*
+ * Unchecked cursor (since 1.1.25) for parsing fixed layout data.
+ * gbinder_reader_cursor_begin() checks once that the requested number
+ * of bytes is available and contains no binder objects, after that the
+ * inline accessors read primitive values one after another without any
+ * checks. The caller must not read more than it has asked for. Once
+ * done, gbinder_reader_cursor_end() moves the reader past whatever has
+ * been read through the cursor.
+ *
+ * Just like with gbinder_reader_read_uint8() and friends, values smaller
+ * than 32 bits are padded to 4 bytes.
+ */
+typedef struct gbinder_reader_cursor {
+    const guint8* ptr;
+    const guint8* end;
+} GBinderReaderCursor;
+
+gboolean
+gbinder_reader_cursor_begin(
+    GBinderReader* reader,
+    gsize size,
+    GBinderReaderCursor* cursor); /* Since 1.1.25 */
+
+gboolean
+gbinder_reader_cursor_end(
+    GBinderReader* reader,
+    const GBinderReaderCursor* cursor); /* Since 1.1.25 */
+
+static inline guint32 gbinder_reader_cursor_uint32(GBinderReaderCursor* c)
+    { const guint32 v = *(const guint32*)c->ptr; c->ptr += 4; return v; }
+static inline gint32 gbinder_reader_cursor_int32(GBinderReaderCursor* c)
+    { return (gint32)gbinder_reader_cursor_uint32(c); }
+static inline guint16 gbinder_reader_cursor_uint16(GBinderReaderCursor* c)
+    { return (guint16)gbinder_reader_cursor_uint32(c); }
+static inline gint16 gbinder_reader_cursor_int16(GBinderReaderCursor* c)
+    { return (gint16)gbinder_reader_cursor_uint32(c); }
+static inline guint8 gbinder_reader_cursor_uint8(GBinderReaderCursor* c)
+    { return (guint8)gbinder_reader_cursor_uint32(c); }
+static inline gint8 gbinder_reader_cursor_int8(GBinderReaderCursor* c)
+    { return (gint8)gbinder_reader_cursor_uint32(c); }
+static inline gboolean gbinder_reader_cursor_bool(GBinderReaderCursor* c)
+    { const gboolean v = (c->ptr[0] != 0); c->ptr += 4; return v; }
+static inline guint64 gbinder_reader_cursor_uint64(GBinderReaderCursor* c)
+    { const guint64 v = *(const guint64*)c->ptr; c->ptr += 8; return v; }
+static inline gint64 gbinder_reader_cursor_int64(GBinderReaderCursor* c)
+    { return (gint64)gbinder_reader_cursor_uint64(c); }
+static inline gfloat gbinder_reader_cursor_float(GBinderReaderCursor* c)
+    { const gfloat v = *(const gfloat*)c->ptr; c->ptr += 4; return v; }
+static inline gdouble gbinder_reader_cursor_double(GBinderReaderCursor* c)
+    { const gdouble v = *(const gdouble*)c->ptr; c->ptr += 8; return v; }
+static inline void gbinder_reader_cursor_skip(GBinderReaderCursor* c,
+    gsize size) { c->ptr += size; }
+
+/*
+ * Inline fast paths for fixed size primitive reads (since 1.1.25).
+ * They behave exactly like their out-of-line counterparts except that
+ * the value pointer must not be NULL. Only when there's not enough data
+ * they call into the library. The layout of GBinderReader they rely on
+ * (d[1] is the end of data, d[2] is the current position) is part of
+ * the ABI since 1.1.25.
+ */
+#define GBINDER_READER_INLINE_READ(reader,type,value,slow) do { \
+    const guint8* _ptr = (const guint8*)(reader)->d[2]; \
+    if (G_LIKELY((gsize)((const guint8*)(reader)->d[1] - _ptr) >= \
+        sizeof(type))) { \
+        *(value) = *(const type*)_ptr; \
+        (reader)->d[2] = _ptr + sizeof(type); \
+        return TRUE; \
+    } \
+    return slow(reader, value); } while (0)
+
+static inline gboolean gbinder_reader_read_uint32_inline(GBinderReader* r,
+    guint32* v) { GBINDER_READER_INLINE_READ(r, guint32, v,
+    gbinder_reader_read_uint32); }
+static inline gboolean gbinder_reader_read_int32_inline(GBinderReader* r,
+    gint32* v) { GBINDER_READER_INLINE_READ(r, gint32, v,
+    gbinder_reader_read_int32); }
+static inline gboolean gbinder_reader_read_uint64_inline(GBinderReader* r,
+    guint64* v) { GBINDER_READER_INLINE_READ(r, guint64, v,
+    gbinder_reader_read_uint64); }
+static inline gboolean gbinder_reader_read_int64_inline(GBinderReader* r,
+    gint64* v) { GBINDER_READER_INLINE_READ(r, gint64, v,
+    gbinder_reader_read_int64); }
+static inline gboolean gbinder_reader_read_float_inline(GBinderReader* r,
+    gfloat* v) { GBINDER_READER_INLINE_READ(r, gfloat, v,
+    gbinder_reader_read_float); }
+static inline gboolean gbinder_reader_read_double_inline(GBinderReader* r,
+    gdouble* v) { GBINDER_READER_INLINE_READ(r, gdouble, v,
+    gbinder_reader_read_double); }
+
 G_END_DECLS
 
 #endif /* GBINDER_READER_H */
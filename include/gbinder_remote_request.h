@@ -62,6 +62,11 @@ uid_t
 gbinder_remote_request_sender_euid(
     GBinderRemoteRequest* req); /* since 1.0.2 */
 
+/* Zero unless the sender has attached one (since 1.1.25) */
+guint64
+gbinder_remote_request_trace_id(
+    GBinderRemoteRequest* req); /* Since 1.1.25 */
+
 GBinderLocalRequest*
 gbinder_remote_request_copy_to_local(
     GBinderRemoteRequest* req) /* since 1.0.6 */
@@ -60,6 +60,24 @@ void
     int status,
     void* user_data);
 
+/* The objects are owned by the caller, they are NULL for missing names */
+typedef
+void
+(*GBinderServiceManagerGetServicesFunc)(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    void* user_data); /* Since 1.1.25 */
+
+/* Results are GBINDER_PING_RESULT values, one per object */
+typedef
+void
+(*GBinderServiceManagerPingFunc)(
+    GBinderServiceManager* sm,
+    const guint8* results,
+    guint count,
+    void* user_data); /* Since 1.1.25 */
+
 typedef
 void
 (*GBinderServiceManagerAddServiceFunc)(
@@ -124,6 +142,23 @@ const char*
 gbinder_servicemanager_device(
     GBinderServiceManager* sm); /* Since 1.1.14 */
 
+const char*
+gbinder_servicemanager_protocol(
+    GBinderServiceManager* sm); /* Since 1.1.25 */
+
+gsize
+gbinder_servicemanager_buffer_space(
+    GBinderServiceManager* sm); /* Since 1.1.25 */
+
+gsize
+gbinder_servicemanager_buffer_pinned(
+    GBinderServiceManager* sm); /* Since 1.1.25 */
+
+void
+gbinder_servicemanager_set_main_context(
+    GBinderServiceManager* sm,
+    GMainContext* context); /* Since 1.1.25 */
+
 gboolean
 gbinder_servicemanager_is_present(
     GBinderServiceManager* sm); /* Since 1.0.25 */
@@ -145,6 +180,20 @@ gbinder_servicemanager_list_sync(
     G_GNUC_WARN_UNUSED_RESULT
     G_GNUC_MALLOC;
 
+gulong
+gbinder_servicemanager_list_by_interface(
+    GBinderServiceManager* sm,
+    const char* iface,
+    GBinderServiceManagerListFunc func,
+    void* user_data); /* Since 1.1.25 */
+
+char**
+gbinder_servicemanager_list_by_interface_sync(
+    GBinderServiceManager* sm,
+    const char* iface) /* Since 1.1.25 */
+    G_GNUC_WARN_UNUSED_RESULT
+    G_GNUC_MALLOC;
+
 gulong
 gbinder_servicemanager_get_service(
     GBinderServiceManager* sm,
@@ -158,6 +207,30 @@ gbinder_servicemanager_get_service_sync(
     const char* name,
     int* status);
 
+gulong
+gbinder_servicemanager_get_services(
+    GBinderServiceManager* sm,
+    const char* const* names,
+    guint max_wait_ms,
+    GBinderServiceManagerGetServicesFunc func,
+    void* user_data); /* Since 1.1.25 */
+
+/*
+ * Pings the objects (obtained from the same device) concurrently, a few
+ * at a time, and reports all the results at once. The ones which don't
+ * respond within timeout_ms are reported as GBINDER_PING_TIMEOUT, zero
+ * timeout means waiting for all of them. Can be cancelled with
+ * gbinder_servicemanager_cancel().
+ */
+gulong
+gbinder_servicemanager_ping_many(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    guint timeout_ms,
+    GBinderServiceManagerPingFunc func,
+    void* user_data); /* Since 1.1.25 */
+
 gulong
 gbinder_servicemanager_add_service(
     GBinderServiceManager* sm,
@@ -183,6 +256,16 @@ gbinder_servicemanager_add_presence_handler(
     GBinderServiceManagerFunc func,
     void* user_data); /* Since 1.0.25 */
 
+/*
+ * The handler is invoked when the kernel suspects that this process is
+ * sending too many oneway transactions (since 1.1.25).
+ */
+gulong
+gbinder_servicemanager_add_oneway_spam_handler(
+    GBinderServiceManager* sm,
+    GBinderServiceManagerFunc func,
+    void* user_data); /* Since 1.1.25 */
+
 gulong
 gbinder_servicemanager_add_registration_handler(
     GBinderServiceManager* sm,
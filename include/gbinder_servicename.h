@@ -57,6 +57,37 @@ void
 gbinder_servicename_unref(
     GBinderServiceName* name);
 
+/*
+ * Lazy services (since 1.1.25). The service manager tells whether
+ * anybody other than itself holds a reference to the service, and the
+ * service may unregister itself and exit when nobody does. It's then
+ * restarted by the service manager on demand. The callback is invoked
+ * whenever that changes, after each (re)registration of the name.
+ * gbinder_servicename_set_lazy() returns FALSE if the service manager
+ * doesn't support lazy services (only aidl4 does at the moment).
+ *
+ * gbinder_servicename_try_unregister() fails if the service has gained
+ * clients in the meantime. Once it succeeds, the name is never added
+ * again, not even when the service manager restarts. The caller is
+ * expected to exit soon after that.
+ */
+typedef
+void
+(*GBinderServiceNameClientsFunc)(
+    GBinderServiceName* name,
+    gboolean has_clients,
+    void* user_data);
+
+gboolean
+gbinder_servicename_set_lazy(
+    GBinderServiceName* name,
+    GBinderServiceNameClientsFunc func,
+    void* user_data); /* Since 1.1.25 */
+
+gboolean
+gbinder_servicename_try_unregister(
+    GBinderServiceName* name); /* Since 1.1.25 */
+
 G_END_DECLS
 
 #endif /* GBINDER_SERVICENAME_H */
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GBINDER_STATS_H
+#define GBINDER_STATS_H
+
+#include "gbinder_types.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Per-device, per-interface, per-code transaction statistics. Collection
+ * is off by default and costs a single atomic read per transaction until
+ * it's enabled with gbinder_stats_set_enabled().
+ *
+ * Since 1.1.25
+ */
+
+/*
+ * Forwarded transactions are recorded by the proxy objects created by
+ * GBinderBridge, against the device they were received from. Their time
+ * is measured until the reply is passed back to the caller, i.e. it
+ * includes the time spent by the destination object.
+ */
+
+/* Latency histogram buckets: [0] < 1us, [i] < 2^i us, last one is open */
+#define GBINDER_STATS_HISTOGRAM_SIZE (24)
+
+typedef enum gbinder_stats_dir {
+    GBINDER_STATS_OUTGOING,     /* Transactions sent by this process */
+    GBINDER_STATS_INCOMING,     /* Transactions handled by local objects */
+    GBINDER_STATS_FORWARDED     /* Transactions forwarded by proxies */
+} GBINDER_STATS_DIR;
+
+typedef struct gbinder_stats_entry {
+    const char* dev;
+    const char* iface;          /* NULL if unknown */
+    guint32 code;
+    GBINDER_STATS_DIR dir;
+    guint64 calls;
+    guint64 oneway;
+    guint64 errors;             /* Non-zero status */
+    guint64 request_bytes;
+    guint64 reply_bytes;
+    guint64 objects;            /* Objects in requests (outgoing) or replies */
+    guint64 total_usec;
+    guint64 max_usec;
+    guint64 histogram[GBINDER_STATS_HISTOGRAM_SIZE];
+} GBinderStatsEntry;
+
+typedef
+void
+(*GBinderStatsFunc)(
+    const GBinderStatsEntry* entry,
+    void* user_data);
+
+void
+gbinder_stats_set_enabled(
+    gboolean enabled);
+
+gboolean
+gbinder_stats_enabled(
+    void);
+
+void
+gbinder_stats_reset(
+    void);
+
+guint
+gbinder_stats_foreach(
+    GBinderStatsFunc func,
+    void* user_data);
+
+char*
+gbinder_stats_dump(
+    void)
+    G_GNUC_WARN_UNUSED_RESULT;
+
+/*
+ * With sampling interval N > 1, only every Nth transaction is measured
+ * and counters are scaled up by N, i.e. they become estimates. Maximum
+ * time is the maximum of the sampled transactions. Zero and one mean
+ * that every transaction is measured, which is the default.
+ */
+void
+gbinder_stats_set_sampling(
+    guint interval);
+
+guint
+gbinder_stats_sampling(
+    void);
+
+/* Upper bound of the histogram bucket containing the percentile */
+guint64
+gbinder_stats_percentile_usec(
+    const GBinderStatsEntry* entry,
+    guint percent);
+
+/*
+ * Process-wide accounting of the memory held by libgbinder. Unlike
+ * transaction statistics, it's always on and isn't affected by
+ * gbinder_stats_set_enabled() and gbinder_stats_reset().
+ *
+ * Since 1.1.25
+ */
+
+typedef enum gbinder_stats_mem {
+    GBINDER_STATS_MEM_BUFFERS,          /* Received data (binder mapping) */
+    GBINDER_STATS_MEM_LOCAL_REQUESTS,   /* Count only */
+    GBINDER_STATS_MEM_LOCAL_REPLIES,    /* Count only */
+    GBINDER_STATS_MEM_TX,               /* Queued asynchronous transactions */
+    GBINDER_STATS_MEM_LOCAL_OBJECTS,    /* Count only */
+    GBINDER_STATS_MEM_REMOTE_OBJECTS,   /* Count only */
+    GBINDER_STATS_MEM_MAPPINGS,         /* Shared memory mapped by readers */
+    GBINDER_STATS_MEM_COUNT
+} GBINDER_STATS_MEM;
+
+typedef struct gbinder_stats_mem_entry {
+    guint64 count;
+    guint64 max_count;
+    guint64 bytes;
+    guint64 max_bytes;
+} GBinderStatsMemEntry;
+
+gboolean
+gbinder_stats_get_memory(
+    GBINDER_STATS_MEM type,
+    GBinderStatsMemEntry* entry);
+
+/* Resets high-water marks to the current values */
+void
+gbinder_stats_reset_memory_peaks(
+    void);
+
+/*
+ * Queueing and lock contention inside libgbinder. Collected together
+ * with transaction statistics, i.e. only when gbinder_stats_enabled()
+ * is TRUE, and cleared by gbinder_stats_reset() (except for the current
+ * depth). Lock probes only count contended acquisitions, i.e. the time
+ * is the time spent waiting for the lock and the depth is the number
+ * of waiting threads.
+ *
+ * Since 1.1.25
+ */
+
+typedef enum gbinder_stats_probe {
+    GBINDER_STATS_PROBE_IPC_LOCK,       /* Global GBinderIpc lock */
+    GBINDER_STATS_PROBE_LOOPER_LOCK,    /* Looper list lock */
+    GBINDER_STATS_PROBE_LOCAL_LOCK,     /* Local object registry locks */
+    GBINDER_STATS_PROBE_REMOTE_LOCK,    /* Remote object registry locks */
+    GBINDER_STATS_PROBE_TX_QUEUE,       /* Async transaction queue to exec */
+    GBINDER_STATS_PROBE_DISPATCH,       /* Looper to main thread handoff */
+    GBINDER_STATS_PROBE_LOOPER_BLOCKED, /* Loopers blocked by requests */
+    GBINDER_STATS_PROBE_COUNT
+} GBINDER_STATS_PROBE;
+
+typedef struct gbinder_stats_probe_entry {
+    guint64 count;
+    guint depth;                /* Current */
+    guint max_depth;
+    guint64 total_usec;
+    guint64 max_usec;
+    guint64 histogram[GBINDER_STATS_HISTOGRAM_SIZE];
+} GBinderStatsProbeEntry;
+
+gboolean
+gbinder_stats_get_probe(
+    GBINDER_STATS_PROBE probe,
+    GBinderStatsProbeEntry* entry);
+
+/*
+ * Profiling of the transaction handlers invoked on the main thread.
+ * It's independent of gbinder_stats_set_enabled() and costs a single
+ * atomic read per transaction while it's off. When it's on, the most
+ * recent GBINDER_STATS_HANDLER_HISTORY invocations are remembered,
+ * and the slow handler callback (if any) is invoked on the main thread
+ * right after each handler that took at least threshold_usec.
+ * gbinder_stats_reset() clears the history.
+ *
+ * Since 1.1.25
+ */
+
+#define GBINDER_STATS_HANDLER_HISTORY (64)
+
+typedef struct gbinder_stats_handler_entry {
+    const char* dev;
+    const char* iface;          /* NULL if unknown */
+    guint32 code;
+    guint32 flags;
+    gint64 start;               /* g_get_monotonic_time() */
+    guint64 usec;
+    guint64 trace_id;           /* Zero if none, see TraceContext */
+} GBinderStatsHandlerEntry;
+
+typedef
+void
+(*GBinderStatsSlowHandlerFunc)(
+    const GBinderStatsHandlerEntry* entry,
+    void* user_data);
+
+void
+gbinder_stats_set_handler_profiling(
+    gboolean enabled);
+
+gboolean
+gbinder_stats_handler_profiling(
+    void);
+
+void
+gbinder_stats_set_slow_handler(
+    guint64 threshold_usec,
+    GBinderStatsSlowHandlerFunc func,
+    void* user_data);
+
+/* Newest first, returns the number of entries copied */
+guint
+gbinder_stats_get_handlers(
+    GBinderStatsHandlerEntry* entries,
+    guint max);
+
+/*
+ * Cold start timings, i.e. how long the first occurrence of each phase
+ * took in this process. These are always collected (it costs nothing
+ * once each phase has been recorded) and never reset. The device is
+ * opened by the first gbinder_ipc_new() for that device but mapped into
+ * memory only right before the first read or write. The IPC phase
+ * includes the config and open phases, if they happened there.
+ *
+ * Since 1.1.25
+ */
+
+typedef enum gbinder_stats_startup {
+    GBINDER_STATS_STARTUP_CONFIG,   /* Loading the config files */
+    GBINDER_STATS_STARTUP_OPEN,     /* Opening and setting up the device */
+    GBINDER_STATS_STARTUP_MMAP,     /* Mapping the device into memory */
+    GBINDER_STATS_STARTUP_IPC,      /* Creating the first GBinderIpc */
+    GBINDER_STATS_STARTUP_LOOPER,   /* Starting the first looper */
+    GBINDER_STATS_STARTUP_COUNT
+} GBINDER_STATS_STARTUP;
+
+/* Returns FALSE if the phase hasn't happened yet */
+gboolean
+gbinder_stats_get_startup(
+    GBINDER_STATS_STARTUP phase,
+    guint64* usec);
+
+/*
+ * Decisions made by the runtime tuning (see Autotune in README), most
+ * recent GBINDER_STATS_TUNING_HISTORY of them. These are rare, they are
+ * always recorded and aren't cleared by gbinder_stats_reset().
+ *
+ * Since 1.1.25
+ */
+
+#define GBINDER_STATS_TUNING_HISTORY (32)
+
+typedef enum gbinder_stats_tuning {
+    GBINDER_STATS_TUNING_READ_BUFFER,   /* Read buffer size, bytes */
+    GBINDER_STATS_TUNING_REPLY_SIZE,    /* Reply pre-sizing, bytes */
+    GBINDER_STATS_TUNING_LOOPERS,       /* Maximum number of loopers */
+    GBINDER_STATS_TUNING_TX_THREADS,    /* Maximum number of tx threads */
+    GBINDER_STATS_TUNING_COUNT
+} GBINDER_STATS_TUNING;
+
+typedef struct gbinder_stats_tuning_entry {
+    const char* dev;
+    GBINDER_STATS_TUNING param;
+    gint64 time;                /* g_get_monotonic_time() */
+    guint old_value;
+    guint new_value;
+} GBinderStatsTuningEntry;
+
+/* Newest first, returns the number of entries copied */
+guint
+gbinder_stats_get_tuning(
+    GBinderStatsTuningEntry* entries,
+    guint max);
+
+/*
+ * The binder driver's view of a process, parsed from its stats file
+ * (binder_logs/stats next to the binderfs device node, or the one in
+ * debugfs). Reading that file normally requires root. The counters are
+ * cumulative since the process has opened the device, zero pid means
+ * this process.
+ *
+ * A process which has the device open more than once (e.g. with two
+ * different RPC protocols) has a separate section for each file. All
+ * sections of the process are summed up, and so are the libgbinder
+ * numbers below.
+ *
+ * For this process, the libgbinder side of the same device is filled
+ * in as well, so that the kernel queues can be compared with our own
+ * loopers and mapping usage. Those are zeros if the device isn't open
+ * or the process is a different one.
+ *
+ * Since 1.1.25
+ */
+
+typedef struct gbinder_stats_kernel {
+    /* Kernel */
+    guint threads;              /* Threads known to the driver */
+    guint ready_threads;        /* Waiting for work */
+    guint requested_threads;    /* BR_SPAWN_LOOPER not answered yet */
+    guint started_threads;      /* Started in response to BR_SPAWN_LOOPER */
+    guint max_threads;
+    guint pending_transactions; /* Queued to the process, not picked up */
+    guint nodes;
+    guint refs;
+    guint buffers;              /* Allocated in the mapping */
+    guint64 free_async_space;   /* Bytes */
+    guint64 transactions;       /* BC_TRANSACTION[_SG] */
+    guint64 replies;            /* BC_REPLY[_SG] */
+    guint64 incoming;           /* BR_TRANSACTION[_SEC_CTX] */
+    guint64 failed_replies;     /* BR_FAILED_REPLY */
+    guint64 dead_replies;       /* BR_DEAD_REPLY */
+    guint64 frozen_replies;     /* BR_FROZEN_REPLY */
+    guint64 spam_suspects;      /* BR_ONEWAY_SPAM_SUSPECT */
+    /* libgbinder (this process only) */
+    guint loopers;              /* Primary loopers */
+    guint blocked_loopers;      /* Waiting for the main thread */
+    guint64 mapped_bytes;       /* See gbinder_servicemanager_buffer_space */
+    guint64 pinned_bytes;       /* And gbinder_servicemanager_buffer_pinned */
+} GBinderStatsKernel;
+
+gboolean
+gbinder_stats_get_kernel(
+    const char* dev,
+    int pid,
+    GBinderStatsKernel* stats);
+
+G_END_DECLS
+
+#endif /* GBINDER_STATS_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
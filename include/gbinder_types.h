@@ -145,6 +145,49 @@ typedef struct gbinder_hidl_memory {
 #define GBINDER_HIDL_MEMORY_NAME_OFFSET (24)
 G_STATIC_ASSERT(sizeof(GBinderHidlMemory) == 40);
 
+/*
+ * Layout of a HIDL struct, for gbinder_writer_append_hidl_schema and
+ * gbinder_reader_read_hidl_schema. Only the fields which have embedded
+ * buffers need to be listed, the rest is plain data. Vector elements
+ * and nested structs are described by their own schemas, e.g.
+ *
+ *   typedef struct foo {
+ *       gint32 id;
+ *       GBinderHidlString name;
+ *       GBinderHidlVec bars;
+ *   } Foo;
+ *
+ *   static const GBinderHidlField foo_fields[] = {
+ *       GBINDER_HIDL_FIELD(STRING, Foo, name, NULL),
+ *       GBINDER_HIDL_FIELD(VEC, Foo, bars, &bar_schema),
+ *       GBINDER_HIDL_FIELDS_END
+ *   };
+ *   static const GBinderHidlSchema foo_schema = { sizeof(Foo), foo_fields };
+ */
+typedef enum gbinder_hidl_field_type {
+    GBINDER_HIDL_FIELD_END,
+    GBINDER_HIDL_FIELD_STRING,  /* GBinderHidlString */
+    GBINDER_HIDL_FIELD_VEC,     /* GBinderHidlVec of schema elements */
+    GBINDER_HIDL_FIELD_STRUCT   /* Struct embedded by value */
+} GBINDER_HIDL_FIELD_TYPE; /* Since 1.1.25 */
+
+typedef struct gbinder_hidl_schema GBinderHidlSchema;
+
+typedef struct gbinder_hidl_field {
+    GBINDER_HIDL_FIELD_TYPE type;
+    gsize offset;
+    const GBinderHidlSchema* schema; /* Elements or the nested struct */
+} GBinderHidlField; /* Since 1.1.25 */
+
+struct gbinder_hidl_schema {
+    gsize size;
+    const GBinderHidlField* fields; /* NULL if there's nothing embedded */
+}; /* Since 1.1.25 */
+
+#define GBINDER_HIDL_FIELD(type,s,field,schema) \
+    { GBINDER_HIDL_FIELD_##type, G_STRUCT_OFFSET(s,field), schema }
+#define GBINDER_HIDL_FIELDS_END { GBINDER_HIDL_FIELD_END, 0, NULL }
+
 /*
  * Each RPC call is identified by the interface name returned
  * by gbinder_remote_request_interface() the transaction code.
@@ -154,6 +197,29 @@ G_STATIC_ASSERT(sizeof(GBinderHidlMemory) == 40);
  * be ignored for one-way transactions. If GBINDER_TX_FLAG_ONEWAY
  * is passed in, the callback may and should return NULL and that
  * won't be interpreted as an error.
+ *
+ * GBINDER_TX_FLAG_DIRECT only makes sense together with
+ * GBINDER_TX_FLAG_ONEWAY and tells gbinder_client_transact() to
+ * write one-way transaction to the driver right away, on the calling
+ * thread, rather than passing it to a worker thread. The completion
+ * callback (if any) is still invoked later from the event loop.
+ *
+ * GBINDER_TX_FLAG_WORKER (since 1.1.25) tells gbinder_client_transact()
+ * to invoke the reply callback right on the worker thread which has
+ * received the reply, saving a trip through the event loop. The callback
+ * must be thread safe. Cancellation is checked before the callback is
+ * invoked but a gbinder_client_cancel() racing with the reply can't stop
+ * the callback which is already running. Either way, the callback is
+ * invoked at most once and the destroy notification is invoked later
+ * from the event loop, after the callback has returned. Transactions
+ * handled on the main thread (direct one-way, coalesced and those going
+ * to in-process objects without looper dispatch) complete there as usual.
+ *
+ * GBINDER_TX_FLAG_REALTIME and GBINDER_TX_FLAG_BACKGROUND (since 1.1.25)
+ * put the asynchronous transaction into the realtime or background lane
+ * of the worker pool, the default being the normal one. Queued calls are
+ * picked lane by lane, and each device has a worker reserved for the
+ * realtime lane, so that slow calls queued earlier can't delay those.
  */
 typedef
 GBinderLocalReply*
@@ -166,13 +232,25 @@ GBinderLocalReply*
     void* user_data);
 
 #define GBINDER_TX_FLAG_ONEWAY (0x01)
+#define GBINDER_TX_FLAG_DIRECT (0x02) /* Since 1.1.25 */
+#define GBINDER_TX_FLAG_WORKER (0x04) /* Since 1.1.25 */
+#define GBINDER_TX_FLAG_REALTIME (0x08) /* Since 1.1.25 */
+#define GBINDER_TX_FLAG_BACKGROUND (0x10) /* Since 1.1.25 */
 
 typedef enum gbinder_status {
     GBINDER_STATUS_OK = 0,
     GBINDER_STATUS_FAILED,
-    GBINDER_STATUS_DEAD_OBJECT
+    GBINDER_STATUS_DEAD_OBJECT,
+    GBINDER_STATUS_FROZEN /* Since 1.1.25 */
 } GBINDER_STATUS;
 
+/* Per-object results of gbinder_servicemanager_ping_many() (since 1.1.25) */
+typedef enum gbinder_ping_result {
+    GBINDER_PING_ALIVE,
+    GBINDER_PING_DEAD,
+    GBINDER_PING_TIMEOUT
+} GBINDER_PING_RESULT;
+
 #define GBINDER_FOURCC(c1,c2,c3,c4) \
     (((c1) << 24) | ((c2) << 16) | ((c3) << 8) | (c4))
 
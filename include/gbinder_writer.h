@@ -129,6 +129,11 @@ gbinder_writer_append_fd(
     GBinderWriter* writer,
     int fd); /* Since 1.0.18 */
 
+void
+gbinder_writer_adopt_fd(
+    GBinderWriter* writer,
+    int fd); /* Since 1.1.25 */
+
 void
 gbinder_writer_append_fds(
     GBinderWriter* writer,
@@ -148,12 +153,33 @@ gbinder_writer_append_buffer_object(
     const void* buf,
     gsize len);
 
+guint
+gbinder_writer_append_buffer_object_bytes(
+    GBinderWriter* writer,
+    GBytes* bytes,
+    const GBinderParent* parent); /* Since 1.1.25 */
+
 void
 gbinder_writer_append_parcelable(
     GBinderWriter* writer,
     const void* buf,
     gsize len); /* Since 1.1.19 */
 
+/*
+ * Writes the non-null parcelable header with a placeholder for the size
+ * which gets patched by gbinder_writer_end_parcelable(). The returned
+ * value must be passed to gbinder_writer_end_parcelable(). Parcelables
+ * can be nested.
+ */
+gsize
+gbinder_writer_begin_parcelable(
+    GBinderWriter* writer); /* Since 1.1.25 */
+
+void
+gbinder_writer_end_parcelable(
+    GBinderWriter* writer,
+    gsize start); /* Since 1.1.25 */
+
 void
 gbinder_writer_append_hidl_vec(
     GBinderWriter* writer,
@@ -161,6 +187,12 @@ gbinder_writer_append_hidl_vec(
     guint count,
     guint elemsize); /* Since 1.0.8 */
 
+void
+gbinder_writer_append_hidl_vec_bytes(
+    GBinderWriter* writer,
+    GBytes* bytes,
+    guint elemsize); /* Since 1.1.25 */
+
 void
 gbinder_writer_append_hidl_string(
     GBinderWriter* writer,
@@ -171,6 +203,18 @@ gbinder_writer_append_hidl_string_copy(
     GBinderWriter* writer,
     const char* str); /* Since 1.1.13 */
 
+/* str[len] must be NUL, the string must outlive the parcel */
+void
+gbinder_writer_append_hidl_string_len(
+    GBinderWriter* writer,
+    const char* str,
+    gsize len); /* Since 1.1.25 */
+
+void
+gbinder_writer_append_hidl_string_bytes(
+    GBinderWriter* writer,
+    GBytes* bytes); /* Since 1.1.25 */
+
 void
 gbinder_writer_append_hidl_string_vec(
     GBinderWriter* writer,
@@ -193,6 +237,44 @@ gbinder_writer_append_byte_array(
     const void* byte_array,
     gint32 len); /* Since 1.0.12 */
 
+void
+gbinder_writer_append_int32_array(
+    GBinderWriter* writer,
+    const gint32* values,
+    gsize count); /* Since 1.1.25 */
+
+void
+gbinder_writer_append_int64_array(
+    GBinderWriter* writer,
+    const gint64* values,
+    gsize count); /* Since 1.1.25 */
+
+void
+gbinder_writer_append_float_array(
+    GBinderWriter* writer,
+    const gfloat* values,
+    gsize count); /* Since 1.1.25 */
+
+void
+gbinder_writer_append_double_array(
+    GBinderWriter* writer,
+    const gdouble* values,
+    gsize count); /* Since 1.1.25 */
+
+/* The data isn't copied and must stay alive until the parcel is gone */
+void
+gbinder_writer_append_hidl_schema(
+    GBinderWriter* writer,
+    const GBinderHidlSchema* schema,
+    const void* data); /* Since 1.1.25 */
+
+/* Blobs above BlobInplaceLimit bytes are passed via shared memory */
+void
+gbinder_writer_append_blob(
+    GBinderWriter* writer,
+    const void* blob,
+    gsize size); /* Since 1.1.25 */
+
 void
 gbinder_writer_append_fmq_descriptor(
     GBinderWriter* writer,
@@ -213,6 +295,14 @@ gbinder_writer_overwrite_int32(
     gsize offset,
     gint32 value); /* Since 1.0.21 */
 
+/* Preallocates space for the data which is about to be written */
+void
+gbinder_writer_reserve(
+    GBinderWriter* writer,
+    gsize size,
+    guint objects,
+    guint buffers); /* Since 1.1.25 */
+
 /* Note: memory allocated by GBinderWriter is owned by GBinderWriter */
 
 void*
@@ -248,6 +338,40 @@ gbinder_writer_strdup(
     GBinderWriter* writer,
     const char* str); /* Since 1.1.13 */
 
+/*
+ * Inline fast paths for fixed size primitive appends (since 1.1.25).
+ * They produce the same output as their out-of-line counterparts.
+ * gbinder_writer_grow() is the slow path which makes room for more
+ * data. The layout of GBinderWriter these rely on (d[1] is the byte
+ * array, d[2] is the number of bytes it can hold without reallocation)
+ * is part of the ABI since 1.1.25.
+ */
+GByteArray*
+gbinder_writer_grow(
+    GBinderWriter* writer,
+    gsize size); /* Since 1.1.25 */
+
+#define GBINDER_WRITER_INLINE_APPEND(writer,type,value) do { \
+    GByteArray* _buf = (GByteArray*)(writer)->d[1]; \
+    if (G_UNLIKELY(!_buf || _buf->len + sizeof(type) > \
+        GPOINTER_TO_SIZE((writer)->d[2]))) { \
+        _buf = gbinder_writer_grow(writer, sizeof(type)); \
+        if (!_buf) return; \
+    } \
+    *(type*)(_buf->data + _buf->len) = (value); \
+    _buf->len += sizeof(type); } while (0)
+
+static inline void gbinder_writer_append_int32_inline(GBinderWriter* w,
+    guint32 v) { GBINDER_WRITER_INLINE_APPEND(w, guint32, v); }
+static inline void gbinder_writer_append_int64_inline(GBinderWriter* w,
+    guint64 v) { GBINDER_WRITER_INLINE_APPEND(w, guint64, v); }
+static inline void gbinder_writer_append_float_inline(GBinderWriter* w,
+    gfloat v) { GBINDER_WRITER_INLINE_APPEND(w, gfloat, v); }
+static inline void gbinder_writer_append_double_inline(GBinderWriter* w,
+    gdouble v) { GBINDER_WRITER_INLINE_APPEND(w, gdouble, v); }
+static inline void gbinder_writer_append_bool_inline(GBinderWriter* w,
+    gboolean v) { GBINDER_WRITER_INLINE_APPEND(w, guint32, v != FALSE); }
+
 G_END_DECLS
 
 #endif /* GBINDER_WRITER_H */
@@ -65,6 +65,7 @@ struct gbinder_bridge {
     GBinderBridgeInterface** ifaces;
     GBinderServiceManager* src;
     GBinderServiceManager* dest;
+    gboolean looper_dispatch;
 };
 
 /*==========================================================================*
@@ -154,6 +155,8 @@ gbinder_bridge_interface_activate(
     if (bi->dest_obj && !bi->proxy) {
         bi->proxy = gbinder_proxy_object_new(gbinder_servicemanager_ipc(src),
             bi->dest_obj);
+        gbinder_local_object_set_looper_dispatch(GBINDER_LOCAL_OBJECT
+            (bi->proxy), bridge->looper_dispatch);
     }
     if (bi->proxy && !bi->src_service) {
         bi->src_service = gbinder_servicename_new(src,
@@ -245,6 +248,32 @@ gbinder_bridge_new2(
     return NULL;
 }
 
+/*
+ * With looper dispatch enabled, calls coming from src are forwarded to
+ * dest synchronously by the looper thread which has received them, and
+ * the reply is sent back by the same thread. That saves a few thread
+ * switches per call but ties up a src looper thread for the duration
+ * of each call.
+ */
+void
+gbinder_bridge_set_looper_dispatch(
+    GBinderBridge* self,
+    gboolean enable) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderBridgeInterface** bi = self->ifaces;
+
+        self->looper_dispatch = (enable != FALSE);
+        while (*bi) {
+            if ((*bi)->proxy) {
+                gbinder_local_object_set_looper_dispatch(GBINDER_LOCAL_OBJECT
+                    ((*bi)->proxy), self->looper_dispatch);
+            }
+            bi++;
+        }
+    }
+}
+
 void
 gbinder_bridge_free(
     GBinderBridge* self)
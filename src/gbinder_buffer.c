@@ -32,18 +32,36 @@
 
 #include "gbinder_buffer_p.h"
 #include "gbinder_driver.h"
+#include "gbinder_io_fixed.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_log.h"
 
 #include <gutil_macros.h>
 
+#include <string.h>
+
 struct gbinder_buffer_contents {
     gint refcount;
     void* buffer;
     gsize size;
+    gsize pinned;
     void** objects;
+    guint fd_count; /* Number of fd objects to close */
+    const void** taken; /* Fd objects given away, see gbinder_buffer_take_fd */
+    guint taken_count;
+    gboolean evicted; /* Heap copy, kernel buffer is already freed */
     GBinderDriver* driver;
+    const GBinderIo* io;
+    GDestroyNotify destroy;
+    gpointer destroy_data;
 };
 
+/* Smaller pieces are copied rather than referenced */
+#define GBINDER_BUFFER_BYTES_COPY_MAX (64)
+
+/* Only guards the taken arrays, those are rarely touched */
+static GMutex gbinder_buffer_take_mutex; /* Statically allocated, no init */
+
 typedef struct gbinder_buffer_priv {
     GBinderBuffer pub;
     GBinderBufferContents* contents;
@@ -56,13 +74,65 @@ static inline GBinderBufferPriv* gbinder_buffer_cast(GBinderBuffer* buf)
  * GBinderBufferContents
  *==========================================================================*/
 
+/*
+ * Only flat buffers can be moved to the heap. Scatter-gather buffers
+ * live outside of the data area and are referenced by absolute pointers
+ * embedded in the data, there's no cheap way to relocate those.
+ */
+static
+gboolean
+gbinder_buffer_contents_can_evict(
+    GBinderBufferContents* self)
+{
+    if (self->objects) {
+        const GBinderIo* io = self->io;
+        void** ptr;
+
+        for (ptr = self->objects; *ptr; ptr++) {
+            if (GBINDER_IO_CALL(io, object_data_size)(*ptr)) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+static
+void
+gbinder_buffer_contents_evict(
+    GBinderBufferContents* self)
+{
+    guint8* copy = g_malloc(self->size);
+
+    /*
+     * Nobody has seen the kernel buffer yet, so the objects are the only
+     * pointers which need to be fixed up.
+     */
+    memcpy(copy, self->buffer, self->size);
+    if (self->objects) {
+        void** ptr;
+
+        for (ptr = self->objects; *ptr; ptr++) {
+            *ptr = copy + ((guint8*)*ptr - (guint8*)self->buffer);
+        }
+    }
+    GVERBOSE("Copied %u bytes at %p to heap", (guint)self->size,
+        self->buffer);
+    gbinder_driver_unpin_buffer(self->driver, self->pinned);
+    gbinder_driver_free_buffer(self->driver, self->buffer);
+    self->pinned = 0;
+    self->buffer = copy;
+    self->evicted = TRUE;
+}
+
 static
 GBinderBufferContents*
 gbinder_buffer_contents_new(
     GBinderDriver* driver,
     void* buffer,
     gsize size,
-    void** objects)
+    void** objects,
+    gboolean evictable)
 {
     GBinderBufferContents* self = g_slice_new0(GBinderBufferContents);
 
@@ -71,6 +141,36 @@ gbinder_buffer_contents_new(
     self->size = size;
     self->objects = objects;
     self->driver = gbinder_driver_ref(driver);
+    self->io = gbinder_driver_io(driver);
+    self->pinned = gbinder_driver_pin_buffer(driver, buffer, size, objects,
+        &self->fd_count);
+    if (evictable && gbinder_driver_mapping_pressure(driver) &&
+        gbinder_buffer_contents_can_evict(self)) {
+        gbinder_buffer_contents_evict(self);
+    }
+    gbinder_stats_mem_add(GBINDER_STATS_MEM_BUFFERS, size);
+    return self;
+}
+
+static
+GBinderBufferContents*
+gbinder_buffer_contents_new_local(
+    const GBinderIo* io,
+    void* buffer,
+    gsize size,
+    void** objects,
+    GDestroyNotify destroy,
+    gpointer destroy_data)
+{
+    GBinderBufferContents* self = g_slice_new0(GBinderBufferContents);
+
+    g_atomic_int_set(&self->refcount, 1);
+    self->buffer = buffer;
+    self->size = size;
+    self->objects = objects;
+    self->io = io;
+    self->destroy = destroy;
+    self->destroy_data = destroy_data;
     return self;
 }
 
@@ -79,16 +179,62 @@ void
 gbinder_buffer_contents_free(
     GBinderBufferContents* self)
 {
-    if (self->objects) {
-        gbinder_driver_close_fds(self->driver, self->objects,
-            ((guint8*)self->buffer) + self->size);
-        g_free(self->objects);
+    if (self->driver) {
+        if (self->fd_count > self->taken_count) {
+            gbinder_driver_close_fds(self->driver, self->objects,
+                ((guint8*)self->buffer) + self->size, self->taken,
+                self->taken_count);
+        }
+        g_free(self->taken);
+        if (self->evicted) {
+            g_free(self->buffer);
+        } else {
+            gbinder_driver_unpin_buffer(self->driver, self->pinned);
+            gbinder_driver_free_buffer(self->driver, self->buffer);
+        }
+        gbinder_driver_unref(self->driver);
+        gbinder_stats_mem_remove(GBINDER_STATS_MEM_BUFFERS, self->size);
+    } else if (self->destroy) {
+        /* File descriptors belong to the owner of the memory */
+        self->destroy(self->destroy_data);
     }
-    gbinder_driver_free_buffer(self->driver, self->buffer);
-    gbinder_driver_unref(self->driver);
+    g_free(self->objects);
     g_slice_free(GBinderBufferContents, self);
 }
 
+/*
+ * Gives the ownership of the fd object to the caller, i.e. the fd won't
+ * be closed when the buffer is freed. Only works for the buffers which
+ * come from the driver, the fds contained in the local buffers belong
+ * to whoever owns the memory. Each fd can be taken only once.
+ */
+static
+gboolean
+gbinder_buffer_contents_take_fd(
+    GBinderBufferContents* self,
+    const void* obj)
+{
+    gboolean ok = FALSE;
+
+    if (self->driver && self->fd_count) {
+        guint i;
+
+        /* Lock */
+        g_mutex_lock(&gbinder_buffer_take_mutex);
+        for (i = 0; i < self->taken_count && self->taken[i] != obj; i++);
+        if (i == self->taken_count && self->taken_count < self->fd_count) {
+            if (!self->taken) {
+                self->taken = g_new(const void*, self->fd_count);
+            }
+            self->taken[self->taken_count++] = obj;
+            ok = TRUE;
+        }
+        g_mutex_unlock(&gbinder_buffer_take_mutex);
+        /* Unlock */
+    }
+    return ok;
+}
+
 GBinderBufferContents*
 gbinder_buffer_contents_ref(
     GBinderBufferContents* self)
@@ -112,6 +258,30 @@ gbinder_buffer_contents_unref(
     }
 }
 
+/*
+ * Exports a piece of the buffer as GBytes. Normally that's just another
+ * reference to the contents, but if the data still sits in the kernel
+ * mapping and the mapping is running short of space (or the piece is so
+ * small that copying is cheaper than holding the whole buffer), the data
+ * gets copied. Otherwise GBytes kept around for a long time would keep
+ * the mapping pinned and hence every incoming buffer copied to the heap.
+ */
+GBytes*
+gbinder_buffer_contents_bytes(
+    GBinderBufferContents* self,
+    gconstpointer data,
+    gsize size)
+{
+    if (self && size > GBINDER_BUFFER_BYTES_COPY_MAX &&
+        (!self->driver || self->evicted ||
+        !gbinder_driver_mapping_pressure(self->driver))) {
+        return g_bytes_new_with_free_func(data, size, (GDestroyNotify)
+            gbinder_buffer_contents_unref, gbinder_buffer_contents_ref(self));
+    } else {
+        return g_bytes_new(data, size);
+    }
+}
+
 /*==========================================================================*
  * GBinderBufferContentsList
  * It's actually a GSList containing GBinderBufferContents refs.
@@ -193,8 +363,51 @@ gbinder_buffer_new(
     void** objects)
 {
     return gbinder_buffer_alloc((driver && data) ?
-        gbinder_buffer_contents_new(driver, data, size, objects) : NULL,
-        data, size);
+        gbinder_buffer_contents_new(driver, data, size, objects, FALSE) :
+        NULL, data, size);
+}
+
+/*
+ * Same as gbinder_buffer_new() but if the mapping is running out of
+ * space, the data may be copied to the heap and the kernel buffer freed
+ * right away. Must not be used for incoming oneway transactions, the
+ * kernel doesn't deliver the next oneway transaction to the same node
+ * until the previous buffer is freed, and that's what keeps them ordered.
+ */
+GBinderBuffer*
+gbinder_buffer_new_evictable(
+    GBinderDriver* driver,
+    void* data,
+    gsize size,
+    void** objects)
+{
+    if (driver && data) {
+        GBinderBufferContents* contents = gbinder_buffer_contents_new(driver,
+            data, size, objects, TRUE);
+
+        return gbinder_buffer_alloc(contents, contents->buffer, size);
+    } else {
+        return gbinder_buffer_alloc(NULL, data, size);
+    }
+}
+
+/*
+ * Wraps the memory which doesn't come from the driver (e.g. the contents
+ * of a parcel delivered within the process). The objects array is owned
+ * by the buffer, destroy is invoked when the last buffer referencing the
+ * memory is gone.
+ */
+GBinderBuffer*
+gbinder_buffer_new_local(
+    const GBinderIo* io,
+    void* data,
+    gsize size,
+    void** objects,
+    GDestroyNotify destroy,
+    gpointer destroy_data)
+{
+    return gbinder_buffer_alloc(gbinder_buffer_contents_new_local(io, data,
+        size, objects, destroy, destroy_data), data, size);
 }
 
 GBinderBuffer*
@@ -246,9 +459,9 @@ const GBinderIo*
 gbinder_buffer_io(
     GBinderBuffer* buf)
 {
-    GBinderDriver* driver = gbinder_buffer_driver(buf);
+    GBinderBufferContents* contents = gbinder_buffer_contents(buf);
 
-    return driver ? gbinder_driver_io(driver) : NULL;
+    return contents ? contents->io : NULL;
 }
 
 void**
@@ -265,6 +478,19 @@ gbinder_buffer_objects(
     return NULL;
 }
 
+gboolean
+gbinder_buffer_take_fd(
+    GBinderBuffer* self,
+    const void* obj)
+{
+    if (G_LIKELY(self)) {
+        GBinderBufferContents* contents = gbinder_buffer_cast(self)->contents;
+
+        return contents && gbinder_buffer_contents_take_fd(contents, obj);
+    }
+    return FALSE;
+}
+
 GBinderBufferContents*
 gbinder_buffer_contents(
     GBinderBuffer* self)
@@ -45,6 +45,24 @@ gbinder_buffer_new(
     void** objects)
     GBINDER_INTERNAL;
 
+GBinderBuffer*
+gbinder_buffer_new_evictable(
+    GBinderDriver* driver,
+    void* data,
+    gsize size,
+    void** objects)
+    GBINDER_INTERNAL;
+
+GBinderBuffer*
+gbinder_buffer_new_local(
+    const GBinderIo* io,
+    void* data,
+    gsize size,
+    void** objects,
+    GDestroyNotify destroy,
+    gpointer destroy_data)
+    GBINDER_INTERNAL;
+
 GBinderBuffer*
 gbinder_buffer_new_with_parent(
     GBinderBuffer* parent,
@@ -78,6 +96,12 @@ gbinder_buffer_objects(
     GBinderBuffer* buffer)
     GBINDER_INTERNAL;
 
+gboolean
+gbinder_buffer_take_fd(
+    GBinderBuffer* buffer,
+    const void* obj)
+    GBINDER_INTERNAL;
+
 GBinderBufferContents*
 gbinder_buffer_contents_ref(
     GBinderBufferContents* contents)
@@ -88,6 +112,13 @@ gbinder_buffer_contents_unref(
     GBinderBufferContents* contents)
     GBINDER_INTERNAL;
 
+GBytes*
+gbinder_buffer_contents_bytes(
+    GBinderBufferContents* contents,
+    gconstpointer data,
+    gsize size)
+    GBINDER_INTERNAL;
+
 GBinderBufferContentsList*
 gbinder_buffer_contents_list_add(
     GBinderBufferContentsList* list,
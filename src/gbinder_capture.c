@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "gbinder_capture_p.h"
+#include "gbinder_io_fixed.h"
+#include "gbinder_log.h"
+
+#include <gutil_intarray.h>
+#include <gutil_macros.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+G_STATIC_ASSERT(sizeof(GBinderCaptureRecord) == 40);
+
+#define GBINDER_CAPTURE_OBJECT_HEADER_SIZE (8)
+
+gint gbinder_capture_on = FALSE;
+
+static GMutex gbinder_capture_mutex;
+static FILE* gbinder_capture_file = NULL;
+static GQueue gbinder_capture_ring = G_QUEUE_INIT;
+static gsize gbinder_capture_ring_bytes = 0;
+static gsize gbinder_capture_ring_max = 0;
+
+static
+void
+gbinder_capture_clear_ring_locked(
+    void)
+{
+    GBytes* rec;
+
+    /* Caller holds the mutex */
+    while ((rec = g_queue_pop_head(&gbinder_capture_ring)) != NULL) {
+        g_bytes_unref(rec);
+    }
+    gbinder_capture_ring_bytes = 0;
+    gbinder_capture_ring_max = 0;
+}
+
+static
+GBytes*
+gbinder_capture_stop_locked(
+    void)
+{
+    GBytes* out = NULL;
+
+    /* Caller holds the mutex */
+    g_atomic_int_set(&gbinder_capture_on, FALSE);
+    if (gbinder_capture_file) {
+        fclose(gbinder_capture_file);
+        gbinder_capture_file = NULL;
+    } else if (gbinder_capture_ring_max) {
+        GByteArray* buf = g_byte_array_sized_new(GBINDER_CAPTURE_MAGIC_SIZE +
+            gbinder_capture_ring_bytes);
+        GList* l;
+
+        g_byte_array_append(buf, (const guint8*)GBINDER_CAPTURE_MAGIC,
+            GBINDER_CAPTURE_MAGIC_SIZE);
+        for (l = gbinder_capture_ring.head; l; l = l->next) {
+            gsize size;
+            const guint8* data = g_bytes_get_data(l->data, &size);
+
+            g_byte_array_append(buf, data, size);
+        }
+        gbinder_capture_clear_ring_locked();
+        out = g_byte_array_free_to_bytes(buf);
+    }
+    return out;
+}
+
+static
+void
+gbinder_capture_add(
+    GBytes* rec)
+{
+    /* Lock */
+    g_mutex_lock(&gbinder_capture_mutex);
+    if (gbinder_capture_file) {
+        gsize size;
+        const void* data = g_bytes_get_data(rec, &size);
+
+        if (fwrite(data, size, 1, gbinder_capture_file) != 1) {
+            GWARN("Capture write failed: %s", strerror(errno));
+            g_bytes_unref(gbinder_capture_stop_locked());
+        }
+        g_bytes_unref(rec);
+    } else if (gbinder_capture_ring_max) {
+        /* Drop the oldest records to make room for the new one */
+        gbinder_capture_ring_bytes += g_bytes_get_size(rec);
+        g_queue_push_tail(&gbinder_capture_ring, rec);
+        while (gbinder_capture_ring_bytes > gbinder_capture_ring_max) {
+            GBytes* old = g_queue_pop_head(&gbinder_capture_ring);
+
+            gbinder_capture_ring_bytes -= g_bytes_get_size(old);
+            g_bytes_unref(old);
+        }
+    } else {
+        /* Capture has been stopped in the meantime */
+        g_bytes_unref(rec);
+    }
+    g_mutex_unlock(&gbinder_capture_mutex);
+    /* Unlock */
+}
+
+/* Either offsets or objects must be provided (if count isn't zero) */
+static
+void
+gbinder_capture_record(
+    const GBinderIo* io,
+    GBINDER_CAPTURE_DIR dir,
+    guint32 handle,
+    guint32 code,
+    guint32 flags,
+    const guint8* data,
+    gsize size,
+    const int* offsets,
+    void** objects,
+    guint count)
+{
+    const gsize data_space = G_ALIGN8(size);
+    const gsize total = sizeof(GBinderCaptureRecord) + data_space +
+        G_ALIGN8(count * sizeof(guint32));
+    GBinderCaptureRecord* rec = g_malloc0(total);
+    guint8* out = (guint8*)(rec + 1);
+    guint32* out_offsets = (guint32*)(out + data_space);
+    guint i;
+
+    rec->size = total;
+    rec->dir = dir;
+    rec->pointer_size = io->pointer_size;
+    rec->usec = g_get_monotonic_time();
+    rec->handle = handle;
+    rec->code = code;
+    rec->flags = flags;
+    rec->data_size = size;
+    rec->offsets_count = count;
+    memcpy(out, data, size);
+
+    /* Keep the object type and flags, zero everything else */
+    for (i = 0; i < count; i++) {
+        const gsize off = offsets ? (gsize)offsets[i] :
+            (gsize)((const guint8*)objects[i] - data);
+
+        out_offsets[i] = off;
+        if (off + GBINDER_CAPTURE_OBJECT_HEADER_SIZE <= size) {
+            gsize objsize = GBINDER_IO_CALL(io, object_size)(out + off);
+
+            objsize = MIN(objsize, size - off);
+            if (objsize > GBINDER_CAPTURE_OBJECT_HEADER_SIZE) {
+                memset(out + off + GBINDER_CAPTURE_OBJECT_HEADER_SIZE, 0,
+                    objsize - GBINDER_CAPTURE_OBJECT_HEADER_SIZE);
+            }
+        }
+    }
+    gbinder_capture_add(g_bytes_new_take(rec, total));
+}
+
+/*==========================================================================*
+ * Internal interface
+ *==========================================================================*/
+
+void
+gbinder_capture_outgoing(
+    const GBinderIo* io,
+    guint32 handle,
+    guint32 code,
+    guint32 flags,
+    const GByteArray* bytes,
+    const GUtilIntArray* offsets)
+{
+    gbinder_capture_record(io, GBINDER_CAPTURE_OUTGOING, handle, code, flags,
+        bytes->data, bytes->len, offsets ? offsets->data : NULL, NULL,
+        offsets ? offsets->count : 0);
+}
+
+void
+gbinder_capture_incoming(
+    const GBinderIo* io,
+    guint32 code,
+    guint32 flags,
+    const void* data,
+    gsize size,
+    void** objects)
+{
+    guint count = 0;
+
+    if (objects) {
+        while (objects[count]) count++;
+    }
+    gbinder_capture_record(io, GBINDER_CAPTURE_INCOMING, 0, code, flags,
+        data, size, NULL, objects, count);
+}
+
+/*==========================================================================*
+ * Interface
+ *==========================================================================*/
+
+gboolean
+gbinder_capture_start_file(
+    const char* path) /* Since 1.1.25 */
+{
+    gboolean ok = FALSE;
+
+    if (G_LIKELY(path)) {
+        FILE* f = fopen(path, "wb");
+
+        if (f) {
+            if (fwrite(GBINDER_CAPTURE_MAGIC, GBINDER_CAPTURE_MAGIC_SIZE, 1,
+                f) == 1) {
+                /* Lock */
+                g_mutex_lock(&gbinder_capture_mutex);
+                g_bytes_unref(gbinder_capture_stop_locked());
+                gbinder_capture_file = f;
+                g_atomic_int_set(&gbinder_capture_on, TRUE);
+                g_mutex_unlock(&gbinder_capture_mutex);
+                /* Unlock */
+                ok = TRUE;
+            } else {
+                fclose(f);
+            }
+        }
+        if (!ok) {
+            GWARN("Can't capture to %s: %s", path, strerror(errno));
+        }
+    }
+    return ok;
+}
+
+gboolean
+gbinder_capture_start_ring(
+    gsize max_bytes) /* Since 1.1.25 */
+{
+    if (max_bytes) {
+        /* Lock */
+        g_mutex_lock(&gbinder_capture_mutex);
+        g_bytes_unref(gbinder_capture_stop_locked());
+        gbinder_capture_ring_max = max_bytes;
+        g_atomic_int_set(&gbinder_capture_on, TRUE);
+        g_mutex_unlock(&gbinder_capture_mutex);
+        /* Unlock */
+        return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean
+gbinder_capture_active(
+    void) /* Since 1.1.25 */
+{
+    return g_atomic_int_get(&gbinder_capture_on);
+}
+
+GBytes*
+gbinder_capture_stop(
+    void) /* Since 1.1.25 */
+{
+    GBytes* out;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_capture_mutex);
+    out = gbinder_capture_stop_locked();
+    g_mutex_unlock(&gbinder_capture_mutex);
+    /* Unlock */
+    return out;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -38,42 +38,77 @@ typedef struct gbinder_cleanup_item {
 } GBinderCleanupItem;
 
 /*
- * This is basically a GArray providing better type safety at compile time.
+ * Most transactions only need a handful of entries, those fit into the
+ * object itself. The rest go to the overflow chunks which are allocated
+ * on demand and, like the object, survive gbinder_cleanup_reset() so that
+ * a recycled cleanup doesn't allocate anything at all.
  */
+#define GBINDER_CLEANUP_INLINE_ITEMS (8)
+#define GBINDER_CLEANUP_CHUNK_ITEMS (32)
+
+typedef struct gbinder_cleanup_chunk GBinderCleanupChunk;
+struct gbinder_cleanup_chunk {
+    GBinderCleanupChunk* next;
+    GBinderCleanupItem items[GBINDER_CLEANUP_CHUNK_ITEMS];
+};
+
 struct gbinder_cleanup {
-    GBinderCleanupItem* items;
     guint count;
+    GBinderCleanupChunk* chunks;
+    GBinderCleanupChunk* tail;  /* The chunk being filled */
+    GBinderCleanupItem items[GBINDER_CLEANUP_INLINE_ITEMS];
 };
 
-G_STATIC_ASSERT(sizeof(GBinderCleanup) == sizeof(GArray));
-#define ELEMENT_SIZE (sizeof(GBinderCleanupItem))
-
 static
 void
-gbinder_cleanup_destroy_func(
-    gpointer data)
+gbinder_cleanup_run(
+    const GBinderCleanupItem* items,
+    guint n)
 {
-    GBinderCleanupItem* item = data;
+    guint i = 0;
+
+    /* Runs of the same function (e.g. a bunch of unrefs) go in one loop */
+    while (i < n) {
+        const GDestroyNotify destroy = items[i].destroy;
 
-    item->destroy(item->pointer);
+        do {
+            destroy(items[i].pointer);
+        } while (++i < n && items[i].destroy == destroy);
+    }
 }
 
 static
-GBinderCleanup*
-gbinder_cleanup_new()
+void
+gbinder_cleanup_run_all(
+    GBinderCleanup* self)
 {
-    GArray* array = g_array_sized_new(FALSE, FALSE, ELEMENT_SIZE, 0);
+    const guint count = self->count;
+
+    /* Same order in which the entries were added */
+    self->count = 0;
+    self->tail = NULL;
+    gbinder_cleanup_run(self->items, MIN(count,
+        GBINDER_CLEANUP_INLINE_ITEMS));
+    if (count > GBINDER_CLEANUP_INLINE_ITEMS) {
+        guint left = count - GBINDER_CLEANUP_INLINE_ITEMS;
+        GBinderCleanupChunk* chunk = self->chunks;
 
-    g_array_set_clear_func(array, gbinder_cleanup_destroy_func);
-    return (GBinderCleanup*)array;
+        while (left > 0) {
+            const guint n = MIN(left, GBINDER_CLEANUP_CHUNK_ITEMS);
+
+            gbinder_cleanup_run(chunk->items, n);
+            chunk = chunk->next;
+            left -= n;
+        }
+    }
 }
 
 void
 gbinder_cleanup_reset(
     GBinderCleanup* self)
 {
-    if (G_LIKELY(self)) {
-        g_array_set_size((GArray*)self, 0);
+    if (G_LIKELY(self) && self->count) {
+        gbinder_cleanup_run_all(self);
     }
 }
 
@@ -82,7 +117,16 @@ gbinder_cleanup_free(
     GBinderCleanup* self)
 {
     if (G_LIKELY(self)) {
-        g_array_free((GArray*)self, TRUE);
+        GBinderCleanupChunk* chunk = self->chunks;
+
+        gbinder_cleanup_run_all(self);
+        while (chunk) {
+            GBinderCleanupChunk* next = chunk->next;
+
+            g_slice_free(GBinderCleanupChunk, chunk);
+            chunk = next;
+        }
+        g_slice_free(GBinderCleanup, self);
     }
 }
 
@@ -93,14 +137,38 @@ gbinder_cleanup_add(
     gpointer pointer)
 {
     if (G_LIKELY(destroy)) {
-        GBinderCleanupItem item;
+        GBinderCleanupItem* item;
 
-        item.destroy = destroy;
-        item.pointer = pointer;
         if (!self) {
-            self = gbinder_cleanup_new();
+            self = g_slice_new0(GBinderCleanup);
+        }
+        if (self->count < GBINDER_CLEANUP_INLINE_ITEMS) {
+            item = self->items + self->count;
+        } else {
+            const guint i = (self->count - GBINDER_CLEANUP_INLINE_ITEMS) %
+                GBINDER_CLEANUP_CHUNK_ITEMS;
+
+            if (!i) {
+                /* Move on to the next chunk, reusing the old ones */
+                GBinderCleanupChunk* next = self->tail ? self->tail->next :
+                    self->chunks;
+
+                if (!next) {
+                    next = g_slice_new(GBinderCleanupChunk);
+                    next->next = NULL;
+                    if (self->tail) {
+                        self->tail->next = next;
+                    } else {
+                        self->chunks = next;
+                    }
+                }
+                self->tail = next;
+            }
+            item = self->tail->items + i;
         }
-        g_array_append_vals((GArray*)self, (void*)&item, 1);
+        item->destroy = destroy;
+        item->pointer = pointer;
+        self->count++;
     }
     return self;
 }
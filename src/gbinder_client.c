@@ -31,41 +31,177 @@
  */
 
 #include "gbinder_client_p.h"
+#include "gbinder_buffer_p.h"
 #include "gbinder_driver.h"
+#include "gbinder_eventloop_p.h"
+#include "gbinder_fmq_p.h"
 #include "gbinder_ipc.h"
+#include "gbinder_local_object.h"
 #include "gbinder_output_data.h"
 #include "gbinder_remote_object_p.h"
 #include "gbinder_local_reply_p.h"
 #include "gbinder_local_request_p.h"
+#include "gbinder_reader.h"
+#include "gbinder_remote_reply_p.h"
+#include "gbinder_writer.h"
 #include "gbinder_log.h"
 
 #include <gutil_macros.h>
+#include <gutil_misc.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <limits.h>
 
 typedef struct gbinder_client_iface_range {
-    char* iface;
+    const char* iface; /* Interned */
     GBytes* rpc_header;
+    gsize rpc_header_size;
     GBinderLocalRequest* basic_req;
     guint32 last_code;
 } GBinderClientIfaceRange;
 
+/*
+ * Interface descriptors are shared by all clients created for the same
+ * list of interfaces and the same flavor of binder (i/o and RPC protocol),
+ * so that creating yet another client for a known interface doesn't
+ * have to build the RPC headers and the basic requests again.
+ */
+typedef struct gbinder_client_ifaces_key {
+    const GBinderIo* io;
+    const GBinderRpcProtocol* protocol;
+    const GBinderClientIfaceInfo* info;
+    guint count;
+} GBinderClientIfacesKey;
+
+typedef struct gbinder_client_ifaces {
+    GBinderClientIfacesKey key; /* Must be first */
+    guint refcount; /* Protected by gbinder_client_ifaces_mutex */
+    GBinderClientIfaceRange* ranges; /* Sorted by last_code */
+    guint nr;
+} GBinderClientIfaces;
+
+static GMutex gbinder_client_ifaces_mutex;
+static GHashTable* gbinder_client_ifaces_table = NULL;
+
+/* Chunked transfers are identified by sender pid and this id */
+static gint gbinder_client_chunk_id = 0;
+
+typedef struct gbinder_client_ordered GBinderClientOrdered;
+
 typedef struct gbinder_client_priv {
     GBinderClient pub;
     guint32 refcount;
-    GBinderClientIfaceRange* ranges;
+    GBinderClientIfaces* ifaces;
+    const GBinderClientIfaceRange* ranges; /* Points to ifaces->ranges */
     guint nr;
+    gint adaptive;
+    GMutex sizes_mutex;
+    GHashTable* sizes; /* code => size of the last request */
+    guint max_in_flight; /* Zero if unlimited */
+    guint max_queued;
+    guint in_flight;
+    GQueue queue; /* Ids of the deferred transactions */
+    GMutex coalesce_mutex;
+    GHashTable* coalesce; /* code => queued GBinderClientCoalesced or NULL */
+    guint timeout_ms; /* Default for async transactions, zero if none */
+    GMutex fmq_mutex; /* Serializes the writers */
+    GBinderFmq* fmq; /* See gbinder_client_open_fmq_channel */
+    GBinderLocalObject* fmq_token; /* Closes the channel when we die */
+    guint32 chunk_code;
+    gsize chunk_size; /* Zero if chunking is disabled */
+    GMutex flight_mutex;
+    GCond flight_cond;
+    GHashTable* flight_codes; /* Single-flight codes, NULL if none */
+    GHashTable* flights; /* GBytes => GBinderClientFlight */
+    GMutex cache_mutex;
+    GHashTable* cache_ttl; /* code => ttl_ms, NULL if nothing is cached */
+    GHashTable* cache; /* GBytes => GBinderClientCached */
+    gulong cache_death_id;
+    guint32 lane; /* GBINDER_TX_FLAG_REALTIME or GBINDER_TX_FLAG_BACKGROUND */
+    gboolean ordered;
+    GMutex ordered_mutex;
+    GQueue ordered_queue; /* Calls waiting to be executed */
+    GQueue ordered_done; /* Executed calls waiting to be delivered */
+    GBinderClientOrdered* ordered_current; /* Being executed */
+    gboolean ordered_busy; /* There's a worker draining the queue */
 } GBinderClientPriv;
 
+#define GBINDER_CLIENT_LANE_FLAGS \
+    (GBINDER_TX_FLAG_REALTIME | GBINDER_TX_FLAG_BACKGROUND)
+
+/* Per client, only replies which have no objects are cached */
+#define GBINDER_CLIENT_CACHE_MAX_ENTRIES (64)
+
+typedef struct gbinder_client_flight {
+    int refcount; /* Protected by flight_mutex */
+    GThread* leader;
+    const GBinderIpcSyncApi* api; /* Used by the leader */
+    gboolean done;
+    gboolean retry; /* The reply carries objects, can't be shared */
+    int status;
+    GBinderRemoteReply* reply;
+} GBinderClientFlight;
+
+typedef struct gbinder_client_cached {
+    GBinderRemoteReply* reply;
+    gint64 expires; /* Monotonic time */
+} GBinderClientCached;
+
+typedef struct gbinder_client_coalesced {
+    GBinderClient* client;
+    gulong id;
+    guint32 code;
+    gboolean started;
+    int status;
+    GBinderLocalRequest* req;
+    GBinderClientReplyFunc reply;
+    GDestroyNotify destroy;
+    void* user_data;
+} GBinderClientCoalesced;
+
+struct gbinder_client_ordered {
+    GBinderClient* client;
+    gulong id;
+    guint32 code;
+    guint32 flags;
+    gboolean cancelled;
+    int status;
+    GBinderLocalRequest* req;
+    GBinderRemoteReply* result;
+    GBinderClientReplyFunc reply;
+    GDestroyNotify destroy;
+    void* user_data;
+};
+
 typedef struct gbinder_client_tx {
     GBinderClient* client;
     GBinderClientReplyFunc reply;
     GDestroyNotify destroy;
     void* user_data;
+    gboolean limited;
 } GBinderClientTx;
 
+typedef struct gbinder_client_batch {
+    GBinderClient* client;
+    GBinderClientBatchTx* txs;
+    GBinderRemoteReply** replies;
+    int* status;
+    guint count;
+    GBinderClientBatchReplyFunc reply;
+    GDestroyNotify destroy;
+    void* user_data;
+} GBinderClientBatch;
+
+typedef struct gbinder_client_broadcast {
+    GBinderClient** clients;
+    guint count;
+    GBinderClientBroadcastFunc func;
+    GDestroyNotify destroy;
+    void* user_data;
+} GBinderClientBroadcast;
+
 static inline GBinderClientPriv* gbinder_client_cast(GBinderClient* client)
     { return G_CAST(client, GBinderClientPriv, pub); }
 
@@ -79,16 +215,20 @@ gbinder_client_find_range(
     GBinderClientPriv* priv,
     guint32 code)
 {
-    guint i;
+    const GBinderClientIfaceRange* ranges = priv->ranges;
+    guint lo = 0, hi = priv->nr;
 
-    for (i = 0; i < priv->nr; i++) {
-        const GBinderClientIfaceRange* r = priv->ranges + i;
+    /* Ranges are sorted by last_code, find the first one covering code */
+    while (lo < hi) {
+        const guint mid = lo + (hi - lo) / 2;
 
-        if (r->last_code >= code) {
-            return r;
+        if (ranges[mid].last_code < code) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
-    return NULL;
+    return (lo < priv->nr) ? (ranges + lo) : NULL;
 }
 
 /*
@@ -102,15 +242,18 @@ static
 void
 gbinder_client_init_range(
     GBinderClientIfaceRange* r,
-    GBinderDriver* driver,
+    const GBinderIo* io,
+    const GBinderRpcProtocol* protocol,
     const GBinderClientIfaceInfo* info)
 {
     GBinderOutputData* hdr;
 
-    r->basic_req = gbinder_driver_local_request_new(driver, info->iface);
+    r->basic_req = gbinder_local_request_new_iface(io, protocol, info->iface);
     hdr = gbinder_local_request_data(r->basic_req);
     r->rpc_header = g_bytes_new(hdr->bytes->data, hdr->bytes->len);
-    r->iface = g_strdup(info->iface);
+    r->rpc_header_size = hdr->bytes->len;
+    r->iface = info->iface;
+    gbinder_local_request_set_iface(r->basic_req, r->iface);
     r->last_code = info->last_code;
 }
 
@@ -127,28 +270,248 @@ gbinder_client_sort_ranges(
         (r1->last_code > r2->last_code) ? 1 : 0;
 }
 
+static
+guint
+gbinder_client_ifaces_hash(
+    gconstpointer key)
+{
+    const GBinderClientIfacesKey* k = key;
+    guint i, h = GPOINTER_TO_UINT(k->io) * 31 +
+        GPOINTER_TO_UINT(k->protocol);
+
+    for (i = 0; i < k->count; i++) {
+        const GBinderClientIfaceInfo* info = k->info + i;
+
+        h = h * 31 + (info->iface ? g_str_hash(info->iface) : 0);
+        h = h * 31 + info->last_code;
+    }
+    return h;
+}
+
+static
+gboolean
+gbinder_client_ifaces_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const GBinderClientIfacesKey* k1 = a;
+    const GBinderClientIfacesKey* k2 = b;
+
+    if (k1->io == k2->io && k1->protocol == k2->protocol &&
+        k1->count == k2->count) {
+        guint i;
+
+        for (i = 0; i < k1->count; i++) {
+            const GBinderClientIfaceInfo* i1 = k1->info + i;
+            const GBinderClientIfaceInfo* i2 = k2->info + i;
+
+            if (i1->last_code != i2->last_code ||
+                g_strcmp0(i1->iface, i2->iface)) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+GBinderClientIfaces*
+gbinder_client_ifaces_create(
+    const GBinderClientIfacesKey* key)
+{
+    GBinderClientIfaces* self = g_slice_new0(GBinderClientIfaces);
+    const guint count = key->count;
+    GBinderClientIfaceInfo* info = g_new(GBinderClientIfaceInfo, count + 1);
+    guint i;
+
+    /* The key keeps its own copy of the (interned) interface names */
+    for (i = 0; i < count; i++) {
+        info[i].iface = g_intern_string(key->info[i].iface);
+        info[i].last_code = key->info[i].last_code;
+    }
+    self->key.io = key->io;
+    self->key.protocol = key->protocol;
+    self->key.info = info;
+    self->key.count = count;
+    self->refcount = 1;
+    if (count > 0) {
+        self->nr = count;
+        self->ranges = g_new(GBinderClientIfaceRange, count);
+        for (i = 0; i < count; i++) {
+            gbinder_client_init_range(self->ranges + i, key->io,
+                key->protocol, info + i);
+        }
+        qsort(self->ranges, count, sizeof(GBinderClientIfaceRange),
+            gbinder_client_sort_ranges);
+    } else {
+        /* No interface info */
+        self->nr = 1;
+        self->ranges = g_new0(GBinderClientIfaceRange, 1);
+        self->ranges[0].last_code = UINT_MAX;
+        self->ranges[0].basic_req = gbinder_local_request_new(key->io, NULL);
+    }
+    return self;
+}
+
 static
 void
-gbinder_client_free(
-    GBinderClientPriv* priv)
+gbinder_client_ifaces_free(
+    GBinderClientIfaces* self)
 {
-    GBinderClient* self = &priv->pub;
     guint i;
 
-    for (i = 0; i < priv->nr; i++) {
-        GBinderClientIfaceRange* r = priv->ranges + i;
+    for (i = 0; i < self->nr; i++) {
+        GBinderClientIfaceRange* r = self->ranges + i;
 
         gbinder_local_request_unref(r->basic_req);
-        g_free(r->iface);
         if (r->rpc_header) {
             g_bytes_unref(r->rpc_header);
         }
     }
-    g_free(priv->ranges);
+    g_free(self->ranges);
+    g_free((GBinderClientIfaceInfo*)self->key.info);
+    g_slice_free(GBinderClientIfaces, self);
+}
+
+static
+GBinderClientIfaces*
+gbinder_client_ifaces_get(
+    GBinderDriver* driver,
+    const GBinderClientIfaceInfo* info,
+    gsize count)
+{
+    GBinderClientIfaces* self = NULL;
+    GBinderClientIfacesKey key;
+
+    key.io = gbinder_driver_io(driver);
+    key.protocol = gbinder_driver_protocol(driver);
+    key.info = info;
+    key.count = count;
+
+    g_mutex_lock(&gbinder_client_ifaces_mutex);
+    if (gbinder_client_ifaces_table) {
+        self = g_hash_table_lookup(gbinder_client_ifaces_table, &key);
+    } else {
+        gbinder_client_ifaces_table = g_hash_table_new
+            (gbinder_client_ifaces_hash, gbinder_client_ifaces_equal);
+    }
+    if (self) {
+        self->refcount++;
+    } else {
+        self = gbinder_client_ifaces_create(&key);
+        g_hash_table_insert(gbinder_client_ifaces_table, &self->key, self);
+    }
+    g_mutex_unlock(&gbinder_client_ifaces_mutex);
+    return self;
+}
+
+static
+void
+gbinder_client_ifaces_unref(
+    GBinderClientIfaces* self)
+{
+    gboolean last;
+
+    g_mutex_lock(&gbinder_client_ifaces_mutex);
+    GASSERT(self->refcount > 0);
+    last = !--(self->refcount);
+    if (last) {
+        g_hash_table_remove(gbinder_client_ifaces_table, &self->key);
+        if (!g_hash_table_size(gbinder_client_ifaces_table)) {
+            g_hash_table_destroy(gbinder_client_ifaces_table);
+            gbinder_client_ifaces_table = NULL;
+        }
+    }
+    g_mutex_unlock(&gbinder_client_ifaces_mutex);
+    if (last) {
+        gbinder_client_ifaces_free(self);
+    }
+}
+
+static
+void
+gbinder_client_free(
+    GBinderClientPriv* priv)
+{
+    GBinderClient* self = &priv->pub;
+
+    gbinder_client_ifaces_unref(priv->ifaces);
+    if (priv->sizes) {
+        g_hash_table_destroy(priv->sizes);
+    }
+    g_mutex_clear(&priv->sizes_mutex);
+    if (priv->coalesce) {
+        g_hash_table_destroy(priv->coalesce);
+    }
+    g_mutex_clear(&priv->coalesce_mutex);
+    g_mutex_clear(&priv->fmq_mutex);
+#if GBINDER_FMQ_SUPPORTED
+    gbinder_fmq_unref(priv->fmq);
+#endif
+    gbinder_local_object_drop(priv->fmq_token);
+    if (priv->flight_codes) {
+        g_hash_table_destroy(priv->flight_codes);
+        g_hash_table_destroy(priv->flights);
+    }
+    g_mutex_clear(&priv->flight_mutex);
+    g_cond_clear(&priv->flight_cond);
+    if (priv->cache_ttl) {
+        g_hash_table_destroy(priv->cache_ttl);
+        g_hash_table_destroy(priv->cache);
+    }
+    g_mutex_clear(&priv->cache_mutex);
+    g_mutex_clear(&priv->ordered_mutex);
+    gbinder_remote_object_remove_handler(self->remote, priv->cache_death_id);
     gbinder_remote_object_unref(self->remote);
     g_slice_free(GBinderClientPriv, priv);
 }
 
+static
+void
+gbinder_client_remember_size(
+    GBinderClient* self,
+    guint32 code,
+    GBinderLocalRequest* req)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+
+    if (g_atomic_int_get(&priv->adaptive)) {
+        const guint size = gbinder_local_request_data(req)->bytes->len;
+
+        /* Lock */
+        g_mutex_lock(&priv->sizes_mutex);
+        if (!priv->sizes) {
+            priv->sizes = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        g_hash_table_insert(priv->sizes, GUINT_TO_POINTER(code),
+            GUINT_TO_POINTER(size));
+        g_mutex_unlock(&priv->sizes_mutex);
+        /* Unlock */
+    }
+}
+
+static
+gsize
+gbinder_client_size_hint(
+    GBinderClientPriv* priv,
+    guint32 code)
+{
+    gsize size = 0;
+
+    if (g_atomic_int_get(&priv->adaptive)) {
+        /* Lock */
+        g_mutex_lock(&priv->sizes_mutex);
+        if (priv->sizes) {
+            size = GPOINTER_TO_UINT(g_hash_table_lookup(priv->sizes,
+                GUINT_TO_POINTER(code)));
+        }
+        g_mutex_unlock(&priv->sizes_mutex);
+        /* Unlock */
+    }
+    return size;
+}
+
 static
 void
 gbinder_client_transact_reply(
@@ -171,6 +534,19 @@ gbinder_client_transact_destroy(
 {
     GBinderClientTx* tx = data;
 
+    if (tx->limited) {
+        GBinderClientPriv* priv = gbinder_client_cast(tx->client);
+
+        /* Free slot, start the next queued transaction */
+        priv->in_flight--;
+        if (!g_queue_is_empty(&priv->queue)) {
+            GBinderRemoteObject* obj = tx->client->remote;
+
+            priv->in_flight++;
+            gbinder_ipc_transact_start(obj->ipc,
+                GPOINTER_TO_SIZE(g_queue_pop_head(&priv->queue)));
+        }
+    }
     if (tx->destroy) {
         tx->destroy(tx->user_data);
     }
@@ -178,6 +554,938 @@ gbinder_client_transact_destroy(
     g_slice_free(GBinderClientTx, tx);
 }
 
+static
+gulong
+gbinder_client_transact_submit(
+    GBinderClient* self,
+    GBinderClientTx* tx,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    guint timeout_ms,
+    gboolean start)
+{
+    GBinderRemoteObject* obj = self->remote;
+    GBinderIpc* ipc = obj->ipc;
+    gulong id;
+
+    if ((flags & (GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT)) ==
+        (GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT)) {
+        /* Written right away, no timeouts or queueing */
+        return gbinder_ipc_transact(ipc, obj->handle, code, flags, req,
+            gbinder_client_transact_reply, gbinder_client_transact_destroy,
+            tx);
+    } else if (start && !timeout_ms) {
+        return gbinder_ipc_transact(ipc, obj->handle, code, flags, req,
+            gbinder_client_transact_reply, gbinder_client_transact_destroy,
+            tx);
+    }
+
+    /* The deadline starts ticking before the transaction is queued */
+    id = gbinder_ipc_transact_deferred(ipc, obj->handle, code, flags, req,
+        gbinder_client_transact_reply, gbinder_client_transact_destroy, tx);
+    gbinder_ipc_transact_set_timeout(ipc, id, timeout_ms);
+    if (start) {
+        gbinder_ipc_transact_start(ipc, id);
+    }
+    return id;
+}
+
+static
+gulong
+gbinder_client_transact_limited(
+    GBinderClient* self,
+    GBinderClientTx* tx,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    guint timeout_ms)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    gulong id;
+
+    if (priv->in_flight < priv->max_in_flight) {
+        id = gbinder_client_transact_submit(self, tx, code, flags, req,
+            timeout_ms, TRUE);
+        if (id) {
+            tx->limited = TRUE;
+            priv->in_flight++;
+        }
+    } else if (priv->queue.length < priv->max_queued) {
+        id = gbinder_client_transact_submit(self, tx, code, flags, req,
+            timeout_ms, FALSE);
+        if (id) {
+            /* Counted as in flight when started */
+            tx->limited = TRUE;
+            g_queue_push_tail(&priv->queue, GSIZE_TO_POINTER(id));
+        }
+    } else {
+        /* Would block */
+        GDEBUG("Too many pending transactions (%u + %u)", priv->in_flight,
+            priv->queue.length);
+        gbinder_client_unref(tx->client);
+        g_slice_free(GBinderClientTx, tx);
+        id = 0;
+    }
+    return id;
+}
+
+/*
+ * Coalesced one-way transactions. While the transaction is waiting in
+ * the queue, newer requests with the same code simply replace the one
+ * which is going to be sent. Only the callbacks of the latest caller
+ * are kept, the superseded caller's destroy notification is invoked
+ * right away.
+ */
+
+static
+void
+gbinder_client_coalesced_detach(
+    GBinderClientCoalesced* call)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(call->client);
+    gpointer key = GUINT_TO_POINTER(call->code);
+
+    /* Caller holds coalesce_mutex */
+    if (priv->coalesce &&
+        g_hash_table_lookup(priv->coalesce, key) == call) {
+        g_hash_table_insert(priv->coalesce, key, NULL);
+    }
+}
+
+/* Invoked on a thread from the tx pool */
+static
+void
+gbinder_client_coalesced_exec(
+    const GBinderIpcTx* tx)
+{
+    GBinderClientCoalesced* call = tx->user_data;
+    GBinderClientPriv* priv = gbinder_client_cast(call->client);
+    GBinderLocalRequest* req;
+
+    /* Lock */
+    g_mutex_lock(&priv->coalesce_mutex);
+    call->started = TRUE;
+    gbinder_client_coalesced_detach(call);
+    req = gbinder_local_request_ref(call->req);
+    g_mutex_unlock(&priv->coalesce_mutex);
+    /* Unlock */
+
+    call->status = gbinder_client_transact_sync_oneway2(call->client,
+        call->code, req, &gbinder_ipc_sync_worker);
+    gbinder_local_request_unref(req);
+}
+
+static
+void
+gbinder_client_coalesced_done(
+    const GBinderIpcTx* tx)
+{
+    GBinderClientCoalesced* call = tx->user_data;
+
+    if (call->reply) {
+        call->reply(call->client, NULL, call->status, call->user_data);
+    }
+}
+
+static
+void
+gbinder_client_coalesced_free(
+    gpointer data)
+{
+    GBinderClientCoalesced* call = data;
+    GBinderClientPriv* priv = gbinder_client_cast(call->client);
+
+    /* In case if it has been cancelled */
+    /* Lock */
+    g_mutex_lock(&priv->coalesce_mutex);
+    gbinder_client_coalesced_detach(call);
+    g_mutex_unlock(&priv->coalesce_mutex);
+    /* Unlock */
+
+    if (call->destroy) {
+        call->destroy(call->user_data);
+    }
+    gbinder_local_request_unref(call->req);
+    gbinder_client_unref(call->client);
+    g_slice_free(GBinderClientCoalesced, call);
+}
+
+static
+gulong
+gbinder_client_transact_coalesced(
+    GBinderClient* self,
+    guint32 code,
+    GBinderLocalRequest* req,
+    GBinderClientReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    gpointer key = GUINT_TO_POINTER(code);
+    GBinderClientCoalesced* call;
+    GBinderLocalRequest* old_req = NULL;
+    GDestroyNotify old_destroy = NULL;
+    void* old_user_data = NULL;
+    gboolean enabled;
+    gulong id = 0;
+
+    /* Lock */
+    g_mutex_lock(&priv->coalesce_mutex);
+    enabled = g_hash_table_lookup_extended(priv->coalesce, key, NULL,
+        (gpointer*) &call);
+    if (call) {
+        /* Still queued, replace the request */
+        GASSERT(!call->started);
+        old_req = call->req;
+        old_destroy = call->destroy;
+        old_user_data = call->user_data;
+        call->req = gbinder_local_request_ref(req);
+        call->reply = reply;
+        call->destroy = destroy;
+        call->user_data = user_data;
+        id = call->id;
+    }
+    g_mutex_unlock(&priv->coalesce_mutex);
+    /* Unlock */
+
+    if (!enabled) {
+        /* Not coalesced */
+        return 0;
+    } else if (id) {
+        GVERBOSE_("tx %lu code %u superseded", id, code);
+        gbinder_local_request_unref(old_req);
+        if (old_destroy) {
+            old_destroy(old_user_data);
+        }
+    } else {
+        call = g_slice_new0(GBinderClientCoalesced);
+        call->client = gbinder_client_ref(self);
+        call->code = code;
+        call->req = gbinder_local_request_ref(req);
+        call->reply = reply;
+        call->destroy = destroy;
+        call->user_data = user_data;
+
+        /* Transactions are submitted on the main thread, no race here */
+        id = call->id = gbinder_ipc_transact_custom(self->remote->ipc,
+            gbinder_client_coalesced_exec, gbinder_client_coalesced_done,
+            gbinder_client_coalesced_free, call);
+
+        /* Lock */
+        g_mutex_lock(&priv->coalesce_mutex);
+        if (!call->started) {
+            g_hash_table_insert(priv->coalesce, key, call);
+        }
+        g_mutex_unlock(&priv->coalesce_mutex);
+        /* Unlock */
+    }
+    return id;
+}
+
+/* Invoked on a thread from the tx pool */
+static
+void
+gbinder_client_batch_exec(
+    const GBinderIpcTx* tx)
+{
+    GBinderClientBatch* batch = tx->user_data;
+    guint i;
+
+    for (i = 0; i < batch->count; i++) {
+        const GBinderClientBatchTx* btx = batch->txs + i;
+
+        if (tx->cancelled) {
+            GVERBOSE_("batch %lu cancelled at %u", tx->id, i);
+            break;
+        }
+        if (btx->flags & GBINDER_TX_FLAG_ONEWAY) {
+            batch->status[i] = gbinder_client_transact_sync_oneway2
+                (batch->client, btx->code, btx->req, &gbinder_ipc_sync_worker);
+        } else {
+            batch->status[i] = (-EFAULT);
+            batch->replies[i] = gbinder_client_transact_sync_reply2
+                (batch->client, btx->code, btx->req, batch->status + i,
+                    &gbinder_ipc_sync_worker);
+        }
+        if (batch->status[i] != GBINDER_STATUS_OK) {
+            /* The rest of the batch most likely depends on this one */
+            GDEBUG("Batch transaction %u (code %u) failed (%d)", i,
+                btx->code, batch->status[i]);
+            break;
+        }
+    }
+}
+
+static
+void
+gbinder_client_batch_done(
+    const GBinderIpcTx* tx)
+{
+    GBinderClientBatch* batch = tx->user_data;
+
+    if (batch->reply) {
+        batch->reply(batch->client, batch->replies, batch->status,
+            batch->count, batch->user_data);
+    }
+}
+
+static
+void
+gbinder_client_batch_free(
+    gpointer data)
+{
+    GBinderClientBatch* batch = data;
+    guint i;
+
+    if (batch->destroy) {
+        batch->destroy(batch->user_data);
+    }
+    for (i = 0; i < batch->count; i++) {
+        gbinder_local_request_unref(batch->txs[i].req);
+        gbinder_remote_reply_unref(batch->replies[i]);
+    }
+    gbinder_client_unref(batch->client);
+    g_free(batch->txs);
+    g_free(batch->replies);
+    g_free(batch->status);
+    g_slice_free(GBinderClientBatch, batch);
+}
+
+/*
+ * Ordered transactions. The calls are queued in the order of submission
+ * and a single worker executes them back to back, until the queue runs
+ * empty. The results are delivered to the main thread in the same order.
+ */
+
+static
+void
+gbinder_client_ordered_free(
+    GBinderClientOrdered* call)
+{
+    if (call->destroy) {
+        call->destroy(call->user_data);
+    }
+    gbinder_local_request_unref(call->req);
+    gbinder_remote_reply_unref(call->result);
+    gbinder_client_unref(call->client);
+    g_slice_free(GBinderClientOrdered, call);
+}
+
+/* Invoked on the main thread */
+static
+void
+gbinder_client_ordered_deliver(
+    gpointer data)
+{
+    GBinderClient* self = data;
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    GBinderClientOrdered* call;
+
+    do {
+        /* Lock */
+        g_mutex_lock(&priv->ordered_mutex);
+        call = g_queue_pop_head(&priv->ordered_done);
+        g_mutex_unlock(&priv->ordered_mutex);
+        /* Unlock */
+
+        if (call) {
+            if (!call->cancelled && call->reply) {
+                call->reply(self, call->result, call->status,
+                    call->user_data);
+            }
+            gbinder_client_ordered_free(call);
+        }
+    } while (call);
+}
+
+static
+void
+gbinder_client_ordered_done(
+    GBinderClient* self,
+    GBinderClientOrdered* call)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+
+    /* Lock */
+    g_mutex_lock(&priv->ordered_mutex);
+    if (priv->ordered_current == call) {
+        priv->ordered_current = NULL;
+    }
+    g_queue_push_tail(&priv->ordered_done, call);
+    g_mutex_unlock(&priv->ordered_mutex);
+    /* Unlock */
+
+    /* Whichever callback runs first delivers everything that's done */
+    gbinder_idle_callback_invoke_later_in(gbinder_client_ordered_deliver,
+        gbinder_client_ref(self), (GDestroyNotify) gbinder_client_unref,
+        gbinder_ipc_main_context(self->remote->ipc));
+}
+
+/* Invoked on a thread from the tx pool */
+static
+void
+gbinder_client_ordered_exec(
+    const GBinderIpcTx* tx)
+{
+    GBinderClient* self = tx->user_data;
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    GBinderClientOrdered* call;
+
+    do {
+        /* Lock */
+        g_mutex_lock(&priv->ordered_mutex);
+        call = priv->ordered_current = g_queue_pop_head(&priv->ordered_queue);
+        if (!call) {
+            /* The next call will have to submit a new worker */
+            priv->ordered_busy = FALSE;
+        }
+        g_mutex_unlock(&priv->ordered_mutex);
+        /* Unlock */
+
+        if (call) {
+            if (call->flags & GBINDER_TX_FLAG_ONEWAY) {
+                call->status = gbinder_client_transact_sync_oneway2(self,
+                    call->code, call->req, &gbinder_ipc_sync_worker);
+            } else {
+                call->result = gbinder_client_transact_sync_reply2(self,
+                    call->code, call->req, &call->status,
+                    &gbinder_ipc_sync_worker);
+            }
+            gbinder_client_ordered_done(self, call);
+        }
+    } while (call);
+}
+
+static
+gulong
+gbinder_client_transact_ordered(
+    GBinderClient* self,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    GBinderClientReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    GBinderIpc* ipc = self->remote->ipc;
+    GBinderClientOrdered* call = g_slice_new0(GBinderClientOrdered);
+    const gulong id = gbinder_ipc_new_id(ipc);
+    gboolean submit;
+
+    call->client = gbinder_client_ref(self);
+    call->id = id;
+    call->code = code;
+    call->flags = flags;
+    call->status = (-EFAULT);
+    call->req = gbinder_local_request_ref(req);
+    call->reply = reply;
+    call->destroy = destroy;
+    call->user_data = user_data;
+
+    /* Lock */
+    g_mutex_lock(&priv->ordered_mutex);
+    g_queue_push_tail(&priv->ordered_queue, call);
+    submit = !priv->ordered_busy;
+    priv->ordered_busy = TRUE;
+    g_mutex_unlock(&priv->ordered_mutex);
+    /* Unlock */
+
+    if (submit) {
+        gbinder_ipc_transact_custom(ipc, gbinder_client_ordered_exec, NULL,
+            (GDestroyNotify) gbinder_client_unref, gbinder_client_ref(self));
+    }
+
+    /* The worker may have already completed and freed the call */
+    return id;
+}
+
+static
+gboolean
+gbinder_client_cancel_ordered(
+    GBinderClient* self,
+    gulong id)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    GBinderClientOrdered* dropped = NULL;
+    gboolean found = FALSE;
+    GList* l;
+
+    /* Lock */
+    g_mutex_lock(&priv->ordered_mutex);
+    for (l = priv->ordered_queue.head; l && !found; l = l->next) {
+        GBinderClientOrdered* call = l->data;
+
+        if (call->id == id) {
+            /* Not sent yet, take it out of the queue */
+            g_queue_delete_link(&priv->ordered_queue, l);
+            call->cancelled = TRUE;
+            dropped = call;
+            found = TRUE;
+        }
+    }
+    if (!found && priv->ordered_current && priv->ordered_current->id == id) {
+        /* Can't be stopped, the result will be dropped */
+        priv->ordered_current->cancelled = TRUE;
+        found = TRUE;
+    }
+    for (l = priv->ordered_done.head; l && !found; l = l->next) {
+        GBinderClientOrdered* call = l->data;
+
+        if (call->id == id) {
+            call->cancelled = TRUE;
+            found = TRUE;
+        }
+    }
+    g_mutex_unlock(&priv->ordered_mutex);
+    /* Unlock */
+
+    if (found) {
+        GVERBOSE_("%lu", id);
+        if (dropped) {
+            /* Destroy notification is still invoked from the main loop */
+            gbinder_client_ordered_done(self, dropped);
+        }
+    }
+    return found;
+}
+
+static
+gboolean
+gbinder_client_can_chunk(
+    GBinderClient* self,
+    GBinderLocalRequest* req)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+
+    /* Chunks are plain bytes, objects can only travel through the driver */
+    if (priv->chunk_size && !self->remote->local) {
+        GBinderOutputData* data = gbinder_local_request_data(req);
+        GUtilIntArray* offsets = gbinder_output_data_offsets(data);
+
+        return (!offsets || !offsets->count) &&
+            !gbinder_output_data_buffers_size(data);
+    }
+    return FALSE;
+}
+
+static
+GBinderLocalRequest*
+gbinder_client_new_chunk_request(
+    GBinderClient* self,
+    GBinderWriter* writer,
+    gint32 op,
+    guint32 id)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    const guint32 code = priv->chunk_code;
+    GBinderLocalRequest* req = gbinder_client_new_request3(self, code,
+        (op == GBINDER_CHUNK_PUT) ? (priv->chunk_size + 32) : 0);
+
+    if (!req) {
+        /* The code is outside of the known ranges */
+        req = gbinder_client_new_request(self);
+    }
+    gbinder_local_request_init_writer(req, writer);
+    gbinder_writer_append_int32(writer, op);
+    gbinder_writer_append_int32(writer, id);
+    return req;
+}
+
+/*
+ * Each chunk is a synchronous transaction, the next one is only sent
+ * after the receiver has consumed the previous one. That keeps no more
+ * than one chunk per transfer in the receiver's mapping.
+ */
+static
+GBinderRemoteReply*
+gbinder_client_transact_chunked_sync(
+    GBinderClient* self,
+    guint32 code,
+    GBinderLocalRequest* req,
+    int* status,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    GBinderRemoteObject* obj = self->remote;
+    GByteArray* in = gbinder_local_request_data(req)->bytes;
+    const gsize chunk = priv->chunk_size;
+    const guint32 id = (guint32)g_atomic_int_add(&gbinder_client_chunk_id, 1);
+    GBinderRemoteReply* reply = NULL;
+    GBinderRemoteReply* out = NULL;
+    GBinderReader reader;
+    guint32 offset = 0, total = 0;
+    guint8* data = NULL;
+    int err = GBINDER_STATUS_OK;
+
+    /* Send the request */
+    do {
+        const guint32 len = MIN(in->len - offset, chunk);
+        GBinderWriter writer;
+        GBinderLocalRequest* put = gbinder_client_new_chunk_request(self,
+            &writer, GBINDER_CHUNK_PUT, id);
+
+        gbinder_writer_append_int32(&writer, code);
+        gbinder_writer_append_int32(&writer, in->len);
+        gbinder_writer_append_int32(&writer, offset);
+        gbinder_writer_append_int32(&writer, chunk);
+        gbinder_writer_append_byte_array(&writer, in->data + offset, len);
+        gbinder_remote_reply_unref(reply);
+        reply = api->sync_reply(obj->ipc, obj->handle, priv->chunk_code,
+            put, &err);
+        gbinder_local_request_unref(put);
+        offset += len;
+    } while (err == GBINDER_STATUS_OK && offset < in->len);
+
+    /* The last reply carries the total size and the first piece of data */
+    if (err == GBINDER_STATUS_OK) {
+        const void* piece;
+        gsize len;
+
+        gbinder_remote_reply_init_reader(reply, &reader);
+        if (gbinder_reader_read_uint32(&reader, &total) &&
+            total <= G_MAXINT32 &&
+            (piece = gbinder_reader_read_byte_array(&reader, &len)) &&
+            len <= total) {
+            data = g_malloc(total);
+            memcpy(data, piece, len);
+            offset = len;
+        } else {
+            err = (-EBADMSG);
+        }
+    }
+
+    /* Fetch the rest of the reply */
+    while (err == GBINDER_STATUS_OK && offset < total) {
+        const void* piece;
+        gsize len;
+        GBinderWriter writer;
+        GBinderLocalRequest* get = gbinder_client_new_chunk_request(self,
+            &writer, GBINDER_CHUNK_GET, id);
+
+        gbinder_writer_append_int32(&writer, offset);
+        gbinder_remote_reply_unref(reply);
+        reply = api->sync_reply(obj->ipc, obj->handle, priv->chunk_code,
+            get, &err);
+        gbinder_local_request_unref(get);
+        if (err == GBINDER_STATUS_OK) {
+            gbinder_remote_reply_init_reader(reply, &reader);
+            piece = gbinder_reader_read_byte_array(&reader, &len);
+            if (piece && len && len <= (total - offset)) {
+                memcpy(data + offset, piece, len);
+                offset += len;
+            } else {
+                err = (-EBADMSG);
+            }
+        }
+    }
+    gbinder_remote_reply_unref(reply);
+
+    if (err == GBINDER_STATUS_OK) {
+        GBinderIpc* ipc = obj->ipc;
+
+        out = gbinder_remote_reply_new(gbinder_ipc_object_registry(ipc));
+        if (total) {
+            gbinder_remote_reply_set_data(out, gbinder_buffer_new_local
+                (gbinder_ipc_io(ipc), data, total, NULL, g_free, data));
+            data = NULL;
+        }
+    } else {
+        GDEBUG("Chunked transaction %u failed (%d)", code, err);
+    }
+    g_free(data);
+    if (status) *status = err;
+    return out;
+}
+
+/*==========================================================================*
+ * Reply cache
+ *==========================================================================*/
+
+/*
+ * Code and contents of the request. NULL if the request carries objects,
+ * those may mean something different next time.
+ */
+static
+GBytes*
+gbinder_client_request_key(
+    guint32 code,
+    GBinderLocalRequest* req)
+{
+    GBinderOutputData* out = gbinder_local_request_data(req);
+    GUtilIntArray* offsets = gbinder_output_data_offsets(out);
+
+    if ((!offsets || !offsets->count) &&
+        !gbinder_output_data_buffers_size(out)) {
+        const GByteArray* bytes = out->bytes;
+        guint8* buf = g_malloc(sizeof(code) + bytes->len);
+
+        memcpy(buf, &code, sizeof(code));
+        memcpy(buf + sizeof(code), bytes->data, bytes->len);
+        return g_bytes_new_take(buf, sizeof(code) + bytes->len);
+    }
+    return NULL;
+}
+
+static
+void
+gbinder_client_cached_free(
+    gpointer data)
+{
+    GBinderClientCached* cached = data;
+
+    gbinder_remote_reply_unref(cached->reply);
+    g_slice_free(GBinderClientCached, cached);
+}
+
+static
+void
+gbinder_client_cache_death(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    gbinder_client_invalidate_cache(user_data);
+}
+
+/* Returns NULL if the reply to this request is not supposed to be cached */
+static
+GBytes*
+gbinder_client_cache_key(
+    GBinderClientPriv* priv,
+    guint32 code,
+    GBinderLocalRequest* req,
+    guint* ttl_ms)
+{
+    GBytes* key = NULL;
+
+    *ttl_ms = 0;
+    if (g_atomic_pointer_get(&priv->cache_ttl)) {
+        /* Lock */
+        g_mutex_lock(&priv->cache_mutex);
+        *ttl_ms = GPOINTER_TO_UINT(g_hash_table_lookup(priv->cache_ttl,
+            GUINT_TO_POINTER(code)));
+        g_mutex_unlock(&priv->cache_mutex);
+        /* Unlock */
+
+        if (*ttl_ms) {
+            key = gbinder_client_request_key(code, req);
+        }
+    }
+    return key;
+}
+
+static
+GBinderRemoteReply*
+gbinder_client_cache_lookup(
+    GBinderClientPriv* priv,
+    GBytes* key)
+{
+    GBinderRemoteReply* reply = NULL;
+    GBinderClientCached* cached;
+
+    /* Lock */
+    g_mutex_lock(&priv->cache_mutex);
+    cached = g_hash_table_lookup(priv->cache, key);
+    if (cached) {
+        if (g_get_monotonic_time() < cached->expires) {
+            reply = gbinder_remote_reply_ref(cached->reply);
+        } else {
+            g_hash_table_remove(priv->cache, key);
+        }
+    }
+    g_mutex_unlock(&priv->cache_mutex);
+    /* Unlock */
+
+    return reply;
+}
+
+static
+void
+gbinder_client_cache_store(
+    GBinderClientPriv* priv,
+    GBytes* key,
+    guint ttl_ms,
+    GBinderRemoteReply* reply)
+{
+    GBinderRemoteReply* copy = gbinder_remote_reply_dup_local(reply);
+
+    if (copy) {
+        const gint64 now = g_get_monotonic_time();
+        GBinderClientCached* cached = g_slice_new(GBinderClientCached);
+
+        cached->reply = copy;
+        cached->expires = now + ((gint64)ttl_ms) * 1000;
+
+        /* Lock */
+        g_mutex_lock(&priv->cache_mutex);
+        if (g_hash_table_size(priv->cache) >=
+            GBINDER_CLIENT_CACHE_MAX_ENTRIES) {
+            GHashTableIter it;
+            gpointer value;
+
+            /* Make room by dropping the expired entries */
+            g_hash_table_iter_init(&it, priv->cache);
+            while (g_hash_table_iter_next(&it, NULL, &value)) {
+                if (((GBinderClientCached*)value)->expires <= now) {
+                    g_hash_table_iter_remove(&it);
+                }
+            }
+        }
+        if (g_hash_table_size(priv->cache) <
+            GBINDER_CLIENT_CACHE_MAX_ENTRIES) {
+            g_hash_table_replace(priv->cache, g_bytes_ref(key), cached);
+            cached = NULL;
+        }
+        g_mutex_unlock(&priv->cache_mutex);
+        /* Unlock */
+
+        if (cached) {
+            gbinder_client_cached_free(cached);
+        }
+    }
+}
+
+static
+GBinderRemoteReply*
+gbinder_client_transact_sync_uncached(
+    GBinderClient* self,
+    guint32 code,
+    GBinderLocalRequest* req,
+    int* status,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderRemoteObject* obj = self->remote;
+
+    if (gbinder_local_request_data(req)->bytes->len >
+        gbinder_client_cast(self)->chunk_size &&
+        gbinder_client_can_chunk(self, req)) {
+        return gbinder_client_transact_chunked_sync(self, code, req, status,
+            api);
+    }
+    return obj->local ?
+        gbinder_ipc_transact_local_sync(obj->ipc, obj->local, code, 0, req,
+            status, api) :
+        api->sync_reply(obj->ipc, obj->handle, code, req, status);
+}
+
+/*==========================================================================*
+ * Single-flight calls
+ *
+ * Identical synchronous calls made while the first one is in progress
+ * wait for it to complete and share its reply rather than making their
+ * own round trips. Replies carrying objects are not shared, e.g. file
+ * descriptors can only be taken once. The waiters make their own calls
+ * in that case.
+ *==========================================================================*/
+
+static
+void
+gbinder_client_flight_unref_locked(
+    GBinderClientFlight* flight)
+{
+    if (!--(flight->refcount)) {
+        gbinder_remote_reply_unref(flight->reply);
+        g_slice_free(GBinderClientFlight, flight);
+    }
+}
+
+static
+GBinderRemoteReply*
+gbinder_client_transact_sync_flight(
+    GBinderClient* self,
+    guint32 code,
+    GBinderLocalRequest* req,
+    int* status,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderClientPriv* priv = gbinder_client_cast(self);
+    GBinderClientFlight* flight = NULL;
+    GBinderRemoteReply* reply;
+    GBytes* key = NULL;
+
+    /*
+     * In-process objects may need the main thread, which may be one of
+     * the waiters. Those are always called directly.
+     *
+     * Same goes for the leaders running on the worker threads. Incoming
+     * transactions which they receive while waiting for the reply are
+     * handed over to the main thread. The main thread (which can only
+     * be using gbinder_ipc_sync_main) must not wait for such a leader,
+     * those calls are made individually.
+     */
+    if (g_atomic_pointer_get(&priv->flight_codes) && !self->remote->local) {
+        GThread* thread = g_thread_self();
+
+        /* Lock */
+        g_mutex_lock(&priv->flight_mutex);
+        if (g_hash_table_contains(priv->flight_codes,
+            GUINT_TO_POINTER(code))) {
+            key = gbinder_client_request_key(code, req);
+        }
+        if (key) {
+            flight = g_hash_table_lookup(priv->flights, key);
+            if (flight && flight->leader != thread &&
+                (flight->api != &gbinder_ipc_sync_worker ||
+                 api == &gbinder_ipc_sync_worker)) {
+                /* Wait for the leader (but not for ourselves) */
+                flight->refcount++;
+                while (!flight->done) {
+                    g_cond_wait(&priv->flight_cond, &priv->flight_mutex);
+                }
+                if (!flight->retry) {
+                    reply = gbinder_remote_reply_ref(flight->reply);
+                    *status = flight->status;
+                    gbinder_client_flight_unref_locked(flight);
+                    g_mutex_unlock(&priv->flight_mutex);
+                    /* Unlock */
+
+                    g_bytes_unref(key);
+                    return reply;
+                }
+                /* Have to make our own call */
+                gbinder_client_flight_unref_locked(flight);
+                flight = NULL;
+            } else if (!flight) {
+                flight = g_slice_new0(GBinderClientFlight);
+                flight->refcount = 1;
+                flight->leader = thread;
+                flight->api = api;
+                g_hash_table_insert(priv->flights, g_bytes_ref(key), flight);
+            } else {
+                /* Nested call or the leader may need this thread */
+                flight = NULL;
+            }
+        }
+        g_mutex_unlock(&priv->flight_mutex);
+        /* Unlock */
+    }
+
+    reply = gbinder_client_transact_sync_uncached(self, code, req, status,
+        api);
+
+    if (flight) {
+        /* The waiters get a copy which doesn't hold the driver's buffer */
+        GBinderRemoteReply* copy = gbinder_remote_reply_dup_local(reply);
+
+        /* Lock */
+        g_mutex_lock(&priv->flight_mutex);
+        flight->reply = copy;
+        flight->retry = (reply && !copy);
+        flight->status = *status;
+        flight->done = TRUE;
+        g_hash_table_remove(priv->flights, key);
+        gbinder_client_flight_unref_locked(flight);
+        g_cond_broadcast(&priv->flight_cond);
+        g_mutex_unlock(&priv->flight_mutex);
+        /* Unlock */
+    }
+    if (key) {
+        g_bytes_unref(key);
+    }
+    return reply;
+}
+
 /*==========================================================================*
  * Internal interface
  *==========================================================================*/
@@ -202,10 +1510,35 @@ gbinder_client_transact_sync_reply2(
                 if (r) {
                     req = r->basic_req;
                 }
+            } else {
+                gbinder_client_remember_size(self, code, req);
             }
             if (req) {
-                return api->sync_reply(obj->ipc, obj->handle, code, req,
-                    status);
+                GBinderClientPriv* priv = gbinder_client_cast(self);
+                GBinderRemoteReply* reply;
+                guint ttl_ms;
+                GBytes* key = gbinder_client_cache_key(priv, code, req,
+                    &ttl_ms);
+                int err;
+
+                if (key) {
+                    reply = gbinder_client_cache_lookup(priv, key);
+                    if (reply) {
+                        g_bytes_unref(key);
+                        if (status) *status = GBINDER_STATUS_OK;
+                        return reply;
+                    }
+                }
+                reply = gbinder_client_transact_sync_flight(self, code, req,
+                    &err, api);
+                if (key) {
+                    if (err == GBINDER_STATUS_OK && !obj->dead) {
+                        gbinder_client_cache_store(priv, key, ttl_ms, reply);
+                    }
+                    g_bytes_unref(key);
+                }
+                if (status) *status = err;
+                return reply;
             } else {
                 GWARN("Unable to build empty request for tx code %u", code);
             }
@@ -235,8 +1568,18 @@ gbinder_client_transact_sync_oneway2(
                 if (r) {
                     req = r->basic_req;
                 }
+            } else {
+                gbinder_client_remember_size(self, code, req);
             }
             if (req) {
+                if (obj->local) {
+                    int status;
+
+                    gbinder_remote_reply_unref
+                        (gbinder_ipc_transact_local_sync(obj->ipc, obj->local,
+                            code, GBINDER_TX_FLAG_ONEWAY, req, &status, api));
+                    return status;
+                }
                 return api->sync_oneway(obj->ipc, obj->handle, code, req);
             } else {
                 GWARN("Unable to build empty request for tx code %u", code);
@@ -262,28 +1605,21 @@ gbinder_client_new2(
     if (G_LIKELY(remote)) {
         GBinderClientPriv* priv = g_slice_new0(GBinderClientPriv);
         GBinderClient* self = &priv->pub;
+
+        g_mutex_init(&priv->sizes_mutex);
+        g_mutex_init(&priv->coalesce_mutex);
+        g_mutex_init(&priv->fmq_mutex);
+        g_mutex_init(&priv->flight_mutex);
+        g_cond_init(&priv->flight_cond);
+        g_mutex_init(&priv->cache_mutex);
+        g_mutex_init(&priv->ordered_mutex);
         GBinderDriver* driver = remote->ipc->driver;
 
         g_atomic_int_set(&priv->refcount, 1);
         self->remote = gbinder_remote_object_ref(remote);
-        if (count > 0) {
-            gsize i;
-
-            priv->nr = count;
-            priv->ranges = g_new(GBinderClientIfaceRange, priv->nr);
-            for (i = 0; i < count; i++) {
-                gbinder_client_init_range(priv->ranges + i, driver, ifaces + i);
-            }
-            qsort(priv->ranges, count, sizeof(GBinderClientIfaceRange),
-                gbinder_client_sort_ranges);
-        } else {
-            /* No interface info */
-            priv->nr = 1;
-            priv->ranges = g_new0(GBinderClientIfaceRange, 1);
-            priv->ranges[0].last_code = UINT_MAX;
-            priv->ranges[0].basic_req = gbinder_local_request_new
-                (gbinder_driver_io(driver), NULL);
-        }
+        priv->ifaces = gbinder_client_ifaces_get(driver, ifaces, count);
+        priv->ranges = priv->ifaces->ranges;
+        priv->nr = priv->ifaces->nr;
         return self;
     }
     return NULL;
@@ -374,8 +1710,11 @@ gbinder_client_new_request(
     if (G_LIKELY(self)) {
         GBinderClientPriv* priv = gbinder_client_cast(self);
         const GBinderIo* io = gbinder_driver_io(self->remote->ipc->driver);
+        GBinderLocalRequest* req = gbinder_local_request_new(io,
+            priv->ranges->rpc_header);
 
-        return gbinder_local_request_new(io, priv->ranges->rpc_header);
+        gbinder_local_request_set_iface(req, priv->ranges->iface);
+        return req;
     }
     return NULL;
 }
@@ -384,6 +1723,15 @@ GBinderLocalRequest*
 gbinder_client_new_request2(
     GBinderClient* self,
     guint32 code) /* since 1.0.42 */
+{
+    return gbinder_client_new_request3(self, code, 0);
+}
+
+GBinderLocalRequest*
+gbinder_client_new_request3(
+    GBinderClient* self,
+    guint32 code,
+    gsize size_hint) /* since 1.1.25 */
 {
     if (G_LIKELY(self)) {
         GBinderClientPriv* priv = gbinder_client_cast(self);
@@ -392,13 +1740,111 @@ gbinder_client_new_request2(
 
         if (r) {
             const GBinderIo* io = gbinder_driver_io(self->remote->ipc->driver);
+            GBinderLocalRequest* req = gbinder_local_request_new(io,
+                r->rpc_header);
+            const gsize size = MAX(size_hint,
+                gbinder_client_size_hint(priv, code));
+            const gsize len = r->rpc_header_size;
 
-            return gbinder_local_request_new(io, r->rpc_header);
+            gbinder_local_request_set_iface(req, r->iface);
+            if (size > len) {
+                GBinderWriter writer;
+
+                gbinder_local_request_init_writer(req, &writer);
+                gbinder_writer_reserve(&writer, size - len, 0, 0);
+            }
+            return req;
         }
     }
     return NULL;
 }
 
+/*
+ * Limits the number of asynchronous transactions submitted to the
+ * thread pool shared by all clients talking to the same binder device.
+ * Transactions above max_in_flight are queued and submitted when one
+ * of the previous ones completes, those which don't fit into the queue
+ * are refused, gbinder_client_transact() returns zero and the destroy
+ * callback is not invoked. Zero max_in_flight removes the limit.
+ * Lowering the limit doesn't affect the transactions which have
+ * already been accepted.
+ *
+ * Synchronous, direct one-way and in-process transactions don't use
+ * the thread pool and are not limited.
+ */
+void
+gbinder_client_set_max_pending(
+    GBinderClient* self,
+    guint max_in_flight,
+    guint max_queued) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+
+        priv->max_in_flight = max_in_flight;
+        priv->max_queued = max_queued;
+    }
+}
+
+/*
+ * Enables or disables coalescing of one-way transactions with the
+ * specified code submitted with gbinder_client_transact(). While such
+ * a transaction is still waiting to be executed, a newer one replaces
+ * its request instead of being queued behind it. It's meant for status
+ * updates, when only the latest value matters. The superseded call
+ * gets its destroy notification but no completion callback, and the
+ * id returned for the newer call is the same as for the older one.
+ */
+void
+gbinder_client_set_coalesce_oneway(
+    GBinderClient* self,
+    guint32 code,
+    gboolean enable) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+        gpointer key = GUINT_TO_POINTER(code);
+
+        /* Lock */
+        g_mutex_lock(&priv->coalesce_mutex);
+        if (enable) {
+            if (!priv->coalesce) {
+                priv->coalesce = g_hash_table_new(g_direct_hash,
+                    g_direct_equal);
+            }
+            if (!g_hash_table_contains(priv->coalesce, key)) {
+                g_hash_table_insert(priv->coalesce, key, NULL);
+            }
+        } else if (priv->coalesce) {
+            /* The queued transaction (if any) will still be executed */
+            g_hash_table_remove(priv->coalesce, key);
+        }
+        g_mutex_unlock(&priv->coalesce_mutex);
+        /* Unlock */
+    }
+}
+
+/* Default timeout for gbinder_client_transact(), zero if none */
+void
+gbinder_client_set_timeout(
+    GBinderClient* self,
+    guint timeout_ms) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        gbinder_client_cast(self)->timeout_ms = timeout_ms;
+    }
+}
+
+void
+gbinder_client_set_adaptive_size(
+    GBinderClient* self,
+    gboolean enable) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        g_atomic_int_set(&gbinder_client_cast(self)->adaptive, enable != 0);
+    }
+}
+
 GBinderRemoteReply*
 gbinder_client_transact_sync_reply(
     GBinderClient* self,
@@ -429,19 +1875,62 @@ gbinder_client_transact(
     GBinderClientReplyFunc reply,
     GDestroyNotify destroy,
     void* user_data)
+{
+    return G_LIKELY(self) ? gbinder_client_transact_with_timeout(self, code,
+        flags, req, gbinder_client_cast(self)->timeout_ms, reply, destroy,
+        user_data) : 0;
+}
+
+/*
+ * If the reply doesn't arrive within timeout_ms, the reply callback is
+ * invoked with -ETIMEDOUT status. The transaction is not even sent if
+ * it's still queued when the time is up. Zero means no timeout.
+ * Timeouts don't apply to in-process, coalesced or ordered transactions.
+ * The destroy callback is invoked right after the timeout, and the
+ * transaction no longer counts against gbinder_client_set_max_pending().
+ */
+gulong
+gbinder_client_transact_with_timeout(
+    GBinderClient* self,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    guint timeout_ms,
+    GBinderClientReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data) /* since 1.1.25 */
 {
     if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
         GBinderRemoteObject* obj = self->remote;
 
         if (G_LIKELY(!obj->dead)) {
+            if (!(flags & GBINDER_CLIENT_LANE_FLAGS)) {
+                flags |= priv->lane;
+            }
             if (!req) {
                 const GBinderClientIfaceRange* r = gbinder_client_find_range
-                    (gbinder_client_cast(self), code);
+                    (priv, code);
 
                 /* Default empty request (just the header, no parameters) */
                 if (r) {
                     req = r->basic_req;
                 }
+            } else {
+                gbinder_client_remember_size(self, code, req);
+            }
+            if (req && g_atomic_int_get(&priv->ordered)) {
+                return gbinder_client_transact_ordered(self, code, flags,
+                    req, reply, destroy, user_data);
+            }
+            if (req && (flags & GBINDER_TX_FLAG_ONEWAY) && !obj->local &&
+                !(flags & GBINDER_TX_FLAG_DIRECT) && priv->coalesce) {
+                const gulong id = gbinder_client_transact_coalesced(self,
+                    code, req, reply, destroy, user_data);
+
+                if (id) {
+                    return id;
+                }
             }
             if (req) {
                 GBinderClientTx* tx = g_slice_new0(GBinderClientTx);
@@ -450,9 +1939,19 @@ gbinder_client_transact(
                 tx->reply = reply;
                 tx->destroy = destroy;
                 tx->user_data = user_data;
-                return gbinder_ipc_transact(obj->ipc, obj->handle, code,
-                    flags, req, gbinder_client_transact_reply,
-                    gbinder_client_transact_destroy, tx);
+                if (obj->local) {
+                    /* Bypass the driver for our own objects */
+                    return gbinder_ipc_transact_local(obj->ipc, obj->local,
+                        code, flags, req, gbinder_client_transact_reply,
+                        gbinder_client_transact_destroy, tx);
+                } else if (priv->max_in_flight &&
+                    (flags & (GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT))
+                    != (GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT)) {
+                    return gbinder_client_transact_limited(self, tx, code,
+                        flags, req, timeout_ms);
+                }
+                return gbinder_client_transact_submit(self, tx, code, flags,
+                    req, timeout_ms, TRUE);
             } else {
                 GWARN("Unable to build empty request for tx code %u", code);
             }
@@ -463,12 +1962,460 @@ gbinder_client_transact(
     return 0;
 }
 
+/*
+ * Negotiates a shared memory queue (FMQ) with the remote object, which
+ * has to accept it with gbinder_local_object_accept_fmq_channel() for
+ * the same code. The descriptor is sent with a synchronous transaction.
+ * From then on, gbinder_client_transact_fmq_oneway() writes one-way
+ * transactions to the queue and wakes up the other side via the event
+ * flag, bypassing the driver. The request also carries a token object,
+ * and the remote side closes the channel when the token dies, i.e. when
+ * this process goes away. Returns TRUE if the channel is open (including
+ * the case when it has been open before).
+ */
+gboolean
+gbinder_client_open_fmq_channel(
+    GBinderClient* self,
+    guint32 code,
+    gsize size) /* since 1.1.25 */
+{
+#if GBINDER_FMQ_SUPPORTED
+    if (G_LIKELY(self) && size > sizeof(GBinderFmqChannelHeader)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+        gboolean ok = FALSE;
+
+        /* Lock */
+        g_mutex_lock(&priv->fmq_mutex);
+        if (priv->fmq) {
+            ok = TRUE;
+        } else if (!self->remote->dead) {
+            GBinderFmq* fmq = gbinder_fmq_new(1, size,
+                GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+                GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+
+            if (fmq) {
+                GBinderLocalRequest* req = gbinder_client_new_request2(self,
+                    code);
+                GBinderLocalObject* token = gbinder_local_object_new
+                    (gbinder_client_ipc(self), NULL, NULL, NULL);
+                GBinderRemoteReply* reply;
+                GBinderWriter writer;
+                int status;
+
+                gbinder_local_request_init_writer(req, &writer);
+                gbinder_writer_append_fmq_descriptor(&writer, fmq);
+                gbinder_writer_append_local_object(&writer, token);
+                reply = gbinder_client_transact_sync_reply(self, code, req,
+                    &status);
+                gbinder_remote_reply_unref(reply);
+                gbinder_local_request_unref(req);
+                if (status == GBINDER_STATUS_OK) {
+                    priv->fmq = fmq;
+                    priv->fmq_token = token;
+                    ok = TRUE;
+                } else {
+                    GDEBUG("FMQ channel refused (%d)", status);
+                    gbinder_local_object_drop(token);
+                    gbinder_fmq_unref(fmq);
+                }
+            }
+        }
+        g_mutex_unlock(&priv->fmq_mutex);
+        /* Unlock */
+        return ok;
+    }
+#endif
+    return FALSE;
+}
+
+/*
+ * Sends one-way transaction over the FMQ channel. Falls back to
+ * gbinder_client_transact_sync_oneway() if the channel isn't open, the
+ * queue is full or the request carries objects, which can only travel
+ * through the driver. The transactions written to the queue are handled
+ * in the order they were written, and so are those sent through the
+ * driver. The receiving side drains the queue before handling anything
+ * coming from the driver, so a transaction that falls back to the driver
+ * is never handled before the ones queued ahead of it. However, it may
+ * be overtaken by the transactions written to the queue after it. The
+ * callers which care about the order of such mixed sequences should
+ * stick to one path, e.g. by keeping the requests small enough and free
+ * of objects, or by not using the queue at all.
+ */
+int
+gbinder_client_transact_fmq_oneway(
+    GBinderClient* self,
+    guint32 code,
+    GBinderLocalRequest* req) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+#if GBINDER_FMQ_SUPPORTED
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+        GBinderLocalRequest* out = req;
+
+        if (!out) {
+            const GBinderClientIfaceRange* r = gbinder_client_find_range
+                (priv, code);
+
+            if (r) {
+                out = r->basic_req;
+            }
+        }
+        if (out) {
+            GBinderOutputData* data = gbinder_local_request_data(out);
+            GUtilIntArray* offsets = gbinder_output_data_offsets(data);
+
+            if ((!offsets || !offsets->count) &&
+                !gbinder_output_data_buffers_size(data)) {
+                gboolean sent;
+
+                /* Lock */
+                g_mutex_lock(&priv->fmq_mutex);
+                sent = priv->fmq && gbinder_fmq_channel_write(priv->fmq,
+                    code, data->bytes->data, data->bytes->len);
+                g_mutex_unlock(&priv->fmq_mutex);
+                /* Unlock */
+                if (sent) {
+                    return GBINDER_STATUS_OK;
+                }
+            }
+        }
+#endif
+        return gbinder_client_transact_sync_oneway(self, code, req);
+    }
+    return (-EINVAL);
+}
+
+/*
+ * Enables chunked transfers for the remote object which accepts them
+ * with gbinder_local_object_accept_chunked() for the same code. From
+ * then on, gbinder_client_transact_sync_reply() splits the requests
+ * larger than chunk_size into a sequence of synchronous transactions,
+ * and the reply is fetched in pieces of the same size. Requests carrying
+ * objects are always sent as is. Zero chunk_size disables chunking.
+ * Must be called before the client is used by more than one thread.
+ */
+void
+gbinder_client_set_chunking(
+    GBinderClient* self,
+    guint32 code,
+    gsize chunk_size) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+
+        priv->chunk_code = code;
+        priv->chunk_size = MIN(chunk_size, G_MAXINT32);
+    }
+}
+
+/*
+ * Caches the replies to synchronous transactions with this code for
+ * ttl_ms milliseconds, zero stops caching them. The cache is keyed by
+ * the request contents, requests and replies carrying objects are never
+ * cached. Cached replies are shared by all callers. The cache is cleared
+ * when the remote object dies and by gbinder_client_invalidate_cache().
+ */
+void
+gbinder_client_set_reply_cache(
+    GBinderClient* self,
+    guint32 code,
+    guint ttl_ms) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+
+        /* Lock */
+        g_mutex_lock(&priv->cache_mutex);
+        if (ttl_ms) {
+            if (!priv->cache_ttl) {
+                priv->cache = g_hash_table_new_full(g_bytes_hash,
+                    g_bytes_equal, (GDestroyNotify) g_bytes_unref,
+                    gbinder_client_cached_free);
+                g_atomic_pointer_set(&priv->cache_ttl,
+                    g_hash_table_new(g_direct_hash, g_direct_equal));
+            }
+            g_hash_table_insert(priv->cache_ttl, GUINT_TO_POINTER(code),
+                GUINT_TO_POINTER(ttl_ms));
+        } else if (priv->cache_ttl) {
+            g_hash_table_remove(priv->cache_ttl, GUINT_TO_POINTER(code));
+        }
+        g_mutex_unlock(&priv->cache_mutex);
+        /* Unlock */
+
+        if (ttl_ms && !priv->cache_death_id) {
+            priv->cache_death_id = gbinder_remote_object_add_death_handler
+                (self->remote, gbinder_client_cache_death, self);
+        }
+    }
+}
+
+void
+gbinder_client_invalidate_cache(
+    GBinderClient* self) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+
+        /* Lock */
+        g_mutex_lock(&priv->cache_mutex);
+        if (priv->cache) {
+            g_hash_table_remove_all(priv->cache);
+        }
+        g_mutex_unlock(&priv->cache_mutex);
+        /* Unlock */
+    }
+}
+
+void
+gbinder_client_set_lane(
+    GBinderClient* self,
+    guint32 flags) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        gbinder_client_cast(self)->lane = flags & GBINDER_CLIENT_LANE_FLAGS;
+    }
+}
+
+/*
+ * In the ordered mode, asynchronous transactions are executed one after
+ * another in the order of submission, and their completion callbacks are
+ * invoked in the same order. A single worker keeps sending the queued
+ * calls back to back, without waiting for the main loop in between.
+ * Coalescing, in-flight limits and timeouts don't apply to such calls.
+ * Disabling the ordered mode doesn't affect the calls already queued.
+ */
+void
+gbinder_client_set_ordered(
+    GBinderClient* self,
+    gboolean enable) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        g_atomic_int_set(&gbinder_client_cast(self)->ordered,
+            enable != FALSE);
+    }
+}
+
+/*
+ * Synchronous calls with this code made while an identical one (same
+ * request contents) is already in progress wait for that one and share
+ * its reply and status. Requests carrying objects and transactions with
+ * in-process objects are always performed individually. So are the calls
+ * which find an asynchronous call (e.g. a batch) in progress, unless they
+ * are asynchronous too. The worker may need the caller's thread. Replies
+ * carrying objects (e.g. file descriptors) aren't shared either, each
+ * waiting caller then repeats the call on its own once the first one
+ * has completed.
+ */
+void
+gbinder_client_set_single_flight(
+    GBinderClient* self,
+    guint32 code,
+    gboolean enable) /* since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+
+        /* Lock */
+        g_mutex_lock(&priv->flight_mutex);
+        if (enable) {
+            if (!priv->flight_codes) {
+                priv->flights = g_hash_table_new_full(g_bytes_hash,
+                    g_bytes_equal, (GDestroyNotify) g_bytes_unref, NULL);
+                g_atomic_pointer_set(&priv->flight_codes,
+                    g_hash_table_new(g_direct_hash, g_direct_equal));
+            }
+            g_hash_table_add(priv->flight_codes, GUINT_TO_POINTER(code));
+        } else if (priv->flight_codes) {
+            g_hash_table_remove(priv->flight_codes, GUINT_TO_POINTER(code));
+        }
+        g_mutex_unlock(&priv->flight_mutex);
+        /* Unlock */
+    }
+}
+
+/*
+ * Same as gbinder_client_transact_sync_reply() but always goes through
+ * the chunked transfer (if it's enabled and the request carries no
+ * objects), regardless of the request size. That's for transactions
+ * which may return a reply too large to fit into a single transaction.
+ */
+GBinderRemoteReply*
+gbinder_client_transact_chunked(
+    GBinderClient* self,
+    guint32 code,
+    GBinderLocalRequest* req,
+    int* status) /* since 1.1.25 */
+{
+    if (G_LIKELY(self) && G_LIKELY(!self->remote->dead)) {
+        GBinderLocalRequest* out = req;
+
+        if (!out) {
+            const GBinderClientIfaceRange* r = gbinder_client_find_range
+                (gbinder_client_cast(self), code);
+
+            if (r) {
+                out = r->basic_req;
+            }
+        }
+        if (out && gbinder_client_can_chunk(self, out)) {
+            return gbinder_client_transact_chunked_sync(self, code, out,
+                status, &gbinder_ipc_sync_main);
+        }
+    }
+    return gbinder_client_transact_sync_reply(self, code, req, status);
+}
+
+gulong
+gbinder_client_transact_batch(
+    GBinderClient* self,
+    const GBinderClientBatchTx* txs,
+    guint count,
+    GBinderClientBatchReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    if (G_LIKELY(self) && txs && count) {
+        GBinderRemoteObject* obj = self->remote;
+
+        if (G_LIKELY(!obj->dead)) {
+            GBinderClientBatch* batch = g_slice_new0(GBinderClientBatch);
+            guint i;
+
+            batch->client = gbinder_client_ref(self);
+            batch->txs = gutil_memdup(txs, sizeof(txs[0]) * count);
+            batch->replies = g_new0(GBinderRemoteReply*, count);
+            batch->status = g_new(int, count);
+            batch->count = count;
+            batch->reply = reply;
+            batch->destroy = destroy;
+            batch->user_data = user_data;
+            for (i = 0; i < count; i++) {
+                gbinder_local_request_ref(batch->txs[i].req);
+                batch->status[i] = (-ECANCELED); /* Until executed */
+            }
+            return gbinder_ipc_transact_custom(obj->ipc,
+                gbinder_client_batch_exec, gbinder_client_batch_done,
+                gbinder_client_batch_free, batch);
+        } else {
+            GDEBUG("Refusing to perform transaction with a dead object");
+        }
+    }
+    return 0;
+}
+
+static
+void
+gbinder_client_broadcast_done(
+    GBinderIpc* ipc,
+    const int* status,
+    guint count,
+    void* user_data)
+{
+    GBinderClientBroadcast* bc = user_data;
+
+    bc->func(bc->clients, status, count, bc->user_data);
+}
+
+static
+void
+gbinder_client_broadcast_free(
+    gpointer data)
+{
+    GBinderClientBroadcast* bc = data;
+    guint i;
+
+    if (bc->destroy) {
+        bc->destroy(bc->user_data);
+    }
+    for (i = 0; i < bc->count; i++) {
+        gbinder_client_unref(bc->clients[i]);
+    }
+    g_free(bc->clients);
+    g_slice_free(GBinderClientBroadcast, bc);
+}
+
+/*
+ * Sends the same request one-way to all the clients, serializing it
+ * only once. The clients must belong to the same device, the request
+ * goes to each one as is (the coalescing and in-flight limits of the
+ * clients don't apply). Status is reported per client, e.g. dead ones
+ * get GBINDER_STATUS_DEAD_OBJECT. The call can be cancelled with
+ * gbinder_client_cancel() on any of the clients.
+ */
+gulong
+gbinder_client_broadcast(
+    GBinderClient* const* clients,
+    guint count,
+    guint32 code,
+    GBinderLocalRequest* req,
+    GBinderClientBroadcastFunc func,
+    GDestroyNotify destroy,
+    void* user_data) /* Since 1.1.25 */
+{
+    GBinderIpc* ipc = NULL;
+    guint i;
+
+    for (i = 0; clients && i < count && !ipc; i++) {
+        if (clients[i]) {
+            ipc = gbinder_client_ipc(clients[i]);
+        }
+    }
+    if (ipc && req) {
+        GBinderClientBroadcast* bc = g_slice_new0(GBinderClientBroadcast);
+        GBinderRemoteObject** objects = g_new(GBinderRemoteObject*, count);
+        gulong id;
+
+        bc->clients = g_new(GBinderClient*, count);
+        bc->count = count;
+        bc->func = func;
+        bc->destroy = destroy;
+        bc->user_data = user_data;
+        for (i = 0; i < count; i++) {
+            GBinderClient* client = clients[i];
+
+            bc->clients[i] = gbinder_client_ref(client);
+            objects[i] = client ? client->remote : NULL;
+        }
+        id = gbinder_ipc_broadcast(ipc, objects, count, code, req,
+            func ? gbinder_client_broadcast_done : NULL,
+            gbinder_client_broadcast_free, bc);
+        g_free(objects);
+        return id;
+    }
+    return 0;
+}
+
 void
 gbinder_client_cancel(
     GBinderClient* self,
     gulong id)
 {
     if (G_LIKELY(self)) {
+        GBinderClientPriv* priv = gbinder_client_cast(self);
+
+        if (id && gbinder_client_cancel_ordered(self, id)) {
+            return;
+        }
+        if (priv->coalesce && id) {
+            GHashTableIter it;
+            gpointer value;
+
+            /* Don't let newer requests join the cancelled transaction */
+            /* Lock */
+            g_mutex_lock(&priv->coalesce_mutex);
+            g_hash_table_iter_init(&it, priv->coalesce);
+            while (g_hash_table_iter_next(&it, NULL, &value)) {
+                GBinderClientCoalesced* call = value;
+
+                if (call && call->id == id) {
+                    g_hash_table_iter_replace(&it, NULL);
+                    break;
+                }
+            }
+            g_mutex_unlock(&priv->coalesce_mutex);
+            /* Unlock */
+        }
         gbinder_ipc_cancel(gbinder_client_ipc(self), id);
     }
 }
@@ -32,23 +32,50 @@
 
 #include "gbinder_config.h"
 #include "gbinder_eventloop_p.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_log.h"
 
+#include <gutil_misc.h>
 #include <gutil_strv.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <string.h>
 
 /*
- * The contents of the config file is queried from (at least) two places,
- * and pretty much always this happens the same stack. Which means that
- * we can avoid reading the same file twice if we delay dereferencing of
- * GKeyFile until the next idle loop.
+ * The merged config is parsed once and kept around. Every file it has
+ * been loaded from (and the directory, to catch files being added or
+ * removed) is stat'ed at most once per GBINDER_CONFIG_CHECK_INTERVAL
+ * and the config gets reloaded only if any of those has changed. The
+ * replaced GKeyFile is released on the next idle loop, so the pointer
+ * returned by gbinder_config_get() remains valid at least until then.
  */
 
+typedef struct gbinder_config_stamp {
+    char* path;
+    gboolean exists;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+} GBinderConfigStamp;
+
+typedef struct gbinder_config_int {
+    gboolean found;
+    int value;
+} GBinderConfigInt;
+
+#define GBINDER_CONFIG_CHECK_INTERVAL (G_TIME_SPAN_SECOND)
+
+static GMutex gbinder_config_mutex;
 static GKeyFile* gbinder_config_keyfile = NULL;
-static GBinderEventLoopCallback* gbinder_config_autorelease = NULL;
+static GArray* gbinder_config_stamps = NULL;
+static GHashTable* gbinder_config_ints = NULL;
+static const char* gbinder_config_loaded_file = NULL;
+static const char* gbinder_config_loaded_dir = NULL;
+static gint64 gbinder_config_checked = 0;
 
 static const char gbinder_config_suffix[] = ".conf";
 static const char gbinder_config_default_file[] = "/etc/gbinder.conf";
@@ -156,6 +183,66 @@ static const GBinderConfigPreset gbinder_config_presets[] = {
     { 28, gbinder_config_28 }
 };
 
+static
+void
+gbinder_config_stamp_stat(
+    GBinderConfigStamp* stamp,
+    const char* path)
+{
+    struct stat st;
+
+    memset(stamp, 0, sizeof(*stamp));
+    if (!stat(path, &st)) {
+        stamp->exists = TRUE;
+        stamp->dev = st.st_dev;
+        stamp->ino = st.st_ino;
+        stamp->size = st.st_size;
+        stamp->mtime = st.st_mtim;
+        stamp->ctime = st.st_ctim;
+    }
+}
+
+static
+void
+gbinder_config_stamp_add(
+    GArray* stamps,
+    const char* path)
+{
+    if (stamps && path) {
+        GBinderConfigStamp stamp;
+
+        gbinder_config_stamp_stat(&stamp, path);
+        stamp.path = g_strdup(path);
+        g_array_append_val(stamps, stamp);
+    }
+}
+
+static
+gboolean
+gbinder_config_stamp_valid(
+    const GBinderConfigStamp* stamp)
+{
+    GBinderConfigStamp now;
+
+    gbinder_config_stamp_stat(&now, stamp->path);
+    return now.exists == stamp->exists &&
+        now.dev == stamp->dev &&
+        now.ino == stamp->ino &&
+        now.size == stamp->size &&
+        now.mtime.tv_sec == stamp->mtime.tv_sec &&
+        now.mtime.tv_nsec == stamp->mtime.tv_nsec &&
+        now.ctime.tv_sec == stamp->ctime.tv_sec &&
+        now.ctime.tv_nsec == stamp->ctime.tv_nsec;
+}
+
+static
+void
+gbinder_config_stamp_clear(
+    gpointer data)
+{
+    g_free(((GBinderConfigStamp*)data)->path);
+}
+
 static
 char**
 gbinder_config_collect_files(
@@ -255,13 +342,16 @@ gbinder_config_apply_presets(
 
 static
 GKeyFile*
-gbinder_config_load_files()
+gbinder_config_load_files(
+    GArray* stamps)
 {
     GError* error = NULL;
     GKeyFile* out = NULL;
     char** files = gbinder_config_collect_files(gbinder_config_dir,
         gbinder_config_suffix);
 
+    gbinder_config_stamp_add(stamps, gbinder_config_file);
+    gbinder_config_stamp_add(stamps, gbinder_config_dir);
     if (gbinder_config_file &&
         g_file_test(gbinder_config_file, G_FILE_TEST_EXISTS)) {
         out = g_key_file_new();
@@ -286,6 +376,7 @@ gbinder_config_load_files()
         for (ptr = files; *ptr; ptr++) {
             const char* file = *ptr;
 
+            gbinder_config_stamp_add(stamps, file);
             if (!override) {
                 override = g_key_file_new();
             }
@@ -334,31 +425,103 @@ gbinder_config_load_files()
     return out;
 }
 
+static
+gboolean
+gbinder_config_up_to_date(
+    void)
+{
+    /* Caller holds gbinder_config_mutex */
+    if (gbinder_config_stamps &&
+        gbinder_config_loaded_file == gbinder_config_file &&
+        gbinder_config_loaded_dir == gbinder_config_dir) {
+        const gint64 now = g_get_monotonic_time();
+        guint i;
+
+        if (now < gbinder_config_checked + GBINDER_CONFIG_CHECK_INTERVAL) {
+            return TRUE;
+        }
+        for (i = 0; i < gbinder_config_stamps->len; i++) {
+            if (!gbinder_config_stamp_valid(&g_array_index
+                (gbinder_config_stamps, GBinderConfigStamp, i))) {
+                GDEBUG("Config has changed");
+                return FALSE;
+            }
+        }
+        gbinder_config_checked = now;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 static
 void
-gbinder_config_autorelease_cb(
-    gpointer data)
+gbinder_config_clear(
+    gboolean autorelease)
 {
-    GASSERT(gbinder_config_keyfile == data);
-    gbinder_config_keyfile = NULL;
-    g_key_file_unref(data);
+    /* Caller holds gbinder_config_mutex */
+    if (gbinder_config_keyfile) {
+        if (autorelease) {
+            /* See the comment at the top of the file */
+            gbinder_idle_callback_invoke_later(NULL, gbinder_config_keyfile,
+                (GDestroyNotify) g_key_file_unref);
+        } else {
+            g_key_file_unref(gbinder_config_keyfile);
+        }
+        gbinder_config_keyfile = NULL;
+    }
+    if (gbinder_config_stamps) {
+        g_array_free(gbinder_config_stamps, TRUE);
+        gbinder_config_stamps = NULL;
+    }
+    if (gbinder_config_ints) {
+        g_hash_table_destroy(gbinder_config_ints);
+        gbinder_config_ints = NULL;
+    }
+    gbinder_config_loaded_file = NULL;
+    gbinder_config_loaded_dir = NULL;
 }
 
-GKeyFile* /* autoreleased */
-gbinder_config_get()
+static
+GKeyFile*
+gbinder_config_get_locked(
+    void)
 {
-    if (!gbinder_config_keyfile &&
-        (gbinder_config_file || gbinder_config_dir)) {
-        gbinder_config_keyfile = gbinder_config_load_files();
-        if (gbinder_config_keyfile) {
-            /* See the comment at the top of the file why this is needed */
-            gbinder_config_autorelease = gbinder_idle_callback_schedule_new
-               (gbinder_config_autorelease_cb, gbinder_config_keyfile, NULL);
+    /* Caller holds gbinder_config_mutex */
+    if (!gbinder_config_up_to_date()) {
+        gbinder_config_clear(TRUE);
+        if (gbinder_config_file || gbinder_config_dir) {
+            const gint64 start = g_get_monotonic_time();
+
+            gbinder_config_stamps = g_array_new(FALSE, FALSE,
+                sizeof(GBinderConfigStamp));
+            g_array_set_clear_func(gbinder_config_stamps,
+                gbinder_config_stamp_clear);
+            gbinder_config_keyfile = gbinder_config_load_files
+                (gbinder_config_stamps);
+            /* gbinder_config_file may have been reset by the loader */
+            gbinder_config_loaded_file = gbinder_config_file;
+            gbinder_config_loaded_dir = gbinder_config_dir;
+            gbinder_config_checked = g_get_monotonic_time();
+            gbinder_stats_startup(GBINDER_STATS_STARTUP_CONFIG, start);
         }
     }
     return gbinder_config_keyfile;
 }
 
+GKeyFile* /* autoreleased */
+gbinder_config_get()
+{
+    GKeyFile* k;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_config_mutex);
+    k = gbinder_config_get_locked();
+    g_mutex_unlock(&gbinder_config_mutex);
+    /* Unlock */
+
+    return k;
+}
+
 /* Helper for loading config group in device = ident format */
 GHashTable*
 gbinder_config_load(
@@ -398,17 +561,107 @@ gbinder_config_load(
     return map;
 }
 
-void
-gbinder_config_exit()
+/* Helper for fetching integer values in device = value format */
+int
+gbinder_config_get_device_int(
+    const char* group,
+    const char* dev,
+    int defval)
 {
-    if (gbinder_config_autorelease) {
-        gbinder_idle_callback_destroy(gbinder_config_autorelease);
-        gbinder_config_autorelease = NULL;
+    GBinderConfigInt result;
+    GBinderConfigInt* cached;
+    GKeyFile* k;
+    char* name;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_config_mutex);
+    k = gbinder_config_get_locked();
+    name = g_strconcat(group, "/", dev, NULL);
+    cached = gbinder_config_ints ?
+        g_hash_table_lookup(gbinder_config_ints, name) : NULL;
+    if (cached) {
+        result = *cached;
+        g_free(name);
+    } else {
+        memset(&result, 0, sizeof(result));
+        if (k) {
+            const char* keys[2];
+            guint i;
+
+            /* Device specific value takes precedence over the default one */
+            keys[0] = dev;
+            keys[1] = GBINDER_CONFIG_VALUE_DEFAULT;
+            for (i = 0; i < G_N_ELEMENTS(keys) && !result.found; i++) {
+                const char* key = keys[i];
+
+                if (key && g_key_file_has_key(k, group, key, NULL)) {
+                    GError* error = NULL;
+                    const int val = g_key_file_get_integer(k, group, key,
+                        &error);
+
+                    if (!error) {
+                        result.found = TRUE;
+                        result.value = val;
+                    } else {
+                        GWARN("Invalid gbinder config value for %s in "
+                            "group [%s]: %s", key, group, error->message);
+                        g_error_free(error);
+                    }
+                }
+            }
+        }
+        /* Cache the result until the config changes */
+        if (!gbinder_config_ints) {
+            gbinder_config_ints = g_hash_table_new_full(g_str_hash,
+                g_str_equal, g_free, g_free);
+        }
+        g_hash_table_insert(gbinder_config_ints, name,
+            gutil_memdup(&result, sizeof(result)));
     }
-    if (gbinder_config_keyfile) {
-        g_key_file_unref(gbinder_config_keyfile);
-        gbinder_config_keyfile = NULL;
+    g_mutex_unlock(&gbinder_config_mutex);
+    /* Unlock */
+
+    return result.found ? result.value : defval;
+}
+
+/* Same thing for strings, returns NULL if there's no value */
+char*
+gbinder_config_get_device_string(
+    const char* group,
+    const char* dev)
+{
+    char* result = NULL;
+    GKeyFile* k;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_config_mutex);
+    k = gbinder_config_get_locked();
+    if (k) {
+        const char* keys[2];
+        guint i;
+
+        keys[0] = dev;
+        keys[1] = GBINDER_CONFIG_VALUE_DEFAULT;
+        for (i = 0; i < G_N_ELEMENTS(keys) && !result; i++) {
+            if (keys[i]) {
+                result = g_key_file_get_string(k, group, keys[i], NULL);
+            }
+        }
     }
+    g_mutex_unlock(&gbinder_config_mutex);
+    /* Unlock */
+
+    return result;
+}
+
+void
+gbinder_config_exit()
+{
+    /* Lock */
+    g_mutex_lock(&gbinder_config_mutex);
+    gbinder_config_clear(FALSE);
+    g_mutex_unlock(&gbinder_config_mutex);
+    /* Unlock */
 }
 
 /*
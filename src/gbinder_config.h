@@ -51,6 +51,20 @@ gbinder_config_get(
     void)
     GBINDER_INTERNAL;
 
+int
+gbinder_config_get_device_int(
+    const char* group,
+    const char* dev,
+    int defval)
+    GBINDER_INTERNAL;
+
+char*
+gbinder_config_get_device_string(
+    const char* group,
+    const char* dev)
+    G_GNUC_WARN_UNUSED_RESULT
+    GBINDER_INTERNAL;
+
 /* This one declared strictly for unit tests */
 void
 gbinder_config_exit(
@@ -65,6 +79,40 @@ extern const char* gbinder_config_dir GBINDER_INTERNAL;
 /* Configuration groups and special value */
 #define GBINDER_CONFIG_GROUP_PROTOCOL "Protocol"
 #define GBINDER_CONFIG_GROUP_SERVICEMANAGER "ServiceManager"
+#define GBINDER_CONFIG_GROUP_READ_BUFFER_SIZE "ReadBufferSize"
+#define GBINDER_CONFIG_GROUP_MMAP_SIZE "MmapSize"
+#define GBINDER_CONFIG_GROUP_MIN_LOOPERS "MinLoopers"
+#define GBINDER_CONFIG_GROUP_MAX_LOOPERS "MaxLoopers"
+#define GBINDER_CONFIG_GROUP_BUFFER_POOL_SIZE "BufferPoolSize"
+#define GBINDER_CONFIG_GROUP_SERVICE_CACHE "ServiceCache"
+#define GBINDER_CONFIG_GROUP_TIMER_SLACK "TimerSlack"
+#define GBINDER_CONFIG_GROUP_TX_THREADS "TxThreads"
+#define GBINDER_CONFIG_GROUP_SHARED_TX_THREADS "SharedTxThreads"
+#define GBINDER_CONFIG_GROUP_LOOPER_IDLE_TIMEOUT "LooperIdleTimeout"
+#define GBINDER_CONFIG_GROUP_PRESTART_LOOPERS "PrestartLoopers"
+#define GBINDER_CONFIG_GROUP_BLOCKING_LOOPERS "BlockingLoopers"
+#define GBINDER_CONFIG_GROUP_SHARED_IDLE_LOOPER "SharedIdleLooper"
+#define GBINDER_CONFIG_GROUP_PRESENCE_CHECK_MIN_DELAY "PresenceCheckMinDelay"
+#define GBINDER_CONFIG_GROUP_PRESENCE_CHECK_MAX_DELAY "PresenceCheckMaxDelay"
+#define GBINDER_CONFIG_GROUP_SERVICE_POLL_INTERVAL "ServicePollInterval"
+#define GBINDER_CONFIG_GROUP_SERVICE_POLL_WATCHED_ONLY "ServicePollWatchedOnly"
+#define GBINDER_CONFIG_GROUP_REMOTE_CACHE_SIZE "RemoteCacheSize"
+#define GBINDER_CONFIG_GROUP_REMOTE_CACHE_TIMEOUT "RemoteCacheTimeout"
+#define GBINDER_CONFIG_GROUP_LOOPER_CPUS "LooperCpus"
+#define GBINDER_CONFIG_GROUP_LOOPER_NICE "LooperNice"
+#define GBINDER_CONFIG_GROUP_LOOPER_RT_PRIORITY "LooperRtPriority"
+#define GBINDER_CONFIG_GROUP_LOOPER_STACK_SIZE "LooperStackSize"
+#define GBINDER_CONFIG_GROUP_TX_CPUS "TxCpus"
+#define GBINDER_CONFIG_GROUP_TX_NICE "TxNice"
+#define GBINDER_CONFIG_GROUP_TX_RT_PRIORITY "TxRtPriority"
+#define GBINDER_CONFIG_GROUP_ONEWAY_SPAM_DETECTION "OnewaySpamDetection"
+#define GBINDER_CONFIG_GROUP_BLOB_INPLACE_LIMIT "BlobInplaceLimit"
+#define GBINDER_CONFIG_GROUP_MEMORY_CACHE_SIZE "MemoryCacheSize"
+#define GBINDER_CONFIG_GROUP_BUFFER_EVICT_WATERMARK "BufferEvictWatermark"
+#define GBINDER_CONFIG_GROUP_TRACE_CONTEXT "TraceContext"
+#define GBINDER_CONFIG_GROUP_AUTOTUNE "Autotune"
+#define GBINDER_CONFIG_GROUP_AUTOTUNE_MAX_LOOPERS "AutotuneMaxLoopers"
+#define GBINDER_CONFIG_GROUP_AUTOTUNE_MAX_TX_THREADS "AutotuneMaxTxThreads"
 #define GBINDER_CONFIG_VALUE_DEFAULT "Default"
 
 #endif /* GBINDER_CONFIG_H */
@@ -32,9 +32,12 @@
 
 #include "gbinder_driver.h"
 #include "gbinder_buffer_p.h"
+#include "gbinder_capture_p.h"
 #include "gbinder_cleanup.h"
+#include "gbinder_config.h"
+#include "gbinder_eventloop_p.h"
 #include "gbinder_handler.h"
-#include "gbinder_io.h"
+#include "gbinder_io_fixed.h"
 #include "gbinder_local_object_p.h"
 #include "gbinder_local_reply_p.h"
 #include "gbinder_local_request_p.h"
@@ -44,7 +47,9 @@
 #include "gbinder_remote_reply_p.h"
 #include "gbinder_remote_request_p.h"
 #include "gbinder_rpc_protocol.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_system.h"
+#include "gbinder_trace.h"
 #include "gbinder_writer.h"
 #include "gbinder_log.h"
 
@@ -66,43 +71,180 @@
 /* BINDER_VM_SIZE copied from native/libs/binder/ProcessState.cpp */
 #define BINDER_VM_SIZE ((1024*1024) - sysconf(_SC_PAGE_SIZE)*2)
 
-#define BINDER_MAX_REPLY_SIZE (256)
+/* Transactions with up to this many objects don't allocate anything */
+#define GBINDER_DRIVER_MAX_STACK_OFFSETS (32)
+
+/* The kernel doesn't map more than 4M per process anyway */
+#define BINDER_VM_MAX_SIZE (4*1024*1024)
 
-/* ioctl code (the only one we really need here) */
-#define BINDER_VERSION _IOWR('b', 9, gint32)
+#define GBINDER_DRIVER_ALIGN(size,align) \
+    (((size) + (align) - 1) & ~((gsize)(align) - 1))
+
+#define BINDER_MAX_REPLY_SIZE (256)
 
-/* OK, one more */
-#define BINDER_SET_MAX_THREADS _IOW('b', 5, guint32)
+/*
+ * ioctl code (the only one we really need here). Single-ABI builds
+ * get these from binder.h, via gbinder_io_fixed.h
+ */
+#ifndef BINDER_VERSION
+#  define BINDER_VERSION _IOWR('b', 9, gint32)
+#endif
+
+/* OK, a few more */
+#ifndef BINDER_SET_MAX_THREADS
+#  define BINDER_SET_MAX_THREADS _IOW('b', 5, guint32)
+#endif
+#ifndef BINDER_ENABLE_ONEWAY_SPAM_DETECTION
+#  define BINDER_ENABLE_ONEWAY_SPAM_DETECTION _IOW('b', 16, guint32)
+#endif
 
 #define DEFAULT_MAX_BINDER_THREADS (0)
 
+/*
+ * If there's less than that left in the read buffer after the ioctl,
+ * the driver may have had more to say. If that happens this many times
+ * in a row, the read buffer gets doubled (up to the maximum size).
+ */
+#define GBINDER_DRIVER_READ_FULL_MARGIN \
+    (sizeof(guint32) + GBINDER_MAX_BC_TRANSACTION_SIZE)
+#define GBINDER_DRIVER_READ_GROW_THRESHOLD (2)
+
+/*
+ * Sizes of the replies are counted in power-of-two buckets while the
+ * runtime tuning is on (the last bucket is open). The pre-sizing hint
+ * is the upper bound of the bucket containing GBINDER_DRIVER_REPLY_HINT
+ * percent of the replies, once there's enough of them.
+ */
+#define GBINDER_DRIVER_REPLY_BUCKETS (16)
+#define GBINDER_DRIVER_REPLY_HINT (90)
+#define GBINDER_DRIVER_REPLY_MIN_SAMPLES (32)
+
+/* Initial size of the deferred command buffer */
+#define GBINDER_DRIVER_DEFERRED_SIZE (64)
+
+/*
+ * BC_FREE_BUFFER commands issued outside of the driver I/O are collected
+ * in the per-driver batch and written all at once, either from the idle
+ * callback, or along with the next write, or when the batch grows this
+ * large (that's about 40 BC_FREE_BUFFER_64 commands).
+ *
+ * BC_RELEASE commands join the same batch, except that they are kept
+ * as per-handle counters until the batch gets written. BC_ACQUIRE for
+ * a handle with a pending release cancels that release instead of going
+ * to the driver. That's what happens when the same remote object keeps
+ * coming and going, e.g. because it's passed around in parcels. It's
+ * safe because the handle can't go away while we are holding a strong
+ * reference to it, and delaying a release never breaks anything.
+ * BC_ACQUIRE itself is never delayed, it may be protecting a handle
+ * which arrived in a buffer that's about to be freed.
+ */
+#define GBINDER_DRIVER_FREE_BATCH_SIZE (512)
+#define GBINDER_DRIVER_RELEASE_SIZE (8) /* BC_RELEASE + handle */
+
+/*
+ * Status-only replies never change. The most common ones (including
+ * the ones sent when a transaction gets rejected) are encoded once
+ * per driver and written by the looper as is.
+ */
+static const gint32 gbinder_driver_cached_status[] = {
+    GBINDER_STATUS_OK,
+    GBINDER_STATUS_FAILED,
+    -EBADMSG,
+    -EINVAL
+};
+
+#define GBINDER_DRIVER_CACHED_STATUS_COUNT \
+    G_N_ELEMENTS(gbinder_driver_cached_status)
+
+typedef struct gbinder_driver_status_reply {
+    gint32 status; /* BC_REPLY points here */
+    guint len;
+    guint8 cmd[sizeof(guint32) + GBINDER_MAX_BC_TRANSACTION_SIZE];
+} GBinderDriverStatusReply;
+
 struct gbinder_driver {
     gint refcount;
     int fd;
-    void* vm;
+    void* vm; /* Mapped on demand */
     gsize vmsize;
+    GMutex map_mutex;
     char* dev;
     const char* name;
     const GBinderIo* io;
     const GBinderRpcProtocol* protocol;
+    gint read_size;
+    gint read_size_min; /* Configured */
+    gint pinned;
+    gsize evict_watermark; /* Zero if heap copies are disabled */
+    gboolean trace_context;
+    gint tuning;
+    gint read_full; /* Counted while tuning */
+    gint reply_sizes[GBINDER_DRIVER_REPLY_BUCKETS]; /* Same */
+    GMutex free_mutex;
+    GByteArray* free_batch;
+    GHashTable* release_batch; /* handle => count */
+    gint free_bytes;
+    GBinderDriverFunc oneway_spam_fn;
+    void* oneway_spam_data;
+    GBinderDriverStatusReply status_reply[GBINDER_DRIVER_CACHED_STATUS_COUNT];
 };
 
+/*
+ * Offsets of the objects being sent are normally stored in the stack
+ * of the thread performing the transaction. Only really large object
+ * counts have to be allocated from the heap (and are counted, to make
+ * sure that it doesn't happen too often).
+ */
+typedef struct gbinder_driver_offsets_buf {
+    guint64 stack[GBINDER_DRIVER_MAX_STACK_OFFSETS];
+    void* heap;
+} GBinderDriverOffsetsBuf;
+
+static gint gbinder_driver_offsets_heap_allocs = 0;
+
 typedef struct gbinder_driver_read_buf {
     GBinderIoBuf io;
     gsize offset;
+    guint full;
 } GBinderDriverReadBuf;
 
+/*
+ * Read buffers are allocated per thread and reused. Nested transactions
+ * (e.g. a synchronous call made by the transaction handler) get their
+ * own temporary buffer.
+ *
+ * While the thread is talking to the driver, small commands which don't
+ * require immediate attention (BC_FREE_BUFFER, BC_INCREFS_DONE and such)
+ * are collected in the deferred command buffer and sent to the driver
+ * along with the next write, or flushed when the thread is done talking
+ * to the driver (i.e. before it gets blocked in poll or returns to the
+ * event loop).
+ */
 typedef struct gbinder_driver_read_data {
     GBinderDriverReadBuf buf;
-    guint8 data[GBINDER_IO_READ_BUFFER_SIZE];
+    gboolean busy;
+    gboolean nested;
+    gsize size;
+    guint8* data;
+    GBinderDriver* driver; /* Not a reference, only valid while busy */
+    GByteArray* deferred;
 } GBinderDriverReadData;
 
+static
+void
+gbinder_driver_read_data_free(
+    gpointer data);
+
+static GPrivate gbinder_driver_read_data_key =
+    G_PRIVATE_INIT(gbinder_driver_read_data_free);
+
 typedef struct gbinder_driver_context {
     GBinderDriverReadBuf* rbuf;
     GBinderObjectRegistry* reg;
     GBinderHandler* handler;
     GBinderCleanup* unrefs;
     GBinderBufferContentsList* bufs;
+    GPtrArray* deaths;
 } GBinderDriverContext;
 
 static
@@ -222,6 +364,215 @@ gbinder_driver_verbose_transaction_data(
 #  define gbinder_driver_verbose_transaction_data(x,y) GLOG_NOTHING
 #endif /* GUTIL_LOG_VERBOSE */
 
+static
+GBinderDriverReadData*
+gbinder_driver_deferred_data(
+    GBinderDriver* self)
+{
+    GBinderDriverReadData* read = g_private_get(&gbinder_driver_read_data_key);
+
+    /* Commands can only be deferred by the thread talking to the driver */
+    return (read && read->busy && read->driver == self) ? read : NULL;
+}
+
+static
+gboolean
+gbinder_driver_defer(
+    GBinderDriver* self,
+    const void* cmd,
+    gsize len)
+{
+    GBinderDriverReadData* read = gbinder_driver_deferred_data(self);
+
+    if (read) {
+        if (!read->deferred) {
+            read->deferred = g_byte_array_sized_new
+                (GBINDER_DRIVER_DEFERRED_SIZE);
+        }
+        g_byte_array_append(read->deferred, cmd, len);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+void
+gbinder_driver_free_batch_add(
+    GBinderDriver* self,
+    const void* cmd,
+    gsize len);
+
+static
+GByteArray*
+gbinder_driver_free_batch_steal(
+    GBinderDriver* self)
+{
+    GByteArray* batch = NULL;
+
+    if (g_atomic_int_get(&self->free_bytes)) {
+        /* Lock */
+        g_mutex_lock(&self->free_mutex);
+        batch = self->free_batch;
+        self->free_batch = NULL;
+        if (self->release_batch && g_hash_table_size(self->release_batch)) {
+            const guint32 cmd = self->io->bc.release;
+            GByteArray* cmds = g_byte_array_sized_new
+                (g_atomic_int_get(&self->free_bytes));
+            GHashTableIter it;
+            gpointer key, value;
+
+            /* Releases go first, followed by the frees */
+            g_hash_table_iter_init(&it, self->release_batch);
+            while (g_hash_table_iter_next(&it, &key, &value)) {
+                const guint32 handle = GPOINTER_TO_UINT(key);
+                guint n = GPOINTER_TO_UINT(value);
+
+                while (n--) {
+                    GVERBOSE("< BC_RELEASE 0x%08x", handle);
+                    g_byte_array_append(cmds, (void*)&cmd, sizeof(cmd));
+                    g_byte_array_append(cmds, (void*)&handle,
+                        sizeof(handle));
+                }
+            }
+            g_hash_table_remove_all(self->release_batch);
+            if (batch) {
+                g_byte_array_append(cmds, batch->data, batch->len);
+                g_byte_array_unref(batch);
+            }
+            batch = cmds;
+        }
+        g_atomic_int_set(&self->free_bytes, 0);
+        g_mutex_unlock(&self->free_mutex);
+        /* Unlock */
+    }
+    return batch;
+}
+
+/*
+ * The receive buffer is only needed to read something from the driver,
+ * mapping it is postponed until the first BINDER_WRITE_READ. Processes
+ * which never get that far (e.g. because the service they are looking
+ * for isn't there) don't pay for it.
+ */
+static
+int
+gbinder_driver_map(
+    GBinderDriver* self)
+{
+    int err = 0;
+
+    if (G_UNLIKELY(!g_atomic_pointer_get(&self->vm))) {
+        /* Lock */
+        g_mutex_lock(&self->map_mutex);
+        if (self->fd < 0) {
+            err = (-EBADF);
+        } else if (!self->vm) {
+            const gint64 start = g_get_monotonic_time();
+            void* vm = gbinder_system_mmap(self->vmsize, PROT_READ,
+                MAP_PRIVATE | MAP_NORESERVE, self->fd);
+
+            if (vm != MAP_FAILED) {
+                GDEBUG("Mapped %u bytes of %s", (guint)self->vmsize,
+                    self->name);
+                g_atomic_pointer_set(&self->vm, vm);
+                gbinder_stats_startup(GBINDER_STATS_STARTUP_MMAP, start);
+            } else {
+                err = (-errno);
+                GERR("%s failed to mmap: %s", self->dev, strerror(errno));
+            }
+        }
+        g_mutex_unlock(&self->map_mutex);
+        /* Unlock */
+    }
+    return err;
+}
+
+static
+int
+gbinder_driver_io_write_read_prefixed(
+    GBinderDriver* self,
+    GByteArray* out,
+    GBinderIoBuf* write,
+    GBinderIoBuf* read)
+{
+    /* Prepend the deferred commands to whatever needs to be written */
+    const gsize deferred = out->len;
+    gsize done;
+    GBinderIoBuf buf;
+    int err;
+
+    if (write && write->size > write->consumed) {
+        g_byte_array_append(out, GSIZE_TO_POINTER(write->ptr +
+            write->consumed), write->size - write->consumed);
+    }
+    memset(&buf, 0, sizeof(buf));
+    buf.ptr = GPOINTER_TO_SIZE(out->data);
+    buf.size = out->len;
+    GVERBOSE("Writing %u bytes of deferred commands", (guint)deferred);
+    err = GBINDER_IO_CALL(self->io, write_read)(self->fd, &buf, read);
+
+    /* Figure out what's been consumed and what hasn't */
+    done = MIN(buf.consumed, deferred);
+    if (write && buf.consumed > deferred) {
+        write->consumed += buf.consumed - deferred;
+    }
+    g_byte_array_set_size(out, deferred);
+    if (err < 0 && err != (-EAGAIN)) {
+        GWARN("Dropping %u bytes of deferred commands",
+            (guint)(deferred - done));
+        g_byte_array_set_size(out, 0);
+    } else if (done) {
+        g_byte_array_remove_range(out, 0, done);
+    }
+    return err;
+}
+
+static
+int
+gbinder_driver_io_write_read(
+    GBinderDriver* self,
+    GBinderIoBuf* write,
+    GBinderIoBuf* read)
+{
+    GBinderDriverReadData* data;
+    GByteArray* frees;
+    const int map_err = gbinder_driver_map(self);
+
+    if (G_UNLIKELY(map_err)) {
+        return map_err;
+    }
+    data = gbinder_driver_deferred_data(self);
+    frees = gbinder_driver_free_batch_steal(self);
+    if (frees) {
+        if (data) {
+            /* Pending frees join the deferred commands */
+            if (data->deferred) {
+                g_byte_array_append(data->deferred, frees->data, frees->len);
+                g_byte_array_unref(frees);
+            } else {
+                data->deferred = frees;
+            }
+        } else {
+            /* Pending frees go first */
+            const int err = gbinder_driver_io_write_read_prefixed(self,
+                frees, write, read);
+
+            if (frees->len) {
+                /* Put back what hasn't been consumed */
+                gbinder_driver_free_batch_add(self, frees->data, frees->len);
+            }
+            g_byte_array_unref(frees);
+            return err;
+        }
+    }
+    if (data && data->deferred && data->deferred->len) {
+        return gbinder_driver_io_write_read_prefixed(self, data->deferred,
+            write, read);
+    } else {
+        return GBINDER_IO_CALL(self->io, write_read)(self->fd, write, read);
+    }
+}
+
 static
 int
 gbinder_driver_write(
@@ -236,13 +587,195 @@ gbinder_driver_write(
             buf->size - buf->consumed);
         GVERBOSE("gbinder_driver_write(%d) %u/%u", self->fd,
             (guint)buf->consumed, (guint)buf->size);
-        err = self->io->write_read(self->fd, buf, NULL);
+        err = gbinder_driver_io_write_read(self, buf, NULL);
         GVERBOSE("gbinder_driver_write(%d) %u/%u err %d", self->fd,
             (guint)buf->consumed, (guint)buf->size, err);
     }
     return err;
 }
 
+static
+int
+gbinder_driver_write_deferred(
+    GBinderDriver* self,
+    GBinderIoBuf* buf)
+{
+    /* Small commands get sent to the driver along with the next write */
+    if (gbinder_driver_defer(self, GSIZE_TO_POINTER(buf->ptr + buf->consumed),
+        buf->size - buf->consumed)) {
+        buf->consumed = buf->size;
+        return 0;
+    } else {
+        return gbinder_driver_write(self, buf);
+    }
+}
+
+static
+void
+gbinder_driver_flush(
+    GBinderDriver* self)
+{
+    GBinderDriverReadData* read = gbinder_driver_deferred_data(self);
+
+    if (read && read->deferred && read->deferred->len) {
+        GBinderIoBuf write;
+
+        /* Nothing but the deferred commands */
+        memset(&write, 0, sizeof(write));
+        gbinder_driver_write(self, &write);
+    }
+}
+
+static
+void
+gbinder_driver_free_batch_flush(
+    GBinderDriver* self)
+{
+    if (g_atomic_int_get(&self->free_bytes)) {
+        GBinderIoBuf write;
+
+        /* gbinder_driver_io_write_read() picks up the pending frees */
+        memset(&write, 0, sizeof(write));
+        gbinder_driver_write(self, &write);
+    }
+}
+
+static
+void
+gbinder_driver_free_batch_cb(
+    gpointer user_data)
+{
+    gbinder_driver_free_batch_flush((GBinderDriver*)user_data);
+}
+
+static
+void
+gbinder_driver_free_batch_kick(
+    GBinderDriver* self,
+    gboolean schedule,
+    gboolean flush)
+{
+    if (flush) {
+        gbinder_driver_free_batch_flush(self);
+    } else if (schedule) {
+        /* The rest of this event loop iteration gets a chance to join */
+        gbinder_idle_callback_invoke_later(gbinder_driver_free_batch_cb,
+            gbinder_driver_ref(self), (GDestroyNotify) gbinder_driver_unref);
+    }
+}
+
+static
+void
+gbinder_driver_free_batch_add(
+    GBinderDriver* self,
+    const void* cmd,
+    gsize len)
+{
+    gboolean schedule, flush;
+    gint bytes;
+
+    /* Lock */
+    g_mutex_lock(&self->free_mutex);
+    if (!self->free_batch) {
+        self->free_batch = g_byte_array_sized_new
+            (GBINDER_DRIVER_FREE_BATCH_SIZE);
+    }
+    bytes = g_atomic_int_get(&self->free_bytes);
+    schedule = !bytes;
+    g_byte_array_append(self->free_batch, cmd, len);
+    bytes += len;
+    flush = bytes >= GBINDER_DRIVER_FREE_BATCH_SIZE;
+    g_atomic_int_set(&self->free_bytes, bytes);
+    g_mutex_unlock(&self->free_mutex);
+    /* Unlock */
+
+    gbinder_driver_free_batch_kick(self, schedule, flush);
+}
+
+static
+void
+gbinder_driver_release_batch_add(
+    GBinderDriver* self,
+    guint32 handle)
+{
+    const gpointer key = GUINT_TO_POINTER(handle);
+    gboolean schedule, flush;
+    gint bytes;
+
+    /* Lock */
+    g_mutex_lock(&self->free_mutex);
+    if (!self->release_batch) {
+        self->release_batch = g_hash_table_new(g_direct_hash,
+            g_direct_equal);
+    }
+    g_hash_table_insert(self->release_batch, key, GUINT_TO_POINTER
+        (GPOINTER_TO_UINT(g_hash_table_lookup(self->release_batch, key)) +
+            1));
+    bytes = g_atomic_int_get(&self->free_bytes);
+    schedule = !bytes;
+    bytes += GBINDER_DRIVER_RELEASE_SIZE;
+    flush = bytes >= GBINDER_DRIVER_FREE_BATCH_SIZE;
+    g_atomic_int_set(&self->free_bytes, bytes);
+    g_mutex_unlock(&self->free_mutex);
+    /* Unlock */
+
+    gbinder_driver_free_batch_kick(self, schedule, flush);
+}
+
+static
+gboolean
+gbinder_driver_release_batch_cancel(
+    GBinderDriver* self,
+    guint32 handle)
+{
+    gboolean cancelled = FALSE;
+
+    if (g_atomic_int_get(&self->free_bytes)) {
+        /* Lock */
+        g_mutex_lock(&self->free_mutex);
+        if (self->release_batch) {
+            const gpointer key = GUINT_TO_POINTER(handle);
+            const guint n = GPOINTER_TO_UINT
+                (g_hash_table_lookup(self->release_batch, key));
+
+            if (n) {
+                if (n > 1) {
+                    g_hash_table_insert(self->release_batch, key,
+                        GUINT_TO_POINTER(n - 1));
+                } else {
+                    g_hash_table_remove(self->release_batch, key);
+                }
+                g_atomic_int_add(&self->free_bytes,
+                    -GBINDER_DRIVER_RELEASE_SIZE);
+                cancelled = TRUE;
+            }
+        }
+        g_mutex_unlock(&self->free_mutex);
+        /* Unlock */
+    }
+    return cancelled;
+}
+
+static
+void
+gbinder_driver_read_size_grow(
+    GBinderDriver* self,
+    gsize current)
+{
+    const gint size = g_atomic_int_get(&self->read_size);
+
+    /* Don't grow it twice because of the same buffer */
+    if (size < GBINDER_IO_READ_BUFFER_MAX_SIZE && current >= (gsize)size) {
+        const gint new_size = MIN(size * 2, GBINDER_IO_READ_BUFFER_MAX_SIZE);
+
+        if (g_atomic_int_compare_and_exchange(&self->read_size, size,
+            new_size)) {
+            GDEBUG("%s read buffer size %d => %d", self->name, size,
+                new_size);
+        }
+    }
+}
+
 static
 int
 gbinder_driver_write_read(
@@ -282,7 +815,7 @@ gbinder_driver_write_read(
                 (guint)(read ? read->size : 0));
         }
 #endif /* GUTIL_LOG_VERBOSE */
-        err = self->io->write_read(self->fd, write, read);
+        err = gbinder_driver_io_write_read(self, write, read);
 #if GUTIL_LOG_VERBOSE
         if (GLOG_ENABLED(GLOG_LEVEL_VERBOSE)) {
             GVERBOSE("gbinder_driver_write_read(%d) "
@@ -300,6 +833,21 @@ gbinder_driver_write_read(
 #endif /* GUTIL_LOG_VERBOSE */
     }
 
+    if (err >= 0) {
+        if ((read->size - read->consumed) < GBINDER_DRIVER_READ_FULL_MARGIN) {
+            /* The driver may have had more to say */
+            if (g_atomic_int_get(&self->tuning)) {
+                g_atomic_int_inc(&self->read_full);
+            }
+            if (++(rbuf->full) >= GBINDER_DRIVER_READ_GROW_THRESHOLD) {
+                rbuf->full = 0;
+                gbinder_driver_read_size_grow(self, rbuf->io.size);
+            }
+        } else {
+            rbuf->full = 0;
+        }
+    }
+
     if (rbuf->offset) {
         rbuf->io.consumed = rio.consumed + rbuf->offset;
     }
@@ -325,7 +873,8 @@ gboolean
 gbinder_driver_cmd_int32(
     GBinderDriver* self,
     guint32 cmd,
-    guint32 param)
+    guint32 param,
+    gboolean defer)
 {
     GBinderIoBuf write;
     guint32 data[2];
@@ -335,7 +884,8 @@ gbinder_driver_cmd_int32(
     memset(&write, 0, sizeof(write));
     write.ptr = (uintptr_t)data;
     write.size = sizeof(data);
-    return gbinder_driver_write(self, &write) >= 0;
+    return (defer ? gbinder_driver_write_deferred(self, &write) :
+        gbinder_driver_write(self, &write)) >= 0;
 }
 
 static
@@ -355,7 +905,8 @@ gbinder_driver_cmd_data(
     write.ptr = (uintptr_t)buf;
     write.size = 4 + _IOC_SIZE(cmd);
 
-    return gbinder_driver_write(self, &write) >= 0;
+    /* All these are replies to the driver, they can wait a bit */
+    return gbinder_driver_write_deferred(self, &write) >= 0;
 }
 
 static
@@ -372,23 +923,103 @@ gbinder_driver_handle_cookie(
     data[0] = cmd;
     memset(&write, 0, sizeof(write));
     write.ptr = (uintptr_t)buf;
-    write.size = 4 + self->io->encode_handle_cookie(data + 1, obj);
+    write.size = 4 + GBINDER_IO_CALL(self->io, encode_handle_cookie)
+        (data + 1, obj);
     return gbinder_driver_write(self, &write) >= 0;
 }
 
 static
 void
-gbinder_driver_read_init(
-    GBinderDriverReadData* read)
+gbinder_driver_read_data_free(
+    gpointer data)
+{
+    GBinderDriverReadData* read = data;
+
+    if (read->deferred) {
+        g_byte_array_unref(read->deferred);
+    }
+    g_free(read->data);
+    g_slice_free(GBinderDriverReadData, read);
+}
+
+static
+GBinderDriverReadData*
+gbinder_driver_read_data_new(
+    gsize size)
 {
+    GBinderDriverReadData* read = g_slice_new0(GBinderDriverReadData);
+
     /*
      * It shouldn't be necessary to zero-initialize the whole buffer
      * but valgrind complains about access to uninitialised data if
      * we don't do so. Oh well...
      */
-    memset(read, 0, sizeof(*read));
+    read->data = g_malloc0(size);
+    read->size = size;
+    return read;
+}
+
+static
+GBinderDriverReadData*
+gbinder_driver_read_data_acquire(
+    GBinderDriver* self)
+{
+    const gsize size = (gsize)g_atomic_int_get(&self->read_size);
+    GBinderDriverReadData* read = g_private_get(&gbinder_driver_read_data_key);
+
+    if (!read) {
+        /* The first one on this thread */
+        read = gbinder_driver_read_data_new(size);
+        g_private_set(&gbinder_driver_read_data_key, read);
+    } else if (read->busy) {
+        /* Nested transaction */
+        read = gbinder_driver_read_data_new(size);
+        read->nested = TRUE;
+    } else if (read->size < size) {
+        /* The buffer has no data in it, no need to preserve the contents */
+        g_free(read->data);
+        read->data = g_malloc0(size);
+        read->size = size;
+    }
+
+    if (!read->nested) {
+        /* Deferred commands are only collected by the outermost reader */
+        read->driver = self;
+    }
+    read->busy = TRUE;
     read->buf.io.ptr = GPOINTER_TO_SIZE(read->data);
-    read->buf.io.size = sizeof(read->data);
+    read->buf.io.size = read->size;
+    read->buf.io.consumed = 0;
+    read->buf.offset = 0;
+    return read;
+}
+
+void
+gbinder_driver_prepare_read(
+    GBinderDriver* self)
+{
+    /* Allocates the read buffer for the calling thread in advance */
+    if (G_LIKELY(self) && !g_private_get(&gbinder_driver_read_data_key)) {
+        g_private_set(&gbinder_driver_read_data_key,
+            gbinder_driver_read_data_new((gsize)
+                g_atomic_int_get(&self->read_size)));
+    }
+}
+
+static
+void
+gbinder_driver_read_data_release(
+    GBinderDriver* self,
+    GBinderDriverReadData* read)
+{
+    if (read->nested) {
+        gbinder_driver_read_data_free(read);
+    } else {
+        /* Don't leave anything behind */
+        gbinder_driver_flush(self);
+        read->driver = NULL;
+        read->busy = FALSE;
+    }
 }
 
 static
@@ -404,6 +1035,7 @@ gbinder_driver_context_init(
     context->handler = handler;
     context->unrefs = NULL;
     context->bufs = NULL;
+    context->deaths = NULL;
 }
 
 static
@@ -411,6 +1043,11 @@ void
 gbinder_driver_context_cleanup(
     GBinderDriverContext* context)
 {
+    if (context->deaths) {
+        /* All deaths collected by this read are reported in one go */
+        gbinder_remote_object_handle_death_notifications(context->deaths);
+        g_ptr_array_unref(context->deaths);
+    }
     gbinder_cleanup_free(context->unrefs);
     gbinder_buffer_contents_list_free(context->bufs);
 }
@@ -438,36 +1075,122 @@ gbinder_driver_next_command(
 }
 
 static
-gboolean
-gbinder_driver_reply_status(
+void*
+gbinder_driver_offsets_buf_init(
+    GBinderDriverOffsetsBuf* buf,
+    const GBinderIo* io,
+    GUtilIntArray* offsets)
+{
+    const guint count = offsets ? offsets->count : 0;
+
+    if (count * io->pointer_size <= sizeof(buf->stack)) {
+        buf->heap = NULL;
+        return buf->stack;
+    } else {
+        g_atomic_int_inc(&gbinder_driver_offsets_heap_allocs);
+        return (buf->heap = g_malloc(count * io->pointer_size));
+    }
+}
+
+static
+void
+gbinder_driver_offsets_buf_cleanup(
+    GBinderDriverOffsetsBuf* buf)
+{
+    g_free(buf->heap);
+}
+
+static
+int
+gbinder_driver_reply_write_read(
     GBinderDriver* self,
-    gint32 status)
+    GBinderDriverContext* context,
+    GBinderIoBuf* write)
+{
+    int err;
+
+    /*
+     * Send the reply and pick up BR_TRANSACTION_COMPLETE with the same
+     * BINDER_WRITE_READ. Whatever else the driver returns along with it
+     * (e.g. the next incoming transaction) stays in the read buffer and
+     * gets handled by the caller without another round trip.
+     */
+    do {
+        err = gbinder_driver_write_read(self, write, context->rbuf);
+        if (err >= 0) {
+            err = gbinder_driver_txstatus(self, context, NULL);
+        }
+    } while (err == (-EAGAIN));
+    return err;
+}
+
+static
+guint
+gbinder_driver_encode_status_reply(
+    const GBinderIo* io,
+    guint8* buf,
+    gint32* status)
 {
-    const GBinderIo* io = self->io;
-    GBinderIoBuf write;
-    guint8 buf[sizeof(guint32) + GBINDER_MAX_BC_TRANSACTION_SIZE];
-    guint8* ptr = buf;
     const guint32* code = &io->bc.reply;
 
     /* Command (this has to be slightly convoluted to avoid breaking
      * strict-aliasing rules.. oh well) */
     memcpy(buf, code, sizeof(*code));
-    ptr += sizeof(*code);
 
-    /* Data */
-    ptr += io->encode_status_reply(ptr, &status);
+    /* Data (the status must stay around until the reply is written) */
+    return sizeof(*code) +
+        GBINDER_IO_CALL(io, encode_status_reply)(buf + sizeof(*code), status);
+}
+
+static
+void
+gbinder_driver_status_reply_init(
+    GBinderDriver* self)
+{
+    guint i;
+
+    for (i = 0; i < GBINDER_DRIVER_CACHED_STATUS_COUNT; i++) {
+        GBinderDriverStatusReply* cached = self->status_reply + i;
+
+        cached->status = gbinder_driver_cached_status[i];
+        cached->len = gbinder_driver_encode_status_reply(self->io,
+            cached->cmd, &cached->status);
+    }
+}
+
+static
+int
+gbinder_driver_reply_status(
+    GBinderDriver* self,
+    GBinderDriverContext* context,
+    gint32 status)
+{
+    GBinderIoBuf write;
+    guint8 buf[sizeof(guint32) + GBINDER_MAX_BC_TRANSACTION_SIZE];
+    guint i;
 
     GVERBOSE("< BC_REPLY (%d)", status);
     memset(&write, 0, sizeof(write));
+    for (i = 0; i < GBINDER_DRIVER_CACHED_STATUS_COUNT; i++) {
+        const GBinderDriverStatusReply* cached = self->status_reply + i;
+
+        if (cached->status == status) {
+            write.ptr = (uintptr_t)cached->cmd;
+            write.size = cached->len;
+            return gbinder_driver_reply_write_read(self, context, &write);
+        }
+    }
+
     write.ptr = (uintptr_t)buf;
-    write.size = ptr - buf;
-    return gbinder_driver_write(self, &write) >= 0;
+    write.size = gbinder_driver_encode_status_reply(self->io, buf, &status);
+    return gbinder_driver_reply_write_read(self, context, &write);
 }
 
 static
-gboolean
+int
 gbinder_driver_reply_data(
     GBinderDriver* self,
+    GBinderDriverContext* context,
     GBinderOutputData* data)
 {
     GBinderIoBuf write;
@@ -478,21 +1201,27 @@ gbinder_driver_reply_data(
     guint len = sizeof(*cmd);
     int status;
     GUtilIntArray* offsets = gbinder_output_data_offsets(data);
-    void* offsets_buf = NULL;
+    GBinderDriverOffsetsBuf obuf;
+    void* offsets_buf = gbinder_driver_offsets_buf_init(&obuf, io, offsets);
+
+    if (g_atomic_int_get(&self->tuning)) {
+        g_atomic_int_inc(self->reply_sizes + MIN(g_bit_storage
+            (data->bytes->len), GBINDER_DRIVER_REPLY_BUCKETS - 1));
+    }
 
     /* Build BC_REPLY */
     if (extra_buffers) {
         GVERBOSE("< BC_REPLY_SG %u bytes", (guint)extra_buffers);
         gbinder_driver_verbose_dump_bytes(' ', data->bytes);
         *cmd = io->bc.reply_sg;
-        len += io->encode_reply_sg(buf + len, 0, 0, data->bytes,
-            offsets, &offsets_buf, extra_buffers);
+        len += GBINDER_IO_CALL(io, encode_reply_sg)(buf + len, 0, 0,
+            data->bytes, offsets, offsets_buf, extra_buffers);
     } else {
         GVERBOSE("< BC_REPLY");
         gbinder_driver_verbose_dump_bytes(' ', data->bytes);
         *cmd = io->bc.reply;
-        len += io->encode_reply(buf + len, 0, 0, data->bytes,
-            offsets, &offsets_buf);
+        len += GBINDER_IO_CALL(io, encode_reply)(buf + len, 0, 0, data->bytes,
+            offsets, offsets_buf);
     }
 
 #if 0 /* GUTIL_LOG_VERBOSE */
@@ -502,14 +1231,54 @@ gbinder_driver_reply_data(
     }
 #endif /* GUTIL_LOG_VERBOSE */
 
-    /* Write it */
+    /* Write it (the offsets must stay around until it's consumed) */
     write.ptr = (uintptr_t)buf;
     write.size = len;
     write.consumed = 0;
-    status = gbinder_driver_write(self, &write) >= 0;
+    status = gbinder_driver_reply_write_read(self, context, &write);
+
+    gbinder_driver_offsets_buf_cleanup(&obuf);
+    return status;
+}
+
+static
+guint64
+gbinder_driver_trace_id_new(
+    void)
+{
+    static gint seq = 0;
 
-    g_free(offsets_buf);
-    return status >= 0;
+    /* Process id in the upper half keeps them unique across processes */
+    return ((guint64)getpid() << 32) |
+        (guint32)(g_atomic_int_add(&seq, 1) + 1);
+}
+
+static
+guint64
+gbinder_driver_trace_strip(
+    GBinderIoTxData* tx)
+{
+    /* Returns zero (and leaves the data alone) if there's no trailer */
+    if (tx->data && tx->size >= sizeof(GBinderDriverTraceTrailer)) {
+        const gsize size = tx->size - sizeof(GBinderDriverTraceTrailer);
+        const guint8* end = (guint8*)tx->data + size;
+        GBinderDriverTraceTrailer trailer;
+
+        memcpy(&trailer, end, sizeof(trailer));
+        if (trailer.magic == GBINDER_DRIVER_TRACE_MAGIC && trailer.id) {
+            void** objects = tx->objects;
+
+            /* The trailer follows the objects, never overlaps them */
+            while (objects && *objects) {
+                if ((const guint8*)*objects++ >= end) {
+                    return 0;
+                }
+            }
+            tx->size = size;
+            return trailer.id;
+        }
+    }
+    return 0;
 }
 
 static
@@ -525,19 +1294,51 @@ gbinder_driver_handle_transaction(
     GBinderIoTxData tx;
     GBinderLocalObject* obj;
     const char* iface;
+    guint64 trace_id = 0;
     int txstatus = -EBADMSG;
 
-    self->io->decode_transaction_data(data, &tx);
+    GBINDER_IO_CALL(self->io, decode_transaction_data)(data, &tx);
     gbinder_driver_verbose_transaction_data("BR_TRANSACTION", &tx);
-    req = gbinder_remote_request_new(reg, self->protocol, tx.pid, tx.euid);
+    GBINDER_TRACE(tx_receive, (uintptr_t)tx.target, tx.code, tx.size, tx.data);
+    if (gbinder_capture_running()) {
+        gbinder_capture_incoming(self->io, tx.code, tx.flags, tx.data,
+            tx.size, tx.objects);
+    }
     obj = gbinder_object_registry_get_local(reg, tx.target);
+    if (!obj) {
+        /*
+         * Nothing is going to look at the data. Release the buffer
+         * right away and reject the call without building the request.
+         */
+        g_free(tx.objects);
+        gbinder_driver_free_buffer(self, tx.data);
+        if (!(tx.flags & GBINDER_TX_FLAG_ONEWAY)) {
+            GBINDER_TRACE(reply_send, (uintptr_t)tx.target, tx.code, 0,
+                tx.data);
+            gbinder_driver_reply_status(self, context, txstatus);
+        }
+        return;
+    }
+
+    if (self->trace_context) {
+        trace_id = gbinder_driver_trace_strip(&tx);
+        if (trace_id) {
+            GBINDER_TRACE_CONTEXT(tx_context_receive, (uintptr_t)tx.target,
+                tx.code, trace_id, tx.data);
+        }
+    }
+
+    req = gbinder_remote_request_new(reg, self->protocol, tx.pid, tx.euid);
+    gbinder_remote_request_set_trace_id(req, trace_id);
 
     /* Transfer data ownership to the request */
     if (tx.data && tx.size) {
-        GBinderBuffer* buf = gbinder_buffer_new(self,
-            tx.data, tx.size, tx.objects);
+        /* Oneway buffers can't be freed early, see gbinder_buffer.c */
+        GBinderBuffer* buf = (tx.flags & GBINDER_TX_FLAG_ONEWAY) ?
+            gbinder_buffer_new(self, tx.data, tx.size, tx.objects) :
+            gbinder_buffer_new_evictable(self, tx.data, tx.size, tx.objects);
 
-        gbinder_driver_verbose_dump(' ', (uintptr_t)tx.data, tx.size);
+        gbinder_driver_verbose_dump(' ', (uintptr_t)buf->data, tx.size);
         gbinder_remote_request_set_data(req, tx.code, buf);
         context->bufs = gbinder_buffer_contents_list_add(context->bufs,
             gbinder_buffer_contents(buf));
@@ -554,6 +1355,12 @@ gbinder_driver_handle_transaction(
             tx.code, tx.flags, &txstatus);
         break;
     case GBINDER_LOCAL_TRANSACTION_SUPPORTED:
+        /*
+         * The handler may take a while, don't keep the deferred
+         * commands waiting.
+         */
+        gbinder_driver_flush(self);
+
         /*
          * NULL GBinderHandler means that this is a synchronous call
          * executed on the main thread, meaning that we can call the
@@ -566,28 +1373,26 @@ gbinder_driver_handle_transaction(
                 tx.flags, &txstatus);
         break;
     default:
-        GWARN("Unhandled transaction %s 0x%08x from %s", iface, tx.code,
-            self->name);
+        GWARN_RATELIMITED("Unhandled transaction %s 0x%08x from %s", iface,
+            tx.code, self->name);
         break;
     }
 
     /* No reply for one-way transactions */
     if (!(tx.flags & GBINDER_TX_FLAG_ONEWAY)) {
         if (reply) {
+            GBinderOutputData* out = gbinder_local_reply_data(reply);
+
             context->bufs = gbinder_buffer_contents_list_add(context->bufs,
                 gbinder_local_reply_contents(reply));
-            gbinder_driver_reply_data(self, gbinder_local_reply_data(reply));
+            GBINDER_TRACE(reply_send, (uintptr_t)tx.target, tx.code,
+                out->bytes->len, tx.data);
+            gbinder_driver_reply_data(self, context, out);
         } else {
-            gbinder_driver_reply_status(self, txstatus);
+            GBINDER_TRACE(reply_send, (uintptr_t)tx.target, tx.code, 0,
+                tx.data);
+            gbinder_driver_reply_status(self, context, txstatus);
         }
-
-        /* Wait until the reply is handled */
-        do {
-            txstatus = gbinder_driver_write_read(self, NULL, context->rbuf);
-            if (txstatus >= 0) {
-                txstatus = gbinder_driver_txstatus(self, context, NULL);
-            }
-        } while (txstatus == (-EAGAIN));
     }
 
     /* Free the data allocated for the transaction */
@@ -637,12 +1442,13 @@ gbinder_driver_handle_command(
         GVERBOSE("> BR_TRANSACTION_COMPLETE (?)");
     } else if (cmd == io->br.spawn_looper) {
         GVERBOSE("> BR_SPAWN_LOOPER");
+        gbinder_handler_spawn_looper(context->handler);
     } else if (cmd == io->br.finished) {
         GVERBOSE("> BR_FINISHED");
     } else if (cmd == io->br.increfs) {
         guint8 buf[4 + GBINDER_MAX_PTR_COOKIE_SIZE];
         GBinderLocalObject* obj = gbinder_object_registry_get_local
-            (reg, io->decode_ptr_cookie(data));
+            (reg, GBINDER_IO_CALL(io, decode_ptr_cookie)(data));
 
         GVERBOSE("> BR_INCREFS %p", obj);
         gbinder_local_object_handle_increfs(obj);
@@ -651,7 +1457,7 @@ gbinder_driver_handle_command(
         gbinder_driver_cmd_data(self, io->bc.increfs_done, data, buf);
     } else if (cmd == io->br.decrefs) {
         GBinderLocalObject* obj = gbinder_object_registry_get_local
-            (reg, io->decode_ptr_cookie(data));
+            (reg, GBINDER_IO_CALL(io, decode_ptr_cookie)(data));
 
         GVERBOSE("> BR_DECREFS %p", obj);
         if (obj) {
@@ -665,7 +1471,7 @@ gbinder_driver_handle_command(
     } else if (cmd == io->br.acquire) {
         guint8 buf[4 + GBINDER_MAX_PTR_COOKIE_SIZE];
         GBinderLocalObject* obj = gbinder_object_registry_get_local
-            (reg, io->decode_ptr_cookie(data));
+            (reg, GBINDER_IO_CALL(io, decode_ptr_cookie)(data));
 
         GVERBOSE("> BR_ACQUIRE %p", obj);
         if (obj) {
@@ -679,7 +1485,7 @@ gbinder_driver_handle_command(
         }
     } else if (cmd == io->br.release) {
         GBinderLocalObject* obj = gbinder_object_registry_get_local
-            (reg, io->decode_ptr_cookie(data));
+            (reg, GBINDER_IO_CALL(io, decode_ptr_cookie)(data));
 
         GVERBOSE("> BR_RELEASE %p", obj);
         if (obj) {
@@ -696,14 +1502,17 @@ gbinder_driver_handle_command(
         guint64 handle = 0;
         GBinderRemoteObject* obj;
 
-        io->decode_cookie(data, &handle);
+        GBINDER_IO_CALL(io, decode_cookie)(data, &handle);
         GVERBOSE("> BR_DEAD_BINDER 0x%08llx", (long long unsigned int) handle);
         obj = gbinder_object_registry_get_remote(reg, (guint32)handle,
             REMOTE_REGISTRY_DONT_CREATE);
         if (obj) {
             /* BC_DEAD_BINDER_DONE will be sent after the request is handled */
-            gbinder_remote_object_handle_death_notification(obj);
-            gbinder_remote_object_unref(obj);
+            if (!context->deaths) {
+                context->deaths = g_ptr_array_new_with_free_func
+                    ((GDestroyNotify) gbinder_remote_object_unref);
+            }
+            g_ptr_array_add(context->deaths, obj);
         } else {
             guint8 buf[4 + GBINDER_MAX_COOKIE_SIZE];
 
@@ -717,14 +1526,14 @@ gbinder_driver_handle_command(
         if (GLOG_ENABLED(GLOG_LEVEL_VERBOSE)) {
             guint64 handle = 0;
 
-            io->decode_cookie(data, &handle);
+            GBINDER_IO_CALL(io, decode_cookie)(data, &handle);
             GVERBOSE("> BR_CLEAR_DEATH_NOTIFICATION_DONE 0x%08llx",
                 (long long unsigned int) handle);
         }
 #endif /* GUTIL_LOG_VERBOSE */
     } else {
 #pragma message("TODO: handle more commands from the driver")
-        GWARN("Unexpected command 0x%08x", cmd);
+        GWARN_RATELIMITED("Unexpected command 0x%08x", cmd);
     }
 }
 
@@ -750,12 +1559,14 @@ gbinder_driver_compact_read_buf(
 }
 
 static
-void
+gboolean
 gbinder_driver_handle_commands(
     GBinderDriver* self,
     GBinderDriverContext* context)
 {
     GBinderDriverReadBuf* rbuf = context->rbuf;
+    const guint32 noop = self->io->br.noop;
+    gboolean handled = FALSE;
     guint32 cmd;
 
     while ((cmd = gbinder_driver_next_command(self, rbuf)) != 0) {
@@ -766,9 +1577,15 @@ gbinder_driver_handle_commands(
         /* Handle this command */
         rbuf->offset += total;
         gbinder_driver_handle_command(self, context, cmd, data);
+        if (cmd != noop) {
+            handled = TRUE;
+        }
     }
 
     gbinder_driver_compact_read_buf(rbuf);
+
+    /* FALSE if there was nothing but BR_NOOP */
+    return handled;
 }
 
 static
@@ -806,18 +1623,38 @@ gbinder_driver_txstatus(
         } else if (cmd == io->br.failed_reply) {
             GVERBOSE("> BR_FAILED_REPLY");
             txstatus = GBINDER_STATUS_FAILED;
+        } else if (cmd == io->br.frozen_reply) {
+            /* The target process is frozen, retrying won't help */
+            GVERBOSE("> BR_FROZEN_REPLY");
+            txstatus = GBINDER_STATUS_FROZEN;
+        } else if (cmd == io->br.transaction_pending_frozen) {
+            /* Oneway transaction is queued until the target thaws */
+            GVERBOSE("> BR_TRANSACTION_PENDING_FROZEN");
+            if (!reply) {
+                txstatus = GBINDER_STATUS_OK;
+            }
+        } else if (cmd == io->br.oneway_spam_suspect) {
+            /* Delivered but we're sending too many oneway transactions */
+            GVERBOSE("> BR_ONEWAY_SPAM_SUSPECT");
+            if (self->oneway_spam_fn) {
+                self->oneway_spam_fn(self, self->oneway_spam_data);
+            }
+            if (!reply) {
+                txstatus = GBINDER_STATUS_OK;
+            }
         } else if (cmd == io->br.reply) {
             GBinderIoTxData tx;
 
-            io->decode_transaction_data(data, &tx);
+            GBINDER_IO_CALL(io, decode_transaction_data)(data, &tx);
             gbinder_driver_verbose_transaction_data("BR_REPLY", &tx);
 
             /* Transfer data ownership to the reply */
             if (tx.data && tx.size) {
-                GBinderBuffer* buf = gbinder_buffer_new(self,
+                GBinderBuffer* buf = gbinder_buffer_new_evictable(self,
                     tx.data, tx.size, tx.objects);
 
-                gbinder_driver_verbose_dump(' ', (uintptr_t)tx.data, tx.size);
+                gbinder_driver_verbose_dump(' ', (uintptr_t)buf->data,
+                    tx.size);
                 gbinder_remote_reply_set_data(reply, buf);
                 context->bufs = gbinder_buffer_contents_list_add(context->bufs,
                     gbinder_buffer_contents(buf));
@@ -837,6 +1674,7 @@ gbinder_driver_txstatus(
             case (-EAGAIN):
             case GBINDER_STATUS_FAILED:
             case GBINDER_STATUS_DEAD_OBJECT:
+            case GBINDER_STATUS_FROZEN:
                 txstatus = (-EFAULT);
                 GWARN("Replacing tx status %d with %d", tx.status, txstatus);
                 break;
@@ -853,6 +1691,20 @@ gbinder_driver_txstatus(
     return txstatus;
 }
 
+static
+gsize
+gbinder_driver_vm_size_for_device(
+    const char* dev)
+{
+    const long page_size = sysconf(_SC_PAGE_SIZE);
+    const int size = gbinder_config_get_device_int(
+        GBINDER_CONFIG_GROUP_MMAP_SIZE, dev, BINDER_VM_SIZE);
+
+    /* Round it up to the page size */
+    return GBINDER_DRIVER_ALIGN(CLAMP(size, page_size, BINDER_VM_MAX_SIZE),
+        page_size);
+}
+
 /*==========================================================================*
  * Interface
  *
@@ -865,7 +1717,9 @@ gbinder_driver_new(
     const char* dev,
     const GBinderRpcProtocol* protocol)
 {
+    const gint64 start = g_get_monotonic_time();
     const int fd = gbinder_system_open(dev, O_RDWR | O_CLOEXEC);
+
     if (fd >= 0) {
         gint32 version = 0;
 
@@ -874,45 +1728,72 @@ gbinder_driver_new(
 
             /* Decide which kernel we are dealing with */
             GDEBUG("Opened %s version %d", dev, version);
+#if GBINDER_IO_ABI
+            /* This build only supports one ABI */
+            if (version == GBINDER_IO_FIXED.version) {
+                io = &GBINDER_IO_FIXED;
+            } else {
+#else
             if (version == gbinder_io_32.version) {
                 io = &gbinder_io_32;
             } else if (version == gbinder_io_64.version) {
                 io = &gbinder_io_64;
             } else {
+#endif
                 GERR("%s unexpected version %d", dev, version);
             }
             if (io) {
-                /* mmap the binder, providing a chunk of virtual address
-                 * space to receive transactions. */
-                const gsize vmsize = BINDER_VM_SIZE;
-                void* vm = gbinder_system_mmap(vmsize, PROT_READ,
-                    MAP_PRIVATE | MAP_NORESERVE, fd);
-                if (vm != MAP_FAILED) {
-                    guint32 max_threads = DEFAULT_MAX_BINDER_THREADS;
-                    GBinderDriver* self = g_slice_new0(GBinderDriver);
-
-                    g_atomic_int_set(&self->refcount, 1);
-                    self->fd = fd;
-                    self->io = io;
-                    self->vm = vm;
-                    self->vmsize = vmsize;
-                    self->dev = g_strdup(dev);
-                    self->name = self->dev + /* Shorter version for logging */
-                        (g_str_has_prefix(self->dev, "/dev/") ? 5 : 0);
-
-                    if (gbinder_system_ioctl(fd, BINDER_SET_MAX_THREADS,
-                        &max_threads) < 0) {
-                        GERR("%s failed to set max threads (%u): %s", dev,
-                            max_threads, strerror(errno));
-                    }
-                    /* Choose the protocol based on the device name
-                     * if none is explicitly specified */
-                    self->protocol = protocol ? protocol :
-                        gbinder_rpc_protocol_for_device(dev);
-                    return self;
-                } else {
-                    GERR("%s failed to mmap: %s", dev, strerror(errno));
+                /* The chunk of virtual address space to receive
+                 * transactions gets mapped by gbinder_driver_map() */
+                const gsize vmsize = gbinder_driver_vm_size_for_device(dev);
+                guint32 max_threads = DEFAULT_MAX_BINDER_THREADS;
+                GBinderDriver* self = g_slice_new0(GBinderDriver);
+
+                g_atomic_int_set(&self->refcount, 1);
+                g_mutex_init(&self->free_mutex);
+                g_mutex_init(&self->map_mutex);
+                self->fd = fd;
+                self->io = io;
+                self->vmsize = vmsize;
+                self->dev = g_strdup(dev);
+                self->name = self->dev + /* Shorter version for logging */
+                    (g_str_has_prefix(self->dev, "/dev/") ? 5 : 0);
+                self->read_size = CLAMP(gbinder_config_get_device_int(
+                    GBINDER_CONFIG_GROUP_READ_BUFFER_SIZE, dev,
+                    GBINDER_IO_READ_BUFFER_SIZE),
+                    GBINDER_IO_READ_BUFFER_SIZE,
+                    GBINDER_IO_READ_BUFFER_MAX_SIZE);
+                self->read_size_min = self->read_size;
+
+                self->evict_watermark = vmsize / 100 *
+                    CLAMP(gbinder_config_get_device_int(
+                    GBINDER_CONFIG_GROUP_BUFFER_EVICT_WATERMARK, dev, 0),
+                    0, 100);
+                self->trace_context = gbinder_config_get_device_int(
+                    GBINDER_CONFIG_GROUP_TRACE_CONTEXT, dev, 0) > 0;
+
+                guint32 spam_detection = gbinder_config_get_device_int(
+                    GBINDER_CONFIG_GROUP_ONEWAY_SPAM_DETECTION, dev, 1);
+
+                if (gbinder_system_ioctl(fd, BINDER_SET_MAX_THREADS,
+                    &max_threads) < 0) {
+                    GERR("%s failed to set max threads (%u): %s", dev,
+                        max_threads, strerror(errno));
                 }
+                /* Older kernels don't know about this one */
+                if (spam_detection && gbinder_system_ioctl(fd,
+                    BINDER_ENABLE_ONEWAY_SPAM_DETECTION,
+                    &spam_detection) < 0) {
+                    GDEBUG("%s no oneway spam detection: %s", dev,
+                        strerror(errno));
+                }
+                /* Choose the protocol based on the device name
+                 * if none is explicitly specified */
+                self->protocol = protocol ? protocol :
+                    gbinder_rpc_protocol_for_device(dev);
+                gbinder_driver_status_reply_init(self);
+                gbinder_stats_startup(GBINDER_STATS_STARTUP_OPEN, start);
+                return self;
             }
         } else {
             GERR("Can't get binder version from %s: %s", dev, strerror(errno));
@@ -924,6 +1805,20 @@ gbinder_driver_new(
     return NULL;
 }
 
+/*
+ * The handler is invoked on whatever thread receives the notification,
+ * it must be set before and cleared after the transactions.
+ */
+void
+gbinder_driver_set_oneway_spam_handler(
+    GBinderDriver* self,
+    GBinderDriverFunc func,
+    void* user_data)
+{
+    self->oneway_spam_fn = func;
+    self->oneway_spam_data = user_data;
+}
+
 GBinderDriver*
 gbinder_driver_ref(
     GBinderDriver* self)
@@ -940,6 +1835,14 @@ gbinder_driver_unref(
     GASSERT(self->refcount > 0);
     if (g_atomic_int_dec_and_test(&self->refcount)) {
         gbinder_driver_close(self);
+        if (self->free_batch) {
+            g_byte_array_unref(self->free_batch);
+        }
+        if (self->release_batch) {
+            g_hash_table_destroy(self->release_batch);
+        }
+        g_mutex_clear(&self->free_mutex);
+        g_mutex_clear(&self->map_mutex);
         g_free(self->dev);
         g_slice_free(GBinderDriver, self);
     }
@@ -949,9 +1852,16 @@ void
 gbinder_driver_close(
     GBinderDriver* self)
 {
-    if (self->vm) {
+    if (self->fd >= 0) {
         GDEBUG("Closing %s", self->dev);
-        gbinder_system_munmap(self->vm, self->vmsize);
+        gbinder_driver_free_batch_flush(self);
+        /* Lock */
+        g_mutex_lock(&self->map_mutex);
+        if (self->vm) {
+            gbinder_system_munmap(self->vm, self->vmsize);
+        }
+        g_mutex_unlock(&self->map_mutex);
+        /* Unlock */
         gbinder_system_close(self->fd);
         self->fd = -1;
         self->vm = NULL;
@@ -967,10 +1877,202 @@ gbinder_driver_fd(
     return self->fd;
 }
 
+gsize
+gbinder_driver_read_buffer_size(
+    GBinderDriver* self)
+{
+    /* Only used by unit tests */
+    return g_atomic_int_get(&self->read_size);
+}
+
+void
+gbinder_driver_set_tuning(
+    GBinderDriver* self,
+    gboolean enable)
+{
+    g_atomic_int_set(&self->tuning, enable != FALSE);
+}
+
+guint
+gbinder_driver_read_full_count(
+    GBinderDriver* self)
+{
+    /* Returns the count and starts counting from zero */
+    return g_atomic_int_and(&self->read_full, 0);
+}
+
+gsize
+gbinder_driver_shrink_read_buffer(
+    GBinderDriver* self)
+{
+    const gint size = g_atomic_int_get(&self->read_size);
+
+    /* Returns the new size or zero if it's already at the minimum */
+    if (size > self->read_size_min) {
+        const gint new_size = MAX(size / 2, self->read_size_min);
+
+        if (g_atomic_int_compare_and_exchange(&self->read_size, size,
+            new_size)) {
+            GDEBUG("%s read buffer size %d => %d", self->name, size,
+                new_size);
+            return new_size;
+        }
+    }
+    return 0;
+}
+
+gsize
+gbinder_driver_reply_size_hint(
+    GBinderDriver* self)
+{
+    guint counts[GBINDER_DRIVER_REPLY_BUCKETS];
+    guint total = 0;
+    int i;
+
+    /* Each call looks at the replies sent since the previous one */
+    for (i = 0; i < GBINDER_DRIVER_REPLY_BUCKETS; i++) {
+        total += (counts[i] = g_atomic_int_and(self->reply_sizes + i, 0));
+    }
+    if (total >= GBINDER_DRIVER_REPLY_MIN_SAMPLES) {
+        const guint enough = (guint)((guint64)total *
+            GBINDER_DRIVER_REPLY_HINT / 100);
+        guint sum = 0;
+
+        for (i = 0; i < GBINDER_DRIVER_REPLY_BUCKETS - 1; i++) {
+            if ((sum += counts[i]) >= enough) {
+                break;
+            }
+        }
+        /* Bucket i holds the sizes below (1 << i) */
+        return (gsize)1 << i;
+    }
+    return 0;
+}
+
+guint
+gbinder_driver_offsets_allocs(
+    void)
+{
+    /* Only used by unit tests */
+    return g_atomic_int_get(&gbinder_driver_offsets_heap_allocs);
+}
+
+gboolean
+gbinder_driver_set_max_threads(
+    GBinderDriver* self,
+    guint32 max_threads)
+{
+    /* Number of loopers the kernel may ask us to spawn */
+    if (gbinder_system_ioctl(self->fd, BINDER_SET_MAX_THREADS,
+        &max_threads) >= 0) {
+        return TRUE;
+    } else {
+        GERR("%s failed to set max threads (%u): %s", self->dev,
+            max_threads, strerror(errno));
+        return FALSE;
+    }
+}
+
+gsize
+gbinder_driver_vm_size(
+    GBinderDriver* self)
+{
+    return self->vmsize;
+}
+
+gsize
+gbinder_driver_pinned_size(
+    GBinderDriver* self)
+{
+    return g_atomic_int_get(&self->pinned);
+}
+
+/*
+ * TRUE if the buffers which can be copied to the heap (and freed right
+ * away) should be copied, because the amount of memory held in the
+ * mapping has crossed the configured watermark.
+ */
+gboolean
+gbinder_driver_mapping_pressure(
+    GBinderDriver* self)
+{
+    return self->evict_watermark &&
+        (gsize)g_atomic_int_get(&self->pinned) > self->evict_watermark;
+}
+
+gsize
+gbinder_driver_pin_buffer(
+    GBinderDriver* self,
+    const void* buffer,
+    gsize size,
+    void** objects,
+    guint* fd_count)
+{
+    /*
+     * Estimates the amount of the mapped space occupied by the buffer,
+     * roughly the way the kernel does it - data, offsets and extra data
+     * (scatter-gather buffers), each one aligned at the pointer size.
+     * Fd arrays live inside their parent buffers and get counted twice,
+     * we can live with that.
+     *
+     * Since we are walking the objects anyway, count the fds so that
+     * gbinder_driver_close_fds doesn't have to walk them again when
+     * there's nothing to close (which is normally the case).
+     */
+    const GBinderIo* io = self->io;
+    const guint align = io->pointer_size;
+    const guint8* end = (const guint8*)buffer + size;
+    gsize offsets = 0, extra = 0;
+    gsize pinned;
+    guint fds = 0;
+
+    if (objects) {
+        void** ptr;
+
+        for (ptr = objects; *ptr; ptr++) {
+            const guint8* obj = *ptr;
+
+            offsets += io->pointer_size;
+            extra += GBINDER_DRIVER_ALIGN
+                (GBINDER_IO_CALL(io, object_data_size)(obj), 8);
+            if (obj < end && GBINDER_IO_CALL(io, decode_fd_object)
+                (obj, end - obj, NULL)) {
+                fds++;
+            }
+        }
+    }
+    if (fd_count) {
+        *fd_count = fds;
+    }
+    pinned = GBINDER_DRIVER_ALIGN(size, align) +
+        GBINDER_DRIVER_ALIGN(offsets, align) +
+        GBINDER_DRIVER_ALIGN(extra, align);
+    g_atomic_int_add(&self->pinned, (gint)pinned);
+    return pinned;
+}
+
+void
+gbinder_driver_unpin_buffer(
+    GBinderDriver* self,
+    gsize pinned)
+{
+    GASSERT(g_atomic_int_get(&self->pinned) >= (gint)pinned);
+    g_atomic_int_add(&self->pinned, -(gint)pinned);
+}
+
 int
 gbinder_driver_poll(
     GBinderDriver* self,
     struct pollfd* pipefd)
+{
+    return gbinder_driver_poll_timeout(self, pipefd, -1);
+}
+
+int
+gbinder_driver_poll_timeout(
+    GBinderDriver* self,
+    struct pollfd* pipefd,
+    int timeout_ms)
 {
     struct pollfd fds[2];
     nfds_t n = 1;
@@ -986,7 +2088,7 @@ gbinder_driver_poll(
         n++;
     }
 
-    err = poll(fds, n, -1);
+    err = poll(fds, n, timeout_ms);
     if (err >= 0) {
         if (pipefd) {
             pipefd->revents = fds[1].revents;
@@ -1000,6 +2102,27 @@ gbinder_driver_poll(
     return err;
 }
 
+void
+gbinder_driver_kick(
+    GBinderDriver* self)
+{
+    /*
+     * Closing any descriptor referring to the binder file makes the
+     * kernel flush it, i.e. kick all the threads of this process out
+     * of BINDER_WRITE_READ. Those which are blocked waiting for work
+     * come back with BR_NOOP, the rest don't notice anything.
+     */
+    if (self->fd >= 0) {
+        const int fd = dup(self->fd);
+
+        if (fd >= 0) {
+            close(fd);
+        } else {
+            GWARN("Failed to kick %s: %s", self->dev, strerror(errno));
+        }
+    }
+}
+
 const char*
 gbinder_driver_dev(
     GBinderDriver* self)
@@ -1034,33 +2157,53 @@ gbinder_driver_acquire_done(
     data[0] = io->bc.acquire_done;
     memset(&write, 0, sizeof(write));
     write.ptr = (uintptr_t)buf;
-    write.size = 4 + io->encode_ptr_cookie(data + 1, obj);
+    write.size = 4 + GBINDER_IO_CALL(io, encode_ptr_cookie)(data + 1, obj);
 
     GVERBOSE("< BC_ACQUIRE_DONE %p", obj);
-    return gbinder_driver_write(self, &write) >= 0;
+    return gbinder_driver_write_deferred(self, &write) >= 0;
 }
 
 gboolean
-gbinder_driver_dead_binder_done(
+gbinder_driver_dead_binders_done(
     GBinderDriver* self,
-    GBinderRemoteObject* obj)
+    const guint32* handles,
+    const gboolean* release,
+    guint count)
 {
-    if (G_LIKELY(obj)) {
-        GBinderIoBuf write;
-        guint8 buf[4 + GBINDER_MAX_COOKIE_SIZE];
-        guint32* data = (guint32*)buf;
+    if (G_LIKELY(self) && count) {
         const GBinderIo* io = self->io;
+        GByteArray* cmds = g_byte_array_sized_new(count *
+            (8 + 4 + GBINDER_MAX_COOKIE_SIZE));
+        GBinderIoBuf write;
+        gboolean ok;
+        guint i;
 
-        data[0] = io->bc.dead_binder_done;
-        memset(&write, 0, sizeof(write));
-        write.ptr = (uintptr_t)buf;
-        write.size = 4 + io->encode_cookie(data + 1, obj->handle);
+        /* BC_RELEASE (if necessary) followed by BC_DEAD_BINDER_DONE */
+        for (i = 0; i < count; i++) {
+            guint8 buf[4 + GBINDER_MAX_COOKIE_SIZE];
+            guint32* data = (guint32*)buf;
 
-        GVERBOSE("< BC_DEAD_BINDER_DONE 0x%08x", obj->handle);
-        return gbinder_driver_write(self, &write) >= 0;
-    } else {
-        return FALSE;
+            if (release[i]) {
+                data[0] = io->bc.release;
+                data[1] = handles[i];
+                GVERBOSE("< BC_RELEASE 0x%08x", handles[i]);
+                g_byte_array_append(cmds, buf, 8);
+            }
+            data[0] = io->bc.dead_binder_done;
+            GVERBOSE("< BC_DEAD_BINDER_DONE 0x%08x", handles[i]);
+            g_byte_array_append(cmds, buf, 4 +
+                GBINDER_IO_CALL(io, encode_cookie)(data + 1, handles[i]));
+        }
+
+        /* All of that goes to the driver with a single ioctl */
+        memset(&write, 0, sizeof(write));
+        write.ptr = (uintptr_t)cmds->data;
+        write.size = cmds->len;
+        ok = gbinder_driver_write_deferred(self, &write) >= 0;
+        g_byte_array_unref(cmds);
+        return ok;
     }
+    return FALSE;
 }
 
 gboolean
@@ -1097,7 +2240,7 @@ gbinder_driver_increfs(
     guint32 handle)
 {
     GVERBOSE("< BC_INCREFS 0x%08x", handle);
-    return gbinder_driver_cmd_int32(self, self->io->bc.increfs, handle);
+    return gbinder_driver_cmd_int32(self, self->io->bc.increfs, handle, FALSE);
 }
 
 gboolean
@@ -1106,7 +2249,7 @@ gbinder_driver_decrefs(
     guint32 handle)
 {
     GVERBOSE("< BC_DECREFS 0x%08x", handle);
-    return gbinder_driver_cmd_int32(self, self->io->bc.decrefs, handle);
+    return gbinder_driver_cmd_int32(self, self->io->bc.decrefs, handle, TRUE);
 }
 
 gboolean
@@ -1114,8 +2257,14 @@ gbinder_driver_acquire(
     GBinderDriver* self,
     guint32 handle)
 {
-    GVERBOSE("< BC_ACQUIRE 0x%08x", handle);
-    return gbinder_driver_cmd_int32(self, self->io->bc.acquire, handle);
+    if (gbinder_driver_release_batch_cancel(self, handle)) {
+        GVERBOSE("< BC_ACQUIRE 0x%08x (cancels BC_RELEASE)", handle);
+        return TRUE;
+    } else {
+        GVERBOSE("< BC_ACQUIRE 0x%08x", handle);
+        return gbinder_driver_cmd_int32(self, self->io->bc.acquire, handle,
+            FALSE);
+    }
 }
 
 gboolean
@@ -1123,15 +2272,18 @@ gbinder_driver_release(
     GBinderDriver* self,
     guint32 handle)
 {
-    GVERBOSE("< BC_RELEASE 0x%08x", handle);
-    return gbinder_driver_cmd_int32(self, self->io->bc.release, handle);
+    /* BC_RELEASE gets written later, unless cancelled by BC_ACQUIRE */
+    gbinder_driver_release_batch_add(self, handle);
+    return TRUE;
 }
 
 void
 gbinder_driver_close_fds(
     GBinderDriver* self,
     void** objects,
-    const void* end)
+    const void* end,
+    const void* const* skip,
+    guint skip_count)
 {
     const GBinderIo* io = self->io;
     void** ptr;
@@ -1142,9 +2294,17 @@ gbinder_driver_close_fds(
 
         GASSERT(obj < end);
         if (obj < end) {
+            guint i;
             int fd;
 
-            if (io->decode_fd_object(obj, (guint8*)end - (guint8*)obj, &fd)) {
+            /* Skip the ones which have been taken by the reader */
+            for (i = 0; i < skip_count && skip[i] != obj; i++);
+            if (i < skip_count) {
+                continue;
+            }
+
+            if (GBINDER_IO_CALL(io, decode_fd_object)
+                (obj, (guint8*)end - (guint8*)obj, &fd)) {
                 if (close(fd) < 0) {
                     GWARN("Error closing fd %d: %s", fd, strerror(errno));
                 }
@@ -1159,21 +2319,20 @@ gbinder_driver_free_buffer(
     void* buffer)
 {
     if (buffer) {
-        GBinderIoBuf write;
         const GBinderIo* io = self->io;
         guint8 wbuf[GBINDER_MAX_POINTER_SIZE + sizeof(guint32)];
         guint32* cmd = (guint32*)wbuf;
         guint len = sizeof(*cmd);
 
         GVERBOSE("< BC_FREE_BUFFER %p", buffer);
+        GBINDER_TRACE(buffer_free, 0, 0, 0, buffer);
         *cmd = io->bc.free_buffer;
-        len += io->encode_pointer(wbuf + len, buffer);
+        len += GBINDER_IO_CALL(io, encode_pointer)(wbuf + len, buffer);
 
-        /* Write it */
-        write.ptr = (uintptr_t)wbuf;
-        write.size = len;
-        write.consumed = 0;
-        gbinder_driver_write(self, &write);
+        /* Defer it or add it to the batch */
+        if (!gbinder_driver_defer(self, wbuf, len)) {
+            gbinder_driver_free_batch_add(self, wbuf, len);
+        }
     }
 }
 
@@ -1185,6 +2344,14 @@ gbinder_driver_enter_looper(
     return gbinder_driver_cmd(self, self->io->bc.enter_looper);
 }
 
+gboolean
+gbinder_driver_register_looper(
+    GBinderDriver* self)
+{
+    GVERBOSE("< BC_REGISTER_LOOPER");
+    return gbinder_driver_cmd(self, self->io->bc.register_looper);
+}
+
 gboolean
 gbinder_driver_exit_looper(
     GBinderDriver* self)
@@ -1193,23 +2360,24 @@ gbinder_driver_exit_looper(
     return gbinder_driver_cmd(self, self->io->bc.exit_looper);
 }
 
+static
 int
-gbinder_driver_read(
+gbinder_driver_read_commands(
     GBinderDriver* self,
     GBinderObjectRegistry* reg,
-    GBinderHandler* handler)
+    GBinderHandler* handler,
+    gboolean* handled)
 {
-    GBinderDriverReadData read;
+    GBinderDriverReadData* read = gbinder_driver_read_data_acquire(self);
     GBinderDriverContext context;
     int ret;
 
-    gbinder_driver_read_init(&read);
-    gbinder_driver_context_init(&context, &read.buf, reg, handler);
+    gbinder_driver_context_init(&context, &read->buf, reg, handler);
     ret = gbinder_driver_write_read(self, NULL, context.rbuf);
     if (ret >= 0) {
         /* Loop until we have handled all the incoming commands */
-        gbinder_driver_handle_commands(self, &context);
-        while (read.buf.io.consumed && gbinder_handler_can_loop(handler)) {
+        *handled = gbinder_driver_handle_commands(self, &context);
+        while (read->buf.io.consumed && gbinder_handler_can_loop(handler)) {
             ret = gbinder_driver_write_read(self, NULL, context.rbuf);
             if (ret >= 0) {
                 gbinder_driver_handle_commands(self, &context);
@@ -1219,9 +2387,38 @@ gbinder_driver_read(
         }
     }
     gbinder_driver_context_cleanup(&context);
+    gbinder_driver_read_data_release(self, read);
     return ret;
 }
 
+int
+gbinder_driver_read(
+    GBinderDriver* self,
+    GBinderObjectRegistry* reg,
+    GBinderHandler* handler)
+{
+    gboolean handled;
+
+    return gbinder_driver_read_commands(self, reg, handler, &handled);
+}
+
+int
+gbinder_driver_read_blocking(
+    GBinderDriver* self,
+    GBinderObjectRegistry* reg,
+    GBinderHandler* handler)
+{
+    gboolean handled = FALSE;
+    const int ret = gbinder_driver_read_commands(self, reg, handler, &handled);
+
+    /*
+     * The file descriptor is blocking, so this doesn't return until the
+     * driver has something to say. Zero means that it came back with
+     * nothing but BR_NOOP (e.g. woken up by gbinder_driver_kick).
+     */
+    return (ret < 0) ? ret : handled ? 1 : 0;
+}
+
 int
 gbinder_driver_transact(
     GBinderDriver* self,
@@ -1232,23 +2429,44 @@ gbinder_driver_transact(
     GBinderLocalRequest* req,
     GBinderRemoteReply* reply)
 {
-    GBinderDriverReadData read;
+    GBinderDriverReadData* read = gbinder_driver_read_data_acquire(self);
     GBinderDriverContext context;
     GBinderIoBuf write;
-    GBinderDriverReadBuf* rbuf = &read.buf;
+    GBinderDriverReadBuf* rbuf = &read->buf;
     const GBinderIo* io = self->io;
     const guint flags = reply ? 0 : GBINDER_TX_FLAG_ONEWAY;
     GBinderOutputData* data = gbinder_local_request_data(req);
     const gsize extra_buffers = gbinder_output_data_buffers_size(data);
     GUtilIntArray* offsets = gbinder_output_data_offsets(data);
-    void* offsets_buf = NULL;
+    GBinderDriverOffsetsBuf obuf;
+    void* offsets_buf = gbinder_driver_offsets_buf_init(&obuf, io, offsets);
     guint8 wbuf[GBINDER_MAX_BC_TRANSACTION_SG_SIZE + sizeof(guint32)];
     guint32* cmd = (guint32*)wbuf;
     guint len = sizeof(*cmd);
+    GByteArray* bytes = data->bytes;
+    GByteArray* traced = NULL;
     int txstatus = (-EAGAIN);
 
-    gbinder_driver_read_init(&read);
-    gbinder_driver_context_init(&context, &read.buf, reg, handler);
+    gbinder_driver_context_init(&context, rbuf, reg, handler);
+
+    if (self->trace_context) {
+        GBinderDriverTraceTrailer trailer;
+
+        trailer.id = gbinder_local_request_trace_id(req);
+        if (!trailer.id) {
+            trailer.id = gbinder_driver_trace_id_new();
+        }
+        trailer.reserved = 0;
+        trailer.magic = GBINDER_DRIVER_TRACE_MAGIC;
+
+        /* The request may be shared, the trailer is appended to a copy */
+        traced = g_byte_array_sized_new(bytes->len + sizeof(trailer));
+        g_byte_array_append(traced, bytes->data, bytes->len);
+        g_byte_array_append(traced, (const void*)&trailer, sizeof(trailer));
+        bytes = traced;
+        GBINDER_TRACE_CONTEXT(tx_context_send, handle, code, trailer.id,
+            data->bytes->data);
+    }
 
     /* Build BC_TRANSACTION */
     if (extra_buffers) {
@@ -1256,14 +2474,15 @@ gbinder_driver_transact(
             (guint)extra_buffers);
         gbinder_driver_verbose_dump_bytes(' ', data->bytes);
         *cmd = io->bc.transaction_sg;
-        len += io->encode_transaction_sg(wbuf + len, handle, code,
-            data->bytes, flags, offsets, &offsets_buf, extra_buffers);
+        len += GBINDER_IO_CALL(io, encode_transaction_sg)(wbuf + len,
+            handle, code, bytes, flags, offsets, offsets_buf,
+            extra_buffers);
     } else {
         GVERBOSE("< BC_TRANSACTION 0x%08x 0x%08x", handle, code);
         gbinder_driver_verbose_dump_bytes(' ', data->bytes);
         *cmd = io->bc.transaction;
-        len += io->encode_transaction(wbuf + len, handle, code,
-            data->bytes, flags, offsets, &offsets_buf);
+        len += GBINDER_IO_CALL(io, encode_transaction)(wbuf + len,
+            handle, code, bytes, flags, offsets, offsets_buf);
     }
 
 #if 0 /* GUTIL_LOG_VERBOSE */
@@ -1277,6 +2496,11 @@ gbinder_driver_transact(
     write.ptr = (uintptr_t)wbuf;
     write.size = len;
     write.consumed = 0;
+    GBINDER_TRACE(tx_send, handle, code, data->bytes->len, data->bytes->data);
+    if (gbinder_capture_running()) {
+        gbinder_capture_outgoing(io, handle, code, flags, data->bytes,
+            offsets);
+    }
 
     /* And wait for reply. Positive txstatus is the transaction status,
      * negative is a driver error (except for -EAGAIN meaning that there's
@@ -1308,7 +2532,12 @@ gbinder_driver_transact(
     }
 
     gbinder_driver_context_cleanup(&context);
-    g_free(offsets_buf);
+    gbinder_driver_read_data_release(self, read);
+    gbinder_driver_offsets_buf_cleanup(&obuf);
+    if (traced) {
+        g_byte_array_free(traced, TRUE);
+    }
+    GBINDER_TRACE(tx_done, handle, code, txstatus, data->bytes->data);
     return txstatus;
 }
 
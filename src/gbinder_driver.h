@@ -37,12 +37,38 @@
 
 struct pollfd;
 
+/*
+ * Trace context trailer. When TraceContext is enabled for the device,
+ * it's appended to the outgoing transaction data and stripped from the
+ * incoming data (if it's there) before anyone gets to look at it.
+ */
+typedef struct gbinder_driver_trace_trailer {
+    guint64 id;
+    guint32 reserved;
+    guint32 magic;
+} GBinderDriverTraceTrailer;
+
+#define GBINDER_DRIVER_TRACE_MAGIC (0x43544247) /* "GBTC" */
+
+typedef
+void
+(*GBinderDriverFunc)(
+    GBinderDriver* driver,
+    void* user_data);
+
 GBinderDriver*
 gbinder_driver_new(
     const char* dev,
     const GBinderRpcProtocol* protocol)
     GBINDER_INTERNAL;
 
+void
+gbinder_driver_set_oneway_spam_handler(
+    GBinderDriver* driver,
+    GBinderDriverFunc func,
+    void* user_data)
+    GBINDER_INTERNAL;
+
 GBinderDriver*
 gbinder_driver_ref(
     GBinderDriver* driver)
@@ -63,12 +89,98 @@ gbinder_driver_fd(
     GBinderDriver* driver)
     GBINDER_INTERNAL;
 
+gsize
+gbinder_driver_read_buffer_size(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
+/* Counting for the runtime tuning, see gbinder_ipc.c */
+void
+gbinder_driver_set_tuning(
+    GBinderDriver* driver,
+    gboolean enable)
+    GBINDER_INTERNAL;
+
+guint
+gbinder_driver_read_full_count(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
+gsize
+gbinder_driver_shrink_read_buffer(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
+gsize
+gbinder_driver_reply_size_hint(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
+guint
+gbinder_driver_offsets_allocs(
+    void)
+    GBINDER_INTERNAL;
+
+gsize
+gbinder_driver_vm_size(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
+gsize
+gbinder_driver_pinned_size(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
+gboolean
+gbinder_driver_mapping_pressure(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
+/* Also counts the fd objects which need to be closed with the buffer */
+gsize
+gbinder_driver_pin_buffer(
+    GBinderDriver* driver,
+    const void* buffer,
+    gsize size,
+    void** objects,
+    guint* fd_count)
+    GBINDER_INTERNAL;
+
+void
+gbinder_driver_unpin_buffer(
+    GBinderDriver* driver,
+    gsize pinned)
+    GBINDER_INTERNAL;
+
+gboolean
+gbinder_driver_set_max_threads(
+    GBinderDriver* driver,
+    guint32 max_threads)
+    GBINDER_INTERNAL;
+
+void
+gbinder_driver_prepare_read(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
 int
 gbinder_driver_poll(
     GBinderDriver* driver,
     struct pollfd* pollfd)
     GBINDER_INTERNAL;
 
+int
+gbinder_driver_poll_timeout(
+    GBinderDriver* driver,
+    struct pollfd* pollfd,
+    int timeout_ms)
+    GBINDER_INTERNAL;
+
+void
+gbinder_driver_kick(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
 const char*
 gbinder_driver_dev(
     GBinderDriver* driver)
@@ -91,9 +203,11 @@ gbinder_driver_acquire_done(
     GBINDER_INTERNAL;
 
 gboolean
-gbinder_driver_dead_binder_done(
+gbinder_driver_dead_binders_done(
     GBinderDriver* driver,
-    GBinderRemoteObject* obj)
+    const guint32* handles,
+    const gboolean* release,
+    guint count)
     GBINDER_INTERNAL;
 
 gboolean
@@ -136,7 +250,9 @@ void
 gbinder_driver_close_fds(
     GBinderDriver* driver,
     void** objects,
-    const void* end)
+    const void* end,
+    const void* const* skip,
+    guint skip_count)
     GBINDER_INTERNAL;
 
 void
@@ -150,6 +266,11 @@ gbinder_driver_enter_looper(
     GBinderDriver* driver)
     GBINDER_INTERNAL;
 
+gboolean
+gbinder_driver_register_looper(
+    GBinderDriver* driver)
+    GBINDER_INTERNAL;
+
 gboolean
 gbinder_driver_exit_looper(
     GBinderDriver* driver)
@@ -162,6 +283,13 @@ gbinder_driver_read(
     GBinderHandler* handler)
     GBINDER_INTERNAL;
 
+int
+gbinder_driver_read_blocking(
+    GBinderDriver* driver,
+    GBinderObjectRegistry* reg,
+    GBinderHandler* handler)
+    GBINDER_INTERNAL;
+
 int
 gbinder_driver_transact(
     GBinderDriver* driver,
@@ -31,6 +31,7 @@
  */
 
 #include "gbinder_eventloop_p.h"
+#include "gbinder_config.h"
 
 #include <gutil_macros.h>
 
@@ -51,7 +52,7 @@ static const GBinderEventLoopIntegration gbinder_eventloop_glib;
 
 typedef struct gbinder_eventloop_glib_timeout {
     GBinderEventLoopTimeout timeout;
-    guint id;
+    GSource* source;
     GSourceFunc func;
     gpointer data;
 } GBinderEventLoopTimeoutGLib;
@@ -61,6 +62,12 @@ typedef struct gbinder_eventloop_glib_callback {
     GBinderEventLoopCallback callback;
 } GBinderEventLoopCallbackGLib;
 
+typedef struct gbinder_eventloop_glib_slack_source {
+    GSource source;
+    gint64 interval; /* microseconds */
+    gint64 slack; /* microseconds */
+} GBinderEventLoopGLibSlackSource;
+
 static
 inline
 GBinderEventLoopTimeoutGLib*
@@ -99,29 +106,110 @@ gbinder_eventloop_glib_timeout_finalize(
 
 static
 GBinderEventLoopTimeout*
-gbinder_eventloop_glib_timeout_add(
+gbinder_eventloop_glib_timeout_add_in(
+    guint interval,
+    GSourceFunc func,
+    gpointer data,
+    GMainContext* context)
+{
+    GBinderEventLoopTimeoutGLib* impl =
+        g_slice_new(GBinderEventLoopTimeoutGLib);
+
+    impl->timeout.eventloop = &gbinder_eventloop_glib;
+    impl->func = func;
+    impl->data = data;
+    impl->source = g_timeout_source_new(interval);
+    g_source_set_callback(impl->source,
+        gbinder_eventloop_glib_timeout_callback, impl,
+        gbinder_eventloop_glib_timeout_finalize);
+    g_source_attach(impl->source, context);
+    /* The context holds the reference, impl dies together with the source */
+    g_source_unref(impl->source);
+    return &impl->timeout;
+}
+
+/*
+ * The deadline is rounded up to the next multiple of the slack on the
+ * monotonic clock. All timers sharing the same slack and expiring within
+ * the same window are dispatched by a single main loop wakeup.
+ */
+static
+void
+gbinder_eventloop_glib_slack_arm(
+    GBinderEventLoopGLibSlackSource* slack)
+{
+    const gint64 deadline = g_get_monotonic_time() + slack->interval;
+
+    g_source_set_ready_time(&slack->source,
+        ((deadline + slack->slack - 1) / slack->slack) * slack->slack);
+}
+
+static
+gboolean
+gbinder_eventloop_glib_slack_dispatch(
+    GSource* source,
+    GSourceFunc callback,
+    gpointer user_data)
+{
+    if (callback(user_data)) {
+        gbinder_eventloop_glib_slack_arm((GBinderEventLoopGLibSlackSource*)
+            source);
+        return G_SOURCE_CONTINUE;
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+GBinderEventLoopTimeout*
+gbinder_eventloop_glib_timeout_add_slack(
     guint interval,
+    guint slack,
     GSourceFunc func,
     gpointer data)
 {
+    static GSourceFuncs slack_funcs = {
+        NULL, NULL,
+        gbinder_eventloop_glib_slack_dispatch
+    };
+
     GBinderEventLoopTimeoutGLib* impl =
         g_slice_new(GBinderEventLoopTimeoutGLib);
+    GBinderEventLoopGLibSlackSource* source =
+        (GBinderEventLoopGLibSlackSource*) g_source_new(&slack_funcs,
+            sizeof(GBinderEventLoopGLibSlackSource));
+
+    source->interval = ((gint64)interval) * 1000;
+    source->slack = ((gint64)slack) * 1000;
+    gbinder_eventloop_glib_slack_arm(source);
 
     impl->timeout.eventloop = &gbinder_eventloop_glib;
     impl->func = func;
     impl->data = data;
-    impl->id = g_timeout_add_full(G_PRIORITY_DEFAULT, interval,
+    impl->source = &source->source;
+    g_source_set_callback(impl->source,
         gbinder_eventloop_glib_timeout_callback, impl,
         gbinder_eventloop_glib_timeout_finalize);
+    g_source_attach(impl->source, NULL);
+    g_source_unref(impl->source);
     return &impl->timeout;
 }
 
+static
+GBinderEventLoopTimeout*
+gbinder_eventloop_glib_timeout_add(
+    guint interval,
+    GSourceFunc func,
+    gpointer data)
+{
+    return gbinder_eventloop_glib_timeout_add_in(interval, func, data, NULL);
+}
+
 static
 void
 gbinder_eventloop_glib_timeout_remove(
     GBinderEventLoopTimeout* timeout)
 {
-    g_source_remove(gbinder_eventloop_glib_timeout_cast(timeout)->id);
+    g_source_destroy(gbinder_eventloop_glib_timeout_cast(timeout)->source);
 }
 
 static
@@ -264,6 +352,9 @@ gbinder_idle_callback_invoke_done(
 static const GBinderEventLoopIntegration* gbinder_eventloop =
     GBINDER_DEFAULT_EVENTLOOP;
 
+/* Negative until fetched from the config */
+static gint gbinder_eventloop_timer_slack = -1;
+
 GBinderEventLoopTimeout*
 gbinder_timeout_add(
     guint interval,
@@ -273,6 +364,57 @@ gbinder_timeout_add(
     return gbinder_eventloop->timeout_add(interval, function, data);
 }
 
+/*
+ * Timers which don't need to be precise (polling, retries and such) may
+ * be delayed by up to TimerSlack milliseconds, so that the ones expiring
+ * close to each other wake up the process only once. Slack is zero (i.e.
+ * disabled) by default. Only the default GLib integration honors it, the
+ * custom ones get a regular timeout.
+ */
+GBinderEventLoopTimeout*
+gbinder_timeout_add_slack(
+    guint interval,
+    GSourceFunc function,
+    gpointer data)
+{
+    int slack = g_atomic_int_get(&gbinder_eventloop_timer_slack);
+
+    if (slack < 0) {
+        slack = MAX(gbinder_config_get_device_int
+            (GBINDER_CONFIG_GROUP_TIMER_SLACK, NULL, 0), 0);
+        g_atomic_int_set(&gbinder_eventloop_timer_slack, slack);
+    }
+    return (slack && gbinder_eventloop == &gbinder_eventloop_glib) ?
+        gbinder_eventloop_glib_timeout_add_slack(interval, slack, function,
+            data) : gbinder_eventloop->timeout_add(interval, function, data);
+}
+
+void
+gbinder_eventloop_set_timer_slack(
+    int slack_ms)
+{
+    /* Negative value makes it re-read the config */
+    g_atomic_int_set(&gbinder_eventloop_timer_slack, slack_ms);
+}
+
+/*
+ * The *_in variants dispatch the callback in the specified GMainContext,
+ * NULL meaning the default one. Custom event loop integrations have no
+ * notion of GMainContext, for those the context is ignored.
+ */
+GBinderEventLoopTimeout*
+gbinder_timeout_add_in(
+    guint interval,
+    GSourceFunc function,
+    gpointer data,
+    GMainContext* context)
+{
+    return (context && gbinder_eventloop == &gbinder_eventloop_glib) ?
+        gbinder_eventloop_glib_timeout_add_in(interval, function, data,
+            context) : gbinder_eventloop->timeout_add(interval, function,
+            data);
+}
+
 GBinderEventLoopTimeout*
 gbinder_idle_add(
     GSourceFunc function,
@@ -341,6 +483,21 @@ gbinder_idle_callback_schedule(
     }
 }
 
+void
+gbinder_idle_callback_schedule_in(
+    GBinderEventLoopCallback* cb,
+    GMainContext* context)
+{
+    if (cb) {
+        if (context && cb->eventloop == &gbinder_eventloop_glib) {
+            g_source_attach(gbinder_eventloop_glib_callback_source(cb),
+                context);
+        } else {
+            cb->eventloop->callback_schedule(cb);
+        }
+    }
+}
+
 void
 gbinder_idle_callback_cancel(
     GBinderEventLoopCallback* cb)
@@ -368,6 +525,16 @@ gbinder_idle_callback_invoke_later(
     GBinderEventLoopCallbackFunc func,
     gpointer data,
     GDestroyNotify destroy)
+{
+    gbinder_idle_callback_invoke_later_in(func, data, destroy, NULL);
+}
+
+void
+gbinder_idle_callback_invoke_later_in(
+    GBinderEventLoopCallbackFunc func,
+    gpointer data,
+    GDestroyNotify destroy,
+    GMainContext* context)
 {
     GBinderIdleCallbackData* idle = g_slice_new(GBinderIdleCallbackData);
 
@@ -376,7 +543,7 @@ gbinder_idle_callback_invoke_later(
     idle->destroy = destroy;
     idle->cb = gbinder_idle_callback_new(gbinder_idle_callback_invoke_proc,
         idle, gbinder_idle_callback_invoke_done);
-    gbinder_idle_callback_schedule(idle->cb);
+    gbinder_idle_callback_schedule_in(idle->cb, context);
 }
 
 /*==========================================================================*
@@ -0,0 +1,544 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "gbinder_eventloop_p.h"
+#include "gbinder_log.h"
+
+#include <gutil_macros.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * Built-in event loop integration for programs which don't run GLib
+ * main loop. Idle callbacks are queued and signalled through an eventfd,
+ * each timeout has its own timerfd. All those are added to one epoll fd
+ * which can be either polled by the caller's own event loop or by the
+ * dedicated dispatcher thread. Whichever thread dispatches the events
+ * becomes "the main thread" as far as libgbinder is concerned.
+ *
+ * Events are fetched from the epoll fd one at a time, so that removing
+ * a timeout from a callback never leaves a stale pointer in the array
+ * of the events which are yet to be handled.
+ */
+
+typedef struct gbinder_eventloop_epoll_timeout {
+    GBinderEventLoopTimeout timeout;
+    int fd;
+    GSourceFunc func;
+    gpointer data;
+} GBinderEventLoopEpollTimeout;
+
+typedef struct gbinder_eventloop_epoll_callback {
+    GBinderEventLoopCallback callback;
+    gint refcount;
+    gboolean scheduled; /* Protected by the mutex */
+    GList link; /* Link in the queue of scheduled callbacks */
+    GBinderEventLoopCallbackFunc func;
+    gpointer data;
+    GDestroyNotify finalize;
+} GBinderEventLoopEpollCallback;
+
+typedef struct gbinder_eventloop_epoll {
+    GMutex mutex;
+    GQueue scheduled;
+    int epoll_fd;
+    int event_fd;
+    GThread* thread;
+    gint stop;
+} GBinderEventLoopEpoll;
+
+static const GBinderEventLoopIntegration gbinder_eventloop_epoll_impl;
+static GBinderEventLoopEpoll gbinder_eventloop_epoll_loop;
+static gsize gbinder_eventloop_epoll_initialized = 0;
+
+static
+inline
+GBinderEventLoopEpollTimeout*
+gbinder_eventloop_epoll_timeout_cast(
+    GBinderEventLoopTimeout* timeout)
+{
+    return G_CAST(timeout,GBinderEventLoopEpollTimeout,timeout);
+}
+
+static
+inline
+GBinderEventLoopEpollCallback*
+gbinder_eventloop_epoll_callback_cast(
+    GBinderEventLoopCallback* callback)
+{
+    return G_CAST(callback,GBinderEventLoopEpollCallback,callback);
+}
+
+static
+void
+gbinder_eventloop_epoll_wakeup(
+    GBinderEventLoopEpoll* loop)
+{
+    const guint64 one = 1;
+
+    if (write(loop->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        GWARN("Failed to signal eventfd: %s", strerror(errno));
+    }
+}
+
+static
+gboolean
+gbinder_eventloop_epoll_init(
+    void)
+{
+    GBinderEventLoopEpoll* loop = &gbinder_eventloop_epoll_loop;
+
+    if (g_once_init_enter(&gbinder_eventloop_epoll_initialized)) {
+        gsize ok = 1;
+
+        g_mutex_init(&loop->mutex);
+        g_queue_init(&loop->scheduled);
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        loop->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (loop->epoll_fd >= 0 && loop->event_fd >= 0) {
+            struct epoll_event ev;
+
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.ptr = loop;
+            if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->event_fd,
+                &ev) < 0) {
+                GERR("Failed to add eventfd to epoll: %s", strerror(errno));
+                ok = 2;
+            }
+        } else {
+            GERR("Failed to create epoll event loop: %s", strerror(errno));
+            ok = 2;
+        }
+        g_once_init_leave(&gbinder_eventloop_epoll_initialized, ok);
+    }
+    return gbinder_eventloop_epoll_initialized == 1;
+}
+
+static
+void
+gbinder_eventloop_epoll_timeout_free(
+    GBinderEventLoopEpollTimeout* impl)
+{
+    epoll_ctl(gbinder_eventloop_epoll_loop.epoll_fd, EPOLL_CTL_DEL,
+        impl->fd, NULL);
+    close(impl->fd);
+    gutil_slice_free(impl);
+}
+
+static
+void
+gbinder_eventloop_epoll_callback_free(
+    GBinderEventLoopEpollCallback* impl)
+{
+    if (impl->finalize) {
+        impl->finalize(impl->data);
+    }
+    gutil_slice_free(impl);
+}
+
+static
+void
+gbinder_eventloop_epoll_callback_drop(
+    GBinderEventLoopEpollCallback* impl)
+{
+    if (g_atomic_int_dec_and_test(&impl->refcount)) {
+        gbinder_eventloop_epoll_callback_free(impl);
+    }
+}
+
+static
+void
+gbinder_eventloop_epoll_handle_callbacks(
+    GBinderEventLoopEpoll* loop)
+{
+    guint64 count;
+    guint n;
+
+    /* Reset the eventfd counter */
+    if (read(loop->event_fd, &count, sizeof(count)) < 0 &&
+        errno != EAGAIN) {
+        GWARN("Failed to read eventfd: %s", strerror(errno));
+    }
+
+    /*
+     * Callbacks scheduled from within the callbacks will be invoked
+     * after the next wakeup, which allows the timeouts to fire in
+     * the meantime.
+     */
+    /* Lock */
+    g_mutex_lock(&loop->mutex);
+    n = loop->scheduled.length;
+    g_mutex_unlock(&loop->mutex);
+    /* Unlock */
+
+    while (n-- > 0) {
+        GBinderEventLoopEpollCallback* impl = NULL;
+        GList* link;
+
+        /* Lock */
+        g_mutex_lock(&loop->mutex);
+        link = g_queue_pop_head_link(&loop->scheduled);
+        if (link) {
+            impl = link->data;
+            impl->scheduled = FALSE;
+        }
+        g_mutex_unlock(&loop->mutex);
+        /* Unlock */
+
+        if (!impl) {
+            /* The rest has been cancelled */
+            break;
+        }
+        if (impl->func) {
+            impl->func(impl->data);
+        }
+        /* Drop the reference added by callback_schedule */
+        gbinder_eventloop_epoll_callback_drop(impl);
+    }
+}
+
+static
+void
+gbinder_eventloop_epoll_handle_timeout(
+    GBinderEventLoopEpollTimeout* impl)
+{
+    guint64 expirations;
+
+    if (read(impl->fd, &expirations, sizeof(expirations)) ==
+        sizeof(expirations) && !impl->func(impl->data)) {
+        gbinder_eventloop_epoll_timeout_free(impl);
+    }
+}
+
+static
+gboolean
+gbinder_eventloop_epoll_dispatch_one(
+    GBinderEventLoopEpoll* loop,
+    int timeout)
+{
+    struct epoll_event ev;
+
+    if (epoll_wait(loop->epoll_fd, &ev, 1, timeout) == 1) {
+        if (ev.data.ptr == loop) {
+            gbinder_eventloop_epoll_handle_callbacks(loop);
+        } else {
+            gbinder_eventloop_epoll_handle_timeout(ev.data.ptr);
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+gpointer
+gbinder_eventloop_epoll_thread(
+    gpointer data)
+{
+    GBinderEventLoopEpoll* loop = data;
+
+    while (!g_atomic_int_get(&loop->stop)) {
+        gbinder_eventloop_epoll_dispatch_one(loop, -1);
+    }
+    return NULL;
+}
+
+/*==========================================================================*
+ * GBinderEventLoopIntegration
+ *==========================================================================*/
+
+static
+GBinderEventLoopTimeout*
+gbinder_eventloop_epoll_timeout_add(
+    guint interval,
+    GSourceFunc func,
+    gpointer data)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (fd >= 0) {
+        GBinderEventLoopEpollTimeout* impl =
+            g_slice_new(GBinderEventLoopEpollTimeout);
+        struct itimerspec spec;
+        struct epoll_event ev;
+
+        /* Zero interval would disarm the timer, fire ASAP instead */
+        memset(&spec, 0, sizeof(spec));
+        if (interval) {
+            spec.it_interval.tv_sec = interval / 1000;
+            spec.it_interval.tv_nsec = (interval % 1000) * 1000000;
+        } else {
+            spec.it_interval.tv_nsec = 1;
+        }
+        spec.it_value = spec.it_interval;
+
+        impl->timeout.eventloop = &gbinder_eventloop_epoll_impl;
+        impl->fd = fd;
+        impl->func = func;
+        impl->data = data;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = impl;
+        if (timerfd_settime(fd, 0, &spec, NULL) == 0 &&
+            epoll_ctl(gbinder_eventloop_epoll_loop.epoll_fd, EPOLL_CTL_ADD,
+            fd, &ev) == 0) {
+            return &impl->timeout;
+        }
+        GERR("Failed to set up timerfd: %s", strerror(errno));
+        close(fd);
+        gutil_slice_free(impl);
+    } else {
+        GERR("Failed to create timerfd: %s", strerror(errno));
+    }
+    return NULL;
+}
+
+static
+void
+gbinder_eventloop_epoll_timeout_remove(
+    GBinderEventLoopTimeout* timeout)
+{
+    gbinder_eventloop_epoll_timeout_free
+        (gbinder_eventloop_epoll_timeout_cast(timeout));
+}
+
+static
+GBinderEventLoopCallback*
+gbinder_eventloop_epoll_callback_new(
+    GBinderEventLoopCallbackFunc func,
+    gpointer data,
+    GDestroyNotify finalize)
+{
+    GBinderEventLoopEpollCallback* impl =
+        g_slice_new0(GBinderEventLoopEpollCallback);
+
+    impl->callback.eventloop = &gbinder_eventloop_epoll_impl;
+    impl->refcount = 1;
+    impl->link.data = impl;
+    impl->func = func;
+    impl->data = data;
+    impl->finalize = finalize;
+    return &impl->callback;
+}
+
+static
+void
+gbinder_eventloop_epoll_callback_ref(
+    GBinderEventLoopCallback* cb)
+{
+    g_atomic_int_inc(&gbinder_eventloop_epoll_callback_cast(cb)->refcount);
+}
+
+static
+void
+gbinder_eventloop_epoll_callback_unref(
+    GBinderEventLoopCallback* cb)
+{
+    gbinder_eventloop_epoll_callback_drop
+        (gbinder_eventloop_epoll_callback_cast(cb));
+}
+
+static
+void
+gbinder_eventloop_epoll_callback_schedule(
+    GBinderEventLoopCallback* cb)
+{
+    GBinderEventLoopEpoll* loop = &gbinder_eventloop_epoll_loop;
+    GBinderEventLoopEpollCallback* impl =
+        gbinder_eventloop_epoll_callback_cast(cb);
+    gboolean wakeup = FALSE;
+
+    /* Lock */
+    g_mutex_lock(&loop->mutex);
+    if (!impl->scheduled) {
+        impl->scheduled = TRUE;
+        g_atomic_int_inc(&impl->refcount);
+        g_queue_push_tail_link(&loop->scheduled, &impl->link);
+        wakeup = TRUE;
+    }
+    g_mutex_unlock(&loop->mutex);
+    /* Unlock */
+
+    if (wakeup) {
+        gbinder_eventloop_epoll_wakeup(loop);
+    }
+}
+
+static
+void
+gbinder_eventloop_epoll_callback_cancel(
+    GBinderEventLoopCallback* cb)
+{
+    GBinderEventLoopEpoll* loop = &gbinder_eventloop_epoll_loop;
+    GBinderEventLoopEpollCallback* impl =
+        gbinder_eventloop_epoll_callback_cast(cb);
+    gboolean cancelled = FALSE;
+
+    /* Lock */
+    g_mutex_lock(&loop->mutex);
+    if (impl->scheduled) {
+        impl->scheduled = FALSE;
+        g_queue_unlink(&loop->scheduled, &impl->link);
+        cancelled = TRUE;
+    }
+    g_mutex_unlock(&loop->mutex);
+    /* Unlock */
+
+    if (cancelled) {
+        gbinder_eventloop_epoll_callback_drop(impl);
+    }
+}
+
+static
+void
+gbinder_eventloop_epoll_cleanup(
+    void)
+{
+    GBinderEventLoopEpoll* loop = &gbinder_eventloop_epoll_loop;
+    GList* link;
+
+    gbinder_eventloop_epoll_stop();
+
+    /* Drop the callbacks which are still scheduled */
+    do {
+        GBinderEventLoopEpollCallback* impl = NULL;
+
+        /* Lock */
+        g_mutex_lock(&loop->mutex);
+        link = g_queue_pop_head_link(&loop->scheduled);
+        if (link) {
+            impl = link->data;
+            impl->scheduled = FALSE;
+        }
+        g_mutex_unlock(&loop->mutex);
+        /* Unlock */
+
+        if (impl) {
+            gbinder_eventloop_epoll_callback_drop(impl);
+        }
+    } while (link);
+}
+
+static const GBinderEventLoopIntegration gbinder_eventloop_epoll_impl = {
+    gbinder_eventloop_epoll_timeout_add,
+    gbinder_eventloop_epoll_timeout_remove,
+    gbinder_eventloop_epoll_callback_new,
+    gbinder_eventloop_epoll_callback_ref,
+    gbinder_eventloop_epoll_callback_unref,
+    gbinder_eventloop_epoll_callback_schedule,
+    gbinder_eventloop_epoll_callback_cancel,
+    gbinder_eventloop_epoll_cleanup
+};
+
+/*==========================================================================*
+ * Interface
+ *==========================================================================*/
+
+const GBinderEventLoopIntegration*
+gbinder_eventloop_epoll(
+    void) /* Since 1.1.25 */
+{
+    return gbinder_eventloop_epoll_init() ? &gbinder_eventloop_epoll_impl :
+        NULL;
+}
+
+int
+gbinder_eventloop_epoll_fd(
+    void) /* Since 1.1.25 */
+{
+    return gbinder_eventloop_epoll_init() ?
+        gbinder_eventloop_epoll_loop.epoll_fd : (-1);
+}
+
+guint
+gbinder_eventloop_epoll_dispatch(
+    void) /* Since 1.1.25 */
+{
+    guint n = 0;
+
+    if (gbinder_eventloop_epoll_init()) {
+        while (gbinder_eventloop_epoll_dispatch_one
+            (&gbinder_eventloop_epoll_loop, 0)) {
+            n++;
+        }
+    }
+    return n;
+}
+
+gboolean
+gbinder_eventloop_epoll_start(
+    void) /* Since 1.1.25 */
+{
+    GBinderEventLoopEpoll* loop = &gbinder_eventloop_epoll_loop;
+
+    if (gbinder_eventloop_epoll_init()) {
+        if (!loop->thread) {
+            g_atomic_int_set(&loop->stop, FALSE);
+            loop->thread = g_thread_new("gbinder-eventloop",
+                gbinder_eventloop_epoll_thread, loop);
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+void
+gbinder_eventloop_epoll_stop(
+    void) /* Since 1.1.25 */
+{
+    GBinderEventLoopEpoll* loop = &gbinder_eventloop_epoll_loop;
+
+    if (loop->thread) {
+        if (loop->thread == g_thread_self()) {
+            GWARN("Can't stop the event loop thread from itself");
+        } else {
+            g_atomic_int_set(&loop->stop, TRUE);
+            gbinder_eventloop_epoll_wakeup(loop);
+            g_thread_join(loop->thread);
+            loop->thread = NULL;
+        }
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -44,6 +44,29 @@ gbinder_timeout_add(
     G_GNUC_WARN_UNUSED_RESULT
     GBINDER_INTERNAL;
 
+GBinderEventLoopTimeout*
+gbinder_timeout_add_in(
+    guint millis,
+    GSourceFunc func,
+    gpointer data,
+    GMainContext* context)
+    G_GNUC_WARN_UNUSED_RESULT
+    GBINDER_INTERNAL;
+
+GBinderEventLoopTimeout*
+gbinder_timeout_add_slack(
+    guint millis,
+    GSourceFunc func,
+    gpointer data)
+    G_GNUC_WARN_UNUSED_RESULT
+    GBINDER_INTERNAL;
+
+/* Declared for unit tests */
+void
+gbinder_eventloop_set_timer_slack(
+    int slack_ms)
+    GBINDER_INTERNAL;
+
 GBinderEventLoopTimeout*
 gbinder_idle_add(
     GSourceFunc func,
@@ -87,6 +110,12 @@ gbinder_idle_callback_schedule(
     GBinderEventLoopCallback* cb)
     GBINDER_INTERNAL;
 
+void
+gbinder_idle_callback_schedule_in(
+    GBinderEventLoopCallback* cb,
+    GMainContext* context)
+    GBINDER_INTERNAL;
+
 void
 gbinder_idle_callback_cancel(
     GBinderEventLoopCallback* cb)
@@ -104,6 +133,14 @@ gbinder_idle_callback_invoke_later(
     GDestroyNotify destroy)
     GBINDER_INTERNAL;
 
+void
+gbinder_idle_callback_invoke_later_in(
+    GBinderEventLoopCallbackFunc func,
+    gpointer data,
+    GDestroyNotify destroy,
+    GMainContext* context)
+    GBINDER_INTERNAL;
+
 #endif /* GBINDER_EVENTLOOP_PRIVATE_H */
 
 /*
@@ -33,16 +33,28 @@
 #include "gbinder_log.h"
 
 #include <gutil_macros.h>
+#include <gutil_misc.h>
 
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/futex.h>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #if GBINDER_FMQ_SUPPORTED
 
+/*
+ * From linux/memfd.h
+ */
+#ifndef MFD_HUGETLB
+#  define MFD_HUGETLB 0x0004U
+#endif
+#ifndef MFD_HUGE_2MB
+#  define MFD_HUGE_2MB (21U << 26)
+#endif
+
 /* Grantor data positions */
 enum {
     READ_PTR_POS = 0,
@@ -58,8 +70,57 @@ typedef struct gbinder_fmq {
     guint64* write_ptr;
     guint32* event_flag_ptr;
     guint32 refcount;
+    gint64 spin_ns;
+    gboolean lazy_wake;
+    /*
+     * Last seen value of the other side's counter. Only touched by the
+     * reader (cached_write_ptr) or the writer (cached_read_ptr). Counters
+     * only grow, so the cached value can only make the queue look more
+     * empty (or more full) than it actually is, never the other way
+     * around. Not used by unsynchronized queues, where the writer can
+     * overrun the reader.
+     */
+    guint64 cached_write_ptr;
+    guint64 cached_read_ptr;
+    /*
+     * Items which this reader of an unsynchronized queue has missed
+     * because the writer has overwritten them. Only touched by the
+     * reader.
+     */
+    guint64 lost_items;
+    /* The one mapping of our own shared memory (fd_index 0) */
+    void* map;
+    gsize map_size;
+    int map_flags;
+    gboolean imported; /* Owns the (duplicated) fds */
 } GBinderFmq;
 
+/* Set in the event flag by the waiters about to sleep (lazy wake only) */
+#define GBINDER_FMQ_SLEEPER_BIT (0x80000000)
+
+GBINDER_INLINE_FUNC
+void
+gbinder_fmq_cpu_relax(
+    void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static
+gint64
+gbinder_fmq_now_ns(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gint64)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
 GBINDER_INLINE_FUNC
 GBinderFmqGrantorDescriptor*
 gbinder_fmq_get_grantor_descriptor(
@@ -123,18 +184,38 @@ gbinder_fmq_available_to_write_bytes(
     }
 }
 
+#define GBINDER_FMQ_CACHE_LINE (64)
+#define GBINDER_FMQ_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
 static
 GBinderFmqGrantorDescriptor*
 gbinder_fmq_create_grantors(
     gsize queue_size_bytes,
     gsize num_fds,
-    gboolean configure_event_flag)
+    GBINDER_FMQ_FLAGS flags,
+    gsize* shmem_size)
 {
-    const gsize num_grantors = configure_event_flag ?
+    /*
+     * Huge pages can only be mapped at offsets aligned at the huge page
+     * size, while the peer rounds grantor offsets down to the regular
+     * page size. Keeping the control block in front of the data makes
+     * every mapping start at offset zero.
+     */
+    static const guint normal_order[] = {
+        READ_PTR_POS, WRITE_PTR_POS, DATA_PTR_POS, EVENT_FLAG_PTR_POS
+    };
+    static const guint control_first_order[] = {
+        READ_PTR_POS, WRITE_PTR_POS, EVENT_FLAG_PTR_POS, DATA_PTR_POS
+    };
+    const gboolean align_counters =
+        (flags & GBINDER_FMQ_FLAG_ALIGN_COUNTERS) != 0;
+    const guint* order = (flags & GBINDER_FMQ_FLAG_HUGE_PAGES) ?
+        control_first_order : normal_order;
+    const gsize num_grantors = (flags & GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG) ?
         (EVENT_FLAG_PTR_POS + 1) : (DATA_PTR_POS + 1);
     GBinderFmqGrantorDescriptor* grantors =
         g_new0(GBinderFmqGrantorDescriptor, num_grantors);
-    gsize pos, offset;
+    gsize i, offset;
     gsize mem_sizes[] = {
         sizeof(guint64),  /* read pointer counter */
         sizeof(guint64),  /* write pointer counter */
@@ -142,26 +223,106 @@ gbinder_fmq_create_grantors(
         sizeof(guint32)   /* event flag pointer */
     };
 
-    for (pos = 0, offset = 0; pos < num_grantors; pos++) {
+    for (i = 0, offset = 0; i < G_N_ELEMENTS(normal_order); i++) {
+        const guint pos = order[i];
         GBinderFmqGrantorDescriptor* grantor = grantors + pos;
         guint32 grantor_fd_index;
         gsize grantor_offset;
 
-        if (pos == DATA_PTR_POS && num_fds == 2) {
+        if (pos >= num_grantors) {
+            continue;
+        } else if (pos == DATA_PTR_POS && num_fds == 2) {
             grantor_fd_index = 1;
             grantor_offset = 0;
         } else {
+            /*
+             * Optionally keep the counters, the data and the event flag
+             * on separate cache lines, so that the reader and the writer
+             * don't keep invalidating each other's cache.
+             */
             grantor_fd_index = 0;
-            grantor_offset = offset;
-            offset += mem_sizes[pos];
+            grantor_offset = align_counters ?
+                ((offset + GBINDER_FMQ_CACHE_LINE - 1) &
+                 ~(GBINDER_FMQ_CACHE_LINE - 1)) : G_ALIGN8(offset);
+            offset = grantor_offset + mem_sizes[pos];
         }
         grantor->fd_index = grantor_fd_index;
-        grantor->offset = (guint32)G_ALIGN8(grantor_offset);
+        grantor->offset = (guint32)grantor_offset;
         grantor->extent = mem_sizes[pos];
     }
+    *shmem_size = offset;
     return grantors;
 }
 
+static
+void
+gbinder_fmq_seal(
+    int fd)
+{
+    /* Don't let the peer resize the memory under our feet */
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        GDEBUG("Failed to seal FMQ memory: %s", strerror(errno));
+    }
+}
+
+static
+int
+gbinder_fmq_alloc_shmem(
+    gsize size,
+    gboolean huge_pages,
+    int map_flags,
+    gsize* shmem_size,
+    void** map)
+{
+    const gsize page_size = getpagesize();
+    int fd;
+
+    if (huge_pages) {
+        const gsize huge_size = (size + GBINDER_FMQ_HUGE_PAGE_SIZE - 1) &
+            ~(GBINDER_FMQ_HUGE_PAGE_SIZE - 1);
+
+        fd = syscall(__NR_memfd_create, "MessageQueue", MFD_CLOEXEC |
+            MFD_ALLOW_SEALING | MFD_HUGETLB | MFD_HUGE_2MB);
+        if (fd >= 0) {
+            /* mmap fails if there are not enough free huge pages */
+            if (ftruncate(fd, huge_size) == 0) {
+                void* ptr = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+                    map_flags, fd, 0);
+
+                if (ptr != MAP_FAILED) {
+                    gbinder_fmq_seal(fd);
+                    *shmem_size = huge_size;
+                    *map = ptr;
+                    return fd;
+                }
+            }
+            close(fd);
+        }
+        GDEBUG("Huge pages unavailable (%s), using regular pages",
+            strerror(errno));
+    }
+
+    fd = syscall(__NR_memfd_create, "MessageQueue", MFD_CLOEXEC |
+        MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        const gsize regular_size = (size + page_size - 1) & ~(page_size - 1);
+
+        if (ftruncate(fd, regular_size) == 0) {
+            void* ptr = mmap(NULL, regular_size, PROT_READ | PROT_WRITE,
+                map_flags, fd, 0);
+
+            if (ptr != MAP_FAILED) {
+                gbinder_fmq_seal(fd);
+                *shmem_size = regular_size;
+                *map = ptr;
+                return fd;
+            }
+        }
+        close(fd);
+    }
+    return -1;
+}
+
 static
 void*
 gbinder_fmq_map_grantor_descriptor(
@@ -171,17 +332,25 @@ gbinder_fmq_map_grantor_descriptor(
     if (index < self->desc->grantors.count) {
         const GBinderFmqGrantorDescriptor* desc =
             gbinder_fmq_get_grantor_descriptor(self, index);
-        /* Offset for mmap must be a multiple of PAGE_SIZE */
-        const guint32 map_offset = (desc->offset & ~(getpagesize()-1));
-        const guint32 map_length = desc->offset - map_offset + desc->extent;
-        const GBinderFds* fds = self->desc->data.fds;
-        void* address = mmap(0, map_length, PROT_READ | PROT_WRITE, MAP_SHARED,
-            gbinder_fds_get_fd(fds, desc->fd_index), map_offset);
-
-        if (address != MAP_FAILED) {
-            return (guint8*)address + (desc->offset - map_offset);
+
+        if (desc->fd_index == 0 && self->map) {
+            /* Our own shared memory is mapped only once */
+            return (guint8*)self->map + desc->offset;
         } else {
-            GWARN("mmap failed: %d", errno);
+            /* Offset for mmap must be a multiple of PAGE_SIZE */
+            const guint32 map_offset = (desc->offset & ~(getpagesize()-1));
+            const guint32 map_length = desc->offset - map_offset +
+                desc->extent;
+            const GBinderFds* fds = self->desc->data.fds;
+            void* address = mmap(0, map_length, PROT_READ | PROT_WRITE,
+                self->map_flags, gbinder_fds_get_fd(fds, desc->fd_index),
+                map_offset);
+
+            if (address != MAP_FAILED) {
+                return (guint8*)address + (desc->offset - map_offset);
+            } else {
+                GWARN("mmap failed: %d", errno);
+            }
         }
     }
     return NULL;
@@ -197,9 +366,51 @@ gbinder_fmq_unmap_grantor_descriptor(
     if (index < self->desc->grantors.count && address) {
         const GBinderFmqGrantorDescriptor* desc =
             gbinder_fmq_get_grantor_descriptor(self, index);
-        const gsize remainder = desc->offset & (getpagesize() - 1);
 
-        munmap((guint8*)address - remainder, remainder + desc->extent);
+        if (desc->fd_index != 0 || !self->map) {
+            const gsize remainder = desc->offset & (getpagesize() - 1);
+
+            munmap((guint8*)address - remainder, remainder + desc->extent);
+        }
+    }
+}
+
+static
+void
+gbinder_fmq_map_pointers(
+    GBinderFmq* self)
+{
+    if (self->desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE) {
+        self->read_ptr = gbinder_fmq_map_grantor_descriptor(self,
+            READ_PTR_POS);
+    } else {
+        /*
+         * Unsynchronized write FMQs may have multiple readers and
+         * each reader would have their own read pointer counter.
+         */
+        self->read_ptr = g_new0(guint64, 1);
+    }
+    if (!self->read_ptr) {
+        GWARN("Read pointer is null");
+    }
+
+    self->write_ptr = gbinder_fmq_map_grantor_descriptor(self,
+        WRITE_PTR_POS);
+    if (!self->write_ptr) {
+        GWARN("Write pointer is null");
+    }
+
+    self->ring = gbinder_fmq_map_grantor_descriptor(self, DATA_PTR_POS);
+    if (!self->ring) {
+        GWARN("Ring buffer pointer is null");
+    }
+
+    if (self->desc->grantors.count > EVENT_FLAG_PTR_POS) {
+        self->event_flag_ptr = gbinder_fmq_map_grantor_descriptor(self,
+            EVENT_FLAG_PTR_POS);
+        if (!self->event_flag_ptr) {
+            GWARN("Event flag pointer is null");
+        }
     }
 }
 
@@ -221,6 +432,17 @@ gbinder_fmq_free(
             DATA_PTR_POS);
         gbinder_fmq_unmap_grantor_descriptor(self, self->event_flag_ptr,
             EVENT_FLAG_PTR_POS);
+        if (self->map) {
+            munmap(self->map, self->map_size);
+        }
+        if (self->imported) {
+            const GBinderFds* fds = self->desc->data.fds;
+            guint i;
+
+            for (i = 0; i < fds->num_fds; i++) {
+                close(gbinder_fds_get_fd(fds, i));
+            }
+        }
 
         g_free((GBinderFmqGrantorDescriptor*)self->desc->grantors.data.ptr);
         g_free((GBinderFds*)self->desc->data.fds);
@@ -239,6 +461,154 @@ gbinder_fmq_get_descriptor(
     return self->desc;
 }
 
+gboolean
+gbinder_fmq_waitv_supported(
+    void)
+{
+    static gint supported = -1; /* Unknown yet */
+
+    if (supported < 0) {
+        /* Zero futexes is EINVAL if the syscall is there at all */
+        supported = (syscall(__NR_futex_waitv, NULL, 0, 0, NULL,
+            CLOCK_MONOTONIC) < 0 && errno == ENOSYS) ? FALSE : TRUE;
+        GDEBUG("futex_waitv %ssupported", supported ? "" : "not ");
+    }
+    return supported;
+}
+
+guint32*
+gbinder_fmq_event_flag(
+    GBinderFmq* self)
+{
+    return self->event_flag_ptr;
+}
+
+guint32
+gbinder_fmq_prepare_wait(
+    GBinderFmq* self,
+    guint32 bit_mask,
+    guint32* value)
+{
+    guint32 old_value = __atomic_fetch_and(self->event_flag_ptr, ~bit_mask,
+        __ATOMIC_SEQ_CST);
+
+    if (!(old_value & bit_mask)) {
+        /* Nothing yet, the caller is going to sleep on *value */
+        if (self->lazy_wake) {
+            old_value = __atomic_fetch_or(self->event_flag_ptr,
+                GBINDER_FMQ_SLEEPER_BIT, __ATOMIC_SEQ_CST) |
+                GBINDER_FMQ_SLEEPER_BIT;
+            if (old_value & bit_mask) {
+                old_value = __atomic_fetch_and(self->event_flag_ptr,
+                    ~bit_mask, __ATOMIC_SEQ_CST);
+            }
+        } else {
+            old_value = __atomic_load_n(self->event_flag_ptr,
+                __ATOMIC_SEQ_CST);
+        }
+    }
+    *value = old_value;
+    return old_value & bit_mask;
+}
+
+/*
+ * Maps the queue described by the descriptor received from the peer.
+ * The descriptor belongs to the caller, the fds are duplicated.
+ */
+GBinderFmq*
+gbinder_fmq_new_from_descriptor(
+    const GBinderMQDescriptor* desc)
+{
+    const GBinderFds* fds = desc->data.fds;
+    const GBinderFmqGrantorDescriptor* grantors = desc->grantors.data.ptr;
+    const guint32 count = desc->grantors.count;
+    guint32 i;
+
+    if (!fds || !fds->num_fds || !grantors || count <= DATA_PTR_POS ||
+        !desc->quantum || (desc->flags != GBINDER_FMQ_TYPE_SYNC_READ_WRITE &&
+        desc->flags != GBINDER_FMQ_TYPE_UNSYNC_WRITE)) {
+        GWARN("Invalid FMQ descriptor");
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        if (grantors[i].fd_index >= fds->num_fds || !grantors[i].extent) {
+            GWARN("Invalid FMQ grantor %u", i);
+            return NULL;
+        }
+    }
+    if (grantors[DATA_PTR_POS].extent % desc->quantum) {
+        GWARN("FMQ size %u isn't a multiple of %u", (guint)
+            grantors[DATA_PTR_POS].extent, desc->quantum);
+        return NULL;
+    } else {
+        GBinderFmq* self = g_slice_new0(GBinderFmq);
+        const gsize fds_size = sizeof(GBinderFds) + sizeof(int) *
+            fds->num_fds;
+        GBinderFds* copy = g_malloc0(fds_size);
+        int* fd = (int*)(copy + 1);
+
+        copy->version = fds_size;
+        copy->num_fds = fds->num_fds;
+        for (i = 0; i < fds->num_fds; i++) {
+            fd[i] = fcntl(gbinder_fds_get_fd(fds, i), F_DUPFD_CLOEXEC, 0);
+            if (fd[i] < 0) {
+                GWARN("Failed to dup FMQ fd: %s", strerror(errno));
+                while (i > 0) {
+                    close(fd[--i]);
+                }
+                g_free(copy);
+                g_slice_free(GBinderFmq, self);
+                return NULL;
+            }
+        }
+
+        /* Touching the memory beyond the end of file would be SIGBUS */
+        for (i = 0; i < count; i++) {
+            struct stat st;
+
+            if (fstat(fd[grantors[i].fd_index], &st) < 0 ||
+                (guint64)st.st_size < grantors[i].offset +
+                grantors[i].extent) {
+                GWARN("FMQ grantor %u is out of bounds", i);
+                for (i = 0; i < copy->num_fds; i++) {
+                    close(fd[i]);
+                }
+                g_free(copy);
+                g_slice_free(GBinderFmq, self);
+                return NULL;
+            }
+        }
+
+        self->imported = TRUE;
+        self->map_flags = MAP_SHARED;
+        self->desc = g_new0(GBinderMQDescriptor, 1);
+        self->desc->data.fds = copy;
+        self->desc->quantum = desc->quantum;
+        self->desc->flags = desc->flags;
+        self->desc->grantors.data.ptr = gutil_memdup(grantors,
+            sizeof(GBinderFmqGrantorDescriptor) * count);
+        self->desc->grantors.count = count;
+        self->desc->grantors.owns_buffer = TRUE;
+        g_atomic_int_set(&self->refcount, 1);
+
+        gbinder_fmq_map_pointers(self);
+        if (!self->read_ptr || !self->write_ptr || !self->ring) {
+            gbinder_fmq_free(self);
+            return NULL;
+        }
+        if (desc->flags == GBINDER_FMQ_TYPE_UNSYNC_WRITE) {
+            /* New reader starts with whatever gets written next */
+            *self->read_ptr = __atomic_load_n(self->write_ptr,
+                __ATOMIC_ACQUIRE);
+        }
+        self->cached_read_ptr = __atomic_load_n(self->read_ptr,
+            __ATOMIC_ACQUIRE);
+        self->cached_write_ptr = __atomic_load_n(self->write_ptr,
+            __ATOMIC_ACQUIRE);
+        return self;
+    }
+}
+
 /* Public API */
 
 GBinderFmq*
@@ -265,32 +635,33 @@ gbinder_fmq_new(
         gboolean configure_event_flag =
             (flags & GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG) != 0;
         gsize queue_size_bytes = num_items * item_size;
-        gsize meta_data_size;
+        gsize num_fds = (fd != -1) ? 2 : 1;
         gsize shmem_size;
         int shmem_fd;
+        GBinderFmqGrantorDescriptor* grantors;
 
-        meta_data_size = 2 * sizeof(guint64);
-        if (configure_event_flag) {
-            meta_data_size += sizeof(guint32);
+        if (fd != -1 && (flags & GBINDER_FMQ_FLAG_HUGE_PAGES)) {
+            /* Huge pages only make sense for the ring buffer */
+            GDEBUG("Ignoring huge pages flag for user-supplied memory");
+            flags &= ~GBINDER_FMQ_FLAG_HUGE_PAGES;
         }
 
-        /* Allocate shared memory */
-        if (fd != -1) {
-            /* User-supplied ringbuffer memory provided,
-             * allocating memory only for meta data */
-            shmem_size = (meta_data_size + getpagesize() - 1) &
-                ~(getpagesize() - 1);
-        } else {
-            /* Allocate ringbuffer, read counter and write counter */
-            shmem_size = (G_ALIGN8(queue_size_bytes) +
-                meta_data_size + getpagesize() - 1) & ~(getpagesize() - 1);
+        /*
+         * Allocate shared memory. If user-supplied ringbuffer memory is
+         * provided, memory is allocated only for meta data.
+         */
+        grantors = gbinder_fmq_create_grantors(queue_size_bytes, num_fds,
+            flags, &shmem_size);
+        self->map_flags = MAP_SHARED;
+        if (flags & GBINDER_FMQ_FLAG_PREFAULT) {
+            /* Take the page faults now rather than while streaming */
+            self->map_flags |= MAP_POPULATE;
         }
+        shmem_fd = gbinder_fmq_alloc_shmem(shmem_size,
+            (flags & GBINDER_FMQ_FLAG_HUGE_PAGES) != 0, self->map_flags,
+            &self->map_size, &self->map);
 
-        shmem_fd = syscall(__NR_memfd_create, "MessageQueue", MFD_CLOEXEC);
-
-        if (shmem_fd >= 0 && ftruncate(shmem_fd, shmem_size) == 0) {
-            GBinderFmqGrantorDescriptor* grantors;
-            gsize num_fds = (fd != -1) ? 2 : 1;
+        if (shmem_fd >= 0) {
             gsize fds_size = sizeof(GBinderFds) + sizeof(int) * num_fds;
             GBinderFds* fds = (GBinderFds*)g_malloc0(fds_size);
 
@@ -303,8 +674,6 @@ gbinder_fmq_new(
                 /* Use user-supplied file descriptor for fd_index 1 */
                 (((int*)((fds) + 1))[1]) = fd;
             }
-            grantors = gbinder_fmq_create_grantors(queue_size_bytes,
-                num_fds, configure_event_flag);
 
             /* Fill FMQ descriptor */
             self->desc = g_new0(GBinderMQDescriptor, 1);
@@ -317,27 +686,7 @@ gbinder_fmq_new(
             self->desc->grantors.owns_buffer = TRUE;
 
             /* Initialize memory pointers */
-            if (type == GBINDER_FMQ_TYPE_SYNC_READ_WRITE) {
-                self->read_ptr = gbinder_fmq_map_grantor_descriptor(self,
-                    READ_PTR_POS);
-            } else {
-                /*
-                 * Unsynchronized write FMQs may have multiple readers and
-                 * each reader would have their own read pointer counter.
-                 */
-                self->read_ptr = g_new0(guint64, 1);
-            }
-
-            if (!self->read_ptr) {
-                GWARN("Read pointer is null");
-            }
-
-            self->write_ptr = gbinder_fmq_map_grantor_descriptor(self,
-                WRITE_PTR_POS);
-            if (!self->write_ptr) {
-                GWARN("Write pointer is null");
-            }
-
+            gbinder_fmq_map_pointers(self);
             if (!(flags & GBINDER_FMQ_FLAG_NO_RESET_POINTERS)) {
                 __atomic_store_n(self->read_ptr, 0, __ATOMIC_RELEASE);
                 __atomic_store_n(self->write_ptr, 0, __ATOMIC_RELEASE);
@@ -345,19 +694,11 @@ gbinder_fmq_new(
                 /* Always reset the read pointer */
                 __atomic_store_n(self->read_ptr, 0, __ATOMIC_RELEASE);
             }
-
-            self->ring = gbinder_fmq_map_grantor_descriptor(self,
-                DATA_PTR_POS);
-            if (!self->ring) {
-                GWARN("Ring buffer pointer is null");
-            }
-
-            if (self->desc->grantors.count > EVENT_FLAG_PTR_POS) {
-                self->event_flag_ptr = gbinder_fmq_map_grantor_descriptor(self,
-                    EVENT_FLAG_PTR_POS);
-                if (!self->event_flag_ptr) {
-                    GWARN("Event flag pointer is null");
-                }
+            if (self->read_ptr && self->write_ptr) {
+                self->cached_read_ptr = __atomic_load_n(self->read_ptr,
+                    __ATOMIC_ACQUIRE);
+                self->cached_write_ptr = __atomic_load_n(self->write_ptr,
+                    __ATOMIC_ACQUIRE);
             }
 
             g_atomic_int_set(&self->refcount, 1);
@@ -365,6 +706,7 @@ gbinder_fmq_new(
         }
 
         GWARN("Failed to allocate shared memory: %s", strerror(errno));
+        g_free(grantors);
         gbinder_fmq_free(self);
     }
 
@@ -426,6 +768,58 @@ gbinder_fmq_available_to_write_contiguous(
         self->desc->quantum) : 0;
 }
 
+GBINDER_INLINE_FUNC
+guint64
+gbinder_fmq_refresh_write_ptr(
+    GBinderFmq* self)
+{
+    /* Only touch the writer's cache line if we have to */
+    return (self->cached_write_ptr = __atomic_load_n(self->write_ptr,
+        __ATOMIC_ACQUIRE));
+}
+
+GBINDER_INLINE_FUNC
+guint64
+gbinder_fmq_refresh_read_ptr(
+    GBinderFmq* self)
+{
+    /* Only touch the reader's cache line if we have to */
+    return (self->cached_read_ptr = __atomic_load_n(self->read_ptr,
+        __ATOMIC_ACQUIRE));
+}
+
+static
+void
+gbinder_fmq_overrun(
+    GBinderFmq* self,
+    guint64 read_ptr,
+    guint64 write_ptr)
+{
+    const guint64 lost = (write_ptr - read_ptr) / self->desc->quantum;
+
+    /* Skip everything that's been overwritten, it's of no use anyway */
+    GDEBUG("FMQ reader lost %" G_GUINT64_FORMAT " item(s)", lost);
+    self->lost_items += lost;
+    __atomic_store_n(self->read_ptr, write_ptr, __ATOMIC_RELEASE);
+}
+
+static
+gboolean
+gbinder_fmq_can_write_bytes(
+    GBinderFmq* self,
+    guint64 write_ptr,
+    gsize bytes)
+{
+    const gsize size = gbinder_fmq_get_grantor_descriptor(self,
+        DATA_PTR_POS)->extent;
+    guint64 used = write_ptr - self->cached_read_ptr;
+
+    if (used > size || size - used < bytes) {
+        used = write_ptr - gbinder_fmq_refresh_read_ptr(self);
+    }
+    return used <= size && size - used >= bytes;
+}
+
 const void*
 gbinder_fmq_begin_read(
     GBinderFmq* self,
@@ -438,13 +832,23 @@ gbinder_fmq_begin_read(
             DATA_PTR_POS)->extent;
         gsize item_size = self->desc->quantum;
         gsize bytes_desired = items * item_size;
-        guint64 write_ptr = __atomic_load_n(self->write_ptr, __ATOMIC_ACQUIRE);
         guint64 read_ptr = __atomic_load_n(self->read_ptr, __ATOMIC_RELAXED);
+        guint64 write_ptr;
+
+        if (self->desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE) {
+            write_ptr = self->cached_write_ptr;
+            if (write_ptr - read_ptr < bytes_desired ||
+                write_ptr - read_ptr > size) {
+                write_ptr = gbinder_fmq_refresh_write_ptr(self);
+            }
+        } else {
+            write_ptr = __atomic_load_n(self->write_ptr, __ATOMIC_ACQUIRE);
+        }
 
         if ((write_ptr % item_size) || (read_ptr % item_size)) {
             GWARN("Unable to write data because of misaligned pointer");
         } else if (write_ptr - read_ptr > size) {
-            __atomic_store_n(self->read_ptr, write_ptr, __ATOMIC_RELEASE);
+            gbinder_fmq_overrun(self, read_ptr, write_ptr);
         } else if (write_ptr - read_ptr < bytes_desired) {
             /* Not enough data to read in FMQ. */
         } else {
@@ -465,21 +869,19 @@ gbinder_fmq_begin_write(
         const gsize item_size = self->desc->quantum;
         const gsize size = gbinder_fmq_get_grantor_descriptor(self,
             DATA_PTR_POS)->extent;
+        const gsize bytes_desired = items * item_size;
+        const guint64 write_ptr = __atomic_load_n(self->write_ptr,
+            __ATOMIC_RELAXED);
 
-        if ((self->desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE &&
-            (gbinder_fmq_available_to_write(self) < items)) ||
-            items > size / item_size) {
+        if (items > size / item_size) {
             /* Incorrect parameters */
+        } else if (self->desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE &&
+            !gbinder_fmq_can_write_bytes(self, write_ptr, bytes_desired)) {
+            /* Not enough space */
+        } else if (write_ptr % item_size) {
+            GWARN("The write pointer has become misaligned.");
         } else {
-            guint64 write_ptr = __atomic_load_n(self->write_ptr,
-                __ATOMIC_RELAXED);
-
-            if (write_ptr % item_size) {
-                GWARN("The write pointer has become misaligned.");
-            } else {
-
-                ptr = self->ring + (write_ptr % size);
-            }
+            ptr = self->ring + (write_ptr % size);
         }
     }
     return ptr;
@@ -494,17 +896,27 @@ gbinder_fmq_end_read(
         gsize size = gbinder_fmq_get_grantor_descriptor(self,
             DATA_PTR_POS)->extent;
         guint64 read_ptr = __atomic_load_n(self->read_ptr, __ATOMIC_RELAXED);
-        guint64 write_ptr = __atomic_load_n(self->write_ptr, __ATOMIC_ACQUIRE);
 
-        /*
-         * If queue type is unsynchronized, it is possible that a write
-         * overflow may have occurred.
-         */
-        if (write_ptr - read_ptr > size) {
-            __atomic_store_n(self->read_ptr, write_ptr, __ATOMIC_RELEASE);
+        if (self->desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE) {
+            /* Synchronized writer can't overrun the reader */
+            __atomic_store_n(self->read_ptr, read_ptr + items *
+                self->desc->quantum, __ATOMIC_RELEASE);
         } else {
-            read_ptr += items * self->desc->quantum;
-            __atomic_store_n(self->read_ptr, read_ptr, __ATOMIC_RELEASE);
+            const guint64 write_ptr = __atomic_load_n(self->write_ptr,
+                __ATOMIC_ACQUIRE);
+
+            /*
+             * If queue type is unsynchronized, the writer may have
+             * overwritten the items while they were being read. Then
+             * they are counted as lost, along with everything else
+             * that got overwritten.
+             */
+            if (write_ptr - read_ptr > size) {
+                gbinder_fmq_overrun(self, read_ptr, write_ptr);
+            } else {
+                __atomic_store_n(self->read_ptr, read_ptr + items *
+                    self->desc->quantum, __ATOMIC_RELEASE);
+            }
         }
     }
 }
@@ -522,37 +934,184 @@ gbinder_fmq_end_write(
     }
 }
 
+static
 gboolean
-gbinder_fmq_read(
+gbinder_fmq_fill_tx(
     GBinderFmq* self,
-    void* data,
-    gsize items)
+    void* ptr,
+    gsize items,
+    GBinderFmqMemTransaction* tx)
 {
-    if (G_LIKELY(self) && G_LIKELY(data) && G_LIKELY(items > 0)) {
-        const void* in_data = gbinder_fmq_begin_read(self, items);
+    if (ptr) {
+        const gsize size = gbinder_fmq_get_grantor_descriptor(self,
+            DATA_PTR_POS)->extent;
+        const gsize item_size = self->desc->quantum;
+        const gsize contiguous = (size - ((guint8*)ptr - self->ring)) /
+            item_size;
+
+        tx->first.ptr = ptr;
+        if (contiguous < items) {
+            /* Wraps around the end of the ring buffer */
+            tx->first.items = contiguous;
+            tx->second.ptr = self->ring;
+            tx->second.items = items - contiguous;
+        } else {
+            tx->first.items = items;
+            tx->second.ptr = NULL;
+            tx->second.items = 0;
+        }
+        return TRUE;
+    } else {
+        memset(tx, 0, sizeof(*tx));
+        return FALSE;
+    }
+}
 
-        if (in_data) {
-            /*
-             * The number of messages that can be read contiguously without
-             * wrapping around the ring buffer.
-             */
-            const gsize contiguous_messages =
-                gbinder_fmq_available_to_read_contiguous(self);
-            const gsize item_size = self->desc->quantum;
-
-            if (contiguous_messages < items) {
-                /* A wrap around is required */
-                memcpy(data, in_data, contiguous_messages * item_size);
-                memcpy((char*)data + contiguous_messages * item_size,
-                    self->ring, (items - contiguous_messages) * item_size);
+gboolean
+gbinder_fmq_begin_read_tx(
+    GBinderFmq* self,
+    gsize items,
+    GBinderFmqMemTransaction* tx) /* Since 1.1.25 */
+{
+    if (G_LIKELY(tx)) {
+        return gbinder_fmq_fill_tx(self, (void*)
+            gbinder_fmq_begin_read(self, items), items, tx);
+    }
+    return FALSE;
+}
+
+gboolean
+gbinder_fmq_begin_write_tx(
+    GBinderFmq* self,
+    gsize items,
+    GBinderFmqMemTransaction* tx) /* Since 1.1.25 */
+{
+    if (G_LIKELY(tx)) {
+        return gbinder_fmq_fill_tx(self, gbinder_fmq_begin_write(self, items),
+            items, tx);
+    }
+    return FALSE;
+}
+
+/*
+ * Messages sent over the byte queue negotiated by
+ * gbinder_client_open_fmq_channel. The writer commits each message
+ * with a single counter update, so the reader never sees a partial one.
+ */
+static
+void
+gbinder_fmq_channel_copy(
+    const GBinderFmqMemTransaction* tx,
+    gsize offset,
+    void* buf,
+    gsize len,
+    gboolean out)
+{
+    const GBinderFmqMemRegion* regions[2];
+    guint8* ptr = buf;
+    guint i;
+
+    regions[0] = &tx->first;
+    regions[1] = &tx->second;
+    for (i = 0; i < G_N_ELEMENTS(regions) && len; i++) {
+        const GBinderFmqMemRegion* r = regions[i];
+
+        if (offset >= r->items) {
+            offset -= r->items;
+        } else {
+            const gsize n = MIN(len, r->items - offset);
+            guint8* mem = (guint8*)r->ptr + offset;
+
+            if (out) {
+                memcpy(ptr, mem, n);
             } else {
-                /* A wrap around is not required */
-                memcpy(data, in_data, items * item_size);
+                memcpy(mem, ptr, n);
             }
+            ptr += n;
+            len -= n;
+            offset = 0;
+        }
+    }
+}
 
-            gbinder_fmq_end_read(self, items);
-            return TRUE;
+gboolean
+gbinder_fmq_channel_write(
+    GBinderFmq* self,
+    guint32 code,
+    const void* data,
+    gsize size)
+{
+    GBinderFmqChannelHeader hdr;
+    GBinderFmqMemTransaction tx;
+    const gsize total = sizeof(hdr) + size;
+
+    if (size <= G_MAXUINT32 && gbinder_fmq_begin_write_tx(self, total, &tx)) {
+        hdr.code = code;
+        hdr.size = (guint32)size;
+        gbinder_fmq_channel_copy(&tx, 0, &hdr, sizeof(hdr), FALSE);
+        gbinder_fmq_channel_copy(&tx, sizeof(hdr), (void*)data, size, FALSE);
+        gbinder_fmq_end_write(self, total);
+        gbinder_fmq_wake(self, GBINDER_FMQ_NOT_EMPTY);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+int
+gbinder_fmq_channel_read(
+    GBinderFmq* self,
+    guint32* code,
+    void** data,
+    gsize* size)
+{
+    GBinderFmqChannelHeader hdr;
+    GBinderFmqMemTransaction tx;
+
+    if (gbinder_fmq_begin_read_tx(self, sizeof(hdr), &tx)) {
+        const gsize max = gbinder_fmq_get_grantor_descriptor(self,
+            DATA_PTR_POS)->extent;
+
+        gbinder_fmq_channel_copy(&tx, 0, &hdr, sizeof(hdr), TRUE);
+        if (hdr.size <= max - sizeof(hdr) && gbinder_fmq_begin_read_tx(self,
+            sizeof(hdr) + hdr.size, &tx)) {
+            void* buf = g_malloc(hdr.size);
+
+            gbinder_fmq_channel_copy(&tx, sizeof(hdr), buf, hdr.size, TRUE);
+            gbinder_fmq_end_read(self, sizeof(hdr) + hdr.size);
+            *code = hdr.code;
+            *data = buf;
+            *size = hdr.size;
+            return 1;
         }
+        /* The writer never leaves a message half-written */
+        GWARN("Broken FMQ channel message (%u bytes)", hdr.size);
+        return -EBADMSG;
+    }
+    return 0;
+}
+
+gboolean
+gbinder_fmq_read(
+    GBinderFmq* self,
+    void* data,
+    gsize items)
+{
+    GBinderFmqMemTransaction tx;
+
+    if (G_LIKELY(data) && gbinder_fmq_begin_read_tx(self, items, &tx)) {
+        const gsize item_size = self->desc->quantum;
+        const gsize first_bytes = tx.first.items * item_size;
+        const guint64 lost = self->lost_items;
+
+        memcpy(data, tx.first.ptr, first_bytes);
+        if (tx.second.items) {
+            /* A wrap around is required */
+            memcpy((char*)data + first_bytes, tx.second.ptr,
+                tx.second.items * item_size);
+        }
+        gbinder_fmq_end_read(self, items);
+        /* Unless the data got overwritten while we were copying it */
+        return self->lost_items == lost;
     }
     return FALSE;
 }
@@ -563,36 +1122,125 @@ gbinder_fmq_write(
     const void* data,
     gsize items)
 {
-    if (G_LIKELY(self) && G_LIKELY(data) && G_LIKELY(items > 0)) {
-        void *out_data = gbinder_fmq_begin_write(self, items);
+    GBinderFmqMemTransaction tx;
 
-        if (out_data) {
-            /*
-             * The number of messages that can be written contiguously without
-             * wrapping around the ring buffer.
-             */
-            const gsize contiguous_messages =
-                gbinder_fmq_available_to_write_contiguous(self);
-            const gsize item_size = self->desc->quantum;
-
-            if (contiguous_messages < items) {
-                /* A wrap around is required. */
-                memcpy(out_data, data, contiguous_messages * item_size);
-                memcpy(self->ring, (char *)data + contiguous_messages *
-                    item_size / sizeof(char),
-                    (items - contiguous_messages) * item_size);
-            } else {
-                /* A wrap around is not required to write items */
-                memcpy(out_data, data, items * item_size);
-            }
+    if (G_LIKELY(data) && gbinder_fmq_begin_write_tx(self, items, &tx)) {
+        const gsize item_size = self->desc->quantum;
+        const gsize first_bytes = tx.first.items * item_size;
 
-            gbinder_fmq_end_write(self, items);
-            return TRUE;
+        memcpy(tx.first.ptr, data, first_bytes);
+        if (tx.second.items) {
+            /* A wrap around is required */
+            memcpy(tx.second.ptr, (const char*)data + first_bytes,
+                tx.second.items * item_size);
         }
+        gbinder_fmq_end_write(self, items);
+        return TRUE;
     }
     return FALSE;
 }
 
+gsize
+gbinder_fmq_read_batch(
+    GBinderFmq* self,
+    void* data,
+    gsize max_items) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && G_LIKELY(data) && G_LIKELY(max_items)) {
+        gsize items;
+
+        if (self->desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE) {
+            /* Refresh the cached write counter once for the whole batch */
+            const guint64 read_ptr = __atomic_load_n(self->read_ptr,
+                __ATOMIC_RELAXED);
+
+            items = (gbinder_fmq_refresh_write_ptr(self) - read_ptr) /
+                self->desc->quantum;
+        } else {
+            /* Let gbinder_fmq_begin_read() deal with overruns */
+            items = gbinder_fmq_available_to_read(self);
+        }
+
+        items = MIN(items, max_items);
+        if (items && gbinder_fmq_read(self, data, items)) {
+            return items;
+        }
+    }
+    return 0;
+}
+
+gsize
+gbinder_fmq_write_batch(
+    GBinderFmq* self,
+    const void* data,
+    gsize max_items) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && G_LIKELY(data) && G_LIKELY(max_items)) {
+        const gsize size = gbinder_fmq_get_grantor_descriptor(self,
+            DATA_PTR_POS)->extent;
+        gsize items;
+
+        if (self->desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE) {
+            /* Refresh the cached read counter once for the whole batch */
+            const guint64 used = __atomic_load_n(self->write_ptr,
+                __ATOMIC_RELAXED) - gbinder_fmq_refresh_read_ptr(self);
+
+            items = (used < size) ? ((size - used) / self->desc->quantum) : 0;
+        } else {
+            /* Unsynchronized writer never waits for the readers */
+            items = size / self->desc->quantum;
+        }
+
+        items = MIN(items, max_items);
+        if (items && gbinder_fmq_write(self, data, items)) {
+            return items;
+        }
+    }
+    return 0;
+}
+
+static
+int
+gbinder_fmq_spin(
+    GBinderFmq* self,
+    guint32 bit_mask,
+    guint32* state,
+    gint64 deadline_ns)
+{
+    /*
+     * Polls the event flag and the counters. Returns -EAGAIN if the
+     * counters have moved without the bits being set, i.e. the other
+     * side made progress, but didn't (yet) notify us. The caller may
+     * want to check the queue again before going to sleep.
+     */
+    const guint64 read_ptr = __atomic_load_n(self->read_ptr, __ATOMIC_RELAXED);
+    const guint64 write_ptr = __atomic_load_n(self->write_ptr,
+        __ATOMIC_RELAXED);
+    const gint64 spin_end = gbinder_fmq_now_ns() + self->spin_ns;
+    const gint64 end = (deadline_ns && deadline_ns < spin_end) ?
+        deadline_ns : spin_end;
+
+    do {
+        if (__atomic_load_n(self->event_flag_ptr, __ATOMIC_RELAXED) &
+            bit_mask) {
+            const guint32 set_bits = __atomic_fetch_and(self->event_flag_ptr,
+                ~bit_mask, __ATOMIC_SEQ_CST) & bit_mask;
+
+            if (set_bits) {
+                *state = set_bits;
+                return 0;
+            }
+        }
+        if (__atomic_load_n(self->read_ptr, __ATOMIC_ACQUIRE) != read_ptr ||
+            __atomic_load_n(self->write_ptr, __ATOMIC_ACQUIRE) != write_ptr) {
+            *state = 0;
+            return (-EAGAIN);
+        }
+        gbinder_fmq_cpu_relax();
+    } while (gbinder_fmq_now_ns() < end);
+    return (-ETIMEDOUT);
+}
+
 int
 gbinder_fmq_wait_timeout(
     GBinderFmq* self,
@@ -604,7 +1252,8 @@ gbinder_fmq_wait_timeout(
         return (-EINVAL);
     } else if (!self->event_flag_ptr) {
         return (-ENOSYS);
-    } else if (!bit_mask) {
+    } else if (!bit_mask || (self->lazy_wake &&
+        (bit_mask & GBINDER_FMQ_SLEEPER_BIT))) {
         return (-EINVAL);
     } else {
         guint32 old_value = __atomic_fetch_and(self->event_flag_ptr, ~bit_mask,
@@ -618,29 +1267,51 @@ gbinder_fmq_wait_timeout(
         } else if (!timeout_ms) {
             return (-ETIMEDOUT);
         } else {
+            const gint64 sec = 1000000000;
+            const gint64 deadline_ns = (timeout_ms > 0) ?
+                (gbinder_fmq_now_ns() + ((gint64)timeout_ms) * 1000000) : 0;
+            struct timespec deadline;
+            guint32 wait_mask = bit_mask;
             int ret;
 
-            if (timeout_ms > 0) {
-                struct timespec deadline;
-                const guint64 ms = 1000000;
-                const guint64 sec = 1000 * ms;
-
-                clock_gettime(CLOCK_MONOTONIC, &deadline);
-                deadline.tv_sec += timeout_ms / 1000;
-                deadline.tv_nsec += (timeout_ms % 1000) * ms;
-                if (deadline.tv_nsec >= sec) {
-                    deadline.tv_sec++;
-                    deadline.tv_nsec -= sec;
+            if (self->spin_ns > 0) {
+                /* Maybe the other side is just a bit behind */
+                ret = gbinder_fmq_spin(self, bit_mask, state, deadline_ns);
+                if (ret != (-ETIMEDOUT) ||
+                    (deadline_ns && gbinder_fmq_now_ns() >= deadline_ns)) {
+                    return ret;
                 }
+            }
 
+            if (self->lazy_wake) {
+                /*
+                 * Let the waker know that someone is sleeping. Any change
+                 * of the value after this point makes FUTEX_WAIT return
+                 * immediately, so nothing gets lost.
+                 */
+                old_value = __atomic_fetch_or(self->event_flag_ptr,
+                    GBINDER_FMQ_SLEEPER_BIT, __ATOMIC_SEQ_CST) |
+                    GBINDER_FMQ_SLEEPER_BIT;
+                wait_mask = FUTEX_BITSET_MATCH_ANY;
+            } else {
+                old_value = __atomic_load_n(self->event_flag_ptr,
+                    __ATOMIC_SEQ_CST);
+            }
+
+            if (old_value & bit_mask) {
+                /* Something has arrived in the meantime */
+                ret = 0;
+            } else if (deadline_ns) {
+                deadline.tv_sec = deadline_ns / sec;
+                deadline.tv_nsec = deadline_ns % sec;
                 ret = syscall(__NR_futex, self->event_flag_ptr,
-                    FUTEX_WAIT_BITSET, old_value, &deadline, NULL, bit_mask);
+                    FUTEX_WAIT_BITSET, old_value, &deadline, NULL, wait_mask);
             } else {
                 ret = syscall(__NR_futex, self->event_flag_ptr,
-                    FUTEX_WAIT_BITSET, old_value, NULL, NULL, bit_mask);
+                    FUTEX_WAIT_BITSET, old_value, NULL, NULL, wait_mask);
             }
 
-            if (ret == -1) {
+            if (ret == -1 && errno != EAGAIN) {
                 return errno ? (-errno) : -EFAULT;
             } else {
                 old_value = __atomic_fetch_and(self->event_flag_ptr, ~bit_mask,
@@ -665,6 +1336,27 @@ gbinder_fmq_wake(
             ret = -ENOSYS;
         } else if (!bit_mask) {
             /* Ignore zero bit mask */
+        } else if (self->lazy_wake) {
+            if (bit_mask & GBINDER_FMQ_SLEEPER_BIT) {
+                ret = -EINVAL;
+            } else {
+                guint32 old_value = __atomic_fetch_or(self->event_flag_ptr,
+                    bit_mask, __ATOMIC_SEQ_CST);
+
+                /*
+                 * Skip the syscall unless someone is actually sleeping.
+                 * Wake everyone, because we have just cleared the sleeper
+                 * bit and those who are waiting for other bits need to
+                 * set it again.
+                 */
+                if (old_value & GBINDER_FMQ_SLEEPER_BIT) {
+                    __atomic_fetch_and(self->event_flag_ptr,
+                        ~GBINDER_FMQ_SLEEPER_BIT, __ATOMIC_SEQ_CST);
+                    ret = syscall(__NR_futex, self->event_flag_ptr,
+                        FUTEX_WAKE_BITSET, G_MAXUINT32, NULL, NULL,
+                        FUTEX_BITSET_MATCH_ANY);
+                }
+            }
         } else {
             /* Set bit mask only if needed */
             guint32 old_value = __atomic_fetch_or(self->event_flag_ptr,
@@ -674,11 +1366,11 @@ gbinder_fmq_wake(
                 ret = syscall(__NR_futex, self->event_flag_ptr,
                     FUTEX_WAKE_BITSET, G_MAXUINT32, NULL, NULL, bit_mask);
             }
+        }
 
-            if (ret == -1) {
-                /* Report error code */
-                ret = -errno;
-            }
+        if (ret == -1) {
+            /* Report error code */
+            ret = -errno;
         }
     } else {
         ret = -EINVAL;
@@ -686,6 +1378,242 @@ gbinder_fmq_wake(
     return ret;
 }
 
+int
+gbinder_fmq_wait_any(
+    GBinderFmq* const* fmqs,
+    const guint32* masks,
+    guint32* states,
+    gsize count,
+    int timeout_ms) /* Since 1.1.25 */
+{
+    const gint64 deadline_ns = (timeout_ms > 0) ?
+        (gbinder_fmq_now_ns() + ((gint64)timeout_ms) * 1000000) : 0;
+    GBinderFutexWaitv waitv[GBINDER_FUTEX_WAITV_MAX];
+    gsize i;
+
+    if (G_UNLIKELY(!fmqs) || G_UNLIKELY(!masks) || G_UNLIKELY(!states) ||
+        G_UNLIKELY(!count) || count > GBINDER_FUTEX_WAITV_MAX) {
+        return (-EINVAL);
+    }
+    for (i = 0; i < count; i++) {
+        GBinderFmq* self = fmqs[i];
+
+        if (G_UNLIKELY(!self) || !masks[i] || (self->lazy_wake &&
+            (masks[i] & GBINDER_FMQ_SLEEPER_BIT))) {
+            return (-EINVAL);
+        } else if (!self->event_flag_ptr) {
+            return (-ENOSYS);
+        }
+    }
+
+    for (;;) {
+        const gint64 sec = 1000000000;
+        struct timespec deadline;
+        int n = 0, ret;
+
+        /* Collect everything that's already there */
+        for (i = 0; i < count; i++) {
+            GBinderFmq* self = fmqs[i];
+            GBinderFutexWaitv* w = waitv + i;
+            guint32 value;
+
+            states[i] = gbinder_fmq_prepare_wait(self, masks[i], &value);
+            if (states[i]) {
+                n++;
+            }
+            w->val = value;
+            w->uaddr = GPOINTER_TO_SIZE(self->event_flag_ptr);
+            w->flags = FUTEX_32; /* Shared memory, not private */
+            w->reserved = 0;
+        }
+
+        if (n) {
+            return n;
+        } else if (!timeout_ms || (deadline_ns &&
+            gbinder_fmq_now_ns() >= deadline_ns)) {
+            return (-ETIMEDOUT);
+        }
+
+        deadline.tv_sec = deadline_ns / sec;
+        deadline.tv_nsec = deadline_ns % sec;
+        if (count == 1 || !gbinder_fmq_waitv_supported()) {
+            /*
+             * Without futex_waitv we can only sleep on one of the event
+             * flags at a time, so the others get checked at least every
+             * millisecond.
+             */
+            struct timespec slice;
+            const gint64 slice_ns = gbinder_fmq_now_ns() + 1000000;
+
+            if (count > 1 && (!deadline_ns || slice_ns < deadline_ns)) {
+                slice.tv_sec = slice_ns / sec;
+                slice.tv_nsec = slice_ns % sec;
+            } else {
+                slice = deadline;
+            }
+            ret = syscall(__NR_futex, fmqs[0]->event_flag_ptr,
+                FUTEX_WAIT_BITSET, (guint32) waitv[0].val,
+                (count > 1 || deadline_ns) ? &slice : NULL, NULL,
+                FUTEX_BITSET_MATCH_ANY);
+        } else {
+            ret = syscall(__NR_futex_waitv, waitv, count, 0,
+                deadline_ns ? &deadline : NULL, CLOCK_MONOTONIC);
+        }
+
+        if (ret < 0 && errno != EAGAIN && errno != EINTR &&
+            errno != ETIMEDOUT) {
+            return errno ? (-errno) : -EFAULT;
+        }
+        /* Otherwise go around and check the bits again */
+    }
+}
+
+void
+gbinder_fmq_set_spin(
+    GBinderFmq* self,
+    guint spin_ns,
+    GBINDER_FMQ_SPIN_FLAGS flags) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        self->spin_ns = spin_ns;
+        self->lazy_wake = (flags & GBINDER_FMQ_SPIN_LAZY_WAKE) != 0;
+    }
+}
+
+static
+int
+gbinder_fmq_transfer_blocking(
+    GBinderFmq* self,
+    gpointer data,
+    gsize items,
+    gboolean write,
+    guint32 wake_bits,
+    guint32 wait_bits,
+    int timeout_ms)
+{
+    const gint64 deadline = (timeout_ms > 0) ? (g_get_monotonic_time() +
+        ((gint64)timeout_ms) * 1000) : 0;
+
+    if (G_UNLIKELY(!self) || G_UNLIKELY(!data) || G_UNLIKELY(!items) ||
+        items > (gbinder_fmq_get_grantor_descriptor(self,
+        DATA_PTR_POS)->extent / self->desc->quantum)) {
+        return (-EINVAL);
+    } else if (!self->event_flag_ptr) {
+        return (-ENOSYS);
+    }
+
+    for (;;) {
+        guint32 state = 0;
+        int wait_ms, ret;
+
+        if (write ? gbinder_fmq_write(self, data, items) :
+            gbinder_fmq_read(self, data, items)) {
+            if (wake_bits) {
+                gbinder_fmq_wake(self, wake_bits);
+            }
+            return 0;
+        } else if (!wait_bits || !timeout_ms) {
+            return (-ETIMEDOUT);
+        } else if (timeout_ms < 0) {
+            wait_ms = -1;
+        } else {
+            const gint64 left = deadline - g_get_monotonic_time();
+
+            if (left <= 0) {
+                return (-ETIMEDOUT);
+            }
+            /* Round up, otherwise we would spin for the last millisecond */
+            wait_ms = (int)((left + 999) / 1000);
+        }
+
+        /*
+         * Notification bits are cleared by the wait, so a wake that
+         * happened between the attempt above and this wait isn't lost.
+         * Any kind of wake up (including not enough progress made by
+         * the other side) is followed by another attempt.
+         */
+        ret = gbinder_fmq_wait_timeout(self, wait_bits, &state, wait_ms);
+        if (ret < 0 && ret != (-ETIMEDOUT) && ret != (-EAGAIN) &&
+            ret != (-EINTR)) {
+            return ret;
+        }
+    }
+}
+
+int
+gbinder_fmq_read_blocking(
+    GBinderFmq* self,
+    void* data,
+    gsize items,
+    guint32 read_notification,
+    guint32 write_notification,
+    int timeout_ms) /* Since 1.1.25 */
+{
+    return gbinder_fmq_transfer_blocking(self, data, items, FALSE,
+        read_notification, write_notification, timeout_ms);
+}
+
+int
+gbinder_fmq_write_blocking(
+    GBinderFmq* self,
+    const void* data,
+    gsize items,
+    guint32 read_notification,
+    guint32 write_notification,
+    int timeout_ms) /* Since 1.1.25 */
+{
+    return gbinder_fmq_transfer_blocking(self, (gpointer)data, items, TRUE,
+        write_notification, read_notification, timeout_ms);
+}
+
+GBinderFmq*
+gbinder_fmq_new_reader(
+    GBinderFmq* self) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        if (self->desc->flags == GBINDER_FMQ_TYPE_UNSYNC_WRITE) {
+            /* Maps the same memory again, with a read counter of its own */
+            return gbinder_fmq_new_from_descriptor(self->desc);
+        }
+        GWARN("Synchronized FMQ can't have more than one reader");
+    }
+    return NULL;
+}
+
+guint64
+gbinder_fmq_lost_items(
+    GBinderFmq* self) /* Since 1.1.25 */
+{
+    return G_LIKELY(self) ? self->lost_items : 0;
+}
+
+gsize
+gbinder_fmq_resync(
+    GBinderFmq* self,
+    gsize max_items) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) &&
+        self->desc->flags == GBINDER_FMQ_TYPE_UNSYNC_WRITE) {
+        const gsize size = gbinder_fmq_get_grantor_descriptor(self,
+            DATA_PTR_POS)->extent;
+        const gsize item_size = self->desc->quantum;
+        const guint64 read_ptr = __atomic_load_n(self->read_ptr,
+            __ATOMIC_RELAXED);
+        const guint64 write_ptr = __atomic_load_n(self->write_ptr,
+            __ATOMIC_ACQUIRE);
+        const guint64 keep = (guint64)MIN(max_items, size / item_size) *
+            item_size;
+
+        if (!(write_ptr % item_size) && write_ptr - read_ptr > keep) {
+            const guint64 pos = write_ptr - keep;
+
+            __atomic_store_n(self->read_ptr, pos, __ATOMIC_RELEASE);
+            return (pos - read_ptr) / item_size;
+        }
+    }
+    return 0;
+}
+
 #else /* !GBINDER_FMQ_SUPPORTED */
 #pragma message("Not compiling FMQ")
 #endif
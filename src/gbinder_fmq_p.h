@@ -38,6 +38,7 @@
 
 /* FMQ functionality requires __NR_memfd_create syscall */
 #include <sys/syscall.h>
+#include <fcntl.h>
 
 #ifdef __NR_memfd_create
 #  define GBINDER_FMQ_SUPPORTED 1
@@ -46,11 +47,21 @@
 #endif
 
 /*
- * From linux/memfd.h
+ * From linux/memfd.h and linux/fcntl.h
  */
 #ifndef MFD_CLOEXEC
 #  define MFD_CLOEXEC 0x0001U
 #endif
+#ifndef MFD_ALLOW_SEALING
+#  define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#  define F_ADD_SEALS (1024 + 9)
+#  define F_SEAL_SEAL 0x0001
+#  define F_SEAL_SHRINK 0x0002
+#  define F_SEAL_GROW 0x0004
+#  define F_SEAL_WRITE 0x0008
+#endif
 
 /*
  * FMQ types
@@ -91,6 +102,79 @@ gbinder_fmq_get_descriptor(
     const GBinderFmq* self)
     GBINDER_INTERNAL;
 
+GBinderFmq*
+gbinder_fmq_new_from_descriptor(
+    const GBinderMQDescriptor* desc)
+    GBINDER_INTERNAL;
+
+/*
+ * FMQ channel (see gbinder_client_open_fmq_channel) is a byte queue
+ * with event flag. Each message is the header followed by the parcel.
+ */
+typedef struct gbinder_fmq_channel_header {
+    guint32 code;
+    guint32 size;
+} GBinderFmqChannelHeader;
+
+/* FALSE if there's no room for the message */
+gboolean
+gbinder_fmq_channel_write(
+    GBinderFmq* fmq,
+    guint32 code,
+    const void* data,
+    gsize size)
+    GBINDER_INTERNAL;
+
+/* 1 if a message has been read, 0 if there's none, negative on error */
+int
+gbinder_fmq_channel_read(
+    GBinderFmq* fmq,
+    guint32* code,
+    void** data,
+    gsize* size)
+    GBINDER_INTERNAL;
+
+/*
+ * futex_waitv (Linux 5.16+) from linux/futex.h
+ */
+#include <linux/futex.h>
+
+#ifndef __NR_futex_waitv
+#  define __NR_futex_waitv 449
+#endif
+#ifndef FUTEX_32
+#  define FUTEX_32 2
+#endif
+#define GBINDER_FUTEX_WAITV_MAX (128)
+
+typedef struct gbinder_futex_waitv {
+    guint64 val;
+    guint64 uaddr;
+    guint32 flags;
+    guint32 reserved;
+} GBinderFutexWaitv;
+
+gboolean
+gbinder_fmq_waitv_supported(
+    void)
+    GBINDER_INTERNAL;
+
+guint32*
+gbinder_fmq_event_flag(
+    GBinderFmq* self)
+    GBINDER_INTERNAL;
+
+/*
+ * Clears and returns the bits that are already set. If there are none,
+ * *value receives the event flag value to pass to FUTEX_WAIT.
+ */
+guint32
+gbinder_fmq_prepare_wait(
+    GBinderFmq* self,
+    guint32 bit_mask,
+    guint32* value)
+    GBINDER_INTERNAL;
+
 #endif /* GBINDER_FMQ_PRIVATE_H */
 
 /*
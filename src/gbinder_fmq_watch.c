@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gbinder_fmq_p.h"
+#include "gbinder_eventloop_p.h"
+#include "gbinder_log.h"
+
+#if GBINDER_FMQ_SUPPORTED
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * All watches are serviced by a single thread blocked in futex_waitv
+ * (Linux 5.16+), whose first futex is a private control word bumped
+ * whenever the set of watches changes. Older kernels fall back to one
+ * thread per watch.
+ */
+
+#define GBINDER_FMQ_WATCH_POLL_MS (100) /* Fallback cancellation latency */
+
+typedef struct gbinder_fmq_watch {
+    gint refcount;
+    gulong id;
+    GBinderFmq* fmq;
+    guint32 bit_mask;
+    guint32 pending;
+    gint cancelled;
+    GBinderFmqWatchFunc func;
+    void* user_data;
+    GThread* thread; /* Fallback only */
+} GBinderFmqWatch;
+
+typedef struct gbinder_fmq_watcher {
+    GThread* thread;
+    GPtrArray* watches;
+    guint32 control;
+    gboolean exit;
+} GBinderFmqWatcher;
+
+static GMutex gbinder_fmq_watch_mutex;
+static GHashTable* gbinder_fmq_watch_table = NULL;
+static GBinderFmqWatcher* gbinder_fmq_watcher = NULL;
+static gulong gbinder_fmq_watch_last_id = 0;
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+GBinderFmqWatch*
+gbinder_fmq_watch_ref(
+    GBinderFmqWatch* watch)
+{
+    g_atomic_int_inc(&watch->refcount);
+    return watch;
+}
+
+static
+void
+gbinder_fmq_watch_unref(
+    gpointer data)
+{
+    GBinderFmqWatch* watch = data;
+
+    if (g_atomic_int_dec_and_test(&watch->refcount)) {
+        gbinder_fmq_unref(watch->fmq);
+        g_slice_free(GBinderFmqWatch, watch);
+    }
+}
+
+static
+void
+gbinder_fmq_watch_dispatch(
+    gpointer data)
+{
+    GBinderFmqWatch* watch = data;
+    const guint32 state = __atomic_exchange_n(&watch->pending, 0,
+        __ATOMIC_SEQ_CST);
+
+    if (state && !g_atomic_int_get(&watch->cancelled)) {
+        watch->func(watch->fmq, state, watch->user_data);
+    }
+}
+
+static
+void
+gbinder_fmq_watch_signal(
+    GBinderFmqWatch* watch,
+    guint32 bits)
+{
+    /* One callback at a time, the bits accumulate until it's invoked */
+    if (!__atomic_fetch_or(&watch->pending, bits, __ATOMIC_SEQ_CST)) {
+        gbinder_idle_callback_invoke_later(gbinder_fmq_watch_dispatch,
+            gbinder_fmq_watch_ref(watch), gbinder_fmq_watch_unref);
+    }
+}
+
+static
+void
+gbinder_fmq_watcher_poke(
+    GBinderFmqWatcher* watcher)
+{
+    __atomic_fetch_add(&watcher->control, 1, __ATOMIC_SEQ_CST);
+    syscall(__NR_futex, &watcher->control, FUTEX_WAKE_PRIVATE, 1,
+        NULL, NULL, 0);
+}
+
+static
+gpointer
+gbinder_fmq_watcher_thread(
+    gpointer data)
+{
+    GBinderFmqWatcher* watcher = data;
+    GBinderFutexWaitv waitv[GBINDER_FUTEX_WAITV_MAX];
+    GBinderFmqWatch* watches[GBINDER_FUTEX_WAITV_MAX];
+
+    for (;;) {
+        gboolean signaled = FALSE;
+        guint i, n;
+
+        /* Lock */
+        g_mutex_lock(&gbinder_fmq_watch_mutex);
+        if (watcher->exit) {
+            g_mutex_unlock(&gbinder_fmq_watch_mutex);
+            /* Unlock */
+            break;
+        }
+        waitv[0].val = __atomic_load_n(&watcher->control, __ATOMIC_SEQ_CST);
+        n = watcher->watches->len;
+        for (i = 0; i < n; i++) {
+            watches[i] = gbinder_fmq_watch_ref(watcher->watches->pdata[i]);
+        }
+        g_mutex_unlock(&gbinder_fmq_watch_mutex);
+        /* Unlock */
+
+        waitv[0].uaddr = GPOINTER_TO_SIZE(&watcher->control);
+        waitv[0].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+        waitv[0].reserved = 0;
+        for (i = 0; i < n; i++) {
+            GBinderFmqWatch* watch = watches[i];
+            GBinderFutexWaitv* w = waitv + i + 1;
+            guint32 value;
+            const guint32 bits = gbinder_fmq_prepare_wait(watch->fmq,
+                watch->bit_mask, &value);
+
+            if (bits) {
+                gbinder_fmq_watch_signal(watch, bits);
+                signaled = TRUE;
+            }
+            w->val = value;
+            w->uaddr = GPOINTER_TO_SIZE(gbinder_fmq_event_flag(watch->fmq));
+            w->flags = FUTEX_32; /* Shared memory, not private */
+            w->reserved = 0;
+        }
+
+        /* If anything was signaled, re-arm before going to sleep */
+        if (!signaled && syscall(__NR_futex_waitv, waitv, n + 1, 0, NULL,
+            CLOCK_MONOTONIC) < 0 && errno != EAGAIN && errno != EINTR) {
+            GWARN("futex_waitv failed: %s", strerror(errno));
+        }
+
+        for (i = 0; i < n; i++) {
+            gbinder_fmq_watch_unref(watches[i]);
+        }
+    }
+    return NULL;
+}
+
+static
+gpointer
+gbinder_fmq_watch_thread(
+    gpointer data)
+{
+    GBinderFmqWatch* watch = data;
+
+    while (!g_atomic_int_get(&watch->cancelled)) {
+        guint32 state = 0;
+
+        if (gbinder_fmq_wait_timeout(watch->fmq, watch->bit_mask, &state,
+            GBINDER_FMQ_WATCH_POLL_MS) == 0 && state) {
+            gbinder_fmq_watch_signal(watch, state);
+        }
+    }
+    gbinder_fmq_watch_unref(watch);
+    return NULL;
+}
+
+/*==========================================================================*
+ * Interface
+ *==========================================================================*/
+
+gulong
+gbinder_fmq_add_watch(
+    GBinderFmq* fmq,
+    guint32 bit_mask,
+    GBinderFmqWatchFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    gulong id = 0;
+
+    if (G_LIKELY(fmq) && G_LIKELY(func) && G_LIKELY(bit_mask) &&
+        gbinder_fmq_event_flag(fmq)) {
+        GBinderFmqWatch* watch = g_slice_new0(GBinderFmqWatch);
+        const gboolean waitv = gbinder_fmq_waitv_supported();
+
+        g_atomic_int_set(&watch->refcount, 1);
+        watch->fmq = gbinder_fmq_ref(fmq);
+        watch->bit_mask = bit_mask;
+        watch->func = func;
+        watch->user_data = user_data;
+
+        /* Lock */
+        g_mutex_lock(&gbinder_fmq_watch_mutex);
+        if (waitv && gbinder_fmq_watcher &&
+            gbinder_fmq_watcher->watches->len + 1 >= GBINDER_FUTEX_WAITV_MAX) {
+            GWARN("Too many FMQ watches");
+        } else {
+            id = ++gbinder_fmq_watch_last_id;
+            if (!id) {
+                id = ++gbinder_fmq_watch_last_id;
+            }
+            watch->id = id;
+            if (!gbinder_fmq_watch_table) {
+                gbinder_fmq_watch_table = g_hash_table_new_full(g_direct_hash,
+                    g_direct_equal, NULL, gbinder_fmq_watch_unref);
+            }
+            g_hash_table_insert(gbinder_fmq_watch_table, GSIZE_TO_POINTER(id),
+                gbinder_fmq_watch_ref(watch));
+            if (waitv) {
+                GBinderFmqWatcher* watcher = gbinder_fmq_watcher;
+
+                if (!watcher) {
+                    watcher = gbinder_fmq_watcher =
+                        g_slice_new0(GBinderFmqWatcher);
+                    watcher->watches = g_ptr_array_new();
+                    watcher->thread = g_thread_new("gbinder-fmq-watch",
+                        gbinder_fmq_watcher_thread, watcher);
+                }
+                g_ptr_array_add(watcher->watches, watch);
+                gbinder_fmq_watcher_poke(watcher);
+            } else {
+                watch->thread = g_thread_new("gbinder-fmq-watch",
+                    gbinder_fmq_watch_thread, gbinder_fmq_watch_ref(watch));
+            }
+        }
+        g_mutex_unlock(&gbinder_fmq_watch_mutex);
+        /* Unlock */
+
+        gbinder_fmq_watch_unref(watch);
+    }
+    return id;
+}
+
+void
+gbinder_fmq_remove_watch(
+    GBinderFmq* fmq,
+    gulong id) /* Since 1.1.25 */
+{
+    if (G_LIKELY(fmq) && G_LIKELY(id)) {
+        GBinderFmqWatch* watch = NULL;
+        GBinderFmqWatcher* done = NULL;
+
+        /* Lock */
+        g_mutex_lock(&gbinder_fmq_watch_mutex);
+        if (gbinder_fmq_watch_table) {
+            watch = g_hash_table_lookup(gbinder_fmq_watch_table,
+                GSIZE_TO_POINTER(id));
+            if (watch && watch->fmq == fmq) {
+                GBinderFmqWatcher* watcher = gbinder_fmq_watcher;
+
+                g_hash_table_steal(gbinder_fmq_watch_table,
+                    GSIZE_TO_POINTER(id));
+                if (!g_hash_table_size(gbinder_fmq_watch_table)) {
+                    g_hash_table_destroy(gbinder_fmq_watch_table);
+                    gbinder_fmq_watch_table = NULL;
+                }
+                g_atomic_int_set(&watch->cancelled, TRUE);
+                if (watcher && g_ptr_array_remove(watcher->watches, watch)) {
+                    if (!watcher->watches->len) {
+                        /* The last one, let the thread go */
+                        watcher->exit = TRUE;
+                        gbinder_fmq_watcher = NULL;
+                        done = watcher;
+                    }
+                    gbinder_fmq_watcher_poke(watcher);
+                }
+            } else {
+                watch = NULL;
+            }
+        }
+        g_mutex_unlock(&gbinder_fmq_watch_mutex);
+        /* Unlock */
+
+        if (watch) {
+            if (watch->thread) {
+                /* Fallback thread notices cancellation within a poll */
+                g_thread_join(watch->thread);
+            }
+            gbinder_fmq_watch_unref(watch);
+        }
+        if (done) {
+            g_thread_join(done->thread);
+            g_ptr_array_free(done->watches, TRUE);
+            g_slice_free(GBinderFmqWatcher, done);
+        }
+    }
+}
+
+#endif /* GBINDER_FMQ_SUPPORTED */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
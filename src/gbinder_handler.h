@@ -40,6 +40,7 @@ typedef struct gbinder_handler_functions {
     GBinderLocalReply* (*transact)(GBinderHandler* handler,
         GBinderLocalObject* obj, GBinderRemoteRequest* req, guint code,
         guint flags, int* status);
+    void (*spawn_looper)(GBinderHandler* handler); /* Optional */
 } GBinderHandlerFunctions;
 
 struct gbinder_handler {
@@ -70,6 +71,16 @@ gbinder_handler_transact(
         NULL;
 }
 
+GBINDER_INLINE_FUNC
+void
+gbinder_handler_spawn_looper(
+    GBinderHandler* self)
+{
+    if (self && self->f->spawn_looper) {
+        self->f->spawn_looper(self);
+    }
+}
+
 #endif /* GBINDER_HANDLER_H */
 
 /*
@@ -49,15 +49,24 @@
 /*
  * This file is included from gbinder_io_32.c and gbinder_io_64.c to
  * generate the code for different ioctl codes and structure sizes.
+ * Single-ABI builds also include it from gbinder_io_fixed.h, with
+ * GBINDER_IO_INLINE defined, to get inlineable copies of the functions.
  */
 
+#ifndef GBINDER_IO_STATIC
+#  define GBINDER_IO_STATIC static
+#endif
+
 #define GBINDER_POINTER_SIZE sizeof(binder_uintptr_t)
 
+/* The lowest possible minimum priority, i.e. no minimum */
+#define GBINDER_IO_NO_MIN_PRIORITY (0x7f)
+
 #define GBINDER_IO_FN__(prefix,suffix) prefix##_##suffix
 #define GBINDER_IO_FN_(prefix,suffix) GBINDER_IO_FN__(prefix,suffix)
 #define GBINDER_IO_FN(fn) GBINDER_IO_FN_(GBINDER_IO_PREFIX,fn)
 
-static
+GBINDER_IO_STATIC
 int
 GBINDER_IO_FN(write_read)(
     int fd,
@@ -91,7 +100,7 @@ GBINDER_IO_FN(write_read)(
 }
 
 /* Returns size of the object */
-static
+GBINDER_IO_STATIC
 gsize
 GBINDER_IO_FN(object_size)(
     const void* obj)
@@ -117,7 +126,7 @@ GBINDER_IO_FN(object_size)(
 }
 
 /* Returns size of the object's extra data */
-static
+GBINDER_IO_STATIC
 gsize
 GBINDER_IO_FN(object_data_size)(
     const void* obj)
@@ -136,7 +145,7 @@ GBINDER_IO_FN(object_data_size)(
 }
 
 /* Writes pointer to the buffer */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_pointer)(
     void* out,
@@ -149,7 +158,7 @@ GBINDER_IO_FN(encode_pointer)(
 }
 
 /* Writes cookie to the buffer */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_cookie)(
     void* out,
@@ -162,7 +171,7 @@ GBINDER_IO_FN(encode_cookie)(
 }
 
 /* Encodes flat_binder_object */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_local_object)(
     void* out,
@@ -172,8 +181,20 @@ GBINDER_IO_FN(encode_local_object)(
 
     memset(dest, 0, sizeof(*dest));
     if (obj) {
+        const GBinderLocalObjectSched* sched = gbinder_local_object_sched(obj);
+
         dest->hdr.type = BINDER_TYPE_BINDER;
-        dest->flags = 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS;
+        dest->flags = FLAT_BINDER_FLAG_ACCEPTS_FDS;
+        if (sched && sched->policy >= 0) {
+            dest->flags |= (sched->priority & FLAT_BINDER_FLAG_PRIORITY_MASK) |
+                ((sched->policy << FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT) &
+                    FLAT_BINDER_FLAG_SCHED_POLICY_MASK);
+        } else {
+            dest->flags |= GBINDER_IO_NO_MIN_PRIORITY;
+        }
+        if (sched && sched->inherit_rt) {
+            dest->flags |= FLAT_BINDER_FLAG_INHERIT_RT;
+        }
         dest->binder = (uintptr_t)obj;
     } else {
         dest->hdr.type = BINDER_TYPE_WEAK_BINDER;
@@ -181,7 +202,7 @@ GBINDER_IO_FN(encode_local_object)(
     return sizeof(*dest);
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_remote_object)(
     void* out,
@@ -189,6 +210,10 @@ GBINDER_IO_FN(encode_remote_object)(
 {
     struct flat_binder_object* dest = out;
 
+    if (obj && obj->local) {
+        /* Back to where it came from */
+        return GBINDER_IO_FN(encode_local_object)(out, obj->local);
+    }
     memset(dest, 0, sizeof(*dest));
     if (obj) {
         dest->hdr.type = BINDER_TYPE_HANDLE;
@@ -200,7 +225,7 @@ GBINDER_IO_FN(encode_remote_object)(
     return sizeof(*dest);
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_fd_object)(
     void* out,
@@ -215,7 +240,7 @@ GBINDER_IO_FN(encode_fd_object)(
     return sizeof(*dest);
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_fda_object)(
     void* out,
@@ -233,7 +258,7 @@ GBINDER_IO_FN(encode_fda_object)(
 }
 
 /* Encodes binder_buffer_object */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_buffer_object)(
     void* out,
@@ -255,7 +280,7 @@ GBINDER_IO_FN(encode_buffer_object)(
     return sizeof(*dest);
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_handle_cookie)(
     void* out,
@@ -269,7 +294,7 @@ GBINDER_IO_FN(encode_handle_cookie)(
     return sizeof(*dest);
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_ptr_cookie)(
     void* out,
@@ -283,8 +308,12 @@ GBINDER_IO_FN(encode_ptr_cookie)(
     return sizeof(dest);
 }
 
-/* Fills binder_transaction_data for BC_TRANSACTION/REPLY */
-static
+/*
+ * Fills binder_transaction_data for BC_TRANSACTION/REPLY. Offsets are
+ * written to the caller supplied buffer which must have room for
+ * offsets->count pointers.
+ */
+GBINDER_IO_STATIC
 void
 GBINDER_IO_FN(fill_transaction_data)(
     struct binder_transaction_data* tr,
@@ -293,7 +322,7 @@ GBINDER_IO_FN(fill_transaction_data)(
     const GByteArray* payload,
     guint tx_flags,
     GUtilIntArray* offsets,
-    void** offsets_buf)
+    void* offsets_buf)
 {
     memset(tr, 0, sizeof(*tr));
     tr->target.handle = handle;
@@ -303,21 +332,18 @@ GBINDER_IO_FN(fill_transaction_data)(
     tr->flags = tx_flags;
     if (offsets && offsets->count) {
         guint i;
-        binder_size_t* tx_offsets = g_new(binder_size_t, offsets->count);
+        binder_size_t* tx_offsets = offsets_buf;
 
         tr->offsets_size = offsets->count * sizeof(binder_size_t);
         tr->data.ptr.offsets = (uintptr_t)tx_offsets;
         for (i = 0; i < offsets->count; i++) {
             tx_offsets[i] = offsets->data[i];
         }
-        *offsets_buf = tx_offsets;
-    } else {
-        *offsets_buf = NULL;
     }
 }
 
 /* Encodes BC_TRANSACTION data */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_transaction)(
     void* out,
@@ -326,7 +352,7 @@ GBINDER_IO_FN(encode_transaction)(
     const GByteArray* payload,
     guint flags,
     GUtilIntArray* offsets,
-    void** offsets_buf)
+    void* offsets_buf)
 {
     struct binder_transaction_data* tr = out;
 
@@ -337,7 +363,7 @@ GBINDER_IO_FN(encode_transaction)(
 }
 
 /* Encodes BC_TRANSACTION_SG data */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_transaction_sg)(
     void* out,
@@ -346,7 +372,7 @@ GBINDER_IO_FN(encode_transaction_sg)(
     const GByteArray* payload,
     guint flags,
     GUtilIntArray* offsets,
-    void** offsets_buf,
+    void* offsets_buf,
     gsize buffers_size)
 {
     struct binder_transaction_data_sg* sg = out;
@@ -360,7 +386,7 @@ GBINDER_IO_FN(encode_transaction_sg)(
 }
 
 /* Encodes BC_REPLY data */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_reply)(
     void* out,
@@ -368,7 +394,7 @@ GBINDER_IO_FN(encode_reply)(
     guint32 code,
     const GByteArray* payload,
     GUtilIntArray* offsets,
-    void** offsets_buf)
+    void* offsets_buf)
 {
     struct binder_transaction_data* tr = out;
 
@@ -378,7 +404,7 @@ GBINDER_IO_FN(encode_reply)(
 }
 
 /* Encodes BC_REPLY_SG data */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_reply_sg)(
     void* out,
@@ -386,7 +412,7 @@ GBINDER_IO_FN(encode_reply_sg)(
     guint32 code,
     const GByteArray* payload,
     GUtilIntArray* offsets,
-    void** offsets_buf,
+    void* offsets_buf,
     gsize buffers_size)
 {
     struct binder_transaction_data_sg* sg = out;
@@ -399,7 +425,7 @@ GBINDER_IO_FN(encode_reply_sg)(
 }
 
 /* Encode BC_REPLY with just status */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(encode_status_reply)(
     void* out,
@@ -415,7 +441,7 @@ GBINDER_IO_FN(encode_status_reply)(
 }
 
 /* Decode BR_REPLY and BR_TRANSACTION */
-static
+GBINDER_IO_STATIC
 void
 GBINDER_IO_FN(decode_transaction_data)(
     const void* data,
@@ -471,7 +497,7 @@ GBINDER_IO_FN(decode_transaction_data)(
 }
 
 /* Decode binder_uintptr_t */
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(decode_cookie)(
     const void* data,
@@ -484,7 +510,7 @@ GBINDER_IO_FN(decode_cookie)(
 }
 
 /* Decode struct binder_ptr_cookie */
-static
+GBINDER_IO_STATIC
 void*
 GBINDER_IO_FN(decode_ptr_cookie)(
     const void* data)
@@ -496,7 +522,7 @@ GBINDER_IO_FN(decode_ptr_cookie)(
     return (void*)(uintptr_t)ptr->ptr;
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(decode_binder_handle)(
     const void* data,
@@ -514,7 +540,7 @@ GBINDER_IO_FN(decode_binder_handle)(
     return 0;
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(decode_binder_object)(
     const void* data,
@@ -539,8 +565,22 @@ GBINDER_IO_FN(decode_binder_object)(
                     *out = NULL;
                 }
                 return sizeof(*obj);
+            } else {
+                /* One of our own objects */
+                GBinderLocalObject* local = gbinder_object_registry_get_local
+                    (reg, (void*)(uintptr_t)obj->binder);
+
+                if (local) {
+                    if (out) {
+                        *out = gbinder_remote_object_new_local(local);
+                    }
+                    gbinder_local_object_unref(local);
+                    return sizeof(*obj);
+                }
+                GWARN("Unknown local object %p", (void*)(uintptr_t)
+                    obj->binder);
             }
-            /* fallthrough */
+            break;
         default:
             GERR("Unsupported binder object type 0x%08x", obj->hdr.type);
             break;
@@ -550,7 +590,7 @@ GBINDER_IO_FN(decode_binder_object)(
     return 0;
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(decode_buffer_object)(
     GBinderBuffer* buf,
@@ -574,7 +614,7 @@ GBINDER_IO_FN(decode_buffer_object)(
     return 0;
 }
 
-static
+GBINDER_IO_STATIC
 guint
 GBINDER_IO_FN(decode_fd_object)(
     const void* data,
@@ -596,6 +636,25 @@ GBINDER_IO_FN(decode_fd_object)(
     return 0;
 }
 
+GBINDER_IO_STATIC
+guint
+GBINDER_IO_FN(decode_fda_object)(
+    const void* data,
+    gsize size,
+    guint* num_fds)
+{
+    const struct binder_fd_array_object* obj = data;
+
+    if (size >= sizeof(*obj) && obj->hdr.type == BINDER_TYPE_FDA) {
+        if (num_fds) *num_fds = (guint)obj->num_fds;
+        return sizeof(*obj);
+    }
+    if (num_fds) *num_fds = 0;
+    return 0;
+}
+
+#ifndef GBINDER_IO_INLINE
+
 const GBinderIo GBINDER_IO_PREFIX = {
     .version = BINDER_CURRENT_PROTOCOL_VERSION,
     .pointer_size = GBINDER_POINTER_SIZE,
@@ -642,7 +701,10 @@ const GBinderIo GBINDER_IO_PREFIX = {
         .finished = BR_FINISHED,
         .dead_binder = BR_DEAD_BINDER,
         .clear_death_notification_done = BR_CLEAR_DEATH_NOTIFICATION_DONE,
-        .failed_reply = BR_FAILED_REPLY
+        .failed_reply = BR_FAILED_REPLY,
+        .frozen_reply = BR_FROZEN_REPLY,
+        .oneway_spam_suspect = BR_ONEWAY_SPAM_SUSPECT,
+        .transaction_pending_frozen = BR_TRANSACTION_PENDING_FROZEN
     },
 
     .object_size = GBINDER_IO_FN(object_size),
@@ -672,6 +734,7 @@ const GBinderIo GBINDER_IO_PREFIX = {
     .decode_binder_object = GBINDER_IO_FN(decode_binder_object),
     .decode_buffer_object = GBINDER_IO_FN(decode_buffer_object),
     .decode_fd_object = GBINDER_IO_FN(decode_fd_object),
+    .decode_fda_object = GBINDER_IO_FN(decode_fda_object),
 
     /* ioctl wrappers */
     .write_read = GBINDER_IO_FN(write_read)
@@ -694,6 +757,8 @@ G_STATIC_ASSERT(sizeof(struct binder_transaction_data) <=
 G_STATIC_ASSERT(sizeof(struct binder_transaction_data_sg) <=
     GBINDER_MAX_BC_TRANSACTION_SG_SIZE);
 
+#endif /* GBINDER_IO_INLINE */
+
 /*
  * Local Variables:
  * mode: C
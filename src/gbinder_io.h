@@ -62,8 +62,13 @@ typedef struct gbinder_io_tx_data {
     void** objects;
 } GBinderIoTxData;
 
-/* Read buffer size (allocated on stack, shouldn't be too large) */
+/*
+ * Default and maximum read buffer size. The buffer is allocated per
+ * thread and grows (up to the maximum) when the driver keeps filling
+ * it up. The initial size can be configured per device.
+ */
 #define GBINDER_IO_READ_BUFFER_SIZE (128)
+#define GBINDER_IO_READ_BUFFER_MAX_SIZE (4096)
 
 /*
  * There are (at least) 2 versions of the binder ioctl API, implemented by
@@ -123,6 +128,9 @@ struct gbinder_io {
         guint dead_binder;
         guint clear_death_notification_done;
         guint failed_reply;
+        guint frozen_reply;
+        guint oneway_spam_suspect;
+        guint transaction_pending_frozen;
     } br;
 
     /* Size of the object and its extra data */
@@ -162,24 +170,25 @@ struct gbinder_io {
 #define GBINDER_MAX_PTR_COOKIE_SIZE (16)
     guint (*encode_ptr_cookie)(void* out, GBinderLocalObject* obj);
 
-    /* Encode BC_TRANSACTION/BC_TRANSACTION_SG data */
+    /* Encode BC_TRANSACTION/BC_TRANSACTION_SG data. The offsets buffer
+     * must have room for offsets->count pointers (pointer_size each) */
 #define GBINDER_MAX_BC_TRANSACTION_SIZE (64)
     guint (*encode_transaction)(void* out, guint32 handle, guint32 code,
         const GByteArray* data, guint flags /* See below */,
-        GUtilIntArray* offsets, void** offsets_buf);
+        GUtilIntArray* offsets, void* offsets_buf);
 #define GBINDER_MAX_BC_TRANSACTION_SG_SIZE (72)
     guint (*encode_transaction_sg)(void* out, guint32 handle, guint32 code,
         const GByteArray* data, guint flags /* GBINDER_TX_FLAG_xxx */,
-        GUtilIntArray* offsets, void** offsets_buf,
+        GUtilIntArray* offsets, void* offsets_buf,
         gsize buffers_size);
 
     /* Encode BC_REPLY/REPLY_SG data */
 #define GBINDER_MAX_BC_REPLY_SIZE GBINDER_MAX_BC_TRANSACTION_SIZE
     guint (*encode_reply)(void* out, guint32 handle, guint32 code,
-        const GByteArray* data, GUtilIntArray* offsets, void** offsets_buf);
+        const GByteArray* data, GUtilIntArray* offsets, void* offsets_buf);
 #define GBINDER_MAX_BC_REPLY_SG_SIZE GBINDER_MAX_BC_TRANSACTION_SG_SIZE
     guint (*encode_reply_sg)(void* out, guint32 handle, guint32 code,
-        const GByteArray* data, GUtilIntArray* offsets, void** offsets_buf,
+        const GByteArray* data, GUtilIntArray* offsets, void* offsets_buf,
         gsize buffers_size);
 
     /* Encode BC_REPLY */
@@ -195,6 +204,7 @@ struct gbinder_io {
     guint (*decode_buffer_object)(GBinderBuffer* buf, gsize offset,
         GBinderIoBufferObject* out);
     guint (*decode_fd_object)(const void* data, gsize size, int* fd);
+    guint (*decode_fda_object)(const void* data, gsize size, guint* num_fds);
 
     /* ioctl wrappers */
     int (*write_read)(int fd, GBinderIoBuf* write, GBinderIoBuf* read);
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GBINDER_IO_FIXED_H
+#define GBINDER_IO_FIXED_H
+
+#include "gbinder_io.h"
+
+/*
+ * Builds for a single kernel ABI (make IO_ABI=32 or IO_ABI=64) compile
+ * the encoders and decoders directly into the code using them. Then
+ * GBINDER_IO_CALL() resolves to a static inline function rather than to
+ * the GBinderIo pointer, and the driver accepts only that ABI. Otherwise
+ * it's an indirect call through the table picked at runtime.
+ */
+
+#if GBINDER_IO_ABI
+
+#if GBINDER_IO_ABI == 32
+#  define BINDER_IPC_32BIT
+#  define GBINDER_IO_FIXED gbinder_io_32
+#elif GBINDER_IO_ABI == 64
+#  undef BINDER_IPC_32BIT
+#  define GBINDER_IO_FIXED gbinder_io_64
+#else
+#  error "GBINDER_IO_ABI must be 32 or 64"
+#endif
+
+#define GBINDER_IO_PREFIX gbinder_io_fixed
+#define GBINDER_IO_STATIC static inline
+#define GBINDER_IO_INLINE
+#include "gbinder_io.c"
+#undef GBINDER_IO_INLINE
+#undef GBINDER_IO_STATIC
+#undef GBINDER_IO_PREFIX
+
+#define GBINDER_IO_CALL(io,fn) ((void)(io), gbinder_io_fixed_##fn)
+
+#else
+
+#define GBINDER_IO_CALL(io,fn) ((io)->fn)
+
+#endif /* GBINDER_IO_ABI */
+
+#endif /* GBINDER_IO_FIXED_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -34,17 +34,24 @@
 #define _GNU_SOURCE  /* pthread_*_np */
 
 #include "gbinder_ipc.h"
+#include "gbinder_buffer_p.h"
+#include "gbinder_config.h"
 #include "gbinder_driver.h"
 #include "gbinder_handler.h"
 #include "gbinder_io.h"
 #include "gbinder_rpc_protocol.h"
 #include "gbinder_object_registry.h"
+#include "gbinder_output_data.h"
 #include "gbinder_local_object_p.h"
-#include "gbinder_local_reply.h"
+#include "gbinder_local_reply_p.h"
 #include "gbinder_local_request_p.h"
+#include "gbinder_memory_cache.h"
 #include "gbinder_remote_object_p.h"
 #include "gbinder_remote_reply_p.h"
 #include "gbinder_remote_request_p.h"
+#include "gbinder_stats_p.h"
+#include "gbinder_thread.h"
+#include "gbinder_trace.h"
 #include "gbinder_eventloop_p.h"
 #include "gbinder_writer.h"
 #include "gbinder_log.h"
@@ -55,30 +62,161 @@
 #include <pthread.h>
 #include <poll.h>
 #include <errno.h>
+#include <sched.h>
 #include <time.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 typedef struct gbinder_ipc_looper GBinderIpcLooper;
+typedef struct gbinder_ipc_idle_watch GBinderIpcIdleWatch;
+typedef struct gbinder_ipc_tx_pool GBinderIpcTxPool;
 typedef GObjectClass GBinderIpcClass;
 
+/*
+ * Objects found in every parcel are looked up from all looper and tx
+ * threads. Spreading them across several independently locked tables
+ * keeps those threads from serializing on a single mutex.
+ */
+#define GBINDER_IPC_REGISTRY_SHARDS (8)
+
+typedef struct gbinder_ipc_registry_shard {
+    GMutex mutex;
+    GHashTable* table;
+    GBINDER_STATS_PROBE probe;
+} GBinderIpcRegistryShard;
+
+/*
+ * Interface names arriving in RPC headers are converted to UTF-8 once
+ * and shared by all requests. Since those come from the other side,
+ * the number of interned names is limited.
+ */
+#define GBINDER_IPC_MAX_IFACES (64)
+
+typedef struct gbinder_ipc_iface {
+    const gunichar2* utf16;
+    gsize len;
+    char* utf8;
+} GBinderIpcIface;
+
+#define GBINDER_IPC_DISPATCH_QUEUES (GBINDER_LOCAL_PRIORITY_HIGH + 1)
+
+/*
+ * State of the runtime tuning, see gbinder_ipc_tune(). The shortage
+ * counters are incremented by the loopers and the threads submitting
+ * transactions, the rest is touched only on the main thread.
+ */
+typedef struct gbinder_ipc_tuning {
+    guint interval; /* ms, zero if disabled */
+    gint armed;
+    GBinderEventLoopTimeout* timer;
+    gint looper_short;
+    gint tx_short;
+    int base_loopers;
+    int max_loopers;
+    int base_tx;
+    int max_tx;
+    guint looper_ok;
+    guint tx_ok;
+    guint read_ok;
+    gsize read_size;
+    gint reply_size;
+} GBinderIpcTuning;
+
+/* Function invoked on the main thread, see gbinder_ipc_invoke_later() */
+typedef struct gbinder_ipc_call GBinderIpcCall;
+struct gbinder_ipc_call {
+    GBinderIpcCall* next;
+    GBinderEventLoopCallbackFunc func;
+    gpointer data;
+    GDestroyNotify destroy;
+};
+
 struct gbinder_ipc_priv {
     GBinderIpc* self;
-    GThreadPool* tx_pool;
+    GThreadPool* tx_pool; /* NULL if the shared pool is used */
+    GThreadPool* tx_rt_pool; /* Reserved for the realtime lane */
+    gint tx_rt_busy;
+    guint tx_seq; /* Keeps the lanes FIFO, main thread only */
     GHashTable* tx_table;
     char* key;
     const char* name;
     GBinderObjectRegistry object_registry;
 
-    GMutex remote_objects_mutex;
-    GHashTable* remote_objects;
+    GBinderIpcRegistryShard remote_objects[GBINDER_IPC_REGISTRY_SHARDS];
+    GBinderIpcRegistryShard local_objects[GBINDER_IPC_REGISTRY_SHARDS];
 
-    GMutex local_objects_mutex;
-    GHashTable* local_objects;
+    GMutex iface_mutex;
+    GHashTable* ifaces;
+
+    /* Mappings of the shared memory regions, see gbinder_memory_cache.h */
+    GBinderMemoryCache* memory_cache;
 
     GMutex looper_mutex;
     GBinderIpcLooper* primary_loopers;
     GBinderIpcLooper* blocked_loopers;
+    gint primary_count;
+    gint busy_count;
+    gint min_loopers;
+    gint max_loopers;
+    gint looper_idle_timeout;
+    gboolean prestart; /* Loopers are started and warmed up in advance */
+    gboolean blocking; /* Loopers block in BINDER_WRITE_READ, not poll() */
+    gboolean shared_idle; /* Idle device is watched by the shared thread */
+    GBinderIpcIdleWatch* idle_watch; /* Protected by looper_mutex */
+
+    /* Incoming transactions waiting to be handled on the main thread */
+    GBinderIpcLooperTx* dispatch_inbox;
+    GBinderIpcCall* call_inbox; /* Handled before the transactions */
+    gint dispatch_scheduled;
+    GQueue dispatch_queue[GBINDER_IPC_DISPATCH_QUEUES]; /* Main thread */
+    GMainContext* context; /* NULL for the default one */
+
+    /* Recently received remote objects, see gbinder_ipc_remote_cache_add */
+    GMutex remote_cache_mutex;
+    GQueue remote_cache; /* GBinderIpcRemoteCacheEntry, most recent first */
+    GHashTable* remote_cache_map; /* handle => GBinderIpcRemoteCacheEntry */
+    guint remote_cache_size;
+    guint remote_cache_timeout;
+    gboolean remote_cache_armed; /* Protected by remote_cache_mutex */
+    GBinderEventLoopTimeout* remote_cache_timer; /* Main thread */
+
+    /* Placement and scheduling of the threads */
+    GBinderThreadConfig thread_config[GBINDER_IPC_THREADS_COUNT];
+
+    /* BR_ONEWAY_SPAM_SUSPECT notifications are coalesced */
+    gint oneway_spam_scheduled;
+
+    /* Process-wide worker pool, protected by its mutex */
+    GBinderIpcTxPool* tx_shared;
+    GQueue tx_queue; /* Transactions waiting for a shared worker */
+    GList tx_ready; /* Link in the round-robin queue, data is NULL if not */
+    gint tx_running;
+    gint tx_quota;
+
+    /* Autotune */
+    GBinderIpcTuning tune;
+
+    /* Pending gbinder_ipc_ping_many() calls, main thread only */
+    GHashTable* ping_table;
+
+    /* Pending gbinder_ipc_broadcast() calls, main thread only */
+    GHashTable* broadcast_table;
+
+    /* Recycled objects, up to GBINDER_IPC_POOL_SIZE of each kind */
+    GMutex pool_mutex;
+    GBinderIpcLooperTx* looper_tx_pool;
+    GBinderIpcCall* call_pool;
+    guint looper_tx_pool_size;
+    guint call_pool_size;
 };
 
+typedef struct gbinder_ipc_remote_cache_entry {
+    GList link;
+    GBinderRemoteObject* obj;
+    gint64 expires;
+} GBinderIpcRemoteCacheEntry;
+
 #define PARENT_CLASS gbinder_ipc_parent_class
 #define THIS_TYPE gbinder_ipc_get_type()
 #define THIS(obj) G_TYPE_CHECK_INSTANCE_CAST(obj, THIS_TYPE, GBinderIpc)
@@ -86,32 +224,81 @@ struct gbinder_ipc_priv {
 GType THIS_TYPE GBINDER_INTERNAL;
 G_DEFINE_TYPE(GBinderIpc, gbinder_ipc, G_TYPE_OBJECT)
 
+enum gbinder_ipc_signal {
+    SIGNAL_ONEWAY_SPAM,
+    SIGNAL_COUNT
+};
+
+static const char SIGNAL_ONEWAY_SPAM_NAME[] = "ipc-oneway-spam";
+
+static guint gbinder_ipc_signals[SIGNAL_COUNT] = { 0 };
+
 /*
  * Binder requests are blocking, worker threads are needed in order to
  * implement asynchronous requests, hence the synchronization.
  */
 static GHashTable* gbinder_ipc_table = NULL;
+static GRWLock gbinder_ipc_table_lock; /* Statically allocated, no init */
 static pthread_mutex_t gbinder_ipc_mutex = PTHREAD_MUTEX_INITIALIZER;
+static GThreadPool* gbinder_ipc_strand_pool = NULL;
 
 #define GBINDER_IPC_MAX_TX_THREADS (15)
+#define GBINDER_IPC_KEY_BUF_SIZE (64)
+#define GBINDER_IPC_MIN_PRIMARY_LOOPERS (1)
 #define GBINDER_IPC_MAX_PRIMARY_LOOPERS (5)
-#define GBINDER_IPC_LOOPER_START_TIMEOUT_SEC (2)
 #define GBINDER_IPC_LOOPER_JOIN_TIMEOUT_MS (500)
+#define GBINDER_IPC_LOOPER_IDLE_TIMEOUT_MS (10000)
+#define GBINDER_IPC_LOOPER_PREFAULT_STACK (64 * 1024)
+#define GBINDER_IPC_REMOTE_CACHE_TIMEOUT_MS (2000)
+#define GBINDER_IPC_DISPATCH_BUDGET (16)
+#define GBINDER_IPC_POOL_SIZE (32)
+#define GBINDER_IPC_TUNE_SHRINK_TICKS (5)
+#define GBINDER_IPC_TUNE_MAX_REPLY_SIZE (16384)
+#define GBINDER_IPC_PING_FANOUT (8)
+#define GBINDER_IPC_BROADCAST_FANOUT (8)
+
+/*
+ * The number of primary loopers stays between min_loopers and
+ * max_loopers. Initially, min_loopers are started. Additional loopers
+ * are started when all primary loopers are busy handling transactions
+ * or when the kernel asks for it with BR_SPAWN_LOOPER. Loopers above
+ * the minimum exit after staying idle for looper_idle_timeout ms.
+ *
+ * Loopers blocked by gbinder_remote_request_block() are not counted,
+ * they are moved to a separate list until the request gets completed.
+ *
+ * With PrestartLoopers configured for the device, the minimum is raised
+ * to that number and they are started right when GBinderIpc is created.
+ * Such loopers touch the top of their stack and allocate the read buffer
+ * before entering the loop, so that the first incoming transactions
+ * don't have to pay for that.
+ *
+ * Normally, loopers poll() the binder fd together with their exit pipe
+ * before each read. With BlockingLoopers configured, the loopers which
+ * don't have to watch for idle time skip that and block right in
+ * BINDER_WRITE_READ, saving a system call per wakeup. Those are stopped
+ * by gbinder_driver_kick() which makes the read return empty-handed.
+ * After an empty read, the looper polls once before reading again, so
+ * that a spurious wakeup can't turn into a busy loop.
+ *
+ * With SharedIdleLooper configured, the device has no loopers of its own
+ * while there's no traffic, see gbinder_ipc_idle_looper_thread().
+ */
 
 /*
  * When looper receives the transaction:
  *
  * 1. Finds the target object and allocates GBinderIpcLooperTx.
  * 2. Posts the GBinderIpcLooperTx reference to the main thread
- * 4. Waits for (any) byte from the receiving end of the tx pipe.
+ * 4. Waits for GBinderIpcLooperTx to be signaled.
  *
  * When the main thread receives GBinderIpcLooperTx:
  *
  * 1. Lets the object to process it and produce the response (GBinderOutput).
- * 2. Writes one byte (TX_DONE) to the sending end of the tx pipe.
+ * 2. Signals GBinderIpcLooperTx with TX_DONE.
  * 3. Unreferences GBinderIpcLooperTx
  *
- * When tx pipe wakes up the looper:
+ * When GBinderIpcLooperTx wakes up the looper:
  *
  * 1. Sends the transaction to the kernel.
  * 2. Unreferences GBinderIpcLooperTx
@@ -121,9 +308,13 @@ static pthread_mutex_t gbinder_ipc_mutex = PTHREAD_MUTEX_INITIALIZER;
  * before it gets processed.
  *
  * When transaction is blocked by gbinder_remote_request_block() call, it
- * gets slightly more complicated. Then the main thread writes TX_BLOCKED
- * to the pipe (rather than TX_DONE) and then looper thread spawn another
- * looper and keeps waiting for TX_DONE.
+ * gets slightly more complicated. Then the main thread signals TX_BLOCKED
+ * (rather than TX_DONE) and then looper thread spawn another looper and
+ * keeps waiting for TX_DONE.
+ *
+ * Signaling is done with a mutex and a condition variable, which in the
+ * uncontended case doesn't involve any system calls at all. Looper
+ * shutdown wakes up the waiter as well.
  */
 
 #define TX_DONE (0x2a)
@@ -138,15 +329,32 @@ typedef enum gbinder_ipc_looper_tx_state {
     GBINDER_IPC_LOOPER_TX_COMPLETE
 } GBINDER_IPC_LOOPER_TX_STATE;
 
+typedef struct gbinder_ipc_sched {
+    int policy;
+    int priority; /* Realtime priority or nice value */
+} GBinderIpcSched;
+
 struct gbinder_ipc_looper_tx {
     /* Reference count */
     gint refcount;
+    /* Where it goes when it's done, those survive recycling: */
+    GBinderIpcPriv* pool;
+    GMutex mutex;
+    GCond cond;
+    /* Wakes up the waiting thread, done is protected by the mutex: */
+    guint8 done;
     /* These are filled by the looper: */
-    int pipefd[2];
     guint32 code;
     guint32 flags;
     GBinderLocalObject* obj;
     GBinderRemoteRequest* req;
+    GBINDER_LOCAL_PRIORITY priority;
+    GBinderIpcSched sched; /* Looper scheduling, if inherit is set */
+    gboolean inherit;
+    /* Link in dispatch_inbox and the flag set by the exiting looper: */
+    GBinderIpcLooperTx* next;
+    gint cancelled;
+    gint64 posted; /* gbinder_stats_probe_enter() time */
     /* And these by the main thread processing the transaction: */
     GBINDER_IPC_LOOPER_TX_STATE state;
     GBinderLocalReply* reply;
@@ -162,19 +370,16 @@ struct gbinder_ipc_looper {
     GBinderIpc* ipc; /* Not a reference! */
     pthread_t thread;
     GMutex mutex;
-    GCond start_cond;
+    gint64 created; /* For GBINDER_STATS_STARTUP_LOOPER */
     gint exit;
-    gint started;
     gint joined;
+    gboolean spawned; /* Requested by the kernel */
+    gboolean warm_up;
+    gboolean blocking;
     int pipefd[2];
-    int txfd[2];
+    GBinderIpcLooperTx* tx; /* Protected by mutex */
 };
 
-typedef struct gbinder_ipc_tx_handler {
-    int pipefd[2];
-    int txfd[2];
-} GBinderIpcTxHandler;
-
 typedef struct gbinder_ipc_tx_priv GBinderIpcTxPriv;
 
 typedef
@@ -188,18 +393,38 @@ typedef struct gbinder_ipc_tx_priv {
     GBinderIpcTxPrivFunc fn_done;
     GBinderIpcTxPrivFunc fn_free;
     GBinderEventLoopCallback* completion;
+    GBinderEventLoopTimeout* timeout;
+    gint64 deadline; /* Monotonic time, zero if none */
+    gint running;
+    gboolean extra_thread;
+    gsize mem_bytes; /* Accounted by gbinder_stats_mem_add() */
+    gint64 queued; /* gbinder_stats_probe_enter() time */
+    int lane; /* GBINDER_IPC_TX_LANE_xxx */
+    guint seq;
+    gboolean reserved; /* Runs on the reserved realtime worker */
 } GBinderIpcTxPriv;
 
+/* Higher lanes are picked first */
+#define GBINDER_IPC_TX_LANE_BACKGROUND (0)
+#define GBINDER_IPC_TX_LANE_NORMAL (1)
+#define GBINDER_IPC_TX_LANE_REALTIME (2)
+#define GBINDER_IPC_TX_LANE(flags) \
+    (((flags) & GBINDER_TX_FLAG_REALTIME) ? GBINDER_IPC_TX_LANE_REALTIME : \
+     ((flags) & GBINDER_TX_FLAG_BACKGROUND) ? GBINDER_IPC_TX_LANE_BACKGROUND : \
+     GBINDER_IPC_TX_LANE_NORMAL)
+
 typedef struct gbinder_ipc_tx_internal {
     GBinderIpcTxPriv tx;
     guint32 handle;
     guint32 code;
     guint32 flags;
     int status;
+    GBinderLocalObject* local; /* In-process target (or NULL) */
     GBinderLocalRequest* req;
     GBinderRemoteReply* reply;
     GBinderIpcReplyFunc fn_reply;
     GDestroyNotify fn_destroy;
+    gint delivered; /* The reply callback has been (or is being) invoked */
 } GBinderIpcTxInternal;
 
 typedef struct gbinder_ipc_tx_custom {
@@ -212,7 +437,19 @@ typedef struct gbinder_ipc_tx_custom {
 static
 GBinderIpcLooper*
 gbinder_ipc_looper_new(
-    GBinderIpc* ipc);
+    GBinderIpc* ipc,
+    gboolean spawned);
+
+static
+void
+gbinder_ipc_idle_looper_arm(
+    GBinderIpcPriv* priv);
+
+static
+gboolean
+gbinder_ipc_tx_pool_resize(
+    GBinderIpcPriv* priv,
+    int delta);
 
 static
 GBinderRemoteReply*
@@ -232,39 +469,120 @@ gbinder_ipc_transact_sync_oneway_worker(
     GBinderLocalRequest* req);
 
 /*==========================================================================*
- * Utilities
+ * Thread scheduling
+ *
+ * These affect the calling thread rather than the whole process, that's
+ * how Linux works.
  *==========================================================================*/
 
+#define gbinder_ipc_sched_is_rt(s) \
+    ((s)->policy == SCHED_FIFO || (s)->policy == SCHED_RR)
+
 static
 gboolean
-gbinder_ipc_wait(
-    int fd_wakeup,
-    int fd_read,
-    guint8* out)
-{
-    struct pollfd fds[2];
-
-    memset(fds, 0, sizeof(fds));
-    fds[0].fd = fd_wakeup;
-    fds[0].events = POLLIN | POLLERR | POLLHUP | POLLNVAL;
-    fds[1].fd = fd_read;
-    fds[1].events = POLLIN | POLLERR | POLLHUP | POLLNVAL;
-    if (poll(fds, 2, -1) < 0) {
-        GWARN("Transaction pipe polling error: %s", strerror(errno));
-    } else if (fds[1].revents & POLLIN) {
-        const ssize_t n = read(fds[1].fd, out, 1);
-
-        if (n == 1) {
+gbinder_ipc_sched_get(
+    GBinderIpcSched* sched)
+{
+    sched->policy = sched_getscheduler(0);
+    if (sched->policy < 0) {
+        return FALSE;
+    }
+#ifdef SCHED_RESET_ON_FORK
+    sched->policy &= ~SCHED_RESET_ON_FORK;
+#endif
+    if (gbinder_ipc_sched_is_rt(sched)) {
+        struct sched_param param;
+
+        if (sched_getparam(0, &param) == 0) {
+            sched->priority = param.sched_priority;
+            return TRUE;
+        }
+    } else {
+        /* -1 is a valid nice value */
+        errno = 0;
+        sched->priority = getpriority(PRIO_PROCESS, 0);
+        return !errno;
+    }
+    return FALSE;
+}
+
+static
+gboolean
+gbinder_ipc_sched_higher(
+    const GBinderIpcSched* a,
+    const GBinderIpcSched* b)
+{
+    if (gbinder_ipc_sched_is_rt(a)) {
+        return !gbinder_ipc_sched_is_rt(b) || a->priority > b->priority;
+    } else {
+        return !gbinder_ipc_sched_is_rt(b) && a->priority < b->priority;
+    }
+}
+
+static
+gboolean
+gbinder_ipc_sched_set(
+    const GBinderIpcSched* sched)
+{
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    if (gbinder_ipc_sched_is_rt(sched)) {
+        param.sched_priority = sched->priority;
+        if (sched_setscheduler(0, sched->policy, &param) == 0) {
             return TRUE;
-        } else if (n < 0) {
-            GWARN("Transaction pipe read error: %s", strerror(errno));
-        } else {
-            GWARN("Nothing was read from the transaction pipe");
         }
+    } else if (sched_setscheduler(0, sched->policy, &param) == 0 &&
+        setpriority(PRIO_PROCESS, 0, sched->priority) == 0) {
+        return TRUE;
     }
+    GDEBUG("Failed to set policy %d priority %d: %s", sched->policy,
+        sched->priority, strerror(errno));
     return FALSE;
 }
 
+/*==========================================================================*
+ * Locks measure contention when statistics are enabled
+ *==========================================================================*/
+
+static
+void
+gbinder_ipc_lock(
+    GMutex* mutex,
+    GBINDER_STATS_PROBE probe)
+{
+    if (!gbinder_stats_active()) {
+        g_mutex_lock(mutex);
+    } else if (!g_mutex_trylock(mutex)) {
+        /* Only contended locks are worth measuring */
+        const gint64 start = gbinder_stats_probe_enter(probe);
+
+        g_mutex_lock(mutex);
+        gbinder_stats_probe_exit(probe, start);
+    }
+}
+
+static
+void
+gbinder_ipc_global_lock(
+    void)
+{
+    if (!gbinder_stats_active()) {
+        pthread_mutex_lock(&gbinder_ipc_mutex);
+    } else if (pthread_mutex_trylock(&gbinder_ipc_mutex)) {
+        const gint64 start = gbinder_stats_probe_enter(
+            GBINDER_STATS_PROBE_IPC_LOCK);
+
+        pthread_mutex_lock(&gbinder_ipc_mutex);
+        gbinder_stats_probe_exit(GBINDER_STATS_PROBE_IPC_LOCK, start);
+    }
+}
+
+#define gbinder_ipc_looper_lock(priv) \
+    gbinder_ipc_lock(&(priv)->looper_mutex, GBINDER_STATS_PROBE_LOOPER_LOCK)
+#define gbinder_ipc_shard_lock(shard) \
+    gbinder_ipc_lock(&(shard)->mutex, (shard)->probe)
+
 /*==========================================================================*
  * GBinderIpcLooperTx
  *==========================================================================*/
@@ -275,33 +593,77 @@ gbinder_ipc_looper_tx_new(
     GBinderLocalObject* obj,
     guint32 code,
     guint32 flags,
-    GBinderRemoteRequest* req,
-    const int* fd)
+    GBinderRemoteRequest* req)
 {
-    GBinderIpcLooperTx* tx = g_slice_new0(GBinderIpcLooperTx);
+    GBinderIpcPriv* priv = obj->ipc->priv;
+    GBinderIpcLooperTx* tx;
+
+    /* Recycled ones are already reset by gbinder_ipc_looper_tx_free() */
+    g_mutex_lock(&priv->pool_mutex);
+    tx = priv->looper_tx_pool;
+    if (tx) {
+        priv->looper_tx_pool = tx->next;
+        priv->looper_tx_pool_size--;
+        tx->next = NULL;
+    }
+    g_mutex_unlock(&priv->pool_mutex);
+    if (!tx) {
+        tx = g_slice_new0(GBinderIpcLooperTx);
+        tx->pool = priv;
+        g_mutex_init(&tx->mutex);
+        g_cond_init(&tx->cond);
+    }
 
     g_atomic_int_set(&tx->refcount, 1);
-    memcpy(tx->pipefd, fd, sizeof(tx->pipefd));
     tx->code = code;
     tx->flags = flags;
     tx->obj = gbinder_local_object_ref(obj);
     tx->req = gbinder_remote_request_ref(req);
+    tx->priority = gbinder_local_object_priority(obj, code);
     return tx;
 }
 
+static
+void
+gbinder_ipc_looper_tx_destroy(
+    GBinderIpcLooperTx* tx)
+{
+    g_cond_clear(&tx->cond);
+    g_mutex_clear(&tx->mutex);
+    g_slice_free(GBinderIpcLooperTx, tx);
+}
+
 static
 void
 gbinder_ipc_looper_tx_free(
     GBinderIpcLooperTx* tx)
 {
-    if (tx->pipefd[0] >= 0) {
-        close(tx->pipefd[0]);
-        close(tx->pipefd[1]);
+    GBinderIpcPriv* priv = tx->pool;
+    GBinderLocalObject* obj = tx->obj;
+    GBinderRemoteRequest* req = tx->req;
+    GBinderLocalReply* reply = tx->reply;
+
+    /*
+     * The object holds a reference to GBinderIpc, i.e. the pool is
+     * still there. Nobody else is looking at this tx anymore, reset
+     * it before it becomes visible to other threads.
+     */
+    memset(&tx->done, 0, sizeof(*tx) - G_STRUCT_OFFSET(GBinderIpcLooperTx,
+        done));
+    g_mutex_lock(&priv->pool_mutex);
+    if (priv->looper_tx_pool_size < GBINDER_IPC_POOL_SIZE) {
+        tx->next = priv->looper_tx_pool;
+        priv->looper_tx_pool = tx;
+        priv->looper_tx_pool_size++;
+        tx = NULL;
     }
-    gbinder_local_object_unref(tx->obj);
-    gbinder_remote_request_unref(tx->req);
-    gbinder_local_reply_unref(tx->reply);
-    g_slice_free(GBinderIpcLooperTx, tx);
+    g_mutex_unlock(&priv->pool_mutex);
+    if (tx) {
+        gbinder_ipc_looper_tx_destroy(tx);
+    }
+    gbinder_remote_request_unref(req);
+    gbinder_local_reply_unref(reply);
+    gbinder_local_object_unref(obj);
 }
 
 static
@@ -315,26 +677,66 @@ gbinder_ipc_looper_tx_ref(
 }
 
 static
-gboolean
+void
 gbinder_ipc_looper_tx_unref(
-    GBinderIpcLooperTx* tx,
-    gboolean dropfd)
+    GBinderIpcLooperTx* tx)
 {
-    gboolean dropped = FALSE;
     GASSERT(tx->refcount > 0);
     if (g_atomic_int_dec_and_test(&tx->refcount)) {
-        if (dropfd) {
-            tx->pipefd[0] = tx->pipefd[1] = -1;
-            dropped = TRUE;
-        }
         gbinder_ipc_looper_tx_free(tx);
     }
-    return dropped;
+}
+
+static
+void
+gbinder_ipc_looper_tx_signal(
+    GBinderIpcLooperTx* tx,
+    guint8 done)
+{
+    g_mutex_lock(&tx->mutex);
+    /* TX_DONE may arrive before TX_BLOCKED, don't let it get lost */
+    if (done == TX_DONE || !tx->done) {
+        tx->done = done;
+    }
+    g_cond_broadcast(&tx->cond);
+    g_mutex_unlock(&tx->mutex);
+}
+
+static
+void
+gbinder_ipc_looper_tx_wakeup(
+    GBinderIpcLooperTx* tx)
+{
+    /* Wakes up the waiter without changing the state */
+    g_mutex_lock(&tx->mutex);
+    g_cond_broadcast(&tx->cond);
+    g_mutex_unlock(&tx->mutex);
+}
+
+/* Returns the new state or zero if the wait has been cancelled */
+static
+guint8
+gbinder_ipc_looper_tx_wait(
+    GBinderIpcLooperTx* tx,
+    guint8 prev,
+    gint* cancel)
+{
+    guint8 done;
+
+    g_mutex_lock(&tx->mutex);
+    while (tx->done == prev && !(cancel && g_atomic_int_get(cancel))) {
+        g_cond_wait(&tx->cond, &tx->mutex);
+    }
+    done = (tx->done == prev) ? 0 : tx->done;
+    g_mutex_unlock(&tx->mutex);
+    return done;
 }
 
 /*==========================================================================*
- * State machine of transaction handling. All this is happening on the event
- * thread and therefore doesn't need to be synchronized.
+ * State machine of transaction handling. Normally all this is happening on
+ * the event thread, but transactions dispatched directly to the looper thread
+ * (see gbinder_local_object_set_looper_dispatch) can be completed from any
+ * thread. Therefore state transitions are protected by the tx mutex.
  *
  * SCHEDULED
  * =========
@@ -369,10 +771,12 @@ gbinder_remote_request_block(
 
         GASSERT(tx);
         if (G_LIKELY(tx)) {
+            g_mutex_lock(&tx->mutex);
             GASSERT(tx->state == GBINDER_IPC_LOOPER_TX_PROCESSING);
             if (tx->state == GBINDER_IPC_LOOPER_TX_PROCESSING) {
                 tx->state = GBINDER_IPC_LOOPER_TX_BLOCKING;
             }
+            g_mutex_unlock(&tx->mutex);
         }
     }
 }
@@ -388,8 +792,9 @@ gbinder_remote_request_complete(
 
         GASSERT(tx);
         if (G_LIKELY(tx)) {
-            const guint8 done = TX_DONE;
+            gboolean wakeup = FALSE;
 
+            g_mutex_lock(&tx->mutex);
             switch (tx->state) {
             case GBINDER_IPC_LOOPER_TX_BLOCKING:
                 /* Called by the transaction handler */
@@ -402,23 +807,225 @@ gbinder_remote_request_complete(
                 tx->status = status;
                 tx->reply = gbinder_local_reply_ref(reply);
                 tx->state = GBINDER_IPC_LOOPER_TX_COMPLETE;
-                /* Wake up the looper */
-                if (write(tx->pipefd[1], &done, sizeof(done)) <= 0) {
-                    GWARN("Failed to wake up the looper");
-                }
+                wakeup = TRUE;
                 break;
             default:
                 GWARN("Unexpected state %d in request completion", tx->state);
                 break;
             }
+            g_mutex_unlock(&tx->mutex);
+
+            /* Wake up the looper */
+            if (wakeup) {
+                gbinder_ipc_looper_tx_signal(tx, TX_DONE);
+            }
 
             /* Clear the transaction reference */
-            gbinder_ipc_looper_tx_unref(tx, FALSE);
+            gbinder_ipc_looper_tx_unref(tx);
             req->tx = NULL;
        }
     }
 }
 
+/*==========================================================================*
+ * Runtime tuning
+ *
+ * With Autotune configured for the device, the main thread wakes up every
+ * so many milliseconds and looks at what has happened since the previous
+ * tick. A limit is raised by one step as soon as a shortage is observed
+ * and lowered back (never below the configured value) after it hasn't
+ * been short for GBINDER_IPC_TUNE_SHRINK_TICKS ticks in a row:
+ *
+ * - maximum number of loopers, short when a looper is needed but the
+ *   limit has been reached
+ * - maximum number of tx threads (private pool only), short when an
+ *   asynchronous transaction has to wait in the queue
+ * - read buffer size, which the driver grows on its own when it fills
+ *   up, is shrunk back when it stops filling up
+ * - replies created by gbinder_local_object_new_reply() are pre-sized
+ *   to fit most of the recently sent replies
+ *
+ * Every change is recorded, see gbinder_stats_get_tuning().
+ *==========================================================================*/
+
+static
+void
+gbinder_ipc_tune_record(
+    GBinderIpc* self,
+    GBINDER_STATS_TUNING param,
+    guint old_value,
+    guint new_value)
+{
+    GDEBUG("%s tuning %d: %u => %u", self->priv->name, param, old_value,
+        new_value);
+    gbinder_stats_tuning(self->dev, param, old_value, new_value);
+}
+
+static
+void
+gbinder_ipc_tune_loopers(
+    GBinderIpc* self)
+{
+    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcTuning* tune = &priv->tune;
+    const int n = g_atomic_int_get(&priv->max_loopers);
+    int max = n;
+
+    if (g_atomic_int_and(&tune->looper_short, 0)) {
+        tune->looper_ok = 0;
+        if (n < tune->max_loopers) {
+            max = n + 1;
+        }
+    } else if (++(tune->looper_ok) >= GBINDER_IPC_TUNE_SHRINK_TICKS) {
+        tune->looper_ok = 0;
+        if (n > tune->base_loopers) {
+            max = n - 1;
+        }
+    }
+    if (max != n) {
+        gbinder_ipc_set_looper_limits(self,
+            g_atomic_int_get(&priv->min_loopers), max);
+        gbinder_ipc_tune_record(self, GBINDER_STATS_TUNING_LOOPERS, n, max);
+    }
+}
+
+static
+void
+gbinder_ipc_tune_tx_threads(
+    GBinderIpc* self)
+{
+    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcTuning* tune = &priv->tune;
+    const int n = g_thread_pool_get_max_threads(priv->tx_pool);
+    int max = n;
+
+    if (g_atomic_int_and(&tune->tx_short, 0)) {
+        tune->tx_ok = 0;
+        if (n < tune->max_tx) {
+            max = n + 1;
+        }
+    } else if (++(tune->tx_ok) >= GBINDER_IPC_TUNE_SHRINK_TICKS) {
+        tune->tx_ok = 0;
+        if (n > tune->base_tx) {
+            max = n - 1;
+        }
+    }
+    if (max != n && g_thread_pool_set_max_threads(priv->tx_pool, max, NULL)) {
+        gbinder_ipc_tune_record(self, GBINDER_STATS_TUNING_TX_THREADS, n, max);
+    }
+}
+
+static
+void
+gbinder_ipc_tune_read_buffer(
+    GBinderIpc* self)
+{
+    GBinderIpcTuning* tune = &self->priv->tune;
+    GBinderDriver* driver = self->driver;
+    gsize size = gbinder_driver_read_buffer_size(driver);
+
+    if (size != tune->read_size) {
+        /* Grown by the driver */
+        gbinder_ipc_tune_record(self, GBINDER_STATS_TUNING_READ_BUFFER,
+            tune->read_size, size);
+    }
+    if (gbinder_driver_read_full_count(driver)) {
+        tune->read_ok = 0;
+    } else if (++(tune->read_ok) >= GBINDER_IPC_TUNE_SHRINK_TICKS) {
+        const gsize smaller = gbinder_driver_shrink_read_buffer(driver);
+
+        tune->read_ok = 0;
+        if (smaller) {
+            gbinder_ipc_tune_record(self, GBINDER_STATS_TUNING_READ_BUFFER,
+                size, smaller);
+            size = smaller;
+        }
+    }
+    tune->read_size = size;
+}
+
+static
+void
+gbinder_ipc_tune_reply_size(
+    GBinderIpc* self)
+{
+    GBinderIpcTuning* tune = &self->priv->tune;
+    const gint size = MIN(gbinder_driver_reply_size_hint(self->driver),
+        GBINDER_IPC_TUNE_MAX_REPLY_SIZE);
+    const gint prev = g_atomic_int_get(&tune->reply_size);
+
+    /* Zero means that there haven't been enough replies to tell */
+    if (size && size != prev) {
+        g_atomic_int_set(&tune->reply_size, size);
+        gbinder_ipc_tune_record(self, GBINDER_STATS_TUNING_REPLY_SIZE,
+            prev, size);
+    }
+}
+
+void
+gbinder_ipc_tune(
+    GBinderIpc* self)
+{
+    GBinderIpcPriv* priv = self->priv;
+
+    /* Main thread only */
+    if (priv->tune.interval) {
+        gbinder_ipc_tune_loopers(self);
+        if (priv->tx_pool) {
+            gbinder_ipc_tune_tx_threads(self);
+        }
+        gbinder_ipc_tune_read_buffer(self);
+        gbinder_ipc_tune_reply_size(self);
+    }
+}
+
+static
+gboolean
+gbinder_ipc_tune_timer(
+    gpointer user_data)
+{
+    gbinder_ipc_tune(THIS(user_data));
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+gbinder_ipc_tune_start(
+    gpointer user_data)
+{
+    GBinderIpc* self = THIS(user_data);
+    GBinderIpcPriv* priv = self->priv;
+
+    /* Removed by gbinder_ipc_dispose() */
+    if (!priv->tune.timer) {
+        priv->tune.timer = gbinder_timeout_add_in(priv->tune.interval,
+            gbinder_ipc_tune_timer, self, priv->context);
+    }
+}
+
+static
+void
+gbinder_ipc_tune_arm(
+    GBinderIpcPriv* priv)
+{
+    /*
+     * The timer is started on the main thread when the GBinderIpc gets
+     * used for the first time, by then the main context is known.
+     */
+    if (priv->tune.interval && !g_atomic_int_get(&priv->tune.armed) &&
+        g_atomic_int_compare_and_exchange(&priv->tune.armed, FALSE, TRUE)) {
+        gbinder_idle_callback_invoke_later_in(gbinder_ipc_tune_start,
+            gbinder_ipc_ref(priv->self), g_object_unref, priv->context);
+    }
+}
+
+gsize
+gbinder_ipc_reply_size_hint(
+    GBinderIpc* self)
+{
+    return g_atomic_int_get(&self->priv->tune.reply_size);
+}
+
 /*==========================================================================*
  * GBinderIpcLooper
  *==========================================================================*/
@@ -428,18 +1035,18 @@ void
 gbinder_ipc_looper_free(
     GBinderIpcLooper* looper)
 {
-    if (!looper->joined && looper->thread != pthread_self()) {
-        pthread_join(looper->thread, NULL);
+    if (!looper->joined) {
+        if (looper->thread != pthread_self()) {
+            pthread_join(looper->thread, NULL);
+        } else {
+            /* Looper has exited on its own, nobody is going to join it */
+            pthread_detach(looper->thread);
+        }
     }
     close(looper->pipefd[0]);
     close(looper->pipefd[1]);
-    if (looper->txfd[0] >= 0) {
-        close(looper->txfd[0]);
-        close(looper->txfd[1]);
-    }
     gbinder_driver_unref(looper->driver);
     g_free(looper->name);
-    g_cond_clear(&looper->start_cond);
     g_mutex_clear(&looper->mutex);
     g_slice_free(GBinderIpcLooper, looper);
 }
@@ -465,6 +1072,17 @@ gbinder_ipc_looper_unref(
     }
 }
 
+#if GBINDER_USDT
+#  define gbinder_ipc_looper_tx_trace(probe,tx) do { \
+    GBinderReader reader; gsize size = 0; gconstpointer ptr; \
+    gbinder_remote_request_init_reader((tx)->req, &reader); \
+    ptr = gbinder_reader_get_data(&reader, &size); \
+    GBINDER_TRACE(probe, (uintptr_t)(tx)->obj, (tx)->code, size, ptr); \
+    } while (0)
+#else
+#  define gbinder_ipc_looper_tx_trace(probe,tx) ((void)0)
+#endif
+
 static
 void
 gbinder_ipc_looper_tx_handle(
@@ -474,6 +1092,8 @@ gbinder_ipc_looper_tx_handle(
     GBinderRemoteRequest* req = tx->req;
     GBinderLocalReply* reply;
     int status = GBINDER_STATUS_OK;
+    gint64 start, hstart;
+    gboolean blocked;
     guint8 done;
 
     /*
@@ -487,10 +1107,24 @@ gbinder_ipc_looper_tx_handle(
     tx->state = GBINDER_IPC_LOOPER_TX_PROCESSING;
 
     /* Actually handle the transaction */
+    gbinder_ipc_looper_tx_trace(dispatch_start, tx);
+    start = gbinder_stats_begin();
+    hstart = gbinder_stats_handler_begin();
     reply = gbinder_local_object_handle_transaction(tx->obj, req,
         tx->code, tx->flags, &status);
+    if (hstart) {
+        gbinder_stats_handler(tx->obj->ipc->dev,
+            gbinder_remote_request_interface(req), tx->code, tx->flags,
+            gbinder_remote_request_trace_id(req), hstart);
+    }
+    if (start) {
+        gbinder_stats_incoming(tx->obj->ipc->dev, tx->code, tx->flags, req,
+            reply, status, start);
+    }
+    gbinder_ipc_looper_tx_trace(dispatch_end, tx);
 
     /* Handle all possible return states */
+    g_mutex_lock(&tx->mutex);
     switch (tx->state) {
     case GBINDER_IPC_LOOPER_TX_PROCESSING:
         /* Result was returned by the handler */
@@ -510,13 +1144,15 @@ gbinder_ipc_looper_tx_handle(
     default:
         break;
     }
+    blocked = (tx->state == GBINDER_IPC_LOOPER_TX_BLOCKED);
+    g_mutex_unlock(&tx->mutex);
 
     /* In case handler returns a reply which it wasn't expected to return */
     GASSERT(!reply);
     gbinder_local_reply_unref(reply);
 
     /* Drop the transaction reference unless blocked */
-    if (tx->state == GBINDER_IPC_LOOPER_TX_BLOCKED) {
+    if (blocked) {
         done = TX_BLOCKED;
         /*
          * From this point on, it's GBinderRemoteRequest who's holding
@@ -531,44 +1167,328 @@ gbinder_ipc_looper_tx_handle(
     } else {
         done = TX_DONE;
         if (req->tx) {
-            gbinder_ipc_looper_tx_unref(req->tx, FALSE);
+            gbinder_ipc_looper_tx_unref(req->tx);
             req->tx = NULL;
         }
     }
 
     /* And wake up the looper */
-    if (write(tx->pipefd[1], &done, sizeof(done)) <= 0) {
-        GWARN("Failed to wake up the looper");
-    }
+    gbinder_ipc_looper_tx_signal(tx, done);
 }
 
+/*
+ * Transactions which have to be handled on the main thread are pushed
+ * by the loopers to the lock-free dispatch_inbox stack. Only the first
+ * push after the main thread has picked up the previous batch schedules
+ * the idle callback, so that the whole burst costs a single wakeup.
+ * The main thread moves the batch to the priority queues and handles
+ * at most GBINDER_IPC_DISPATCH_BUDGET transactions per main loop
+ * iteration. Higher priority transactions which arrive in the meantime
+ * overtake the lower priority ones still waiting in the queue.
+ */
 static
 void
-gbinder_ipc_looper_tx_done(
-    gpointer data)
+gbinder_ipc_dispatch_collect(
+    GBinderIpcPriv* priv)
 {
-    gbinder_ipc_looper_tx_unref(data, FALSE);
+    GBinderIpcLooperTx* list;
+    GBinderIpcLooperTx* fifo = NULL;
+
+    /* Take the whole stack at once, there's no ABA problem that way */
+    do {
+        list = g_atomic_pointer_get(&priv->dispatch_inbox);
+    } while (list && !g_atomic_pointer_compare_and_exchange
+        (&priv->dispatch_inbox, list, NULL));
+
+    /* The stack is LIFO, restore the order of arrival */
+    while (list) {
+        GBinderIpcLooperTx* next = list->next;
+
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+
+    while (fifo) {
+        GBinderIpcLooperTx* tx = fifo;
+
+        fifo = tx->next;
+        tx->next = NULL;
+        g_queue_push_tail(priv->dispatch_queue + tx->priority, tx);
+    }
 }
 
 static
 void
-gbinder_ipc_looper_start(
-    GBinderIpcLooper* looper)
+gbinder_ipc_dispatch_calls(
+    GBinderIpcPriv* priv)
 {
-    if (!g_atomic_int_get(&looper->started)) {
-        /* Lock */
-        g_mutex_lock(&looper->mutex);
-        if (!g_atomic_int_get(&looper->started)) {
-            g_cond_wait_until(&looper->start_cond, &looper->mutex,
-                g_get_monotonic_time() + GBINDER_IPC_LOOPER_START_TIMEOUT_SEC *
-                    G_TIME_SPAN_SECOND);
-            GASSERT(g_atomic_int_get(&looper->started));
+    GBinderIpcCall* list;
+    GBinderIpcCall* fifo = NULL;
+
+    do {
+        list = g_atomic_pointer_get(&priv->call_inbox);
+    } while (list && !g_atomic_pointer_compare_and_exchange
+        (&priv->call_inbox, list, NULL));
+
+    while (list) {
+        GBinderIpcCall* next = list->next;
+
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+
+    while (fifo) {
+        GBinderIpcCall* call = fifo;
+
+        fifo = call->next;
+        if (call->func) {
+            call->func(call->data);
+        }
+        if (call->destroy) {
+            call->destroy(call->data);
+        }
+
+        /* Recycle the call */
+        g_mutex_lock(&priv->pool_mutex);
+        if (priv->call_pool_size < GBINDER_IPC_POOL_SIZE) {
+            call->next = priv->call_pool;
+            priv->call_pool = call;
+            priv->call_pool_size++;
+            call = NULL;
+        }
+        g_mutex_unlock(&priv->pool_mutex);
+        if (call) {
+            g_slice_free(GBinderIpcCall, call);
         }
-        g_mutex_unlock(&looper->mutex);
-        /* Unlock */
     }
 }
 
+static
+GBinderIpcLooperTx*
+gbinder_ipc_dispatch_pop(
+    GBinderIpcPriv* priv)
+{
+    int i;
+
+    for (i = GBINDER_IPC_DISPATCH_QUEUES - 1; i >= 0; i--) {
+        GBinderIpcLooperTx* tx = g_queue_pop_head(priv->dispatch_queue + i);
+
+        if (tx) {
+            return tx;
+        }
+    }
+    return NULL;
+}
+
+static
+gboolean
+gbinder_ipc_dispatch_pending(
+    GBinderIpcPriv* priv)
+{
+    int i;
+
+    for (i = 0; i < GBINDER_IPC_DISPATCH_QUEUES; i++) {
+        if (!g_queue_is_empty(priv->dispatch_queue + i)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static
+void
+gbinder_ipc_dispatch_proc(
+    gpointer data);
+
+static
+void
+gbinder_ipc_dispatch_schedule(
+    GBinderIpcPriv* priv)
+{
+    if (g_atomic_int_compare_and_exchange(&priv->dispatch_scheduled, 0, 1)) {
+        /* The callback holds a reference to GBinderIpc */
+        gbinder_idle_callback_invoke_later_in(gbinder_ipc_dispatch_proc,
+            gbinder_ipc_ref(priv->self), g_object_unref, priv->context);
+    }
+}
+
+static
+void
+gbinder_ipc_dispatch_handle(
+    GBinderIpcLooperTx* tx)
+{
+    GBinderIpcSched saved;
+
+    /*
+     * Run the handler at the priority the kernel has given to the looper,
+     * if it's higher than that of the main thread.
+     */
+    if (tx->inherit && gbinder_ipc_sched_get(&saved) &&
+        gbinder_ipc_sched_higher(&tx->sched, &saved) &&
+        gbinder_ipc_sched_set(&tx->sched)) {
+        gbinder_ipc_looper_tx_handle(tx);
+        gbinder_ipc_sched_set(&saved);
+    } else {
+        gbinder_ipc_looper_tx_handle(tx);
+    }
+}
+
+static
+void
+gbinder_ipc_dispatch_proc(
+    gpointer data)
+{
+    GBinderIpc* self = THIS(data);
+    GBinderIpcPriv* priv = self->priv;
+    int n = 0;
+
+    /* Transactions pushed after this point will schedule another wakeup */
+    g_atomic_int_set(&priv->dispatch_scheduled, 0);
+    gbinder_ipc_dispatch_calls(priv);
+    gbinder_ipc_dispatch_collect(priv);
+
+    while (n < GBINDER_IPC_DISPATCH_BUDGET) {
+        GBinderIpcLooperTx* tx = gbinder_ipc_dispatch_pop(priv);
+
+        if (!tx) {
+            break;
+        }
+        gbinder_stats_probe_exit(GBINDER_STATS_PROBE_DISPATCH, tx->posted);
+        tx->posted = 0;
+        if (!g_atomic_int_get(&tx->cancelled)) {
+            gbinder_ipc_dispatch_handle(tx);
+            n++;
+        }
+        gbinder_ipc_looper_tx_unref(tx);
+    }
+
+    /* Let the rest of the main loop run before handling the rest */
+    if (gbinder_ipc_dispatch_pending(priv)) {
+        gbinder_ipc_dispatch_schedule(priv);
+    }
+}
+
+/*
+ * Objects with serial dispatch have their transactions queued to the
+ * per-object strand. The first transaction to hit an idle strand hands
+ * the object over to the process-wide worker pool, and the worker keeps
+ * handling transactions for this object until the strand runs dry.
+ * After GBINDER_IPC_DISPATCH_BUDGET transactions the object goes to the
+ * back of the pool queue, so that a busy object doesn't hog the worker
+ * while others are waiting. The strand stays busy in the meantime and
+ * nobody else touches it.
+ */
+static
+void
+gbinder_ipc_strand_proc(
+    gpointer data,
+    gpointer user_data)
+{
+    GBinderLocalObject* obj = data;
+    GBinderIpcLooperTx* tx;
+    int n = 0;
+
+    while ((tx = gbinder_local_object_strand_pop(obj)) != NULL) {
+        gbinder_stats_probe_exit(GBINDER_STATS_PROBE_DISPATCH, tx->posted);
+        tx->posted = 0;
+        if (!g_atomic_int_get(&tx->cancelled)) {
+            gbinder_ipc_looper_tx_handle(tx);
+        }
+        gbinder_ipc_looper_tx_unref(tx);
+        if (++n == GBINDER_IPC_DISPATCH_BUDGET) {
+            /* The pool item still holds the object reference */
+            g_thread_pool_push(gbinder_ipc_strand_pool, obj, NULL);
+            return;
+        }
+    }
+    gbinder_local_object_unref(obj);
+}
+
+static
+GThreadPool*
+gbinder_ipc_strand_pool_get(
+    void)
+{
+    GThreadPool* pool = g_atomic_pointer_get(&gbinder_ipc_strand_pool);
+
+    if (G_UNLIKELY(!pool)) {
+        /* Lock */
+        gbinder_ipc_global_lock();
+        pool = gbinder_ipc_strand_pool;
+        if (!pool) {
+            const int n = MAX(g_get_num_processors(), 2);
+
+            pool = g_thread_pool_new(gbinder_ipc_strand_proc, NULL, n,
+                FALSE, NULL);
+            g_atomic_pointer_set(&gbinder_ipc_strand_pool, pool);
+            GDEBUG("Serial dispatch pool of %d threads", n);
+        }
+        pthread_mutex_unlock(&gbinder_ipc_mutex);
+        /* Unlock */
+    }
+    return pool;
+}
+
+static
+gboolean
+gbinder_ipc_looper_tx_dispatch(
+    GBinderIpcLooperTx* tx)
+{
+    if (gbinder_local_object_looper_dispatch(tx->obj)) {
+        /* The object is fine with being called on the looper thread */
+        gbinder_ipc_looper_tx_handle(tx);
+        return FALSE;
+    } else if (gbinder_local_object_serial_dispatch(tx->obj)) {
+        GThreadPool* pool = gbinder_ipc_strand_pool_get();
+
+        /* One transaction at a time, in the order of arrival */
+        gbinder_ipc_looper_tx_ref(tx);
+        tx->posted = gbinder_stats_probe_enter(GBINDER_STATS_PROBE_DISPATCH);
+        if (gbinder_local_object_strand_push(tx->obj, tx)) {
+            g_thread_pool_push(pool, gbinder_local_object_ref(tx->obj), NULL);
+        }
+        return TRUE;
+    } else {
+        GBinderIpcPriv* priv = tx->obj->ipc->priv;
+        GBinderIpcLooperTx* head;
+
+        /* Only the objects with scheduling hints inherit the priority */
+        if (gbinder_local_object_sched(tx->obj) &&
+            gbinder_ipc_sched_get(&tx->sched)) {
+            tx->inherit = TRUE;
+            if (gbinder_ipc_sched_is_rt(&tx->sched)) {
+                /* And realtime ones jump the queue */
+                tx->priority = GBINDER_LOCAL_PRIORITY_HIGH;
+            }
+        }
+        gbinder_ipc_looper_tx_ref(tx);
+        tx->posted = gbinder_stats_probe_enter(GBINDER_STATS_PROBE_DISPATCH);
+        do {
+            head = g_atomic_pointer_get(&priv->dispatch_inbox);
+            tx->next = head;
+        } while (!g_atomic_pointer_compare_and_exchange
+            (&priv->dispatch_inbox, head, tx));
+        gbinder_ipc_dispatch_schedule(priv);
+        return TRUE;
+    }
+}
+
+static
+void
+gbinder_ipc_looper_tx_undispatch(
+    GBinderIpcLooperTx* tx)
+{
+    /*
+     * The transaction can't be pulled out of the lock-free stack (or the
+     * strand), it's marked as cancelled and dropped by the main thread
+     * (or the strand worker) without being handled. If it has already
+     * been handled, this has no effect.
+     */
+    g_atomic_int_set(&tx->cancelled, TRUE);
+}
+
 static
 gboolean
 gbinder_ipc_looper_remove_from_list(
@@ -602,8 +1522,52 @@ gboolean
 gbinder_ipc_looper_remove_primary(
     GBinderIpcLooper* looper)
 {
-    return gbinder_ipc_looper_remove_from_list(looper,
-        &looper->ipc->priv->primary_loopers);
+    GBinderIpcPriv* priv = looper->ipc->priv;
+
+    /* Caller holds looper_mutex */
+    if (gbinder_ipc_looper_remove_from_list(looper, &priv->primary_loopers)) {
+        g_atomic_int_add(&priv->primary_count, -1);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+void
+gbinder_ipc_looper_add_primary(
+    GBinderIpcLooper* looper)
+{
+    GBinderIpcPriv* priv = looper->ipc->priv;
+
+    /* Caller holds looper_mutex */
+    looper->next = priv->primary_loopers;
+    priv->primary_loopers = looper;
+    g_atomic_int_inc(&priv->primary_count);
+}
+
+static
+void
+gbinder_ipc_looper_grow(
+    GBinderIpc* ipc,
+    gboolean spawned)
+{
+    GBinderIpcPriv* priv = ipc->priv;
+
+    /* Lock */
+    gbinder_ipc_looper_lock(priv);
+    if (priv->primary_count < priv->max_loopers) {
+        /* The thread doesn't need to be fully started */
+        GBinderIpcLooper* looper = gbinder_ipc_looper_new(ipc, spawned);
+
+        if (looper) {
+            gbinder_ipc_looper_add_primary(looper);
+        }
+    } else {
+        GDEBUG("Too many %s loopers (%d)", priv->name, priv->primary_count);
+        g_atomic_int_inc(&priv->tune.looper_short);
+    }
+    g_mutex_unlock(&priv->looper_mutex);
+    /* Unlock */
 }
 
 static
@@ -616,25 +1580,24 @@ gbinder_ipc_looper_remove_blocked(
 }
 
 static
-guint
-gbinder_ipc_looper_count_primary(
-    GBinderIpcLooper* looper)
+gboolean
+gbinder_ipc_looper_can_loop(
+    GBinderHandler* handler)
 {
-    const GBinderIpcLooper* ptr = looper->ipc->priv->primary_loopers;
-    guint n = 0;
+    GBinderIpcLooper* looper = G_CAST(handler,GBinderIpcLooper,handler);
 
-    for (n = 0; ptr; ptr = ptr->next) n++;
-    return n;
+    return !g_atomic_int_get(&looper->exit);
 }
 
 static
-gboolean
-gbinder_ipc_looper_can_loop(
+void
+gbinder_ipc_looper_spawn(
     GBinderHandler* handler)
 {
     GBinderIpcLooper* looper = G_CAST(handler,GBinderIpcLooper,handler);
 
-    return !g_atomic_int_get(&looper->exit);
+    /* BR_SPAWN_LOOPER */
+    gbinder_ipc_looper_grow(looper->ipc, TRUE);
 }
 
 static
@@ -649,114 +1612,193 @@ gbinder_ipc_looper_transact(
 {
     GBinderIpcLooper* looper = G_CAST(handler,GBinderIpcLooper,handler);
     GBinderIpc* ipc = looper->ipc;
+    GBinderIpcPriv* priv = ipc->priv;
+    GBinderIpcLooperTx* tx = gbinder_ipc_looper_tx_new(obj, code, flags, req);
     GBinderLocalReply* reply = NULL;
+    gboolean queued;
+    gboolean was_blocked = FALSE;
     int status = -EFAULT;
+    guint8 done;
 
-    if (looper->txfd[0] < 0 && pipe(looper->txfd)) {
-        GERR("Failed to create a tx pipe: %s", strerror(errno));
+    /* Make sure that there's someone to receive the next transaction */
+    if (g_atomic_int_add(&priv->busy_count, 1) + 1 >=
+        g_atomic_int_get(&priv->primary_count)) {
+        gbinder_ipc_looper_grow(ipc, FALSE);
     }
 
-    if (looper->txfd[0] >= 0) {
-        GBinderIpcLooperTx* tx = gbinder_ipc_looper_tx_new(obj, code, flags,
-            req, looper->txfd);
-        GBinderIpcPriv* priv = ipc->priv;
-        guint8 done = 0;
-        gboolean was_blocked = FALSE;
-        /* Let GBinderLocalObject handle the transaction on the main thread */
-        GBinderEventLoopCallback* callback =
-            gbinder_idle_callback_schedule_new(gbinder_ipc_looper_tx_handle,
-                gbinder_ipc_looper_tx_ref(tx), gbinder_ipc_looper_tx_done);
-
-        /* Wait for either transaction completion or looper shutdown */
-        if (gbinder_ipc_wait(looper->pipefd[0], tx->pipefd[0], &done) &&
-            done == TX_BLOCKED) {
+    /* Let gbinder_ipc_looper_stop() wake us up */
+    g_mutex_lock(&looper->mutex);
+    looper->tx = tx;
+    g_mutex_unlock(&looper->mutex);
+
+    /*
+     * Let GBinderLocalObject handle the transaction on the main thread,
+     * unless it wants to handle it right here.
+     */
+    queued = gbinder_ipc_looper_tx_dispatch(tx);
+
+    /* Wait for either transaction completion or looper shutdown */
+    done = gbinder_ipc_looper_tx_wait(tx, 0, &looper->exit);
+    if (done == TX_BLOCKED) {
+        /*
+         * We are going to block this looper for potentially
+         * significant period of time. Start new looper to
+         * accept normal incoming requests and terminate this
+         * one when we are done with this transaction.
+         *
+         * For the duration of the transaction, this looper is
+         * moved to the blocked_loopers list.
+         */
+        const gint64 blocked = gbinder_stats_probe_enter
+            (GBINDER_STATS_PROBE_LOOPER_BLOCKED);
+
+        /* Lock */
+        gbinder_ipc_looper_lock(priv);
+        if (gbinder_ipc_looper_remove_primary(looper)) {
+            GVERBOSE("Primary looper %s is blocked", looper->name);
+            looper->next = priv->blocked_loopers;
+            priv->blocked_loopers = looper;
+            was_blocked = TRUE;
+
             /*
-             * We are going to block this looper for potentially
-             * significant period of time. Start new looper to
-             * accept normal incoming requests and terminate this
-             * one when we are done with this transaction.
-             *
-             * For the duration of the transaction, this looper is
-             * moved to the blocked_loopers list.
+             * If there's no more primary loopers left, create one.
+             * There's no need to wait until it gets started, incoming
+             * transactions stay queued in the kernel until then.
              */
-            GBinderIpcPriv* priv = looper->ipc->priv;
-            GBinderIpcLooper* new_looper = NULL;
+            if (!priv->primary_loopers) {
+                GBinderIpcLooper* new_looper = gbinder_ipc_looper_new(ipc,
+                    FALSE);
 
-            /* Lock */
-            g_mutex_lock(&priv->looper_mutex);
-            if (gbinder_ipc_looper_remove_primary(looper)) {
-                GVERBOSE("Primary looper %s is blocked", looper->name);
-                looper->next = priv->blocked_loopers;
-                priv->blocked_loopers = looper;
-                was_blocked = TRUE;
-
-                /* If there's no more primary loopers left, create one */
-                if (!priv->primary_loopers) {
-                    new_looper = gbinder_ipc_looper_new(ipc);
-                    if (new_looper) {
-                        /* Will unref it after it gets started */
-                        gbinder_ipc_looper_ref(new_looper);
-                        priv->primary_loopers = new_looper;
-                    }
+                if (new_looper) {
+                    gbinder_ipc_looper_add_primary(new_looper);
                 }
             }
-            g_mutex_unlock(&priv->looper_mutex);
-            /* Unlock */
-
-            if (new_looper) {
-                /* Wait until it gets started */
-                gbinder_ipc_looper_start(new_looper);
-                gbinder_ipc_looper_unref(new_looper);
-            }
-
-            /* Block until asynchronous transaction gets completed. */
-            done = 0;
-            if (gbinder_ipc_wait(looper->pipefd[0], tx->pipefd[0], &done)) {
-                GVERBOSE("Looper %s is released", looper->name);
-                GASSERT(done == TX_DONE);
-            }
         }
+        g_mutex_unlock(&priv->looper_mutex);
+        /* Unlock */
 
+        /* Block until asynchronous transaction gets completed. */
+        done = gbinder_ipc_looper_tx_wait(tx, TX_BLOCKED, &looper->exit);
+        gbinder_stats_probe_exit(GBINDER_STATS_PROBE_LOOPER_BLOCKED, blocked);
         if (done) {
+            GVERBOSE("Looper %s is released", looper->name);
             GASSERT(done == TX_DONE);
-            reply = gbinder_local_reply_ref(tx->reply);
-            status = tx->status;
-        }
-
-        if (!gbinder_ipc_looper_tx_unref(tx, TRUE)) {
-            /*
-             * This wasn't the last reference meaning that
-             * gbinder_ipc_looper_tx_free() will close the
-             * descriptors and we will have to create a new
-             * pipe for the next transaction.
-             */
-            looper->txfd[0] = looper->txfd[1] = -1;
         }
+    }
 
-        gbinder_idle_callback_destroy(callback);
+    g_mutex_lock(&looper->mutex);
+    looper->tx = NULL;
+    g_mutex_unlock(&looper->mutex);
 
-        if (was_blocked) {
-            guint n;
+    if (done) {
+        GASSERT(done == TX_DONE);
+        reply = gbinder_local_reply_ref(tx->reply);
+        status = tx->status;
+    }
 
-            g_mutex_lock(&priv->looper_mutex);
-            n = gbinder_ipc_looper_count_primary(looper);
-            if (n >= GBINDER_IPC_MAX_PRIMARY_LOOPERS) {
-                /* Looper will exit once transaction completes */
-                GDEBUG("Too many primary loopers (%u)", n);
-                g_atomic_int_set(&looper->exit, 1);
-            } else {
-                /* Move it back to the primary list */
-                gbinder_ipc_looper_remove_blocked(looper);
-                looper->next = priv->primary_loopers;
-                priv->primary_loopers = looper;
-            }
-            g_mutex_unlock(&priv->looper_mutex);
+    if (queued) {
+        /* Looper is exiting, the transaction may still be in the queue */
+        gbinder_ipc_looper_tx_undispatch(tx);
+    }
+    gbinder_ipc_looper_tx_unref(tx);
+
+    if (was_blocked) {
+        gbinder_ipc_looper_lock(priv);
+        if (priv->primary_count >= priv->max_loopers) {
+            /* Looper will exit once transaction completes */
+            GDEBUG("Too many primary loopers (%d)", priv->primary_count);
+            g_atomic_int_set(&looper->exit, 1);
+        } else {
+            /* Move it back to the primary list */
+            gbinder_ipc_looper_remove_blocked(looper);
+            gbinder_ipc_looper_add_primary(looper);
         }
+        g_mutex_unlock(&priv->looper_mutex);
     }
+    g_atomic_int_add(&priv->busy_count, -1);
     *result = status;
     return reply;
 }
 
+/* The shared idle looper takes over when all loopers are gone */
+#define gbinder_ipc_looper_min(priv) \
+    ((priv)->shared_idle ? 0 : g_atomic_int_get(&(priv)->min_loopers))
+
+static
+int
+gbinder_ipc_looper_poll_timeout(
+    GBinderIpcLooper* looper)
+{
+    GBinderIpcPriv* priv = looper->ipc->priv;
+
+    /* Only the loopers above the minimum need to watch for idle time */
+    return (g_atomic_int_get(&priv->primary_count) >
+        gbinder_ipc_looper_min(priv)) ?
+        g_atomic_int_get(&priv->looper_idle_timeout) : -1;
+}
+
+static
+gboolean
+gbinder_ipc_looper_idle_exit(
+    GBinderIpcLooper* looper)
+{
+    GBinderIpcPriv* priv = looper->ipc->priv;
+    gboolean exit = FALSE;
+
+    /* Lock */
+    gbinder_ipc_looper_lock(priv);
+    if (priv->primary_count > gbinder_ipc_looper_min(priv) &&
+        gbinder_ipc_looper_remove_primary(looper)) {
+        exit = TRUE;
+        if (!priv->primary_count) {
+            /* The device goes back to the shared idle looper */
+            gbinder_ipc_idle_looper_arm(priv);
+        }
+    }
+    g_mutex_unlock(&priv->looper_mutex);
+    /* Unlock */
+    return exit;
+}
+
+static
+void
+gbinder_ipc_looper_warm_up(
+    GBinderIpcLooper* looper)
+{
+    volatile guint8 stack[GBINDER_IPC_LOOPER_PREFAULT_STACK];
+    gsize i;
+
+    /* Fault in the stack pages, one write per page is enough */
+    for (i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+    gbinder_driver_prepare_read(looper->driver);
+}
+
+static
+int
+gbinder_ipc_looper_read(
+    GBinderIpcLooper* looper,
+    gboolean blocking)
+{
+    /*
+     * No need to synchronize access to looper->ipc because
+     * the other thread would wait until this thread exits
+     * before setting looper->ipc to NULL.
+     */
+    GBinderIpc* ipc = gbinder_ipc_ref(looper->ipc);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    /* But that gbinder_driver_read() may unref GBinderIpc */
+    const int ret = blocking ?
+        gbinder_driver_read_blocking(looper->driver, reg, &looper->handler) :
+        gbinder_driver_read(looper->driver, reg, &looper->handler);
+
+    /* And this gbinder_ipc_unref() may release the last ref: */
+    gbinder_ipc_unref(ipc);
+    /* And at this point looper->ipc may be NULL */
+    return ret;
+}
+
 static
 gpointer
 gbinder_ipc_looper_thread(
@@ -767,46 +1809,60 @@ gbinder_ipc_looper_thread(
 
     g_mutex_lock(&looper->mutex);
     pthread_setname_np(looper->thread, looper->name);
-    if (gbinder_driver_enter_looper(driver)) {
+    gbinder_thread_config_apply(looper->ipc->priv->thread_config +
+        GBINDER_IPC_THREADS_LOOPER);
+    if (looper->warm_up) {
+        gbinder_ipc_looper_warm_up(looper);
+    }
+    if (looper->spawned ? gbinder_driver_register_looper(driver) :
+        gbinder_driver_enter_looper(driver)) {
         struct pollfd pipefd;
+        gboolean idle = FALSE;
         int res;
 
         GDEBUG("Looper %s running", looper->name);
-        g_atomic_int_set(&looper->started, TRUE);
-        g_cond_broadcast(&looper->start_cond);
+        gbinder_stats_startup(GBINDER_STATS_STARTUP_LOOPER, looper->created);
         g_mutex_unlock(&looper->mutex);
 
         memset(&pipefd, 0, sizeof(pipefd));
         pipefd.fd = looper->pipefd[0]; /* read end of the pipe */
         pipefd.events = POLLIN | POLLERR | POLLHUP | POLLNVAL;
 
-        res = gbinder_driver_poll(driver, &pipefd);
-        while (!g_atomic_int_get(&looper->exit) && ((res & POLLIN) || !res)) {
-            if (res & POLLIN) {
-                /*
-                 * No need to synchronize access to looper->ipc because
-                 * the other thread would wait until this thread exits
-                 * before setting looper->ipc to NULL.
-                 */
-                GBinderIpc* ipc = gbinder_ipc_ref(looper->ipc);
-                GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
-                /* But that gbinder_driver_read() may unref GBinderIpc */
-                int ret = gbinder_driver_read(driver, reg, &looper->handler);
-
-                /* And this gbinder_ipc_unref() may release the last ref: */
-                gbinder_ipc_unref(ipc);
-                /* And at this point looper->ipc may be NULL */
+        while (!g_atomic_int_get(&looper->exit)) {
+            const int timeout = gbinder_ipc_looper_poll_timeout(looper);
+
+            if (looper->blocking && timeout < 0) {
+                const int ret = gbinder_ipc_looper_read(looper, TRUE);
+
                 if (ret < 0) {
                     GDEBUG("Looper %s failed", looper->name);
                     break;
+                } else if (g_atomic_int_get(&looper->exit)) {
+                    GDEBUG("Looper %s is requested to exit", looper->name);
+                    break;
+                } else if (ret > 0) {
+                    continue;
                 }
+                /* Came back empty-handed, poll before reading again */
+            }
+            res = gbinder_driver_poll_timeout(driver, &pipefd, timeout);
+            if (g_atomic_int_get(&looper->exit) || !((res & POLLIN) || !res)) {
+                break;
+            }
+            if ((res & POLLIN) && gbinder_ipc_looper_read(looper, FALSE) < 0) {
+                GDEBUG("Looper %s failed", looper->name);
+                break;
             }
             /* Any event from this pipe terminates the loop */
             if (pipefd.revents || g_atomic_int_get(&looper->exit)) {
                 GDEBUG("Looper %s is requested to exit", looper->name);
                 break;
             }
-            res = gbinder_driver_poll(driver, &pipefd);
+            /* Nothing happened for a while, this looper may be redundant */
+            if (!res && gbinder_ipc_looper_idle_exit(looper)) {
+                idle = TRUE;
+                break;
+            }
         }
 
         gbinder_driver_exit_looper(driver);
@@ -814,13 +1870,18 @@ gbinder_ipc_looper_thread(
         /*
          * Again, there's no need to synchronize access to looper->ipc
          * because the other thread would wait until this thread exits
-         * before setting looper->ipc to NULL
+         * before setting looper->ipc to NULL. Except for the idle
+         * looper which has already removed itself from the list and
+         * must not touch looper->ipc anymore.
          */
-        if (looper->ipc) {
+        if (idle) {
+            GDEBUG("Looper %s exits (idle)", looper->name);
+            gbinder_ipc_looper_unref(looper);
+        } else if (looper->ipc) {
             GBinderIpcPriv* priv = looper->ipc->priv;
 
             /* Lock */
-            g_mutex_lock(&priv->looper_mutex);
+            gbinder_ipc_looper_lock(priv);
             if (gbinder_ipc_looper_remove_blocked(looper) ||
                 gbinder_ipc_looper_remove_primary(looper)) {
                 /* Spontaneous exit */
@@ -836,8 +1897,6 @@ gbinder_ipc_looper_thread(
             GDEBUG("Looper %s is abandoned", looper->name);
         }
     } else {
-        g_atomic_int_set(&looper->started, TRUE);
-        g_cond_broadcast(&looper->start_cond);
         g_mutex_unlock(&looper->mutex);
     }
 
@@ -848,7 +1907,8 @@ gbinder_ipc_looper_thread(
 static
 GBinderIpcLooper*
 gbinder_ipc_looper_new(
-    GBinderIpc* ipc)
+    GBinderIpc* ipc,
+    gboolean spawned)
 {
     int fd[2];
 
@@ -856,24 +1916,36 @@ gbinder_ipc_looper_new(
     if (!pipe(fd)) {
         static const GBinderHandlerFunctions handler_functions = {
             .can_loop = gbinder_ipc_looper_can_loop,
-            .transact = gbinder_ipc_looper_transact
+            .transact = gbinder_ipc_looper_transact,
+            .spawn_looper = gbinder_ipc_looper_spawn
         };
         GBinderIpcLooper* looper = g_slice_new0(GBinderIpcLooper);
         static gint gbinder_ipc_next_looper_id = 1;
         guint id = (guint)g_atomic_int_add(&gbinder_ipc_next_looper_id, 1);
+        pthread_attr_t attr_buf;
+        pthread_attr_t* attr;
+        gboolean created;
 
         memcpy(looper->pipefd, fd, sizeof(fd));
-        looper->txfd[0] = looper->txfd[1] = -1;
         g_atomic_int_set(&looper->refcount, 1);
-        g_cond_init(&looper->start_cond);
         g_mutex_init(&looper->mutex);
+        looper->created = g_get_monotonic_time();
         g_mutex_lock(&looper->mutex);
         looper->name = g_strdup_printf("%s#%u", gbinder_ipc_name(ipc), id);
         looper->handler.f = &handler_functions;
+        looper->spawned = spawned;
+        looper->warm_up = ipc->priv->prestart;
+        looper->blocking = ipc->priv->blocking;
         looper->ipc = ipc;
         looper->driver = gbinder_driver_ref(ipc->driver);
-        if (!pthread_create(&looper->thread, NULL, gbinder_ipc_looper_thread,
-            looper)) {
+        attr = gbinder_thread_config_attr(ipc->priv->thread_config +
+            GBINDER_IPC_THREADS_LOOPER, &attr_buf);
+        created = !pthread_create(&looper->thread, attr,
+            gbinder_ipc_looper_thread, looper);
+        if (attr) {
+            pthread_attr_destroy(attr);
+        }
+        if (created) {
             /* gbinder_ipc_looper_thread() will release this reference: */
             gbinder_ipc_looper_ref(looper);
             g_mutex_unlock(&looper->mutex);
@@ -897,27 +1969,40 @@ gbinder_ipc_looper_check(
     if (G_LIKELY(self)) {
         GBinderIpcPriv* priv = self->priv;
 
-        if (!priv->primary_loopers) {
-            GBinderIpcLooper* looper;
+        gbinder_ipc_tune_arm(priv);
+        if (priv->shared_idle) {
+            /* Loopers are started when the device becomes readable */
+            if (!g_atomic_int_get(&priv->primary_count)) {
+                /* Lock */
+                gbinder_ipc_looper_lock(priv);
+                if (!priv->primary_count) {
+                    gbinder_ipc_idle_looper_arm(priv);
+                }
+                g_mutex_unlock(&priv->looper_mutex);
+                /* Unlock */
+            }
+        } else if (!priv->primary_loopers) {
+            /*
+             * Don't wait for the loopers to start. Incoming transactions
+             * stay queued in the kernel until one of them is ready to
+             * pick them up, and the caller (normally the main thread)
+             * doesn't stall while the threads are being spawned.
+             */
 
             /* Lock */
-            g_mutex_lock(&priv->looper_mutex);
-            if (!priv->primary_loopers) {
-                priv->primary_loopers = gbinder_ipc_looper_new(self);
-            }
-            looper = priv->primary_loopers;
-            if (looper) {
-                gbinder_ipc_looper_ref(looper);
+            gbinder_ipc_looper_lock(priv);
+            while (priv->primary_count < priv->min_loopers) {
+                GBinderIpcLooper* new_looper =
+                    gbinder_ipc_looper_new(self, FALSE);
+
+                if (new_looper) {
+                    gbinder_ipc_looper_add_primary(new_looper);
+                } else {
+                    break;
+                }
             }
             g_mutex_unlock(&priv->looper_mutex);
             /* Unlock */
-
-            /* We are not ready to accept incoming transactions until
-             * looper has started. We may need to wait a bit. */
-            if (looper) {
-                gbinder_ipc_looper_start(looper);
-                gbinder_ipc_looper_unref(looper);
-            }
         }
     }
 }
@@ -937,6 +2022,13 @@ gbinder_ipc_looper_stop(
             if (write(looper->pipefd[1], &done, sizeof(done)) <= 0) {
                 GWARN("Failed to stop looper %s", looper->name);
             }
+
+            /* Wake it up if it's waiting for a transaction to complete */
+            g_mutex_lock(&looper->mutex);
+            if (looper->tx) {
+                gbinder_ipc_looper_tx_wakeup(looper->tx);
+            }
+            g_mutex_unlock(&looper->mutex);
         }
     }
 }
@@ -959,27 +2051,34 @@ gbinder_ipc_looper_stop_all(
     return loopers;
 }
 
+static
+void
+gbinder_ipc_looper_join_deadline(
+    struct timespec* deadline)
+{
+    if (clock_gettime(CLOCK_REALTIME, deadline) == 0) {
+        const long ms = 1000000;
+        const long sec = 1000 * ms;
+        const long ns = deadline->tv_nsec +
+            GBINDER_IPC_LOOPER_JOIN_TIMEOUT_MS * ms;
+
+        deadline->tv_sec += ns / sec;
+        deadline->tv_nsec = ns % sec;
+    } else {
+        /* Don't wait at all */
+        memset(deadline, 0, sizeof(*deadline));
+    }
+}
+
 static
 void
 gbinder_ipc_looper_join(
-    GBinderIpcLooper* looper)
+    GBinderIpcLooper* looper,
+    const struct timespec* deadline)
 {
     /* Caller checks looper for NULL */
     if (looper->thread && looper->thread != pthread_self()) {
-        struct timespec ts;
-        int err = clock_gettime(CLOCK_REALTIME, &ts);
-
-        if (!err) {
-            const long ms = 1000000;
-            const long sec = 1000 * ms;
-            const long ns = ts.tv_nsec + GBINDER_IPC_LOOPER_JOIN_TIMEOUT_MS*ms;
-
-            ts.tv_sec += ns / sec;
-            ts.tv_nsec = ns % sec;
-            err = pthread_timedjoin_np(looper->thread, NULL, &ts);
-        }
-
-        if (err) {
+        if (pthread_timedjoin_np(looper->thread, NULL, deadline)) {
             /* Assume that looper is stuck in read */
             GBinderIpc* ipc = looper->ipc;
             GBinderIpcPriv* priv = ipc->priv;
@@ -987,7 +2086,7 @@ gbinder_ipc_looper_join(
             GDEBUG("Looper %s is stuck", looper->name);
 
             /* Lock */
-            g_mutex_lock(&priv->looper_mutex);
+            gbinder_ipc_looper_lock(priv);
             gbinder_driver_close(ipc->driver);
             g_mutex_unlock(&priv->looper_mutex);
             /* Unlock */
@@ -1000,59 +2099,314 @@ gbinder_ipc_looper_join(
 }
 
 /*==========================================================================*
- * GBinderIpcTxHandler
- *
- * It's needed to handle the following scenario:
+ * Shared idle looper
  *
- * 1. Asynchronous call is made. The actual transaction is performed on
- *    gbinder_ipc_tx_proc thread.
- * 2. While we were are waiting for completion of our transaction, we
- *    receive a valid incoming transation.
- * 3. This transaction is handled by gbinder_ipc_tx_handler_transact.
+ * A process which has several binder devices open but rarely gets any
+ * traffic on most of them would otherwise keep at least one sleeping
+ * looper per device. With SharedIdleLooper configured for a device,
+ * the device has no loopers of its own while it's idle. Instead, a single
+ * process-wide thread watches the binder fds of all such devices with
+ * epoll. That thread enters the looper state on each device (otherwise
+ * the kernel wouldn't report process work to poll) but never reads from
+ * them. When a device becomes readable, it's removed from the epoll set
+ * and a dedicated looper gets started. The incoming work stays queued in
+ * the kernel until that looper picks it up, and more loopers are started
+ * the usual way if the traffic keeps up. Once the last of them exits after
+ * staying idle for LooperIdleTimeout, the device goes back to the shared
+ * thread. In other words, the idle timeout provides the hysteresis, and
+ * the busy devices don't pay anything extra.
  *
- * This seems to be quite a rare scenario, so we allocate a new
- * GBinderIpcTxHandler (and new pipes) for each such transaction,
- * to keep things as simple as possible.
+ * All epoll_ctl() calls are made by the shared thread itself, because
+ * the binder driver associates the poll with the calling thread. Other
+ * threads only set the armed flag and poke the eventfd.
  *
+ * Lock order is idle looper mutex first, then looper_mutex. Arming the
+ * watch under looper_mutex is lock-free.
  *==========================================================================*/
 
-static
-GBinderIpcTxHandler*
-gbinder_ipc_tx_handler_new(
-    void)
+struct gbinder_ipc_idle_watch {
+    GBinderIpcIdleWatch* next;
+    GBinderIpc* ipc; /* Not a reference! NULL once detached */
+    GBinderDriver* driver;
+    gint armed;
+    gboolean watched; /* In the epoll set (idle looper thread only) */
+    gboolean entered; /* BC_ENTER_LOOPER sent (idle looper thread only) */
+};
+
+typedef struct gbinder_ipc_idle_looper {
+    pthread_t thread;
+    int epoll_fd;
+    int event_fd;
+    GMutex mutex;
+    GBinderIpcIdleWatch* watches; /* Protected by mutex */
+} GBinderIpcIdleLooper;
+
+#define GBINDER_IPC_IDLE_LOOPER_EVENTS (8)
+
+/* Created on demand and never destroyed, protected by gbinder_ipc_mutex */
+static GBinderIpcIdleLooper* gbinder_ipc_idle_looper = NULL;
+
+static
+void
+gbinder_ipc_idle_looper_wakeup(
+    GBinderIpcIdleLooper* idle)
 {
-    GBinderIpcTxHandler* h = g_slice_new0(GBinderIpcTxHandler);
+    const guint64 one = 1;
 
-    /* Note: pipe() calls can actually fail */
-    if (!pipe(h->txfd)) {
-        if (!pipe(h->pipefd)) {
-            return h;
-        } else {
-            GERR("Failed to create a tx pipe: %s", strerror(errno));
+    if (write(idle->event_fd, &one, sizeof(one)) < 0) {
+        GWARN("Failed to wake up idle looper: %s", strerror(errno));
+    }
+}
+
+static
+void
+gbinder_ipc_idle_looper_arm(
+    GBinderIpcPriv* priv)
+{
+    GBinderIpcIdleWatch* watch = priv->idle_watch;
+
+    /* Caller holds looper_mutex */
+    if (watch && g_atomic_int_compare_and_exchange(&watch->armed, 0, 1)) {
+        GVERBOSE("%s is idle", priv->name);
+        gbinder_ipc_idle_looper_wakeup(gbinder_ipc_idle_looper);
+    }
+}
+
+static
+void
+gbinder_ipc_idle_looper_fire(
+    GBinderIpcIdleLooper* idle,
+    GBinderIpcIdleWatch* watch)
+{
+    /* Caller holds the idle looper mutex */
+    if (watch->watched) {
+        epoll_ctl(idle->epoll_fd, EPOLL_CTL_DEL,
+            gbinder_driver_fd(watch->driver), NULL);
+        watch->watched = FALSE;
+        g_atomic_int_set(&watch->armed, 0);
+        if (watch->ipc) {
+            /* Detached GBinderIpc never gets here */
+            GDEBUG("%s is readable", watch->ipc->priv->name);
+            gbinder_ipc_looper_grow(watch->ipc, FALSE);
         }
-        close(h->txfd[0]);
-        close(h->txfd[1]);
-    } else {
-        GERR("Failed to create a tx pipe: %s", strerror(errno));
     }
-    g_slice_free(GBinderIpcTxHandler, h);
+}
+
+static
+void
+gbinder_ipc_idle_looper_update(
+    GBinderIpcIdleLooper* idle)
+{
+    GBinderIpcIdleWatch* prev = NULL;
+    GBinderIpcIdleWatch* watch = idle->watches;
+
+    /* Caller holds the idle looper mutex */
+    while (watch) {
+        GBinderIpcIdleWatch* next = watch->next;
+        const int fd = gbinder_driver_fd(watch->driver);
+
+        if (!watch->ipc) {
+            /* GBinderIpc is gone */
+            if (watch->watched) {
+                epoll_ctl(idle->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            }
+            if (watch->entered) {
+                gbinder_driver_exit_looper(watch->driver);
+            }
+            if (prev) {
+                prev->next = next;
+            } else {
+                idle->watches = next;
+            }
+            gbinder_driver_unref(watch->driver);
+            g_slice_free(GBinderIpcIdleWatch, watch);
+            watch = next;
+            continue;
+        }
+
+        if (!watch->watched && g_atomic_int_get(&watch->armed)) {
+            struct epoll_event ev;
+
+            if (!watch->entered) {
+                watch->entered = gbinder_driver_enter_looper(watch->driver);
+            }
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.ptr = watch;
+            if (watch->entered &&
+                !epoll_ctl(idle->epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+                watch->watched = TRUE;
+            } else {
+                /* Fall back to a dedicated looper */
+                GWARN("Can't watch %s: %s", watch->ipc->priv->name,
+                    strerror(errno));
+                g_atomic_int_set(&watch->armed, 0);
+                gbinder_ipc_looper_grow(watch->ipc, FALSE);
+            }
+        }
+        prev = watch;
+        watch = next;
+    }
+}
+
+static
+void*
+gbinder_ipc_idle_looper_thread(
+    void* data)
+{
+    GBinderIpcIdleLooper* idle = data;
+    struct epoll_event events[GBINDER_IPC_IDLE_LOOPER_EVENTS];
+
+    pthread_setname_np(idle->thread, "gbinder-idle");
+    for (;;) {
+        const int n = epoll_wait(idle->epoll_fd, events,
+            G_N_ELEMENTS(events), -1);
+        int i;
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            GERR("Idle looper failed: %s", strerror(errno));
+            break;
+        }
+
+        /* Lock */
+        g_mutex_lock(&idle->mutex);
+        for (i = 0; i < n; i++) {
+            GBinderIpcIdleWatch* watch = events[i].data.ptr;
+
+            if (watch) {
+                gbinder_ipc_idle_looper_fire(idle, watch);
+            } else {
+                guint64 count;
+
+                /* Eventfd, (re)armed or detached watches */
+                if (read(idle->event_fd, &count, sizeof(count)) < 0 &&
+                    errno != EAGAIN) {
+                    GWARN("Idle looper eventfd: %s", strerror(errno));
+                }
+            }
+        }
+        gbinder_ipc_idle_looper_update(idle);
+        g_mutex_unlock(&idle->mutex);
+        /* Unlock */
+    }
     return NULL;
 }
 
+static
+GBinderIpcIdleLooper*
+gbinder_ipc_idle_looper_get_locked(
+    void)
+{
+    /* Caller holds gbinder_ipc_mutex */
+    if (!gbinder_ipc_idle_looper) {
+        const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        const int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (epoll_fd >= 0 && event_fd >= 0) {
+            GBinderIpcIdleLooper* idle = g_new0(GBinderIpcIdleLooper, 1);
+            struct epoll_event ev;
+
+            g_mutex_init(&idle->mutex);
+            idle->epoll_fd = epoll_fd;
+            idle->event_fd = event_fd;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            if (!epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &ev) &&
+                !pthread_create(&idle->thread, NULL,
+                gbinder_ipc_idle_looper_thread, idle)) {
+                pthread_detach(idle->thread);
+                gbinder_ipc_idle_looper = idle;
+                return idle;
+            }
+            GERR("Failed to start idle looper");
+            g_mutex_clear(&idle->mutex);
+            g_free(idle);
+        } else {
+            GERR("Failed to create idle looper: %s", strerror(errno));
+        }
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (event_fd >= 0) close(event_fd);
+    }
+    return gbinder_ipc_idle_looper;
+}
+
+static
+gboolean
+gbinder_ipc_idle_looper_attach_locked(
+    GBinderIpc* self)
+{
+    /* Caller holds gbinder_ipc_mutex */
+    GBinderIpcIdleLooper* idle = gbinder_ipc_idle_looper_get_locked();
+
+    if (idle) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcIdleWatch* watch = g_slice_new0(GBinderIpcIdleWatch);
+
+        watch->ipc = self;
+        watch->driver = gbinder_driver_ref(self->driver);
+
+        /* Lock */
+        g_mutex_lock(&idle->mutex);
+        watch->next = idle->watches;
+        idle->watches = watch;
+        g_mutex_unlock(&idle->mutex);
+        /* Unlock */
+
+        /* Nobody else has seen this GBinderIpc yet */
+        priv->idle_watch = watch;
+        priv->shared_idle = TRUE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 static
 void
-gbinder_ipc_tx_handler_free(
-    GBinderIpcTxHandler* h)
+gbinder_ipc_idle_looper_detach(
+    GBinderIpc* self)
 {
-    close(h->pipefd[0]);
-    close(h->pipefd[1]);
-    if (h->txfd[0] >= 0) {
-        close(h->txfd[0]);
-        close(h->txfd[1]);
+    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcIdleWatch* watch;
+
+    /* Loopers exiting on their own don't see the watch after this */
+    gbinder_ipc_looper_lock(priv);
+    watch = priv->idle_watch;
+    priv->idle_watch = NULL;
+    g_mutex_unlock(&priv->looper_mutex);
+
+    if (watch) {
+        GBinderIpcIdleLooper* idle = gbinder_ipc_idle_looper;
+
+        /* And the idle looper won't start any new ones */
+        g_mutex_lock(&idle->mutex);
+        watch->ipc = NULL;
+        g_mutex_unlock(&idle->mutex);
+
+        /* The watch is freed by the idle looper thread */
+        gbinder_ipc_idle_looper_wakeup(idle);
     }
-    g_slice_free(GBinderIpcTxHandler, h);
 }
 
+/*==========================================================================*
+ * GBinderIpcTxHandler
+ *
+ * It's needed to handle the following scenario:
+ *
+ * 1. Asynchronous call is made. The actual transaction is performed on
+ *    gbinder_ipc_tx_proc thread.
+ * 2. While we were are waiting for completion of our transaction, we
+ *    receive a valid incoming transation.
+ * 3. This transaction is handled by gbinder_ipc_tx_handler_transact.
+ *
+ * This seems to be quite a rare scenario, so we allocate a new
+ * GBinderIpcLooperTx for each such transaction, to keep things as
+ * simple as possible.
+ *
+ *==========================================================================*/
+
 static
 GBinderLocalReply*
 gbinder_ipc_tx_handler_transact(
@@ -1063,50 +2417,21 @@ gbinder_ipc_tx_handler_transact(
     guint flags,
     int* result)
 {
-    GBinderIpcTxHandler* h = gbinder_ipc_tx_handler_new();
-    GBinderLocalReply* reply = NULL;
-    int status = -EFAULT;
-
-    if (h) {
-        GBinderIpcLooperTx* tx = gbinder_ipc_looper_tx_new(obj, code, flags,
-            req, h->txfd);
-        guint8 done = 0;
-        /* Handle transaction on the main thread */
-        GBinderEventLoopCallback* callback =
-            gbinder_idle_callback_schedule_new(gbinder_ipc_looper_tx_handle,
-                gbinder_ipc_looper_tx_ref(tx), gbinder_ipc_looper_tx_done);
-
-        /* Wait for completion */
-        if (gbinder_ipc_wait(h->pipefd[0], tx->pipefd[0], &done) &&
-            done == TX_BLOCKED) {
-            /* Block until asynchronous transaction gets completed. */
-            done = 0;
-            if (gbinder_ipc_wait(h->pipefd[0], tx->pipefd[0], &done)) {
-                GASSERT(done == TX_DONE);
-            }
-        }
-
-        if (done) {
-            GASSERT(done == TX_DONE);
-            reply = gbinder_local_reply_ref(tx->reply);
-            status = tx->status;
-        }
-
-        if (!gbinder_ipc_looper_tx_unref(tx, TRUE)) {
-            /*
-             * This wasn't the last references meaning that
-             * gbinder_ipc_looper_tx_free() will close the
-             * descriptors and we will have to create a new
-             * pipe for the next transaction.
-             */
-            h->txfd[0] = h->txfd[1] = -1;
-        }
+    GBinderIpcLooperTx* tx = gbinder_ipc_looper_tx_new(obj, code, flags, req);
+    GBinderLocalReply* reply;
+    /* Handle transaction on the main thread (or right here) */
+    gbinder_ipc_looper_tx_dispatch(tx);
 
-        gbinder_idle_callback_destroy(callback);
-        gbinder_ipc_tx_handler_free(h);
+    /* Wait for completion (can't be cancelled) */
+    if (gbinder_ipc_looper_tx_wait(tx, 0, NULL) == TX_BLOCKED) {
+        /* Block until asynchronous transaction gets completed. */
+        gbinder_ipc_looper_tx_wait(tx, TX_BLOCKED, NULL);
     }
 
-    *result = status;
+    reply = gbinder_local_reply_ref(tx->reply);
+    *result = tx->status;
+
+    gbinder_ipc_looper_tx_unref(tx);
     return reply;
 }
 
@@ -1114,19 +2439,40 @@ gbinder_ipc_tx_handler_transact(
  * GBinderObjectRegistry
  *==========================================================================*/
 
+GBINDER_INLINE_FUNC
+GBinderIpcRegistryShard*
+gbinder_ipc_local_shard(
+    GBinderIpcPriv* priv,
+    gconstpointer pointer)
+{
+    /* Objects are at least 16 bytes aligned, low bits are always zero */
+    return priv->local_objects +
+        ((GPOINTER_TO_SIZE(pointer) >> 4) % GBINDER_IPC_REGISTRY_SHARDS);
+}
+
+GBINDER_INLINE_FUNC
+GBinderIpcRegistryShard*
+gbinder_ipc_remote_shard(
+    GBinderIpcPriv* priv,
+    guint32 handle)
+{
+    return priv->remote_objects + (handle % GBINDER_IPC_REGISTRY_SHARDS);
+}
+
 static
 void
 gbinder_ipc_invalidate_local_object_locked(
     GBinderIpc* self,
     GBinderLocalObject* obj)
 {
-    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcRegistryShard* shard = gbinder_ipc_local_shard(self->priv, obj);
 
-    if (priv->local_objects && g_hash_table_remove(priv->local_objects, obj)) {
+    /* Caller holds the shard mutex */
+    if (shard->table && g_hash_table_remove(shard->table, obj)) {
         GVERBOSE_("%p %s", obj, gbinder_ipc_name(self));
-        if (g_hash_table_size(priv->local_objects) == 0) {
-            g_hash_table_unref(priv->local_objects);
-            priv->local_objects = NULL;
+        if (g_hash_table_size(shard->table) == 0) {
+            g_hash_table_unref(shard->table);
+            shard->table = NULL;
         }
     }
 }
@@ -1137,20 +2483,21 @@ gbinder_ipc_invalidate_remote_handle_locked(
     GBinderIpc* self,
     guint32 handle)
 {
-    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcRegistryShard* shard = gbinder_ipc_remote_shard(self->priv,
+        handle);
 
-    /* Caller holds priv->remote_objects_mutex */
-    if (priv->remote_objects) {
+    /* Caller holds the shard mutex */
+    if (shard->table) {
         const gpointer key = GINT_TO_POINTER(handle);
 #if GUTIL_LOG_VERBOSE
-        const gpointer obj = g_hash_table_lookup(priv->remote_objects, key);
+        const gpointer obj = g_hash_table_lookup(shard->table, key);
 #endif
 
-        if (g_hash_table_remove(priv->remote_objects, key)) {
+        if (g_hash_table_remove(shard->table, key)) {
             GVERBOSE_("handle %u %p %s", handle, obj, gbinder_ipc_name(self));
-            if (g_hash_table_size(priv->remote_objects) == 0) {
-                g_hash_table_unref(priv->remote_objects);
-                priv->remote_objects = NULL;
+            if (g_hash_table_size(shard->table) == 0) {
+                g_hash_table_unref(shard->table);
+                shard->table = NULL;
             }
         }
     }
@@ -1161,12 +2508,12 @@ gbinder_ipc_invalidate_local_object(
     GBinderIpc* self,
     GBinderLocalObject* obj)
 {
-    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcRegistryShard* shard = gbinder_ipc_local_shard(self->priv, obj);
 
     /* Lock */
-    g_mutex_lock(&priv->local_objects_mutex);
+    gbinder_ipc_shard_lock(shard);
     gbinder_ipc_invalidate_local_object_locked(self, obj);
-    g_mutex_unlock(&priv->local_objects_mutex);
+    g_mutex_unlock(&shard->mutex);
     /* Unlock */
 }
 
@@ -1175,15 +2522,47 @@ gbinder_ipc_invalidate_remote_handle(
     GBinderIpc* self,
     guint32 handle)
 {
-    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcRegistryShard* shard = gbinder_ipc_remote_shard(self->priv,
+        handle);
 
     /* Lock */
-    g_mutex_lock(&priv->remote_objects_mutex);
+    gbinder_ipc_shard_lock(shard);
     gbinder_ipc_invalidate_remote_handle_locked(self, handle);
-    g_mutex_unlock(&priv->remote_objects_mutex);
+    g_mutex_unlock(&shard->mutex);
     /* Unlock */
 }
 
+void
+gbinder_ipc_invalidate_remote_handles(
+    GBinderIpc* self,
+    const guint32* handles,
+    guint count)
+{
+    GBinderIpcPriv* priv = self->priv;
+    guint s, k;
+
+    /* Each shard is locked once, no matter how many handles it has */
+    for (s = 0; s < GBINDER_IPC_REGISTRY_SHARDS; s++) {
+        GBinderIpcRegistryShard* shard = priv->remote_objects + s;
+        gboolean locked = FALSE;
+
+        for (k = 0; k < count; k++) {
+            if (gbinder_ipc_remote_shard(priv, handles[k]) == shard) {
+                if (!locked) {
+                    /* Lock */
+                    gbinder_ipc_shard_lock(shard);
+                    locked = TRUE;
+                }
+                gbinder_ipc_invalidate_remote_handle_locked(self, handles[k]);
+            }
+        }
+        if (locked) {
+            g_mutex_unlock(&shard->mutex);
+            /* Unlock */
+        }
+    }
+}
+
 /**
  * Internal functions called by gbinder_object_dispose(). Among other things,
  * it means that it doesn't have to check GBinderIpc pointer for NULL.
@@ -1203,20 +2582,23 @@ gbinder_ipc_invalidate_remote_handle(
  * It's OK for a GObject to get re-referenced in dispose. glib will
  * recheck the refcount once dispose returns, the object stays alive
  * and gbinder_object_finalize() won't be called this time around,
+ *
+ * The lock in question is the mutex of the registry shard which the
+ * object belongs to. Each object always maps to the same shard.
  */
 void
 gbinder_ipc_local_object_disposed(
     GBinderIpc* self,
     GBinderLocalObject* obj)
 {
-    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcRegistryShard* shard = gbinder_ipc_local_shard(self->priv, obj);
 
     /* Lock */
-    g_mutex_lock(&priv->local_objects_mutex);
+    gbinder_ipc_shard_lock(shard);
     if (g_atomic_int_get(&obj->object.ref_count) == 1) {
         gbinder_ipc_invalidate_local_object_locked(self, obj);
     }
-    g_mutex_unlock(&priv->local_objects_mutex);
+    g_mutex_unlock(&shard->mutex);
     /* Unlock */
 }
 
@@ -1225,7 +2607,8 @@ gbinder_ipc_remote_object_disposed(
     GBinderIpc* self,
     GBinderRemoteObject* obj)
 {
-    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcRegistryShard* shard = gbinder_ipc_remote_shard(self->priv,
+        obj->handle);
 
     /*
      * Check of ref_count for 1 makes it possible (albeit quite unlikely)
@@ -1234,15 +2617,15 @@ gbinder_ipc_remote_object_disposed(
      *
      * For this to happen, other thread must re-reference GBinderRemoteObject
      * right before we grab the lock here (making ref_count greater than 1)
-     * and then release that reference before g_object_unref() re-checks the
-     * refcount.
+     * and then release that reference before gbinder_remote_object_unref()
+     * re-checks the refcount.
      *
      * That's why another gbinder_ipc_invalidate_remote_handle() call from
-     * gbinder_remote_object_finalize() is necessary to make sure that stale
+     * gbinder_remote_object_free() is necessary to make sure that stale
      * object pointer isn't stored in the hashtable.
      *
      * We still have to invalidate the handle here because it's the last
-     * point when GObject can be legitimately re-referenced and brought
+     * point when the object can be legitimately re-referenced and brought
      * back to life. Which means that GBinderIpc mutex has to acquired
      * twice during GBinderRemoteObject destruction.
      *
@@ -1251,11 +2634,11 @@ gbinder_ipc_remote_object_disposed(
      */
 
     /* Lock */
-    g_mutex_lock(&priv->remote_objects_mutex);
-    if (g_atomic_int_get(&obj->object.ref_count) == 1) {
+    gbinder_ipc_shard_lock(shard);
+    if (g_atomic_int_get(&obj->refcount) == 1) {
         gbinder_ipc_invalidate_remote_handle_locked(self, obj->handle);
     }
-    g_mutex_unlock(&priv->remote_objects_mutex);
+    g_mutex_unlock(&shard->mutex);
     /* Unlock */
 }
 
@@ -1264,18 +2647,18 @@ gbinder_ipc_register_local_object(
     GBinderIpc* self,
     GBinderLocalObject* obj)
 {
-    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcRegistryShard* shard = gbinder_ipc_local_shard(self->priv, obj);
 
     /* Lock */
-    g_mutex_lock(&priv->local_objects_mutex);
-    if (!priv->local_objects) {
-        priv->local_objects = g_hash_table_new(g_direct_hash, g_direct_equal);
+    gbinder_ipc_shard_lock(shard);
+    if (!shard->table) {
+        shard->table = g_hash_table_new(g_direct_hash, g_direct_equal);
     }
-    if (!g_hash_table_contains(priv->local_objects, obj)) {
-        g_hash_table_insert(priv->local_objects, obj, obj);
+    if (!g_hash_table_contains(shard->table, obj)) {
+        g_hash_table_insert(shard->table, obj, obj);
         GVERBOSE_("%p %s", obj, gbinder_ipc_name(self));
     }
-    g_mutex_unlock(&priv->local_objects_mutex);
+    g_mutex_unlock(&shard->mutex);
     /* Unlock */
 
     gbinder_ipc_looper_check(self);
@@ -1290,20 +2673,24 @@ gbinder_ipc_priv_get_local_object(
     GBinderLocalObject* obj = NULL;
 
     if (pointer) {
+        GBinderIpcRegistryShard* shard = gbinder_ipc_local_shard(priv,
+            pointer);
+
         /* Lock */
-        g_mutex_lock(&priv->local_objects_mutex);
-        if (priv->local_objects) {
-            obj = g_hash_table_lookup(priv->local_objects, pointer);
+        gbinder_ipc_shard_lock(shard);
+        if (shard->table) {
+            obj = g_hash_table_lookup(shard->table, pointer);
             if (obj) {
                 gbinder_local_object_ref(obj);
-            } else {
-                GWARN("Unknown local object %p %s", pointer, priv->name);
             }
-        } else {
-            GWARN("Unknown local object %p %s", pointer, priv->name);
         }
-        g_mutex_unlock(&priv->local_objects_mutex);
+        g_mutex_unlock(&shard->mutex);
         /* Unlock */
+
+        if (!obj) {
+            GWARN_RATELIMITED("Unknown local object %p %s", pointer,
+                priv->name);
+        }
     }
 
     return obj;
@@ -1317,13 +2704,15 @@ gbinder_ipc_priv_get_remote_object(
     REMOTE_REGISTRY_CREATE create,
     gboolean maybe_dead)
 {
+    GBinderIpcRegistryShard* shard = gbinder_ipc_remote_shard(priv, handle);
     GBinderRemoteObject* obj = NULL;
     void* key = GINT_TO_POINTER(handle);
+    gboolean unknown = FALSE;
 
     /* Lock */
-    g_mutex_lock(&priv->remote_objects_mutex);
-    if (priv->remote_objects) {
-        obj = g_hash_table_lookup(priv->remote_objects, key);
+    gbinder_ipc_shard_lock(shard);
+    if (shard->table) {
+        obj = g_hash_table_lookup(shard->table, key);
     }
     if (obj) {
         gbinder_remote_object_ref(obj);
@@ -1338,18 +2727,21 @@ gbinder_ipc_priv_get_remote_object(
             REMOTE_OBJECT_CREATE_DEAD : (create == REMOTE_REGISTRY_CAN_CREATE) ?
             REMOTE_OBJECT_CREATE_ALIVE :
             REMOTE_OBJECT_CREATE_ACQUIRED);
-        if (!priv->remote_objects) {
-            priv->remote_objects = g_hash_table_new
-                (g_direct_hash, g_direct_equal);
+        if (!shard->table) {
+            shard->table = g_hash_table_new(g_direct_hash, g_direct_equal);
         }
         GVERBOSE_("%p handle %u %s", obj, handle, gbinder_ipc_name(self));
-        g_hash_table_replace(priv->remote_objects, key, obj);
+        g_hash_table_replace(shard->table, key, obj);
     } else {
-        GWARN("Unknown handle %u %s", handle, priv->name);
+        unknown = TRUE;
     }
-    g_mutex_unlock(&priv->remote_objects_mutex);
+    g_mutex_unlock(&shard->mutex);
     /* Unlock */
 
+    if (unknown) {
+        /* Not logging under the lock */
+        GWARN_RATELIMITED("Unknown handle %u %s", handle, priv->name);
+    }
     return obj;
 }
 
@@ -1363,25 +2755,30 @@ gbinder_ipc_find_local_object(
 
     if (self)  {
         GBinderIpcPriv* priv = self->priv;
+        guint i;
 
-        /* Lock */
-        g_mutex_lock(&priv->local_objects_mutex);
-        if (priv->local_objects) {
-            GHashTableIter it;
-            gpointer value;
-
-            g_hash_table_iter_init(&it, priv->local_objects);
-            while (g_hash_table_iter_next(&it, NULL, &value)) {
-                GBinderLocalObject* obj = GBINDER_LOCAL_OBJECT(value);
+        for (i = 0; i < GBINDER_IPC_REGISTRY_SHARDS && !found; i++) {
+            GBinderIpcRegistryShard* shard = priv->local_objects + i;
 
-                if (func(obj, user_data)) {
-                    found = gbinder_local_object_ref(obj);
-                    break;
+            /* Lock */
+            gbinder_ipc_shard_lock(shard);
+            if (shard->table) {
+                GHashTableIter it;
+                gpointer value;
+
+                g_hash_table_iter_init(&it, shard->table);
+                while (g_hash_table_iter_next(&it, NULL, &value)) {
+                    GBinderLocalObject* obj = GBINDER_LOCAL_OBJECT(value);
+
+                    if (func(obj, user_data)) {
+                        found = gbinder_local_object_ref(obj);
+                        break;
+                    }
                 }
             }
+            g_mutex_unlock(&shard->mutex);
+            /* Unlock */
         }
-        g_mutex_unlock(&priv->local_objects_mutex);
-        /* Unlock */
     }
 
     return found;
@@ -1428,92 +2825,405 @@ gbinder_ipc_object_registry_unref(
     gbinder_ipc_unref(gbinder_ipc_from_object_registry(reg));
 }
 
+/*
+ * Remote objects arriving in parcels are often dropped as soon as the
+ * parcel is handled, only to be received (and created, and acquired)
+ * again by the next transaction. With RemoteCacheSize configured, the
+ * most recently received ones are kept alive (together with the kernel
+ * reference) for RemoteCacheTimeout ms after they were last seen. The
+ * expiration timer runs on the main thread. Dead objects are dropped
+ * right away.
+ */
 static
-GBinderLocalObject*
-gbinder_ipc_object_registry_get_local(
-    GBinderObjectRegistry* reg,
-    void* pointer)
+GSList*
+gbinder_ipc_remote_cache_expire(
+    GBinderIpcPriv* priv,
+    gint64 now)
 {
-    return gbinder_ipc_priv_get_local_object
-        (gbinder_ipc_priv_from_object_registry(reg), pointer);
-}
+    GSList* drop = NULL;
+    GList* link;
 
-static
-GBinderRemoteObject*
-gbinder_ipc_object_registry_get_remote(
-    GBinderObjectRegistry* reg,
-    guint32 handle,
-    REMOTE_REGISTRY_CREATE create)
-{
-    return gbinder_ipc_priv_get_remote_object
-        (gbinder_ipc_priv_from_object_registry(reg), handle, create, FALSE);
-}
+    /* Caller holds remote_cache_mutex. The oldest entries are at the tail */
+    while ((link = g_queue_peek_tail_link(&priv->remote_cache)) != NULL) {
+        GBinderIpcRemoteCacheEntry* entry = link->data;
 
-/*==========================================================================*
- * Implementation
- *==========================================================================*/
+        if (now >= 0 && entry->expires > now) {
+            break;
+        }
+        g_queue_unlink(&priv->remote_cache, link);
+        g_hash_table_remove(priv->remote_cache_map,
+            GUINT_TO_POINTER(entry->obj->handle));
+        drop = g_slist_prepend(drop, entry->obj);
+        g_slice_free(GBinderIpcRemoteCacheEntry, entry);
+    }
+    return drop;
+}
 
 static
-gulong
-gbinder_ipc_tx_new_id()
+gboolean
+gbinder_ipc_remote_cache_timer(
+    gpointer user_data)
 {
-    static gint gbinder_ipc_next_id = 1;
-    gulong id = (guint)g_atomic_int_add(&gbinder_ipc_next_id, 1);
+    /* Cached objects hold references to GBinderIpc, it's alive */
+    GBinderIpc* self = gbinder_ipc_ref(THIS(user_data));
+    GBinderIpcPriv* priv = self->priv;
+    gboolean keep;
+    GSList* drop;
 
-    if (!id) id = (guint)g_atomic_int_add(&gbinder_ipc_next_id, 1);
-    return id;
+    /* Lock */
+    g_mutex_lock(&priv->remote_cache_mutex);
+    drop = gbinder_ipc_remote_cache_expire(priv, g_get_monotonic_time());
+    keep = (priv->remote_cache.length > 0);
+    if (!keep) {
+        priv->remote_cache_armed = FALSE;
+    }
+    g_mutex_unlock(&priv->remote_cache_mutex);
+    /* Unlock */
+
+    if (!keep) {
+        priv->remote_cache_timer = NULL;
+    }
+    g_slist_free_full(drop, (GDestroyNotify)
+        gbinder_remote_object_unref);
+    gbinder_ipc_unref(self);
+    return keep ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
 }
 
 static
-gulong
-gbinder_ipc_tx_get_id(
-    GBinderIpc* self)
+void
+gbinder_ipc_remote_cache_arm(
+    gpointer user_data)
 {
+    GBinderIpc* self = THIS(user_data);
     GBinderIpcPriv* priv = self->priv;
-    gulong id = gbinder_ipc_tx_new_id();
+    gboolean start;
 
-    while (g_hash_table_contains(priv->tx_table, GINT_TO_POINTER(id))) {
-        id = gbinder_ipc_tx_new_id();
+    /* Lock */
+    g_mutex_lock(&priv->remote_cache_mutex);
+    start = (priv->remote_cache.length > 0);
+    if (!start) {
+        /* Cleared by gbinder_ipc_remote_cache_clear() in the meantime */
+        priv->remote_cache_armed = FALSE;
+    }
+    g_mutex_unlock(&priv->remote_cache_mutex);
+    /* Unlock */
+
+    if (start && !priv->remote_cache_timer) {
+        priv->remote_cache_timer = gbinder_timeout_add_in
+            (priv->remote_cache_timeout, gbinder_ipc_remote_cache_timer,
+                self, priv->context);
     }
-    return id;
 }
 
 static
 void
-gbinder_ipc_tx_free(
-    gpointer data)
+gbinder_ipc_remote_cache_add(
+    GBinderIpcPriv* priv,
+    GBinderRemoteObject* obj)
 {
-    GBinderIpcTxPriv* tx = data;
-    GBinderIpcTx* pub = &tx->pub;
-    GBinderIpc* self = pub->ipc;
-    GBinderIpcPriv* priv = self->priv;
+    if (priv->remote_cache_size && !obj->dead && !obj->local) {
+        const gpointer key = GUINT_TO_POINTER(obj->handle);
+        GBinderIpcRemoteCacheEntry* entry;
+        GBinderRemoteObject* evicted = NULL;
+        gboolean arm = FALSE;
 
-    gbinder_idle_callback_unref(tx->completion);
-    g_hash_table_remove(priv->tx_table, GINT_TO_POINTER(pub->id));
-    tx->fn_free(tx);
+        /* Lock */
+        g_mutex_lock(&priv->remote_cache_mutex);
+        entry = g_hash_table_lookup(priv->remote_cache_map, key);
+        if (entry) {
+            /* Move it to the head */
+            g_queue_unlink(&priv->remote_cache, &entry->link);
+            if (entry->obj != obj) {
+                /* The handle has been reused, the old object is gone */
+                GVERBOSE_("replacing handle %u", obj->handle);
+                evicted = entry->obj;
+                entry->obj = gbinder_remote_object_ref(obj);
+            }
+        } else {
+            if (priv->remote_cache.length >= priv->remote_cache_size) {
+                GBinderIpcRemoteCacheEntry* oldest =
+                    g_queue_pop_tail_link(&priv->remote_cache)->data;
+
+                GVERBOSE_("evicting handle %u", oldest->obj->handle);
+                g_hash_table_remove(priv->remote_cache_map,
+                    GUINT_TO_POINTER(oldest->obj->handle));
+                evicted = oldest->obj;
+                g_slice_free(GBinderIpcRemoteCacheEntry, oldest);
+            }
+            entry = g_slice_new0(GBinderIpcRemoteCacheEntry);
+            entry->link.data = entry;
+            entry->obj = gbinder_remote_object_ref(obj);
+            g_hash_table_insert(priv->remote_cache_map, key, entry);
+        }
+        entry->expires = g_get_monotonic_time() +
+            ((gint64)priv->remote_cache_timeout) * 1000;
+        g_queue_push_head_link(&priv->remote_cache, &entry->link);
+        if (!priv->remote_cache_armed) {
+            priv->remote_cache_armed = arm = TRUE;
+        }
+        g_mutex_unlock(&priv->remote_cache_mutex);
+        /* Unlock */
 
-    /* This may actually deallocate GBinderIpc object: */
-    gbinder_ipc_unref(self);
+        if (arm) {
+            /* The timer is started on the main thread */
+            gbinder_idle_callback_invoke_later_in
+                (gbinder_ipc_remote_cache_arm, gbinder_ipc_ref(priv->self),
+                    g_object_unref, priv->context);
+        }
+        gbinder_remote_object_unref(evicted);
+    }
 }
 
-static
+/* Invoked on the main thread after handling a batch of deaths */
 void
-gbinder_ipc_tx_done(
-    gpointer data)
+gbinder_ipc_remote_cache_drop_dead(
+    GBinderIpc* self)
 {
-    GBinderIpcTxPriv* tx = data;
-    GBinderIpcTx* pub = &tx->pub;
+    GBinderIpcPriv* priv = self->priv;
 
-    if (!pub->cancelled) {
-        tx->fn_done(tx);
+    if (priv->remote_cache_size) {
+        GSList* drop = NULL;
+        GList* l;
+
+        /* Lock */
+        g_mutex_lock(&priv->remote_cache_mutex);
+        l = priv->remote_cache.head;
+        while (l) {
+            GBinderIpcRemoteCacheEntry* entry = l->data;
+
+            l = l->next;
+            if (entry->obj->dead) {
+                g_queue_unlink(&priv->remote_cache, &entry->link);
+                g_hash_table_remove(priv->remote_cache_map,
+                    GUINT_TO_POINTER(entry->obj->handle));
+                drop = g_slist_prepend(drop, entry->obj);
+                g_slice_free(GBinderIpcRemoteCacheEntry, entry);
+            }
+        }
+        g_mutex_unlock(&priv->remote_cache_mutex);
+        /* Unlock */
+
+        g_slist_free_full(drop, (GDestroyNotify)
+            gbinder_remote_object_unref);
     }
 }
 
 static
 void
-gbinder_ipc_tx_pub_init(
-    GBinderIpcTx* tx,
-    GBinderIpc* self,
+gbinder_ipc_remote_cache_clear(
+    GBinderIpc* self)
+{
+    GBinderIpcPriv* priv = self->priv;
+    GSList* drop;
+
+    /* Main thread only */
+    if (priv->remote_cache_timer) {
+        gbinder_timeout_remove(priv->remote_cache_timer);
+        priv->remote_cache_timer = NULL;
+    }
+
+    /* Lock */
+    g_mutex_lock(&priv->remote_cache_mutex);
+    drop = gbinder_ipc_remote_cache_expire(priv, -1);
+    priv->remote_cache_armed = FALSE;
+    g_mutex_unlock(&priv->remote_cache_mutex);
+    /* Unlock */
+
+    g_slist_free_full(drop, (GDestroyNotify)
+        gbinder_remote_object_unref);
+}
+
+static
+GBinderLocalObject*
+gbinder_ipc_object_registry_get_local(
+    GBinderObjectRegistry* reg,
+    void* pointer)
+{
+    return gbinder_ipc_priv_get_local_object
+        (gbinder_ipc_priv_from_object_registry(reg), pointer);
+}
+
+static
+GBinderRemoteObject*
+gbinder_ipc_object_registry_get_remote(
+    GBinderObjectRegistry* reg,
+    guint32 handle,
+    REMOTE_REGISTRY_CREATE create)
+{
+    GBinderIpcPriv* priv = gbinder_ipc_priv_from_object_registry(reg);
+    GBinderRemoteObject* obj = gbinder_ipc_priv_get_remote_object(priv,
+        handle, create, FALSE);
+
+    /* Objects arriving in parcels may be worth keeping around */
+    if (obj && create != REMOTE_REGISTRY_DONT_CREATE) {
+        gbinder_ipc_remote_cache_add(priv, obj);
+    }
+    return obj;
+}
+
+static
+guint
+gbinder_ipc_iface_hash(
+    gconstpointer key)
+{
+    const GBinderIpcIface* iface = key;
+    guint h = 5381;
+    gsize i;
+
+    for (i = 0; i < iface->len; i++) {
+        h = (h << 5) + h + iface->utf16[i];
+    }
+    return h;
+}
+
+static
+gboolean
+gbinder_ipc_iface_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const GBinderIpcIface* i1 = a;
+    const GBinderIpcIface* i2 = b;
+
+    return i1->len == i2->len &&
+        !memcmp(i1->utf16, i2->utf16, i1->len * sizeof(gunichar2));
+}
+
+static
+void
+gbinder_ipc_iface_free(
+    gpointer data)
+{
+    GBinderIpcIface* iface = data;
+
+    g_free(iface->utf8);
+    g_free(iface);
+}
+
+static
+const char*
+gbinder_ipc_object_registry_intern_iface(
+    GBinderObjectRegistry* reg,
+    const gunichar2* utf16,
+    gsize len)
+{
+    GBinderIpcPriv* priv = gbinder_ipc_priv_from_object_registry(reg);
+    const char* str = NULL;
+    GBinderIpcIface key;
+    GBinderIpcIface* iface;
+
+    key.utf16 = utf16;
+    key.len = len;
+
+    /* Lock */
+    g_mutex_lock(&priv->iface_mutex);
+    iface = g_hash_table_lookup(priv->ifaces, &key);
+    if (iface) {
+        str = iface->utf8;
+    } else if (g_hash_table_size(priv->ifaces) < GBINDER_IPC_MAX_IFACES) {
+        char* utf8 = g_utf16_to_utf8(utf16, len, NULL, NULL, NULL);
+
+        if (utf8) {
+            /* UTF-16 data is stored right after the structure */
+            iface = g_malloc(sizeof(GBinderIpcIface) + len * 2);
+            iface->utf16 = memcpy(iface + 1, utf16, len * 2);
+            iface->len = len;
+            iface->utf8 = utf8;
+            g_hash_table_add(priv->ifaces, iface);
+            str = utf8;
+        }
+    }
+    g_mutex_unlock(&priv->iface_mutex);
+    /* Unlock */
+
+    return str;
+}
+
+static
+GBytes*
+gbinder_ipc_object_registry_map_memory(
+    GBinderObjectRegistry* reg,
+    int fd,
+    gsize size)
+{
+    return gbinder_memory_cache_map(gbinder_ipc_priv_from_object_registry
+        (reg)->memory_cache, fd, size);
+}
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+gulong
+gbinder_ipc_tx_new_id()
+{
+    static gint gbinder_ipc_next_id = 1;
+    gulong id = (guint)g_atomic_int_add(&gbinder_ipc_next_id, 1);
+
+    if (!id) id = (guint)g_atomic_int_add(&gbinder_ipc_next_id, 1);
+    return id;
+}
+
+static
+gulong
+gbinder_ipc_tx_get_id(
+    GBinderIpc* self)
+{
+    GBinderIpcPriv* priv = self->priv;
+    gulong id = gbinder_ipc_tx_new_id();
+
+    while (g_hash_table_contains(priv->tx_table, GINT_TO_POINTER(id))) {
+        id = gbinder_ipc_tx_new_id();
+    }
+    return id;
+}
+
+static
+void
+gbinder_ipc_tx_free(
+    gpointer data)
+{
+    GBinderIpcTxPriv* tx = data;
+    GBinderIpcTx* pub = &tx->pub;
+    GBinderIpc* self = pub->ipc;
+    GBinderIpcPriv* priv = self->priv;
+
+    gbinder_timeout_remove(tx->timeout);
+    gbinder_stats_probe_exit(GBINDER_STATS_PROBE_TX_QUEUE, tx->queued);
+    if (tx->extra_thread) {
+        /* The stuck thread is back */
+        gbinder_ipc_tx_pool_resize(priv, -1);
+    }
+    gbinder_idle_callback_unref(tx->completion);
+    g_hash_table_remove(priv->tx_table, GINT_TO_POINTER(pub->id));
+    gbinder_stats_mem_remove(GBINDER_STATS_MEM_TX, tx->mem_bytes);
+    tx->fn_free(tx);
+
+    /* This may actually deallocate GBinderIpc object: */
+    gbinder_ipc_unref(self);
+}
+
+static
+void
+gbinder_ipc_tx_done(
+    gpointer data)
+{
+    GBinderIpcTxPriv* tx = data;
+    GBinderIpcTx* pub = &tx->pub;
+
+    gbinder_timeout_remove(tx->timeout);
+    tx->timeout = NULL;
+    if (!pub->cancelled) {
+        tx->fn_done(tx);
+    }
+}
+
+static
+void
+gbinder_ipc_tx_pub_init(
+    GBinderIpcTx* tx,
+    GBinderIpc* self,
     gulong id,
     void* user_data)
 {
@@ -1529,6 +3239,7 @@ gbinder_ipc_tx_priv_init(
     GBinderIpc* self,
     gulong id,
     void* user_data,
+    gsize mem_bytes,
     GBinderIpcTxPrivFunc fn_exec,
     GBinderIpcTxPrivFunc fn_done,
     GBinderIpcTxPrivFunc fn_free)
@@ -1537,8 +3248,11 @@ gbinder_ipc_tx_priv_init(
     priv->fn_exec = fn_exec;
     priv->fn_done = fn_done;
     priv->fn_free = fn_free;
+    priv->lane = GBINDER_IPC_TX_LANE_NORMAL;
     priv->completion = gbinder_idle_callback_new(gbinder_ipc_tx_done, priv,
         gbinder_ipc_tx_free);
+    priv->mem_bytes = mem_bytes;
+    gbinder_stats_mem_add(GBINDER_STATS_MEM_TX, mem_bytes);
 }
 
 static
@@ -1558,6 +3272,7 @@ gbinder_ipc_tx_internal_free(
     GBinderIpcTxInternal* tx = gbinder_ipc_tx_internal_cast(priv);
     GBinderIpcTx* pub = &priv->pub;
 
+    gbinder_local_object_unref(tx->local);
     gbinder_local_request_unref(tx->req);
     gbinder_remote_reply_unref(tx->reply);
     if (tx->fn_destroy) {
@@ -1566,17 +3281,33 @@ gbinder_ipc_tx_internal_free(
     g_slice_free(GBinderIpcTxInternal, tx);
 }
 
+static
+gboolean
+gbinder_ipc_tx_internal_deliver(
+    GBinderIpcTxInternal* tx,
+    GBinderRemoteReply* reply,
+    int status)
+{
+    GBinderIpcTx* pub = &tx->tx.pub;
+
+    /* Whoever gets here first (worker, main thread or timeout) wins */
+    if (g_atomic_int_compare_and_exchange(&tx->delivered, FALSE, TRUE)) {
+        if (tx->fn_reply) {
+            tx->fn_reply(pub->ipc, reply, status, pub->user_data);
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
 static
 void
 gbinder_ipc_tx_internal_done(
     GBinderIpcTxPriv* priv)
 {
     GBinderIpcTxInternal* tx = gbinder_ipc_tx_internal_cast(priv);
-    GBinderIpcTx* pub = &priv->pub;
 
-    if (tx->fn_reply) {
-        tx->fn_reply(pub->ipc, tx->reply, tx->status, pub->user_data);
-    }
+    gbinder_ipc_tx_internal_deliver(tx, tx->reply, tx->status);
 }
 
 static
@@ -1587,13 +3318,23 @@ gbinder_ipc_tx_internal_exec(
     GBinderIpcTxInternal* tx = gbinder_ipc_tx_internal_cast(priv);
     GBinderIpc* ipc = priv->pub.ipc;
 
-    if (tx->flags & GBINDER_TX_FLAG_ONEWAY) {
+    if (tx->local) {
+        /* Waits for the request to complete if the handler blocks it */
+        tx->reply = gbinder_ipc_transact_local_sync(ipc, tx->local,
+            tx->code, tx->flags, tx->req, &tx->status,
+            &gbinder_ipc_sync_worker);
+    } else if (tx->flags & GBINDER_TX_FLAG_ONEWAY) {
         tx->status = gbinder_ipc_transact_sync_oneway_worker(ipc, tx->handle,
             tx->code, tx->req);
     } else {
         tx->reply = gbinder_ipc_transact_sync_reply_worker(ipc, tx->handle,
             tx->code, tx->req, &tx->status);
     }
+
+    if ((tx->flags & GBINDER_TX_FLAG_WORKER) &&
+        !g_atomic_int_get(&priv->pub.cancelled)) {
+        gbinder_ipc_tx_internal_deliver(tx, tx->reply, tx->status);
+    }
 }
 
 static
@@ -1611,11 +3352,15 @@ gbinder_ipc_tx_internal_new(
 {
     GBinderIpcTxInternal* tx = g_slice_new0(GBinderIpcTxInternal);
     GBinderIpcTxPriv* priv = &tx->tx;
+    GBinderOutputData* out = gbinder_local_request_data(req);
 
-    gbinder_ipc_tx_priv_init(priv, self, id, user_data,
+    /* Request data is held until the transaction completes */
+    gbinder_ipc_tx_priv_init(priv, self, id, user_data, out ?
+        (out->bytes->len + gbinder_output_data_buffers_size(out)) : 0,
         gbinder_ipc_tx_internal_exec, gbinder_ipc_tx_internal_done,
         gbinder_ipc_tx_internal_free);
 
+    priv->lane = GBINDER_IPC_TX_LANE(flags);
     tx->code = code;
     tx->flags = flags;
     tx->handle = handle;
@@ -1685,7 +3430,7 @@ gbinder_ipc_tx_custom_new(
     GBinderIpcTxCustom* tx = g_slice_new0(GBinderIpcTxCustom);
     GBinderIpcTxPriv* priv = &tx->tx;
 
-    gbinder_ipc_tx_priv_init(priv, self, id, user_data,
+    gbinder_ipc_tx_priv_init(priv, self, id, user_data, 0,
         gbinder_ipc_tx_custom_exec, gbinder_ipc_tx_custom_done,
         gbinder_ipc_tx_custom_free);
 
@@ -1705,138 +3450,468 @@ gbinder_ipc_tx_proc(
 {
     GBinderIpcTxPriv* tx = data;
 
-    if (!tx->pub.cancelled) {
+    gbinder_stats_probe_exit(GBINDER_STATS_PROBE_TX_QUEUE, tx->queued);
+    tx->queued = 0;
+
+    /* Pooled threads are shared with other devices */
+    gbinder_thread_config_enter(tx->pub.ipc->priv->thread_config +
+        GBINDER_IPC_THREADS_TX);
+    if (tx->deadline && g_get_monotonic_time() >= tx->deadline) {
+        GVERBOSE_("not executing transaction %lu (expired)", tx->pub.id);
+    } else if (!tx->pub.cancelled) {
+        g_atomic_int_set(&tx->running, TRUE);
         tx->fn_exec(tx);
+        g_atomic_int_set(&tx->running, FALSE);
     } else {
         GVERBOSE_("not executing transaction %lu (cancelled)", tx->pub.id);
     }
+    if (tx->reserved) {
+        /* The next realtime call can have the reserved worker */
+        g_atomic_int_set(&tx->pub.ipc->priv->tx_rt_busy, FALSE);
+    }
 
     /* The result is handled by the main thread */
-    gbinder_idle_callback_schedule(tx->completion);
-}
-
-static
-char*
-gbinder_ipc_make_key(
-    const char* dev,
-    const char* protocol)
-{
-    return g_strdup_printf("%s:%s", protocol, dev);
+    gbinder_idle_callback_schedule_in(tx->completion,
+        tx->pub.ipc->priv->context);
 }
 
-/*==========================================================================*
- * GBinderIpcSyncApi for worker threads
- *==========================================================================*/
-
+/*
+ * Transactions are picked by lane (realtime, normal, background) and
+ * in the order of submission within the lane. On top of that, each
+ * device has a worker reserved for the realtime lane, which takes the
+ * realtime call if it's not busy with the previous one. That puts a
+ * bound on the queueing delay of the realtime calls no matter how many
+ * slow calls have been queued ahead of them.
+ */
 static
-GBinderRemoteReply*
-gbinder_ipc_transact_sync_reply_worker(
-    GBinderIpc* self,
-    guint32 handle,
-    guint32 code,
-    GBinderLocalRequest* req,
-    int* status)
+gint
+gbinder_ipc_tx_compare(
+    gconstpointer a,
+    gconstpointer b,
+    gpointer user_data)
 {
-    /* Must be invoked on worker thread */
-    if (G_LIKELY(self)) {
-        static const GBinderHandlerFunctions handler_fn = {
-            .can_loop = NULL,
-            .transact = gbinder_ipc_tx_handler_transact
-        };
-        GBinderHandler handler = { &handler_fn };
-        GBinderIpcPriv* priv = self->priv;
-        GBinderObjectRegistry* reg = &priv->object_registry;
-        GBinderRemoteReply* reply = gbinder_remote_reply_new(reg);
-        int ret = gbinder_driver_transact(self->driver, reg, &handler,
-            handle, code, req, reply);
+    const GBinderIpcTxPriv* tx1 = a;
+    const GBinderIpcTxPriv* tx2 = b;
 
-        if (status) *status = ret;
-        if (ret == GBINDER_STATUS_OK || !gbinder_remote_reply_is_empty(reply)) {
-            return reply;
-        } else {
-            gbinder_remote_reply_unref(reply);
-        }
+    if (tx1->lane != tx2->lane) {
+        return tx2->lane - tx1->lane;
     } else {
-        if (status) *status = (-EINVAL);
+        /* Sequence numbers may wrap around */
+        return (gint)(tx1->seq - tx2->seq);
     }
-    return NULL;
 }
 
 static
-int
-gbinder_ipc_transact_sync_oneway_worker(
-    GBinderIpc* self,
-    guint32 handle,
-    guint32 code,
-    GBinderLocalRequest* req)
+void
+gbinder_ipc_tx_queue_insert(
+    GQueue* queue,
+    GBinderIpcTxPriv* tx)
 {
-    /* Must be invoked on worker thread */
-    if (G_LIKELY(self)) {
-        static const GBinderHandlerFunctions handler_fn = {
-            .can_loop = NULL,
-            .transact = gbinder_ipc_tx_handler_transact
-        };
-        GBinderHandler handler = { &handler_fn };
-        GBinderIpcPriv* priv = self->priv;
+    GList* l;
 
-        return gbinder_driver_transact(self->driver, &priv->object_registry,
-            &handler, handle, code, req, NULL);
-    } else {
-        return (-EINVAL);
+    /* Behind everything in the same or higher lanes */
+    for (l = queue->tail; l; l = l->prev) {
+        if (((GBinderIpcTxPriv*)l->data)->lane >= tx->lane) {
+            g_queue_insert_after(queue, l, tx);
+            return;
+        }
     }
+    g_queue_push_head(queue, tx);
 }
 
-const GBinderIpcSyncApi gbinder_ipc_sync_worker = {
-    .sync_reply = gbinder_ipc_transact_sync_reply_worker,
-    .sync_oneway = gbinder_ipc_transact_sync_oneway_worker
+/*
+ * With SharedTxThreads configured, the asynchronous transactions of all
+ * devices are executed by a single process-wide GThreadPool, limited to
+ * that many threads. GThreadPool only creates threads when all existing
+ * ones are busy, so the number of threads follows the number of the
+ * concurrent blocking calls rather than the number of open devices.
+ *
+ * Each device queues its transactions separately and may have at most
+ * tx_quota (TxThreads) of them running at the same time. The devices
+ * having something to run take turns in the round-robin ready queue,
+ * so that a burst on one device can't hold off the others. The pool
+ * receives one token per queued transaction, plus another one every
+ * time a device drops below its quota with the work still pending.
+ * Workers which find nothing to run just return.
+ */
+struct gbinder_ipc_tx_pool {
+    GThreadPool* pool;
+    GMutex mutex;
+    GCond idle; /* Signaled when a device runs out of work */
+    GQueue ready; /* GBinderIpcPriv with something to run */
 };
 
-/*==========================================================================*
- * GBinderIpcSyncApi for the main thread
- *==========================================================================*/
+/* Created on demand and never destroyed, protected by gbinder_ipc_mutex */
+static GBinderIpcTxPool* gbinder_ipc_tx_shared_pool = NULL;
 
 static
-GBinderRemoteReply*
-gbinder_ipc_transact_sync_reply(
-    GBinderIpc* self,
-    guint32 handle,
-    guint32 code,
-    GBinderLocalRequest* req,
-    int* status)
+gboolean
+gbinder_ipc_tx_pool_ready_locked(
+    GBinderIpcTxPool* pool,
+    GBinderIpcPriv* priv)
 {
-    if (G_LIKELY(self)) {
-        GBinderIpcPriv* priv = self->priv;
-        GBinderObjectRegistry* reg = &priv->object_registry;
-        GBinderRemoteReply* reply = gbinder_remote_reply_new(reg);
-        int ret = gbinder_driver_transact(self->driver, reg, NULL, handle,
-            code, req, reply);
-
-        if (status) *status = ret;
-        if (ret == GBINDER_STATUS_OK || !gbinder_remote_reply_is_empty(reply)) {
-            return reply;
-        } else {
-            gbinder_remote_reply_unref(reply);
-        }
-    } else {
-        if (status) *status = (-EINVAL);
+    /* Caller holds the pool mutex */
+    if (!priv->tx_ready.data && priv->tx_queue.length &&
+        priv->tx_running < priv->tx_quota) {
+        priv->tx_ready.data = priv;
+        g_queue_push_tail_link(&pool->ready, &priv->tx_ready);
+        return TRUE;
     }
-    return NULL;
+    return FALSE;
 }
 
 static
-int
-gbinder_ipc_transact_sync_oneway(
-    GBinderIpc* self,
-    guint32 handle,
-    guint32 code,
-    GBinderLocalRequest* req)
+void
+gbinder_ipc_tx_pool_proc(
+    gpointer token,
+    gpointer user_data)
 {
-    if (G_LIKELY(self)) {
-        GBinderIpcPriv* priv = self->priv;
+    GBinderIpcTxPool* pool = user_data;
+    GBinderIpcTxPriv* tx = NULL;
+    GBinderIpcPriv* priv = NULL;
+    GBinderIpc* ipc = NULL;
+    GList* link;
 
-        return gbinder_driver_transact(self->driver, &priv->object_registry,
-            NULL, handle, code, req, NULL);
-    } else {
+    /* Lock */
+    g_mutex_lock(&pool->mutex);
+    link = g_queue_pop_head_link(&pool->ready);
+    if (link) {
+        priv = link->data;
+        link->data = NULL;
+        tx = g_queue_pop_head(&priv->tx_queue);
+        priv->tx_running++;
+        /* The completion may drop the last reference to GBinderIpc */
+        ipc = gbinder_ipc_ref(priv->self);
+        /* Back to the end of the line, if it has more to run */
+        gbinder_ipc_tx_pool_ready_locked(pool, priv);
+    }
+    g_mutex_unlock(&pool->mutex);
+    /* Unlock */
+
+    if (tx) {
+        gboolean more;
+
+        gbinder_ipc_tx_proc(tx, NULL);
+
+        /* Lock */
+        g_mutex_lock(&pool->mutex);
+        priv->tx_running--;
+        more = gbinder_ipc_tx_pool_ready_locked(pool, priv);
+        if (!priv->tx_running && !priv->tx_queue.length) {
+            g_cond_broadcast(&pool->idle);
+        }
+        g_mutex_unlock(&pool->mutex);
+        /* Unlock */
+
+        if (more) {
+            /* The device has been held back by its quota */
+            g_thread_pool_push(pool->pool, pool, NULL);
+        }
+        gbinder_ipc_unref(ipc);
+    }
+}
+
+static
+GBinderIpcTxPool*
+gbinder_ipc_tx_pool_get_locked(
+    int max_threads)
+{
+    /* Caller holds gbinder_ipc_mutex */
+    if (!gbinder_ipc_tx_shared_pool) {
+        GBinderIpcTxPool* pool = g_new0(GBinderIpcTxPool, 1);
+
+        g_mutex_init(&pool->mutex);
+        g_cond_init(&pool->idle);
+        g_queue_init(&pool->ready);
+        pool->pool = g_thread_pool_new(gbinder_ipc_tx_pool_proc, pool,
+            max_threads, FALSE, NULL);
+        gbinder_ipc_tx_shared_pool = pool;
+        GDEBUG("Shared pool of %d tx threads", max_threads);
+    }
+    return gbinder_ipc_tx_shared_pool;
+}
+
+static
+void
+gbinder_ipc_tx_push(
+    GBinderIpcPriv* priv,
+    GBinderIpcTxPriv* tx)
+{
+    GBinderIpcTxPool* pool = priv->tx_shared;
+
+    tx->queued = gbinder_stats_probe_enter(GBINDER_STATS_PROBE_TX_QUEUE);
+    tx->seq = priv->tx_seq++;
+    gbinder_ipc_tune_arm(priv);
+    if (tx->lane == GBINDER_IPC_TX_LANE_REALTIME &&
+        g_atomic_int_compare_and_exchange(&priv->tx_rt_busy, FALSE, TRUE)) {
+        if (!priv->tx_rt_pool) {
+            priv->tx_rt_pool = g_thread_pool_new(gbinder_ipc_tx_proc,
+                priv->self, 1, FALSE, NULL);
+        }
+        tx->reserved = TRUE;
+        g_thread_pool_push(priv->tx_rt_pool, tx, NULL);
+    } else if (pool) {
+        /* Lock */
+        g_mutex_lock(&pool->mutex);
+        gbinder_ipc_tx_queue_insert(&priv->tx_queue, tx);
+        gbinder_ipc_tx_pool_ready_locked(pool, priv);
+        g_mutex_unlock(&pool->mutex);
+        /* Unlock */
+
+        g_thread_pool_push(pool->pool, pool, NULL);
+    } else {
+        if (priv->tune.interval &&
+            g_thread_pool_unprocessed(priv->tx_pool) > 0) {
+            /* Transactions are waiting for a thread */
+            g_atomic_int_inc(&priv->tune.tx_short);
+        }
+        g_thread_pool_push(priv->tx_pool, tx, NULL);
+    }
+}
+
+/* Returns TRUE if the limit has been changed */
+static
+gboolean
+gbinder_ipc_tx_pool_resize(
+    GBinderIpcPriv* priv,
+    int delta)
+{
+    GBinderIpcTxPool* pool = priv->tx_shared;
+
+    if (pool) {
+        gboolean more;
+        gint max;
+
+        /* Lock */
+        g_mutex_lock(&pool->mutex);
+        priv->tx_quota = MAX(priv->tx_quota + delta, 1);
+        max = g_thread_pool_get_max_threads(pool->pool);
+        if (max > 0) {
+            g_thread_pool_set_max_threads(pool->pool, MAX(max + delta, 1),
+                NULL);
+        }
+        more = gbinder_ipc_tx_pool_ready_locked(pool, priv);
+        g_mutex_unlock(&pool->mutex);
+        /* Unlock */
+
+        if (more) {
+            g_thread_pool_push(pool->pool, pool, NULL);
+        }
+        return TRUE;
+    } else {
+        const gint max = g_thread_pool_get_max_threads(priv->tx_pool);
+
+        if (delta > 0 ? (max > 0) : (max > 1)) {
+            g_thread_pool_set_max_threads(priv->tx_pool, max + delta, NULL);
+            return TRUE;
+        }
+        return FALSE;
+    }
+}
+
+static
+void
+gbinder_ipc_tx_pool_drain(
+    GBinderIpcPriv* priv)
+{
+    GBinderIpcTxPool* pool = priv->tx_shared;
+
+    if (pool) {
+        /* Lock */
+        g_mutex_lock(&pool->mutex);
+        while (priv->tx_queue.length || priv->tx_running) {
+            g_cond_wait(&pool->idle, &pool->mutex);
+        }
+        g_mutex_unlock(&pool->mutex);
+        /* Unlock */
+    } else if (priv->tx_pool) {
+        GThreadPool* tx_pool = priv->tx_pool;
+
+        priv->tx_pool = NULL;
+        g_thread_pool_free(tx_pool, FALSE, TRUE);
+    }
+    if (priv->tx_rt_pool) {
+        GThreadPool* tx_rt_pool = priv->tx_rt_pool;
+
+        priv->tx_rt_pool = NULL;
+        g_thread_pool_free(tx_rt_pool, FALSE, TRUE);
+    }
+}
+
+/*
+ * Formats the key into the caller's buffer (if it fits) so that looking
+ * up an existing instance doesn't allocate anything. The caller frees
+ * the result if it's not the buffer.
+ */
+static
+char*
+gbinder_ipc_make_key(
+    char* buf,
+    gsize size,
+    const char* dev,
+    const char* protocol)
+{
+    if (g_snprintf(buf, size, "%s:%s", protocol, dev) < (gint)size) {
+        return buf;
+    } else {
+        return g_strdup_printf("%s:%s", protocol, dev);
+    }
+}
+
+/*
+ * The table only needs the write lock for adding and removing entries,
+ * repeated gbinder_ipc_new() calls for the same device don't get in the
+ * way of each other. Creating new instances is still serialized by the
+ * global mutex.
+ */
+static
+GBinderIpc*
+gbinder_ipc_lookup(
+    const char* key)
+{
+    GBinderIpc* self = NULL;
+
+    g_rw_lock_reader_lock(&gbinder_ipc_table_lock);
+    if (gbinder_ipc_table) {
+        self = gbinder_ipc_ref(g_hash_table_lookup(gbinder_ipc_table, key));
+    }
+    g_rw_lock_reader_unlock(&gbinder_ipc_table_lock);
+    return self;
+}
+
+/*==========================================================================*
+ * GBinderIpcSyncApi for worker threads
+ *==========================================================================*/
+
+static
+GBinderRemoteReply*
+gbinder_ipc_transact_sync_reply_worker(
+    GBinderIpc* self,
+    guint32 handle,
+    guint32 code,
+    GBinderLocalRequest* req,
+    int* status)
+{
+    /* Must be invoked on worker thread */
+    if (G_LIKELY(self)) {
+        static const GBinderHandlerFunctions handler_fn = {
+            .can_loop = NULL,
+            .transact = gbinder_ipc_tx_handler_transact
+        };
+        GBinderHandler handler = { &handler_fn };
+        GBinderIpcPriv* priv = self->priv;
+        GBinderObjectRegistry* reg = &priv->object_registry;
+        GBinderRemoteReply* reply = gbinder_remote_reply_new(reg);
+        const gint64 start = gbinder_stats_begin();
+        int ret = gbinder_driver_transact(self->driver, reg, &handler,
+            handle, code, req, reply);
+
+        if (start) {
+            gbinder_stats_outgoing(self->dev, code, 0, req, reply, ret, start);
+        }
+        if (status) *status = ret;
+        if (ret == GBINDER_STATUS_OK || !gbinder_remote_reply_is_empty(reply)) {
+            return reply;
+        } else {
+            gbinder_remote_reply_unref(reply);
+        }
+    } else {
+        if (status) *status = (-EINVAL);
+    }
+    return NULL;
+}
+
+static
+int
+gbinder_ipc_transact_sync_oneway_worker(
+    GBinderIpc* self,
+    guint32 handle,
+    guint32 code,
+    GBinderLocalRequest* req)
+{
+    /* Must be invoked on worker thread */
+    if (G_LIKELY(self)) {
+        static const GBinderHandlerFunctions handler_fn = {
+            .can_loop = NULL,
+            .transact = gbinder_ipc_tx_handler_transact
+        };
+        GBinderHandler handler = { &handler_fn };
+        GBinderIpcPriv* priv = self->priv;
+        const gint64 start = gbinder_stats_begin();
+        const int ret = gbinder_driver_transact(self->driver,
+            &priv->object_registry, &handler, handle, code, req, NULL);
+
+        if (start) {
+            gbinder_stats_outgoing(self->dev, code, GBINDER_TX_FLAG_ONEWAY,
+                req, NULL, ret, start);
+        }
+        return ret;
+    } else {
+        return (-EINVAL);
+    }
+}
+
+const GBinderIpcSyncApi gbinder_ipc_sync_worker = {
+    .sync_reply = gbinder_ipc_transact_sync_reply_worker,
+    .sync_oneway = gbinder_ipc_transact_sync_oneway_worker
+};
+
+/*==========================================================================*
+ * GBinderIpcSyncApi for the main thread
+ *==========================================================================*/
+
+static
+GBinderRemoteReply*
+gbinder_ipc_transact_sync_reply(
+    GBinderIpc* self,
+    guint32 handle,
+    guint32 code,
+    GBinderLocalRequest* req,
+    int* status)
+{
+    if (G_LIKELY(self)) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderObjectRegistry* reg = &priv->object_registry;
+        GBinderRemoteReply* reply = gbinder_remote_reply_new(reg);
+        const gint64 start = gbinder_stats_begin();
+        int ret = gbinder_driver_transact(self->driver, reg, NULL, handle,
+            code, req, reply);
+
+        if (start) {
+            gbinder_stats_outgoing(self->dev, code, 0, req, reply, ret, start);
+        }
+        if (status) *status = ret;
+        if (ret == GBINDER_STATUS_OK || !gbinder_remote_reply_is_empty(reply)) {
+            return reply;
+        } else {
+            gbinder_remote_reply_unref(reply);
+        }
+    } else {
+        if (status) *status = (-EINVAL);
+    }
+    return NULL;
+}
+
+static
+int
+gbinder_ipc_transact_sync_oneway(
+    GBinderIpc* self,
+    guint32 handle,
+    guint32 code,
+    GBinderLocalRequest* req)
+{
+    if (G_LIKELY(self)) {
+        GBinderIpcPriv* priv = self->priv;
+        const gint64 start = gbinder_stats_begin();
+        const int ret = gbinder_driver_transact(self->driver,
+            &priv->object_registry, NULL, handle, code, req, NULL);
+
+        if (start) {
+            gbinder_stats_outgoing(self->dev, code, GBINDER_TX_FLAG_ONEWAY,
+                req, NULL, ret, start);
+        }
+        return ret;
+    } else {
         return (-EINVAL);
     }
 }
@@ -1846,57 +3921,427 @@ const GBinderIpcSyncApi gbinder_ipc_sync_main = {
     .sync_oneway = gbinder_ipc_transact_sync_oneway
 };
 
+/*==========================================================================*
+ * In-process transactions
+ *
+ * Transactions addressed to our own local objects never reach the
+ * driver. The handler reads the parcel right from the bytes produced
+ * by the writer (no copying) which stay owned by the local request.
+ * The same applies to the reply. File descriptors are not duplicated
+ * and therefore not closed when the parcel is freed.
+ *
+ * The request goes through the same state machine as the one received
+ * by the looper, so the handler can use gbinder_remote_request_block()
+ * and gbinder_remote_request_complete(). The thread which made the call
+ * then waits for the completion, just like the looper would. Therefore,
+ * a blocked request can't be completed by the main loop if the call has
+ * been made on the main thread. Asynchronous calls are made from the
+ * worker threads, so they are fine.
+ *==========================================================================*/
+
+typedef struct gbinder_ipc_local_call {
+    GMutex mutex;
+    GCond cond;
+    gboolean done;
+    GBinderIpc* ipc;
+    GBinderLocalObject* obj;
+    guint32 code;
+    guint32 flags;
+    GBinderLocalRequest* req;
+    GBinderIpcLooperTx* tx;
+} GBinderIpcLocalCall;
+
+static
+GBinderBuffer*
+gbinder_ipc_local_buffer(
+    GBinderIpc* self,
+    GBinderOutputData* out,
+    GDestroyNotify destroy,
+    gpointer owner)
+{
+    GUtilIntArray* offsets = gbinder_output_data_offsets(out);
+    guint8* data = out->bytes->data;
+    void** objects = NULL;
+
+    if (offsets && offsets->count) {
+        guint i;
+
+        objects = g_new(void*, offsets->count + 1);
+        for (i = 0; i < offsets->count; i++) {
+            objects[i] = data + offsets->data[i];
+        }
+        objects[i] = NULL;
+    }
+    return gbinder_buffer_new_local(gbinder_driver_io(self->driver), data,
+        out->bytes->len, objects, destroy, owner);
+}
+
+/* Invokes the handler on the calling thread */
+static
+GBinderIpcLooperTx*
+gbinder_ipc_transact_local_handle(
+    GBinderIpc* self,
+    GBinderLocalObject* obj,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req)
+{
+    GBinderRemoteRequest* rreq = gbinder_remote_request_new
+        (&self->priv->object_registry, gbinder_driver_protocol(self->driver),
+            getpid(), geteuid());
+    GBinderIpcLooperTx* tx;
+    const char* iface;
+
+    /* The request keeps the parcel data alive */
+    gbinder_remote_request_set_data(rreq, code, gbinder_ipc_local_buffer(self,
+        gbinder_local_request_data(req), (GDestroyNotify)
+        gbinder_local_request_unref, gbinder_local_request_ref(req)));
+    tx = gbinder_ipc_looper_tx_new(obj, code, flags, rreq);
+    gbinder_remote_request_unref(rreq);
+
+    iface = gbinder_remote_request_interface(tx->req);
+    switch (gbinder_local_object_can_handle_transaction(obj, iface, code)) {
+    case GBINDER_LOCAL_TRANSACTION_LOOPER:
+        /* These can't be blocked */
+        tx->reply = gbinder_local_object_handle_looper_transaction(obj,
+            tx->req, code, flags, &tx->status);
+        tx->state = GBINDER_IPC_LOOPER_TX_COMPLETE;
+        break;
+    case GBINDER_LOCAL_TRANSACTION_SUPPORTED:
+        gbinder_ipc_looper_tx_handle(tx);
+        break;
+    default:
+        GWARN("Unhandled in-process transaction %s 0x%08x", iface, code);
+        tx->status = (-EBADMSG);
+        tx->state = GBINDER_IPC_LOOPER_TX_COMPLETE;
+        break;
+    }
+    return tx;
+}
+
+/* Waits for the blocked request to complete and releases the tx */
+static
+GBinderRemoteReply*
+gbinder_ipc_transact_local_finish(
+    GBinderIpc* self,
+    GBinderIpcLooperTx* tx,
+    int* status)
+{
+    GBinderObjectRegistry* reg = &self->priv->object_registry;
+    GBinderRemoteReply* rreply = NULL;
+    int txstatus = GBINDER_STATUS_OK;
+
+    if (!(tx->flags & GBINDER_TX_FLAG_ONEWAY)) {
+        GBinderLocalReply* reply;
+
+        /* Returns right away unless the handler has blocked the request */
+        gbinder_ipc_looper_tx_wait(tx, TX_BLOCKED, NULL);
+        reply = tx->reply;
+        txstatus = tx->status;
+        if (reply) {
+            rreply = gbinder_remote_reply_new(reg);
+            gbinder_remote_reply_set_data(rreply, gbinder_ipc_local_buffer
+                (self, gbinder_local_reply_data(reply), (GDestroyNotify)
+                gbinder_local_reply_unref, gbinder_local_reply_ref(reply)));
+            txstatus = GBINDER_STATUS_OK;
+        } else if (txstatus == GBINDER_STATUS_OK) {
+            /* Same as BR_REPLY with no data */
+            rreply = gbinder_remote_reply_new(reg);
+        }
+    }
+
+    /* Blocked one-way request holds its own reference to the tx */
+    gbinder_ipc_looper_tx_unref(tx);
+    if (status) *status = txstatus;
+    return rreply;
+}
+
+static
+void
+gbinder_ipc_transact_local_main(
+    gpointer data)
+{
+    GBinderIpcLocalCall* call = data;
+    GBinderIpcLooperTx* tx = gbinder_ipc_transact_local_handle(call->ipc,
+        call->obj, call->code, call->flags, call->req);
+
+    /* Lock */
+    g_mutex_lock(&call->mutex);
+    call->tx = tx;
+    call->done = TRUE;
+    g_cond_signal(&call->cond);
+    g_mutex_unlock(&call->mutex);
+    /* Unlock */
+}
+
+GBinderRemoteReply*
+gbinder_ipc_transact_local_sync(
+    GBinderIpc* self,
+    GBinderLocalObject* obj,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    int* status,
+    const GBinderIpcSyncApi* api)
+{
+    if (api == &gbinder_ipc_sync_main ||
+        gbinder_local_object_looper_dispatch(obj)) {
+        return gbinder_ipc_transact_local_finish(self,
+            gbinder_ipc_transact_local_handle(self, obj, code, flags, req),
+            status);
+    } else {
+        GBinderIpcLocalCall call;
+
+        /* Local objects expect to be called on the main thread */
+        memset(&call, 0, sizeof(call));
+        g_mutex_init(&call.mutex);
+        g_cond_init(&call.cond);
+        call.ipc = self;
+        call.obj = obj;
+        call.code = code;
+        call.flags = flags;
+        call.req = req;
+        gbinder_idle_callback_invoke_later_in(gbinder_ipc_transact_local_main,
+            &call, NULL, self->priv->context);
+
+        /* Lock */
+        g_mutex_lock(&call.mutex);
+        while (!call.done) {
+            g_cond_wait(&call.cond, &call.mutex);
+        }
+        g_mutex_unlock(&call.mutex);
+        /* Unlock */
+
+        g_cond_clear(&call.cond);
+        g_mutex_clear(&call.mutex);
+        return gbinder_ipc_transact_local_finish(self, call.tx, status);
+    }
+}
+
 /*==========================================================================*
  * Interface
  *==========================================================================*/
 
+static
+void
+gbinder_ipc_oneway_spam_proc(
+    gpointer data)
+{
+    GBinderIpc* self = THIS(data);
+
+    g_atomic_int_set(&self->priv->oneway_spam_scheduled, 0);
+    g_signal_emit(self, gbinder_ipc_signals[SIGNAL_ONEWAY_SPAM], 0);
+}
+
+/* Invoked by GBinderDriver on the thread which made the transaction */
+static
+void
+gbinder_ipc_oneway_spam(
+    GBinderDriver* driver,
+    void* user_data)
+{
+    GBinderIpc* self = THIS(user_data);
+    GBinderIpcPriv* priv = self->priv;
+
+    if (g_atomic_int_compare_and_exchange(&priv->oneway_spam_scheduled,
+        0, 1)) {
+        GWARN("%s: too many oneway transactions", self->dev);
+        gbinder_idle_callback_invoke_later_in(gbinder_ipc_oneway_spam_proc,
+            gbinder_ipc_ref(self), g_object_unref, priv->context);
+    }
+}
+
+static
+void
+gbinder_ipc_load_thread_config(
+    GBinderIpc* self,
+    const char* dev,
+    GBINDER_IPC_THREADS threads,
+    const char* cpus_group,
+    const char* nice_group,
+    const char* rt_group)
+{
+    char* cpus = gbinder_config_get_device_string(cpus_group, dev);
+    const int rt = gbinder_config_get_device_int(rt_group, dev, 0);
+
+    if (cpus) {
+        gbinder_ipc_set_thread_cpus(self, threads, cpus);
+        g_free(cpus);
+    }
+
+    /* Realtime priority takes precedence over the nice value */
+    if (rt > 0) {
+        if (!gbinder_ipc_set_thread_sched(self, threads, SCHED_FIFO, rt)) {
+            GWARN("Invalid %s value %d for %s", rt_group, rt, dev);
+        }
+    } else {
+        const int nice = gbinder_config_get_device_int(nice_group, dev,
+            G_MININT);
+
+        if (nice != G_MININT &&
+            !gbinder_ipc_set_thread_sched(self, threads, SCHED_OTHER, nice)) {
+            GWARN("Invalid %s value %d for %s", nice_group, nice, dev);
+        }
+    }
+}
+
+static
+void
+gbinder_ipc_apply_config(
+    GBinderIpc* self,
+    const char* dev)
+{
+    const int tx_threads = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_TX_THREADS, dev, 0);
+    const int prestart = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_PRESTART_LOOPERS, dev, 0);
+    const int blocking = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_BLOCKING_LOOPERS, dev, 0);
+    const int shared_idle = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_SHARED_IDLE_LOOPER, dev, 0);
+    const int shared_tx = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_SHARED_TX_THREADS, NULL, 0);
+    const int max_loopers = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_MAX_LOOPERS, dev,
+            GBINDER_IPC_MAX_PRIMARY_LOOPERS);
+    const int cache_size = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_REMOTE_CACHE_SIZE, dev, 0);
+    const int cache_timeout = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_REMOTE_CACHE_TIMEOUT, dev,
+            GBINDER_IPC_REMOTE_CACHE_TIMEOUT_MS);
+    const int autotune = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_AUTOTUNE, dev, 0);
+    int stack_size;
+
+    /* Caller holds gbinder_ipc_mutex */
+    if (shared_tx > 0) {
+        self->priv->tx_shared = gbinder_ipc_tx_pool_get_locked(shared_tx);
+    } else {
+        self->priv->tx_pool = g_thread_pool_new(gbinder_ipc_tx_proc, self,
+            GBINDER_IPC_MAX_TX_THREADS, FALSE, NULL);
+        g_thread_pool_set_sort_function(self->priv->tx_pool,
+            gbinder_ipc_tx_compare, NULL);
+    }
+    if (prestart > 0) {
+        /* Prestarted loopers don't exit when idle */
+        self->priv->prestart = TRUE;
+        gbinder_ipc_set_looper_limits(self, MIN(prestart, max_loopers),
+            max_loopers);
+    } else {
+        gbinder_ipc_set_looper_limits(self,
+            gbinder_config_get_device_int(GBINDER_CONFIG_GROUP_MIN_LOOPERS,
+                dev, GBINDER_IPC_MIN_PRIMARY_LOOPERS), max_loopers);
+    }
+    self->priv->blocking = (blocking > 0);
+    if (shared_idle > 0 && prestart <= 0) {
+        /* Caller holds gbinder_ipc_mutex */
+        gbinder_ipc_idle_looper_attach_locked(self);
+    }
+    gbinder_ipc_set_looper_idle_timeout(self,
+        gbinder_config_get_device_int(GBINDER_CONFIG_GROUP_LOOPER_IDLE_TIMEOUT,
+            dev, GBINDER_IPC_LOOPER_IDLE_TIMEOUT_MS));
+    if (tx_threads > 0) {
+        gbinder_ipc_set_max_threads(self, tx_threads);
+    }
+    gbinder_ipc_set_remote_cache(self, cache_size, cache_timeout);
+    gbinder_ipc_set_memory_cache(self, gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_MEMORY_CACHE_SIZE, dev, 0));
+    gbinder_ipc_load_thread_config(self, dev, GBINDER_IPC_THREADS_LOOPER,
+        GBINDER_CONFIG_GROUP_LOOPER_CPUS, GBINDER_CONFIG_GROUP_LOOPER_NICE,
+        GBINDER_CONFIG_GROUP_LOOPER_RT_PRIORITY);
+    gbinder_ipc_load_thread_config(self, dev, GBINDER_IPC_THREADS_TX,
+        GBINDER_CONFIG_GROUP_TX_CPUS, GBINDER_CONFIG_GROUP_TX_NICE,
+        GBINDER_CONFIG_GROUP_TX_RT_PRIORITY);
+    stack_size = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_LOOPER_STACK_SIZE, dev, 0);
+    if (stack_size > 0) {
+        gbinder_ipc_set_looper_stack_size(self, stack_size);
+    }
+    if (autotune > 0) {
+        GBinderIpcTuning* tune = &self->priv->tune;
+
+        /* Configured values are the lower bounds */
+        tune->base_loopers = self->priv->max_loopers;
+        tune->max_loopers = MAX(gbinder_config_get_device_int
+            (GBINDER_CONFIG_GROUP_AUTOTUNE_MAX_LOOPERS, dev,
+                2 * tune->base_loopers), tune->base_loopers);
+        tune->base_tx = (tx_threads > 0) ? tx_threads :
+            GBINDER_IPC_MAX_TX_THREADS;
+        tune->max_tx = MAX(gbinder_config_get_device_int
+            (GBINDER_CONFIG_GROUP_AUTOTUNE_MAX_TX_THREADS, dev,
+                2 * tune->base_tx), tune->base_tx);
+        tune->read_size = gbinder_driver_read_buffer_size(self->driver);
+        tune->interval = autotune;
+        gbinder_driver_set_tuning(self->driver, TRUE);
+    }
+}
+
 GBinderIpc*
 gbinder_ipc_new(
     const char* dev,
     const char* protocol_name)
 {
+    const gint64 start = g_get_monotonic_time();
     GBinderIpc* self = NULL;
     const GBinderRpcProtocol* protocol = (protocol_name ?
         gbinder_rpc_protocol_by_name(protocol_name) : NULL);
 
-    if (!dev || !dev[0]) dev = GBINDER_DEFAULT_BINDER;
-    if (!protocol) protocol = gbinder_rpc_protocol_for_device(dev);
-    char* key = gbinder_ipc_make_key(dev, protocol->name);
+    char buf[GBINDER_IPC_KEY_BUF_SIZE];
+    char* key;
 
-    /* Lock */
-    pthread_mutex_lock(&gbinder_ipc_mutex);
-    if (gbinder_ipc_table) {
-        self = g_hash_table_lookup(gbinder_ipc_table, key);
-    }
-    if (self) {
-        g_free(key);
-        gbinder_ipc_ref(self);
-    } else {
-        GBinderDriver* driver = gbinder_driver_new(dev, protocol);
-
-        if (driver) {
-            GBinderIpcPriv* priv;
-
-            self = g_object_new(THIS_TYPE, NULL);
-            priv = self->priv;
-            self->driver = driver;
-            self->dev = g_strdup(dev);
-            priv->key = key;
-            self->priv->object_registry.io = gbinder_driver_io(driver);
-            /* gbinder_ipc_dispose will remove iself from the table */
-            if (!gbinder_ipc_table) {
-                gbinder_ipc_table = g_hash_table_new(g_str_hash, g_str_equal);
+    if (!dev || !dev[0]) dev = GBINDER_DEFAULT_BINDER;
+    if (!protocol) protocol = gbinder_rpc_protocol_for_device(dev);
+    key = gbinder_ipc_make_key(buf, sizeof(buf), dev, protocol->name);
+
+    self = gbinder_ipc_lookup(key);
+    if (!self) {
+        /* Lock */
+        gbinder_ipc_global_lock();
+        /* Someone may have created it while we were waiting for the lock */
+        self = gbinder_ipc_lookup(key);
+        if (!self) {
+            GBinderDriver* driver = gbinder_driver_new(dev, protocol);
+
+            if (driver) {
+                GBinderIpcPriv* priv;
+
+                self = g_object_new(THIS_TYPE, NULL);
+                priv = self->priv;
+                self->driver = driver;
+                self->dev = g_strdup(dev);
+                priv->key = (key == buf) ? g_strdup(buf) : key;
+                key = buf;
+                gbinder_driver_set_oneway_spam_handler(driver,
+                    gbinder_ipc_oneway_spam, self);
+                self->priv->object_registry.io = gbinder_driver_io(driver);
+                /* With "/dev/" prefix, it may be too long to be a thread name */
+                priv->name = self->dev +
+                    (g_str_has_prefix(priv->key, "/dev/") ? 5 : 0);
+                gbinder_ipc_apply_config(self, dev);
+
+                /* Publish the fully initialized instance */
+                g_rw_lock_writer_lock(&gbinder_ipc_table_lock);
+                /* gbinder_ipc_dispose will remove iself from the table */
+                if (!gbinder_ipc_table) {
+                    gbinder_ipc_table = g_hash_table_new(g_str_hash,
+                        g_str_equal);
+                }
+                g_hash_table_replace(gbinder_ipc_table, priv->key, self);
+                g_rw_lock_writer_unlock(&gbinder_ipc_table_lock);
+                gbinder_stats_startup(GBINDER_STATS_STARTUP_IPC, start);
             }
-            g_hash_table_replace(gbinder_ipc_table, priv->key, self);
-            /* With "/dev/" prefix, it may be too long to be a thread name */
-            priv->name = self->dev +
-                (g_str_has_prefix(priv->key, "/dev/") ? 5 : 0);
-        } else {
-            g_free(key);
         }
+        pthread_mutex_unlock(&gbinder_ipc_mutex);
+        /* Unlock */
+    }
+    if (key != buf) {
+        g_free(key);
+    }
+
+    if (self && self->priv->prestart) {
+        /* Does nothing if the loopers are already running */
+        gbinder_ipc_looper_check(self);
     }
-    pthread_mutex_unlock(&gbinder_ipc_mutex);
-    /* Unlock */
     return self;
 }
 
@@ -1939,36 +4384,635 @@ const GBinderIo*
 gbinder_ipc_io(
     GBinderIpc* self)
 {
-    return G_LIKELY(self) ? gbinder_driver_io(self->driver) : NULL;
+    return G_LIKELY(self) ? gbinder_driver_io(self->driver) : NULL;
+}
+
+const GBinderRpcProtocol*
+gbinder_ipc_protocol(
+    GBinderIpc* self)
+{
+    return G_LIKELY(self) ? gbinder_driver_protocol(self->driver) : NULL;
+}
+
+int
+gbinder_ipc_ping_sync(
+    GBinderIpc* ipc,
+    guint32 handle,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderDriver* driver = ipc->driver;
+    GBinderLocalRequest* req = gbinder_driver_local_request_new_ping(driver);
+    guint32 code = gbinder_driver_protocol(driver)->ping_tx;
+    int ret;
+
+    gbinder_remote_reply_unref(api->sync_reply(ipc, handle, code, req, &ret));
+    gbinder_local_request_unref(req);
+    return ret;
+}
+
+/*
+ * Bulk ping. Up to GBINDER_IPC_PING_FANOUT worker transactions are
+ * pinging the objects, each of them picking the next one until there
+ * are none left. The workers only touch the objects and the state array,
+ * everything else happens on the main thread.
+ */
+
+#define GBINDER_IPC_PING_PENDING (-1)
+
+typedef struct gbinder_ipc_ping_many {
+    int refcount; /* The caller's one and one per worker */
+    gulong id;
+    GBinderIpc* ipc;
+    GBinderRemoteObject** objects;
+    gint* state;
+    guint count;
+    guint workers;
+    gint next;
+    gint done; /* Completed or cancelled */
+    GBinderEventLoopTimeout* timeout;
+    GBinderIpcPingFunc func;
+    GDestroyNotify destroy;
+    void* user_data;
+} GBinderIpcPingMany;
+
+static
+void
+gbinder_ipc_ping_many_unref(
+    GBinderIpcPingMany* ping)
+{
+    if (!--ping->refcount) {
+        guint i;
+
+        GASSERT(!ping->timeout);
+        if (ping->destroy) {
+            ping->destroy(ping->user_data);
+        }
+        for (i = 0; i < ping->count; i++) {
+            gbinder_remote_object_unref(ping->objects[i]);
+        }
+        gbinder_ipc_unref(ping->ipc);
+        g_free(ping->objects);
+        g_free(ping->state);
+        g_slice_free(GBinderIpcPingMany, ping);
+    }
+}
+
+static
+void
+gbinder_ipc_ping_many_detach(
+    GBinderIpcPingMany* ping)
+{
+    GBinderIpcPriv* priv = ping->ipc->priv;
+
+    /* Workers stop picking new objects */
+    g_atomic_int_set(&ping->done, TRUE);
+    gbinder_timeout_remove(ping->timeout);
+    ping->timeout = NULL;
+    g_hash_table_remove(priv->ping_table, GINT_TO_POINTER(ping->id));
+    if (!g_hash_table_size(priv->ping_table)) {
+        g_hash_table_destroy(priv->ping_table);
+        priv->ping_table = NULL;
+    }
+}
+
+static
+void
+gbinder_ipc_ping_many_finish(
+    GBinderIpcPingMany* ping)
+{
+    guint8* results = g_new(guint8, MAX(ping->count, 1));
+    guint i;
+
+    for (i = 0; i < ping->count; i++) {
+        const gint state = g_atomic_int_get(ping->state + i);
+
+        results[i] = (state == GBINDER_IPC_PING_PENDING) ?
+            GBINDER_PING_TIMEOUT : state;
+    }
+    gbinder_ipc_ping_many_detach(ping);
+    if (ping->func) {
+        ping->func(ping->ipc, results, ping->count, ping->user_data);
+    }
+    g_free(results);
+    gbinder_ipc_ping_many_unref(ping);
+}
+
+static
+gboolean
+gbinder_ipc_ping_many_timeout(
+    gpointer user_data)
+{
+    GBinderIpcPingMany* ping = user_data;
+
+    ping->timeout = NULL;
+    gbinder_ipc_ping_many_finish(ping);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+gbinder_ipc_ping_many_exec(
+    const GBinderIpcTx* tx)
+{
+    GBinderIpcPingMany* ping = tx->user_data;
+    gint i;
+
+    while (!g_atomic_int_get(&ping->done) &&
+        (i = g_atomic_int_add(&ping->next, 1)) < (gint)ping->count) {
+        if (g_atomic_int_get(ping->state + i) == GBINDER_IPC_PING_PENDING) {
+            const int status = gbinder_ipc_ping_sync(tx->ipc,
+                ping->objects[i]->handle, &gbinder_ipc_sync_worker);
+
+            /* Frozen process is still alive */
+            g_atomic_int_set(ping->state + i, (status == GBINDER_STATUS_OK ||
+                status == GBINDER_STATUS_FROZEN) ? GBINDER_PING_ALIVE :
+                GBINDER_PING_DEAD);
+        }
+    }
+}
+
+static
+void
+gbinder_ipc_ping_many_done(
+    const GBinderIpcTx* tx)
+{
+    GBinderIpcPingMany* ping = tx->user_data;
+
+    GASSERT(ping->workers);
+    ping->workers--;
+    if (!ping->workers && !ping->done) {
+        gbinder_ipc_ping_many_finish(ping);
+    }
+}
+
+static
+void
+gbinder_ipc_ping_many_free(
+    gpointer user_data)
+{
+    gbinder_ipc_ping_many_unref(user_data);
+}
+
+gulong
+gbinder_ipc_ping_many(
+    GBinderIpc* self,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    guint timeout_ms,
+    GBinderIpcPingFunc func,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    if (G_LIKELY(self) && (objects || !count)) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcPingMany* ping = g_slice_new0(GBinderIpcPingMany);
+        guint i, pending = 0;
+
+        ping->refcount = 1;
+        ping->id = gbinder_ipc_tx_get_id(self);
+        ping->ipc = gbinder_ipc_ref(self);
+        ping->count = count;
+        ping->objects = g_new(GBinderRemoteObject*, MAX(count, 1));
+        ping->state = g_new(gint, MAX(count, 1));
+        ping->func = func;
+        ping->destroy = destroy;
+        ping->user_data = user_data;
+        for (i = 0; i < count; i++) {
+            GBinderRemoteObject* obj = objects[i];
+
+            ping->objects[i] = gbinder_remote_object_ref(obj);
+            if (!obj || obj->dead || obj->ipc != self) {
+                ping->state[i] = GBINDER_PING_DEAD;
+            } else if (obj->local) {
+                /* It's our own object */
+                ping->state[i] = GBINDER_PING_ALIVE;
+            } else {
+                ping->state[i] = GBINDER_IPC_PING_PENDING;
+                pending++;
+            }
+        }
+
+        if (!priv->ping_table) {
+            priv->ping_table = g_hash_table_new(g_direct_hash,
+                g_direct_equal);
+        }
+        g_hash_table_insert(priv->ping_table, GINT_TO_POINTER(ping->id),
+            ping);
+        if (pending) {
+            ping->workers = MIN(pending, GBINDER_IPC_PING_FANOUT);
+            for (i = 0; i < ping->workers; i++) {
+                ping->refcount++;
+                gbinder_ipc_transact_custom(self, gbinder_ipc_ping_many_exec,
+                    gbinder_ipc_ping_many_done, gbinder_ipc_ping_many_free,
+                    ping);
+            }
+            if (timeout_ms) {
+                ping->timeout = gbinder_timeout_add_in(timeout_ms,
+                    gbinder_ipc_ping_many_timeout, ping, priv->context);
+            }
+        } else {
+            /* Nothing to wait for, but still complete asynchronously */
+            ping->timeout = gbinder_timeout_add_in(0,
+                gbinder_ipc_ping_many_timeout, ping, priv->context);
+        }
+        return ping->id;
+    }
+    return 0;
+}
+
+/*
+ * Broadcast works the same way as the bulk ping, except that there's
+ * no timeout (one-way transactions don't wait for anything) and the
+ * same request is sent to all targets. The driver doesn't modify the
+ * request, so the workers can share it.
+ */
+
+#define GBINDER_IPC_BROADCAST_PENDING (-EINPROGRESS)
+
+typedef struct gbinder_ipc_broadcast {
+    int refcount; /* The caller's one and one per worker */
+    gulong id;
+    GBinderIpc* ipc;
+    GBinderRemoteObject** objects;
+    GBinderLocalRequest* req;
+    guint32 code;
+    int* status;
+    guint count;
+    guint workers;
+    gint next;
+    gint done; /* Completed or cancelled */
+    GBinderEventLoopTimeout* complete;
+    GBinderIpcBroadcastFunc func;
+    GDestroyNotify destroy;
+    void* user_data;
+} GBinderIpcBroadcast;
+
+static
+void
+gbinder_ipc_broadcast_unref(
+    GBinderIpcBroadcast* bc)
+{
+    if (!--bc->refcount) {
+        guint i;
+
+        GASSERT(!bc->complete);
+        if (bc->destroy) {
+            bc->destroy(bc->user_data);
+        }
+        for (i = 0; i < bc->count; i++) {
+            gbinder_remote_object_unref(bc->objects[i]);
+        }
+        gbinder_local_request_unref(bc->req);
+        gbinder_ipc_unref(bc->ipc);
+        g_free(bc->objects);
+        g_free(bc->status);
+        g_slice_free(GBinderIpcBroadcast, bc);
+    }
+}
+
+static
+void
+gbinder_ipc_broadcast_detach(
+    GBinderIpcBroadcast* bc)
+{
+    GBinderIpcPriv* priv = bc->ipc->priv;
+
+    /* Workers stop picking new targets */
+    g_atomic_int_set(&bc->done, TRUE);
+    gbinder_timeout_remove(bc->complete);
+    bc->complete = NULL;
+    g_hash_table_remove(priv->broadcast_table, GINT_TO_POINTER(bc->id));
+    if (!g_hash_table_size(priv->broadcast_table)) {
+        g_hash_table_destroy(priv->broadcast_table);
+        priv->broadcast_table = NULL;
+    }
+}
+
+static
+void
+gbinder_ipc_broadcast_finish(
+    GBinderIpcBroadcast* bc)
+{
+    gbinder_ipc_broadcast_detach(bc);
+    if (bc->func) {
+        bc->func(bc->ipc, bc->status, bc->count, bc->user_data);
+    }
+    gbinder_ipc_broadcast_unref(bc);
+}
+
+static
+gboolean
+gbinder_ipc_broadcast_complete(
+    gpointer user_data)
+{
+    GBinderIpcBroadcast* bc = user_data;
+
+    bc->complete = NULL;
+    gbinder_ipc_broadcast_finish(bc);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+gbinder_ipc_broadcast_exec(
+    const GBinderIpcTx* tx)
+{
+    GBinderIpcBroadcast* bc = tx->user_data;
+    gint i;
+
+    while (!g_atomic_int_get(&bc->done) &&
+        (i = g_atomic_int_add(&bc->next, 1)) < (gint)bc->count) {
+        if (bc->status[i] == GBINDER_IPC_BROADCAST_PENDING) {
+            bc->status[i] = gbinder_ipc_transact_sync_oneway_worker(tx->ipc,
+                bc->objects[i]->handle, bc->code, bc->req);
+        }
+    }
+}
+
+static
+void
+gbinder_ipc_broadcast_done(
+    const GBinderIpcTx* tx)
+{
+    GBinderIpcBroadcast* bc = tx->user_data;
+
+    GASSERT(bc->workers);
+    bc->workers--;
+    if (!bc->workers && !bc->done) {
+        gbinder_ipc_broadcast_finish(bc);
+    }
+}
+
+static
+void
+gbinder_ipc_broadcast_free(
+    gpointer user_data)
+{
+    gbinder_ipc_broadcast_unref(user_data);
+}
+
+gulong
+gbinder_ipc_broadcast(
+    GBinderIpc* self,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    guint32 code,
+    GBinderLocalRequest* req,
+    GBinderIpcBroadcastFunc func,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    if (G_LIKELY(self) && G_LIKELY(req) && (objects || !count)) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcBroadcast* bc = g_slice_new0(GBinderIpcBroadcast);
+        guint i, pending = 0;
+
+        bc->refcount = 1;
+        bc->id = gbinder_ipc_tx_get_id(self);
+        bc->ipc = gbinder_ipc_ref(self);
+        bc->req = gbinder_local_request_ref(req);
+        bc->code = code;
+        bc->count = count;
+        bc->objects = g_new(GBinderRemoteObject*, MAX(count, 1));
+        bc->status = g_new(int, MAX(count, 1));
+        bc->func = func;
+        bc->destroy = destroy;
+        bc->user_data = user_data;
+        for (i = 0; i < count; i++) {
+            GBinderRemoteObject* obj = objects[i];
+
+            bc->objects[i] = gbinder_remote_object_ref(obj);
+            if (!obj || obj->dead) {
+                bc->status[i] = GBINDER_STATUS_DEAD_OBJECT;
+            } else if (obj->ipc != self) {
+                /* Handles are only meaningful within their device */
+                bc->status[i] = (-EINVAL);
+            } else if (obj->local) {
+                /* Bypass the driver for our own objects */
+                bc->status[i] = gbinder_ipc_transact_local(self, obj->local,
+                    code, GBINDER_TX_FLAG_ONEWAY, req, NULL, NULL, NULL) ?
+                    GBINDER_STATUS_OK : GBINDER_STATUS_FAILED;
+            } else {
+                bc->status[i] = GBINDER_IPC_BROADCAST_PENDING;
+                pending++;
+            }
+        }
+
+        if (!priv->broadcast_table) {
+            priv->broadcast_table = g_hash_table_new(g_direct_hash,
+                g_direct_equal);
+        }
+        g_hash_table_insert(priv->broadcast_table, GINT_TO_POINTER(bc->id),
+            bc);
+        if (pending) {
+            bc->workers = MIN(pending, GBINDER_IPC_BROADCAST_FANOUT);
+            for (i = 0; i < bc->workers; i++) {
+                bc->refcount++;
+                gbinder_ipc_transact_custom(self, gbinder_ipc_broadcast_exec,
+                    gbinder_ipc_broadcast_done, gbinder_ipc_broadcast_free,
+                    bc);
+            }
+        } else {
+            /* Nothing to wait for, but still complete asynchronously */
+            bc->complete = gbinder_timeout_add_in(0,
+                gbinder_ipc_broadcast_complete, bc, priv->context);
+        }
+        return bc->id;
+    }
+    return 0;
+}
+
+static
+gulong
+gbinder_ipc_transact_direct(
+    GBinderIpc* self,
+    guint32 handle,
+    guint32 code,
+    GBinderLocalRequest* req,
+    GBinderIpcReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    /* One-way transactions don't block, no need for a worker thread */
+    const int status = gbinder_ipc_transact_sync_oneway(self, handle, code,
+        req);
+
+    if (reply || destroy) {
+        /* Request has already been sent, no need to keep it around */
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcTxPriv* tx = gbinder_ipc_tx_internal_new(self,
+            gbinder_ipc_tx_get_id(self), handle, code, GBINDER_TX_FLAG_ONEWAY,
+            NULL, reply, destroy, user_data);
+        const gulong id = tx->pub.id;
+
+        gbinder_ipc_tx_internal_cast(tx)->status = status;
+        g_hash_table_insert(priv->tx_table, GINT_TO_POINTER(id), tx);
+        gbinder_idle_callback_schedule_in(tx->completion, priv->context);
+        return id;
+    } else if (status == GBINDER_STATUS_OK) {
+        /* Nothing to complete and nothing to cancel */
+        return gbinder_ipc_tx_new_id();
+    } else {
+        GDEBUG("One-way transaction %u failed (%d)", code, status);
+        return 0;
+    }
+}
+
+gulong
+gbinder_ipc_transact(
+    GBinderIpc* self,
+    guint32 handle,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    GBinderIpcReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    if (G_LIKELY(self)) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcTxPriv* tx;
+        gulong id;
+
+        if ((flags & (GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT)) ==
+            (GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT)) {
+            return gbinder_ipc_transact_direct(self, handle, code, req,
+                reply, destroy, user_data);
+        }
+
+        tx = gbinder_ipc_tx_internal_new(self,
+            gbinder_ipc_tx_get_id(self), handle, code, flags, req, reply,
+            destroy, user_data);
+        id = tx->pub.id;
+        g_hash_table_insert(priv->tx_table, GINT_TO_POINTER(id), tx);
+        gbinder_ipc_tx_push(priv, tx);
+        return id;
+    } else {
+        return 0;
+    }
+}
+
+/*
+ * Same as gbinder_ipc_transact() but the transaction is not submitted
+ * to the thread pool until gbinder_ipc_transact_start() is called. It
+ * can be cancelled in the meantime. Direct one-way transactions are not
+ * supported.
+ */
+gulong
+gbinder_ipc_transact_deferred(
+    GBinderIpc* self,
+    guint32 handle,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    GBinderIpcReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+{
+    if (G_LIKELY(self)) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcTxPriv* tx = gbinder_ipc_tx_internal_new(self,
+            gbinder_ipc_tx_get_id(self), handle, code,
+            flags & ~GBINDER_TX_FLAG_DIRECT, req, reply, destroy, user_data);
+        const gulong id = tx->pub.id;
+
+        g_hash_table_insert(priv->tx_table, GINT_TO_POINTER(id), tx);
+        return id;
+    } else {
+        return 0;
+    }
+}
+
+void
+gbinder_ipc_transact_start(
+    GBinderIpc* self,
+    gulong id)
+{
+    if (G_LIKELY(self) && G_LIKELY(id)) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcTxPriv* tx = g_hash_table_lookup(priv->tx_table,
+            GINT_TO_POINTER(id));
+
+        if (tx) {
+            gbinder_ipc_tx_push(priv, tx);
+        } else {
+            GWARN("Invalid transaction id %lu", id);
+        }
+    }
 }
 
-const GBinderRpcProtocol*
-gbinder_ipc_protocol(
-    GBinderIpc* self)
+static
+gboolean
+gbinder_ipc_tx_timeout(
+    gpointer data)
 {
-    return G_LIKELY(self) ? gbinder_driver_protocol(self->driver) : NULL;
+    GBinderIpcTxPriv* tx = data;
+    GBinderIpcTx* pub = &tx->pub;
+    GBinderIpcPriv* priv = pub->ipc->priv;
+    GBinderIpcTxInternal* itx = gbinder_ipc_tx_internal_cast(tx);
+
+    tx->timeout = NULL;
+    if (!pub->cancelled) {
+        GDEBUG("Transaction %lu timed out", pub->id);
+        if (g_atomic_int_get(&tx->running) && !tx->extra_thread) {
+            /* The thread is stuck in the driver, replace it */
+            tx->extra_thread = gbinder_ipc_tx_pool_resize(priv, 1);
+        }
+
+        /* Complete it now, the actual result will be ignored */
+        g_atomic_int_set(&pub->cancelled, TRUE);
+        if (gbinder_ipc_tx_internal_deliver(itx, NULL, -ETIMEDOUT) &&
+            itx->fn_destroy) {
+            GDestroyNotify destroy = itx->fn_destroy;
+
+            /*
+             * The caller is done with this transaction, don't make it
+             * wait for the stuck thread to release its user data.
+             */
+            itx->fn_destroy = NULL;
+            destroy(pub->user_data);
+        }
+    }
+    return G_SOURCE_REMOVE;
 }
 
-int
-gbinder_ipc_ping_sync(
-    GBinderIpc* ipc,
-    guint32 handle,
-    const GBinderIpcSyncApi* api)
+/*
+ * Sets the deadline for a transaction created with
+ * gbinder_ipc_transact_deferred(), should be done before it's started.
+ * If the deadline passes before the transaction is sent, it's dropped.
+ * If it passes while the worker thread is waiting for the reply, the
+ * transaction is completed with -ETIMEDOUT and another thread is added
+ * to the pool. That thread goes away once the stuck one gets released
+ * by the driver. The destroy callback is invoked right after the
+ * timeout is delivered.
+ */
+void
+gbinder_ipc_transact_set_timeout(
+    GBinderIpc* self,
+    gulong id,
+    guint timeout_ms)
 {
-    GBinderDriver* driver = ipc->driver;
-    GBinderLocalRequest* req = gbinder_driver_local_request_new_ping(driver);
-    guint32 code = gbinder_driver_protocol(driver)->ping_tx;
-    int ret;
-
-    gbinder_remote_reply_unref(api->sync_reply(ipc, handle, code, req, &ret));
-    gbinder_local_request_unref(req);
-    return ret;
+    if (G_LIKELY(self) && G_LIKELY(id) && timeout_ms) {
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcTxPriv* tx = g_hash_table_lookup(priv->tx_table,
+            GINT_TO_POINTER(id));
+
+        if (tx && tx->fn_exec == gbinder_ipc_tx_internal_exec) {
+            gbinder_timeout_remove(tx->timeout);
+            tx->deadline = g_get_monotonic_time() +
+                ((gint64)timeout_ms) * 1000;
+            tx->timeout = gbinder_timeout_add_in(timeout_ms,
+                gbinder_ipc_tx_timeout, tx, priv->context);
+        } else {
+            GWARN("Can't set timeout for transaction %lu", id);
+        }
+    }
 }
 
 gulong
-gbinder_ipc_transact(
+gbinder_ipc_transact_local(
     GBinderIpc* self,
-    guint32 handle,
+    GBinderLocalObject* obj,
     guint32 code,
     guint32 flags,
     GBinderLocalRequest* req,
@@ -1976,15 +5020,16 @@ gbinder_ipc_transact(
     GDestroyNotify destroy,
     void* user_data)
 {
-    if (G_LIKELY(self)) {
+    if (G_LIKELY(self) && G_LIKELY(obj)) {
         GBinderIpcPriv* priv = self->priv;
         GBinderIpcTxPriv* tx = gbinder_ipc_tx_internal_new(self,
-            gbinder_ipc_tx_get_id(self), handle, code, flags, req, reply,
-            destroy, user_data);
+            gbinder_ipc_tx_get_id(self), GBINDER_REMOTE_OBJECT_NO_HANDLE,
+            code, flags, req, reply, destroy, user_data);
         const gulong id = tx->pub.id;
 
+        gbinder_ipc_tx_internal_cast(tx)->local = gbinder_local_object_ref(obj);
         g_hash_table_insert(priv->tx_table, GINT_TO_POINTER(id), tx);
-        g_thread_pool_push(priv->tx_pool, tx, NULL);
+        gbinder_ipc_tx_push(priv, tx);
         return id;
     } else {
         return 0;
@@ -2006,13 +5051,20 @@ gbinder_ipc_transact_custom(
         const gulong id = tx->pub.id;
 
         g_hash_table_insert(priv->tx_table, GINT_TO_POINTER(id), tx);
-        g_thread_pool_push(priv->tx_pool, tx, NULL);
+        gbinder_ipc_tx_push(priv, tx);
         return id;
     } else {
         return 0;
     }
 }
 
+gulong
+gbinder_ipc_new_id(
+    GBinderIpc* self)
+{
+    return G_LIKELY(self) ? gbinder_ipc_tx_get_id(self) : 0;
+}
+
 void
 gbinder_ipc_cancel(
     GBinderIpc* self,
@@ -2022,9 +5074,23 @@ gbinder_ipc_cancel(
         gconstpointer key = GINT_TO_POINTER(id);
         GBinderIpcPriv* priv = self->priv;
         GBinderIpcTx* tx = g_hash_table_lookup(priv->tx_table, key);
+        GBinderIpcPingMany* ping = priv->ping_table ?
+            g_hash_table_lookup(priv->ping_table, key) : NULL;
+        GBinderIpcBroadcast* bc = priv->broadcast_table ?
+            g_hash_table_lookup(priv->broadcast_table, key) : NULL;
 
-        if (tx) {
-            tx->cancelled = TRUE;
+        if (ping) {
+            /* Running pings can't be stopped, their results are dropped */
+            GVERBOSE_("%lu", id);
+            gbinder_ipc_ping_many_detach(ping);
+            gbinder_ipc_ping_many_unref(ping);
+        } else if (bc) {
+            /* The targets which haven't been picked yet are skipped */
+            GVERBOSE_("%lu", id);
+            gbinder_ipc_broadcast_detach(bc);
+            gbinder_ipc_broadcast_unref(bc);
+        } else if (tx) {
+            g_atomic_int_set(&tx->cancelled, TRUE);
             GVERBOSE_("%lu", id);
         } else {
             GWARN("Invalid transaction id %lu", id);
@@ -2037,7 +5103,278 @@ gbinder_ipc_set_max_threads(
     GBinderIpc* self,
     gint max)
 {
-    return g_thread_pool_set_max_threads(self->priv->tx_pool, max, NULL);
+    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcTxPool* pool = priv->tx_shared;
+
+    if (pool) {
+        gboolean more;
+
+        /* Lock */
+        g_mutex_lock(&pool->mutex);
+        priv->tx_quota = (max > 0) ? max : G_MAXINT;
+        more = gbinder_ipc_tx_pool_ready_locked(pool, priv);
+        g_mutex_unlock(&pool->mutex);
+        /* Unlock */
+
+        if (more) {
+            g_thread_pool_push(pool->pool, pool, NULL);
+        }
+        return TRUE;
+    } else {
+        return g_thread_pool_set_max_threads(priv->tx_pool, max, NULL);
+    }
+}
+
+void
+gbinder_ipc_set_looper_limits(
+    GBinderIpc* self,
+    int min,
+    int max)
+{
+    GBinderIpcPriv* priv = self->priv;
+
+    /* There has to be at least one looper */
+    min = MAX(min, 1);
+    max = MAX(max, min);
+
+    /* Lock */
+    gbinder_ipc_looper_lock(priv);
+    g_atomic_int_set(&priv->min_loopers, min);
+    g_atomic_int_set(&priv->max_loopers, max);
+    g_mutex_unlock(&priv->looper_mutex);
+    /* Unlock */
+
+    /* The kernel may ask for the loopers above the minimum */
+    gbinder_driver_set_max_threads(self->driver, max - min);
+}
+
+void
+gbinder_ipc_set_looper_idle_timeout(
+    GBinderIpc* self,
+    int timeout_ms)
+{
+    g_atomic_int_set(&self->priv->looper_idle_timeout, timeout_ms);
+}
+
+void
+gbinder_ipc_set_remote_cache(
+    GBinderIpc* self,
+    int size,
+    int timeout_ms)
+{
+    GBinderIpcPriv* priv = self->priv;
+
+    /* Must be done before any remote objects get received */
+    priv->remote_cache_size = MAX(size, 0);
+    priv->remote_cache_timeout = (timeout_ms > 0) ? timeout_ms :
+        GBINDER_IPC_REMOTE_CACHE_TIMEOUT_MS;
+}
+
+void
+gbinder_ipc_set_memory_cache(
+    GBinderIpc* self,
+    int size)
+{
+    gbinder_memory_cache_set_max_idle(self->priv->memory_cache,
+        MAX(size, 0));
+}
+
+/*
+ * Placement and scheduling of the looper threads and the threads running
+ * the asynchronous transactions. Loopers pick the changes up when they
+ * get started, the pooled threads before running the next transaction.
+ * Stack size only applies to the loopers, GThreadPool doesn't allow to
+ * change it.
+ */
+gboolean
+gbinder_ipc_set_thread_cpus(
+    GBinderIpc* self,
+    GBINDER_IPC_THREADS threads,
+    const char* cpus)
+{
+    return ((guint)threads < GBINDER_IPC_THREADS_COUNT) &&
+        gbinder_thread_config_set_cpus(self->priv->thread_config + threads,
+            cpus);
+}
+
+gboolean
+gbinder_ipc_set_thread_sched(
+    GBinderIpc* self,
+    GBINDER_IPC_THREADS threads,
+    int policy,
+    int priority)
+{
+    return ((guint)threads < GBINDER_IPC_THREADS_COUNT) &&
+        gbinder_thread_config_set_sched(self->priv->thread_config + threads,
+            policy, priority);
+}
+
+void
+gbinder_ipc_set_looper_stack_size(
+    GBinderIpc* self,
+    gsize size)
+{
+    gbinder_thread_config_set_stack_size(self->priv->thread_config +
+        GBINDER_IPC_THREADS_LOOPER, size);
+}
+
+/*
+ * Callbacks associated with this GBinderIpc (incoming transactions,
+ * completion of asynchronous calls, death notifications and such) are
+ * dispatched in the given context. That only works with the default
+ * GLib event loop integration and must be done before the GBinderIpc
+ * gets used for anything.
+ */
+void
+gbinder_ipc_set_main_context(
+    GBinderIpc* self,
+    GMainContext* context)
+{
+    GBinderIpcPriv* priv = self->priv;
+
+    if (priv->context != context) {
+        if (priv->context) {
+            g_main_context_unref(priv->context);
+        }
+        priv->context = context ? g_main_context_ref(context) : NULL;
+    }
+}
+
+GMainContext*
+gbinder_ipc_main_context(
+    GBinderIpc* self)
+{
+    return G_LIKELY(self) ? self->priv->context : NULL;
+}
+
+/*
+ * Non-cancellable callback invoked on the main thread. Unlike
+ * gbinder_idle_callback_invoke_later_in(), it doesn't allocate a new
+ * callback (and GSource) for each call. The calls are queued in the
+ * order of submission and picked up by the same wakeup which handles
+ * the incoming transactions. The queue entries are recycled.
+ */
+void
+gbinder_ipc_invoke_later(
+    GBinderIpc* self,
+    GBinderEventLoopCallbackFunc func,
+    gpointer data,
+    GDestroyNotify destroy)
+{
+    GBinderIpcPriv* priv = self->priv;
+    GBinderIpcCall* call;
+    GBinderIpcCall* head;
+
+    g_mutex_lock(&priv->pool_mutex);
+    call = priv->call_pool;
+    if (call) {
+        priv->call_pool = call->next;
+        priv->call_pool_size--;
+    }
+    g_mutex_unlock(&priv->pool_mutex);
+    if (!call) {
+        call = g_slice_new(GBinderIpcCall);
+    }
+
+    call->func = func;
+    call->data = data;
+    call->destroy = destroy;
+    do {
+        head = g_atomic_pointer_get(&priv->call_inbox);
+        call->next = head;
+    } while (!g_atomic_pointer_compare_and_exchange
+        (&priv->call_inbox, head, call));
+    gbinder_ipc_dispatch_schedule(priv);
+}
+
+/*
+ * The kernel suspects that this process is flooding somebody with oneway
+ * transactions. The handler is invoked on the main thread.
+ */
+gulong
+gbinder_ipc_add_oneway_spam_handler(
+    GBinderIpc* self,
+    GBinderIpcFunc func,
+    void* user_data)
+{
+    return (G_LIKELY(self) && G_LIKELY(func)) ? g_signal_connect(self,
+        SIGNAL_ONEWAY_SPAM_NAME, G_CALLBACK(func), user_data) : 0;
+}
+
+void
+gbinder_ipc_remove_handler(
+    GBinderIpc* self,
+    gulong id)
+{
+    if (G_LIKELY(self) && G_LIKELY(id)) {
+        g_signal_handler_disconnect(self, id);
+    }
+}
+
+gboolean
+gbinder_ipc_kernel_stats(
+    const char* dev,
+    GBinderStatsKernel* stats)
+{
+    GSList* list = NULL;
+    GSList* l;
+
+    /* Lock */
+    g_rw_lock_reader_lock(&gbinder_ipc_table_lock);
+    if (gbinder_ipc_table) {
+        GHashTableIter it;
+        gpointer value;
+
+        /*
+         * Each protocol has its own instance with its own fd, i.e. its own
+         * section in the kernel stats. The caller sums those up, and so do
+         * we (matching the section to the fd isn't possible, there's no fd
+         * in the stats).
+         */
+        g_hash_table_iter_init(&it, gbinder_ipc_table);
+        while (g_hash_table_iter_next(&it, NULL, &value)) {
+            if (!g_strcmp0(THIS(value)->dev, dev)) {
+                list = g_slist_prepend(list, gbinder_ipc_ref(THIS(value)));
+            }
+        }
+    }
+    g_rw_lock_reader_unlock(&gbinder_ipc_table_lock);
+    /* Unlock */
+
+    stats->loopers = 0;
+    stats->blocked_loopers = 0;
+    stats->mapped_bytes = 0;
+    stats->pinned_bytes = 0;
+    for (l = list; l; l = l->next) {
+        GBinderIpc* self = l->data;
+        GBinderIpcPriv* priv = self->priv;
+        GBinderIpcLooper* looper;
+
+        /* Lock */
+        gbinder_ipc_looper_lock(priv);
+        for (looper = priv->blocked_loopers; looper; looper = looper->next) {
+            stats->blocked_loopers++;
+        }
+        stats->loopers += priv->primary_count;
+        g_mutex_unlock(&priv->looper_mutex);
+        /* Unlock */
+
+        stats->mapped_bytes += gbinder_driver_vm_size(self->driver);
+        stats->pinned_bytes += gbinder_driver_pinned_size(self->driver);
+    }
+    if (list) {
+        g_slist_free_full(list, (GDestroyNotify) gbinder_ipc_unref);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+guint
+gbinder_ipc_looper_count(
+    GBinderIpc* self)
+{
+    /* Only used by unit tests */
+    return g_atomic_int_get(&self->priv->primary_count);
 }
 
 /*==========================================================================*
@@ -2053,52 +5390,111 @@ gbinder_ipc_init(
         .ref = gbinder_ipc_object_registry_ref,
         .unref = gbinder_ipc_object_registry_unref,
         .get_local = gbinder_ipc_object_registry_get_local,
-        .get_remote = gbinder_ipc_object_registry_get_remote
+        .get_remote = gbinder_ipc_object_registry_get_remote,
+        .intern_iface = gbinder_ipc_object_registry_intern_iface,
+        .map_memory = gbinder_ipc_object_registry_map_memory
     };
     GBinderIpcPriv* priv = G_TYPE_INSTANCE_GET_PRIVATE(self, THIS_TYPE,
         GBinderIpcPriv);
+    guint i;
 
     g_mutex_init(&priv->looper_mutex);
-    g_mutex_init(&priv->local_objects_mutex);
-    g_mutex_init(&priv->remote_objects_mutex);
+    g_mutex_init(&priv->iface_mutex);
+    g_mutex_init(&priv->pool_mutex);
+    for (i = 0; i < GBINDER_IPC_DISPATCH_QUEUES; i++) {
+        g_queue_init(priv->dispatch_queue + i);
+    }
+    for (i = 0; i < GBINDER_IPC_REGISTRY_SHARDS; i++) {
+        g_mutex_init(&priv->local_objects[i].mutex);
+        g_mutex_init(&priv->remote_objects[i].mutex);
+        priv->local_objects[i].probe = GBINDER_STATS_PROBE_LOCAL_LOCK;
+        priv->remote_objects[i].probe = GBINDER_STATS_PROBE_REMOTE_LOCK;
+    }
+    priv->ifaces = g_hash_table_new_full(gbinder_ipc_iface_hash,
+        gbinder_ipc_iface_equal, gbinder_ipc_iface_free, NULL);
     priv->tx_table = g_hash_table_new(g_direct_hash, g_direct_equal);
-    priv->tx_pool = g_thread_pool_new(gbinder_ipc_tx_proc, self,
-        GBINDER_IPC_MAX_TX_THREADS, FALSE, NULL);
+    g_queue_init(&priv->tx_queue);
+    priv->tx_quota = GBINDER_IPC_MAX_TX_THREADS;
+    priv->min_loopers = GBINDER_IPC_MIN_PRIMARY_LOOPERS;
+    priv->max_loopers = GBINDER_IPC_MAX_PRIMARY_LOOPERS;
+    priv->looper_idle_timeout = GBINDER_IPC_LOOPER_IDLE_TIMEOUT_MS;
+    g_mutex_init(&priv->remote_cache_mutex);
+    g_queue_init(&priv->remote_cache);
+    priv->remote_cache_map = g_hash_table_new(g_direct_hash, g_direct_equal);
+    priv->remote_cache_timeout = GBINDER_IPC_REMOTE_CACHE_TIMEOUT_MS;
+    priv->memory_cache = gbinder_memory_cache_new(0);
+    for (i = 0; i < GBINDER_IPC_THREADS_COUNT; i++) {
+        gbinder_thread_config_init(priv->thread_config + i);
+    }
     priv->object_registry.f = &object_registry_functions;
     priv->self = self;
     self->priv = priv;
 }
 
+/*
+ * Signals all the loopers at once and returns them in a single list,
+ * which gets appended to the one passed in. The pipe wakes up the
+ * loopers sitting in poll(). The blocking ones are kicked out of the
+ * driver by flushing the binder fd, one flush per device wakes them all.
+ */
 static
-void
-gbinder_ipc_stop_loopers(
-    GBinderIpc* self)
+GBinderIpcLooper*
+gbinder_ipc_signal_loopers(
+    GBinderIpc* self,
+    GBinderIpcLooper* loopers)
 {
     GBinderIpcPriv* priv = self->priv;
-    GBinderIpcLooper* loopers = NULL;
+    GBinderIpcLooper* list;
 
-    do {
-        GBinderIpcLooper* tmp;
+    /* Lock */
+    gbinder_ipc_looper_lock(priv);
+    list = gbinder_ipc_looper_stop_all(gbinder_ipc_looper_stop_all(loopers,
+        priv->primary_loopers), priv->blocked_loopers);
+    priv->blocked_loopers = NULL;
+    priv->primary_loopers = NULL;
+    g_atomic_int_set(&priv->primary_count, 0);
+    g_mutex_unlock(&priv->looper_mutex);
+    /* Unlock */
 
-        /* Lock */
-        g_mutex_lock(&priv->looper_mutex);
-        loopers = gbinder_ipc_looper_stop_all(gbinder_ipc_looper_stop_all(NULL,
-            priv->primary_loopers), priv->blocked_loopers);
-        priv->blocked_loopers = NULL;
-        priv->primary_loopers = NULL;
-        g_mutex_unlock(&priv->looper_mutex);
-        /* Unlock */
+    if (list != loopers && priv->blocking) {
+        gbinder_driver_kick(self->driver);
+    }
+    return list;
+}
 
-        tmp = loopers;
-        while (tmp) {
-            GBinderIpcLooper* looper = tmp;
+/*
+ * All the loopers share the same deadline, so the total time is
+ * bounded by the slowest one rather than the sum of them.
+ */
+static
+void
+gbinder_ipc_join_loopers(
+    GBinderIpcLooper* loopers,
+    const struct timespec* deadline)
+{
+    while (loopers) {
+        GBinderIpcLooper* looper = loopers;
 
-            tmp = looper->next;
-            looper->next = NULL;
-            gbinder_ipc_looper_join(looper);
-            gbinder_ipc_looper_unref(looper);
-        }
-    } while (loopers);
+        loopers = looper->next;
+        looper->next = NULL;
+        gbinder_ipc_looper_join(looper, deadline);
+        gbinder_ipc_looper_unref(looper);
+    }
+}
+
+static
+void
+gbinder_ipc_stop_loopers(
+    GBinderIpc* self)
+{
+    GBinderIpcLooper* loopers;
+    struct timespec deadline;
+
+    gbinder_ipc_looper_join_deadline(&deadline);
+    while ((loopers = gbinder_ipc_signal_loopers(self, NULL)) != NULL) {
+        /* New loopers may have been started in the meantime */
+        gbinder_ipc_join_loopers(loopers, &deadline);
+    }
 }
 
 static
@@ -2110,25 +5506,31 @@ gbinder_ipc_dispose(
 
     GVERBOSE_("%s", self->dev);
     /* Lock */
-    pthread_mutex_lock(&gbinder_ipc_mutex);
+    g_rw_lock_writer_lock(&gbinder_ipc_table_lock);
     /*
      * gbinder_ipc_dispose() can be invoked more than once (typically
      * at shutdown) and gbinder_ipc_table here may actually happen to
-     * be NULL, hence the check.
+     * be NULL or even contain a newer instance, hence the checks.
      */
     if (gbinder_ipc_table) {
         GBinderIpcPriv* priv = self->priv;
 
-        GASSERT(g_hash_table_lookup(gbinder_ipc_table, priv->key) == self);
-        g_hash_table_remove(gbinder_ipc_table, priv->key);
-        if (g_hash_table_size(gbinder_ipc_table) == 0) {
-            g_hash_table_unref(gbinder_ipc_table);
-            gbinder_ipc_table = NULL;
+        if (g_hash_table_lookup(gbinder_ipc_table, priv->key) == self) {
+            g_hash_table_remove(gbinder_ipc_table, priv->key);
+            if (g_hash_table_size(gbinder_ipc_table) == 0) {
+                g_hash_table_unref(gbinder_ipc_table);
+                gbinder_ipc_table = NULL;
+            }
         }
     }
-    pthread_mutex_unlock(&gbinder_ipc_mutex);
+    g_rw_lock_writer_unlock(&gbinder_ipc_table_lock);
     /* Unlock */
 
+    if (self->priv->tune.timer) {
+        gbinder_timeout_remove(self->priv->tune.timer);
+        self->priv->tune.timer = NULL;
+    }
+    gbinder_ipc_idle_looper_detach(self);
     gbinder_ipc_stop_loopers(self);
     G_OBJECT_CLASS(PARENT_CLASS)->dispose(object);
 }
@@ -2140,17 +5542,56 @@ gbinder_ipc_finalize(
 {
     GBinderIpc* self = THIS(object);
     GBinderIpcPriv* priv = self->priv;
+    guint i;
 
-    GASSERT(!priv->local_objects);
-    GASSERT(!priv->remote_objects);
+    if (priv->context) {
+        g_main_context_unref(priv->context);
+    }
+    /* Pending dispatch callback holds a reference to GBinderIpc */
+    GASSERT(!priv->dispatch_inbox);
+    GASSERT(!priv->call_inbox);
+    while (priv->looper_tx_pool) {
+        GBinderIpcLooperTx* tx = priv->looper_tx_pool;
+
+        priv->looper_tx_pool = tx->next;
+        gbinder_ipc_looper_tx_destroy(tx);
+    }
+    while (priv->call_pool) {
+        GBinderIpcCall* call = priv->call_pool;
+
+        priv->call_pool = call->next;
+        g_slice_free(GBinderIpcCall, call);
+    }
+    g_mutex_clear(&priv->pool_mutex);
+    GASSERT(!gbinder_ipc_dispatch_pending(priv));
+    /* Cached remote objects hold references to GBinderIpc */
+    GASSERT(!priv->remote_cache.length);
+    GASSERT(!priv->remote_cache_timer);
+    GASSERT(!priv->idle_watch);
+    g_hash_table_destroy(priv->remote_cache_map);
+    g_mutex_clear(&priv->remote_cache_mutex);
+    for (i = 0; i < GBINDER_IPC_THREADS_COUNT; i++) {
+        gbinder_thread_config_clear(priv->thread_config + i);
+    }
     g_mutex_clear(&priv->looper_mutex);
-    g_mutex_clear(&priv->local_objects_mutex);
-    g_mutex_clear(&priv->remote_objects_mutex);
+    g_mutex_clear(&priv->iface_mutex);
+    g_hash_table_destroy(priv->ifaces);
+    /* Mapped memory may outlive GBinderIpc */
+    gbinder_memory_cache_unref(priv->memory_cache);
+    for (i = 0; i < GBINDER_IPC_REGISTRY_SHARDS; i++) {
+        GASSERT(!priv->local_objects[i].table);
+        GASSERT(!priv->remote_objects[i].table);
+        g_mutex_clear(&priv->local_objects[i].mutex);
+        g_mutex_clear(&priv->remote_objects[i].mutex);
+    }
     if (priv->tx_pool) {
         g_thread_pool_free(priv->tx_pool, FALSE, TRUE);
     }
+    GASSERT(!priv->tx_queue.length);
+    GASSERT(!priv->tx_running);
     GASSERT(!g_hash_table_size(priv->tx_table));
     g_hash_table_unref(priv->tx_table);
+    gbinder_driver_set_oneway_spam_handler(self->driver, NULL, NULL);
     gbinder_driver_unref(self->driver);
     g_free((char*)self->dev);
     g_free(priv->key);
@@ -2167,6 +5608,10 @@ gbinder_ipc_class_init(
     g_type_class_add_private(klass, sizeof(GBinderIpcPriv));
     object_class->dispose = gbinder_ipc_dispose;
     object_class->finalize = gbinder_ipc_finalize;
+
+    gbinder_ipc_signals[SIGNAL_ONEWAY_SPAM] =
+        g_signal_new(SIGNAL_ONEWAY_SPAM_NAME, G_OBJECT_CLASS_TYPE(klass),
+            G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL, G_TYPE_NONE, 0);
 }
 
 /* Runs at exit */
@@ -2179,32 +5624,49 @@ gbinder_ipc_exit()
     GSList* i;
 
     /* Lock */
-    pthread_mutex_lock(&gbinder_ipc_mutex);
+    g_rw_lock_reader_lock(&gbinder_ipc_table_lock);
     if (gbinder_ipc_table) {
         g_hash_table_iter_init(&it, gbinder_ipc_table);
         while (g_hash_table_iter_next(&it, NULL, &value)) {
             ipcs = g_slist_append(ipcs, gbinder_ipc_ref(value));
         }
     }
-    pthread_mutex_unlock(&gbinder_ipc_mutex);
+    g_rw_lock_reader_unlock(&gbinder_ipc_table_lock);
     /* Unlock */
 
+    /* Shut down the loopers of all devices in parallel */
+    if (ipcs) {
+        GBinderIpcLooper* loopers = NULL;
+        struct timespec deadline;
+
+        gbinder_ipc_looper_join_deadline(&deadline);
+        for (i = ipcs; i; i = i->next) {
+            GBinderIpc* ipc = THIS(i->data);
+
+            gbinder_ipc_idle_looper_detach(ipc);
+            loopers = gbinder_ipc_signal_loopers(ipc, loopers);
+        }
+        gbinder_ipc_join_loopers(loopers, &deadline);
+    }
+
     for (i = ipcs; i; i = i->next) {
         GBinderIpc* ipc = THIS(i->data);
         GBinderIpcPriv* priv = ipc->priv;
-        GThreadPool* pool = priv->tx_pool;
         GSList* local_objs = NULL;
         GSList* tx_keys = NULL;
         GSList* k;
         GSList* l;
+        guint n;
 
-        /* Terminate looper threads */
+        /* Terminate the loopers started since then, if any */
         GVERBOSE_("%s", ipc->dev);
         gbinder_ipc_stop_loopers(ipc);
 
+        /* Release the cached remote objects */
+        gbinder_ipc_remote_cache_clear(ipc);
+
         /* Make sure pooled transaction complete too */
-        priv->tx_pool = NULL;
-        g_thread_pool_free(pool, FALSE, TRUE);
+        gbinder_ipc_tx_pool_drain(priv);
 
         /*
          * Since this function is supposed to be invoked on the main thread,
@@ -2226,17 +5688,21 @@ gbinder_ipc_exit()
         GASSERT(!g_hash_table_size(priv->tx_table));
         g_slist_free(tx_keys);
 
-        /* Lock */
-        g_mutex_lock(&priv->local_objects_mutex);
-        if (priv->local_objects) {
-            g_hash_table_iter_init(&it, priv->local_objects);
-            while (g_hash_table_iter_next(&it, NULL, &value)) {
-                local_objs = g_slist_append(local_objs,
-                    gbinder_local_object_ref(value));
+        for (n = 0; n < GBINDER_IPC_REGISTRY_SHARDS; n++) {
+            GBinderIpcRegistryShard* shard = priv->local_objects + n;
+
+            /* Lock */
+            gbinder_ipc_shard_lock(shard);
+            if (shard->table) {
+                g_hash_table_iter_init(&it, shard->table);
+                while (g_hash_table_iter_next(&it, NULL, &value)) {
+                    local_objs = g_slist_append(local_objs,
+                        gbinder_local_object_ref(value));
+                }
             }
+            g_mutex_unlock(&shard->mutex);
+            /* Unlock */
         }
-        g_mutex_unlock(&priv->local_objects_mutex);
-        /* Unlock */
 
         /* Drop remote references */
         for (l = local_objs; l; l = l->next) {
@@ -2246,6 +5712,7 @@ gbinder_ipc_exit()
                 obj->strong_refs--;
                 gbinder_local_object_unref(obj);
             }
+            gbinder_local_object_unpin(obj);
         }
         g_slist_free_full(local_objs, g_object_unref);
     }
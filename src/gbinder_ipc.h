@@ -34,6 +34,8 @@
 #define GBINDER_IPC_H
 
 #include "gbinder_types_p.h"
+#include "gbinder_eventloop.h"
+#include "gbinder_stats.h"
 
 #include <glib-object.h>
 
@@ -47,6 +49,12 @@ struct gbinder_ipc {
 
 typedef struct gbinder_ipc_tx GBinderIpcTx;
 
+typedef
+void
+(*GBinderIpcFunc)(
+    GBinderIpc* ipc,
+    void* user_data);
+
 typedef
 void
 (*GBinderIpcTxFunc)(
@@ -59,6 +67,13 @@ struct gbinder_ipc_tx {
     void* user_data;
 };
 
+/* Threads created by GBinderIpc */
+typedef enum gbinder_ipc_threads {
+    GBINDER_IPC_THREADS_LOOPER,
+    GBINDER_IPC_THREADS_TX,
+    GBINDER_IPC_THREADS_COUNT
+} GBINDER_IPC_THREADS;
+
 typedef
 gboolean
 (*GBinderIpcLocalObjectCheckFunc)(
@@ -165,6 +180,18 @@ gbinder_ipc_invalidate_remote_handle(
     guint32 handle)
     GBINDER_INTERNAL;
 
+void
+gbinder_ipc_invalidate_remote_handles(
+    GBinderIpc* ipc,
+    const guint32* handles,
+    guint count)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_remote_cache_drop_dead(
+    GBinderIpc* ipc)
+    GBINDER_INTERNAL;
+
 int
 gbinder_ipc_ping_sync(
     GBinderIpc* ipc,
@@ -172,6 +199,59 @@ gbinder_ipc_ping_sync(
     const GBinderIpcSyncApi* api)
     GBINDER_INTERNAL;
 
+/* Results are GBINDER_PING_RESULT values, one per object */
+typedef
+void
+(*GBinderIpcPingFunc)(
+    GBinderIpc* ipc,
+    const guint8* results,
+    guint count,
+    void* user_data);
+
+/*
+ * Pings the objects concurrently on the worker threads, completes when
+ * all of them have responded or after timeout_ms (0 means no timeout).
+ * Can be cancelled with gbinder_ipc_cancel(), the destroy notification
+ * is invoked either way.
+ */
+gulong
+gbinder_ipc_ping_many(
+    GBinderIpc* ipc,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    guint timeout_ms,
+    GBinderIpcPingFunc func,
+    GDestroyNotify destroy,
+    void* user_data)
+    GBINDER_INTERNAL;
+
+/* Status is the one-way transaction status, one per object */
+typedef
+void
+(*GBinderIpcBroadcastFunc)(
+    GBinderIpc* ipc,
+    const int* status,
+    guint count,
+    void* user_data);
+
+/*
+ * Sends the same request one-way to all the objects, concurrently on
+ * the worker threads. Completes when all of them have been sent. Can be
+ * cancelled with gbinder_ipc_cancel(), the destroy notification is
+ * invoked either way.
+ */
+gulong
+gbinder_ipc_broadcast(
+    GBinderIpc* ipc,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    guint32 code,
+    GBinderLocalRequest* req,
+    GBinderIpcBroadcastFunc func,
+    GDestroyNotify destroy,
+    void* user_data)
+    GBINDER_INTERNAL;
+
 gulong
 gbinder_ipc_transact(
     GBinderIpc* ipc,
@@ -184,6 +264,55 @@ gbinder_ipc_transact(
     void* user_data)
     GBINDER_INTERNAL;
 
+gulong
+gbinder_ipc_transact_deferred(
+    GBinderIpc* ipc,
+    guint32 handle,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    GBinderIpcReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_transact_start(
+    GBinderIpc* ipc,
+    gulong id)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_transact_set_timeout(
+    GBinderIpc* ipc,
+    gulong id,
+    guint timeout_ms)
+    GBINDER_INTERNAL;
+
+/* Transactions with the local objects living in this process */
+GBinderRemoteReply*
+gbinder_ipc_transact_local_sync(
+    GBinderIpc* ipc,
+    GBinderLocalObject* obj,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    int* status,
+    const GBinderIpcSyncApi* api)
+    GBINDER_INTERNAL;
+
+gulong
+gbinder_ipc_transact_local(
+    GBinderIpc* ipc,
+    GBinderLocalObject* obj,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    GBinderIpcReplyFunc reply,
+    GDestroyNotify destroy,
+    void* user_data)
+    GBINDER_INTERNAL;
+
 gulong
 gbinder_ipc_transact_custom(
     GBinderIpc* ipc,
@@ -199,6 +328,12 @@ gbinder_ipc_cancel(
     gulong id)
     GBINDER_INTERNAL;
 
+/* Id which doesn't clash with the ones of the transactions */
+gulong
+gbinder_ipc_new_id(
+    GBinderIpc* ipc)
+    GBINDER_INTERNAL;
+
 /* Internal for GBinderLocalObject */
 void
 gbinder_ipc_local_object_disposed(
@@ -226,6 +361,110 @@ gbinder_ipc_set_max_threads(
     gint max_threads)
     GBINDER_INTERNAL;
 
+void
+gbinder_ipc_set_looper_limits(
+    GBinderIpc* ipc,
+    int min_loopers,
+    int max_loopers)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_set_looper_idle_timeout(
+    GBinderIpc* ipc,
+    int timeout_ms)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_set_remote_cache(
+    GBinderIpc* ipc,
+    int size,
+    int timeout_ms)
+    GBINDER_INTERNAL;
+
+/* Maximum number of idle shared memory mappings kept around */
+void
+gbinder_ipc_set_memory_cache(
+    GBinderIpc* ipc,
+    int size)
+    GBINDER_INTERNAL;
+
+gboolean
+gbinder_ipc_set_thread_cpus(
+    GBinderIpc* ipc,
+    GBINDER_IPC_THREADS threads,
+    const char* cpus)
+    GBINDER_INTERNAL;
+
+gboolean
+gbinder_ipc_set_thread_sched(
+    GBinderIpc* ipc,
+    GBINDER_IPC_THREADS threads,
+    int policy,
+    int priority)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_set_looper_stack_size(
+    GBinderIpc* ipc,
+    gsize size)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_set_main_context(
+    GBinderIpc* ipc,
+    GMainContext* context)
+    GBINDER_INTERNAL;
+
+GMainContext*
+gbinder_ipc_main_context(
+    GBinderIpc* ipc)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_invoke_later(
+    GBinderIpc* ipc,
+    GBinderEventLoopCallbackFunc func,
+    gpointer data,
+    GDestroyNotify destroy)
+    GBINDER_INTERNAL;
+
+gulong
+gbinder_ipc_add_oneway_spam_handler(
+    GBinderIpc* ipc,
+    GBinderIpcFunc func,
+    void* user_data)
+    GBINDER_INTERNAL;
+
+void
+gbinder_ipc_remove_handler(
+    GBinderIpc* ipc,
+    gulong id)
+    GBINDER_INTERNAL;
+
+/* Fills in the libgbinder part (all instances), FALSE if not open */
+gboolean
+gbinder_ipc_kernel_stats(
+    const char* dev,
+    GBinderStatsKernel* stats)
+    GBINDER_INTERNAL;
+
+guint
+gbinder_ipc_looper_count(
+    GBinderIpc* ipc)
+    GBINDER_INTERNAL;
+
+/* Zero unless Autotune has come up with something */
+gsize
+gbinder_ipc_reply_size_hint(
+    GBinderIpc* ipc)
+    GBINDER_INTERNAL;
+
+/* One tick of Autotune, invoked by the timer (and unit tests) */
+void
+gbinder_ipc_tune(
+    GBinderIpc* ipc)
+    GBINDER_INTERNAL;
+
 /* Declared for unit tests */
 void
 gbinder_ipc_exit(
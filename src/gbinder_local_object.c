@@ -35,22 +35,98 @@
 #include "gbinder_driver.h"
 #include "gbinder_ipc.h"
 #include "gbinder_buffer_p.h"
+#include "gbinder_fmq_p.h"
 #include "gbinder_local_object_p.h"
 #include "gbinder_local_reply_p.h"
-#include "gbinder_remote_request.h"
-#include "gbinder_eventloop_p.h"
+#include "gbinder_object_registry.h"
+#include "gbinder_output_data.h"
+#include "gbinder_reader_p.h"
+#include "gbinder_remote_object_p.h"
+#include "gbinder_remote_request_p.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_writer.h"
 #include "gbinder_log.h"
 
+#include <gutil_intarray.h>
 #include <gutil_strv.h>
 #include <gutil_macros.h>
 
+#include <sched.h>
 #include <errno.h>
 
+#ifndef SCHED_BATCH
+#  define SCHED_BATCH 3
+#endif
+
+typedef enum gbinder_local_object_reply {
+    GBINDER_LOCAL_OBJECT_REPLY_STATUS_OK,
+    GBINDER_LOCAL_OBJECT_REPLY_INTERFACE,
+    GBINDER_LOCAL_OBJECT_REPLY_HIDL_DESCRIPTOR,
+    GBINDER_LOCAL_OBJECT_REPLY_HIDL_DESCRIPTOR_CHAIN,
+    GBINDER_LOCAL_OBJECT_REPLY_EMPTY,
+    GBINDER_LOCAL_OBJECT_REPLY_COUNT
+} GBINDER_LOCAL_OBJECT_REPLY;
+
+typedef struct gbinder_local_object_method GBinderLocalObjectMethod;
+
+typedef struct gbinder_local_object_fmq_channel {
+    GBinderLocalObject* object; /* Not a reference */
+    GBinderFmq* fmq;
+    GBinderRemoteObject* token; /* Dies together with the writer */
+    gulong watch_id;
+    gulong death_id;
+    gboolean dead;
+    pid_t pid;
+    uid_t euid;
+} GBinderLocalObjectFmqChannel;
+
+#define GBINDER_LOCAL_OBJECT_MAX_CHUNKED (16)
+
+typedef struct gbinder_local_object_chunked {
+    gint64 key; /* Must be first, sender pid and transfer id */
+    guint32 code;
+    guint32 total;
+    gsize chunk;
+    GByteArray* in; /* NULL once the request has been handled */
+    GBinderLocalReply* out;
+    gint64 last_used;
+} GBinderLocalObjectChunked;
+
+struct gbinder_local_object_method {
+    GBinderLocalObjectMethod* next; /* Same code, another interface */
+    char* iface;
+    const char* interned; /* NULL if the name couldn't be interned */
+    guint32 flags;
+    GBinderLocalTransactFunc handler;
+};
+
 struct gbinder_local_object_priv {
     char** ifaces;
     GBinderLocalTransactFunc txproc;
     void* user_data;
+    gint looper_dispatch;
+    gint serial_dispatch;
+    GMutex strand_mutex;
+    GQueue strand; /* Protected by strand_mutex */
+    gboolean strand_busy; /* Protected by strand_mutex */
+    GHashTable* methods; /* code => GBinderLocalObjectMethod */
+    GHashTable* priorities; /* code => GBINDER_LOCAL_PRIORITY + 1 */
+    gint priority;
+    GBinderLocalObjectSched* sched;
+    gint dropped;
+    GBinderLocalReply* replies[GBINDER_LOCAL_OBJECT_REPLY_COUNT];
+    gint weak_refs_delta;
+    gint weak_refs_scheduled;
+    gint fmq_accept;
+    guint32 fmq_code;
+    GSList* fmq_channels; /* GBinderLocalObjectFmqChannel, main thread */
+    gboolean fmq_draining; /* Handlers may call back into the object */
+    gint chunk_accept;
+    guint32 chunk_code;
+    gsize chunk_max_size;
+    GHashTable* chunked; /* key => GBinderLocalObjectChunked, main thread */
+    gint pinned; /* Callback object, kept alive by the kernel references */
+    gint kernel_refs; /* Only counted for pinned objects, looper thread */
 };
 
 typedef struct gbinder_local_object_acquire_data {
@@ -89,6 +165,90 @@ static const char hidl_base_interface[] = "android.hidl.base@1.0::IBase";
  * Implementation
  *==========================================================================*/
 
+static
+void
+gbinder_local_object_method_free(
+    gpointer data)
+{
+    GBinderLocalObjectMethod* method = data;
+
+    while (method) {
+        GBinderLocalObjectMethod* next = method->next;
+
+        g_free(method->iface);
+        g_slice_free(GBinderLocalObjectMethod, method);
+        method = next;
+    }
+}
+
+static
+const char*
+gbinder_local_object_intern_iface(
+    GBinderLocalObject* self,
+    const char* iface)
+{
+    glong len = 0;
+    gunichar2* utf16 = g_utf8_to_utf16(iface, -1, NULL, &len, NULL);
+    const char* interned = NULL;
+
+    /* The same pointer is returned for the incoming RPC headers */
+    if (utf16) {
+        interned = gbinder_object_registry_intern_iface
+            (gbinder_ipc_object_registry(self->ipc), utf16, len);
+        g_free(utf16);
+    }
+    return interned;
+}
+
+static
+const GBinderLocalObjectMethod*
+gbinder_local_object_find_method(
+    GBinderLocalObject* self,
+    const char* iface,
+    guint code)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+
+    if (priv->methods && iface && !g_atomic_int_get(&priv->dropped)) {
+        const GBinderLocalObjectMethod* first = g_hash_table_lookup
+            (priv->methods, GUINT_TO_POINTER(code));
+        const GBinderLocalObjectMethod* method;
+
+        /* Pointer comparison is enough for interned names */
+        for (method = first; method; method = method->next) {
+            if (method->interned == iface) {
+                return method;
+            }
+        }
+        for (method = first; method; method = method->next) {
+            if (!g_strcmp0(method->iface, iface)) {
+                return method;
+            }
+        }
+    }
+    return NULL;
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_method_invoke(
+    GBinderLocalObject* self,
+    const GBinderLocalObjectMethod* method,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status)
+{
+    if ((method->flags & GBINDER_LOCAL_METHOD_FLAG_ONEWAY) &&
+        !(flags & GBINDER_TX_FLAG_ONEWAY)) {
+        GWARN("Two-way call to one-way method %s 0x%08x", method->iface, code);
+        if (status) *status = (-EBADMSG);
+        return NULL;
+    }
+    return method->handler(self, req, code, flags, status,
+        self->priv->user_data);
+}
+
 static
 GBINDER_LOCAL_TRANSACTION_SUPPORT
 gbinder_local_object_default_can_handle_transaction(
@@ -96,6 +256,8 @@ gbinder_local_object_default_can_handle_transaction(
     const char* iface,
     guint code)
 {
+    const GBinderLocalObjectMethod* method;
+
     switch (code) {
     case GBINDER_PING_TRANSACTION:
     case GBINDER_INTERFACE_TRANSACTION:
@@ -108,6 +270,12 @@ gbinder_local_object_default_can_handle_transaction(
         }
         /* no break */
     default:
+        method = gbinder_local_object_find_method(self, iface, code);
+        if (method) {
+            return (method->flags & GBINDER_LOCAL_METHOD_FLAG_LOOPER) ?
+                GBINDER_LOCAL_TRANSACTION_LOOPER :
+                GBINDER_LOCAL_TRANSACTION_SUPPORTED;
+        }
         return self->priv->txproc ? GBINDER_LOCAL_TRANSACTION_SUPPORTED :
             GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED;
     }
@@ -123,8 +291,13 @@ gbinder_local_object_default_handle_transaction(
     int* status)
 {
     GBinderLocalObjectPriv* priv = self->priv;
+    const GBinderLocalObjectMethod* method = gbinder_local_object_find_method
+        (self, gbinder_remote_request_interface(req), code);
 
-    if (priv->txproc) {
+    if (method) {
+        return gbinder_local_object_method_invoke(self, method, req, code,
+            flags, status);
+    } else if (priv->txproc) {
         return priv->txproc(self, req, code, flags, status, priv->user_data);
     } else {
         if (status) *status = (-EBADMSG);
@@ -132,6 +305,90 @@ gbinder_local_object_default_handle_transaction(
     }
 }
 
+static
+GBinderLocalReply*
+gbinder_local_object_status_ok_reply(
+    GBinderLocalObject* self)
+{
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(self);
+
+    gbinder_local_reply_append_int32(reply, GBINDER_STATUS_OK);
+    return reply;
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_interface_reply(
+    GBinderLocalObject* self)
+{
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(self);
+
+    gbinder_local_reply_append_string16(reply, self->priv->ifaces[0]);
+    return reply;
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_hidl_descriptor_reply(
+    GBinderLocalObject* self)
+{
+    /*android.hidl.base@1.0::IBase interfaceDescriptor() */
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(self);
+    GBinderWriter writer;
+
+    gbinder_local_reply_init_writer(reply, &writer);
+    gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
+    gbinder_writer_append_hidl_string(&writer, self->priv->ifaces[0]);
+    return reply;
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_hidl_descriptor_chain_reply(
+    GBinderLocalObject* self)
+{
+    /*android.hidl.base@1.0::IBase interfaceChain() */
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(self);
+    GBinderWriter writer;
+
+    gbinder_local_reply_init_writer(reply, &writer);
+    gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
+    gbinder_writer_append_hidl_string_vec(&writer, (const char**)
+        self->ifaces, -1);
+    return reply;
+}
+
+/*
+ * Replies to the built-in transactions never change, they are built
+ * once and then the same reply is sent again and again. Several looper
+ * threads may race to build the same reply, only one of them wins.
+ */
+static
+GBinderLocalReply*
+gbinder_local_object_cached_reply(
+    GBinderLocalObject* self,
+    GBINDER_LOCAL_OBJECT_REPLY type,
+    GBinderLocalReply* (*build)(GBinderLocalObject* self),
+    int* status)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+    GBinderLocalReply* reply = g_atomic_pointer_get(priv->replies + type);
+
+    if (!reply) {
+        GBinderLocalReply* created = build(self);
+
+        if (g_atomic_pointer_compare_and_exchange(priv->replies + type,
+            NULL, created)) {
+            reply = created;
+        } else {
+            gbinder_local_reply_unref(created);
+            reply = g_atomic_pointer_get(priv->replies + type);
+        }
+    }
+    *status = GBINDER_STATUS_OK;
+    return gbinder_local_reply_ref(reply);
+}
+
 static
 GBinderLocalReply*
 gbinder_local_object_ping_transaction(
@@ -139,13 +396,10 @@ gbinder_local_object_ping_transaction(
     GBinderRemoteRequest* req,
     int* status)
 {
-    const GBinderIo* io = gbinder_local_object_io(self);
-    GBinderLocalReply* reply = gbinder_local_reply_new(io);
-
     GVERBOSE("  PING_TRANSACTION");
-    gbinder_local_reply_append_int32(reply, GBINDER_STATUS_OK);
-    *status = GBINDER_STATUS_OK;
-    return reply;
+    return gbinder_local_object_cached_reply(self,
+        GBINDER_LOCAL_OBJECT_REPLY_STATUS_OK,
+        gbinder_local_object_status_ok_reply, status);
 }
 
 static
@@ -155,14 +409,10 @@ gbinder_local_object_interface_transaction(
     GBinderRemoteRequest* req,
     int* status)
 {
-    const GBinderIo* io = gbinder_local_object_io(self);
-    GBinderLocalObjectPriv* priv = self->priv;
-    GBinderLocalReply* reply = gbinder_local_reply_new(io);
-
     GVERBOSE("  INTERFACE_TRANSACTION");
-    gbinder_local_reply_append_string16(reply, priv->ifaces[0]);
-    *status = GBINDER_STATUS_OK;
-    return reply;
+    return gbinder_local_object_cached_reply(self,
+        GBINDER_LOCAL_OBJECT_REPLY_INTERFACE,
+        gbinder_local_object_interface_reply, status);
 }
 
 static
@@ -172,15 +422,11 @@ gbinder_local_object_hidl_ping_transaction(
     GBinderRemoteRequest* req,
     int* status)
 {
-    /*android.hidl.base@1.0::IBase interfaceDescriptor() */
-    const GBinderIo* io = gbinder_local_object_io(self);
-    GBinderLocalReply* reply = gbinder_local_reply_new(io);
-
     GVERBOSE("  HIDL_PING_TRANSACTION \"%s\"",
         gbinder_remote_request_interface(req));
-    gbinder_local_reply_append_int32(reply, GBINDER_STATUS_OK);
-    *status = GBINDER_STATUS_OK;
-    return reply;
+    return gbinder_local_object_cached_reply(self,
+        GBINDER_LOCAL_OBJECT_REPLY_STATUS_OK,
+        gbinder_local_object_status_ok_reply, status);
 }
 
 static
@@ -190,19 +436,11 @@ gbinder_local_object_hidl_get_descriptor_transaction(
     GBinderRemoteRequest* req,
     int* status)
 {
-    /*android.hidl.base@1.0::IBase interfaceDescriptor() */
-    const GBinderIo* io = gbinder_local_object_io(self);
-    GBinderLocalObjectPriv* priv = self->priv;
-    GBinderLocalReply* reply = gbinder_local_reply_new(io);
-    GBinderWriter writer;
-
     GVERBOSE("  HIDL_GET_DESCRIPTOR_TRANSACTION \"%s\"",
         gbinder_remote_request_interface(req));
-    gbinder_local_reply_init_writer(reply, &writer);
-    gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
-    gbinder_writer_append_hidl_string(&writer, priv->ifaces[0]);
-    *status = GBINDER_STATUS_OK;
-    return reply;
+    return gbinder_local_object_cached_reply(self,
+        GBINDER_LOCAL_OBJECT_REPLY_HIDL_DESCRIPTOR,
+        gbinder_local_object_hidl_descriptor_reply, status);
 }
 
 static
@@ -212,20 +450,11 @@ gbinder_local_object_hidl_descriptor_chain_transaction(
     GBinderRemoteRequest* req,
     int* status)
 {
-    /*android.hidl.base@1.0::IBase interfaceChain() */
-    const GBinderIo* io = gbinder_local_object_io(self);
-    GBinderLocalReply* reply = gbinder_local_reply_new(io);
-    GBinderWriter writer;
-
     GVERBOSE("  HIDL_DESCRIPTOR_CHAIN_TRANSACTION \"%s\"",
         gbinder_remote_request_interface(req));
-
-    gbinder_local_reply_init_writer(reply, &writer);
-    gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
-    gbinder_writer_append_hidl_string_vec(&writer, (const char**)
-        self->ifaces, -1);
-    *status = GBINDER_STATUS_OK;
-    return reply;
+    return gbinder_local_object_cached_reply(self,
+        GBINDER_LOCAL_OBJECT_REPLY_HIDL_DESCRIPTOR_CHAIN,
+        gbinder_local_object_hidl_descriptor_chain_reply, status);
 }
 
 static
@@ -238,6 +467,20 @@ gbinder_local_object_default_handle_looper_transaction(
     int* status)
 {
     GBinderLocalObjectTxHandler handler = NULL;
+    const char* iface = gbinder_remote_request_interface(req);
+
+    /* Methods marked with GBINDER_LOCAL_METHOD_FLAG_LOOPER */
+    if (code != GBINDER_PING_TRANSACTION &&
+        code != GBINDER_INTERFACE_TRANSACTION &&
+        g_strcmp0(iface, hidl_base_interface)) {
+        const GBinderLocalObjectMethod* method =
+            gbinder_local_object_find_method(self, iface, code);
+
+        if (method) {
+            return gbinder_local_object_method_invoke(self, method, req,
+                code, flags, status);
+        }
+    }
 
     switch (code) {
     case GBINDER_PING_TRANSACTION:
@@ -271,7 +514,11 @@ gbinder_local_object_default_drop(
 {
     GBinderLocalObjectPriv* priv = self->priv;
 
-    /* Clear the transaction callback */
+    /*
+     * Clear the transaction callback. The method table may still be
+     * in use by the looper threads, it's freed by the finalizer.
+     */
+    g_atomic_int_set(&priv->dropped, TRUE);
     priv->txproc = NULL;
     priv->user_data = NULL;
 }
@@ -283,34 +530,60 @@ gbinder_local_object_handle_later(
     GBinderEventLoopCallbackFunc function)
 {
     if (G_LIKELY(self)) {
-        gbinder_idle_callback_invoke_later(function,
+        gbinder_ipc_invoke_later(self->ipc, function,
             gbinder_local_object_ref(self), g_object_unref);
     }
 }
 
 static
 void
-gbinder_local_object_increfs_proc(
+gbinder_local_object_weak_refs_proc(
     gpointer user_data)
 {
     GBinderLocalObject* self = GBINDER_LOCAL_OBJECT(user_data);
+    GBinderLocalObjectPriv* priv = self->priv;
+    gint delta, prev;
+
+    /* Changes made after this point will schedule another callback */
+    g_atomic_int_set(&priv->weak_refs_scheduled, FALSE);
+    delta = g_atomic_int_get(&priv->weak_refs_delta);
+    g_atomic_int_add(&priv->weak_refs_delta, -delta);
+    prev = g_atomic_int_add(&self->weak_refs, delta);
+    GASSERT(prev + delta >= 0);
 
-    self->weak_refs++;
-    g_signal_emit(self, gbinder_local_object_signals
-        [SIGNAL_WEAK_REFS_CHANGED], 0);
+    /* Only 0 => 1 and 1 => 0 transitions are reported */
+    if ((prev > 0) != (prev + delta > 0)) {
+        g_signal_emit(self, gbinder_local_object_signals
+            [SIGNAL_WEAK_REFS_CHANGED], 0);
+    }
 }
 
 static
 void
-gbinder_local_object_decrefs_proc(
-    gpointer user_data)
+gbinder_local_object_weak_refs_changed(
+    GBinderLocalObject* self,
+    gint delta)
 {
-    GBinderLocalObject* self = GBINDER_LOCAL_OBJECT(user_data);
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
 
-    GASSERT(self->weak_refs > 0);
-    self->weak_refs--;
-    g_signal_emit(self, gbinder_local_object_signals
-        [SIGNAL_WEAK_REFS_CHANGED], 0);
+        /*
+         * BR_INCREFS and BR_DECREFS arriving within the same main loop
+         * iteration are coalesced into a single callback. If nobody is
+         * listening, there's no need to bother the main thread at all.
+         */
+        if (!g_signal_has_handler_pending(self, gbinder_local_object_signals
+            [SIGNAL_WEAK_REFS_CHANGED], 0, TRUE)) {
+            g_atomic_int_add(&self->weak_refs, delta);
+        } else {
+            g_atomic_int_add(&priv->weak_refs_delta, delta);
+            if (g_atomic_int_compare_and_exchange(&priv->weak_refs_scheduled,
+                FALSE, TRUE)) {
+                gbinder_local_object_handle_later(self,
+                    gbinder_local_object_weak_refs_proc);
+            }
+        }
+    }
 }
 
 static
@@ -321,8 +594,10 @@ gbinder_local_object_default_acquire(
     self->strong_refs++;
     gbinder_local_object_ref(self);
     GVERBOSE_("%p => %d", self, self->strong_refs);
-    g_signal_emit(self, gbinder_local_object_signals
-        [SIGNAL_STRONG_REFS_CHANGED], 0);
+    if (self->strong_refs == 1) {
+        g_signal_emit(self, gbinder_local_object_signals
+            [SIGNAL_STRONG_REFS_CHANGED], 0);
+    }
 }
 
 static
@@ -359,8 +634,10 @@ gbinder_local_object_default_release(
     if (self->strong_refs > 0) {
         self->strong_refs--;
         GVERBOSE_("%p => %d", self, self->strong_refs);
-        g_signal_emit(self, gbinder_local_object_signals
-            [SIGNAL_STRONG_REFS_CHANGED], 0);
+        if (!self->strong_refs) {
+            g_signal_emit(self, gbinder_local_object_signals
+                [SIGNAL_STRONG_REFS_CHANGED], 0);
+        }
         gbinder_local_object_unref(self);
     }
 }
@@ -375,6 +652,465 @@ gbinder_local_object_release_proc(
     GBINDER_LOCAL_OBJECT_GET_CLASS(self)->release(self);
 }
 
+static
+void
+gbinder_local_object_unpin_proc(
+    gpointer obj)
+{
+    GBinderLocalObject* self = GBINDER_LOCAL_OBJECT(obj);
+
+    /* The kernel may have come back while we were on the way here */
+    if (!g_atomic_int_get(&self->priv->kernel_refs)) {
+        GVERBOSE_("%p released by the kernel", self);
+        gbinder_local_object_unpin(self);
+    }
+}
+
+static
+void
+gbinder_local_object_kernel_refs_changed(
+    GBinderLocalObject* self,
+    gint delta)
+{
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        /*
+         * Weak and strong references are counted together, in the order
+         * in which they arrive from the driver. Once they are all gone,
+         * the callback object is dropped on the main thread.
+         */
+        if (g_atomic_int_get(&priv->pinned) &&
+            g_atomic_int_add(&priv->kernel_refs, delta) + delta == 0) {
+            gbinder_local_object_handle_later(self,
+                gbinder_local_object_unpin_proc);
+        }
+    }
+}
+
+/*==========================================================================*
+ * FMQ channels
+ *
+ * Messages are read and handled on the main thread. Each one becomes
+ * a one-way GBinderRemoteRequest carrying the sender credentials of the
+ * transaction which opened the channel. The channel is closed when the
+ * token object passed along with the descriptor dies.
+ *==========================================================================*/
+
+#if GBINDER_FMQ_SUPPORTED
+
+static
+void
+gbinder_local_object_fmq_channel_free(
+    GBinderLocalObjectFmqChannel* channel)
+{
+    gbinder_fmq_remove_watch(channel->fmq, channel->watch_id);
+    gbinder_fmq_unref(channel->fmq);
+    gbinder_remote_object_remove_handler(channel->token, channel->death_id);
+    gbinder_remote_object_unref(channel->token);
+    g_slice_free(GBinderLocalObjectFmqChannel, channel);
+}
+
+static
+gboolean
+gbinder_local_object_fmq_channel_drain(
+    GBinderLocalObjectFmqChannel* channel)
+{
+    GBinderLocalObject* self = channel->object;
+    GBinderIpc* ipc = self->ipc;
+    void* data;
+    gsize size;
+    guint32 code;
+    int rc;
+
+    while ((rc = gbinder_fmq_channel_read(channel->fmq, &code, &data,
+        &size)) > 0) {
+        GBinderRemoteRequest* req = gbinder_remote_request_new
+            (gbinder_ipc_object_registry(ipc), gbinder_ipc_protocol(ipc),
+                channel->pid, channel->euid);
+        int status = GBINDER_STATUS_OK;
+
+        gbinder_remote_request_set_data(req, code, gbinder_buffer_new_local
+            (gbinder_ipc_io(ipc), data, size, NULL, g_free, data));
+        gbinder_local_reply_unref(GBINDER_LOCAL_OBJECT_GET_CLASS(self)->
+            handle_transaction(self, req, code, GBINDER_TX_FLAG_ONEWAY,
+                &status));
+        gbinder_remote_request_unref(req);
+    }
+    return rc == 0;
+}
+
+static
+void
+gbinder_local_object_fmq_channel_close(
+    GBinderLocalObjectFmqChannel* channel)
+{
+    GBinderLocalObjectPriv* priv = channel->object->priv;
+
+    GWARN("Closing FMQ channel from pid %d", (int)channel->pid);
+    priv->fmq_channels = g_slist_remove(priv->fmq_channels, channel);
+    gbinder_local_object_fmq_channel_free(channel);
+}
+
+static
+void
+gbinder_local_object_fmq_drain(
+    GBinderLocalObject* self)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+
+    if (!priv->fmq_draining) {
+        GSList* l = priv->fmq_channels;
+
+        gbinder_local_object_ref(self);
+        priv->fmq_draining = TRUE;
+        while (l) {
+            GBinderLocalObjectFmqChannel* channel = l->data;
+
+            l = l->next;
+            if (!gbinder_local_object_fmq_channel_drain(channel)) {
+                gbinder_local_object_fmq_channel_close(channel);
+            } else if (channel->dead) {
+                /* The writer died while we were draining */
+                priv->fmq_channels = g_slist_remove(priv->fmq_channels,
+                    channel);
+                gbinder_local_object_fmq_channel_free(channel);
+            }
+        }
+        priv->fmq_draining = FALSE;
+        gbinder_local_object_unref(self);
+    }
+}
+
+static
+void
+gbinder_local_object_fmq_channel_ready(
+    GBinderFmq* fmq,
+    guint32 state,
+    void* user_data)
+{
+    GBinderLocalObjectFmqChannel* channel = user_data;
+
+    gbinder_local_object_fmq_drain(channel->object);
+}
+
+static
+void
+gbinder_local_object_fmq_channel_died(
+    GBinderRemoteObject* token,
+    void* user_data)
+{
+    GBinderLocalObjectFmqChannel* channel = user_data;
+    GBinderLocalObjectPriv* priv = channel->object->priv;
+
+    GDEBUG("FMQ writer pid %d is gone", (int)channel->pid);
+    if (priv->fmq_draining) {
+        channel->dead = TRUE;
+    } else {
+        priv->fmq_channels = g_slist_remove(priv->fmq_channels, channel);
+        gbinder_local_object_fmq_channel_free(channel);
+    }
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_fmq_open(
+    GBinderLocalObject* self,
+    GBinderRemoteRequest* req,
+    int* status)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+    GBinderReader reader;
+    GBinderFmq* fmq;
+
+    if (g_slist_length(priv->fmq_channels) >=
+        GBINDER_LOCAL_OBJECT_MAX_FMQ_CHANNELS) {
+        GWARN("Too many FMQ channels");
+        *status = (-EBUSY);
+        return NULL;
+    }
+
+    gbinder_remote_request_init_reader(req, &reader);
+    fmq = gbinder_reader_read_fmq(&reader);
+    if (fmq) {
+        const GBinderMQDescriptor* desc = gbinder_fmq_get_descriptor(fmq);
+        GBinderRemoteObject* token = gbinder_reader_read_object(&reader);
+
+        if (token && !token->dead && desc->quantum == 1 &&
+            desc->flags == GBINDER_FMQ_TYPE_SYNC_READ_WRITE) {
+            GBinderLocalObjectFmqChannel* channel =
+                g_slice_new0(GBinderLocalObjectFmqChannel);
+
+            channel->object = self;
+            channel->fmq = fmq;
+            channel->token = token;
+            channel->pid = gbinder_remote_request_sender_pid(req);
+            channel->euid = gbinder_remote_request_sender_euid(req);
+            channel->watch_id = gbinder_fmq_add_watch(fmq,
+                GBINDER_FMQ_NOT_EMPTY, gbinder_local_object_fmq_channel_ready,
+                channel);
+            if (channel->watch_id) {
+                channel->death_id = gbinder_remote_object_add_death_handler
+                    (token, gbinder_local_object_fmq_channel_died, channel);
+                priv->fmq_channels = g_slist_append(priv->fmq_channels,
+                    channel);
+                return gbinder_local_object_cached_reply(self,
+                    GBINDER_LOCAL_OBJECT_REPLY_EMPTY,
+                    gbinder_local_object_new_reply, status);
+            }
+            g_slice_free(GBinderLocalObjectFmqChannel, channel);
+        }
+        gbinder_remote_object_unref(token);
+        gbinder_fmq_unref(fmq);
+    }
+    *status = (-EINVAL);
+    return NULL;
+}
+
+#endif /* GBINDER_FMQ_SUPPORTED */
+
+/*==========================================================================*
+ * Chunked transfers
+ *==========================================================================*/
+
+static
+void
+gbinder_local_object_chunked_free(
+    gpointer data)
+{
+    GBinderLocalObjectChunked* t = data;
+
+    if (t->in) {
+        g_byte_array_unref(t->in);
+    }
+    gbinder_local_reply_unref(t->out);
+    g_slice_free(GBinderLocalObjectChunked, t);
+}
+
+static
+GBinderLocalObjectChunked*
+gbinder_local_object_chunked_new(
+    GBinderLocalObject* self,
+    gint64 key)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+    GBinderLocalObjectChunked* t;
+
+    if (!priv->chunked) {
+        priv->chunked = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+            NULL, gbinder_local_object_chunked_free);
+    } else {
+        g_hash_table_remove(priv->chunked, &key);
+        if (g_hash_table_size(priv->chunked) >=
+            GBINDER_LOCAL_OBJECT_MAX_CHUNKED) {
+            GBinderLocalObjectChunked* oldest = NULL;
+            GHashTableIter it;
+            gpointer value;
+
+            /* Evict the transfer which has been abandoned the longest */
+            g_hash_table_iter_init(&it, priv->chunked);
+            while (g_hash_table_iter_next(&it, NULL, &value)) {
+                t = value;
+                if (!oldest || t->last_used < oldest->last_used) {
+                    oldest = t;
+                }
+            }
+            GWARN("Dropping chunked transfer %u from pid %d",
+                (guint)(oldest->key & 0xffffffff), (int)(oldest->key >> 32));
+            g_hash_table_remove(priv->chunked, &oldest->key);
+        }
+    }
+    t = g_slice_new0(GBinderLocalObjectChunked);
+    t->key = key;
+    g_hash_table_insert(priv->chunked, &t->key, t);
+    return t;
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_chunked_piece(
+    GBinderLocalObject* self,
+    GBinderLocalObjectChunked* t,
+    guint32 offset,
+    gboolean with_total)
+{
+    GByteArray* out = t->out ?
+        gbinder_local_reply_data(t->out)->bytes : NULL;
+    const guint32 total = out ? out->len : 0;
+    const guint32 len = MIN(total - offset, t->chunk);
+    GBinderLocalReply* reply = gbinder_local_object_new_reply2(self, len + 8);
+    GBinderWriter writer;
+
+    gbinder_local_reply_init_writer(reply, &writer);
+    if (with_total) {
+        gbinder_writer_append_int32(&writer, total);
+    }
+    gbinder_writer_append_byte_array(&writer, out ? (out->data + offset) :
+        NULL, len);
+    if (offset + len >= total) {
+        /* The whole reply has been fetched */
+        g_hash_table_remove(self->priv->chunked, &t->key);
+    }
+    return reply;
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_chunked_put(
+    GBinderLocalObject* self,
+    GBinderRemoteRequest* req,
+    GBinderReader* reader,
+    gint64 key,
+    int* status)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+    GBinderLocalObjectChunked* t = priv->chunked ?
+        g_hash_table_lookup(priv->chunked, &key) : NULL;
+    guint32 code, total, offset, chunk;
+    const void* piece;
+    gsize len;
+
+    if (!gbinder_reader_read_uint32(reader, &code) ||
+        !gbinder_reader_read_uint32(reader, &total) ||
+        !gbinder_reader_read_uint32(reader, &offset) ||
+        !gbinder_reader_read_uint32(reader, &chunk) || !chunk ||
+        !(piece = gbinder_reader_read_byte_array(reader, &len)) ||
+        total > priv->chunk_max_size || len > (total - offset) ||
+        offset > total) {
+        *status = (-EINVAL);
+    } else if (!offset) {
+        t = gbinder_local_object_chunked_new(self, key);
+        t->code = code;
+        t->total = total;
+        t->in = g_byte_array_sized_new(total);
+    } else if (!t || !t->in || t->in->len != offset || t->code != code ||
+        t->total != total) {
+        *status = (-EINVAL);
+    }
+
+    if (*status != GBINDER_STATUS_OK) {
+        if (t) {
+            g_hash_table_remove(priv->chunked, &t->key);
+        }
+        return NULL;
+    }
+
+    /* The sender doesn't get to decide how large our replies are */
+    t->chunk = MIN(chunk, GBINDER_LOCAL_OBJECT_MAX_CHUNK_SIZE);
+    t->last_used = g_get_monotonic_time();
+    g_byte_array_append(t->in, piece, len);
+    if (t->in->len < t->total) {
+        /* Wait for more */
+        return gbinder_local_object_cached_reply(self,
+            GBINDER_LOCAL_OBJECT_REPLY_EMPTY,
+            gbinder_local_object_new_reply, status);
+    } else {
+        GBinderIpc* ipc = self->ipc;
+        GBinderLocalObjectClass* klass = GBINDER_LOCAL_OBJECT_GET_CLASS(self);
+        GBinderRemoteRequest* full = gbinder_remote_request_new
+            (gbinder_ipc_object_registry(ipc), gbinder_ipc_protocol(ipc),
+                gbinder_remote_request_sender_pid(req),
+                gbinder_remote_request_sender_euid(req));
+        const guint size = t->in->len;
+        guint8* data = g_byte_array_free(t->in, FALSE);
+        const char* iface;
+
+        /* Handle the reassembled request */
+        t->in = NULL;
+        gbinder_remote_request_set_data(full, t->code,
+            gbinder_buffer_new_local(gbinder_ipc_io(ipc), data, size, NULL,
+                g_free, data));
+
+        /* Same check as for the requests coming directly from the driver */
+        iface = gbinder_remote_request_interface(full);
+        switch ((t->code == priv->chunk_code) ?
+            GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED :
+            klass->can_handle_transaction(self, iface, t->code)) {
+        case GBINDER_LOCAL_TRANSACTION_LOOPER:
+            t->out = klass->handle_looper_transaction(self, full, t->code,
+                0, status);
+            break;
+        case GBINDER_LOCAL_TRANSACTION_SUPPORTED:
+            t->out = klass->handle_transaction(self, full, t->code, 0,
+                status);
+            break;
+        default:
+            GWARN("Unhandled chunked transaction %s 0x%08x", iface, t->code);
+            *status = (-EBADMSG);
+            break;
+        }
+        gbinder_remote_request_unref(full);
+        if (*status == GBINDER_STATUS_OK && t->out) {
+            GBinderOutputData* out = gbinder_local_reply_data(t->out);
+            GUtilIntArray* offsets = gbinder_output_data_offsets(out);
+
+            if ((offsets && offsets->count) ||
+                gbinder_output_data_buffers_size(out)) {
+                GWARN("Can't send objects in chunks (tx %u)", t->code);
+                *status = (-EINVAL);
+            }
+        }
+        if (*status != GBINDER_STATUS_OK) {
+            g_hash_table_remove(priv->chunked, &t->key);
+            return NULL;
+        }
+        return gbinder_local_object_chunked_piece(self, t, 0, TRUE);
+    }
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_chunked_get(
+    GBinderLocalObject* self,
+    GBinderReader* reader,
+    gint64 key,
+    int* status)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+    GBinderLocalObjectChunked* t = priv->chunked ?
+        g_hash_table_lookup(priv->chunked, &key) : NULL;
+    guint32 offset;
+
+    if (t && t->out && gbinder_reader_read_uint32(reader, &offset) &&
+        offset < gbinder_local_reply_data(t->out)->bytes->len) {
+        t->last_used = g_get_monotonic_time();
+        return gbinder_local_object_chunked_piece(self, t, offset, FALSE);
+    }
+    *status = (-EINVAL);
+    return NULL;
+}
+
+static
+GBinderLocalReply*
+gbinder_local_object_chunked(
+    GBinderLocalObject* self,
+    GBinderRemoteRequest* req,
+    int* status)
+{
+    GBinderReader reader;
+    gint32 op;
+    guint32 id;
+
+    gbinder_remote_request_init_reader(req, &reader);
+    if (gbinder_reader_read_int32(&reader, &op) &&
+        gbinder_reader_read_uint32(&reader, &id)) {
+        const gint64 key = (((gint64)gbinder_remote_request_sender_pid(req))
+            << 32) | id;
+
+        *status = GBINDER_STATUS_OK;
+        switch (op) {
+        case GBINDER_CHUNK_PUT:
+            return gbinder_local_object_chunked_put(self, req, &reader, key,
+                status);
+        case GBINDER_CHUNK_GET:
+            return gbinder_local_object_chunked_get(self, &reader, key,
+                status);
+        }
+    }
+    *status = (-EINVAL);
+    return NULL;
+}
+
 /*==========================================================================*
  * Interface
  *==========================================================================*/
@@ -390,6 +1126,31 @@ gbinder_local_object_new(
         ipc, ifaces, txproc, user_data);
 }
 
+GBinderLocalObject*
+gbinder_local_object_new_callback(
+    GBinderIpc* ipc,
+    const char* iface,
+    GBinderLocalTransactFunc txproc,
+    void* user_data) /* Since 1.1.25 */
+{
+    if (G_LIKELY(ipc) && G_LIKELY(txproc)) {
+        const char* ifaces[2];
+        GBinderLocalObject* obj = g_object_new(GBINDER_TYPE_LOCAL_OBJECT,
+            NULL);
+
+        ifaces[0] = iface;
+        ifaces[1] = NULL;
+        gbinder_local_object_init_base(obj, ipc, ifaces, txproc, user_data);
+
+        /* This reference belongs to the kernel */
+        obj->priv->pinned = TRUE;
+        gbinder_local_object_ref(obj);
+        gbinder_ipc_register_local_object(ipc, obj);
+        return obj;
+    }
+    return NULL;
+}
+
 GBinderLocalObject*
 gbinder_local_object_new_with_type(
     GType type,
@@ -471,6 +1232,7 @@ gbinder_local_object_drop(
 {
     if (G_LIKELY(self)) {
         GBINDER_LOCAL_OBJECT_GET_CLASS(self)->drop(self);
+        gbinder_local_object_unpin(self);
         g_object_unref(GBINDER_LOCAL_OBJECT(self));
     }
 }
@@ -480,11 +1242,317 @@ gbinder_local_object_new_reply(
     GBinderLocalObject* self)
 {
     if (G_LIKELY(self)) {
-        return gbinder_local_reply_new(gbinder_local_object_io(self));
+        GBinderLocalReply* reply =
+            gbinder_local_reply_new(gbinder_local_object_io(self));
+        const gsize size_hint = gbinder_ipc_reply_size_hint(self->ipc);
+
+        /* Pre-sized by Autotune */
+        if (size_hint) {
+            GBinderWriter writer;
+
+            gbinder_local_reply_init_writer(reply, &writer);
+            gbinder_writer_reserve(&writer, size_hint, 0, 0);
+        }
+        return reply;
     }
     return NULL;
 }
 
+GBinderLocalReply*
+gbinder_local_object_new_reply2(
+    GBinderLocalObject* self,
+    gsize size_hint) /* Since 1.1.25 */
+{
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(self);
+
+    if (reply && size_hint) {
+        GBinderWriter writer;
+
+        gbinder_local_reply_init_writer(reply, &writer);
+        gbinder_writer_reserve(&writer, size_hint, 0, 0);
+    }
+    return reply;
+}
+
+/*
+ * By default, incoming transactions are handed over to the main thread
+ * and the GBinderLocalTransactFunc is invoked there. If the handler is
+ * thread safe, it can be invoked directly on the looper thread which
+ * received the transaction. In that case:
+ *
+ * - The handler may be invoked on any looper thread, and concurrently
+ *   for several transactions;
+ * - gbinder_remote_request_block() can be called by the handler and
+ *   gbinder_remote_request_complete() from any thread. Looper thread
+ *   stays blocked until the request gets completed;
+ * - Everything else (signals, death notifications, reference counting
+ *   callbacks etc.) still happens on the main thread;
+ * - gbinder_local_object_drop() doesn't wait for the handlers which
+ *   are already running on looper threads;
+ * - Can't be combined with gbinder_local_object_accept_fmq_channel().
+ */
+void
+gbinder_local_object_set_looper_dispatch(
+    GBinderLocalObject* self,
+    gboolean enable) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        if (enable && g_atomic_int_get(&priv->fmq_accept)) {
+            /* FMQ channels are drained on the main thread */
+            GWARN("Looper dispatch is incompatible with FMQ channels");
+        } else {
+            g_atomic_int_set(&priv->looper_dispatch, enable != FALSE);
+        }
+    }
+}
+
+/*
+ * Serial dispatch is a middle ground between the main thread and the
+ * looper thread dispatch. Incoming transactions for the object are
+ * handled one at a time, in the order in which they have been received,
+ * by a pool of worker threads shared by all objects in the process.
+ * Transactions for different objects run in parallel. In other words,
+ * each object gets its own serial queue and the handler doesn't need
+ * to be reentrant, only thread safe with respect to the other objects.
+ *
+ * - The handler is never invoked concurrently for the same object,
+ *   although consecutive calls may happen on different threads;
+ * - gbinder_remote_request_block() and gbinder_remote_request_complete()
+ *   work the same way as with looper dispatch. Blocked request doesn't
+ *   hold the queue, the next transaction is handled right away;
+ * - Everything else still happens on the main thread, and so do the
+ *   in-process transactions which don't go through the driver. Those
+ *   aren't serialized with the ones coming from other processes;
+ * - Looper dispatch takes precedence if both are enabled;
+ * - Can't be combined with gbinder_local_object_accept_fmq_channel().
+ */
+void
+gbinder_local_object_set_serial_dispatch(
+    GBinderLocalObject* self,
+    gboolean enable) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        if (enable && g_atomic_int_get(&priv->fmq_accept)) {
+            GWARN("Serial dispatch is incompatible with FMQ channels");
+        } else {
+            g_atomic_int_set(&priv->serial_dispatch, enable != FALSE);
+        }
+    }
+}
+
+/*
+ * Accepts shared memory queues offered by gbinder_client_open_fmq_channel()
+ * with the given transaction code. One-way transactions arriving through
+ * such queues are passed to the regular handler on the main thread. Each
+ * queue is closed when the process which opened it dies. All open queues
+ * are drained before handling any other transaction, so that a call which
+ * falls back to the driver can't overtake the calls queued before it.
+ * It can still be overtaken by those queued after it, see
+ * gbinder_client_transact_fmq_oneway(). Refused for the objects with
+ * looper or serial dispatch enabled (and those can't be enabled once the
+ * queues are accepted). A no-op if the library has been built without
+ * FMQ support.
+ */
+void
+gbinder_local_object_accept_fmq_channel(
+    GBinderLocalObject* self,
+    guint32 code) /* Since 1.1.25 */
+{
+#if GBINDER_FMQ_SUPPORTED
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        if (g_atomic_int_get(&priv->looper_dispatch) ||
+            g_atomic_int_get(&priv->serial_dispatch)) {
+            /* Otherwise the queues would be drained off the main thread */
+            GWARN("FMQ channels require main thread dispatch");
+        } else {
+            priv->fmq_code = code;
+            g_atomic_int_set(&priv->fmq_accept, TRUE);
+        }
+    }
+#endif
+}
+
+/*
+ * Accepts chunked transfers sent by the clients which have enabled them
+ * with gbinder_client_set_chunking() for the same code. Chunks are put
+ * back together on the main thread and the reassembled request is passed
+ * to the regular handler as a two-way transaction with its original code,
+ * provided that the object accepts that code and interface. The reply is
+ * fetched by the client in pieces of no more than the client's chunk size
+ * and GBINDER_LOCAL_OBJECT_MAX_CHUNK_SIZE bytes. Neither the request nor
+ * the reply may carry objects. Requests larger than max_size are rejected.
+ * Not compatible with looper dispatch.
+ */
+void
+gbinder_local_object_accept_chunked(
+    GBinderLocalObject* self,
+    guint32 code,
+    gsize max_size) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        priv->chunk_code = code;
+        priv->chunk_max_size = MIN(max_size, G_MAXINT32);
+        g_atomic_int_set(&priv->chunk_accept, TRUE);
+    }
+}
+
+/*
+ * Registers the handlers for individual transaction codes. Must be done
+ * before the object is passed to anyone else, the table isn't protected
+ * from concurrent access by the looper threads. Re-registering the same
+ * code and interface replaces the handler.
+ */
+gboolean
+gbinder_local_object_add_methods(
+    GBinderLocalObject* self,
+    const GBinderLocalMethod* methods,
+    gsize count) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && (methods || !count)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+        gsize i;
+
+        for (i = 0; i < count; i++) {
+            if (!methods[i].handler) {
+                return FALSE;
+            }
+        }
+        if (!priv->methods && count) {
+            priv->methods = g_hash_table_new_full(g_direct_hash,
+                g_direct_equal, NULL, gbinder_local_object_method_free);
+        }
+        for (i = 0; i < count; i++) {
+            const GBinderLocalMethod* m = methods + i;
+            const char* iface = m->iface ? m->iface : priv->ifaces[0];
+            gpointer key = GUINT_TO_POINTER(m->code);
+            GBinderLocalObjectMethod* first = g_hash_table_lookup
+                (priv->methods, key);
+            GBinderLocalObjectMethod* method;
+
+            for (method = first; method; method = method->next) {
+                if (!g_strcmp0(method->iface, iface)) {
+                    break;
+                }
+            }
+            if (!method) {
+                method = g_slice_new0(GBinderLocalObjectMethod);
+                method->iface = g_strdup(iface);
+                method->interned = gbinder_local_object_intern_iface(self,
+                    iface);
+                method->next = first;
+                g_hash_table_steal(priv->methods, key);
+                g_hash_table_insert(priv->methods, key, method);
+            }
+            method->flags = m->flags;
+            method->handler = m->handler;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+void
+gbinder_local_object_set_priority(
+    GBinderLocalObject* self,
+    GBINDER_LOCAL_PRIORITY priority) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && priority >= GBINDER_LOCAL_PRIORITY_LOW &&
+        priority <= GBINDER_LOCAL_PRIORITY_HIGH) {
+        g_atomic_int_set(&self->priv->priority, priority);
+    }
+}
+
+/*
+ * Overrides the object priority for the particular transaction code.
+ * Same as with gbinder_local_object_add_methods(), that must be done
+ * before the object becomes visible to the looper threads.
+ */
+void
+gbinder_local_object_set_code_priority(
+    GBinderLocalObject* self,
+    guint32 code,
+    GBINDER_LOCAL_PRIORITY priority) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && priority >= GBINDER_LOCAL_PRIORITY_LOW &&
+        priority <= GBINDER_LOCAL_PRIORITY_HIGH) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        if (!priv->priorities) {
+            priv->priorities = g_hash_table_new(g_direct_hash,
+                g_direct_equal);
+        }
+        /* Store the value plus one to tell it apart from a missing entry */
+        g_hash_table_insert(priv->priorities, GUINT_TO_POINTER(code),
+            GINT_TO_POINTER(priority + 1));
+    }
+}
+
+static
+GBinderLocalObjectSched*
+gbinder_local_object_sched_new(
+    GBinderLocalObjectPriv* priv)
+{
+    if (!priv->sched) {
+        priv->sched = g_slice_new0(GBinderLocalObjectSched);
+        priv->sched->policy = -1;
+    }
+    return priv->sched;
+}
+
+gboolean
+gbinder_local_object_set_min_sched(
+    GBinderLocalObject* self,
+    int policy,
+    int priority) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        gboolean ok;
+
+        switch (policy) {
+        case SCHED_OTHER:
+        case SCHED_BATCH:
+            /* Nice value */
+            ok = (priority >= -20 && priority <= 19);
+            break;
+        case SCHED_FIFO:
+        case SCHED_RR:
+            ok = (priority >= 1 && priority <= 99);
+            break;
+        default:
+            /* The rest can't be encoded */
+            ok = FALSE;
+            break;
+        }
+        if (ok) {
+            GBinderLocalObjectSched* sched =
+                gbinder_local_object_sched_new(self->priv);
+
+            sched->policy = policy;
+            sched->priority = priority;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void
+gbinder_local_object_set_inherit_rt(
+    GBinderLocalObject* self,
+    gboolean inherit) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && (inherit || self->priv->sched)) {
+        gbinder_local_object_sched_new(self->priv)->inherit_rt = inherit;
+    }
+}
+
 gulong
 gbinder_local_object_add_weak_refs_changed_handler(
     GBinderLocalObject* self,
@@ -521,9 +1589,93 @@ gbinder_local_object_can_handle_transaction(
     const char* iface,
     guint code)
 {
-    return G_LIKELY(self) ?
-        GBINDER_LOCAL_OBJECT_GET_CLASS(self)->can_handle_transaction
-            (self, iface, code) : GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED;
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        if ((g_atomic_int_get(&priv->fmq_accept) && code == priv->fmq_code) ||
+            (g_atomic_int_get(&priv->chunk_accept) &&
+             code == priv->chunk_code)) {
+            return GBINDER_LOCAL_TRANSACTION_SUPPORTED;
+        }
+        return GBINDER_LOCAL_OBJECT_GET_CLASS(self)->can_handle_transaction
+            (self, iface, code);
+    }
+    return GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED;
+}
+
+gboolean
+gbinder_local_object_looper_dispatch(
+    GBinderLocalObject* self)
+{
+    return G_LIKELY(self) && g_atomic_int_get(&self->priv->looper_dispatch);
+}
+
+gboolean
+gbinder_local_object_serial_dispatch(
+    GBinderLocalObject* self)
+{
+    return G_LIKELY(self) && g_atomic_int_get(&self->priv->serial_dispatch);
+}
+
+gboolean
+gbinder_local_object_strand_push(
+    GBinderLocalObject* self,
+    gpointer item)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+    gboolean idle;
+
+    g_mutex_lock(&priv->strand_mutex);
+    g_queue_push_tail(&priv->strand, item);
+    idle = !priv->strand_busy;
+    priv->strand_busy = TRUE;
+    g_mutex_unlock(&priv->strand_mutex);
+    return idle;
+}
+
+gpointer
+gbinder_local_object_strand_pop(
+    GBinderLocalObject* self)
+{
+    GBinderLocalObjectPriv* priv = self->priv;
+    gpointer item;
+
+    g_mutex_lock(&priv->strand_mutex);
+    GASSERT(priv->strand_busy);
+    item = g_queue_pop_head(&priv->strand);
+    if (!item) {
+        priv->strand_busy = FALSE;
+    }
+    g_mutex_unlock(&priv->strand_mutex);
+    return item;
+}
+
+GBINDER_LOCAL_PRIORITY
+gbinder_local_object_priority(
+    GBinderLocalObject* self,
+    guint32 code)
+{
+    if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        if (priv->priorities) {
+            const int value = GPOINTER_TO_INT(g_hash_table_lookup
+                (priv->priorities, GUINT_TO_POINTER(code)));
+
+            if (value) {
+                return value - 1;
+            }
+        }
+        return g_atomic_int_get(&priv->priority);
+    }
+    return GBINDER_LOCAL_PRIORITY_NORMAL;
+}
+
+const GBinderLocalObjectSched*
+gbinder_local_object_sched(
+    GBinderLocalObject* self)
+{
+    return G_LIKELY(self) ? self->priv->sched : NULL;
 }
 
 GBinderLocalReply*
@@ -535,6 +1687,26 @@ gbinder_local_object_handle_transaction(
     int* status)
 {
     if (G_LIKELY(self)) {
+        GBinderLocalObjectPriv* priv = self->priv;
+
+        if (g_atomic_int_get(&priv->chunk_accept) &&
+            code == priv->chunk_code) {
+            int unused;
+
+            return gbinder_local_object_chunked(self, req,
+                status ? status : &unused);
+        }
+#if GBINDER_FMQ_SUPPORTED
+        if (g_atomic_int_get(&priv->fmq_accept)) {
+            if (code == priv->fmq_code) {
+                int unused;
+
+                return gbinder_local_object_fmq_open(self, req,
+                    status ? status : &unused);
+            }
+            gbinder_local_object_fmq_drain(self);
+        }
+#endif
         return GBINDER_LOCAL_OBJECT_GET_CLASS(self)->handle_transaction
             (self, req, code, flags, status);
     } else {
@@ -560,18 +1732,30 @@ gbinder_local_object_handle_looper_transaction(
     }
 }
 
+void
+gbinder_local_object_unpin(
+    GBinderLocalObject* self)
+{
+    if (g_atomic_int_compare_and_exchange(&self->priv->pinned, TRUE, FALSE)) {
+        GBINDER_LOCAL_OBJECT_GET_CLASS(self)->drop(self);
+        gbinder_local_object_unref(self);
+    }
+}
+
 void
 gbinder_local_object_handle_increfs(
     GBinderLocalObject* self)
 {
-    gbinder_local_object_handle_later(self, gbinder_local_object_increfs_proc);
+    gbinder_local_object_kernel_refs_changed(self, 1);
+    gbinder_local_object_weak_refs_changed(self, 1);
 }
 
 void
 gbinder_local_object_handle_decrefs(
     GBinderLocalObject* self)
 {
-    gbinder_local_object_handle_later(self, gbinder_local_object_decrefs_proc);
+    gbinder_local_object_weak_refs_changed(self, -1);
+    gbinder_local_object_kernel_refs_changed(self, -1);
 }
 
 void
@@ -583,6 +1767,8 @@ gbinder_local_object_handle_acquire(
         GBinderLocalObjectAcquireData* data =
             g_slice_new(GBinderLocalObjectAcquireData);
 
+        gbinder_local_object_kernel_refs_changed(self, 1);
+
         /*
          * This is a bit complicated :)
          * GBinderProxyObject derived from GBinderLocalObject acquires a
@@ -597,7 +1783,7 @@ gbinder_local_object_handle_acquire(
          */
         data->object = gbinder_local_object_ref(self);
         data->bufs = gbinder_buffer_contents_list_dup(bufs);
-        gbinder_idle_callback_invoke_later(gbinder_local_object_acquire_proc,
+        gbinder_ipc_invoke_later(self->ipc, gbinder_local_object_acquire_proc,
             data, gbinder_local_object_acquire_done);
     }
 }
@@ -607,6 +1793,7 @@ gbinder_local_object_handle_release(
     GBinderLocalObject* self)
 {
     gbinder_local_object_handle_later(self, gbinder_local_object_release_proc);
+    gbinder_local_object_kernel_refs_changed(self, -1);
 }
 
 /*==========================================================================*
@@ -621,7 +1808,11 @@ gbinder_local_object_init(
     GBinderLocalObjectPriv* priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
         GBINDER_TYPE_LOCAL_OBJECT, GBinderLocalObjectPriv);
 
+    priv->priority = GBINDER_LOCAL_PRIORITY_NORMAL;
+    g_mutex_init(&priv->strand_mutex);
+    g_queue_init(&priv->strand);
     self->priv = priv;
+    gbinder_stats_mem_add(GBINDER_STATS_MEM_LOCAL_OBJECTS, 0);
 }
 
 static
@@ -631,6 +1822,15 @@ gbinder_local_object_dispose(
 {
     GBinderLocalObject* self = GBINDER_LOCAL_OBJECT(object);
 
+#if GBINDER_FMQ_SUPPORTED
+    g_slist_free_full(self->priv->fmq_channels, (GDestroyNotify)
+        gbinder_local_object_fmq_channel_free);
+    self->priv->fmq_channels = NULL;
+#endif
+    if (self->priv->chunked) {
+        g_hash_table_destroy(self->priv->chunked);
+        self->priv->chunked = NULL;
+    }
     gbinder_ipc_local_object_disposed(self->ipc, self);
     G_OBJECT_CLASS(PARENT_CLASS)->dispose(object);
 }
@@ -642,11 +1842,27 @@ gbinder_local_object_finalize(
 {
     GBinderLocalObject* self = GBINDER_LOCAL_OBJECT(object);
     GBinderLocalObjectPriv* priv = self->priv;
+    guint i;
 
     GASSERT(!self->strong_refs);
+    GASSERT(g_queue_is_empty(&priv->strand));
     gbinder_ipc_invalidate_local_object(self->ipc, self);
     gbinder_ipc_unref(self->ipc);
+    if (priv->priorities) {
+        g_hash_table_destroy(priv->priorities);
+    }
+    if (priv->sched) {
+        g_slice_free(GBinderLocalObjectSched, priv->sched);
+    }
+    if (priv->methods) {
+        g_hash_table_destroy(priv->methods);
+    }
+    for (i = 0; i < G_N_ELEMENTS(priv->replies); i++) {
+        gbinder_local_reply_unref(priv->replies[i]);
+    }
     g_strfreev(priv->ifaces);
+    g_mutex_clear(&priv->strand_mutex);
+    gbinder_stats_mem_remove(GBINDER_STATS_MEM_LOCAL_OBJECTS, 0);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
 
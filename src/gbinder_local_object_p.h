@@ -67,6 +67,12 @@ typedef enum gbinder_local_transaction_support {
     GBINDER_LOCAL_TRANSACTION_LOOPER         /* On the looper thread */
 } GBINDER_LOCAL_TRANSACTION_SUPPORT;
 
+typedef struct gbinder_local_object_sched {
+    int policy; /* Negative if there's no minimum */
+    int priority;
+    gboolean inherit_rt;
+} GBinderLocalObjectSched;
+
 typedef struct gbinder_local_object_class {
     GObjectClass parent;
     GBINDER_LOCAL_TRANSACTION_SUPPORT (*can_handle_transaction)
@@ -93,6 +99,12 @@ GType gbinder_local_object_get_type(void) GBINDER_INTERNAL;
 #define gbinder_local_object_dev(obj) (gbinder_driver_dev((obj)->ipc->driver))
 #define gbinder_local_object_io(obj) (gbinder_driver_io((obj)->ipc->driver))
 
+/* Largest piece of the reply returned by a chunked transfer */
+#define GBINDER_LOCAL_OBJECT_MAX_CHUNK_SIZE (0x10000)
+
+/* Open FMQ channels per object */
+#define GBINDER_LOCAL_OBJECT_MAX_FMQ_CHANNELS (16)
+
 GBinderLocalObject*
 gbinder_local_object_new_with_type(
     GType type,
@@ -111,6 +123,7 @@ gbinder_local_object_init_base(
     void* user_data)
     GBINDER_INTERNAL;
 
+/* Handlers are only invoked when the count becomes zero or non-zero */
 gulong
 gbinder_local_object_add_weak_refs_changed_handler(
     GBinderLocalObject* obj,
@@ -138,6 +151,41 @@ gbinder_local_object_can_handle_transaction(
     guint code)
     GBINDER_INTERNAL;
 
+gboolean
+gbinder_local_object_looper_dispatch(
+    GBinderLocalObject* obj)
+    GBINDER_INTERNAL;
+
+gboolean
+gbinder_local_object_serial_dispatch(
+    GBinderLocalObject* obj)
+    GBINDER_INTERNAL;
+
+/* Returns TRUE if the strand was idle and the caller has to drain it */
+gboolean
+gbinder_local_object_strand_push(
+    GBinderLocalObject* obj,
+    gpointer item)
+    GBINDER_INTERNAL;
+
+/* Returns NULL and marks the strand idle once it's empty */
+gpointer
+gbinder_local_object_strand_pop(
+    GBinderLocalObject* obj)
+    GBINDER_INTERNAL;
+
+GBINDER_LOCAL_PRIORITY
+gbinder_local_object_priority(
+    GBinderLocalObject* obj,
+    guint32 code)
+    GBINDER_INTERNAL;
+
+/* NULL if no scheduling hints have been set */
+const GBinderLocalObjectSched*
+gbinder_local_object_sched(
+    GBinderLocalObject* obj)
+    GBINDER_INTERNAL;
+
 GBinderLocalReply*
 gbinder_local_object_handle_transaction(
     GBinderLocalObject* obj,
@@ -156,6 +204,12 @@ gbinder_local_object_handle_looper_transaction(
     int* status)
     GBINDER_INTERNAL;
 
+/* Releases the reference held on behalf of the kernel by callback objects */
+void
+gbinder_local_object_unpin(
+    GBinderLocalObject* obj)
+    GBINDER_INTERNAL;
+
 void
 gbinder_local_object_handle_increfs(
     GBinderLocalObject* obj)
@@ -32,6 +32,7 @@
 
 #include "gbinder_local_reply_p.h"
 #include "gbinder_output_data.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_writer_p.h"
 #include "gbinder_buffer_p.h"
 #include "gbinder_log.h"
@@ -86,9 +87,10 @@ gbinder_local_reply_new(
         };
 
         g_atomic_int_set(&self->refcount, 1);
-        data->io = io;
-        out->bytes = data->bytes = g_byte_array_new();
+        gbinder_writer_data_init(data, io);
+        out->bytes = data->bytes;
         out->f = &local_reply_output_fn;
+        gbinder_stats_mem_add(GBINDER_STATS_MEM_LOCAL_REPLIES, 0);
         return self;
     }
     return NULL;
@@ -114,13 +116,10 @@ void
 gbinder_local_reply_free(
     GBinderLocalReply* self)
 {
-    GBinderWriterData* data = &self->data;
-
-    gutil_int_array_free(data->offsets, TRUE);
-    g_byte_array_free(data->bytes, TRUE);
-    gbinder_cleanup_free(data->cleanup);
+    gbinder_writer_data_clear(&self->data);
     gbinder_buffer_contents_unref(self->contents);
     gutil_slice_free(self);
+    gbinder_stats_mem_remove(GBINDER_STATS_MEM_LOCAL_REPLIES, 0);
 }
 
 GBinderLocalReply*
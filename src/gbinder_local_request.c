@@ -33,6 +33,7 @@
 #include "gbinder_local_request_p.h"
 #include "gbinder_rpc_protocol.h"
 #include "gbinder_output_data.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_writer_p.h"
 #include "gbinder_buffer_p.h"
 #include "gbinder_io.h"
@@ -45,6 +46,8 @@ struct gbinder_local_request {
     gint refcount;
     GBinderWriterData data;
     GBinderOutputData out;
+    const char* iface; /* Interned, for statistics only */
+    guint64 trace_id;
 };
 
 GBINDER_INLINE_FUNC
@@ -88,18 +91,16 @@ gbinder_local_request_new(
         };
 
         g_atomic_int_set(&self->refcount, 1);
-        writer->io = io;
+        gbinder_writer_data_init(writer, io);
         if (init) {
             gsize size;
             gconstpointer data = g_bytes_get_data(init, &size);
 
-            writer->bytes = g_byte_array_sized_new(size);
             g_byte_array_append(writer->bytes, data, size);
-        } else {
-            writer->bytes = g_byte_array_new();
         }
         out->f = &local_request_output_fn;
         out->bytes = writer->bytes;
+        gbinder_stats_mem_add(GBINDER_STATS_MEM_LOCAL_REQUESTS, 0);
         return self;
     }
     return NULL;
@@ -118,6 +119,10 @@ gbinder_local_request_new_iface(
 
         gbinder_local_request_init_writer(self, &writer);
         protocol->write_rpc_header(&writer, iface);
+        if (gbinder_stats_active()) {
+            /* Interning isn't free, only bother when someone is watching */
+            self->iface = g_intern_string(iface);
+        }
     }
     return self;
 }
@@ -148,17 +153,42 @@ gbinder_local_request_append_contents(
     }
 }
 
+GBinderLocalRequest*
+gbinder_local_request_copy(
+    GBinderLocalRequest* tmpl) /* Since 1.1.25 */
+{
+    /*
+     * Requests built once (RPC header plus constant leading arguments)
+     * can be used as templates, each instance starts with a copy of the
+     * template data and gets the variable part appended to it. Buffer
+     * objects point to the memory owned by the template, so those can't
+     * be copied.
+     */
+    if (G_LIKELY(tmpl) && !tmpl->data.buffers_size) {
+        const GBinderWriterData* src = &tmpl->data;
+        GBinderLocalRequest* self = gbinder_local_request_new(src->io, NULL);
+        GBinderWriterData* dest = &self->data;
+
+        g_byte_array_append(dest->bytes, src->bytes->data, src->bytes->len);
+        if (src->offsets && src->offsets->count) {
+            dest->offsets = gutil_int_array_sized_new(src->offsets->count);
+            gutil_int_array_append_all(dest->offsets, src->offsets->data,
+                src->offsets->count);
+        }
+        self->iface = tmpl->iface;
+        return self;
+    }
+    return NULL;
+}
+
 static
 void
 gbinder_local_request_free(
     GBinderLocalRequest* self)
 {
-    GBinderWriterData* data = &self->data;
-
-    g_byte_array_free(data->bytes, TRUE);
-    gutil_int_array_free(data->offsets, TRUE);
-    gbinder_cleanup_free(data->cleanup);
+    gbinder_writer_data_clear(&self->data);
     g_slice_free(GBinderLocalRequest, self);
+    gbinder_stats_mem_remove(GBINDER_STATS_MEM_LOCAL_REQUESTS, 0);
 }
 
 GBinderLocalRequest*
@@ -191,6 +221,41 @@ gbinder_local_request_data(
     return G_LIKELY(self) ? &self->out :  NULL;
 }
 
+void
+gbinder_local_request_set_iface(
+    GBinderLocalRequest* self,
+    const char* iface)
+{
+    /* The caller passes in an interned string */
+    if (G_LIKELY(self)) {
+        self->iface = iface;
+    }
+}
+
+const char*
+gbinder_local_request_iface(
+    GBinderLocalRequest* self)
+{
+    return G_LIKELY(self) ? self->iface : NULL;
+}
+
+void
+gbinder_local_request_set_trace_id(
+    GBinderLocalRequest* self,
+    guint64 id) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        self->trace_id = id;
+    }
+}
+
+guint64
+gbinder_local_request_trace_id(
+    GBinderLocalRequest* self) /* Since 1.1.25 */
+{
+    return G_LIKELY(self) ? self->trace_id : 0;
+}
+
 void
 gbinder_local_request_cleanup(
     GBinderLocalRequest* self,
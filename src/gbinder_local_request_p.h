@@ -61,6 +61,17 @@ gbinder_local_request_data(
     GBinderLocalRequest* req)
     GBINDER_INTERNAL;
 
+void
+gbinder_local_request_set_iface(
+    GBinderLocalRequest* req,
+    const char* iface)
+    GBINDER_INTERNAL;
+
+const char*
+gbinder_local_request_iface(
+    GBinderLocalRequest* req)
+    GBINDER_INTERNAL;
+
 void
 gbinder_local_request_append_contents(
     GBinderLocalRequest* req,
@@ -39,6 +39,9 @@
 /* Log module */
 GLOG_MODULE_DEFINE("gbinder");
 
+/* Only taken when there's something to log */
+static GMutex gbinder_log_ratelimit_mutex; /* Statically allocated */
+
 /* Initializes the default log level at startup */
 void
 gbinder_log_init(
@@ -53,6 +56,33 @@ gbinder_log_init(
     }
 }
 
+gboolean
+gbinder_log_ratelimit(
+    GBinderLogRateLimit* rl,
+    guint* suppressed)
+{
+    const gint64 now = g_get_monotonic_time();
+    gboolean ok;
+
+    g_mutex_lock(&gbinder_log_ratelimit_mutex);
+    if (!rl->start || now - rl->start >=
+        (gint64)GBINDER_LOG_RATELIMIT_INTERVAL_MS * 1000) {
+        /* New interval */
+        rl->start = now;
+        rl->count = 0;
+    }
+    ok = (rl->count < GBINDER_LOG_RATELIMIT_BURST);
+    if (ok) {
+        rl->count++;
+        *suppressed = rl->suppressed;
+        rl->suppressed = 0;
+    } else {
+        rl->suppressed++;
+    }
+    g_mutex_unlock(&gbinder_log_ratelimit_mutex);
+    return ok;
+}
+
 /*
  * Local Variables:
  * mode: C
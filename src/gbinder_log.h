@@ -45,6 +45,39 @@ gbinder_log_init(
     void)
     GBINDER_INTERNAL;
 
+/*
+ * Rate limited warnings, for the places which a misbehaving peer can hit
+ * as often as it wants. Each call site logs at most
+ * GBINDER_LOG_RATELIMIT_BURST messages per GBINDER_LOG_RATELIMIT_INTERVAL_MS,
+ * the first message after that tells how many have been suppressed.
+ * Formatting only happens when the message actually gets logged.
+ */
+#define GBINDER_LOG_RATELIMIT_INTERVAL_MS (5000)
+#define GBINDER_LOG_RATELIMIT_BURST (10)
+
+typedef struct gbinder_log_ratelimit {
+    gint64 start;
+    guint count;
+    guint suppressed;
+} GBinderLogRateLimit;
+
+gboolean
+gbinder_log_ratelimit(
+    GBinderLogRateLimit* rl,
+    guint* suppressed)
+    GBINDER_INTERNAL;
+
+#define GWARN_RATELIMITED(format, ...) do { \
+    static GBinderLogRateLimit gbinder_log_rl; \
+    guint gbinder_log_suppressed; \
+    if (GLOG_ENABLED(GLOG_LEVEL_WARN) && \
+        gbinder_log_ratelimit(&gbinder_log_rl, &gbinder_log_suppressed)) { \
+        if (gbinder_log_suppressed) { \
+            GWARN("%u similar message(s) suppressed", gbinder_log_suppressed); \
+        } \
+        GWARN(format, ##__VA_ARGS__); \
+    } } while (0)
+
 #endif /* GBINDER_LOG_H */
 
 /*
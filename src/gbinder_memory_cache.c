@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "gbinder_memory_cache.h"
+#include "gbinder_stats_p.h"
+#include "gbinder_log.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct gbinder_memory_cache_key {
+    dev_t dev;
+    ino_t ino;
+} GBinderMemoryCacheKey;
+
+typedef struct gbinder_memory_cache_entry {
+    GBinderMemoryCacheKey key;
+    GBinderMemoryCache* cache; /* NULL if not cached */
+    GList link; /* Idle queue link, data points back to the entry */
+    void* ptr;
+    gsize size;
+    guint views;
+    gboolean cached; /* In the table */
+} GBinderMemoryCacheEntry;
+
+struct gbinder_memory_cache {
+    gint refcount;
+    GMutex mutex;
+    GHashTable* table;
+    GQueue idle; /* Most recently released first */
+    guint max_idle;
+};
+
+static
+guint
+gbinder_memory_cache_key_hash(
+    gconstpointer data)
+{
+    const GBinderMemoryCacheKey* key = data;
+
+    return (guint)key->ino ^ (guint)key->dev;
+}
+
+static
+gboolean
+gbinder_memory_cache_key_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const GBinderMemoryCacheKey* k1 = a;
+    const GBinderMemoryCacheKey* k2 = b;
+
+    return k1->ino == k2->ino && k1->dev == k2->dev;
+}
+
+static
+GBinderMemoryCacheEntry*
+gbinder_memory_cache_entry_new(
+    int fd,
+    gsize size)
+{
+    void* ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (ptr != MAP_FAILED) {
+        GBinderMemoryCacheEntry* entry =
+            g_slice_new0(GBinderMemoryCacheEntry);
+
+        entry->link.data = entry;
+        entry->ptr = ptr;
+        entry->size = size;
+        entry->views = 1;
+        gbinder_stats_mem_add(GBINDER_STATS_MEM_MAPPINGS, size);
+        return entry;
+    }
+    GWARN("Failed to map %u bytes: %s", (guint)size, strerror(errno));
+    return NULL;
+}
+
+static
+void
+gbinder_memory_cache_entry_free(
+    GBinderMemoryCacheEntry* entry)
+{
+    munmap(entry->ptr, entry->size);
+    gbinder_stats_mem_remove(GBINDER_STATS_MEM_MAPPINGS, entry->size);
+    g_slice_free(GBinderMemoryCacheEntry, entry);
+}
+
+static
+void
+gbinder_memory_cache_free_entries(
+    GQueue* entries)
+{
+    GList* link;
+
+    while ((link = g_queue_pop_head_link(entries)) != NULL) {
+        gbinder_memory_cache_entry_free(link->data);
+    }
+}
+
+static
+void
+gbinder_memory_cache_drop_locked(
+    GBinderMemoryCache* self,
+    GBinderMemoryCacheEntry* entry)
+{
+    /* Caller holds the mutex */
+    g_hash_table_remove(self->table, &entry->key);
+    entry->cached = FALSE;
+}
+
+static
+void
+gbinder_memory_cache_trim_locked(
+    GBinderMemoryCache* self,
+    GQueue* dead)
+{
+    /* Caller holds the mutex, entries get unmapped outside of it */
+    while (self->idle.length > self->max_idle) {
+        GList* link = g_queue_pop_tail_link(&self->idle);
+
+        gbinder_memory_cache_drop_locked(self, link->data);
+        g_queue_push_tail_link(dead, link);
+    }
+}
+
+static
+void
+gbinder_memory_cache_view_free(
+    gpointer data)
+{
+    GBinderMemoryCacheEntry* entry = data;
+    GBinderMemoryCache* self = entry->cache;
+
+    if (self) {
+        GQueue dead = G_QUEUE_INIT;
+
+        /* Lock */
+        g_mutex_lock(&self->mutex);
+        if (!--entry->views) {
+            if (entry->cached) {
+                g_queue_push_head_link(&self->idle, &entry->link);
+                gbinder_memory_cache_trim_locked(self, &dead);
+            } else {
+                g_queue_push_tail_link(&dead, &entry->link);
+            }
+        }
+        g_mutex_unlock(&self->mutex);
+        /* Unlock */
+
+        gbinder_memory_cache_free_entries(&dead);
+        gbinder_memory_cache_unref(self);
+    } else {
+        gbinder_memory_cache_entry_free(entry);
+    }
+}
+
+static
+GBytes*
+gbinder_memory_cache_view_new(
+    GBinderMemoryCacheEntry* entry,
+    gsize size)
+{
+    return g_bytes_new_with_free_func(entry->ptr, size,
+        gbinder_memory_cache_view_free, entry);
+}
+
+/*==========================================================================*
+ * Interface
+ *==========================================================================*/
+
+GBinderMemoryCache*
+gbinder_memory_cache_new(
+    guint max_idle)
+{
+    GBinderMemoryCache* self = g_slice_new0(GBinderMemoryCache);
+
+    g_atomic_int_set(&self->refcount, 1);
+    g_mutex_init(&self->mutex);
+    g_queue_init(&self->idle);
+    self->table = g_hash_table_new(gbinder_memory_cache_key_hash,
+        gbinder_memory_cache_key_equal);
+    self->max_idle = max_idle;
+    return self;
+}
+
+GBinderMemoryCache*
+gbinder_memory_cache_ref(
+    GBinderMemoryCache* self)
+{
+    if (G_LIKELY(self)) {
+        GASSERT(self->refcount > 0);
+        g_atomic_int_inc(&self->refcount);
+    }
+    return self;
+}
+
+void
+gbinder_memory_cache_unref(
+    GBinderMemoryCache* self)
+{
+    if (G_LIKELY(self)) {
+        GASSERT(self->refcount > 0);
+        if (g_atomic_int_dec_and_test(&self->refcount)) {
+            /* Each view holds a reference, only idle entries are left */
+            GASSERT(g_hash_table_size(self->table) == self->idle.length);
+            gbinder_memory_cache_free_entries(&self->idle);
+            g_hash_table_destroy(self->table);
+            g_mutex_clear(&self->mutex);
+            g_slice_free(GBinderMemoryCache, self);
+        }
+    }
+}
+
+void
+gbinder_memory_cache_set_max_idle(
+    GBinderMemoryCache* self,
+    guint max_idle)
+{
+    if (G_LIKELY(self)) {
+        GQueue dead = G_QUEUE_INIT;
+
+        /* Lock */
+        g_mutex_lock(&self->mutex);
+        self->max_idle = max_idle;
+        gbinder_memory_cache_trim_locked(self, &dead);
+        g_mutex_unlock(&self->mutex);
+        /* Unlock */
+
+        gbinder_memory_cache_free_entries(&dead);
+    }
+}
+
+GBytes*
+gbinder_memory_cache_map(
+    GBinderMemoryCache* self,
+    int fd,
+    gsize size)
+{
+    GBinderMemoryCacheEntry* entry;
+    struct stat st;
+
+    if (!size) {
+        return NULL;
+    } else if (fstat(fd, &st) < 0) {
+        GWARN("Failed to stat fd %d: %s", fd, strerror(errno));
+        return NULL;
+    } else if (S_ISREG(st.st_mode) && (st.st_size < 0 ||
+        (guint64)st.st_size < size)) {
+        /* Touching the pages past the end of the file would SIGBUS */
+        GWARN("Shared memory fd %d is too small", fd);
+        return NULL;
+    }
+
+    /*
+     * Other kinds of files (e.g. ashmem devices) don't necessarily
+     * have a unique inode per region, those are always mapped anew.
+     */
+    if (self && S_ISREG(st.st_mode)) {
+        GQueue dead = G_QUEUE_INIT;
+        GBinderMemoryCacheKey key;
+
+        key.dev = st.st_dev;
+        key.ino = st.st_ino;
+
+        /* Lock */
+        g_mutex_lock(&self->mutex);
+        entry = g_hash_table_lookup(self->table, &key);
+        if (entry && entry->size < size) {
+            /* The region has grown, the old mapping is too short */
+            gbinder_memory_cache_drop_locked(self, entry);
+            if (!entry->views) {
+                g_queue_unlink(&self->idle, &entry->link);
+                g_queue_push_tail_link(&dead, &entry->link);
+            }
+            entry = NULL;
+        }
+        if (entry) {
+            if (!entry->views++) {
+                g_queue_unlink(&self->idle, &entry->link);
+            }
+        } else {
+            entry = gbinder_memory_cache_entry_new(fd, size);
+            if (entry) {
+                entry->key = key;
+                entry->cache = self;
+                entry->cached = TRUE;
+                g_hash_table_insert(self->table, &entry->key, entry);
+            }
+        }
+        if (entry) {
+            /* Released by gbinder_memory_cache_view_free */
+            gbinder_memory_cache_ref(self);
+        }
+        g_mutex_unlock(&self->mutex);
+        /* Unlock */
+
+        gbinder_memory_cache_free_entries(&dead);
+    } else {
+        entry = gbinder_memory_cache_entry_new(fd, size);
+    }
+    return entry ? gbinder_memory_cache_view_new(entry, size) : NULL;
+}
+
+guint
+gbinder_memory_cache_count(
+    GBinderMemoryCache* self)
+{
+    guint count = 0;
+
+    if (G_LIKELY(self)) {
+        /* Lock */
+        g_mutex_lock(&self->mutex);
+        count = g_hash_table_size(self->table);
+        g_mutex_unlock(&self->mutex);
+        /* Unlock */
+    }
+    return count;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
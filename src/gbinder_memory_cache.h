@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GBINDER_MEMORY_CACHE_H
+#define GBINDER_MEMORY_CACHE_H
+
+#include "gbinder_types_p.h"
+
+/*
+ * Read-only mappings of shared memory regions received over binder,
+ * keyed by device and inode. Mappings stay alive while there are views
+ * (GBytes) referencing them, plus up to max_idle most recently released
+ * ones are kept around in case the same region arrives again.
+ */
+GBinderMemoryCache*
+gbinder_memory_cache_new(
+    guint max_idle)
+    GBINDER_INTERNAL;
+
+GBinderMemoryCache*
+gbinder_memory_cache_ref(
+    GBinderMemoryCache* cache)
+    GBINDER_INTERNAL;
+
+void
+gbinder_memory_cache_unref(
+    GBinderMemoryCache* cache)
+    GBINDER_INTERNAL;
+
+void
+gbinder_memory_cache_set_max_idle(
+    GBinderMemoryCache* cache,
+    guint max_idle)
+    GBINDER_INTERNAL;
+
+/* NULL cache (or fd which isn't a regular file) maps the memory uncached */
+GBytes*
+gbinder_memory_cache_map(
+    GBinderMemoryCache* cache,
+    int fd,
+    gsize size)
+    G_GNUC_WARN_UNUSED_RESULT
+    GBINDER_INTERNAL;
+
+/* Only used by unit tests */
+guint
+gbinder_memory_cache_count(
+    GBinderMemoryCache* cache)
+    GBINDER_INTERNAL;
+
+#endif /* GBINDER_MEMORY_CACHE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
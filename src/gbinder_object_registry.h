@@ -33,7 +33,7 @@
 #ifndef GBINDER_OBJECT_REGISTRY_H
 #define GBINDER_OBJECT_REGISTRY_H
 
-#include "gbinder_types_p.h"
+#include "gbinder_memory_cache.h"
 
 typedef enum gbinder_remote_registry_create {
     REMOTE_REGISTRY_DONT_CREATE,
@@ -48,6 +48,11 @@ typedef struct gbinder_object_registry_functions {
         void* pointer);
     GBinderRemoteObject* (*get_remote)(GBinderObjectRegistry* reg,
         guint32 handle, REMOTE_REGISTRY_CREATE create);
+    /* Optional, returns NULL if the string can't be interned */
+    const char* (*intern_iface)(GBinderObjectRegistry* reg,
+        const gunichar2* utf16, gsize len);
+    /* Optional, returns NULL if the memory can't be mapped */
+    GBytes* (*map_memory)(GBinderObjectRegistry* reg, int fd, gsize size);
 } GBinderObjectRegistryFunctions;
 
 struct gbinder_object_registry {
@@ -93,6 +98,29 @@ gbinder_object_registry_get_remote(
     return reg ? reg->f->get_remote(reg, handle, create) : NULL;
 }
 
+GBINDER_INLINE_FUNC
+const char*
+gbinder_object_registry_intern_iface(
+    GBinderObjectRegistry* reg,
+    const gunichar2* utf16,
+    gsize len)
+{
+    return (reg && reg->f->intern_iface) ?
+        reg->f->intern_iface(reg, utf16, len) : NULL;
+}
+
+GBINDER_INLINE_FUNC
+GBytes*
+gbinder_object_registry_map_memory(
+    GBinderObjectRegistry* reg,
+    int fd,
+    gsize size)
+{
+    return (reg && reg->f->map_memory) ?
+        reg->f->map_memory(reg, fd, size) :
+        gbinder_memory_cache_map(NULL, fd, size);
+}
+
 #endif /* GBINDER_OBJECT_REGISTRY_H */
 
 /*
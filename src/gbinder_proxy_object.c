@@ -43,6 +43,7 @@
 #include "gbinder_object_registry.h"
 #include "gbinder_driver.h"
 #include "gbinder_ipc.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_log.h"
 
 #include <gutil_macros.h>
@@ -57,11 +58,14 @@ struct gbinder_proxy_tx {
     GBinderRemoteRequest* req;
     GBinderProxyObject* proxy;
     gulong id;
+    guint32 code;
+    guint32 flags;
+    gint64 start;
 };
 
 struct gbinder_proxy_object_priv {
     gboolean acquired;
-    gboolean dropped;
+    gint dropped;
     GBinderProxyTx* tx;
 };
 
@@ -74,6 +78,155 @@ G_DEFINE_TYPE(GBinderProxyObject, gbinder_proxy_object, \
 #define THIS_TYPE GBINDER_TYPE_PROXY_OBJECT
 #define PARENT_CLASS gbinder_proxy_object_parent_class
 
+/*
+ * Maps (src, remote ipc, handle) to the proxy object. Parcels passing
+ * through the proxy tend to carry the same binders over and over again
+ * (e.g. callbacks), this cache allows to find the matching proxy without
+ * going through the object registries. Entries hold weak references,
+ * and get removed when the proxy is finalized.
+ */
+typedef struct gbinder_proxy_object_cache_key {
+    GBinderIpc* src;
+    GBinderIpc* remote;
+    guint32 handle;
+} GBinderProxyObjectCacheKey;
+
+typedef struct gbinder_proxy_object_cache_entry {
+    GBinderProxyObjectCacheKey key;
+    GBinderProxyObject* proxy; /* Only for comparison, not a reference */
+    GWeakRef ref;
+} GBinderProxyObjectCacheEntry;
+
+static GMutex gbinder_proxy_object_cache_mutex;
+static GHashTable* gbinder_proxy_object_cache = NULL;
+
+/*==========================================================================*
+ * Cache
+ *==========================================================================*/
+
+static
+guint
+gbinder_proxy_object_cache_hash(
+    gconstpointer data)
+{
+    const GBinderProxyObjectCacheKey* key = data;
+
+    return (g_direct_hash(key->src) * 31 + g_direct_hash(key->remote)) * 31 +
+        key->handle;
+}
+
+static
+gboolean
+gbinder_proxy_object_cache_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const GBinderProxyObjectCacheKey* k1 = a;
+    const GBinderProxyObjectCacheKey* k2 = b;
+
+    return k1->src == k2->src && k1->remote == k2->remote &&
+        k1->handle == k2->handle;
+}
+
+static
+void
+gbinder_proxy_object_cache_entry_free(
+    gpointer data)
+{
+    GBinderProxyObjectCacheEntry* entry = data;
+
+    g_weak_ref_clear(&entry->ref);
+    gutil_slice_free(entry);
+}
+
+static
+GBinderProxyObject*
+gbinder_proxy_object_cache_lookup(
+    GBinderIpc* src,
+    GBinderIpc* remote,
+    guint32 handle)
+{
+    GBinderProxyObject* proxy = NULL;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_proxy_object_cache_mutex);
+    if (gbinder_proxy_object_cache) {
+        GBinderProxyObjectCacheKey key;
+        GBinderProxyObjectCacheEntry* entry;
+
+        key.src = src;
+        key.remote = remote;
+        key.handle = handle;
+        entry = g_hash_table_lookup(gbinder_proxy_object_cache, &key);
+        if (entry) {
+            /* NULL if the proxy is being finalized */
+            proxy = g_weak_ref_get(&entry->ref);
+        }
+    }
+    g_mutex_unlock(&gbinder_proxy_object_cache_mutex);
+    /* Unlock */
+    return proxy;
+}
+
+static
+void
+gbinder_proxy_object_cache_add(
+    GBinderProxyObject* proxy)
+{
+    GBinderProxyObjectCacheEntry* entry =
+        g_slice_new0(GBinderProxyObjectCacheEntry);
+    GBinderRemoteObject* remote = proxy->remote;
+
+    entry->key.src = proxy->parent.ipc;
+    entry->key.remote = remote->ipc;
+    entry->key.handle = remote->handle;
+    entry->proxy = proxy;
+    g_weak_ref_init(&entry->ref, proxy);
+
+    /* Lock */
+    g_mutex_lock(&gbinder_proxy_object_cache_mutex);
+    if (!gbinder_proxy_object_cache) {
+        gbinder_proxy_object_cache = g_hash_table_new_full
+            (gbinder_proxy_object_cache_hash,
+                gbinder_proxy_object_cache_equal, NULL,
+                gbinder_proxy_object_cache_entry_free);
+    }
+    /* The newest proxy wins */
+    g_hash_table_replace(gbinder_proxy_object_cache, &entry->key, entry);
+    g_mutex_unlock(&gbinder_proxy_object_cache_mutex);
+    /* Unlock */
+}
+
+static
+void
+gbinder_proxy_object_cache_remove(
+    GBinderProxyObject* proxy)
+{
+    /* Lock */
+    g_mutex_lock(&gbinder_proxy_object_cache_mutex);
+    if (gbinder_proxy_object_cache) {
+        GBinderRemoteObject* remote = proxy->remote;
+        GBinderProxyObjectCacheKey key;
+        GBinderProxyObjectCacheEntry* entry;
+
+        key.src = proxy->parent.ipc;
+        key.remote = remote->ipc;
+        key.handle = remote->handle;
+        entry = g_hash_table_lookup(gbinder_proxy_object_cache, &key);
+
+        /* The entry may have been taken over by another proxy */
+        if (entry && entry->proxy == proxy) {
+            g_hash_table_remove(gbinder_proxy_object_cache, &key);
+            if (!g_hash_table_size(gbinder_proxy_object_cache)) {
+                g_hash_table_destroy(gbinder_proxy_object_cache);
+                gbinder_proxy_object_cache = NULL;
+            }
+        }
+    }
+    g_mutex_unlock(&gbinder_proxy_object_cache_mutex);
+    /* Unlock */
+}
+
 /*==========================================================================*
  * Converter
  *==========================================================================*/
@@ -82,6 +235,7 @@ typedef struct gbinder_proxy_object_converter {
     GBinderObjectConverter pub;
     GBinderIpc* remote;
     GBinderIpc* local;
+    gboolean looper;
 } GBinderProxyObjectConverter;
 
 GBINDER_INLINE_FUNC
@@ -113,15 +267,32 @@ gbinder_proxy_object_converter_handle_to_local(
     guint32 handle)
 {
     GBinderProxyObjectConverter* c = gbinder_proxy_object_converter_cast(pub);
-    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(c->remote);
-    GBinderRemoteObject* remote = gbinder_object_registry_get_remote(reg,
-        handle, REMOTE_REGISTRY_CAN_CREATE /* but don't acquire */);
-    GBinderLocalObject* local = gbinder_ipc_find_local_object(c->local,
-        gbinder_proxy_object_converter_check, remote);
+    GBinderProxyObject* proxy = gbinder_proxy_object_cache_lookup(c->local,
+        c->remote, handle);
+    GBinderObjectRegistry* reg;
+    GBinderRemoteObject* remote;
+    GBinderLocalObject* local;
+
+    if (proxy) {
+        if (!proxy->remote->dead) {
+            /* Seen this one before */
+            return &proxy->parent;
+        }
+        /* Let the registry figure it out */
+        g_object_unref(proxy);
+    }
 
+    reg = gbinder_ipc_object_registry(c->remote);
+    remote = gbinder_object_registry_get_remote(reg, handle,
+        REMOTE_REGISTRY_CAN_CREATE /* but don't acquire */);
+    local = gbinder_ipc_find_local_object(c->local,
+        gbinder_proxy_object_converter_check, remote);
     if (!local && !remote->dead) {
         /* GBinderProxyObject will reference GBinderRemoteObject */
         local = &gbinder_proxy_object_new(c->local, remote)->parent;
+
+        /* Auto-created proxies forward calls the same way */
+        gbinder_local_object_set_looper_dispatch(local, c->looper);
     }
 
     /* Release the reference returned by gbinder_object_registry_get_remote */
@@ -147,6 +318,7 @@ gbinder_proxy_object_converter_init(
     memset(convert, 0, sizeof(*convert));
     convert->remote = remote;
     convert->local = local;
+    convert->looper = gbinder_local_object_looper_dispatch(&proxy->parent);
     pub->f = &gbinder_converter_fn;
     pub->io = gbinder_ipc_io(dest);
     pub->protocol = gbinder_ipc_protocol(dest);
@@ -209,6 +381,10 @@ gbinder_proxy_tx_reply(
      */
     gbinder_proxy_object_converter_init(&convert, self, ipc, self->parent.ipc);
     fwd = gbinder_remote_reply_convert_to_local(reply, &convert.pub);
+    if (tx->start) {
+        gbinder_stats_forwarded(self->parent.ipc->dev, tx->code, tx->flags,
+            tx->req, fwd, status, tx->start);
+    }
     tx->id = 0;
     gbinder_proxy_tx_dequeue(tx);
     gbinder_remote_request_complete(tx->req, fwd,
@@ -236,6 +412,67 @@ gbinder_proxy_tx_destroy(
     gutil_slice_free(tx);
 }
 
+static
+void
+gbinder_proxy_object_dead_reply(
+    gpointer remote)
+{
+    gbinder_remote_object_commit_suicide(remote);
+}
+
+static
+GBinderLocalReply*
+gbinder_proxy_object_forward_sync(
+    GBinderProxyObject* self,
+    const GBinderIpcSyncApi* api,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status)
+{
+    GBinderLocalObject* object = &self->parent;
+    GBinderRemoteObject* remote = self->remote;
+    GBinderProxyObjectConverter convert;
+    GBinderLocalRequest* fwd;
+    GBinderLocalReply* reply = NULL;
+    int ret = GBINDER_STATUS_OK;
+    const gint64 start = gbinder_stats_begin();
+
+    /* See gbinder_proxy_object_handle_transaction() */
+    gbinder_proxy_object_converter_init(&convert, self, object->ipc,
+        remote->ipc);
+    fwd = gbinder_remote_request_convert_to_local(req, &convert.pub);
+    if (flags & GBINDER_TX_FLAG_ONEWAY) {
+        /* Nobody is waiting for the result */
+        ret = api->sync_oneway(remote->ipc, remote->handle, code, fwd);
+        *status = GBINDER_STATUS_OK;
+    } else {
+        GBinderRemoteReply* rr = api->sync_reply(remote->ipc, remote->handle,
+            code, fwd, &ret);
+
+        if (rr) {
+            /* See gbinder_proxy_tx_reply() */
+            gbinder_proxy_object_converter_init(&convert, self, remote->ipc,
+                object->ipc);
+            reply = gbinder_remote_reply_convert_to_local(rr, &convert.pub);
+            gbinder_remote_reply_unref(rr);
+        }
+        *status = (ret > 0) ? (-EFAULT) : ret;
+    }
+    if (start) {
+        gbinder_stats_forwarded(object->ipc->dev, code, flags, req, reply,
+            ret, start);
+    }
+    if (ret == GBINDER_STATUS_DEAD_OBJECT) {
+        /* Obituaries are handled on the main thread */
+        gbinder_ipc_invoke_later(object->ipc, gbinder_proxy_object_dead_reply,
+            gbinder_remote_object_ref(remote), (GDestroyNotify)
+            gbinder_remote_object_unref);
+    }
+    gbinder_local_request_unref(fwd);
+    return reply;
+}
+
 static
 GBinderLocalReply*
 gbinder_proxy_object_handle_transaction(
@@ -249,13 +486,36 @@ gbinder_proxy_object_handle_transaction(
     GBinderProxyObjectPriv* priv = self->priv;
     GBinderRemoteObject* remote = self->remote;
 
-    if (!priv->dropped && !remote->dead) {
+    if (g_atomic_int_get(&priv->dropped) || remote->dead) {
+        GVERBOSE_("dropped: %d dead:%d", priv->dropped, remote->dead);
+        *status = (-EBADMSG);
+    } else if (gbinder_local_object_looper_dispatch(object)) {
+        /*
+         * We are on the looper thread which has received the request.
+         * Forward it synchronously from here and let the looper send
+         * the reply, without involving the main thread at all.
+         */
+        return gbinder_proxy_object_forward_sync(self,
+            &gbinder_ipc_sync_worker, req, code, flags, status);
+    } else if (flags & GBINDER_TX_FLAG_ONEWAY) {
+        /*
+         * One-way transactions don't block, write it to the driver right
+         * away. There's no reply to wait for and nothing to keep track of.
+         * Incoming transactions are handled by the main thread one by one,
+         * so the order of calls is preserved.
+         */
+        return gbinder_proxy_object_forward_sync(self,
+            &gbinder_ipc_sync_main, req, code, flags, status);
+    } else {
         GBinderLocalRequest* fwd;
         GBinderProxyTx* tx = g_slice_new0(GBinderProxyTx);
         GBinderProxyObjectConverter convert;
 
         g_object_ref(tx->proxy = self);
         tx->req = gbinder_remote_request_ref(req);
+        tx->code = code;
+        tx->flags = flags;
+        tx->start = gbinder_stats_begin();
         tx->next = priv->tx;
         priv->tx = tx;
 
@@ -276,9 +536,6 @@ gbinder_proxy_object_handle_transaction(
             fwd, gbinder_proxy_tx_reply, gbinder_proxy_tx_destroy, tx);
         gbinder_local_request_unref(fwd);
         *status = GBINDER_STATUS_OK;
-    } else {
-        GVERBOSE_("dropped: %d dead:%d", priv->dropped, remote->dead);
-        *status = (-EBADMSG);
     }
     return NULL;
 }
@@ -290,7 +547,7 @@ gbinder_proxy_object_can_handle_transaction(
     const char* iface,
     guint code)
 {
-    /* Process all transactions on the main thread */
+    /* Main thread, unless looper dispatch is enabled for this proxy */
     return GBINDER_LOCAL_TRANSACTION_SUPPORTED;
 }
 
@@ -319,7 +576,7 @@ gbinder_proxy_object_drop(
     GBinderProxyObject* self = THIS(object);
     GBinderProxyObjectPriv* priv = self->priv;
 
-    priv->dropped = TRUE;
+    g_atomic_int_set(&priv->dropped, TRUE);
     GBINDER_LOCAL_OBJECT_CLASS(PARENT_CLASS)->drop(object);
 }
 
@@ -348,6 +605,7 @@ gbinder_proxy_object_new(
             GDEBUG("Proxy %p %s => %u %s created", self, gbinder_ipc_name(src),
                 remote->handle, gbinder_ipc_name(remote->ipc));
             self->remote = gbinder_remote_object_ref(remote);
+            gbinder_proxy_object_cache_add(self);
             return self;
         }
     }
@@ -376,6 +634,7 @@ gbinder_proxy_object_finalize(
      * on the performance because finalizing a proxy is not supposed to be a
      * frequent operation.
      */
+    gbinder_proxy_object_cache_remove(self);
     gbinder_ipc_invalidate_local_object(local->ipc, local);
     if (priv->acquired) {
         gbinder_driver_release(remote->ipc->driver, remote->handle);
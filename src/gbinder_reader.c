@@ -32,11 +32,14 @@
 
 #include "gbinder_reader_p.h"
 #include "gbinder_buffer_p.h"
-#include "gbinder_io.h"
+#include "gbinder_fmq_p.h"
+#include "gbinder_io_fixed.h"
+#include "gbinder_memory_cache.h"
 #include "gbinder_object_registry.h"
 #include "gbinder_log.h"
 
 #include <gutil_macros.h>
+#include <gutil_misc.h>
 
 #include <errno.h>
 #include <fcntl.h>
@@ -51,11 +54,33 @@ typedef struct gbinder_reader_priv {
 
 G_STATIC_ASSERT(sizeof(GBinderReader) >= sizeof(GBinderReaderPriv));
 
+/* These are used by the inline functions in gbinder_reader.h */
+G_STATIC_ASSERT(G_STRUCT_OFFSET(GBinderReaderPriv, end) ==
+    G_STRUCT_OFFSET(GBinderReader, d) + sizeof(gconstpointer));
+G_STATIC_ASSERT(G_STRUCT_OFFSET(GBinderReaderPriv, ptr) ==
+    G_STRUCT_OFFSET(GBinderReader, d) + 2 * sizeof(gconstpointer));
+
 static inline GBinderReaderPriv* gbinder_reader_cast(GBinderReader* reader)
     { return (GBinderReaderPriv*)reader; }
 static inline const GBinderReaderPriv* gbinder_reader_cast_c
     (const GBinderReader* reader)  { return (GBinderReaderPriv*)reader; }
 
+/*
+ * NULL and empty arrays are returned as a pointer which may not point
+ * into the buffer at all, those don't need to reference anything.
+ */
+static
+GBytes*
+gbinder_reader_bytes(
+    const GBinderReaderPriv* p,
+    const void* data,
+    gsize size)
+{
+    return size ? gbinder_buffer_contents_bytes(p->data ?
+        gbinder_buffer_contents(p->data->buffer) : NULL, data, size) :
+        g_bytes_new(NULL, 0);
+}
+
 void
 gbinder_reader_init(
     GBinderReader* reader,
@@ -311,8 +336,9 @@ gbinder_reader_read_fd(
 
     if (gbinder_reader_can_read_object(p)) {
         int fd;
-        const guint eaten = p->data->reg->io->decode_fd_object(p->ptr,
-            gbinder_reader_bytes_remaining(reader), &fd);
+        const guint eaten = GBINDER_IO_CALL(p->data->reg->io,
+            decode_fd_object)(p->ptr, gbinder_reader_bytes_remaining(reader),
+                &fd);
 
         if (eaten) {
             GASSERT(fd >= 0);
@@ -324,12 +350,11 @@ gbinder_reader_read_fd(
     return -1;
 }
 
+static
 int
-gbinder_reader_read_dup_fd(
-    GBinderReader* reader) /* Since 1.0.18 */
+gbinder_reader_dup_fd(
+    int fd)
 {
-    const int fd = gbinder_reader_read_fd(reader);
-
     if (fd >= 0) {
         const int dupfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
 
@@ -342,6 +367,26 @@ gbinder_reader_read_dup_fd(
     return -1;
 }
 
+int
+gbinder_reader_read_dup_fd(
+    GBinderReader* reader) /* Since 1.0.18 */
+{
+    return gbinder_reader_dup_fd(gbinder_reader_read_fd(reader));
+}
+
+int
+gbinder_reader_take_fd(
+    GBinderReader* reader) /* Since 1.1.25 */
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+    const void* obj = p->ptr;
+    const int fd = gbinder_reader_read_fd(reader);
+
+    /* Fall back to dup() if the buffer can't give the fd away */
+    return (fd >= 0 && gbinder_buffer_take_fd(p->data->buffer, obj)) ? fd :
+        gbinder_reader_dup_fd(fd);
+}
+
 gboolean
 gbinder_reader_read_nullable_object(
     GBinderReader* reader,
@@ -351,8 +396,9 @@ gbinder_reader_read_nullable_object(
 
     if (gbinder_reader_can_read_object(p)) {
         const GBinderReaderData* data = p->data;
-        const guint eaten = data->reg->io->decode_binder_object(p->ptr,
-            gbinder_reader_bytes_remaining(reader), data->reg, out);
+        const guint eaten = GBINDER_IO_CALL(data->reg->io,
+            decode_binder_object)(p->ptr,
+                gbinder_reader_bytes_remaining(reader), data->reg, out);
 
         if (eaten) {
             p->ptr += eaten;
@@ -387,7 +433,8 @@ gbinder_reader_read_buffer_object(
         GBinderBuffer* buf = data->buffer;
         const GBinderIo* io = data->reg->io;
         const gsize offset = p->ptr - (guint8*)buf->data;
-        const guint eaten = io->decode_buffer_object(buf, offset, out);
+        const guint eaten = GBINDER_IO_CALL(io, decode_buffer_object)
+            (buf, offset, out);
 
         if (eaten) {
             p->ptr += eaten;
@@ -454,6 +501,31 @@ gbinder_reader_read_parcelable(
     return NULL;
 }
 
+gboolean
+gbinder_reader_read_parcelable_reader(
+    GBinderReader* reader,
+    GBinderReader* parcelable) /* Since 1.1.25 */
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+    GBinderReaderPriv* pp = gbinder_reader_cast(parcelable);
+    gsize size;
+    const guint8* ptr = gbinder_reader_read_parcelable(reader, &size);
+
+    if (ptr) {
+        /* The parcelable may contain objects, the outer reader skips them */
+        memcpy(pp, p, sizeof(*pp));
+        pp->ptr = ptr;
+        pp->end = p->ptr;
+        while (p->objects && p->objects[0] &&
+            (const guint8*)p->objects[0] < p->ptr) {
+            p->objects++;
+        }
+        return TRUE;
+    }
+    gbinder_reader_copy(parcelable, NULL);
+    return FALSE;
+}
+
 /* Helper for gbinder_reader_read_hidl_struct() macro */
 const void*
 gbinder_reader_read_hidl_struct1(
@@ -506,6 +578,29 @@ gbinder_reader_read_hidl_vec(
     return out;
 }
 
+/*
+ * Same as gbinder_reader_read_hidl_vec but the data is exported as
+ * GBytes which may outlive the parcel.
+ */
+GBytes*
+gbinder_reader_read_hidl_vec_bytes(
+    GBinderReader* reader,
+    gsize* count,
+    gsize* elemsize) /* Since 1.1.25 */
+{
+    gsize n = 0, size = 0;
+    const void* data = gbinder_reader_read_hidl_vec(reader, &n, &size);
+
+    if (count) {
+        *count = n;
+    }
+    if (elemsize) {
+        *elemsize = size;
+    }
+    return data ? gbinder_reader_bytes(gbinder_reader_cast(reader),
+        data, n * size) : NULL;
+}
+
 /* Helper for gbinder_reader_read_hidl_struct_vec() macro */
 const void*
 gbinder_reader_read_hidl_vec1(
@@ -520,9 +615,15 @@ gbinder_reader_read_hidl_vec1(
     return (data && (actual == expected_elem_size || !actual)) ? data : NULL;
 }
 
+/*
+ * Returns the string pointing to the parcel data, NUL-terminated, and
+ * its length as stored in the hidl_string descriptor. The length is
+ * zeroed on error.
+ */
 const char*
-gbinder_reader_read_hidl_string_c(
-    GBinderReader* reader) /* Since 1.0.23 */
+gbinder_reader_read_hidl_string_len(
+    GBinderReader* reader,
+    gsize* len) /* Since 1.1.25 */
 {
     GBinderIoBufferObject obj;
 
@@ -536,24 +637,47 @@ gbinder_reader_read_hidl_string_c(
             obj.data == str->data.str &&
             obj.size == str->len + 1 &&
             str->data.str[str->len] == 0) {
+            if (len) {
+                *len = str->len;
+            }
             return str->data.str;
         }
     }
+    if (len) {
+        *len = 0;
+    }
     return NULL;
 }
 
+const char*
+gbinder_reader_read_hidl_string_c(
+    GBinderReader* reader) /* Since 1.0.23 */
+{
+    return gbinder_reader_read_hidl_string_len(reader, NULL);
+}
+
 char*
 gbinder_reader_read_hidl_string(
     GBinderReader* reader)
 {
+    gsize len;
+    const char* str = gbinder_reader_read_hidl_string_len(reader, &len);
+
     /* This function should've been called gbinder_reader_dup_hidl_string */
-    return g_strdup(gbinder_reader_read_hidl_string_c(reader));
+    return str ? gutil_memdup(str, len + 1) : NULL;
 }
 
-char**
-gbinder_reader_read_hidl_string_vec(
-    GBinderReader* reader)
+/*
+ * Validates hidl_vec<hidl_string> and returns the array of strings
+ * pointing to the parcel data, all NUL-terminated. NULL on error.
+ */
+static
+const GBinderHidlString*
+gbinder_reader_read_hidl_string_vec_data(
+    GBinderReader* reader,
+    guint* count)
 {
+    static const GBinderHidlString empty = { { 0 } };
     GBinderIoBufferObject obj;
 
     /* First buffer contains hidl_vector */
@@ -565,7 +689,8 @@ gbinder_reader_read_hidl_string_vec(
 
         if (!next && !n) {
             /* Should this be considered an error? */
-            return g_new0(char*, 1);
+            *count = 0;
+            return &empty;
         } else if (gbinder_reader_read_buffer_object(reader, &obj) &&
                    /* The second buffer (if any) contains n hidl_string's */
                    obj.parent_offset == GBINDER_HIDL_VEC_BUFFER_OFFSET &&
@@ -573,7 +698,6 @@ gbinder_reader_read_hidl_string_vec(
                    obj.data == next &&
                    obj.size == (sizeof(GBinderHidlString) * n)) {
             const GBinderHidlString* strings = obj.data;
-            GPtrArray* list = g_ptr_array_sized_new(n + 1);
             guint i;
 
             /* Now we expect n buffers containing the actual data */
@@ -587,10 +711,7 @@ gbinder_reader_read_hidl_string_vec(
                     obj.data == s->data.str &&
                     obj.size == s->len + 1 &&
                     s->data.str[s->len] == 0) {
-                    char* name = g_strdup(s->data.str);
-
-                    g_ptr_array_add(list, name);
-                    GVERBOSE_("%u. %s", i + 1, name);
+                    GVERBOSE_("%u. %s", i + 1, s->data.str);
                 } else {
                     GWARN("Unexpected hidl_string buffer %p/%u vs %p/%u",
                         obj.data, (guint)obj.size, s->data.str, s->len);
@@ -599,18 +720,276 @@ gbinder_reader_read_hidl_string_vec(
             }
 
             if (i == n) {
-                g_ptr_array_add(list, NULL);
-                return (char**)g_ptr_array_free(list, FALSE);
+                *count = n;
+                return strings;
             }
-
-            g_ptr_array_set_free_func(list, g_free);
-            g_ptr_array_free(list, TRUE);
         }
     }
     GWARN("Invalid hidl_vec<string>");
     return NULL;
 }
 
+char**
+gbinder_reader_read_hidl_string_vec(
+    GBinderReader* reader)
+{
+    guint i, n;
+    const GBinderHidlString* strings =
+        gbinder_reader_read_hidl_string_vec_data(reader, &n);
+
+    if (strings) {
+        char** out = g_new(char*, n + 1);
+
+        for (i = 0; i < n; i++) {
+            out[i] = g_strdup(strings[i].data.str);
+        }
+        out[i] = NULL;
+        return out;
+    }
+    return NULL;
+}
+
+const char**
+gbinder_reader_read_hidl_string_vec_c(
+    GBinderReader* reader,
+    gsize* count) /* Since 1.1.25 */
+{
+    guint i, n;
+    const GBinderHidlString* strings =
+        gbinder_reader_read_hidl_string_vec_data(reader, &n);
+
+    if (strings) {
+        /* Single allocation, the strings point to the parcel data */
+        const char** out = g_new(const char*, n + 1);
+
+        for (i = 0; i < n; i++) {
+            out[i] = strings[i].data.str;
+        }
+        out[i] = NULL;
+        if (count) {
+            *count = n;
+        }
+        return out;
+    }
+    if (count) {
+        *count = 0;
+    }
+    return NULL;
+}
+
+static
+gboolean
+gbinder_reader_read_fda_object(
+    GBinderReader* reader,
+    guint* num_fds)
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+
+    if (gbinder_reader_can_read_object(p)) {
+        const guint eaten = GBINDER_IO_CALL(p->data->reg->io,
+            decode_fda_object)(p->ptr, gbinder_reader_bytes_remaining(reader),
+                num_fds);
+
+        if (eaten) {
+            p->ptr += eaten;
+            p->objects++;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * hidl_memory is followed by its native handle (size, buffer and fd
+ * array) and by the name buffer. The first fd is what gets mapped.
+ */
+GBytes*
+gbinder_reader_read_hidl_memory(
+    GBinderReader* reader) /* Since 1.1.25 */
+{
+    GBinderIoBufferObject obj;
+
+    if (gbinder_reader_read_buffer_object(reader, &obj) &&
+        obj.data && obj.size == sizeof(GBinderHidlMemory)) {
+        const GBinderHidlMemory* mem = obj.data;
+        const GBinderFds* fds = mem->data.fds;
+        const void* name = mem->name.data.str;
+        guint64 handle_size = 0;
+        guint num_fds = 0;
+
+        if (fds && mem->size <= G_MAXSIZE &&
+            gbinder_reader_read_uint64(reader, &handle_size) &&
+            handle_size >= sizeof(GBinderFds) &&
+            gbinder_reader_read_buffer_object(reader, &obj) &&
+            obj.data == fds && obj.size == handle_size && obj.has_parent &&
+            obj.parent_offset == GBINDER_HIDL_MEMORY_PTR_OFFSET &&
+            fds->num_fds > 0 && handle_size >= sizeof(GBinderFds) +
+            sizeof(int) * ((gsize)fds->num_fds + fds->num_ints) &&
+            gbinder_reader_read_fda_object(reader, &num_fds) &&
+            num_fds == fds->num_fds && (!name ||
+            (gbinder_reader_read_buffer_object(reader, &obj) &&
+            obj.data == name && obj.has_parent &&
+            obj.parent_offset == GBINDER_HIDL_MEMORY_NAME_OFFSET))) {
+            const GBinderReaderData* data = gbinder_reader_cast(reader)->data;
+
+            return gbinder_object_registry_map_memory(data->reg,
+                gbinder_fds_get_fd(fds, 0), (gsize)mem->size);
+        }
+    }
+    GWARN("Invalid hidl_memory");
+    return NULL;
+}
+
+#if GBINDER_FMQ_SUPPORTED
+
+/*
+ * MQDescriptor is followed by the grantors vector and the native handle
+ * (size, buffer and fd array), the way gbinder_writer_append_fmq_descriptor
+ * and Android's writeEmbeddedToParcel write it.
+ */
+GBinderFmq*
+gbinder_reader_read_fmq(
+    GBinderReader* reader) /* Since 1.1.25 */
+{
+    GBinderIoBufferObject obj;
+
+    if (gbinder_reader_read_buffer_object(reader, &obj) &&
+        obj.data && obj.size == sizeof(GBinderMQDescriptor)) {
+        const GBinderMQDescriptor* desc = obj.data;
+        const GBinderFds* fds = desc->data.fds;
+        const gsize vec_size = (gsize)desc->grantors.count *
+            sizeof(GBinderFmqGrantorDescriptor);
+        guint64 handle_size = 0;
+        guint num_fds = 0;
+
+        if (fds && desc->grantors.data.ptr &&
+            gbinder_reader_read_buffer_object(reader, &obj) &&
+            obj.data == desc->grantors.data.ptr && obj.size == vec_size &&
+            obj.has_parent &&
+            obj.parent_offset == GBINDER_MQ_DESCRIPTOR_GRANTORS_OFFSET &&
+            gbinder_reader_read_uint64(reader, &handle_size) &&
+            handle_size >= sizeof(GBinderFds) &&
+            gbinder_reader_read_buffer_object(reader, &obj) &&
+            obj.data == fds && obj.size == handle_size && obj.has_parent &&
+            obj.parent_offset == GBINDER_MQ_DESCRIPTOR_FDS_OFFSET &&
+            handle_size >= sizeof(GBinderFds) + sizeof(int) *
+            ((gsize)fds->num_fds + fds->num_ints) &&
+            gbinder_reader_read_fda_object(reader, &num_fds) &&
+            num_fds == fds->num_fds) {
+            return gbinder_fmq_new_from_descriptor(desc);
+        }
+    }
+    GWARN("Invalid MQDescriptor");
+    return NULL;
+}
+
+#endif /* GBINDER_FMQ_SUPPORTED */
+
+static
+gboolean
+gbinder_reader_read_hidl_schema_child(
+    GBinderReader* reader,
+    const void* ptr,
+    gsize size,
+    gsize parent_offset)
+{
+    GBinderIoBufferObject obj;
+
+    return gbinder_reader_read_buffer_object(reader, &obj) &&
+        obj.has_parent && obj.parent_offset == parent_offset &&
+        obj.data == ptr && obj.size == size;
+}
+
+/*
+ * The pointers have already been fixed up by the kernel, what remains
+ * is to make sure that the embedded buffers are where the struct says
+ * they are, in the order gbinder_writer_append_hidl_schema writes them.
+ */
+static
+gboolean
+gbinder_reader_read_hidl_schema_fields(
+    GBinderReader* reader,
+    const GBinderHidlSchema* schema,
+    const guint8* ptr,
+    gsize base)
+{
+    const GBinderHidlField* f;
+
+    for (f = schema->fields; f && f->type != GBINDER_HIDL_FIELD_END; f++) {
+        const guint8* field = ptr + f->offset;
+
+        switch (f->type) {
+        case GBINDER_HIDL_FIELD_STRING:
+            {
+                const GBinderHidlString* str = (const GBinderHidlString*)
+                    field;
+                const char* s = str->data.str;
+
+                if (!gbinder_reader_read_hidl_schema_child(reader, s,
+                    s ? (str->len + 1) : 0, base + f->offset +
+                    GBINDER_HIDL_STRING_BUFFER_OFFSET) ||
+                    (s && s[str->len])) {
+                    return FALSE;
+                }
+            }
+            break;
+        case GBINDER_HIDL_FIELD_VEC:
+            {
+                const GBinderHidlSchema* es = f->schema;
+                const GBinderHidlVec* vec = (const GBinderHidlVec*)field;
+                const guint8* elem = vec->data.ptr;
+
+                if ((!elem && vec->count) || !es->size ||
+                    vec->count > G_MAXSIZE / es->size ||
+                    !gbinder_reader_read_hidl_schema_child(reader, elem,
+                    elem ? (vec->count * es->size) : 0, base + f->offset +
+                    GBINDER_HIDL_VEC_BUFFER_OFFSET)) {
+                    return FALSE;
+                }
+                if (es->fields) {
+                    guint i;
+
+                    for (i = 0; i < vec->count; i++) {
+                        if (!gbinder_reader_read_hidl_schema_fields(reader,
+                            es, elem + i * es->size, i * es->size)) {
+                            return FALSE;
+                        }
+                    }
+                }
+            }
+            break;
+        case GBINDER_HIDL_FIELD_STRUCT:
+            if (!gbinder_reader_read_hidl_schema_fields(reader, f->schema,
+                field, base + f->offset)) {
+                return FALSE;
+            }
+            break;
+        case GBINDER_HIDL_FIELD_END:
+            break;
+        }
+    }
+    return TRUE;
+}
+
+const void*
+gbinder_reader_read_hidl_schema(
+    GBinderReader* reader,
+    const GBinderHidlSchema* schema) /* Since 1.1.25 */
+{
+    GBinderIoBufferObject obj;
+
+    if (G_LIKELY(schema) &&
+        gbinder_reader_read_buffer_object(reader, &obj) &&
+        obj.data && obj.size == schema->size) {
+        if (gbinder_reader_read_hidl_schema_fields(reader, schema,
+            obj.data, 0)) {
+            return obj.data;
+        }
+        GWARN("Unexpected embedded buffers");
+    }
+    return NULL;
+}
+
 const char*
 gbinder_reader_read_string8(
     GBinderReader* reader)
@@ -635,6 +1014,106 @@ gbinder_reader_read_string8(
     return NULL;
 }
 
+/*
+ * Decodes the next character, advances the index. Returns (gunichar)-1
+ * on an unpaired surrogate. Zero means either NULL character or the end
+ * of the input string (which is what g_utf16_to_utf8 does too).
+ */
+static
+gunichar
+gbinder_reader_utf16_next(
+    const gunichar2* utf16,
+    gsize len,
+    gsize* pos)
+{
+    const gsize i = *pos;
+
+    if (i < len) {
+        const gunichar2 c = utf16[i];
+
+        if (c < 0xd800 || c >= 0xe000) {
+            if (c) {
+                *pos = i + 1;
+            }
+            return c;
+        } else if (c < 0xdc00 && (i + 1) < len &&
+            utf16[i + 1] >= 0xdc00 && utf16[i + 1] < 0xe000) {
+            *pos = i + 2;
+            return 0x10000 + (((gunichar)(c - 0xd800)) << 10) +
+                (utf16[i + 1] - 0xdc00);
+        }
+        return (gunichar)-1;
+    }
+    return 0;
+}
+
+static
+char*
+gbinder_reader_utf16_to_utf8(
+    const gunichar2* utf16,
+    gsize len)
+{
+    gsize i, n = 0, pos = 0;
+    gunichar c;
+    char* utf8;
+    char* ptr;
+
+    /* Validate and calculate the size of the output first */
+    while ((c = gbinder_reader_utf16_next(utf16, len, &pos)) != 0) {
+        if (c == (gunichar)-1) {
+            return NULL;
+        }
+        n += (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+    }
+
+    ptr = utf8 = g_malloc(n + 1);
+    if (n == pos) {
+        /* ASCII only, one byte per character */
+        for (i = 0; i < n; i++) {
+            utf8[i] = (char)utf16[i];
+        }
+        ptr += n;
+    } else {
+        pos = 0;
+        while ((c = gbinder_reader_utf16_next(utf16, len, &pos)) != 0) {
+            ptr += g_unichar_to_utf8(c, ptr);
+        }
+    }
+    *ptr = 0;
+    return utf8;
+}
+
+static
+gboolean
+gbinder_reader_utf16_equal(
+    const gunichar2* utf16,
+    gsize len,
+    const char* utf8)
+{
+    const guint8* ptr = (const guint8*)utf8;
+    gsize pos = 0;
+    gunichar c;
+
+    while ((c = gbinder_reader_utf16_next(utf16, len, &pos)) != 0) {
+        if (c < 0x80) {
+            if (*ptr++ != c) {
+                return FALSE;
+            }
+        } else if (c == (gunichar)-1) {
+            return FALSE;
+        } else {
+            char buf[6];
+            const gint n = g_unichar_to_utf8(c, buf);
+
+            if (strncmp((const char*)ptr, buf, n)) {
+                return FALSE;
+            }
+            ptr += n;
+        }
+    }
+    return !*ptr;
+}
+
 gboolean
 gbinder_reader_read_nullable_string16(
     GBinderReader* reader,
@@ -645,13 +1124,57 @@ gbinder_reader_read_nullable_string16(
 
     if (gbinder_reader_read_nullable_string16_utf16(reader, &str, &len)) {
         if (out) {
-            *out = str ? g_utf16_to_utf8(str, len, NULL, NULL, NULL) : NULL;
+            *out = str ? gbinder_reader_utf16_to_utf8(str, len) : NULL;
         }
         return TRUE;
     }
     return FALSE;
 }
 
+const char*
+gbinder_reader_read_string16_interned(
+    GBinderReader* reader,
+    char** tmp)
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+    const gunichar2* utf16;
+    gsize len;
+
+    *tmp = NULL;
+    if (gbinder_reader_read_nullable_string16_utf16(reader, &utf16, &len) &&
+        utf16) {
+        const char* str = gbinder_object_registry_intern_iface(p->data ?
+            p->data->reg : NULL, utf16, len);
+
+        return str ? str : (*tmp = gbinder_reader_utf16_to_utf8(utf16, len));
+    }
+    return NULL;
+}
+
+gboolean
+gbinder_reader_read_string16_equal(
+    GBinderReader* reader,
+    const char* utf8) /* Since 1.1.25 */
+{
+    const gunichar2* str;
+    gsize len;
+
+    /*
+     * Compares the string without converting it to UTF-8 and therefore
+     * without allocating anything. NULL matches NULL. The string is
+     * consumed even if it doesn't match, FALSE is also returned if the
+     * data can't be parsed.
+     */
+    if (gbinder_reader_read_nullable_string16_utf16(reader, &str, &len)) {
+        if (str && utf8) {
+            return gbinder_reader_utf16_equal(str, len, utf8);
+        } else {
+            return !str && !utf8;
+        }
+    }
+    return FALSE;
+}
+
 gboolean
 gbinder_reader_read_nullable_string16_utf16(
     GBinderReader* reader,
@@ -770,6 +1293,141 @@ gbinder_reader_read_byte_array(
     return data;
 }
 
+/*
+ * Same as gbinder_reader_read_byte_array but the data is exported as
+ * GBytes which may outlive the parcel. NULL and empty arrays are both
+ * returned as empty GBytes.
+ */
+GBytes*
+gbinder_reader_read_byte_array_bytes(
+    GBinderReader* reader) /* Since 1.1.25 */
+{
+    gsize len;
+    const void* data = gbinder_reader_read_byte_array(reader, &len);
+
+    return data ? gbinder_reader_bytes(gbinder_reader_cast(reader),
+        data, len) : NULL;
+}
+
+/*
+ * Blob written by gbinder_writer_append_blob, either in place or in
+ * shared memory. The size isn't encoded, both sides must know it.
+ */
+GBytes*
+gbinder_reader_read_blob(
+    GBinderReader* reader,
+    gsize size) /* Since 1.1.25 */
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+    gint32 type;
+
+    if (gbinder_reader_can_read(p, sizeof(type))) {
+        const guint8* ptr = p->ptr;
+        void** objects = p->objects;
+
+        type = *(const gint32*)ptr;
+        p->ptr += sizeof(type);
+        if (type == GBINDER_BLOB_INPLACE) {
+            const gsize padded = G_ALIGN4(size);
+
+            if (padded >= size && gbinder_reader_can_read(p, padded)) {
+                GBytes* bytes = g_bytes_new(p->ptr, size);
+
+                p->ptr += padded;
+                return bytes;
+            }
+        } else if (size && (type == GBINDER_BLOB_ASHMEM_IMMUTABLE ||
+            type == GBINDER_BLOB_ASHMEM_MUTABLE)) {
+            const int fd = gbinder_reader_read_fd(reader);
+
+            if (fd >= 0) {
+                /* Each blob is a new region, no point in caching it */
+                GBytes* bytes = gbinder_memory_cache_map(NULL, fd, size);
+
+                if (bytes) {
+                    return bytes;
+                }
+            }
+        }
+        /* Leave the position unchanged on failure */
+        p->ptr = ptr;
+        p->objects = objects;
+    }
+    return NULL;
+}
+
+/*
+ * Vector of primitive values: int32 count (-1 for NULL) followed by the
+ * values. There's no copying involved, the returned pointer refers to
+ * the parcel data. As with gbinder_reader_read_byte_array, NULL and empty
+ * arrays are returned as a non-NULL pointer with zero count.
+ */
+static
+const void*
+gbinder_reader_read_array(
+    GBinderReader* reader,
+    gsize elem_size,
+    gsize* count)
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+    const void* data = NULL;
+    gint32 n;
+
+    if (count) {
+        *count = 0;
+    }
+    if (gbinder_reader_can_read(p, sizeof(n))) {
+        n = *(const gint32*)p->ptr;
+        if (n <= 0) {
+            p->ptr += sizeof(n);
+            /* Any non-NULL pointer just to indicate success */
+            data = p->start;
+        } else if ((gsize)n <= (gsize)(p->end - p->ptr - sizeof(n)) /
+            elem_size) {
+            /* One bounds check for the whole array */
+            p->ptr += sizeof(n);
+            data = p->ptr;
+            p->ptr += n * elem_size;
+            if (count) {
+                *count = n;
+            }
+        }
+    }
+    return data;
+}
+
+const gint32*
+gbinder_reader_read_int32_array(
+    GBinderReader* reader,
+    gsize* count) /* Since 1.1.25 */
+{
+    return gbinder_reader_read_array(reader, sizeof(gint32), count);
+}
+
+const gint64*
+gbinder_reader_read_int64_array(
+    GBinderReader* reader,
+    gsize* count) /* Since 1.1.25 */
+{
+    return gbinder_reader_read_array(reader, sizeof(gint64), count);
+}
+
+const gfloat*
+gbinder_reader_read_float_array(
+    GBinderReader* reader,
+    gsize* count) /* Since 1.1.25 */
+{
+    return gbinder_reader_read_array(reader, sizeof(gfloat), count);
+}
+
+const gdouble*
+gbinder_reader_read_double_array(
+    GBinderReader* reader,
+    gsize* count) /* Since 1.1.25 */
+{
+    return gbinder_reader_read_array(reader, sizeof(gdouble), count);
+}
+
 const void*
 gbinder_reader_get_data(
     const GBinderReader* reader,
@@ -813,6 +1471,44 @@ gbinder_reader_bytes_remaining(
     return p ? (p->end - p->ptr) : 0;
 }
 
+gboolean
+gbinder_reader_cursor_begin(
+    GBinderReader* reader,
+    gsize size,
+    GBinderReaderCursor* cursor) /* Since 1.1.25 */
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+
+    /* The cursor doesn't know anything about the objects */
+    if (gbinder_reader_can_read(p, size) && (!p->objects ||
+        !p->objects[0] || (const guint8*)p->objects[0] >= p->ptr + size)) {
+        cursor->ptr = p->ptr;
+        cursor->end = p->ptr + size;
+        return TRUE;
+    } else {
+        cursor->ptr = cursor->end = NULL;
+        return FALSE;
+    }
+}
+
+gboolean
+gbinder_reader_cursor_end(
+    GBinderReader* reader,
+    const GBinderReaderCursor* cursor) /* Since 1.1.25 */
+{
+    GBinderReaderPriv* p = gbinder_reader_cast(reader);
+
+    /* Leave the reader where it was if the cursor went too far */
+    if (cursor->ptr >= p->ptr && cursor->ptr <= cursor->end &&
+        cursor->end <= p->end) {
+        p->ptr = cursor->ptr;
+        return TRUE;
+    } else {
+        GWARN("Reader cursor overrun");
+        return FALSE;
+    }
+}
+
 void
 gbinder_reader_copy(
     GBinderReader* dest,
@@ -51,6 +51,16 @@ gbinder_reader_init(
     gsize len)
     GBINDER_INTERNAL;
 
+/*
+ * Returns the string interned by the object registry if possible,
+ * otherwise allocates a new one and stores it to *tmp
+ */
+const char*
+gbinder_reader_read_string16_interned(
+    GBinderReader* reader,
+    char** tmp)
+    GBINDER_INTERNAL;
+
 #endif /* GBINDER_READER_PRIVATE_H */
 
 /*
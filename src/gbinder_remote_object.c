@@ -30,35 +30,26 @@
  * THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#define GLIB_DISABLE_DEPRECATION_WARNINGS
-
 #include "gbinder_driver.h"
 #include "gbinder_ipc.h"
+#include "gbinder_local_object_p.h"
 #include "gbinder_remote_object_p.h"
 #include "gbinder_servicemanager_p.h"
-#include "gbinder_eventloop_p.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_log.h"
 
-struct gbinder_remote_object_priv {
-    gboolean acquired;
-};
-
-typedef GObjectClass GBinderRemoteObjectClass;
-GType gbinder_remote_object_get_type(void) GBINDER_INTERNAL;
-G_DEFINE_TYPE(GBinderRemoteObject, gbinder_remote_object, G_TYPE_OBJECT)
-
-#define PARENT_CLASS gbinder_remote_object_parent_class
-#define THIS_TYPE (gbinder_remote_object_get_type())
-#define THIS(obj) G_TYPE_CHECK_INSTANCE_CAST(obj,THIS_TYPE,GBinderRemoteObject)
-
-enum gbinder_remote_object_signal {
-    SIGNAL_DEATH,
-    SIGNAL_COUNT
-};
+typedef struct gbinder_remote_object_handler {
+    gulong id;
+    GBinderRemoteObjectNotifyFunc fn;
+    void* data;
+} GBinderRemoteObjectHandler;
 
-#define SIGNAL_DEATH_NAME "death"
-
-static guint gbinder_remote_object_signals[SIGNAL_COUNT] = { 0 };
+/*
+ * Death handlers are rare, they all share one lock. Ids are unique
+ * across all objects and grow monotonically, each list is sorted by id.
+ */
+static GMutex gbinder_remote_object_handlers_mutex;
+static gulong gbinder_remote_object_last_handler_id = 0;
 
 /*==========================================================================*
  * Implementation
@@ -66,29 +57,157 @@ static guint gbinder_remote_object_signals[SIGNAL_COUNT] = { 0 };
 
 static
 void
-gbinder_remote_object_handle_death_on_main_thread(
-    gpointer user_data)
+gbinder_remote_object_handler_free(
+    GBinderRemoteObjectHandler* h)
 {
-    GBinderRemoteObject* self = THIS(user_data);
+    g_slice_free(GBinderRemoteObjectHandler, h);
+}
 
-    if (!self->dead) {
-        GBinderIpc* ipc = self->ipc;
-        GBinderDriver* driver = ipc->driver;
-        GBinderRemoteObjectPriv* priv = self->priv;
+static
+void
+gbinder_remote_object_free(
+    GBinderRemoteObject* self)
+{
+    GBinderIpc* ipc = self->ipc;
+    GBinderDriver* driver = ipc->driver;
 
-        self->dead = TRUE;
-        if (priv->acquired) {
-            priv->acquired = FALSE;
-            /* Release the dead node */
+    if (self->local) {
+        /* Nothing to tell the driver */
+        gbinder_local_object_unref(self->local);
+    } else {
+        gbinder_ipc_invalidate_remote_handle(ipc, self->handle);
+        if (!self->dead) {
+            gbinder_driver_clear_death_notification(driver, self);
+        }
+        if (self->acquired) {
             gbinder_driver_release(driver, self->handle);
         }
-        /* ServiceManager always has the same handle, and can be reanimated. */
-        if (self->handle != GBINDER_SERVICEMANAGER_HANDLE) {
-            gbinder_ipc_invalidate_remote_handle(ipc, self->handle);
+    }
+    g_slist_free_full(self->handlers, (GDestroyNotify)
+        gbinder_remote_object_handler_free);
+    gbinder_ipc_unref(ipc);
+    gbinder_stats_mem_remove(GBINDER_STATS_MEM_REMOTE_OBJECTS, 0);
+    g_slice_free(GBinderRemoteObject, self);
+}
+
+static
+GBinderRemoteObject*
+gbinder_remote_object_alloc(
+    GBinderIpc* ipc)
+{
+    GBinderRemoteObject* self = g_slice_new0(GBinderRemoteObject);
+
+    g_atomic_int_set(&self->refcount, 1);
+    self->ipc = gbinder_ipc_ref(ipc);
+    gbinder_stats_mem_add(GBINDER_STATS_MEM_REMOTE_OBJECTS, 0);
+    return self;
+}
+
+static
+void
+gbinder_remote_object_emit_death(
+    GBinderRemoteObject* self)
+{
+    /* Most objects never get a death handler */
+    if (g_atomic_pointer_get(&self->handlers)) {
+        gulong last = 0, max = 0;
+        GSList* l;
+
+        /*
+         * Handlers may add and remove handlers and drop their references
+         * to the object. Those removed before being called are skipped,
+         * those added during the emission are not called this time.
+         */
+        gbinder_remote_object_ref(self);
+
+        /* Lock */
+        g_mutex_lock(&gbinder_remote_object_handlers_mutex);
+        l = g_slist_last(self->handlers);
+        if (l) {
+            max = ((GBinderRemoteObjectHandler*)l->data)->id;
+        }
+        g_mutex_unlock(&gbinder_remote_object_handlers_mutex);
+        /* Unlock */
+
+        while (last < max) {
+            GBinderRemoteObjectNotifyFunc fn = NULL;
+            void* data = NULL;
+
+            /* Lock */
+            g_mutex_lock(&gbinder_remote_object_handlers_mutex);
+            for (l = self->handlers; l; l = l->next) {
+                const GBinderRemoteObjectHandler* h = l->data;
+
+                if (h->id > last) {
+                    if (h->id <= max) {
+                        last = h->id;
+                        fn = h->fn;
+                        data = h->data;
+                    }
+                    break;
+                }
+            }
+            g_mutex_unlock(&gbinder_remote_object_handlers_mutex);
+            /* Unlock */
+
+            if (fn) {
+                fn(self, data);
+            } else {
+                break;
+            }
+        }
+        gbinder_remote_object_unref(self);
+    }
+}
+
+static
+void
+gbinder_remote_object_handle_deaths_on_main_thread(
+    gpointer user_data)
+{
+    GPtrArray* objs = user_data;
+    GBinderIpc* ipc = ((GBinderRemoteObject*)objs->pdata[0])->ipc;
+    guint32* handles = g_new(guint32, objs->len);
+    guint32* invalid = g_new(guint32, objs->len);
+    gboolean* release = g_new(gboolean, objs->len);
+    gboolean* notify = g_new0(gboolean, objs->len);
+    guint i, ndead = 0, ninvalid = 0;
+
+    /* All objects were collected by the same read, i.e. the same ipc */
+    for (i = 0; i < objs->len; i++) {
+        GBinderRemoteObject* self = objs->pdata[i];
+
+        GASSERT(self->ipc == ipc);
+        if (!self->dead) {
+            self->dead = TRUE;
+            notify[i] = TRUE;
+            /* Release the dead node (if acquired) */
+            release[ndead] = self->acquired;
+            self->acquired = FALSE;
+            handles[ndead++] = self->handle;
+            /* ServiceManager has the same handle, and can be reanimated. */
+            if (self->handle != GBINDER_SERVICEMANAGER_HANDLE) {
+                invalid[ninvalid++] = self->handle;
+            }
+        }
+    }
+
+    if (ndead) {
+        gbinder_ipc_invalidate_remote_handles(ipc, invalid, ninvalid);
+        gbinder_ipc_remote_cache_drop_dead(ipc);
+        gbinder_driver_dead_binders_done(ipc->driver, handles, release,
+            ndead);
+        for (i = 0; i < objs->len; i++) {
+            if (notify[i]) {
+                gbinder_remote_object_emit_death(objs->pdata[i]);
+            }
         }
-        gbinder_driver_dead_binder_done(driver, self);
-        g_signal_emit(self, gbinder_remote_object_signals[SIGNAL_DEATH], 0);
     }
+
+    g_free(handles);
+    g_free(invalid);
+    g_free(release);
+    g_free(notify);
 }
 
 /*==========================================================================*
@@ -111,12 +230,11 @@ gbinder_remote_object_reanimate(
         /* Kick the horse */
         GASSERT(self->handle == GBINDER_SERVICEMANAGER_HANDLE);
         if (gbinder_ipc_ping_sync(ipc, handle, &gbinder_ipc_sync_main) == 0) {
-            GBinderRemoteObjectPriv* priv = self->priv;
             GBinderDriver* driver = ipc->driver;
 
             /* Wow, it's alive! */
             self->dead = FALSE;
-            priv->acquired = TRUE;
+            self->acquired = TRUE;
             gbinder_ipc_looper_check(ipc); /* For death notifications */
             gbinder_driver_acquire(driver, handle);
             gbinder_driver_request_death_notification(driver, self);
@@ -126,15 +244,17 @@ gbinder_remote_object_reanimate(
 }
 
 void
-gbinder_remote_object_handle_death_notification(
-    GBinderRemoteObject* self)
+gbinder_remote_object_handle_death_notifications(
+    GPtrArray* objs)
 {
-    /* This function is invoked from the looper thread, the caller has
-     * checked the object pointer */
-    GVERBOSE_("%p %u", self, self->handle);
-    gbinder_idle_callback_invoke_later
-        (gbinder_remote_object_handle_death_on_main_thread,
-            gbinder_remote_object_ref(self), g_object_unref);
+    /* This function is invoked from the looper thread, the array holds
+     * references to the objects and is never empty */
+    GBinderRemoteObject* first = objs->pdata[0];
+
+    GVERBOSE_("%u object(s)", objs->len);
+    gbinder_ipc_invoke_later(first->ipc,
+        gbinder_remote_object_handle_deaths_on_main_thread,
+        g_ptr_array_ref(objs), (GDestroyNotify) g_ptr_array_unref);
 }
 
 void
@@ -143,22 +263,21 @@ gbinder_remote_object_commit_suicide(
 {
     /* This function is only invoked by GBinderProxyObject in context of
      * the main thread, the object pointer is checked by the caller */
-    if (!self->dead) {
+    if (!self->dead && !self->local) {
         GBinderIpc* ipc = self->ipc;
         GBinderDriver* driver = ipc->driver;
-        GBinderRemoteObjectPriv* priv = self->priv;
 
         self->dead = TRUE;
         gbinder_driver_clear_death_notification(driver, self);
-        if (priv->acquired) {
-            priv->acquired = FALSE;
+        if (self->acquired) {
+            self->acquired = FALSE;
             /* Release the dead node */
             gbinder_driver_release(driver, self->handle);
         }
         GVERBOSE_("%p %u", self, self->handle);
         gbinder_ipc_invalidate_remote_handle(self->ipc, self->handle);
         /* Don't submit BC_DEAD_BINDER_DONE because this is a suicide */
-        g_signal_emit(self, gbinder_remote_object_signals[SIGNAL_DEATH], 0);
+        gbinder_remote_object_emit_death(self);
     }
 }
 
@@ -173,24 +292,22 @@ gbinder_remote_object_new(
     REMOTE_OBJECT_CREATE create)
 {
     if (G_LIKELY(ipc)) {
-        GBinderRemoteObject* self = g_object_new(THIS_TYPE, NULL);
-        GBinderRemoteObjectPriv* priv = self->priv;
+        GBinderRemoteObject* self = gbinder_remote_object_alloc(ipc);
 
-        self->ipc = gbinder_ipc_ref(ipc);
         self->handle = handle;
         switch (create) {
         case REMOTE_OBJECT_CREATE_DEAD:
             self->dead = TRUE;
             break;
         case REMOTE_OBJECT_CREATE_ACQUIRED:
-            priv->acquired = TRUE;
+            self->acquired = TRUE;
             /* fallthrough */
         case REMOTE_OBJECT_CREATE_ALIVE:
             break;
         }
         if (!self->dead) {
             gbinder_ipc_looper_check(self->ipc); /* For death notifications */
-            if (priv->acquired) {
+            if (self->acquired) {
                 gbinder_driver_acquire(ipc->driver, handle);
             }
             gbinder_driver_request_death_notification(ipc->driver, self);
@@ -200,12 +317,33 @@ gbinder_remote_object_new(
     return NULL;
 }
 
+/*
+ * The kernel never gives us handles to our own objects, they arrive as
+ * BINDER_TYPE_BINDER. Such a remote object doesn't have a handle, it's
+ * not registered with GBinderIpc and transactions are delivered to the
+ * local object directly, without going through the kernel.
+ */
+GBinderRemoteObject*
+gbinder_remote_object_new_local(
+    GBinderLocalObject* local)
+{
+    if (G_LIKELY(local)) {
+        GBinderRemoteObject* self = gbinder_remote_object_alloc(local->ipc);
+
+        self->handle = GBINDER_REMOTE_OBJECT_NO_HANDLE;
+        self->local = gbinder_local_object_ref(local);
+        return self;
+    }
+    return NULL;
+}
+
 GBinderRemoteObject*
 gbinder_remote_object_ref(
     GBinderRemoteObject* self)
 {
     if (G_LIKELY(self)) {
-        g_object_ref(THIS(self));
+        GASSERT(self->refcount > 0);
+        g_atomic_int_inc(&self->refcount);
         return self;
     } else {
         return NULL;
@@ -217,7 +355,36 @@ gbinder_remote_object_unref(
     GBinderRemoteObject* self)
 {
     if (G_LIKELY(self)) {
-        g_object_unref(THIS(self));
+        GASSERT(self->refcount > 0);
+        if (self->local) {
+            /* Not in the registry */
+            if (g_atomic_int_dec_and_test(&self->refcount)) {
+                gbinder_remote_object_free(self);
+            }
+        } else {
+            /*
+             * Same thing as what g_object_unref() does with dispose. The
+             * registry may hand out a new reference to this object until
+             * it's removed from there, which only happens when the last
+             * reference is being dropped.
+             */
+            for (;;) {
+                const gint ref = g_atomic_int_get(&self->refcount);
+
+                if (ref > 1) {
+                    if (g_atomic_int_compare_and_exchange(&self->refcount,
+                        ref, ref - 1)) {
+                        break;
+                    }
+                } else {
+                    gbinder_ipc_remote_object_disposed(self->ipc, self);
+                    if (g_atomic_int_dec_and_test(&self->refcount)) {
+                        gbinder_remote_object_free(self);
+                    }
+                    break;
+                }
+            }
+        }
     }
 }
 
@@ -242,9 +409,22 @@ gbinder_remote_object_add_death_handler(
     void* data)
 {
     if (G_LIKELY(self) && G_LIKELY(fn)) {
+        GBinderRemoteObjectHandler* h = g_slice_new(GBinderRemoteObjectHandler);
+        gulong id;
+
         /* To receive the notifications, we need to have looper running */
         gbinder_ipc_looper_check(self->ipc);
-        return g_signal_connect(self, SIGNAL_DEATH_NAME, G_CALLBACK(fn), data);
+        h->fn = fn;
+        h->data = data;
+
+        /* Lock */
+        g_mutex_lock(&gbinder_remote_object_handlers_mutex);
+        id = h->id = ++gbinder_remote_object_last_handler_id;
+        g_atomic_pointer_set(&self->handlers, g_slist_append(self->handlers,
+            h));
+        g_mutex_unlock(&gbinder_remote_object_handlers_mutex);
+        /* Unlock */
+        return id;
     }
     return 0;
 }
@@ -255,71 +435,28 @@ gbinder_remote_object_remove_handler(
     gulong id)
 {
     if (G_LIKELY(self) && G_LIKELY(id)) {
-        g_signal_handler_disconnect(self, id);
-    }
-}
-
-/*==========================================================================*
- * Internals
- *==========================================================================*/
-
-static
-void
-gbinder_remote_object_init(
-    GBinderRemoteObject* self)
-{
-    GBinderRemoteObjectPriv* priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
-        THIS_TYPE, GBinderRemoteObjectPriv);
-
-    self->priv = priv;
-}
-
-static
-void
-gbinder_remote_object_dispose(
-    GObject* object)
-{
-    GBinderRemoteObject* self = THIS(object);
-
-    gbinder_ipc_remote_object_disposed(self->ipc, self);
-    G_OBJECT_CLASS(PARENT_CLASS)->dispose(object);
-}
-
-static
-void
-gbinder_remote_object_finalize(
-    GObject* object)
-{
-    GBinderRemoteObject* self = THIS(object);
-    GBinderRemoteObjectPriv* priv = self->priv;
-    GBinderIpc* ipc = self->ipc;
-    GBinderDriver* driver = ipc->driver;
+        GBinderRemoteObjectHandler* found = NULL;
+        GSList* l;
+
+        /* Lock */
+        g_mutex_lock(&gbinder_remote_object_handlers_mutex);
+        for (l = self->handlers; l; l = l->next) {
+            GBinderRemoteObjectHandler* h = l->data;
+
+            if (h->id == id) {
+                found = h;
+                g_atomic_pointer_set(&self->handlers,
+                    g_slist_delete_link(self->handlers, l));
+                break;
+            }
+        }
+        g_mutex_unlock(&gbinder_remote_object_handlers_mutex);
+        /* Unlock */
 
-    gbinder_ipc_invalidate_remote_handle(ipc, self->handle);
-    if (!self->dead) {
-        gbinder_driver_clear_death_notification(driver, self);
-    }
-    if (priv->acquired) {
-        gbinder_driver_release(driver, self->handle);
+        if (found) {
+            gbinder_remote_object_handler_free(found);
+        }
     }
-    gbinder_ipc_unref(ipc);
-    G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
-}
-
-static
-void
-gbinder_remote_object_class_init(
-    GBinderRemoteObjectClass* klass)
-{
-    GObjectClass* remote_class = G_OBJECT_CLASS(klass);
-
-    g_type_class_add_private(klass, sizeof(GBinderRemoteObjectPriv));
-    remote_class->dispose = gbinder_remote_object_dispose;
-    remote_class->finalize = gbinder_remote_object_finalize;
-
-    gbinder_remote_object_signals[SIGNAL_DEATH] =
-        g_signal_new(SIGNAL_DEATH_NAME, G_OBJECT_CLASS_TYPE(klass),
-            G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL, G_TYPE_NONE, 0);
 }
 
 /*
@@ -39,15 +39,26 @@
 
 #include <glib-object.h>
 
-typedef struct gbinder_remote_object_priv GBinderRemoteObjectPriv;
+/*
+ * There's one of these per handle the process has ever seen, and most
+ * of them never get a death handler. That's why it's a plain refcounted
+ * structure (40 bytes on 64-bit systems, vs ~80 for a GObject with its
+ * private area and signal bookkeeping) and the handler list is only
+ * allocated when the first death handler is added.
+ */
 struct gbinder_remote_object {
-    GObject object;
-    GBinderRemoteObjectPriv* priv;
-    GBinderIpc* ipc;
+    gint refcount;
     guint32 handle;
+    GBinderIpc* ipc;
+    GBinderLocalObject* local; /* Object living in this process */
+    GSList* handlers; /* NULL until the first death handler is added */
     gboolean dead;
+    gboolean acquired;
 };
 
+/* Handle of the remote objects which refer to our own local objects */
+#define GBINDER_REMOTE_OBJECT_NO_HANDLE ((guint32)-1)
+
 #define gbinder_remote_object_dev(obj) (gbinder_driver_dev((obj)->ipc->driver))
 #define gbinder_remote_object_io(obj) (gbinder_driver_io((obj)->ipc->driver))
 
@@ -64,14 +75,19 @@ gbinder_remote_object_new(
     REMOTE_OBJECT_CREATE create)
     GBINDER_INTERNAL;
 
+GBinderRemoteObject*
+gbinder_remote_object_new_local(
+    GBinderLocalObject* local)
+    GBINDER_INTERNAL;
+
 gboolean
 gbinder_remote_object_reanimate(
     GBinderRemoteObject* obj)
     GBINDER_INTERNAL;
 
 void
-gbinder_remote_object_handle_death_notification(
-    GBinderRemoteObject* obj)
+gbinder_remote_object_handle_death_notifications(
+    GPtrArray* objs)
     GBINDER_INTERNAL;
 
 void
@@ -38,6 +38,7 @@
 #include "gbinder_log.h"
 
 #include <gutil_macros.h>
+#include <gutil_misc.h>
 
 struct gbinder_remote_reply {
     gint refcount;
@@ -107,6 +108,35 @@ gbinder_remote_reply_unref(
     }
 }
 
+/*
+ * Copies the reply into the heap memory, so that it doesn't hold on to
+ * the driver's buffer. Replies carrying objects can't be copied that way,
+ * NULL is returned for those.
+ */
+GBinderRemoteReply*
+gbinder_remote_reply_dup_local(
+    GBinderRemoteReply* self)
+{
+    if (G_LIKELY(self)) {
+        GBinderReaderData* d = &self->data;
+
+        if (!d->objects || !d->objects[0]) {
+            GBinderRemoteReply* copy = gbinder_remote_reply_new(d->reg);
+            GBinderBuffer* buf = d->buffer;
+
+            if (buf && buf->size) {
+                void* data = gutil_memdup(buf->data, buf->size);
+
+                gbinder_remote_reply_set_data(copy, gbinder_buffer_new_local
+                    (gbinder_buffer_io(buf), data, buf->size, NULL, g_free,
+                        data));
+            }
+            return copy;
+        }
+    }
+    return NULL;
+}
+
 gboolean
 gbinder_remote_reply_is_empty(
     GBinderRemoteReply* self)
@@ -54,6 +54,11 @@ gbinder_remote_reply_set_data(
     GBinderBuffer* buffer)
     GBINDER_INTERNAL;
 
+GBinderRemoteReply*
+gbinder_remote_reply_dup_local(
+    GBinderRemoteReply* reply)
+    GBINDER_INTERNAL;
+
 gboolean
 gbinder_remote_reply_is_empty(
     GBinderRemoteReply* reply)
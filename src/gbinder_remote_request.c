@@ -53,6 +53,7 @@ typedef struct gbinder_remote_request_priv {
     const char* iface;
     char* iface2;
     gsize header_size;
+    guint64 trace_id;
     GBinderReaderData data;
 } GBinderRemoteRequestPriv;
 
@@ -86,8 +87,11 @@ gbinder_remote_request_copy_to_local(
 
     if (G_LIKELY(self)) {
         GBinderReaderData* d = &self->data;
+        GBinderLocalRequest* local =
+            gbinder_local_request_new_from_data(d->buffer, NULL);
 
-        return gbinder_local_request_new_from_data(d->buffer, NULL);
+        gbinder_local_request_set_trace_id(local, self->trace_id);
+        return local;
     }
     return NULL;
 }
@@ -101,19 +105,22 @@ gbinder_remote_request_convert_to_local(
 
     if (G_LIKELY(self)) {
         GBinderReaderData* data = &self->data;
+        GBinderLocalRequest* local;
 
         if (!convert || convert->protocol == self->protocol) {
             /* The same protocol, the same format of RPC header */
-            return gbinder_local_request_new_from_data(data->buffer, convert);
+            local = gbinder_local_request_new_from_data(data->buffer, convert);
         } else {
             /* Need to translate to another format */
-            GBinderLocalRequest* local = gbinder_local_request_new_iface
-                (convert->io, convert->protocol, self->iface);
-
+            local = gbinder_local_request_new_iface(convert->io,
+                convert->protocol, self->iface);
             gbinder_local_request_append_contents(local, data->buffer,
                 self->header_size, convert);
-            return local;
         }
+
+        /* Forwarded requests carry the trace id over to the next hop */
+        gbinder_local_request_set_trace_id(local, self->trace_id);
+        return local;
     }
     return NULL;
 }
@@ -156,6 +163,18 @@ gbinder_remote_request_init_reader2(
     }
 }
 
+void
+gbinder_remote_request_set_trace_id(
+    GBinderRemoteRequest* req,
+    guint64 id)
+{
+    GBinderRemoteRequestPriv* self = gbinder_remote_request_cast(req);
+
+    if (G_LIKELY(self)) {
+        self->trace_id = id;
+    }
+}
+
 void
 gbinder_remote_request_set_data(
     GBinderRemoteRequest* req,
@@ -256,6 +275,15 @@ gbinder_remote_request_sender_euid(
     return G_LIKELY(self) ? self->euid : (uid_t)(-1);
 }
 
+guint64
+gbinder_remote_request_trace_id(
+    GBinderRemoteRequest* req) /* Since 1.1.25 */
+{
+    GBinderRemoteRequestPriv* self = gbinder_remote_request_cast(req);
+
+    return G_LIKELY(self) ? self->trace_id : 0;
+}
+
 gboolean
 gbinder_remote_request_read_int32(
     GBinderRemoteRequest* self,
@@ -56,6 +56,12 @@ gbinder_remote_request_set_data(
     GBinderBuffer* buffer)
     GBINDER_INTERNAL;
 
+void
+gbinder_remote_request_set_trace_id(
+    GBinderRemoteRequest* request,
+    guint64 id)
+    GBINDER_INTERNAL;
+
 GBinderLocalRequest*
 gbinder_remote_request_convert_to_local(
     GBinderRemoteRequest* req,
@@ -31,7 +31,7 @@
  */
 
 #include "gbinder_rpc_protocol.h"
-#include "gbinder_reader.h"
+#include "gbinder_reader_p.h"
 #include "gbinder_writer.h"
 #include "gbinder_config.h"
 #include "gbinder_log.h"
@@ -109,15 +109,15 @@ gbinder_rpc_protocol_aidl_read_rpc_header(
     guint32 txcode,
     char** iface)
 {
+    *iface = NULL;
     if (txcode > GBINDER_TRANSACTION(0,0,0)) {
         /* Internal transaction e.g. GBINDER_DUMP_TRANSACTION etc. */
-        *iface = NULL;
+        return NULL;
     } else if (gbinder_reader_read_int32(reader, NULL)) {
-        *iface = gbinder_reader_read_string16(reader);
+        return gbinder_reader_read_string16_interned(reader, iface);
     } else {
-        *iface = NULL;
+        return NULL;
     }
-    return *iface;
 }
 
 static const GBinderRpcProtocol gbinder_rpc_protocol_aidl = {
@@ -156,16 +156,16 @@ gbinder_rpc_protocol_aidl2_read_rpc_header(
     guint32 txcode,
     char** iface)
 {
+    *iface = NULL;
     if (txcode > GBINDER_TRANSACTION(0,0,0)) {
         /* Internal transaction e.g. GBINDER_DUMP_TRANSACTION etc. */
-        *iface = NULL;
+        return NULL;
     } else if (gbinder_reader_read_int32(reader, NULL) /* flags */ &&
         gbinder_reader_read_int32(reader, NULL) /* work source */) {
-        *iface = gbinder_reader_read_string16(reader);
+        return gbinder_reader_read_string16_interned(reader, iface);
     } else {
-        *iface = NULL;
+        return NULL;
     }
-    return *iface;
 }
 
 static const GBinderRpcProtocol gbinder_rpc_protocol_aidl2 = {
@@ -199,17 +199,16 @@ gbinder_rpc_protocol_aidl3_read_rpc_header(
     guint32 txcode,
     char** iface)
 {
+    *iface = NULL;
     if (txcode > GBINDER_TRANSACTION(0,0,0)) {
-        *iface = NULL;
+        return NULL;
     } else if (gbinder_reader_read_int32(reader, NULL) /* flags */ &&
         gbinder_reader_read_int32(reader, NULL) /* work source */ &&
         gbinder_reader_read_int32(reader, NULL) /* sys header */) {
-        *iface = gbinder_reader_read_string16(reader);
+        return gbinder_reader_read_string16_interned(reader, iface);
     } else {
-        *iface = NULL;
+        return NULL;
     }
-
-    return *iface;
 }
 
 static const GBinderRpcProtocol gbinder_rpc_protocol_aidl3 = {
@@ -40,13 +40,21 @@
 #include "gbinder_eventloop_p.h"
 #include "gbinder_driver.h"
 #include "gbinder_ipc.h"
+#include "gbinder_system.h"
 #include "gbinder_log.h"
 
 #include <gbinder_client.h>
+#include <gbinder_remote_request.h>
 
 #include <gutil_misc.h>
+#include <gutil_strv.h>
 
 #include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 
 /*==========================================================================*
  *
@@ -95,9 +103,25 @@ static GHashTable* gbinder_servicemanager_map = NULL;
 static const GBinderServiceManagerType* gbinder_servicemanager_default =
     SERVICEMANAGER_TYPE_DEFAULT;
 
+/*
+ * The delay between pings doubles up to PRESENSE_WAIT_MS_MAX. If the
+ * device node can be watched with inotify, the delay is allowed to grow
+ * up to PRESENSE_WATCH_MS_MAX, because service manager opening the
+ * device wakes us up anyway. The first two can be overridden by the
+ * PresenceCheckMinDelay and PresenceCheckMaxDelay config values.
+ */
 #define PRESENSE_WAIT_MS_MIN  (100)
 #define PRESENSE_WAIT_MS_MAX  (1000)
-#define PRESENSE_WAIT_MS_STEP (100)
+#define PRESENSE_WATCH_MS_MAX (30000)
+
+typedef struct gbinder_servicemanager_presence_watch {
+    gint refcount;
+    gint poked;
+    GBinderServiceManager* sm; /* Main thread only, NULL once stopped */
+    GThread* thread;
+    int inotify_fd;
+    int wake_fd;
+} GBinderServiceManagerPresenceWatch;
 
 typedef struct gbinder_servicemanager_watch {
     char* name;
@@ -106,14 +130,58 @@ typedef struct gbinder_servicemanager_watch {
     gboolean watched;
 } GBinderServiceManagerWatch;
 
+typedef struct gbinder_servicemanager_batch GBinderServiceManagerBatch;
+
+typedef struct gbinder_servicemanager_batch_item {
+    GBinderServiceManagerBatch* batch;
+    const char* name;
+    gulong tx_id;
+    gulong registration_id;
+} GBinderServiceManagerBatchItem;
+
+/*
+ * All names are looked up at once, the transactions are executed by
+ * the tx thread pool in parallel. If no object is found and max_wait_ms
+ * is non-zero, the name is looked up again when it gets registered.
+ */
+struct gbinder_servicemanager_batch {
+    GBinderServiceManager* sm;
+    gulong id;
+    guint count;
+    guint found;
+    guint pending;
+    char** names;
+    GBinderRemoteObject** objects;
+    GBinderServiceManagerBatchItem* items;
+    GBinderEventLoopTimeout* deadline;
+    GBinderServiceManagerGetServicesFunc func;
+    void* user_data;
+};
+
+typedef struct gbinder_servicemanager_cache_entry {
+    GBinderServiceManager* sm;
+    GBinderRemoteObject* obj;
+    char* name;
+    gulong death_id;
+} GBinderServiceManagerCacheEntry;
+
 struct gbinder_servicemanager_priv {
+    const char* protocol; /* Static, NULL if unknown */
     GHashTable* watch_table;
     gulong death_id;
+    gulong oneway_spam_id;
     gboolean present;
     GBinderEventLoopTimeout* presence_check;
     guint presence_check_delay_ms;
+    guint presence_min_delay_ms;
+    guint presence_max_delay_ms;
+    GBinderServiceManagerPresenceWatch* presence_watch;
     GBinderEventLoopCallback* autorelease_cb;
     GSList* autorelease;
+    GHashTable* batches;
+    /* NULL if the cache is disabled */
+    GMutex cache_mutex;
+    GHashTable* cache;
 };
 
 G_DEFINE_ABSTRACT_TYPE(GBinderServiceManager, gbinder_servicemanager,
@@ -132,11 +200,13 @@ G_DEFINE_ABSTRACT_TYPE(GBinderServiceManager, gbinder_servicemanager,
 enum gbinder_servicemanager_signal {
     SIGNAL_PRESENCE,
     SIGNAL_REGISTRATION,
+    SIGNAL_ONEWAY_SPAM,
     SIGNAL_COUNT
 };
 
 static const char SIGNAL_PRESENCE_NAME[] = "servicemanager-presence";
 static const char SIGNAL_REGISTRATION_NAME[] = "servicemanager-registration";
+static const char SIGNAL_ONEWAY_SPAM_NAME[] = "servicemanager-oneway-spam";
 #define DETAIL_LEN 32
 
 static guint gbinder_servicemanager_signals[SIGNAL_COUNT] = { 0 };
@@ -187,22 +257,333 @@ gbinder_servicemanager_watch_free(
     g_free(watch);
 }
 
+static
+void
+gbinder_servicemanager_cache_entry_free(
+    gpointer data)
+{
+    GBinderServiceManagerCacheEntry* entry = data;
+
+    gbinder_remote_object_remove_handler(entry->obj, entry->death_id);
+    gbinder_remote_object_unref(entry->obj);
+    g_free(entry->name);
+    g_slice_free(GBinderServiceManagerCacheEntry, entry);
+}
+
+static
+void
+gbinder_servicemanager_cache_remove(
+    GBinderServiceManager* self,
+    const char* name)
+{
+    GBinderServiceManagerPriv* priv = self->priv;
+
+    if (priv->cache) {
+        /* Lock */
+        g_mutex_lock(&priv->cache_mutex);
+        g_hash_table_remove(priv->cache, name);
+        g_mutex_unlock(&priv->cache_mutex);
+        /* Unlock */
+    }
+}
+
+static
+void
+gbinder_servicemanager_cache_entry_died(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    GBinderServiceManagerCacheEntry* entry = user_data;
+    GBinderServiceManagerPriv* priv = entry->sm->priv;
+
+    GDEBUG("Dropping cached '%s'", entry->name);
+    /* Lock */
+    g_mutex_lock(&priv->cache_mutex);
+    if (g_hash_table_lookup(priv->cache, entry->name) == entry) {
+        g_hash_table_remove(priv->cache, entry->name); /* Frees the entry */
+    }
+    g_mutex_unlock(&priv->cache_mutex);
+    /* Unlock */
+}
+
+static
+GBinderRemoteObject*
+gbinder_servicemanager_get_service_cached(
+    GBinderServiceManager* self,
+    const char* name,
+    int* status,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderServiceManagerPriv* priv = self->priv;
+    GBinderServiceManagerCacheEntry* entry;
+    GBinderRemoteObject* obj = NULL;
+
+    if (!priv->cache) {
+        return GBINDER_SERVICEMANAGER_GET_CLASS(self)->
+            get_service(self, name, status, api);
+    }
+
+    /* Lock */
+    g_mutex_lock(&priv->cache_mutex);
+    entry = g_hash_table_lookup(priv->cache, name);
+    if (entry && !entry->obj->dead) {
+        obj = gbinder_remote_object_ref(entry->obj);
+    }
+    g_mutex_unlock(&priv->cache_mutex);
+    /* Unlock */
+
+    if (obj) {
+        if (status) {
+            *status = GBINDER_STATUS_OK;
+        }
+        return obj;
+    }
+
+    obj = GBINDER_SERVICEMANAGER_GET_CLASS(self)->
+        get_service(self, name, status, api);
+    if (obj && !obj->dead) {
+        entry = g_slice_new0(GBinderServiceManagerCacheEntry);
+        entry->sm = self;
+        entry->obj = gbinder_remote_object_ref(obj);
+        entry->name = g_strdup(name);
+        entry->death_id = gbinder_remote_object_add_death_handler(obj,
+            gbinder_servicemanager_cache_entry_died, entry);
+
+        /* Lock */
+        g_mutex_lock(&priv->cache_mutex);
+        g_hash_table_replace(priv->cache, entry->name, entry);
+        g_mutex_unlock(&priv->cache_mutex);
+        /* Unlock */
+    }
+    return obj;
+}
+
+static
+void
+gbinder_servicemanager_batch_free(
+    GBinderServiceManagerBatch* batch)
+{
+    GBinderServiceManager* sm = batch->sm;
+    guint i;
+
+    gbinder_timeout_remove(batch->deadline);
+    for (i = 0; i < batch->count; i++) {
+        GBinderServiceManagerBatchItem* item = batch->items + i;
+
+        if (item->tx_id) {
+            gbinder_servicemanager_cancel(sm, item->tx_id);
+        }
+        if (item->registration_id) {
+            gbinder_servicemanager_remove_handler(sm, item->registration_id);
+        }
+        gbinder_remote_object_unref(batch->objects[i]);
+    }
+    g_free(batch->objects);
+    g_free(batch->items);
+    g_strfreev(batch->names);
+    gbinder_servicemanager_unref(sm);
+    g_slice_free(GBinderServiceManagerBatch, batch);
+}
+
+static
+void
+gbinder_servicemanager_batch_finish(
+    GBinderServiceManagerBatch* batch)
+{
+    GBinderServiceManager* sm = batch->sm;
+    guint i;
+
+    g_hash_table_remove(sm->priv->batches, GSIZE_TO_POINTER(batch->id));
+
+    /* Stop the lookups before invoking the callback */
+    gbinder_timeout_remove(batch->deadline);
+    batch->deadline = NULL;
+    for (i = 0; i < batch->count; i++) {
+        GBinderServiceManagerBatchItem* item = batch->items + i;
+
+        if (item->tx_id) {
+            gbinder_servicemanager_cancel(sm, item->tx_id);
+            item->tx_id = 0;
+        }
+    }
+    batch->func(sm, batch->objects, batch->count, batch->user_data);
+    gbinder_servicemanager_batch_free(batch);
+}
+
+static
+void
+gbinder_servicemanager_batch_check(
+    GBinderServiceManagerBatch* batch)
+{
+    if (batch->found == batch->count ||
+        (!batch->pending && !batch->deadline)) {
+        gbinder_servicemanager_batch_finish(batch);
+    }
+}
+
+static
+gboolean
+gbinder_servicemanager_batch_timeout(
+    gpointer user_data)
+{
+    GBinderServiceManagerBatch* batch = user_data;
+
+    GDEBUG("%u out of %u service(s) found", batch->found, batch->count);
+    batch->deadline = NULL;
+    gbinder_servicemanager_batch_finish(batch);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+gbinder_servicemanager_batch_registered(
+    GBinderServiceManager* sm,
+    const char* name,
+    void* user_data);
+
+static
+void
+gbinder_servicemanager_batch_get_service_done(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* obj,
+    int status,
+    void* user_data)
+{
+    GBinderServiceManagerBatchItem* item = user_data;
+    GBinderServiceManagerBatch* batch = item->batch;
+    const guint i = item - batch->items;
+
+    item->tx_id = 0;
+    batch->pending--;
+    if (obj) {
+        if (!batch->objects[i]) {
+            batch->objects[i] = gbinder_remote_object_ref(obj);
+            batch->found++;
+        }
+        if (item->registration_id) {
+            gbinder_servicemanager_remove_handler(sm, item->registration_id);
+            item->registration_id = 0;
+        }
+    } else if (batch->deadline && !item->registration_id) {
+        /* Wait for it to show up */
+        GDEBUG("Waiting for %s", item->name);
+        item->registration_id = gbinder_servicemanager_add_registration_handler
+            (sm, item->name, gbinder_servicemanager_batch_registered, item);
+    }
+    gbinder_servicemanager_batch_check(batch);
+}
+
+static
+void
+gbinder_servicemanager_batch_registered(
+    GBinderServiceManager* sm,
+    const char* name,
+    void* user_data)
+{
+    GBinderServiceManagerBatchItem* item = user_data;
+    GBinderServiceManagerBatch* batch = item->batch;
+
+    if (!item->tx_id && !batch->objects[item - batch->items]) {
+        item->tx_id = gbinder_servicemanager_get_service(sm, item->name,
+            gbinder_servicemanager_batch_get_service_done, item);
+        if (item->tx_id) {
+            batch->pending++;
+        }
+    }
+}
+
 typedef struct gbinder_servicemanager_list_tx_data {
     GBinderServiceManager* sm;
     GBinderServiceManagerListFunc func;
+    char* iface; /* gbinder_servicemanager_list_by_interface */
+    char** names; /* gbinder_servicemanager_list_present */
     char** result;
     void* user_data;
 } GBinderServiceManagerListTxData;
 
+static
+char**
+gbinder_servicemanager_list_by_interface2(
+    GBinderServiceManager* self,
+    const char* iface,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderServiceManagerClass* klass = GBINDER_SERVICEMANAGER_GET_CLASS(self);
+
+    if (klass->list_by_interface) {
+        return klass->list_by_interface(self, iface, api);
+    } else {
+        /* Pick "iface/instance" names from the full list */
+        char** list = klass->list(self, api);
+
+        if (list) {
+            const gsize len = strlen(iface);
+            char** dest = list;
+            char** src;
+
+            for (src = list; *src; src++) {
+                const char* name = *src;
+
+                if (!strncmp(name, iface, len) && name[len] == '/' &&
+                    name[len + 1]) {
+                    *dest++ = *src;
+                } else {
+                    g_free(*src);
+                }
+            }
+            *dest = NULL;
+        }
+        return list;
+    }
+}
+
+static
+char**
+gbinder_servicemanager_list_present2(
+    GBinderServiceManager* self,
+    const GStrV* names,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderServiceManagerClass* klass = GBINDER_SERVICEMANAGER_GET_CLASS(self);
+    char** result = g_new0(char*, gutil_strv_length(names) + 1);
+    char** ptr = result;
+
+    while (*names) {
+        const char* name = *names++;
+        int status = GBINDER_STATUS_OK;
+        GBinderRemoteObject* obj = klass->get_service(self, name, &status,
+            api);
+
+        if (obj) {
+            *ptr++ = g_strdup(name);
+            gbinder_remote_object_unref(obj);
+        } else if (status != GBINDER_STATUS_OK) {
+            /* Can't tell, don't report anything */
+            g_strfreev(result);
+            return NULL;
+        }
+    }
+    return result;
+}
+
 static
 void
 gbinder_servicemanager_list_tx_exec(
     const GBinderIpcTx* tx)
 {
     GBinderServiceManagerListTxData* data = tx->user_data;
+    GBinderServiceManager* sm = data->sm;
 
-    data->result = GBINDER_SERVICEMANAGER_GET_CLASS(data->sm)->
-        list(data->sm, &gbinder_ipc_sync_worker);
+    if (data->names) {
+        data->result = gbinder_servicemanager_list_present2(sm, data->names,
+            &gbinder_ipc_sync_worker);
+    } else if (data->iface) {
+        data->result = gbinder_servicemanager_list_by_interface2(sm,
+            data->iface, &gbinder_ipc_sync_worker);
+    } else {
+        data->result = GBINDER_SERVICEMANAGER_GET_CLASS(sm)->
+            list(sm, &gbinder_ipc_sync_worker);
+    }
 }
 
 static
@@ -226,6 +607,8 @@ gbinder_servicemanager_list_tx_free(
     GBinderServiceManagerListTxData* data = user_data;
 
     g_strfreev(data->result);
+    g_strfreev(data->names);
+    g_free(data->iface);
     gbinder_servicemanager_unref(data->sm);
     g_slice_free(GBinderServiceManagerListTxData, data);
 }
@@ -246,9 +629,8 @@ gbinder_servicemanager_get_service_tx_exec(
 {
     GBinderServiceManagerGetServiceTxData* data = tx->user_data;
 
-    data->obj = GBINDER_SERVICEMANAGER_GET_CLASS(data->sm)->
-        get_service(data->sm, data->name, &data->status,
-            &gbinder_ipc_sync_worker);
+    data->obj = gbinder_servicemanager_get_service_cached(data->sm,
+        data->name, &data->status, &gbinder_ipc_sync_worker);
 }
 
 static
@@ -317,6 +699,141 @@ gbinder_servicemanager_add_service_tx_free(
     g_slice_free(GBinderServiceManagerAddServiceTxData, data);
 }
 
+typedef struct gbinder_servicemanager_add_services_tx {
+    GBinderServiceManager* sm;
+    GBinderServiceManagerAddServicesFunc func;
+    char** names;
+    GBinderLocalObject** objects;
+    int* status;
+    guint count;
+    void* user_data;
+} GBinderServiceManagerAddServicesTxData;
+
+static
+void
+gbinder_servicemanager_add_services_tx_exec(
+    const GBinderIpcTx* tx)
+{
+    GBinderServiceManagerAddServicesTxData* data = tx->user_data;
+    GBinderServiceManagerClass* klass =
+        GBINDER_SERVICEMANAGER_GET_CLASS(data->sm);
+    guint i;
+
+    for (i = 0; i < data->count && !tx->cancelled; i++) {
+        data->status[i] = klass->add_service(data->sm, data->names[i],
+            data->objects[i], &gbinder_ipc_sync_worker);
+    }
+}
+
+static
+void
+gbinder_servicemanager_add_services_tx_done(
+    const GBinderIpcTx* tx)
+{
+    GBinderServiceManagerAddServicesTxData* data = tx->user_data;
+
+    data->func(data->sm, data->status, data->user_data);
+}
+
+static
+void
+gbinder_servicemanager_add_services_tx_free(
+    gpointer user_data)
+{
+    GBinderServiceManagerAddServicesTxData* data = user_data;
+    guint i;
+
+    for (i = 0; i < data->count; i++) {
+        gbinder_local_object_unref(data->objects[i]);
+    }
+    gbinder_servicemanager_unref(data->sm);
+    g_strfreev(data->names);
+    g_free(data->objects);
+    g_free(data->status);
+    g_slice_free(GBinderServiceManagerAddServicesTxData, data);
+}
+
+typedef struct gbinder_servicemanager_ping_many {
+    GBinderServiceManager* sm;
+    GBinderServiceManagerPingFunc func;
+    void* user_data;
+} GBinderServiceManagerPingMany;
+
+static
+void
+gbinder_servicemanager_ping_many_done(
+    GBinderIpc* ipc,
+    const guint8* results,
+    guint count,
+    void* user_data)
+{
+    GBinderServiceManagerPingMany* data = user_data;
+
+    data->func(data->sm, results, count, data->user_data);
+}
+
+static
+void
+gbinder_servicemanager_ping_many_free(
+    gpointer user_data)
+{
+    GBinderServiceManagerPingMany* data = user_data;
+
+    gbinder_servicemanager_unref(data->sm);
+    g_slice_free(GBinderServiceManagerPingMany, data);
+}
+
+typedef struct gbinder_servicemanager_clients_tx {
+    GBinderServiceManager* sm;
+    GBinderServiceManagerAddServiceFunc func;
+    GBinderLocalObject* obj;
+    GBinderLocalObject* cb;
+    int status;
+    char* name;
+    void* user_data;
+} GBinderServiceManagerClientsTxData;
+
+static
+void
+gbinder_servicemanager_clients_tx_exec(
+    const GBinderIpcTx* tx)
+{
+    GBinderServiceManagerClientsTxData* data = tx->user_data;
+
+    data->status = GBINDER_SERVICEMANAGER_GET_CLASS(data->sm)->
+        register_clients_callback(data->sm, data->name, data->obj, data->cb,
+            &gbinder_ipc_sync_worker);
+}
+
+static
+void
+gbinder_servicemanager_clients_tx_done(
+    const GBinderIpcTx* tx)
+{
+    GBinderServiceManagerClientsTxData* data = tx->user_data;
+
+    data->func(data->sm, data->status, data->user_data);
+}
+
+static
+void
+gbinder_servicemanager_clients_tx_free(
+    gpointer user_data)
+{
+    GBinderServiceManagerClientsTxData* data = user_data;
+
+    gbinder_servicemanager_unref(data->sm);
+    gbinder_local_object_unref(data->obj);
+    gbinder_local_object_unref(data->cb);
+    g_free(data->name);
+    g_slice_free(GBinderServiceManagerClientsTxData, data);
+}
+
+static
+void
+gbinder_servicemanager_presence_watch_stop(
+    GBinderServiceManager* self);
+
 static
 void
 gbinder_servicemanager_reanimated(
@@ -328,6 +845,7 @@ gbinder_servicemanager_reanimated(
         gbinder_timeout_remove(priv->presence_check);
         priv->presence_check = NULL;
     }
+    gbinder_servicemanager_presence_watch_stop(self);
     GINFO("Service manager %s has appeared", self->dev);
     /* Re-arm the watches */
     if (g_hash_table_size(priv->watch_table) > 0) {
@@ -349,37 +867,255 @@ gbinder_servicemanager_reanimated(
             }
         }
     }
-    g_signal_emit(self, gbinder_servicemanager_signals[SIGNAL_PRESENCE], 0);
+    g_signal_emit(self, gbinder_servicemanager_signals[SIGNAL_PRESENCE], 0);
+}
+
+/*
+ * Service manager opens the binder device when it starts, so IN_OPEN
+ * on the device node tells us that it's probably coming up. Other
+ * processes opening the device cause spurious wakeups but those are
+ * cheap, it's just an extra ping.
+ */
+static
+int
+gbinder_servicemanager_inotify_new(
+    const char* dev)
+{
+    const int fd = gbinder_system_open_watch(dev);
+
+    if (fd < 0) {
+        GDEBUG("Can't watch %s: %s", dev, strerror(errno));
+    }
+    return fd;
+}
+
+static
+void
+gbinder_servicemanager_inotify_drain(
+    int fd)
+{
+    union {
+        struct inotify_event event;
+        char buf[512];
+    } u;
+
+    /* We don't care about the details */
+    while (read(fd, &u, sizeof(u)) > 0);
+}
+
+/* Returns TRUE if the device node has been opened by someone */
+static
+gboolean
+gbinder_servicemanager_inotify_wait(
+    int fd,
+    int timeout_ms)
+{
+    struct pollfd pfd;
+
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+        gbinder_servicemanager_inotify_drain(fd);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+void
+gbinder_servicemanager_load_delays(
+    GBinderServiceManagerPriv* priv,
+    const char* dev)
+{
+    const int min_ms = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_PRESENCE_CHECK_MIN_DELAY, dev,
+            PRESENSE_WAIT_MS_MIN);
+    const int max_ms = gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_PRESENCE_CHECK_MAX_DELAY, dev,
+            PRESENSE_WAIT_MS_MAX);
+
+    priv->presence_min_delay_ms = MAX(min_ms, 1);
+    priv->presence_max_delay_ms = MAX(max_ms, (int)
+        priv->presence_min_delay_ms);
+}
+
+static
+guint
+gbinder_servicemanager_presence_next_delay(
+    GBinderServiceManager* self,
+    guint delay_ms)
+{
+    GBinderServiceManagerPriv* priv = self->priv;
+    const guint max = priv->presence_watch ?
+        MAX(PRESENSE_WATCH_MS_MAX, priv->presence_max_delay_ms) :
+        priv->presence_max_delay_ms;
+
+    return MIN(2 * delay_ms, max);
+}
+
+static
+gboolean
+gbinder_servicemanager_presense_check_timer(
+    gpointer user_data)
+{
+    GBinderServiceManager* self = GBINDER_SERVICEMANAGER(user_data);
+    GBinderRemoteObject* remote = self->client->remote;
+    GBinderServiceManagerPriv* priv = self->priv;
+    gboolean result;
+
+    GASSERT(remote->dead);
+    gbinder_servicemanager_ref(self);
+    if (gbinder_remote_object_reanimate(remote)) {
+        /* Done */
+        priv->presence_check = NULL;
+        gbinder_servicemanager_reanimated(self);
+        result = G_SOURCE_REMOVE;
+    } else {
+        const guint delay_ms = gbinder_servicemanager_presence_next_delay
+            (self, priv->presence_check_delay_ms);
+
+        if (delay_ms != priv->presence_check_delay_ms) {
+            priv->presence_check_delay_ms = delay_ms;
+            priv->presence_check = gbinder_timeout_add_slack(delay_ms,
+                gbinder_servicemanager_presense_check_timer, self);
+            result = G_SOURCE_REMOVE;
+        } else {
+            result = G_SOURCE_CONTINUE;
+        }
+    }
+    gbinder_servicemanager_unref(self);
+    return result;
+}
+
+static
+void
+gbinder_servicemanager_presence_watch_unref(
+    gpointer data)
+{
+    GBinderServiceManagerPresenceWatch* watch = data;
+
+    if (g_atomic_int_dec_and_test(&watch->refcount)) {
+        g_slice_free(GBinderServiceManagerPresenceWatch, watch);
+    }
+}
+
+static
+void
+gbinder_servicemanager_presence_watch_poke(
+    gpointer data)
+{
+    GBinderServiceManagerPresenceWatch* watch = data;
+    GBinderServiceManager* self = watch->sm;
+
+    g_atomic_int_set(&watch->poked, 0);
+    if (self && self->priv->presence_check) {
+        GBinderServiceManagerPriv* priv = self->priv;
+
+        /* Ping it now and then start over with the shortest delay */
+        GDEBUG("%s has been opened", self->dev);
+        gbinder_timeout_remove(priv->presence_check);
+        priv->presence_check = NULL;
+        gbinder_servicemanager_ref(self);
+        if (gbinder_remote_object_reanimate(self->client->remote)) {
+            gbinder_servicemanager_reanimated(self);
+        } else {
+            priv->presence_check_delay_ms = priv->presence_min_delay_ms;
+            priv->presence_check = gbinder_timeout_add_slack
+                (priv->presence_min_delay_ms,
+                    gbinder_servicemanager_presense_check_timer, self);
+        }
+        gbinder_servicemanager_unref(self);
+    }
+}
+
+static
+gpointer
+gbinder_servicemanager_presence_watch_thread(
+    gpointer data)
+{
+    GBinderServiceManagerPresenceWatch* watch = data;
+    struct pollfd fds[2];
+
+    memset(fds, 0, sizeof(fds));
+    fds[0].fd = watch->inotify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = watch->wake_fd;
+    fds[1].events = POLLIN;
+    while (poll(fds, G_N_ELEMENTS(fds), -1) >= 0 || errno == EINTR) {
+        if (fds[1].revents) {
+            /* We have been stopped */
+            break;
+        } else if (fds[0].revents & POLLIN) {
+            gbinder_servicemanager_inotify_drain(watch->inotify_fd);
+            if (g_atomic_int_compare_and_exchange(&watch->poked, 0, 1)) {
+                g_atomic_int_inc(&watch->refcount);
+                gbinder_idle_callback_invoke_later
+                    (gbinder_servicemanager_presence_watch_poke, watch,
+                        gbinder_servicemanager_presence_watch_unref);
+            }
+        } else if (fds[0].revents) {
+            GWARN("Failed to watch the binder device");
+            break;
+        }
+    }
+    return NULL;
+}
+
+static
+void
+gbinder_servicemanager_presence_watch_start(
+    GBinderServiceManager* self)
+{
+    GBinderServiceManagerPriv* priv = self->priv;
+    const int fd = gbinder_servicemanager_inotify_new(self->dev);
+
+    if (fd >= 0) {
+        const int wake_fd = eventfd(0, EFD_CLOEXEC);
+
+        if (wake_fd >= 0) {
+            GBinderServiceManagerPresenceWatch* watch =
+                g_slice_new0(GBinderServiceManagerPresenceWatch);
+
+            watch->refcount = 1;
+            watch->sm = self;
+            watch->inotify_fd = fd;
+            watch->wake_fd = wake_fd;
+            watch->thread = g_thread_try_new(self->dev,
+                gbinder_servicemanager_presence_watch_thread, watch, NULL);
+            if (watch->thread) {
+                priv->presence_watch = watch;
+                return;
+            }
+            g_slice_free(GBinderServiceManagerPresenceWatch, watch);
+            close(wake_fd);
+        }
+        close(fd);
+    }
 }
 
 static
-gboolean
-gbinder_servicemanager_presense_check_timer(
-    gpointer user_data)
+void
+gbinder_servicemanager_presence_watch_stop(
+    GBinderServiceManager* self)
 {
-    GBinderServiceManager* self = GBINDER_SERVICEMANAGER(user_data);
-    GBinderRemoteObject* remote = self->client->remote;
     GBinderServiceManagerPriv* priv = self->priv;
-    gboolean result;
+    GBinderServiceManagerPresenceWatch* watch = priv->presence_watch;
 
-    GASSERT(remote->dead);
-    gbinder_servicemanager_ref(self);
-    if (gbinder_remote_object_reanimate(remote)) {
-        /* Done */
-        priv->presence_check = NULL;
-        gbinder_servicemanager_reanimated(self);
-        result = G_SOURCE_REMOVE;
-    } else if (priv->presence_check_delay_ms < PRESENSE_WAIT_MS_MAX) {
-        priv->presence_check_delay_ms += PRESENSE_WAIT_MS_STEP;
-        priv->presence_check =
-            gbinder_timeout_add(priv->presence_check_delay_ms,
-                gbinder_servicemanager_presense_check_timer, self);
-        result = G_SOURCE_REMOVE;
-    } else {
-        result = G_SOURCE_CONTINUE;
+    if (watch) {
+        const guint64 one = 1;
+
+        priv->presence_watch = NULL;
+        watch->sm = NULL;
+        if (write(watch->wake_fd, &one, sizeof(one)) < 0) {
+            GWARN("Failed to stop %s watcher: %s", self->dev,
+                strerror(errno));
+        }
+        g_thread_join(watch->thread);
+        close(watch->inotify_fd);
+        close(watch->wake_fd);
+        gbinder_servicemanager_presence_watch_unref(watch);
     }
-    gbinder_servicemanager_unref(self);
-    return result;
 }
 
 static
@@ -390,9 +1126,13 @@ gbinder_servicemanager_presence_check_start(
     GBinderServiceManagerPriv* priv = self->priv;
 
     GASSERT(!priv->presence_check);
-    priv->presence_check_delay_ms = PRESENSE_WAIT_MS_MIN;
-    priv->presence_check = gbinder_timeout_add(PRESENSE_WAIT_MS_MIN,
-        gbinder_servicemanager_presense_check_timer, self);
+    if (!priv->presence_watch) {
+        gbinder_servicemanager_presence_watch_start(self);
+    }
+    priv->presence_check_delay_ms = priv->presence_min_delay_ms;
+    priv->presence_check = gbinder_timeout_add_slack
+        (priv->presence_min_delay_ms,
+            gbinder_servicemanager_presense_check_timer, self);
 }
 
 static
@@ -452,7 +1192,8 @@ gbinder_servicemanager_autorelease_cb(
 
     priv->autorelease_cb = NULL;
     priv->autorelease = NULL;
-    g_slist_free_full(list, g_object_unref);
+    g_slist_free_full(list, (GDestroyNotify)
+        gbinder_remote_object_unref);
 }
 
 static
@@ -513,6 +1254,25 @@ gbinder_servicemanager_exit(
     gbinder_servicemanager_default = SERVICEMANAGER_TYPE_DEFAULT;
 }
 
+static
+GBinderServiceManager*
+gbinder_servicemanager_lookup(
+    GBinderServiceManagerClass* klass,
+    const char* dev)
+{
+    GBinderServiceManager* self = NULL;
+
+    /* Lock */
+    g_mutex_lock(&klass->mutex);
+    if (klass->table) {
+        self = gbinder_servicemanager_ref(g_hash_table_lookup(klass->table,
+            dev));
+    }
+    g_mutex_unlock(&klass->mutex);
+    /* Unlock */
+    return self;
+}
+
 /*==========================================================================*
  * Internal interface
  *==========================================================================*/
@@ -530,7 +1290,9 @@ gbinder_servicemanager_new_with_type(
         GBinderIpc* ipc;
 
         if (!dev) dev = klass->default_device;
-        ipc = gbinder_ipc_new(dev, rpc_protocol);
+        /* Existing instance doesn't need GBinderIpc lookup */
+        self = gbinder_servicemanager_lookup(klass, dev);
+        ipc = self ? NULL : gbinder_ipc_new(dev, rpc_protocol);
         if (ipc) {
             /* Create a (possibly) dead service manager object */
             GBinderRemoteObject* object = gbinder_ipc_get_service_manager(ipc);
@@ -553,6 +1315,14 @@ gbinder_servicemanager_new_with_type(
                     self = g_object_new(type, NULL);
                     self->client = gbinder_client_new(object, klass->iface);
                     self->dev = gbinder_remote_object_dev(object);
+                    gbinder_servicemanager_load_delays(self->priv, dev);
+                    if (gbinder_config_get_device_int
+                        (GBINDER_CONFIG_GROUP_SERVICE_CACHE, dev, 0) > 0) {
+                        GDEBUG("Caching %s services", dev);
+                        self->priv->cache = g_hash_table_new_full(g_str_hash,
+                            g_str_equal, NULL,
+                            gbinder_servicemanager_cache_entry_free);
+                    }
                     if (!klass->table) {
                         klass->table = g_hash_table_new_full(g_str_hash,
                             g_str_equal, g_free, NULL);
@@ -584,6 +1354,149 @@ gbinder_servicemanager_new_with_type(
     return self;
 }
 
+gulong
+gbinder_servicemanager_list_present(
+    GBinderServiceManager* self,
+    const GStrV* names,
+    GBinderServiceManagerListFunc func,
+    void* user_data)
+{
+    if (G_LIKELY(self) && names && func) {
+        GBinderServiceManagerListTxData* data =
+            g_slice_new0(GBinderServiceManagerListTxData);
+
+        data->sm = gbinder_servicemanager_ref(self);
+        data->func = func;
+        data->names = g_strdupv((char**)names);
+        data->user_data = user_data;
+
+        return gbinder_ipc_transact_custom(gbinder_client_ipc(self->client),
+            gbinder_servicemanager_list_tx_exec,
+            gbinder_servicemanager_list_tx_done,
+            gbinder_servicemanager_list_tx_free, data);
+    }
+    return 0;
+}
+
+gulong
+gbinder_servicemanager_add_services(
+    GBinderServiceManager* self,
+    const GStrV* names,
+    GBinderLocalObject* const* objects,
+    GBinderServiceManagerAddServicesFunc func,
+    void* user_data)
+{
+    const guint count = gutil_strv_length(names);
+
+    if (G_LIKELY(self) && count && objects && func) {
+        GBinderServiceManagerAddServicesTxData* data =
+            g_slice_new0(GBinderServiceManagerAddServicesTxData);
+        guint i;
+
+        data->sm = gbinder_servicemanager_ref(self);
+        data->func = func;
+        data->names = g_strdupv((char**)names);
+        data->objects = g_new(GBinderLocalObject*, count);
+        data->status = g_new(int, count);
+        data->count = count;
+        data->user_data = user_data;
+        for (i = 0; i < count; i++) {
+            data->objects[i] = gbinder_local_object_ref(objects[i]);
+            data->status[i] = (-ECANCELED);
+        }
+
+        return gbinder_ipc_transact_custom(gbinder_client_ipc(self->client),
+            gbinder_servicemanager_add_services_tx_exec,
+            gbinder_servicemanager_add_services_tx_done,
+            gbinder_servicemanager_add_services_tx_free, data);
+    }
+    return 0;
+}
+
+GBinderLocalObject*
+gbinder_servicemanager_new_clients_callback(
+    GBinderServiceManager* self,
+    GBinderLocalTransactFunc handler,
+    void* user_data)
+{
+    if (G_LIKELY(self)) {
+        const char* iface = GBINDER_SERVICEMANAGER_GET_CLASS(self)->
+            clients_callback_iface;
+
+        if (iface) {
+            return gbinder_local_object_new_callback
+                (gbinder_client_ipc(self->client), iface, handler, user_data);
+        }
+    }
+    return NULL;
+}
+
+gboolean
+gbinder_servicemanager_read_clients(
+    GBinderServiceManager* self,
+    GBinderRemoteRequest* req,
+    guint code,
+    gboolean* has_clients)
+{
+    if (G_LIKELY(self) && G_LIKELY(req)) {
+        GBinderServiceManagerClass* klass =
+            GBINDER_SERVICEMANAGER_GET_CLASS(self);
+
+        if (klass->read_clients &&
+            !g_strcmp0(gbinder_remote_request_interface(req),
+            klass->clients_callback_iface)) {
+            return klass->read_clients(self, req, code, has_clients);
+        }
+    }
+    return FALSE;
+}
+
+gulong
+gbinder_servicemanager_register_clients_callback(
+    GBinderServiceManager* self,
+    const char* name,
+    GBinderLocalObject* obj,
+    GBinderLocalObject* cb,
+    GBinderServiceManagerAddServiceFunc func,
+    void* user_data)
+{
+    if (G_LIKELY(self) && name && obj && cb && func &&
+        GBINDER_SERVICEMANAGER_GET_CLASS(self)->register_clients_callback) {
+        GBinderServiceManagerClientsTxData* data =
+            g_slice_new0(GBinderServiceManagerClientsTxData);
+
+        data->sm = gbinder_servicemanager_ref(self);
+        data->obj = gbinder_local_object_ref(obj);
+        data->cb = gbinder_local_object_ref(cb);
+        data->func = func;
+        data->name = g_strdup(name);
+        data->user_data = user_data;
+        data->status = (-EFAULT);
+
+        return gbinder_ipc_transact_custom(gbinder_client_ipc(self->client),
+            gbinder_servicemanager_clients_tx_exec,
+            gbinder_servicemanager_clients_tx_done,
+            gbinder_servicemanager_clients_tx_free, data);
+    }
+    return 0;
+}
+
+int
+gbinder_servicemanager_try_unregister(
+    GBinderServiceManager* self,
+    const char* name,
+    GBinderLocalObject* obj)
+{
+    if (G_LIKELY(self) && name && obj) {
+        GBinderServiceManagerClass* klass =
+            GBINDER_SERVICEMANAGER_GET_CLASS(self);
+
+        return klass->try_unregister ? klass->try_unregister(self, name, obj,
+            &gbinder_ipc_sync_main) : (-EOPNOTSUPP);
+    }
+    return (-EINVAL);
+}
+
 void
 gbinder_servicemanager_service_registered(
     GBinderServiceManager* self,
@@ -595,6 +1508,8 @@ gbinder_servicemanager_service_registered(
     const char* normalized_name;
     char* tmp_name = NULL;
 
+    /* The name may now refer to a different object */
+    gbinder_servicemanager_cache_remove(self, name);
     switch (klass->check_name(self, name)) {
     case GBINDER_SERVICEMANAGER_NAME_OK:
         normalized_name = name;
@@ -618,6 +1533,22 @@ gbinder_servicemanager_service_registered(
  * Interface
  *==========================================================================*/
 
+static
+GBinderServiceManager*
+gbinder_servicemanager_new_with_protocol(
+    const GBinderServiceManagerType* type,
+    const char* dev,
+    const char* rpc_protocol)
+{
+    GBinderServiceManager* self = gbinder_servicemanager_new_with_type
+        (type->get_type(), dev, rpc_protocol);
+
+    if (self) {
+        self->priv->protocol = type->name;
+    }
+    return self;
+}
+
 GBinderServiceManager*
 gbinder_servicemanager_new(
     const char* dev)
@@ -659,7 +1590,7 @@ gbinder_servicemanager_new2(
             type = gbinder_servicemanager_default;
             GDEBUG("Using default service manager %s for %s", type->name, dev);
         }
-        return gbinder_servicemanager_new_with_type(type->get_type(), dev,
+        return gbinder_servicemanager_new_with_protocol(type, dev,
             rpc_protocol);
     } else {
         /* If protocol name is specified, it must be a valid one */
@@ -667,7 +1598,7 @@ gbinder_servicemanager_new2(
             gbinder_servicemanager_value_map(sm_protocol);
 
         if (type) {
-            return gbinder_servicemanager_new_with_type(type->get_type(), dev,
+            return gbinder_servicemanager_new_with_protocol(type, dev,
                 rpc_protocol);
         } else {
             GWARN("Unknown servicemanager protocol %s", sm_protocol);
@@ -731,6 +1662,52 @@ gbinder_servicemanager_device(
     return G_LIKELY(self) ? self->dev : NULL;
 }
 
+/* Service manager protocol (aidl, aidl2, aidl3, aidl4 or hidl) */
+const char*
+gbinder_servicemanager_protocol(
+    GBinderServiceManager* self) /* Since 1.1.25 */
+{
+    return G_LIKELY(self) ? self->priv->protocol : NULL;
+}
+
+gsize
+gbinder_servicemanager_buffer_space(
+    GBinderServiceManager* self) /* Since 1.1.25 */
+{
+    /* Size of the driver's mapping receiving incoming transactions */
+    return G_LIKELY(self) ?
+        gbinder_driver_vm_size(gbinder_servicemanager_ipc(self)->driver) : 0;
+}
+
+gsize
+gbinder_servicemanager_buffer_pinned(
+    GBinderServiceManager* self) /* Since 1.1.25 */
+{
+    /* Part of the mapping occupied by the buffers which are still alive */
+    return G_LIKELY(self) ?
+        gbinder_driver_pinned_size(gbinder_servicemanager_ipc(self)->driver) :
+        0;
+}
+
+/*
+ * Binds the device to the given GMainContext. Incoming transactions,
+ * completions of asynchronous calls and notifications for all objects
+ * associated with this device will be dispatched there rather than in
+ * the default context, e.g. on a separate thread for each device. Must
+ * be done before making any calls or registering any objects, and only
+ * works with the default (GLib) event loop integration.
+ */
+void
+gbinder_servicemanager_set_main_context(
+    GBinderServiceManager* self,
+    GMainContext* context) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        gbinder_ipc_set_main_context(gbinder_servicemanager_ipc(self),
+            context);
+    }
+}
+
 gboolean
 gbinder_servicemanager_is_present(
     GBinderServiceManager* self) /* Since 1.0.25 */
@@ -753,28 +1730,46 @@ gbinder_servicemanager_wait(
             return TRUE;
         } else if (max_wait_ms != 0) {
             /* Zero timeout means a singe check and it's already done */
-            long delay_ms = PRESENSE_WAIT_MS_MIN;
+            const int fd = gbinder_servicemanager_inotify_new(self->dev);
+            GBinderServiceManagerPriv* priv = self->priv;
+            const long max_delay_ms = (fd >= 0) ?
+                MAX(PRESENSE_WATCH_MS_MAX, priv->presence_max_delay_ms) :
+                priv->presence_max_delay_ms;
+            const gint64 deadline = g_get_monotonic_time() +
+                ((gint64)max_wait_ms) * 1000;
+            long delay_ms = priv->presence_min_delay_ms;
+            gboolean found = FALSE;
+
+            while (!found) {
+                long wait_ms = delay_ms;
 
-            while (max_wait_ms != 0) {
                 if (max_wait_ms > 0) {
-                    if (max_wait_ms < delay_ms) {
-                        delay_ms = max_wait_ms;
-                        max_wait_ms = 0;
-                    } else {
-                        max_wait_ms -= delay_ms;
+                    const gint64 left_ms = (deadline -
+                        g_get_monotonic_time()) / 1000;
+
+                    if (left_ms <= 0) {
+                        break;
+                    } else if (wait_ms > left_ms) {
+                        wait_ms = (long)left_ms;
                     }
                 }
-                gbinder_servicemanager_sleep_ms(delay_ms);
-                if (gbinder_remote_object_reanimate(remote)) {
-                    gbinder_servicemanager_reanimated(self);
-                    return TRUE;
-                }
-                if (delay_ms < PRESENSE_WAIT_MS_MAX) {
-                    delay_ms += PRESENSE_WAIT_MS_STEP;
-                    if (delay_ms > PRESENSE_WAIT_MS_MAX) {
-                        delay_ms = PRESENSE_WAIT_MS_MAX;
-                    }
+                if (fd < 0) {
+                    gbinder_servicemanager_sleep_ms(wait_ms);
+                    delay_ms = MIN(2 * delay_ms, max_delay_ms);
+                } else if (gbinder_servicemanager_inotify_wait(fd, wait_ms)) {
+                    /* Someone has opened the device, start over */
+                    delay_ms = PRESENSE_WAIT_MS_MIN;
+                } else {
+                    delay_ms = MIN(2 * delay_ms, max_delay_ms);
                 }
+                found = gbinder_remote_object_reanimate(remote);
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+            if (found) {
+                gbinder_servicemanager_reanimated(self);
+                return TRUE;
             }
             /* Timeout */
             GWARN("Timeout waiting for service manager %s", self->dev);
@@ -816,6 +1811,48 @@ gbinder_servicemanager_list_sync(
     return NULL;
 }
 
+/*
+ * Lists the names of the registered instances of the interface, in the
+ * "iface/instance" form accepted by gbinder_servicemanager_get_service().
+ * hwservicemanager does it natively. Other service managers don't have
+ * such a call, the full list is fetched and filtered.
+ */
+gulong
+gbinder_servicemanager_list_by_interface(
+    GBinderServiceManager* self,
+    const char* iface,
+    GBinderServiceManagerListFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && iface && func) {
+        GBinderServiceManagerListTxData* data =
+            g_slice_new0(GBinderServiceManagerListTxData);
+
+        data->sm = gbinder_servicemanager_ref(self);
+        data->func = func;
+        data->iface = g_strdup(iface);
+        data->user_data = user_data;
+
+        return gbinder_ipc_transact_custom(gbinder_client_ipc(self->client),
+            gbinder_servicemanager_list_tx_exec,
+            gbinder_servicemanager_list_tx_done,
+            gbinder_servicemanager_list_tx_free, data);
+    }
+    return 0;
+}
+
+char**
+gbinder_servicemanager_list_by_interface_sync(
+    GBinderServiceManager* self,
+    const char* iface) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && iface) {
+        return gbinder_servicemanager_list_by_interface2(self, iface,
+            &gbinder_ipc_sync_main);
+    }
+    return NULL;
+}
+
 gulong
 gbinder_servicemanager_get_service(
     GBinderServiceManager* self,
@@ -850,8 +1887,8 @@ gbinder_servicemanager_get_service_sync(
     GBinderRemoteObject* obj = NULL;
 
     if (G_LIKELY(self) && name) {
-        obj = GBINDER_SERVICEMANAGER_GET_CLASS(self)->
-            get_service(self, name, status, &gbinder_ipc_sync_main);
+        obj = gbinder_servicemanager_get_service_cached(self, name, status,
+            &gbinder_ipc_sync_main);
         if (obj) {
             GBinderServiceManagerPriv* priv = self->priv;
 
@@ -867,6 +1904,84 @@ gbinder_servicemanager_get_service_sync(
     return obj;
 }
 
+gulong
+gbinder_servicemanager_get_services(
+    GBinderServiceManager* self,
+    const char* const* names,
+    guint max_wait_ms,
+    GBinderServiceManagerGetServicesFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    const guint count = gutil_strv_length((const GStrV*)names);
+
+    if (G_LIKELY(self) && func && count) {
+        GBinderServiceManagerPriv* priv = self->priv;
+        GBinderServiceManagerBatch* batch =
+            g_slice_new0(GBinderServiceManagerBatch);
+        guint i;
+
+        batch->sm = gbinder_servicemanager_ref(self);
+        batch->count = count;
+        batch->names = g_strdupv((char**)names);
+        batch->objects = g_new0(GBinderRemoteObject*, count);
+        batch->items = g_new0(GBinderServiceManagerBatchItem, count);
+        batch->func = func;
+        batch->user_data = user_data;
+        if (max_wait_ms) {
+            batch->deadline = gbinder_timeout_add(max_wait_ms,
+                gbinder_servicemanager_batch_timeout, batch);
+        }
+
+        for (i = 0; i < count; i++) {
+            GBinderServiceManagerBatchItem* item = batch->items + i;
+
+            item->batch = batch;
+            item->name = batch->names[i];
+            item->tx_id = gbinder_servicemanager_get_service(self,
+                item->name, gbinder_servicemanager_batch_get_service_done,
+                item);
+            batch->pending++;
+        }
+
+        /*
+         * The transaction ids come from a monotonically increasing
+         * counter, the id of the first lookup won't be reused while
+         * the batch is alive.
+         */
+        batch->id = batch->items[0].tx_id;
+        if (!priv->batches) {
+            priv->batches = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        g_hash_table_insert(priv->batches, GSIZE_TO_POINTER(batch->id),
+            batch);
+        return batch->id;
+    }
+    return 0;
+}
+
+gulong
+gbinder_servicemanager_ping_many(
+    GBinderServiceManager* self,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    guint timeout_ms,
+    GBinderServiceManagerPingFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && func && objects && count) {
+        GBinderServiceManagerPingMany* data =
+            g_slice_new0(GBinderServiceManagerPingMany);
+
+        data->sm = gbinder_servicemanager_ref(self);
+        data->func = func;
+        data->user_data = user_data;
+        return gbinder_ipc_ping_many(gbinder_client_ipc(self->client),
+            objects, count, timeout_ms, gbinder_servicemanager_ping_many_done,
+            gbinder_servicemanager_ping_many_free, data);
+    }
+    return 0;
+}
+
 gulong
 gbinder_servicemanager_add_service(
     GBinderServiceManager* self,
@@ -914,7 +2029,16 @@ gbinder_servicemanager_cancel(
     gulong id)
 {
     if (G_LIKELY(self)) {
-        gbinder_ipc_cancel(gbinder_client_ipc(self->client), id);
+        GBinderServiceManagerPriv* priv = self->priv;
+        GBinderServiceManagerBatch* batch = priv->batches ?
+            g_hash_table_lookup(priv->batches, GSIZE_TO_POINTER(id)) : NULL;
+
+        if (batch) {
+            g_hash_table_remove(priv->batches, GSIZE_TO_POINTER(id));
+            gbinder_servicemanager_batch_free(batch);
+        } else {
+            gbinder_ipc_cancel(gbinder_client_ipc(self->client), id);
+        }
     }
 }
 
@@ -928,6 +2052,37 @@ gbinder_servicemanager_add_presence_handler(
         SIGNAL_PRESENCE_NAME, G_CALLBACK(func), user_data) : 0;
 }
 
+static
+void
+gbinder_servicemanager_oneway_spam(
+    GBinderIpc* ipc,
+    void* user_data)
+{
+    GBinderServiceManager* self = GBINDER_SERVICEMANAGER(user_data);
+
+    g_signal_emit(self, gbinder_servicemanager_signals[SIGNAL_ONEWAY_SPAM], 0);
+}
+
+gulong
+gbinder_servicemanager_add_oneway_spam_handler(
+    GBinderServiceManager* self,
+    GBinderServiceManagerFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self) && G_LIKELY(func)) {
+        GBinderServiceManagerPriv* priv = self->priv;
+
+        if (!priv->oneway_spam_id) {
+            priv->oneway_spam_id = gbinder_ipc_add_oneway_spam_handler
+                (gbinder_servicemanager_ipc(self),
+                    gbinder_servicemanager_oneway_spam, self);
+        }
+        return g_signal_connect(self, SIGNAL_ONEWAY_SPAM_NAME,
+            G_CALLBACK(func), user_data);
+    }
+    return 0;
+}
+
 gulong
 gbinder_servicemanager_add_registration_handler(
     GBinderServiceManager* self,
@@ -1040,16 +2195,16 @@ GBinderServiceManager*
 gbinder_defaultservicemanager_new(
     const char* dev)
 {
-    return gbinder_servicemanager_new_with_type
-        (gbinder_servicemanager_aidl_get_type(), dev, NULL);
+    return gbinder_servicemanager_new_with_protocol
+        (SERVICEMANAGER_TYPE_AIDL, dev, NULL);
 }
 
 GBinderServiceManager*
 gbinder_hwservicemanager_new(
     const char* dev)
 {
-    return gbinder_servicemanager_new_with_type
-        (gbinder_servicemanager_hidl_get_type(), dev, NULL);
+    return gbinder_servicemanager_new_with_protocol
+        (SERVICEMANAGER_TYPE_HIDL, dev, NULL);
 }
 
 /*==========================================================================*
@@ -1065,8 +2220,11 @@ gbinder_servicemanager_init(
         GBINDER_TYPE_SERVICEMANAGER, GBinderServiceManagerPriv);
 
     self->priv = priv;
+    priv->presence_min_delay_ms = PRESENSE_WAIT_MS_MIN;
+    priv->presence_max_delay_ms = PRESENSE_WAIT_MS_MAX;
     priv->watch_table = g_hash_table_new_full(g_str_hash, g_str_equal,
         NULL, gbinder_servicemanager_watch_free);
+    g_mutex_init(&priv->cache_mutex);
 }
 
 static
@@ -1120,10 +2278,21 @@ gbinder_servicemanager_finalize(
     GBinderServiceManagerPriv* priv = self->priv;
 
     gbinder_timeout_remove(priv->presence_check);
+    gbinder_servicemanager_presence_watch_stop(self);
     gbinder_remote_object_remove_handler(self->client->remote, priv->death_id);
+    gbinder_ipc_remove_handler(gbinder_servicemanager_ipc(self),
+        priv->oneway_spam_id);
     gbinder_idle_callback_destroy(priv->autorelease_cb);
-    g_slist_free_full(priv->autorelease, g_object_unref);
+    g_slist_free_full(priv->autorelease, (GDestroyNotify)
+        gbinder_remote_object_unref);
     g_hash_table_destroy(priv->watch_table);
+    if (priv->batches) {
+        g_hash_table_destroy(priv->batches);
+    }
+    if (priv->cache) {
+        g_hash_table_destroy(priv->cache);
+    }
+    g_mutex_clear(&priv->cache_mutex);
     gbinder_client_unref(self->client);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
@@ -1148,6 +2317,10 @@ gbinder_servicemanager_class_init(
         g_signal_new(SIGNAL_REGISTRATION_NAME, type,
             G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, 0, NULL, NULL, NULL,
             G_TYPE_NONE, 1, G_TYPE_STRING);
+    gbinder_servicemanager_signals[SIGNAL_ONEWAY_SPAM] =
+        g_signal_new(SIGNAL_ONEWAY_SPAM_NAME, type,
+            G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL,
+            G_TYPE_NONE, 0);
 }
 
 /*
@@ -38,14 +38,25 @@
 #include "gbinder_client_p.h"
 #include "gbinder_log.h"
 
+#include <gbinder_local_object.h>
 #include <gbinder_local_request.h>
 #include <gbinder_remote_reply.h>
+#include <gbinder_remote_request.h>
+#include <gbinder_reader.h>
 
+/*
+ * Service managers which support registerForNotifications (Android 11
+ * and later) push the registration events to the callback object. For
+ * the older ones (or if the registration fails) the list of services
+ * gets polled.
+ */
 typedef struct gbinder_servicemanager_aidl_watch {
+    GBinderServiceManager* manager;
     GBinderServicePoll* poll;
     char* name;
     gulong handler_id;
     GBinderEventLoopTimeout* notify;
+    GBinderLocalObject* callback;
 } GBinderServiceManagerAidlWatch;
 
 struct gbinder_servicemanager_aidl_priv {
@@ -63,6 +74,7 @@ G_DEFINE_TYPE(GBinderServiceManagerAidl,
     GBinderServiceManagerAidl)
 
 #define SERVICEMANAGER_AIDL_IFACE  "android.os.IServiceManager"
+#define SERVICEMANAGER_AIDL_CALLBACK_IFACE  "android.os.IServiceCallback"
 
 static
 void
@@ -74,14 +86,12 @@ gbinder_servicemanager_aidl_watch_proc(
     GBinderServiceManagerAidlWatch* watch = user_data;
 
     if (!g_strcmp0(name_added, watch->name)) {
-        GBinderServiceManager* manager =
-            gbinder_servicepoll_manager(watch->poll);
-
         if (watch->notify) {
             gbinder_timeout_remove(watch->notify);
             watch->notify = NULL;
         }
-        gbinder_servicemanager_service_registered(manager, name_added);
+        /* The poll may be shared with other service managers */
+        gbinder_servicemanager_service_registered(watch->manager, name_added);
     }
 }
 
@@ -91,16 +101,49 @@ gbinder_servicemanager_aidl_watch_notify(
     gpointer user_data)
 {
     GBinderServiceManagerAidlWatch* watch = user_data;
-    GBinderServiceManager* manager = gbinder_servicepoll_manager(watch->poll);
     char* name = g_strdup(watch->name);
 
     GASSERT(watch->notify);
     watch->notify = NULL;
-    gbinder_servicemanager_service_registered(manager, name);
+    gbinder_servicemanager_service_registered(watch->manager, name);
     g_free(name);
     return G_SOURCE_REMOVE;
 }
 
+static
+GBinderLocalReply*
+gbinder_servicemanager_aidl_callback(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    GBinderServiceManagerAidlWatch* watch = user_data;
+    const char* iface = gbinder_remote_request_interface(req);
+
+    if (!g_strcmp0(iface, SERVICEMANAGER_AIDL_CALLBACK_IFACE) &&
+        code == ON_REGISTRATION_TRANSACTION) {
+        GBinderReader reader;
+        char* name;
+
+        /* oneway void onRegistration(String name, IBinder binder) */
+        gbinder_remote_request_init_reader(req, &reader);
+        name = gbinder_reader_read_string16(&reader);
+        GDEBUG(SERVICEMANAGER_AIDL_CALLBACK_IFACE " onRegistration %s", name);
+        if (name) {
+            gbinder_servicemanager_service_registered(watch->manager, name);
+            g_free(name);
+        }
+        *status = GBINDER_STATUS_OK;
+    } else {
+        GDEBUG("%s %u", iface, code);
+        *status = GBINDER_STATUS_FAILED;
+    }
+    return NULL;
+}
+
 static
 void
 gbinder_servicemanager_aidl_watch_free(
@@ -108,13 +151,77 @@ gbinder_servicemanager_aidl_watch_free(
 {
     GBinderServiceManagerAidlWatch* watch = user_data;
 
-    gbinder_timeout_remove(watch->notify);
-    gbinder_servicepoll_remove_handler(watch->poll, watch->handler_id);
-    gbinder_servicepoll_unref(watch->poll);
+    if (watch->callback) {
+        GBinderServiceManager* manager = watch->manager;
+        GBinderClient* client = manager->client;
+        GBinderLocalRequest* req = GBINDER_SERVICEMANAGER_AIDL_GET_CLASS
+            (manager)->notification_req(client, watch->name, watch->callback);
+
+        /* Don't wait for unregisterForNotifications to complete */
+        gbinder_local_request_cleanup(req, (GDestroyNotify)
+            gbinder_local_object_unref,
+            gbinder_local_object_ref(watch->callback));
+        gbinder_client_transact(client,
+            UNREGISTER_FOR_NOTIFICATIONS_TRANSACTION, 0, req,
+            NULL, NULL, NULL);
+        gbinder_local_request_unref(req);
+        gbinder_local_object_drop(watch->callback);
+    } else {
+        gbinder_timeout_remove(watch->notify);
+        gbinder_servicepoll_remove_handler(watch->poll, watch->handler_id);
+        gbinder_servicepoll_unwatch_name(watch->poll, watch->name);
+        gbinder_servicepoll_unref(watch->poll);
+    }
     g_free(watch->name);
     g_slice_free(GBinderServiceManagerAidlWatch, watch);
 }
 
+static
+GBinderServiceManagerAidlWatch*
+gbinder_servicemanager_aidl_watch_register(
+    GBinderServiceManagerAidl* self,
+    const char* name)
+{
+    GBinderServiceManager* manager = &self->manager;
+    GBinderClient* client = manager->client;
+    GBinderServiceManagerAidlWatch* watch =
+        g_slice_new0(GBinderServiceManagerAidlWatch);
+    GBinderLocalRequest* req;
+    GBinderRemoteReply* reply;
+    gint32 exception = -1;
+    int status;
+
+    watch->manager = manager;
+    watch->name = g_strdup(name);
+    watch->callback = gbinder_servicemanager_new_local_object(manager,
+        SERVICEMANAGER_AIDL_CALLBACK_IFACE,
+        gbinder_servicemanager_aidl_callback, watch);
+
+    /* registerForNotifications(String name, IServiceCallback callback) */
+    req = GBINDER_SERVICEMANAGER_AIDL_GET_CLASS(self)->notification_req
+        (client, name, watch->callback);
+    reply = gbinder_client_transact_sync_reply(client,
+        REGISTER_FOR_NOTIFICATIONS_TRANSACTION, req, &status);
+    if (status == GBINDER_STATUS_OK && reply) {
+        GBinderReader reader;
+
+        gbinder_remote_reply_init_reader(reply, &reader);
+        gbinder_reader_read_int32(&reader, &exception);
+    }
+    gbinder_remote_reply_unref(reply);
+    gbinder_local_request_unref(req);
+
+    if (exception) {
+        GDEBUG("Failed to register for '%s' notifications (%d/%d)", name,
+            status, exception);
+        gbinder_local_object_drop(watch->callback);
+        g_free(watch->name);
+        g_slice_free(GBinderServiceManagerAidlWatch, watch);
+        return NULL;
+    }
+    return watch;
+}
+
 static
 GBinderServiceManagerAidlWatch*
 gbinder_servicemanager_aidl_watch_new(
@@ -125,10 +232,12 @@ gbinder_servicemanager_aidl_watch_new(
     GBinderServiceManagerAidlWatch* watch =
         g_slice_new0(GBinderServiceManagerAidlWatch);
 
+    watch->manager = &self->manager;
     watch->name = g_strdup(name);
     watch->poll = gbinder_servicepoll_new(&self->manager, &priv->poll);
     watch->handler_id = gbinder_servicepoll_add_handler(priv->poll,
         gbinder_servicemanager_aidl_watch_proc, watch);
+    gbinder_servicepoll_watch_name(watch->poll, name);
     return watch;
 }
 
@@ -250,13 +359,22 @@ gbinder_servicemanager_aidl_watch(
 {
     GBinderServiceManagerAidl* self = GBINDER_SERVICEMANAGER_AIDL(manager);
     GBinderServiceManagerAidlPriv* priv = self->priv;
-    GBinderServiceManagerAidlWatch* watch =
-        gbinder_servicemanager_aidl_watch_new(self, name);
+    GBinderServiceManagerAidlWatch* watch = NULL;
+
+    if (GBINDER_SERVICEMANAGER_AIDL_GET_CLASS(self)->notification_req) {
+        watch = gbinder_servicemanager_aidl_watch_register(self, name);
+    }
 
-    g_hash_table_replace(priv->watch_table, watch->name, watch);
-    if (gbinder_servicepoll_is_known_name(watch->poll, name)) {
-        watch->notify = gbinder_idle_add
-            (gbinder_servicemanager_aidl_watch_notify, watch);
+    if (watch) {
+        /* Service manager calls back right away if it's already there */
+        g_hash_table_replace(priv->watch_table, watch->name, watch);
+    } else {
+        watch = gbinder_servicemanager_aidl_watch_new(self, name);
+        g_hash_table_replace(priv->watch_table, watch->name, watch);
+        if (gbinder_servicepoll_is_known_name(watch->poll, name)) {
+            watch->notify = gbinder_idle_add
+                (gbinder_servicemanager_aidl_watch_notify, watch);
+        }
     }
     return TRUE;
 }
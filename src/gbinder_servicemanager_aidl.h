@@ -47,6 +47,9 @@ typedef struct gbinder_servicemanager_aidl_class {
         (GBinderClient* client, gint32 index);
     GBinderLocalRequest* (*add_service_req)
         (GBinderClient* client, const char* name, GBinderLocalObject* obj);
+    /* Optional, if NULL then the service list is polled */
+    GBinderLocalRequest* (*notification_req)
+        (GBinderClient* client, const char* name, GBinderLocalObject* cb);
 } GBinderServiceManagerAidlClass;
 
 #define GBINDER_TYPE_SERVICEMANAGER_AIDL \
@@ -63,7 +66,23 @@ enum gbinder_servicemanager_aidl_calls {
     GET_SERVICE_TRANSACTION = GBINDER_FIRST_CALL_TRANSACTION,
     CHECK_SERVICE_TRANSACTION,
     ADD_SERVICE_TRANSACTION,
-    LIST_SERVICES_TRANSACTION
+    LIST_SERVICES_TRANSACTION,
+    REGISTER_FOR_NOTIFICATIONS_TRANSACTION,
+    UNREGISTER_FOR_NOTIFICATIONS_TRANSACTION,
+    IS_DECLARED_TRANSACTION,
+    GET_DECLARED_INSTANCES_TRANSACTION,
+    UPDATABLE_VIA_APEX_TRANSACTION,
+    /* Android 12, shifted by two in Android 13 */
+    REGISTER_CLIENT_CALLBACK_TRANSACTION,
+    TRY_UNREGISTER_SERVICE_TRANSACTION
+};
+
+enum gbinder_servicemanager_aidl_notifications {
+    ON_REGISTRATION_TRANSACTION = GBINDER_FIRST_CALL_TRANSACTION
+};
+
+enum gbinder_servicemanager_aidl_client_callback {
+    ON_CLIENTS_TRANSACTION = GBINDER_FIRST_CALL_TRANSACTION
 };
 
 enum gbinder_stability_level {
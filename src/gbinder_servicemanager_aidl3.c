@@ -35,6 +35,7 @@
 #include "gbinder_servicemanager_aidl_p.h"
 #include "gbinder_client_p.h"
 #include "gbinder_reader_p.h"
+#include "gbinder_log.h"
 
 #include <gbinder_local_request.h>
 #include <gbinder_remote_reply.h>
@@ -76,15 +77,51 @@ gbinder_servicemanager_aidl3_get_service(
     return obj;
 }
 
+static
 char**
-gbinder_servicemanager_aidl3_list(
+gbinder_servicemanager_aidl3_list_by_index(
     GBinderServiceManager* manager,
     const GBinderIpcSyncApi* api)
 {
     GPtrArray* list = g_ptr_array_new();
     GBinderClient* client = manager->client;
     GBinderRemoteReply* reply;
+
+    /* Pre-Android 11 way, one transaction per service */
+    for (;;) {
+        GBinderLocalRequest* req = gbinder_client_new_request(client);
+        char* service = NULL;
+
+        gbinder_local_request_append_int32(req, list->len);
+        gbinder_local_request_append_int32(req, DUMP_FLAG_PRIORITY_ALL);
+        reply = gbinder_client_transact_sync_reply2(client,
+            LIST_SERVICES_TRANSACTION, req, NULL, api);
+        gbinder_local_request_unref(req);
+        if (reply) {
+            service = gbinder_remote_reply_read_string16(reply);
+            gbinder_remote_reply_unref(reply);
+        }
+        if (service) {
+            g_ptr_array_add(list, service);
+        } else {
+            break;
+        }
+    }
+
+    g_ptr_array_add(list, NULL);
+    return (char**)g_ptr_array_free(list, FALSE);
+}
+
+char**
+gbinder_servicemanager_aidl3_list(
+    GBinderServiceManager* manager,
+    const GBinderIpcSyncApi* api)
+{
+    GPtrArray* list = NULL;
+    GBinderClient* client = manager->client;
+    GBinderRemoteReply* reply;
     GBinderLocalRequest* req = gbinder_client_new_request(client);
+    int status = GBINDER_STATUS_FAILED;
 
     /*
      * Starting from Android 11, no `index` field is required but
@@ -94,7 +131,8 @@ gbinder_servicemanager_aidl3_list(
      */
     gbinder_local_request_append_int32(req, DUMP_FLAG_PRIORITY_ALL);
     reply = gbinder_client_transact_sync_reply2(client,
-        LIST_SERVICES_TRANSACTION, req, NULL, api);
+        LIST_SERVICES_TRANSACTION, req, &status, api);
+    gbinder_local_request_unref(req);
 
     if (reply) {
         GBinderReader reader;
@@ -102,18 +140,32 @@ gbinder_servicemanager_aidl3_list(
 
         gbinder_remote_reply_init_reader(reply, &reader);
         gbinder_reader_read_int32(&reader, NULL /* status */);
-        if (gbinder_reader_read_int32(&reader, &count)) {
+        if (gbinder_reader_read_int32(&reader, &count) && count >= 0) {
             int i;
 
             /* Iterate each service name */
+            list = g_ptr_array_sized_new(count + 1);
             for (i = 0; i < count; i++) {
-                g_ptr_array_add(list, gbinder_reader_read_string16(&reader));
+                char* name = gbinder_reader_read_string16(&reader);
+
+                if (name) {
+                    g_ptr_array_add(list, name);
+                } else {
+                    break;
+                }
             }
         }
         gbinder_remote_reply_unref(reply);
+    } else if (status != GBINDER_STATUS_OK &&
+        status != GBINDER_STATUS_DEAD_OBJECT) {
+        /* Service manager may not understand the single-shot request */
+        GDEBUG("Listing services by index (%d)", status);
+        return gbinder_servicemanager_aidl3_list_by_index(manager, api);
     }
 
-    gbinder_local_request_unref(req);
+    if (!list) {
+        list = g_ptr_array_new();
+    }
     g_ptr_array_add(list, NULL);
     return (char**)g_ptr_array_free(list, FALSE);
 }
@@ -139,6 +191,21 @@ gbinder_servicemanager_aidl3_add_service_req(
     return req;
 }
 
+static
+GBinderLocalRequest*
+gbinder_servicemanager_aidl3_notification_req(
+    GBinderClient* client,
+    const char* name,
+    GBinderLocalObject* callback)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request(client);
+
+    gbinder_local_request_append_string16(req, name);
+    gbinder_local_request_append_local_object(req, callback);
+    gbinder_local_request_append_int32(req, SYSTEM);
+    return req;
+}
+
 static
 void
 gbinder_servicemanager_aidl3_init(
@@ -154,6 +221,7 @@ gbinder_servicemanager_aidl3_class_init(
     GBinderServiceManagerClass* manager = GBINDER_SERVICEMANAGER_CLASS(klass);
 
     klass->add_service_req = gbinder_servicemanager_aidl3_add_service_req;
+    klass->notification_req = gbinder_servicemanager_aidl3_notification_req;
     manager->list = gbinder_servicemanager_aidl3_list;
     manager->get_service = gbinder_servicemanager_aidl3_get_service;
 }
@@ -35,10 +35,12 @@
 #include "gbinder_servicemanager_aidl_p.h"
 #include "gbinder_client_p.h"
 #include "gbinder_reader_p.h"
+#include "gbinder_log.h"
 #include "binder.h"
 
 #include <gbinder_local_request.h>
 #include <gbinder_remote_reply.h>
+#include <gbinder_remote_request.h>
 
 /* Variant of AIDL servicemanager appeared in Android 12 (API level 31) */
 
@@ -52,6 +54,10 @@ G_DEFINE_TYPE(GBinderServiceManagerAidl4,
 #define PARENT_CLASS gbinder_servicemanager_aidl4_parent_class
 
 #define BINDER_WIRE_FORMAT_VERSION (1)
+#define BINDER_STABILITY_SYSTEM \
+    B_PACK_CHARS(SYSTEM, 0, 0, BINDER_WIRE_FORMAT_VERSION)
+
+#define SERVICEMANAGER_AIDL4_CLIENT_CALLBACK_IFACE "android.os.IClientCallback"
 
 static
 GBinderLocalRequest*
@@ -82,6 +88,119 @@ gbinder_servicemanager_aidl4_add_service_req(
     return req;
 }
 
+static
+GBinderLocalRequest*
+gbinder_servicemanager_aidl4_notification_req(
+    GBinderClient* client,
+    const char* name,
+    GBinderLocalObject* callback)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request(client);
+
+    gbinder_local_request_append_string16(req, name);
+    gbinder_local_request_append_local_object(req, callback);
+    gbinder_local_request_append_int32(req, B_PACK_CHARS(SYSTEM, 0, 0,
+        BINDER_WIRE_FORMAT_VERSION));
+    return req;
+}
+
+static
+int
+gbinder_servicemanager_aidl4_exception(
+    GBinderClient* client,
+    guint32 code,
+    GBinderLocalRequest* req,
+    const GBinderIpcSyncApi* api)
+{
+    int status;
+    GBinderRemoteReply* reply = gbinder_client_transact_sync_reply2(client,
+        code, req, &status, api);
+
+    if (status == GBINDER_STATUS_OK) {
+        GBinderReader reader;
+        gint32 exception = -1;
+
+        gbinder_remote_reply_init_reader(reply, &reader);
+        gbinder_reader_read_int32(&reader, &exception);
+        if (exception) {
+            status = GBINDER_STATUS_FAILED;
+        }
+    }
+    gbinder_remote_reply_unref(reply);
+    gbinder_local_request_unref(req);
+    return status;
+}
+
+static
+gboolean
+gbinder_servicemanager_aidl4_read_clients(
+    GBinderServiceManager* manager,
+    GBinderRemoteRequest* req,
+    guint code,
+    gboolean* has_clients)
+{
+    if (code == ON_CLIENTS_TRANSACTION) {
+        GBinderReader reader;
+
+        /* oneway void onClients(IBinder registered, boolean hasClients) */
+        gbinder_remote_request_init_reader(req, &reader);
+        return gbinder_reader_skip_object(&reader) &&
+            gbinder_reader_read_int32(&reader, NULL /* stability */) &&
+            gbinder_reader_read_bool(&reader, has_clients);
+    }
+    return FALSE;
+}
+
+static
+int
+gbinder_servicemanager_aidl4_register_clients_callback(
+    GBinderServiceManager* manager,
+    const char* name,
+    GBinderLocalObject* obj,
+    GBinderLocalObject* cb,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderClient* client = manager->client;
+    GBinderLocalRequest* req = gbinder_client_new_request(client);
+
+    /*
+     * void registerClientCallback(@utf8InCpp String name, IBinder service,
+     *     IClientCallback callback)
+     */
+    gbinder_local_request_append_string16(req, name);
+    gbinder_local_request_append_local_object(req, obj);
+    gbinder_local_request_append_int32(req, BINDER_STABILITY_SYSTEM);
+    gbinder_local_request_append_local_object(req, cb);
+    gbinder_local_request_append_int32(req, BINDER_STABILITY_SYSTEM);
+    return gbinder_servicemanager_aidl4_exception(client,
+        REGISTER_CLIENT_CALLBACK_TRANSACTION, req, api);
+}
+
+static
+int
+gbinder_servicemanager_aidl4_try_unregister(
+    GBinderServiceManager* manager,
+    const char* name,
+    GBinderLocalObject* obj,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderClient* client = manager->client;
+    GBinderLocalRequest* req = gbinder_client_new_request(client);
+    int status;
+
+    /* void tryUnregisterService(@utf8InCpp String name, IBinder service) */
+    gbinder_local_request_append_string16(req, name);
+    gbinder_local_request_append_local_object(req, obj);
+    gbinder_local_request_append_int32(req, BINDER_STABILITY_SYSTEM);
+    status = gbinder_servicemanager_aidl4_exception(client,
+        TRY_UNREGISTER_SERVICE_TRANSACTION, req, api);
+    if (status != GBINDER_STATUS_OK) {
+        /* Most likely, it still has clients */
+        GDEBUG("Failed to unregister %s (%d)", name, status);
+    }
+    return status;
+}
+
 static
 void
 gbinder_servicemanager_aidl4_init(
@@ -96,8 +215,15 @@ gbinder_servicemanager_aidl4_class_init(
 {
     GBinderServiceManagerClass* manager = GBINDER_SERVICEMANAGER_CLASS(cls);
     cls->add_service_req = gbinder_servicemanager_aidl4_add_service_req;
+    cls->notification_req = gbinder_servicemanager_aidl4_notification_req;
     manager->list = gbinder_servicemanager_aidl3_list;
     manager->get_service = gbinder_servicemanager_aidl3_get_service;
+    manager->clients_callback_iface =
+        SERVICEMANAGER_AIDL4_CLIENT_CALLBACK_IFACE;
+    manager->read_clients = gbinder_servicemanager_aidl4_read_clients;
+    manager->register_clients_callback =
+        gbinder_servicemanager_aidl4_register_clients_callback;
+    manager->try_unregister = gbinder_servicemanager_aidl4_try_unregister;
 }
 
 /*
@@ -174,6 +174,48 @@ gbinder_servicemanager_hidl_list(
     return NULL;
 }
 
+static
+char**
+gbinder_servicemanager_hidl_list_by_interface(
+    GBinderServiceManager* self,
+    const char* fqname,
+    const GBinderIpcSyncApi* api)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request(self->client);
+    GBinderRemoteReply* reply;
+
+    /* listByInterface(string fqName) generates (vec<string> instanceNames) */
+    gbinder_local_request_append_hidl_string(req, fqname);
+    reply = gbinder_client_transact_sync_reply2(self->client,
+        LIST_BY_INTERFACE_TRANSACTION, req, NULL, api);
+    gbinder_local_request_unref(req);
+    if (reply) {
+        GBinderReader reader;
+        char** result = NULL;
+        int status = -1;
+
+        gbinder_remote_reply_init_reader(reply, &reader);
+        if (gbinder_reader_read_int32(&reader, &status) &&
+            status == GBINDER_STATUS_OK) {
+            /* Turn instance names into fully qualified ones */
+            result = gbinder_reader_read_hidl_string_vec(&reader);
+            if (result) {
+                char** ptr;
+
+                for (ptr = result; *ptr; ptr++) {
+                    char* instance = *ptr;
+
+                    *ptr = g_strconcat(fqname, "/", instance, NULL);
+                    g_free(instance);
+                }
+            }
+        }
+        gbinder_remote_reply_unref(reply);
+        return result;
+    }
+    return NULL;
+}
+
 static
 GBinderRemoteObject*
 gbinder_servicemanager_hidl_get_service(
@@ -375,6 +417,7 @@ gbinder_servicemanager_hidl_class_init(
     klass->default_device = GBINDER_DEFAULT_HWBINDER;
 
     klass->list = gbinder_servicemanager_hidl_list;
+    klass->list_by_interface = gbinder_servicemanager_hidl_list_by_interface;
     klass->get_service = gbinder_servicemanager_hidl_get_service;
     klass->add_service = gbinder_servicemanager_hidl_add_service;
     klass->check_name = gbinder_servicemanager_hidl_check_name;
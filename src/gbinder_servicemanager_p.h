@@ -64,6 +64,9 @@ typedef struct gbinder_servicemanager_class {
 
     /* Methods (synchronous) */
     char** (*list)(GBinderServiceManager* self, const GBinderIpcSyncApi* api);
+    /* Optional, the full list gets filtered if NULL */
+    char** (*list_by_interface)(GBinderServiceManager* self,
+        const char* iface, const GBinderIpcSyncApi* api);
     GBinderRemoteObject* (*get_service)(GBinderServiceManager* self,
         const char* name, int* status, const GBinderIpcSyncApi* api);
     int (*add_service)(GBinderServiceManager* self, const char* name,
@@ -77,6 +80,16 @@ typedef struct gbinder_servicemanager_class {
     /* If watch() returns FALSE, unwatch() is not called */
     gboolean (*watch)(GBinderServiceManager* self, const char* name);
     void (*unwatch)(GBinderServiceManager* self, const char* name);
+
+    /* Optional, lazy services (NULL iface if not supported) */
+    const char* clients_callback_iface;
+    gboolean (*read_clients)(GBinderServiceManager* self,
+        GBinderRemoteRequest* req, guint code, gboolean* has_clients);
+    int (*register_clients_callback)(GBinderServiceManager* self,
+        const char* name, GBinderLocalObject* obj, GBinderLocalObject* cb,
+        const GBinderIpcSyncApi* api);
+    int (*try_unregister)(GBinderServiceManager* self, const char* name,
+        GBinderLocalObject* obj, const GBinderIpcSyncApi* api);
 } GBinderServiceManagerClass;
 
 GType gbinder_servicemanager_get_type(void) GBINDER_INTERNAL;
@@ -94,6 +107,72 @@ gbinder_servicemanager_new_with_type(
     const char* rpc_protocol)
     GBINDER_INTERNAL;
 
+/* Asynchronously checks which of the given names are registered */
+gulong
+gbinder_servicemanager_list_present(
+    GBinderServiceManager* sm,
+    const GStrV* names,
+    GBinderServiceManagerListFunc func,
+    void* user_data)
+    GBINDER_INTERNAL;
+
+/* Status array has one entry per name */
+typedef
+void
+(*GBinderServiceManagerAddServicesFunc)(
+    GBinderServiceManager* sm,
+    const int* status,
+    void* user_data);
+
+/* Adds the names one after another with a single asynchronous call */
+gulong
+gbinder_servicemanager_add_services(
+    GBinderServiceManager* sm,
+    const GStrV* names,
+    GBinderLocalObject* const* objects,
+    GBinderServiceManagerAddServicesFunc func,
+    void* user_data)
+    GBINDER_INTERNAL;
+
+/*
+ * Lazy services. The callback object receives the notifications about
+ * the service gaining and losing its clients, which are decoded with
+ * gbinder_servicemanager_read_clients(). NULL is returned if the service
+ * manager doesn't support that.
+ */
+GBinderLocalObject*
+gbinder_servicemanager_new_clients_callback(
+    GBinderServiceManager* sm,
+    GBinderLocalTransactFunc handler,
+    void* user_data)
+    GBINDER_INTERNAL;
+
+gboolean
+gbinder_servicemanager_read_clients(
+    GBinderServiceManager* sm,
+    GBinderRemoteRequest* req,
+    guint code,
+    gboolean* has_clients)
+    GBINDER_INTERNAL;
+
+gulong
+gbinder_servicemanager_register_clients_callback(
+    GBinderServiceManager* sm,
+    const char* name,
+    GBinderLocalObject* obj,
+    GBinderLocalObject* cb,
+    GBinderServiceManagerAddServiceFunc func,
+    void* user_data)
+    GBINDER_INTERNAL;
+
+/* Synchronous, fails if the service still has clients */
+int
+gbinder_servicemanager_try_unregister(
+    GBinderServiceManager* sm,
+    const char* name,
+    GBinderLocalObject* obj)
+    GBINDER_INTERNAL;
+
 void
 gbinder_servicemanager_service_registered(
     GBinderServiceManager* self,
@@ -33,7 +33,7 @@
 #include "gbinder_types_p.h"
 #include "gbinder_eventloop_p.h"
 #include "gbinder_servicename.h"
-#include "gbinder_servicemanager.h"
+#include "gbinder_servicemanager_p.h"
 #include "gbinder_local_object.h"
 #include "gbinder_log.h"
 
@@ -41,7 +41,18 @@
 
 /* Since 1.0.26 */
 
+/*
+ * All names registered with the same service manager are (re)added
+ * together, by a single asynchronous call which issues the requests one
+ * after another. If any of them fails, the failed ones are retried after
+ * a delay which doubles with each unsuccessful attempt (up to the max)
+ * and is randomized by up to a half, so that processes which lost their
+ * registrations at the same time don't come back at the same time.
+ */
 #define GBINDER_SERVICENAME_RETRY_INTERVAL_MS (500)
+#define GBINDER_SERVICENAME_MAX_RETRY_INTERVAL_MS (16000)
+
+typedef struct gbinder_servicename_group GBinderServiceNameGroup;
 
 typedef struct gbinder_servicename_priv {
     GBinderServiceName pub;
@@ -49,15 +60,33 @@ typedef struct gbinder_servicename_priv {
     char* name;
     GBinderLocalObject* object;
     GBinderServiceManager* sm;
+    GBinderServiceNameGroup* group;
+    gboolean pending; /* Needs to be (re)added */
+    gboolean registered;
+    gboolean unregistered; /* Lazy service which is gone for good */
+    GBinderLocalObject* clients_cb;
+    GBinderServiceNameClientsFunc clients_func;
+    void* clients_data;
+    gulong clients_call_id;
+} GBinderServiceNamePriv;
+
+struct gbinder_servicename_group {
+    GBinderServiceManager* sm; /* Not a reference, the names hold those */
+    GSList* names;
+    GPtrArray* batch; /* Names being added, NULL if they are gone */
     GBinderEventLoopTimeout* retry_timer;
+    guint retry_interval;
     gulong presence_id;
     gulong add_call_id;
-} GBinderServiceNamePriv;
+};
+
+/* All access happens on the main thread */
+static GHashTable* gbinder_servicename_groups = NULL;
 
 static
 void
-gbinder_servicename_add_service(
-    GBinderServiceNamePriv* priv);
+gbinder_servicename_group_start(
+    GBinderServiceNameGroup* group);
 
 GBINDER_INLINE_FUNC GBinderServiceNamePriv*
 gbinder_servicename_cast(GBinderServiceName* pub)
@@ -67,49 +96,213 @@ gbinder_servicename_cast(GBinderServiceName* pub)
  * Implementation
  *==========================================================================*/
 
+static
+void
+gbinder_servicename_clients_cancel(
+    GBinderServiceNamePriv* priv)
+{
+    if (priv->clients_call_id) {
+        gbinder_servicemanager_cancel(priv->sm, priv->clients_call_id);
+        priv->clients_call_id = 0;
+    }
+}
+
+static
+void
+gbinder_servicename_clients_registered(
+    GBinderServiceManager* sm,
+    int status,
+    void* user_data)
+{
+    GBinderServiceNamePriv* priv = user_data;
+
+    GASSERT(priv->clients_call_id);
+    priv->clients_call_id = 0;
+    if (status) {
+        GWARN("Error %d registering client callback for \"%s\"", status,
+            priv->name);
+    }
+}
+
+static
+void
+gbinder_servicename_clients_register(
+    GBinderServiceNamePriv* priv)
+{
+    /* The service manager forgets the callback when the name is re-added */
+    if (priv->clients_cb && priv->registered) {
+        gbinder_servicename_clients_cancel(priv);
+        priv->clients_call_id =
+            gbinder_servicemanager_register_clients_callback(priv->sm,
+                priv->name, priv->object, priv->clients_cb,
+                gbinder_servicename_clients_registered, priv);
+    }
+}
+
+static
+GBinderLocalReply*
+gbinder_servicename_clients_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    GBinderServiceNamePriv* priv = user_data;
+    gboolean has_clients = FALSE;
+
+    if (gbinder_servicemanager_read_clients(priv->sm, req, code,
+        &has_clients)) {
+        GDEBUG("Service \"%s\" has %s clients", priv->name,
+            has_clients ? "some" : "no");
+        *status = GBINDER_STATUS_OK;
+        if (priv->clients_func && !priv->unregistered) {
+            /* This may drop the last reference to the name */
+            priv->clients_func(&priv->pub, has_clients, priv->clients_data);
+        }
+    } else {
+        *status = GBINDER_STATUS_FAILED;
+    }
+    return NULL;
+}
+
 static
 gboolean
-gbinder_servicename_add_service_retry(
+gbinder_servicename_group_retry(
     gpointer user_data)
 {
-    GBinderServiceNamePriv* priv = user_data;
+    GBinderServiceNameGroup* group = user_data;
 
-    priv->retry_timer = NULL;
-    gbinder_servicename_add_service(priv);
+    group->retry_timer = NULL;
+    gbinder_servicename_group_start(group);
     return G_SOURCE_REMOVE;
 }
 
 static
 void
-gbinder_servicename_add_service_done(
+gbinder_servicename_group_schedule_retry(
+    GBinderServiceNameGroup* group)
+{
+    const guint interval = group->retry_interval;
+
+    group->retry_interval = MIN(2 * interval,
+        GBINDER_SERVICENAME_MAX_RETRY_INTERVAL_MS);
+    gbinder_timeout_remove(group->retry_timer);
+    group->retry_timer = gbinder_timeout_add_slack(interval +
+        g_random_int_range(0, interval / 2 + 1),
+        gbinder_servicename_group_retry, group);
+}
+
+static
+void
+gbinder_servicename_group_done(
     GBinderServiceManager* sm,
-    int status,
+    const int* status,
     void* user_data)
 {
-    GBinderServiceNamePriv* priv = user_data;
+    GBinderServiceNameGroup* group = user_data;
+    GPtrArray* batch = group->batch;
+    gboolean failed = FALSE;
+    guint i;
 
-    GASSERT(priv->add_call_id);
-    priv->add_call_id = 0;
-    if (status) {
-        GWARN("Error %d adding name \"%s\"", status, priv->name);
-        gbinder_timeout_remove(priv->retry_timer);
-        priv->retry_timer =
-            gbinder_timeout_add(GBINDER_SERVICENAME_RETRY_INTERVAL_MS,
-                gbinder_servicename_add_service_retry, priv);
+    GASSERT(group->add_call_id);
+    group->add_call_id = 0;
+    group->batch = NULL;
+    for (i = 0; i < batch->len; i++) {
+        GBinderServiceNamePriv* priv = batch->pdata[i];
+
+        if (!priv) {
+            /* This one is gone */
+            continue;
+        } else if (status[i]) {
+            GWARN("Error %d adding name \"%s\"", status[i], priv->name);
+            priv->pending = TRUE;
+            failed = TRUE;
+        } else {
+            GDEBUG("Service \"%s\" has been registered", priv->name);
+            priv->registered = TRUE;
+            gbinder_servicename_clients_register(priv);
+        }
+    }
+    g_ptr_array_free(batch, TRUE);
+
+    if (failed) {
+        gbinder_servicename_group_schedule_retry(group);
     } else {
-        GDEBUG("Service \"%s\" has been registered", priv->name);
+        /* New names may have been added in the meantime */
+        group->retry_interval = GBINDER_SERVICENAME_RETRY_INTERVAL_MS;
+        if (!group->retry_timer) {
+            gbinder_servicename_group_start(group);
+        }
     }
 }
 
 static
 void
-gbinder_servicename_add_service(
-    GBinderServiceNamePriv* priv)
+gbinder_servicename_group_start(
+    GBinderServiceNameGroup* group)
 {
-    GDEBUG("Adding service \"%s\"", priv->name);
-    gbinder_servicemanager_cancel(priv->sm, priv->add_call_id);
-    priv->add_call_id = gbinder_servicemanager_add_service(priv->sm,
-        priv->name, priv->object, gbinder_servicename_add_service_done, priv);
+    if (!group->add_call_id && !group->retry_timer &&
+        gbinder_servicemanager_is_present(group->sm)) {
+        GPtrArray* names = g_ptr_array_new();
+        GPtrArray* objects = g_ptr_array_new();
+        GPtrArray* batch = g_ptr_array_new();
+        GSList* l;
+
+        for (l = group->names; l; l = l->next) {
+            GBinderServiceNamePriv* priv = l->data;
+
+            if (priv->pending) {
+                GDEBUG("Adding service \"%s\"", priv->name);
+                priv->pending = FALSE;
+                priv->registered = FALSE;
+                gbinder_servicename_clients_cancel(priv);
+                g_ptr_array_add(names, priv->name);
+                g_ptr_array_add(objects, priv->object);
+                g_ptr_array_add(batch, priv);
+            }
+        }
+        if (batch->len) {
+            g_ptr_array_add(names, NULL);
+            group->batch = batch;
+            group->add_call_id = gbinder_servicemanager_add_services(group->sm,
+                (const GStrV*)names->pdata, (GBinderLocalObject* const*)
+                objects->pdata, gbinder_servicename_group_done, group);
+        } else {
+            g_ptr_array_free(batch, TRUE);
+        }
+        g_ptr_array_free(names, TRUE);
+        g_ptr_array_free(objects, TRUE);
+    }
+}
+
+static
+void
+gbinder_servicename_group_stop(
+    GBinderServiceNameGroup* group)
+{
+    if (group->add_call_id) {
+        GPtrArray* batch = group->batch;
+        guint i;
+
+        /* Whatever has been sent, will have to be sent again */
+        for (i = 0; i < batch->len; i++) {
+            GBinderServiceNamePriv* priv = batch->pdata[i];
+
+            if (priv) {
+                priv->pending = TRUE;
+            }
+        }
+        gbinder_servicemanager_cancel(group->sm, group->add_call_id);
+        g_ptr_array_free(batch, TRUE);
+        group->batch = NULL;
+        group->add_call_id = 0;
+    }
+    if (group->retry_timer) {
+        gbinder_timeout_remove(group->retry_timer);
+        group->retry_timer = NULL;
+    }
 }
 
 static
@@ -118,19 +311,77 @@ gbinder_servicename_presence_handler(
     GBinderServiceManager* sm,
     void* user_data)
 {
-    GBinderServiceNamePriv* priv = user_data;
+    GBinderServiceNameGroup* group = user_data;
 
+    gbinder_servicename_group_stop(group);
     if (gbinder_servicemanager_is_present(sm)) {
-        gbinder_servicename_add_service(priv);
+        GSList* l;
+
+        /* Service manager has restarted, everything has to be re-added */
+        for (l = group->names; l; l = l->next) {
+            GBinderServiceNamePriv* priv = l->data;
+
+            priv->pending = !priv->unregistered;
+        }
+        group->retry_interval = GBINDER_SERVICENAME_RETRY_INTERVAL_MS;
+        gbinder_servicename_group_start(group);
+    }
+}
+
+static
+void
+gbinder_servicename_group_add(
+    GBinderServiceNamePriv* priv)
+{
+    GBinderServiceManager* sm = priv->sm;
+    GBinderServiceNameGroup* group = NULL;
+
+    if (gbinder_servicename_groups) {
+        group = g_hash_table_lookup(gbinder_servicename_groups, sm);
     } else {
-        if (priv->add_call_id) {
-            gbinder_servicemanager_cancel(priv->sm, priv->add_call_id);
-            priv->add_call_id = 0;
+        gbinder_servicename_groups = g_hash_table_new(g_direct_hash,
+            g_direct_equal);
+    }
+    if (!group) {
+        group = g_slice_new0(GBinderServiceNameGroup);
+        group->sm = sm;
+        group->retry_interval = GBINDER_SERVICENAME_RETRY_INTERVAL_MS;
+        group->presence_id = gbinder_servicemanager_add_presence_handler(sm,
+            gbinder_servicename_presence_handler, group);
+        g_hash_table_insert(gbinder_servicename_groups, sm, group);
+    }
+    priv->group = group;
+    priv->pending = TRUE;
+    group->names = g_slist_append(group->names, priv);
+    gbinder_servicename_group_start(group);
+}
+
+static
+void
+gbinder_servicename_group_remove(
+    GBinderServiceNamePriv* priv)
+{
+    GBinderServiceNameGroup* group = priv->group;
+
+    group->names = g_slist_remove(group->names, priv);
+    if (group->batch) {
+        guint i;
+
+        for (i = 0; i < group->batch->len; i++) {
+            if (group->batch->pdata[i] == priv) {
+                group->batch->pdata[i] = NULL;
+            }
         }
-        if (priv->retry_timer) {
-            gbinder_timeout_remove(priv->retry_timer);
-            priv->retry_timer = NULL;
+    }
+    if (!group->names) {
+        gbinder_servicename_group_stop(group);
+        gbinder_servicemanager_remove_handler(group->sm, group->presence_id);
+        g_hash_table_remove(gbinder_servicename_groups, group->sm);
+        if (!g_hash_table_size(gbinder_servicename_groups)) {
+            g_hash_table_destroy(gbinder_servicename_groups);
+            gbinder_servicename_groups = NULL;
         }
+        g_slice_free(GBinderServiceNameGroup, group);
     }
 }
 
@@ -152,11 +403,7 @@ gbinder_servicename_new(
         priv->object = gbinder_local_object_ref(object);
         priv->sm = gbinder_servicemanager_ref(sm);
         self->name = priv->name = g_strdup(name);
-        priv->presence_id = gbinder_servicemanager_add_presence_handler(sm,
-            gbinder_servicename_presence_handler, priv);
-        if (gbinder_servicemanager_is_present(sm)) {
-            gbinder_servicename_add_service(priv);
-        }
+        gbinder_servicename_group_add(priv);
         return self;
     } else {
         return NULL;
@@ -185,17 +432,69 @@ gbinder_servicename_unref(
 
         GASSERT(priv->refcount > 0);
         if (g_atomic_int_dec_and_test(&priv->refcount)) {
-            gbinder_servicemanager_cancel(priv->sm, priv->add_call_id);
-            gbinder_servicemanager_remove_handler(priv->sm, priv->presence_id);
+            gbinder_servicename_group_remove(priv);
+            gbinder_servicename_clients_cancel(priv);
+            gbinder_local_object_drop(priv->clients_cb);
             gbinder_servicemanager_unref(priv->sm);
             gbinder_local_object_unref(priv->object);
-            gbinder_timeout_remove(priv->retry_timer);
             g_free(priv->name);
             gutil_slice_free(priv);
         }
     }
 }
 
+gboolean
+gbinder_servicename_set_lazy(
+    GBinderServiceName* self,
+    GBinderServiceNameClientsFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderServiceNamePriv* priv = gbinder_servicename_cast(self);
+
+        priv->clients_func = func;
+        priv->clients_data = func ? user_data : NULL;
+        if (!func) {
+            /* The service manager keeps the callback, it's just ignored */
+            return TRUE;
+        } else if (!priv->clients_cb) {
+            priv->clients_cb = gbinder_servicemanager_new_clients_callback
+                (priv->sm, gbinder_servicename_clients_handler, priv);
+            if (!priv->clients_cb) {
+                GWARN("Lazy services are not supported by %s",
+                    gbinder_servicemanager_device(priv->sm));
+                priv->clients_func = NULL;
+                priv->clients_data = NULL;
+                return FALSE;
+            }
+            gbinder_servicename_clients_register(priv);
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean
+gbinder_servicename_try_unregister(
+    GBinderServiceName* self) /* Since 1.1.25 */
+{
+    if (G_LIKELY(self)) {
+        GBinderServiceNamePriv* priv = gbinder_servicename_cast(self);
+
+        if (priv->unregistered) {
+            return TRUE;
+        } else if (priv->registered && !gbinder_servicemanager_try_unregister
+            (priv->sm, priv->name, priv->object)) {
+            GDEBUG("Service \"%s\" has been unregistered", priv->name);
+            gbinder_servicename_clients_cancel(priv);
+            priv->registered = FALSE;
+            priv->unregistered = TRUE;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
 /*
  * Local Variables:
  * mode: C
@@ -31,22 +31,36 @@
  */
 
 #include "gbinder_servicepoll.h"
-#include "gbinder_servicemanager.h"
+#include "gbinder_config.h"
+#include "gbinder_servicemanager_p.h"
 #include "gbinder_eventloop_p.h"
 
 #include <gutil_strv.h>
 
 #include <glib-object.h>
 
+#include <string.h>
+
 /* This is configurable mostly so that unit testing doesn't take too long */
 guint gbinder_servicepoll_interval_ms = 2000;
 
+/*
+ * While the list stays the same, the interval keeps doubling until it
+ * reaches GBINDER_SERVICEPOLL_MAX_BACKOFF times the base interval. Any
+ * change resets it back to gbinder_servicepoll_interval_ms.
+ */
+#define GBINDER_SERVICEPOLL_MAX_BACKOFF (8)
+
 typedef GObjectClass GBinderServicePollClass;
 struct gbinder_servicepoll {
     GObject object;
     GBinderServiceManager* manager;
+    char* dev;
     char** list;
+    GHashTable* watched; /* name => count, NULL unless ServicePollWatchedOnly */
     gulong list_id;
+    guint base_interval;
+    guint interval;
     GBinderEventLoopTimeout* timer;
 };
 
@@ -59,17 +73,55 @@ G_DEFINE_TYPE(GBinderServicePoll, gbinder_servicepoll, G_TYPE_OBJECT)
 
 enum gbinder_servicepoll_signal {
     SIGNAL_NAME_ADDED,
+    SIGNAL_NAME_REMOVED,
     SIGNAL_COUNT
 };
 
 static const char SIGNAL_NAME_ADDED_NAME[] = "servicepoll-name-added";
+static const char SIGNAL_NAME_REMOVED_NAME[] = "servicepoll-name-removed";
 
 static guint gbinder_servicepoll_signals[SIGNAL_COUNT] = { 0 };
 
+/* One poll per device, shared by all service managers in the process */
+static GHashTable* gbinder_servicepoll_table = NULL;
+
 /*==========================================================================*
  * Implementation
  *==========================================================================*/
 
+static
+gboolean
+gbinder_servicepoll_timer(
+    gpointer user_data);
+
+static
+void
+gbinder_servicepoll_schedule(
+    GBinderServicePoll* self,
+    gboolean changed)
+{
+    const guint max = self->base_interval * GBINDER_SERVICEPOLL_MAX_BACKOFF;
+
+    if (changed || !self->interval) {
+        self->interval = self->base_interval;
+    } else if (self->interval < max) {
+        self->interval = MIN(2 * self->interval, max);
+    }
+    gbinder_timeout_remove(self->timer);
+    self->timer = gbinder_timeout_add_slack(self->interval,
+        gbinder_servicepoll_timer, self);
+}
+
+static
+void
+gbinder_servicepoll_emit(
+    GBinderServicePoll* self,
+    int signal,
+    const char* name)
+{
+    g_signal_emit(self, gbinder_servicepoll_signals[signal], 0, name);
+}
+
 /* GBinderServiceManagerListFunc callback returns TRUE to keep the services
  * list, otherwise the caller will deallocate it. */
 gboolean
@@ -79,46 +131,80 @@ gbinder_servicepoll_list(
     void* user_data)
 {
     GBinderServicePoll* self = THIS(user_data);
+    gboolean changed = FALSE;
 
     gbinder_servicepoll_ref(self);
     self->list_id = 0;
     if (services) {
-        const GStrV* ptr_new;
-
-        ptr_new = services = gutil_strv_sort(services, TRUE);
-        if (self->list) {
-            const GStrV* ptr_old = self->list;
+        const GStrV* ptr_new = services = gutil_strv_sort(services, TRUE);
+        const GStrV* ptr_old = self->list;
 
+        /* Both lists are sorted, walk them side by side */
+        if (ptr_old) {
             while (*ptr_new && *ptr_old) {
-                const int i = gutil_strv_find(ptr_old, *ptr_new);
-
-                if (i < 0) {
-                    /* New name */
-                    g_signal_emit(self, gbinder_servicepoll_signals
-                        [SIGNAL_NAME_ADDED], 0, *ptr_new);
+                const int diff = strcmp(*ptr_new, *ptr_old);
+
+                if (diff < 0) {
+                    changed = TRUE;
+                    gbinder_servicepoll_emit(self, SIGNAL_NAME_ADDED,
+                        *ptr_new++);
+                } else if (diff > 0) {
+                    changed = TRUE;
+                    gbinder_servicepoll_emit(self, SIGNAL_NAME_REMOVED,
+                        *ptr_old++);
                 } else {
-                    int k;
-
-                    /* If some names have disappeared, then i may be > 0 */
-                    for (k = 0; k < i; k ++) ptr_old++;
+                    ptr_new++;
                     ptr_old++;
                 }
-                ptr_new++;
+            }
+            while (*ptr_old) {
+                changed = TRUE;
+                gbinder_servicepoll_emit(self, SIGNAL_NAME_REMOVED,
+                    *ptr_old++);
             }
         }
         while (*ptr_new) {
-            g_signal_emit(self, gbinder_servicepoll_signals
-                [SIGNAL_NAME_ADDED], 0, *ptr_new);
-            ptr_new++;
+            changed = TRUE;
+            gbinder_servicepoll_emit(self, SIGNAL_NAME_ADDED, *ptr_new++);
         }
+        g_strfreev(self->list);
+        self->list = services;
     }
 
-    g_strfreev(self->list);
-    self->list = services;
+    /* Next round */
+    gbinder_servicepoll_schedule(self, changed);
     gbinder_servicepoll_unref(self);
     return TRUE;
 }
 
+/*
+ * In ServicePollWatchedOnly mode, only the watched names are checked
+ * (with one checkService call per name) instead of fetching the whole
+ * list (one call per each registered name with older service managers).
+ */
+static
+void
+gbinder_servicepoll_start(
+    GBinderServicePoll* self)
+{
+    if (!self->list_id) {
+        if (!self->watched) {
+            self->list_id = gbinder_servicemanager_list(self->manager,
+                gbinder_servicepoll_list, self);
+        } else if (g_hash_table_size(self->watched)) {
+            char** names = (char**)g_hash_table_get_keys_as_array
+                (self->watched, NULL);
+
+            self->list_id = gbinder_servicemanager_list_present(self->manager,
+                (const GStrV*)names, gbinder_servicepoll_list, self);
+            g_free(names);
+        }
+        if (!self->list_id) {
+            gbinder_servicepoll_schedule(self, FALSE);
+        }
+    }
+}
+
 static
 gboolean
 gbinder_servicepoll_timer(
@@ -126,11 +212,9 @@ gbinder_servicepoll_timer(
 {
     GBinderServicePoll* self = THIS(user_data);
 
-    if (!self->list_id) {
-        self->list_id = gbinder_servicemanager_list(self->manager,
-            gbinder_servicepoll_list, self);
-    }
-    return G_SOURCE_CONTINUE;
+    self->timer = NULL;
+    gbinder_servicepoll_start(self);
+    return G_SOURCE_REMOVE;
 }
 
 static
@@ -141,8 +225,20 @@ gbinder_servicepoll_create(
     GBinderServicePoll* self = g_object_new(THIS_TYPE, NULL);
 
     self->manager = gbinder_servicemanager_ref(manager);
-    self->list_id = gbinder_servicemanager_list(manager,
-        gbinder_servicepoll_list, self);
+    self->dev = g_strdup(manager->dev);
+    self->base_interval = MAX(gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_SERVICE_POLL_INTERVAL, self->dev,
+            gbinder_servicepoll_interval_ms), 1);
+    if (!gbinder_servicepoll_table) {
+        gbinder_servicepoll_table = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    if (gbinder_config_get_device_int
+        (GBINDER_CONFIG_GROUP_SERVICE_POLL_WATCHED_ONLY, self->dev, 0) > 0) {
+        self->watched = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    }
+    g_hash_table_insert(gbinder_servicepoll_table, self->dev, self);
+    gbinder_servicepoll_start(self);
     return self;
 }
 
@@ -155,17 +251,24 @@ gbinder_servicepoll_new(
     GBinderServiceManager* manager,
     GBinderServicePoll** weakptr)
 {
-    if (weakptr) {
-        if (*weakptr) {
-            gbinder_servicepoll_ref(*weakptr);
-        } else {
-            *weakptr = gbinder_servicepoll_create(manager);
-            g_object_add_weak_pointer(G_OBJECT(*weakptr), (gpointer*)weakptr);
-        }
-        return *weakptr;
+    GBinderServicePoll* self;
+
+    if (weakptr && *weakptr) {
+        return gbinder_servicepoll_ref(*weakptr);
+    }
+
+    self = gbinder_servicepoll_table ?
+        g_hash_table_lookup(gbinder_servicepoll_table, manager->dev) : NULL;
+    if (self) {
+        gbinder_servicepoll_ref(self);
     } else {
-        return gbinder_servicepoll_create(manager);
+        self = gbinder_servicepoll_create(manager);
+    }
+    if (weakptr) {
+        *weakptr = self;
+        g_object_add_weak_pointer(G_OBJECT(self), (gpointer*)weakptr);
     }
+    return self;
 }
 
 GBinderServicePoll*
@@ -204,6 +307,60 @@ gbinder_servicepoll_is_known_name(
     return G_LIKELY(self) && gutil_strv_contains(self->list, name);
 }
 
+/*
+ * Tells the poll which names someone is interested in. Only matters in
+ * ServicePollWatchedOnly mode, where nothing else gets polled.
+ */
+void
+gbinder_servicepoll_watch_name(
+    GBinderServicePoll* self,
+    const char* name)
+{
+    if (G_LIKELY(self) && self->watched && G_LIKELY(name)) {
+        const guint count = GPOINTER_TO_UINT(g_hash_table_lookup
+            (self->watched, name));
+
+        if (count) {
+            g_hash_table_insert(self->watched, g_strdup(name),
+                GUINT_TO_POINTER(count + 1));
+        } else {
+            g_hash_table_insert(self->watched, g_strdup(name),
+                GUINT_TO_POINTER(1));
+            /* Check the new name sooner rather than later */
+            if (!self->list_id) {
+                gbinder_timeout_remove(self->timer);
+                self->timer = NULL;
+                self->interval = 0;
+                gbinder_servicepoll_start(self);
+            }
+        }
+    }
+}
+
+void
+gbinder_servicepoll_unwatch_name(
+    GBinderServicePoll* self,
+    const char* name)
+{
+    if (G_LIKELY(self) && self->watched && G_LIKELY(name)) {
+        const guint count = GPOINTER_TO_UINT(g_hash_table_lookup
+            (self->watched, name));
+
+        if (count > 1) {
+            g_hash_table_insert(self->watched, g_strdup(name),
+                GUINT_TO_POINTER(count - 1));
+        } else if (count) {
+            const int pos = gutil_strv_find(self->list, name);
+
+            g_hash_table_remove(self->watched, name);
+            /* It's not going to be polled anymore, forget it quietly */
+            if (pos >= 0) {
+                self->list = gutil_strv_remove_at(self->list, pos, TRUE);
+            }
+        }
+    }
+}
+
 gulong
 gbinder_servicepoll_add_handler(
     GBinderServicePoll* self,
@@ -214,6 +371,16 @@ gbinder_servicepoll_add_handler(
         SIGNAL_NAME_ADDED_NAME, G_CALLBACK(fn), user_data) : 0;
 }
 
+gulong
+gbinder_servicepoll_add_removal_handler(
+    GBinderServicePoll* self,
+    GBinderServicePollFunc fn,
+    void* user_data)
+{
+    return (G_LIKELY(self) && G_LIKELY(fn)) ? g_signal_connect(self,
+        SIGNAL_NAME_REMOVED_NAME, G_CALLBACK(fn), user_data) : 0;
+}
+
 void
 gbinder_servicepoll_remove_handler(
     GBinderServicePoll* self,
@@ -233,8 +400,6 @@ void
 gbinder_servicepoll_init(
     GBinderServicePoll* self)
 {
-    self->timer = gbinder_timeout_add(gbinder_servicepoll_interval_ms,
-        gbinder_servicepoll_timer, self);
 }
 
 static
@@ -244,10 +409,22 @@ gbinder_servicepoll_finalize(
 {
     GBinderServicePoll* self = THIS(object);
 
+    if (gbinder_servicepoll_table &&
+        g_hash_table_lookup(gbinder_servicepoll_table, self->dev) == self) {
+        g_hash_table_remove(gbinder_servicepoll_table, self->dev);
+        if (!g_hash_table_size(gbinder_servicepoll_table)) {
+            g_hash_table_destroy(gbinder_servicepoll_table);
+            gbinder_servicepoll_table = NULL;
+        }
+    }
     gbinder_timeout_remove(self->timer);
     gbinder_servicemanager_cancel(self->manager, self->list_id);
     gbinder_servicemanager_unref(self->manager);
+    if (self->watched) {
+        g_hash_table_destroy(self->watched);
+    }
     g_strfreev(self->list);
+    g_free(self->dev);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
 
@@ -261,6 +438,10 @@ gbinder_servicepoll_class_init(
         g_signal_new(SIGNAL_NAME_ADDED_NAME, G_OBJECT_CLASS_TYPE(klass),
             G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL, G_TYPE_NONE,
             1, G_TYPE_STRING);
+    gbinder_servicepoll_signals[SIGNAL_NAME_REMOVED] =
+        g_signal_new(SIGNAL_NAME_REMOVED_NAME, G_OBJECT_CLASS_TYPE(klass),
+            G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL, G_TYPE_NONE,
+            1, G_TYPE_STRING);
 }
 
 /*
@@ -41,7 +41,7 @@ typedef
 void
 (*GBinderServicePollFunc)(
     GBinderServicePoll* poll,
-    const char* name_added,
+    const char* name,
     void* user_data);
 
 GBinderServicePoll*
@@ -71,6 +71,18 @@ gbinder_servicepoll_is_known_name(
     const char* name)
     GBINDER_INTERNAL;
 
+void
+gbinder_servicepoll_watch_name(
+    GBinderServicePoll* poll,
+    const char* name)
+    GBINDER_INTERNAL;
+
+void
+gbinder_servicepoll_unwatch_name(
+    GBinderServicePoll* poll,
+    const char* name)
+    GBINDER_INTERNAL;
+
 gulong
 gbinder_servicepoll_add_handler(
     GBinderServicePoll* poll,
@@ -78,6 +90,13 @@ gbinder_servicepoll_add_handler(
     void* user_data)
     GBINDER_INTERNAL;
 
+gulong
+gbinder_servicepoll_add_removal_handler(
+    GBinderServicePoll* poll,
+    GBinderServicePollFunc func,
+    void* user_data)
+    GBINDER_INTERNAL;
+
 void
 gbinder_servicepoll_remove_handler(
     GBinderServicePoll* poll,
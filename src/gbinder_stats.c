@@ -0,0 +1,1009 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gbinder_stats_p.h"
+#include "gbinder_ipc.h"
+#include "gbinder_local_request_p.h"
+#include "gbinder_local_reply_p.h"
+#include "gbinder_output_data.h"
+#include "gbinder_log.h"
+
+#include <gbinder_reader.h>
+#include <gbinder_remote_reply.h>
+#include <gbinder_remote_request.h>
+
+#include <gutil_intarray.h>
+#include <gutil_macros.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+gint gbinder_stats_on = FALSE;
+
+static gint gbinder_stats_interval = 1;
+static gint gbinder_stats_sample = 0;
+
+static GMutex gbinder_stats_mutex;
+static GHashTable* gbinder_stats_table = NULL;
+
+/* Memory accounting has its own lock, it's hit more often */
+static GMutex gbinder_stats_mem_mutex;
+static GBinderStatsMemEntry gbinder_stats_mem[GBINDER_STATS_MEM_COUNT];
+
+/* And so do probes */
+static GMutex gbinder_stats_probe_mutex;
+static GBinderStatsProbeEntry gbinder_stats_probes[GBINDER_STATS_PROBE_COUNT];
+
+/* Handler profiling, the history is a ring buffer */
+gint gbinder_stats_handlers_on = FALSE;
+
+static GMutex gbinder_stats_handler_mutex;
+static GBinderStatsHandlerEntry
+    gbinder_stats_handler_history[GBINDER_STATS_HANDLER_HISTORY];
+static guint gbinder_stats_handler_count = 0; /* Total recorded */
+static guint64 gbinder_stats_slow_usec = 0;
+static GBinderStatsSlowHandlerFunc gbinder_stats_slow_fn = NULL;
+static void* gbinder_stats_slow_data = NULL;
+
+/* Cold start timings, each one is written once */
+static GMutex gbinder_stats_startup_mutex;
+static guint gbinder_stats_startup_mask = 0;
+static guint64 gbinder_stats_startup_usec[GBINDER_STATS_STARTUP_COUNT];
+
+/* Tuning decisions, another ring buffer */
+static GMutex gbinder_stats_tuning_mutex;
+static GBinderStatsTuningEntry
+    gbinder_stats_tuning_history[GBINDER_STATS_TUNING_HISTORY];
+static guint gbinder_stats_tuning_count = 0; /* Total recorded */
+
+/*
+ * Entries serve as their own keys, dev and iface pointers are interned
+ * and therefore can be compared directly.
+ */
+
+static
+guint
+gbinder_stats_entry_hash(
+    gconstpointer key)
+{
+    const GBinderStatsEntry* entry = key;
+
+    return g_direct_hash(entry->dev) ^ g_direct_hash(entry->iface) ^
+        (entry->code * 31) ^ entry->dir;
+}
+
+static
+gboolean
+gbinder_stats_entry_equal(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const GBinderStatsEntry* e1 = a;
+    const GBinderStatsEntry* e2 = b;
+
+    return e1->dev == e2->dev && e1->iface == e2->iface &&
+        e1->code == e2->code && e1->dir == e2->dir;
+}
+
+static
+guint
+gbinder_stats_histogram_bucket(
+    gint64 usec)
+{
+    /* Bucket i > 0 counts calls that took [2^(i-1), 2^i) microseconds */
+    if (usec > 0) {
+        const guint i = g_bit_storage((gulong)usec);
+
+        return MIN(i, GBINDER_STATS_HISTOGRAM_SIZE - 1);
+    } else {
+        return 0;
+    }
+}
+
+static
+gint
+gbinder_stats_compare_total(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const GBinderStatsEntry* e1 = a;
+    const GBinderStatsEntry* e2 = b;
+
+    return (e1->total_usec > e2->total_usec) ? (-1) :
+        (e1->total_usec < e2->total_usec) ? 1 :
+        (e1->calls > e2->calls) ? (-1) :
+        (e1->calls < e2->calls) ? 1 : 0;
+}
+
+static
+GBinderStatsEntry*
+gbinder_stats_snapshot(
+    guint* count)
+{
+    GBinderStatsEntry* entries = NULL;
+    guint n = 0;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_mutex);
+    if (gbinder_stats_table) {
+        n = g_hash_table_size(gbinder_stats_table);
+        if (n) {
+            GHashTableIter it;
+            gpointer value;
+            guint i = 0;
+
+            entries = g_new(GBinderStatsEntry, n);
+            g_hash_table_iter_init(&it, gbinder_stats_table);
+            while (g_hash_table_iter_next(&it, NULL, &value)) {
+                entries[i++] = *(GBinderStatsEntry*)value;
+            }
+        }
+    }
+    g_mutex_unlock(&gbinder_stats_mutex);
+    /* Unlock */
+
+    *count = n;
+    return entries;
+}
+
+static
+const char*
+gbinder_stats_dir_name(
+    GBINDER_STATS_DIR dir)
+{
+    switch (dir) {
+    case GBINDER_STATS_OUTGOING: return "out";
+    case GBINDER_STATS_INCOMING: return "in";
+    case GBINDER_STATS_FORWARDED: return "fwd";
+    }
+    return "?";
+}
+
+/*==========================================================================*
+ * Internal interface
+ *==========================================================================*/
+
+gint64
+gbinder_stats_start(
+    void)
+{
+    const guint interval = g_atomic_int_get(&gbinder_stats_interval);
+
+    if (interval > 1 &&
+        ((guint)g_atomic_int_add(&gbinder_stats_sample, 1) % interval)) {
+        return 0;
+    }
+    /* Never zero */
+    return MAX(g_get_monotonic_time(), 1);
+}
+
+void
+gbinder_stats_record(
+    const char* dev,
+    const char* iface,
+    guint32 code,
+    GBINDER_STATS_DIR dir,
+    guint32 flags,
+    int status,
+    gsize request_bytes,
+    gsize reply_bytes,
+    guint objects,
+    gint64 usec)
+{
+    /* Each sampled transaction stands for the interval */
+    const guint64 n = g_atomic_int_get(&gbinder_stats_interval);
+    GBinderStatsEntry key;
+    GBinderStatsEntry* entry;
+
+    memset(&key, 0, sizeof(key));
+    key.dev = g_intern_string(dev);
+    key.iface = g_intern_string(iface);
+    key.code = code;
+    key.dir = dir;
+    if (usec < 0) {
+        usec = 0;
+    }
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_mutex);
+    if (!gbinder_stats_table) {
+        gbinder_stats_table = g_hash_table_new_full(gbinder_stats_entry_hash,
+            gbinder_stats_entry_equal, NULL, g_free);
+    }
+    entry = g_hash_table_lookup(gbinder_stats_table, &key);
+    if (!entry) {
+        entry = gutil_memdup(&key, sizeof(key));
+        g_hash_table_add(gbinder_stats_table, entry);
+    }
+    entry->calls += n;
+    if (flags & GBINDER_TX_FLAG_ONEWAY) {
+        entry->oneway += n;
+    }
+    if (status != GBINDER_STATUS_OK) {
+        entry->errors += n;
+    }
+    entry->request_bytes += n * request_bytes;
+    entry->reply_bytes += n * reply_bytes;
+    entry->objects += n * objects;
+    entry->total_usec += n * usec;
+    if (entry->max_usec < (guint64)usec) {
+        entry->max_usec = usec;
+    }
+    entry->histogram[gbinder_stats_histogram_bucket(usec)] += n;
+    g_mutex_unlock(&gbinder_stats_mutex);
+    /* Unlock */
+}
+
+gint64
+gbinder_stats_probe_enter(
+    GBINDER_STATS_PROBE probe)
+{
+    if (gbinder_stats_active()) {
+        GBinderStatsProbeEntry* entry = gbinder_stats_probes + probe;
+
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_probe_mutex);
+        entry->depth++;
+        if (entry->max_depth < entry->depth) {
+            entry->max_depth = entry->depth;
+        }
+        g_mutex_unlock(&gbinder_stats_probe_mutex);
+        /* Unlock */
+
+        /* Never zero */
+        return MAX(g_get_monotonic_time(), 1);
+    }
+    return 0;
+}
+
+void
+gbinder_stats_probe_exit(
+    GBINDER_STATS_PROBE probe,
+    gint64 start)
+{
+    if (start) {
+        GBinderStatsProbeEntry* entry = gbinder_stats_probes + probe;
+        gint64 usec = g_get_monotonic_time() - start;
+
+        if (usec < 0) {
+            usec = 0;
+        }
+
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_probe_mutex);
+        GASSERT(entry->depth > 0);
+        entry->depth--;
+        entry->count++;
+        entry->total_usec += usec;
+        if (entry->max_usec < (guint64)usec) {
+            entry->max_usec = usec;
+        }
+        entry->histogram[gbinder_stats_histogram_bucket(usec)]++;
+        g_mutex_unlock(&gbinder_stats_probe_mutex);
+        /* Unlock */
+    }
+}
+
+void
+gbinder_stats_mem_add(
+    GBINDER_STATS_MEM type,
+    gsize bytes)
+{
+    GBinderStatsMemEntry* mem = gbinder_stats_mem + type;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_mem_mutex);
+    mem->count++;
+    mem->bytes += bytes;
+    if (mem->max_count < mem->count) {
+        mem->max_count = mem->count;
+    }
+    if (mem->max_bytes < mem->bytes) {
+        mem->max_bytes = mem->bytes;
+    }
+    g_mutex_unlock(&gbinder_stats_mem_mutex);
+    /* Unlock */
+}
+
+void
+gbinder_stats_mem_remove(
+    GBINDER_STATS_MEM type,
+    gsize bytes)
+{
+    GBinderStatsMemEntry* mem = gbinder_stats_mem + type;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_mem_mutex);
+    GASSERT(mem->count > 0);
+    GASSERT(mem->bytes >= bytes);
+    mem->count--;
+    mem->bytes -= bytes;
+    g_mutex_unlock(&gbinder_stats_mem_mutex);
+    /* Unlock */
+}
+
+void
+gbinder_stats_outgoing(
+    const char* dev,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    GBinderRemoteReply* reply,
+    int status,
+    gint64 start)
+{
+    const gint64 usec = g_get_monotonic_time() - start;
+    GBinderOutputData* out = gbinder_local_request_data(req);
+    GUtilIntArray* offsets = gbinder_output_data_offsets(out);
+    gsize reply_bytes = 0;
+
+    if (reply) {
+        GBinderReader reader;
+
+        gbinder_remote_reply_init_reader(reply, &reader);
+        reply_bytes = gbinder_reader_bytes_remaining(&reader);
+    }
+    gbinder_stats_record(dev, gbinder_local_request_iface(req), code,
+        GBINDER_STATS_OUTGOING, flags, status, out ? out->bytes->len : 0,
+        reply_bytes, offsets ? offsets->count : 0, usec);
+}
+
+static
+void
+gbinder_stats_remote_request(
+    const char* dev,
+    GBINDER_STATS_DIR dir,
+    guint32 code,
+    guint32 flags,
+    GBinderRemoteRequest* req,
+    GBinderLocalReply* reply,
+    int status,
+    gint64 start)
+{
+    const gint64 usec = g_get_monotonic_time() - start;
+    GBinderOutputData* out = gbinder_local_reply_data(reply);
+    GUtilIntArray* offsets = gbinder_output_data_offsets(out);
+    GBinderReader reader;
+
+    gbinder_remote_request_init_reader(req, &reader);
+    gbinder_stats_record(dev, gbinder_remote_request_interface(req), code,
+        dir, flags, status, gbinder_reader_bytes_remaining(&reader),
+        out ? out->bytes->len : 0, offsets ? offsets->count : 0, usec);
+}
+
+void
+gbinder_stats_incoming(
+    const char* dev,
+    guint32 code,
+    guint32 flags,
+    GBinderRemoteRequest* req,
+    GBinderLocalReply* reply,
+    int status,
+    gint64 start)
+{
+    gbinder_stats_remote_request(dev, GBINDER_STATS_INCOMING, code, flags,
+        req, reply, status, start);
+}
+
+void
+gbinder_stats_forwarded(
+    const char* dev,
+    guint32 code,
+    guint32 flags,
+    GBinderRemoteRequest* req,
+    GBinderLocalReply* reply,
+    int status,
+    gint64 start)
+{
+    gbinder_stats_remote_request(dev, GBINDER_STATS_FORWARDED, code, flags,
+        req, reply, status, start);
+}
+
+void
+gbinder_stats_tuning(
+    const char* dev,
+    GBINDER_STATS_TUNING param,
+    guint old_value,
+    guint new_value)
+{
+    GBinderStatsTuningEntry entry;
+
+    entry.dev = g_intern_string(dev);
+    entry.param = param;
+    entry.time = g_get_monotonic_time();
+    entry.old_value = old_value;
+    entry.new_value = new_value;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_tuning_mutex);
+    gbinder_stats_tuning_history[gbinder_stats_tuning_count++ %
+        GBINDER_STATS_TUNING_HISTORY] = entry;
+    g_mutex_unlock(&gbinder_stats_tuning_mutex);
+    /* Unlock */
+}
+
+void
+gbinder_stats_startup(
+    GBINDER_STATS_STARTUP phase,
+    gint64 start)
+{
+    const guint bit = (1 << phase);
+
+    /* Cheap check first, the phases get recorded once per process */
+    if (!(g_atomic_int_get(&gbinder_stats_startup_mask) & bit)) {
+        const gint64 now = g_get_monotonic_time();
+
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_startup_mutex);
+        if (!(gbinder_stats_startup_mask & bit)) {
+            gbinder_stats_startup_usec[phase] = (now > start) ?
+                (now - start) : 0;
+            g_atomic_int_or(&gbinder_stats_startup_mask, bit);
+        }
+        g_mutex_unlock(&gbinder_stats_startup_mutex);
+        /* Unlock */
+    }
+}
+
+void
+gbinder_stats_handler(
+    const char* dev,
+    const char* iface,
+    guint32 code,
+    guint32 flags,
+    guint64 trace_id,
+    gint64 start)
+{
+    const gint64 usec = g_get_monotonic_time() - start;
+    GBinderStatsSlowHandlerFunc fn = NULL;
+    GBinderStatsHandlerEntry entry;
+    void* fn_data = NULL;
+
+    entry.dev = g_intern_string(dev);
+    entry.iface = g_intern_string(iface);
+    entry.code = code;
+    entry.flags = flags;
+    entry.start = start;
+    entry.usec = MAX(usec, 0);
+    entry.trace_id = trace_id;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_handler_mutex);
+    gbinder_stats_handler_history[gbinder_stats_handler_count++ %
+        GBINDER_STATS_HANDLER_HISTORY] = entry;
+    if (gbinder_stats_slow_fn && entry.usec >= gbinder_stats_slow_usec) {
+        fn = gbinder_stats_slow_fn;
+        fn_data = gbinder_stats_slow_data;
+    }
+    g_mutex_unlock(&gbinder_stats_handler_mutex);
+    /* Unlock */
+
+    if (fn) {
+        fn(&entry, fn_data);
+    }
+}
+
+/*==========================================================================*
+ * Interface
+ *==========================================================================*/
+
+void
+gbinder_stats_set_enabled(
+    gboolean enabled) /* Since 1.1.25 */
+{
+    g_atomic_int_set(&gbinder_stats_on, enabled != FALSE);
+}
+
+gboolean
+gbinder_stats_enabled(
+    void) /* Since 1.1.25 */
+{
+    return g_atomic_int_get(&gbinder_stats_on);
+}
+
+void
+gbinder_stats_reset(
+    void) /* Since 1.1.25 */
+{
+    int i;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_mutex);
+    if (gbinder_stats_table) {
+        g_hash_table_destroy(gbinder_stats_table);
+        gbinder_stats_table = NULL;
+    }
+    g_mutex_unlock(&gbinder_stats_mutex);
+    /* Unlock */
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_probe_mutex);
+    for (i = 0; i < GBINDER_STATS_PROBE_COUNT; i++) {
+        GBinderStatsProbeEntry* entry = gbinder_stats_probes + i;
+        const guint depth = entry->depth;
+
+        /* Whatever is in progress will still exit */
+        memset(entry, 0, sizeof(*entry));
+        entry->depth = entry->max_depth = depth;
+    }
+    g_mutex_unlock(&gbinder_stats_probe_mutex);
+    /* Unlock */
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_handler_mutex);
+    gbinder_stats_handler_count = 0;
+    g_mutex_unlock(&gbinder_stats_handler_mutex);
+    /* Unlock */
+}
+
+gboolean
+gbinder_stats_get_probe(
+    GBINDER_STATS_PROBE probe,
+    GBinderStatsProbeEntry* entry) /* Since 1.1.25 */
+{
+    if ((guint)probe < GBINDER_STATS_PROBE_COUNT && G_LIKELY(entry)) {
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_probe_mutex);
+        *entry = gbinder_stats_probes[probe];
+        g_mutex_unlock(&gbinder_stats_probe_mutex);
+        /* Unlock */
+        return TRUE;
+    }
+    return FALSE;
+}
+
+guint
+gbinder_stats_foreach(
+    GBinderStatsFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    guint n = 0;
+
+    if (G_LIKELY(func)) {
+        /* Callback is invoked without holding the lock */
+        GBinderStatsEntry* entries = gbinder_stats_snapshot(&n);
+        guint i;
+
+        for (i = 0; i < n; i++) {
+            func(entries + i, user_data);
+        }
+        g_free(entries);
+    }
+    return n;
+}
+
+gboolean
+gbinder_stats_get_memory(
+    GBINDER_STATS_MEM type,
+    GBinderStatsMemEntry* entry) /* Since 1.1.25 */
+{
+    if ((guint)type < GBINDER_STATS_MEM_COUNT && G_LIKELY(entry)) {
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_mem_mutex);
+        *entry = gbinder_stats_mem[type];
+        g_mutex_unlock(&gbinder_stats_mem_mutex);
+        /* Unlock */
+        return TRUE;
+    }
+    return FALSE;
+}
+
+void
+gbinder_stats_reset_memory_peaks(
+    void) /* Since 1.1.25 */
+{
+    int i;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_mem_mutex);
+    for (i = 0; i < GBINDER_STATS_MEM_COUNT; i++) {
+        GBinderStatsMemEntry* mem = gbinder_stats_mem + i;
+
+        mem->max_count = mem->count;
+        mem->max_bytes = mem->bytes;
+    }
+    g_mutex_unlock(&gbinder_stats_mem_mutex);
+    /* Unlock */
+}
+
+char*
+gbinder_stats_dump(
+    void) /* Since 1.1.25 */
+{
+    guint i, n;
+    GBinderStatsEntry* entries = gbinder_stats_snapshot(&n);
+    GString* buf = g_string_new(NULL);
+
+    if (n) {
+        qsort(entries, n, sizeof(entries[0]), gbinder_stats_compare_total);
+    }
+    for (i = 0; i < n; i++) {
+        const GBinderStatsEntry* e = entries + i;
+        int last = GBINDER_STATS_HISTOGRAM_SIZE - 1;
+        int k;
+
+        g_string_append_printf(buf, "%s %s %s %u calls=%" G_GUINT64_FORMAT
+            " oneway=%" G_GUINT64_FORMAT " errors=%" G_GUINT64_FORMAT
+            " req=%" G_GUINT64_FORMAT " reply=%" G_GUINT64_FORMAT
+            " objects=%" G_GUINT64_FORMAT " total=%" G_GUINT64_FORMAT
+            "us avg=%" G_GUINT64_FORMAT "us max=%" G_GUINT64_FORMAT "us hist=",
+            gbinder_stats_dir_name(e->dir),
+            e->dev ? e->dev : "-", e->iface ? e->iface : "-", e->code,
+            e->calls, e->oneway, e->errors, e->request_bytes, e->reply_bytes,
+            e->objects, e->total_usec, e->calls ? (e->total_usec / e->calls) :
+            0, e->max_usec);
+        while (last > 0 && !e->histogram[last]) last--;
+        for (k = 0; k <= last; k++) {
+            g_string_append_printf(buf, k ? ",%" G_GUINT64_FORMAT :
+                "%" G_GUINT64_FORMAT, e->histogram[k]);
+        }
+        g_string_append_c(buf, '\n');
+    }
+    g_free(entries);
+    return g_string_free(buf, FALSE);
+}
+
+void
+gbinder_stats_set_sampling(
+    guint interval) /* Since 1.1.25 */
+{
+    g_atomic_int_set(&gbinder_stats_interval, MAX(interval, 1));
+}
+
+guint
+gbinder_stats_sampling(
+    void) /* Since 1.1.25 */
+{
+    return g_atomic_int_get(&gbinder_stats_interval);
+}
+
+guint64
+gbinder_stats_percentile_usec(
+    const GBinderStatsEntry* entry,
+    guint percent) /* Since 1.1.25 */
+{
+    if (G_LIKELY(entry)) {
+        guint64 total = 0, rank, sum = 0;
+        int i;
+
+        for (i = 0; i < GBINDER_STATS_HISTOGRAM_SIZE; i++) {
+            total += entry->histogram[i];
+        }
+        if (total) {
+            /* Rank of the sample at the percentile, counting from 1 */
+            rank = MAX((total * MIN(percent, 100) + 99) / 100, 1);
+            for (i = 0; i < GBINDER_STATS_HISTOGRAM_SIZE - 1; i++) {
+                sum += entry->histogram[i];
+                if (sum >= rank) {
+                    return G_GUINT64_CONSTANT(1) << i;
+                }
+            }
+            /* The last bucket is open */
+            return MAX(entry->max_usec,
+                G_GUINT64_CONSTANT(1) << (GBINDER_STATS_HISTOGRAM_SIZE - 1));
+        }
+    }
+    return 0;
+}
+
+void
+gbinder_stats_set_handler_profiling(
+    gboolean enabled) /* Since 1.1.25 */
+{
+    g_atomic_int_set(&gbinder_stats_handlers_on, enabled != FALSE);
+}
+
+gboolean
+gbinder_stats_handler_profiling(
+    void) /* Since 1.1.25 */
+{
+    return g_atomic_int_get(&gbinder_stats_handlers_on);
+}
+
+void
+gbinder_stats_set_slow_handler(
+    guint64 threshold_usec,
+    GBinderStatsSlowHandlerFunc func,
+    void* user_data) /* Since 1.1.25 */
+{
+    /* Lock */
+    g_mutex_lock(&gbinder_stats_handler_mutex);
+    gbinder_stats_slow_usec = threshold_usec;
+    gbinder_stats_slow_fn = func;
+    gbinder_stats_slow_data = user_data;
+    g_mutex_unlock(&gbinder_stats_handler_mutex);
+    /* Unlock */
+}
+
+guint
+gbinder_stats_get_handlers(
+    GBinderStatsHandlerEntry* entries,
+    guint max) /* Since 1.1.25 */
+{
+    guint n = 0;
+
+    if (entries) {
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_handler_mutex);
+        n = MIN(max, MIN(gbinder_stats_handler_count,
+            GBINDER_STATS_HANDLER_HISTORY));
+        if (n) {
+            guint i;
+
+            for (i = 0; i < n; i++) {
+                entries[i] = gbinder_stats_handler_history
+                    [(gbinder_stats_handler_count - 1 - i) %
+                    GBINDER_STATS_HANDLER_HISTORY];
+            }
+        }
+        g_mutex_unlock(&gbinder_stats_handler_mutex);
+        /* Unlock */
+    }
+    return n;
+}
+
+guint
+gbinder_stats_get_tuning(
+    GBinderStatsTuningEntry* entries,
+    guint max) /* Since 1.1.25 */
+{
+    guint n = 0;
+
+    if (entries) {
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_tuning_mutex);
+        n = MIN(max, MIN(gbinder_stats_tuning_count,
+            GBINDER_STATS_TUNING_HISTORY));
+        if (n) {
+            guint i;
+
+            for (i = 0; i < n; i++) {
+                entries[i] = gbinder_stats_tuning_history
+                    [(gbinder_stats_tuning_count - 1 - i) %
+                    GBINDER_STATS_TUNING_HISTORY];
+            }
+        }
+        g_mutex_unlock(&gbinder_stats_tuning_mutex);
+        /* Unlock */
+    }
+    return n;
+}
+
+gboolean
+gbinder_stats_get_startup(
+    GBINDER_STATS_STARTUP phase,
+    guint64* usec) /* Since 1.1.25 */
+{
+    gboolean done = FALSE;
+
+    if ((guint)phase < GBINDER_STATS_STARTUP_COUNT) {
+        /* Lock */
+        g_mutex_lock(&gbinder_stats_startup_mutex);
+        if (gbinder_stats_startup_mask & (1 << phase)) {
+            if (usec) {
+                *usec = gbinder_stats_startup_usec[phase];
+            }
+            done = TRUE;
+        }
+        g_mutex_unlock(&gbinder_stats_startup_mutex);
+        /* Unlock */
+    }
+    return done;
+}
+
+/*
+ * Per-process part of the binder driver's stats file looks like this:
+ *
+ * proc 1234
+ * context hwbinder
+ *   threads: 3
+ *   requested threads: 0+1/15
+ *   ready threads 2
+ *   free async space 520192
+ *   nodes: 3
+ *   refs: 2 s 2 w 2
+ *   buffers: 0
+ *   pages: 0:1:253
+ *   pending transactions: 0
+ *   BC_TRANSACTION: 5
+ *   BR_REPLY: 5
+ *   ...
+ *
+ * Only non-zero BC_ and BR_ counters are printed. The same process has
+ * a separate section for each binder device (context) it has opened.
+ */
+
+typedef struct gbinder_stats_kernel_counter {
+    const char* name;
+    gsize offset;
+} GBinderStatsKernelCounter;
+
+#define GBINDER_STATS_KERNEL_COUNTER(name,field) \
+    { name, G_STRUCT_OFFSET(GBinderStatsKernel, field) }
+
+static const GBinderStatsKernelCounter gbinder_stats_kernel_counters[] = {
+    GBINDER_STATS_KERNEL_COUNTER("BC_TRANSACTION", transactions),
+    GBINDER_STATS_KERNEL_COUNTER("BC_TRANSACTION_SG", transactions),
+    GBINDER_STATS_KERNEL_COUNTER("BC_REPLY", replies),
+    GBINDER_STATS_KERNEL_COUNTER("BC_REPLY_SG", replies),
+    GBINDER_STATS_KERNEL_COUNTER("BR_TRANSACTION", incoming),
+    GBINDER_STATS_KERNEL_COUNTER("BR_TRANSACTION_SEC_CTX", incoming),
+    GBINDER_STATS_KERNEL_COUNTER("BR_FAILED_REPLY", failed_replies),
+    GBINDER_STATS_KERNEL_COUNTER("BR_DEAD_REPLY", dead_replies),
+    GBINDER_STATS_KERNEL_COUNTER("BR_FROZEN_REPLY", frozen_replies),
+    GBINDER_STATS_KERNEL_COUNTER("BR_ONEWAY_SPAM_SUSPECT", spam_suspects)
+};
+
+static
+void
+gbinder_stats_parse_kernel_counter(
+    const char* line,
+    GBinderStatsKernel* stats)
+{
+    long long value = 0;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(gbinder_stats_kernel_counters); i++) {
+        const GBinderStatsKernelCounter* c = gbinder_stats_kernel_counters + i;
+        const gsize len = strlen(c->name);
+
+        if (!strncmp(line, c->name, len) && line[len] == ':' &&
+            sscanf(line + len + 1, " %lld", &value) == 1 && value > 0) {
+            *(guint64*)((guint8*)stats + c->offset) += value;
+            return;
+        }
+    }
+}
+
+static
+void
+gbinder_stats_parse_kernel_line(
+    const char* line,
+    GBinderStatsKernel* stats)
+{
+    long long value = 0;
+    guint n[3];
+
+    /* Everything adds up, the process may have several sections */
+    if (sscanf(line, "threads: %u", n) == 1) {
+        stats->threads += n[0];
+    } else if (sscanf(line, "requested threads: %u+%u/%u",
+        n, n + 1, n + 2) == 3) {
+        stats->requested_threads += n[0];
+        stats->started_threads += n[1];
+        stats->max_threads += n[2];
+    } else if (sscanf(line, "ready threads %u", n) == 1) {
+        stats->ready_threads += n[0];
+    } else if (sscanf(line, "nodes: %u", n) == 1) {
+        stats->nodes += n[0];
+    } else if (sscanf(line, "refs: %u", n) == 1) {
+        stats->refs += n[0];
+    } else if (sscanf(line, "buffers: %u", n) == 1) {
+        stats->buffers += n[0];
+    } else if (sscanf(line, "pending transactions: %u", n) == 1) {
+        stats->pending_transactions += n[0];
+    } else if (sscanf(line, "free async space %lld", &value) == 1) {
+        stats->free_async_space += MAX(value, 0);
+    } else {
+        gbinder_stats_parse_kernel_counter(line, stats);
+    }
+}
+
+gboolean
+gbinder_stats_parse_kernel(
+    const char* text,
+    const char* context,
+    int pid,
+    GBinderStatsKernel* stats)
+{
+    char* proc = g_strdup_printf("proc %d", pid);
+    char** lines = g_strsplit(text, "\n", -1);
+    gboolean pid_matched = FALSE;
+    gboolean in_proc = FALSE;
+    gboolean found = FALSE;
+    char** ptr;
+
+    memset(stats, 0, sizeof(*stats));
+    for (ptr = lines; *ptr; ptr++) {
+        const char* line = *ptr;
+
+        if (line[0] == ' ') {
+            if (in_proc) {
+                while (*line == ' ') line++;
+                gbinder_stats_parse_kernel_line(line, stats);
+            }
+        } else if (pid_matched && g_str_has_prefix(line, "context ")) {
+            /* Context line follows the proc line */
+            in_proc = !g_strcmp0(line + 8, context);
+            found |= in_proc;
+            pid_matched = FALSE;
+        } else {
+            pid_matched = !strcmp(line, proc);
+            in_proc = FALSE;
+        }
+    }
+    g_strfreev(lines);
+    g_free(proc);
+    return found;
+}
+
+gboolean
+gbinder_stats_get_kernel(
+    const char* dev,
+    int pid,
+    GBinderStatsKernel* stats) /* Since 1.1.25 */
+{
+    gboolean ok = FALSE;
+
+    if (G_LIKELY(dev) && G_LIKELY(stats)) {
+        /* The context is named after the device node */
+        char* path = realpath(dev, NULL);
+        const char* node = path ? path : dev;
+        char* context = g_path_get_basename(node);
+        char* dir = g_path_get_dirname(node);
+        char* binderfs = g_build_filename(dir, "binder_logs", "stats", NULL);
+        const char* files[3];
+        const int self = getpid();
+        guint i;
+
+        files[0] = binderfs;
+        files[1] = "/sys/kernel/debug/binder/stats";
+        files[2] = "/dev/binderfs/binder_logs/stats";
+        for (i = 0; i < G_N_ELEMENTS(files) && !ok; i++) {
+            char* text = NULL;
+
+            if (g_file_get_contents(files[i], &text, NULL, NULL)) {
+                GDEBUG("Reading %s", files[i]);
+                ok = gbinder_stats_parse_kernel(text, context,
+                    pid ? pid : self, stats);
+                g_free(text);
+            }
+        }
+        if (ok && (!pid || pid == self)) {
+            gbinder_ipc_kernel_stats(dev, stats);
+        }
+        g_free(binderfs);
+        g_free(dir);
+        g_free(context);
+        free(path);
+    }
+    return ok;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
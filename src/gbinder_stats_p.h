@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GBINDER_STATS_PRIVATE_H
+#define GBINDER_STATS_PRIVATE_H
+
+#include <gbinder_stats.h>
+
+#include "gbinder_types_p.h"
+
+extern gint gbinder_stats_on GBINDER_INTERNAL;
+extern gint gbinder_stats_handlers_on GBINDER_INTERNAL;
+
+/* The only thing that gets evaluated when statistics are disabled */
+#define gbinder_stats_active() G_UNLIKELY(g_atomic_int_get(&gbinder_stats_on))
+
+/* Start time of a measured transaction or zero if it's not measured */
+#define gbinder_stats_begin() \
+    (gbinder_stats_active() ? gbinder_stats_start() : 0)
+
+gint64
+gbinder_stats_start(
+    void)
+    GBINDER_INTERNAL;
+
+/* Start time of a profiled handler invocation or zero */
+#define gbinder_stats_handler_begin() \
+    (G_UNLIKELY(g_atomic_int_get(&gbinder_stats_handlers_on)) ? \
+    MAX(g_get_monotonic_time(), 1) : 0)
+
+void
+gbinder_stats_handler(
+    const char* dev,
+    const char* iface,
+    guint32 code,
+    guint32 flags,
+    guint64 trace_id,
+    gint64 start)
+    GBINDER_INTERNAL;
+
+/* Only the first occurrence of each phase is remembered */
+void
+gbinder_stats_startup(
+    GBINDER_STATS_STARTUP phase,
+    gint64 start)
+    GBINDER_INTERNAL;
+
+void
+gbinder_stats_tuning(
+    const char* dev,
+    GBINDER_STATS_TUNING param,
+    guint old_value,
+    guint new_value)
+    GBINDER_INTERNAL;
+
+void
+gbinder_stats_record(
+    const char* dev,
+    const char* iface,
+    guint32 code,
+    GBINDER_STATS_DIR dir,
+    guint32 flags,
+    int status,
+    gsize request_bytes,
+    gsize reply_bytes,
+    guint objects,
+    gint64 usec)
+    GBINDER_INTERNAL;
+
+/* Returns zero if statistics are disabled */
+gint64
+gbinder_stats_probe_enter(
+    GBINDER_STATS_PROBE probe)
+    GBINDER_INTERNAL;
+
+/* Does nothing if start is zero */
+void
+gbinder_stats_probe_exit(
+    GBINDER_STATS_PROBE probe,
+    gint64 start)
+    GBINDER_INTERNAL;
+
+void
+gbinder_stats_mem_add(
+    GBINDER_STATS_MEM type,
+    gsize bytes)
+    GBINDER_INTERNAL;
+
+void
+gbinder_stats_mem_remove(
+    GBINDER_STATS_MEM type,
+    gsize bytes)
+    GBINDER_INTERNAL;
+
+void
+gbinder_stats_outgoing(
+    const char* dev,
+    guint32 code,
+    guint32 flags,
+    GBinderLocalRequest* req,
+    GBinderRemoteReply* reply,
+    int status,
+    gint64 start)
+    GBINDER_INTERNAL;
+
+void
+gbinder_stats_incoming(
+    const char* dev,
+    guint32 code,
+    guint32 flags,
+    GBinderRemoteRequest* req,
+    GBinderLocalReply* reply,
+    int status,
+    gint64 start)
+    GBINDER_INTERNAL;
+
+void
+gbinder_stats_forwarded(
+    const char* dev,
+    guint32 code,
+    guint32 flags,
+    GBinderRemoteRequest* req,
+    GBinderLocalReply* reply,
+    int status,
+    gint64 start)
+    GBINDER_INTERNAL;
+
+/* Parses the contents of the binder driver's stats file */
+gboolean
+gbinder_stats_parse_kernel(
+    const char* text,
+    const char* context,
+    int pid,
+    GBinderStatsKernel* stats)
+    GBINDER_INTERNAL;
+
+#endif /* GBINDER_STATS_PRIVATE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -37,6 +37,7 @@
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/inotify.h>
 
 int
 gbinder_system_open(
@@ -83,6 +84,22 @@ gbinder_system_munmap(
     return munmap(addr, length);
 }
 
+int
+gbinder_system_open_watch(
+    const char* path)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (fd >= 0 && inotify_add_watch(fd, path, IN_OPEN) < 0) {
+        const int err = errno;
+
+        close(fd);
+        errno = err;
+        fd = -1;
+    }
+    return fd;
+}
+
 /*
  * Local Variables:
  * mode: C
@@ -67,6 +67,12 @@ gbinder_system_munmap(
     size_t length)
     GBINDER_INTERNAL;
 
+/* Non-blocking fd which becomes readable when someone opens the path */
+int
+gbinder_system_open_watch(
+    const char* path)
+    GBINDER_INTERNAL;
+
 #endif /* GBINDER_SYSTEM_H */
 
 /*
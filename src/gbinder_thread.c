@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define _GNU_SOURCE /* cpu_set_t and friends */
+
+#include "gbinder_thread.h"
+#include "gbinder_log.h"
+
+#include <sched.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+/* State of a pooled thread, see gbinder_thread_config_enter() */
+typedef struct gbinder_thread_state {
+    guint id; /* Id of the configuration applied to this thread */
+    GBinderThreadConfig saved; /* What it was before that */
+    cpu_set_t cpus;
+} GBinderThreadState;
+
+static GPrivate gbinder_thread_state = G_PRIVATE_INIT(g_free);
+static gint gbinder_thread_last_id = 0;
+
+static
+void
+gbinder_thread_config_changed(
+    GBinderThreadConfig* config)
+{
+    if (config->cpus || config->policy >= 0 || config->stack_size) {
+        guint id;
+
+        /* Zero is reserved for the empty configuration */
+        do {
+            id = (guint)g_atomic_int_add(&gbinder_thread_last_id, 1) + 1;
+        } while (!id);
+        config->id = id;
+    } else {
+        config->id = 0;
+    }
+}
+
+void
+gbinder_thread_config_init(
+    GBinderThreadConfig* config)
+{
+    memset(config, 0, sizeof(*config));
+    config->policy = -1;
+}
+
+void
+gbinder_thread_config_clear(
+    GBinderThreadConfig* config)
+{
+    g_free(config->cpus);
+    gbinder_thread_config_init(config);
+}
+
+gboolean
+gbinder_thread_config_set_cpus(
+    GBinderThreadConfig* config,
+    const char* cpus)
+{
+    cpu_set_t* set = NULL;
+
+    if (cpus && cpus[0]) {
+        const char* ptr = cpus;
+
+        set = g_new0(cpu_set_t, 1);
+        while (*ptr) {
+            char* end;
+            long first = strtol(ptr, &end, 10);
+            long last = first;
+
+            if (end == ptr) {
+                break;
+            }
+            if (*end == '-') {
+                ptr = end + 1;
+                last = strtol(ptr, &end, 10);
+                if (end == ptr) {
+                    break;
+                }
+            }
+            if (first < 0 || last < first || last >= CPU_SETSIZE) {
+                break;
+            }
+            for (; first <= last; first++) {
+                CPU_SET(first, set);
+            }
+            ptr = end;
+            if (*ptr == ',') {
+                ptr++;
+            } else if (*ptr) {
+                break;
+            }
+        }
+        if (*ptr || !CPU_COUNT(set)) {
+            GWARN("Invalid CPU list '%s'", cpus);
+            g_free(set);
+            return FALSE;
+        }
+    }
+    g_free(config->cpus);
+    config->cpus = set;
+    gbinder_thread_config_changed(config);
+    return TRUE;
+}
+
+gboolean
+gbinder_thread_config_set_sched(
+    GBinderThreadConfig* config,
+    int policy,
+    int priority)
+{
+    switch (policy) {
+    case SCHED_OTHER:
+        if (priority < -20 || priority > 19) {
+            return FALSE;
+        }
+        break;
+    case SCHED_FIFO:
+    case SCHED_RR:
+        if (priority < sched_get_priority_min(policy) ||
+            priority > sched_get_priority_max(policy)) {
+            return FALSE;
+        }
+        break;
+    default:
+        if (policy >= 0) {
+            return FALSE;
+        }
+        policy = -1;
+        priority = 0;
+        break;
+    }
+    config->policy = policy;
+    config->priority = priority;
+    gbinder_thread_config_changed(config);
+    return TRUE;
+}
+
+void
+gbinder_thread_config_set_stack_size(
+    GBinderThreadConfig* config,
+    gsize size)
+{
+    config->stack_size = size ? MAX(size, PTHREAD_STACK_MIN) : 0;
+    gbinder_thread_config_changed(config);
+}
+
+pthread_attr_t*
+gbinder_thread_config_attr(
+    const GBinderThreadConfig* config,
+    pthread_attr_t* attr)
+{
+    if (config->stack_size && !pthread_attr_init(attr)) {
+        if (!pthread_attr_setstacksize(attr, config->stack_size)) {
+            return attr;
+        }
+        GWARN("Failed to set thread stack size to %lu",
+            (gulong) config->stack_size);
+        pthread_attr_destroy(attr);
+    }
+    return NULL;
+}
+
+static
+void
+gbinder_thread_config_save(
+    GBinderThreadState* state)
+{
+    GBinderThreadConfig* saved = &state->saved;
+
+    /* Everything gets restored, not only what the config is changing */
+    gbinder_thread_config_init(saved);
+    if (!sched_getaffinity(0, sizeof(state->cpus), &state->cpus)) {
+        saved->cpus = &state->cpus;
+    }
+    saved->policy = sched_getscheduler(0);
+#ifdef SCHED_RESET_ON_FORK
+    if (saved->policy > 0) {
+        saved->policy &= ~SCHED_RESET_ON_FORK;
+    }
+#endif
+    if (saved->policy == SCHED_FIFO || saved->policy == SCHED_RR) {
+        struct sched_param param;
+
+        if (!sched_getparam(0, &param)) {
+            saved->priority = param.sched_priority;
+        } else {
+            saved->policy = -1;
+        }
+    } else if (saved->policy == SCHED_OTHER) {
+        errno = 0;
+        saved->priority = getpriority(PRIO_PROCESS, 0);
+        if (errno) {
+            saved->policy = -1;
+        }
+    } else {
+        /* Something we don't touch */
+        saved->policy = -1;
+    }
+}
+
+void
+gbinder_thread_config_apply(
+    const GBinderThreadConfig* config)
+{
+    /* These apply to the calling thread on Linux */
+    if (config->cpus && sched_setaffinity(0, sizeof(cpu_set_t),
+        config->cpus) < 0) {
+        GWARN("Failed to set thread affinity: %s", strerror(errno));
+    }
+    if (config->policy >= 0) {
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        if (config->policy != SCHED_OTHER) {
+            param.sched_priority = config->priority;
+        }
+        if (sched_setscheduler(0, config->policy, &param) < 0) {
+            GWARN("Failed to set scheduling policy %d: %s", config->policy,
+                strerror(errno));
+        } else if (config->policy == SCHED_OTHER &&
+            setpriority(PRIO_PROCESS, 0, config->priority) < 0) {
+            GWARN("Failed to set nice value %d: %s", config->priority,
+                strerror(errno));
+        }
+    }
+}
+
+void
+gbinder_thread_config_enter(
+    const GBinderThreadConfig* config)
+{
+    GBinderThreadState* state = g_private_get(&gbinder_thread_state);
+    const guint id = config->id;
+
+    if (state ? (state->id != id) : (id != 0)) {
+        if (!state) {
+            state = g_new(GBinderThreadState, 1);
+            gbinder_thread_config_save(state);
+            g_private_set(&gbinder_thread_state, state);
+        } else if (state->id) {
+            /* Undo the previous configuration */
+            gbinder_thread_config_apply(&state->saved);
+        }
+        if (id) {
+            GVERBOSE_("applying thread config %u", id);
+            gbinder_thread_config_apply(config);
+        }
+        state->id = id;
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
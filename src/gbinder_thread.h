@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GBINDER_THREAD_H
+#define GBINDER_THREAD_H
+
+#include "gbinder_types_p.h"
+
+#include <pthread.h>
+
+/*
+ * Placement and scheduling of the threads created by libgbinder. Unset
+ * fields leave the corresponding attribute of the thread alone. Each
+ * change assigns a new id, which lets the pooled threads notice that
+ * they need to be reconfigured.
+ */
+typedef struct gbinder_thread_config {
+    guint id; /* Zero if nothing is configured */
+    gpointer cpus; /* cpu_set_t* or NULL */
+    int policy; /* Negative if not set */
+    int priority; /* Nice value or realtime priority */
+    gsize stack_size; /* Zero for default */
+} GBinderThreadConfig;
+
+void
+gbinder_thread_config_init(
+    GBinderThreadConfig* config)
+    GBINDER_INTERNAL;
+
+void
+gbinder_thread_config_clear(
+    GBinderThreadConfig* config)
+    GBINDER_INTERNAL;
+
+/* List of CPUs like "4-7" or "0,2", NULL or empty to unset */
+gboolean
+gbinder_thread_config_set_cpus(
+    GBinderThreadConfig* config,
+    const char* cpus)
+    GBINDER_INTERNAL;
+
+/* SCHED_OTHER with a nice value or SCHED_FIFO/SCHED_RR, negative to unset */
+gboolean
+gbinder_thread_config_set_sched(
+    GBinderThreadConfig* config,
+    int policy,
+    int priority)
+    GBINDER_INTERNAL;
+
+void
+gbinder_thread_config_set_stack_size(
+    GBinderThreadConfig* config,
+    gsize size)
+    GBINDER_INTERNAL;
+
+/* Prepares attributes for pthread_create, these need pthread_attr_destroy */
+pthread_attr_t*
+gbinder_thread_config_attr(
+    const GBinderThreadConfig* config,
+    pthread_attr_t* attr)
+    G_GNUC_WARN_UNUSED_RESULT
+    GBINDER_INTERNAL;
+
+/* Applies the configuration to the calling thread */
+void
+gbinder_thread_config_apply(
+    const GBinderThreadConfig* config)
+    GBINDER_INTERNAL;
+
+/*
+ * For the pooled threads which may end up serving different devices.
+ * Applies the configuration unless it's already there, restoring the
+ * original state of the thread if the configuration is empty.
+ */
+void
+gbinder_thread_config_enter(
+    const GBinderThreadConfig* config)
+    GBINDER_INTERNAL;
+
+#endif /* GBINDER_THREAD_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GBINDER_TRACE_H
+#define GBINDER_TRACE_H
+
+#include "gbinder_types_p.h"
+
+/*
+ * Static tracepoints on the transaction path, compiled in with
+ * make USE_USDT=1 (requires <sys/sdt.h>). Probes are in the libgbinder
+ * provider and take four arguments:
+ *
+ *   arg0  handle (outgoing) or local object pointer (incoming)
+ *   arg1  transaction code
+ *   arg2  data size (tx_done: transaction status)
+ *   arg3  transaction id, i.e. the address of the data buffer
+ *
+ * Outgoing transactions are identified by the address of the request
+ * data, incoming ones by the address of the kernel buffer, the same
+ * that gets passed to BC_FREE_BUFFER.
+ *
+ *   tx_send         BC_TRANSACTION about to be written
+ *   tx_done         gbinder_driver_transact() is about to return
+ *   tx_receive      BR_TRANSACTION has been read
+ *   reply_send      BC_REPLY about to be written
+ *   dispatch_start  Main thread starts handling the transaction
+ *   dispatch_end    Main thread is done with it
+ *   buffer_free     BC_FREE_BUFFER is written or queued
+ *
+ * With TraceContext enabled for the device, two more probes associate
+ * transaction ids with the trace ids (arg2) carried across processes:
+ *
+ *   tx_context_send     Trace id attached to the outgoing transaction
+ *   tx_context_receive  Trace id found in the incoming transaction
+ *
+ * When disabled, none of this generates any code.
+ */
+
+#if GBINDER_USDT
+#  include <sys/sdt.h>
+#  define GBINDER_TRACE(probe,handle,code,size,id) \
+    DTRACE_PROBE4(libgbinder, probe, (guint64)(handle), (guint32)(code), \
+        (gint64)(size), (gconstpointer)(id))
+#  define GBINDER_TRACE_CONTEXT(probe,handle,code,trace,id) \
+    DTRACE_PROBE4(libgbinder, probe, (guint64)(handle), (guint32)(code), \
+        (guint64)(trace), (gconstpointer)(id))
+#else
+#  define GBINDER_TRACE(probe,handle,code,size,id) ((void)0)
+#  define GBINDER_TRACE_CONTEXT(probe,handle,code,trace,id) ((void)0)
+#endif
+
+#endif /* GBINDER_TRACE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
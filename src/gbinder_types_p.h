@@ -41,6 +41,7 @@ typedef struct gbinder_cleanup GBinderCleanup;
 typedef struct gbinder_driver GBinderDriver;
 typedef struct gbinder_handler GBinderHandler;
 typedef struct gbinder_io GBinderIo;
+typedef struct gbinder_memory_cache GBinderMemoryCache;
 typedef struct gbinder_object_converter GBinderObjectConverter;
 typedef struct gbinder_object_registry GBinderObjectRegistry;
 typedef struct gbinder_output_data GBinderOutputData;
@@ -77,6 +78,18 @@ typedef struct gbinder_ipc_sync_api GBinderIpcSyncApi;
 /* As a special case, ServiceManager's handle is zero */
 #define GBINDER_SERVICEMANAGER_HANDLE (0)
 
+/* Blob types, as in Android's Parcel::writeBlob */
+#define GBINDER_BLOB_INPLACE (0)
+#define GBINDER_BLOB_ASHMEM_IMMUTABLE (1)
+#define GBINDER_BLOB_ASHMEM_MUTABLE (2)
+
+/* Blobs larger than that are passed via shared memory by default */
+#define GBINDER_BLOB_INPLACE_LIMIT (16*1024)
+
+/* Chunked transfer operations, see gbinder_local_object_accept_chunked() */
+#define GBINDER_CHUNK_PUT (0)
+#define GBINDER_CHUNK_GET (1)
+
 #endif /* GBINDER_TYPES_PRIVATE_H */
 
 /*
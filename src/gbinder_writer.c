@@ -32,10 +32,11 @@
 
 #include "gbinder_writer_p.h"
 #include "gbinder_buffer_p.h"
+#include "gbinder_config.h"
 #include "gbinder_fmq_p.h"
 #include "gbinder_local_object.h"
 #include "gbinder_object_converter.h"
-#include "gbinder_io.h"
+#include "gbinder_io_fixed.h"
 #include "gbinder_log.h"
 
 #include <gutil_intarray.h>
@@ -47,18 +48,281 @@
 #include <stdint.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 typedef struct gbinder_writer_priv {
     GBinderWriterData* data;
+    /* These two are used by the inline functions in gbinder_writer.h */
+    GByteArray* bytes;
+    gsize capacity; /* What the bytes can take without reallocation */
 } GBinderWriterPriv;
 
 G_STATIC_ASSERT(sizeof(GBinderWriter) >= sizeof(GBinderWriterPriv));
+G_STATIC_ASSERT(G_STRUCT_OFFSET(GBinderWriterPriv, bytes) ==
+    G_STRUCT_OFFSET(GBinderWriter, d) + sizeof(gconstpointer));
+G_STATIC_ASSERT(G_STRUCT_OFFSET(GBinderWriterPriv, capacity) ==
+    G_STRUCT_OFFSET(GBinderWriter, d) + 2 * sizeof(gconstpointer));
+
+/* The smallest amount of space gbinder_writer_grow() makes available */
+#define GBINDER_WRITER_MIN_GROW (64)
+
+/*
+ * Small temporary allocations (HIDL string and vector descriptors,
+ * gbinder_writer_malloc() and friends) are carved from larger chunks
+ * which are all freed together with GBinderWriterData. Allocations
+ * larger than a quarter of the chunk get a chunk of their own.
+ */
+struct gbinder_writer_chunk {
+    GBinderWriterChunk* next;
+    gsize size;
+    gsize used;
+};
+
+/*
+ * Buffers of the freed requests and replies can be kept around and
+ * reused by the next ones, up to [BufferPoolSize] bytes in total.
+ * The pool is disabled by default.
+ */
+typedef struct gbinder_writer_pool_entry {
+    GByteArray* bytes;
+    GBinderCleanup* cleanup;
+    gsize size;
+} GBinderWriterPoolEntry;
+
+#define GBINDER_WRITER_POOL_MAX_ENTRIES (32)
+
+static GMutex gbinder_writer_pool_mutex;
+static int gbinder_writer_pool_max_size = -1; /* Not yet configured */
+static gsize gbinder_writer_pool_size = 0;
+static guint gbinder_writer_pool_n = 0;
+static GBinderWriterPoolEntry
+    gbinder_writer_pool[GBINDER_WRITER_POOL_MAX_ENTRIES];
+
+static int gbinder_writer_blob_limit = -1; /* Not yet configured */
+
+#define GBINDER_WRITER_CHUNK_SIZE (1024)
+#define GBINDER_WRITER_CHUNK_HEADER_SIZE G_ALIGN8(sizeof(GBinderWriterChunk))
+#define GBINDER_WRITER_CHUNK_DATA(chunk) \
+    (((guint8*)(chunk)) + GBINDER_WRITER_CHUNK_HEADER_SIZE)
 
 GBINDER_INLINE_FUNC GBinderWriterPriv* gbinder_writer_cast(GBinderWriter* pub)
     { return (GBinderWriterPriv*)pub; }
 GBINDER_INLINE_FUNC GBinderWriterData* gbinder_writer_data(GBinderWriter* pub)
     { return G_LIKELY(pub) ? gbinder_writer_cast(pub)->data : NULL; }
 
+static
+void
+gbinder_writer_pool_shrink_locked(
+    gsize max_size)
+{
+    /* Caller holds gbinder_writer_pool_mutex */
+    while (gbinder_writer_pool_n > 0 && gbinder_writer_pool_size > max_size) {
+        GBinderWriterPoolEntry* e =
+            gbinder_writer_pool + (--gbinder_writer_pool_n);
+
+        gbinder_writer_pool_size -= e->size;
+        g_byte_array_free(e->bytes, TRUE);
+        gbinder_cleanup_free(e->cleanup);
+    }
+}
+
+void
+gbinder_writer_pool_set_size(
+    int max_size)
+{
+    /* Lock */
+    g_mutex_lock(&gbinder_writer_pool_mutex);
+    gbinder_writer_pool_max_size = MAX(max_size, 0);
+    gbinder_writer_pool_shrink_locked(gbinder_writer_pool_max_size);
+    g_mutex_unlock(&gbinder_writer_pool_mutex);
+    /* Unlock */
+}
+
+guint
+gbinder_writer_pool_count(
+    void)
+{
+    return gbinder_writer_pool_n;
+}
+
+static
+void
+gbinder_writer_pool_exit(
+    void)
+    GBINDER_DESTRUCTOR;
+
+static
+void
+gbinder_writer_pool_exit(
+    void)
+{
+    gbinder_writer_pool_shrink_locked(0);
+}
+
+void
+gbinder_writer_data_init(
+    GBinderWriterData* data,
+    const GBinderIo* io)
+{
+    data->io = io;
+    if (gbinder_writer_pool_n) {
+        /* Lock */
+        g_mutex_lock(&gbinder_writer_pool_mutex);
+        if (gbinder_writer_pool_n) {
+            GBinderWriterPoolEntry* e =
+                gbinder_writer_pool + (--gbinder_writer_pool_n);
+
+            gbinder_writer_pool_size -= e->size;
+            data->bytes = e->bytes;
+            data->cleanup = e->cleanup;
+        }
+        g_mutex_unlock(&gbinder_writer_pool_mutex);
+        /* Unlock */
+    }
+    if (!data->bytes) {
+        data->bytes = g_byte_array_new();
+    }
+}
+
+void
+gbinder_writer_data_clear(
+    GBinderWriterData* data)
+{
+    GByteArray* bytes = data->bytes;
+    GBinderCleanup* cleanup = data->cleanup;
+    const gsize size = bytes->len;
+
+    /* Run the cleanup callbacks but keep the array */
+    gbinder_cleanup_reset(cleanup);
+    gbinder_writer_data_free_chunks(data);
+    gutil_int_array_free(data->offsets, TRUE);
+    data->offsets = NULL;
+    data->bytes = NULL;
+    data->cleanup = NULL;
+
+    /* Lock */
+    g_mutex_lock(&gbinder_writer_pool_mutex);
+    if (gbinder_writer_pool_max_size < 0) {
+        gbinder_writer_pool_max_size = MAX(gbinder_config_get_device_int
+            (GBINDER_CONFIG_GROUP_BUFFER_POOL_SIZE, NULL, 0), 0);
+    }
+    if (gbinder_writer_pool_n < GBINDER_WRITER_POOL_MAX_ENTRIES &&
+        (gbinder_writer_pool_size + size) <= (gsize)gbinder_writer_pool_max_size) {
+        GBinderWriterPoolEntry* e =
+            gbinder_writer_pool + (gbinder_writer_pool_n++);
+
+        /* The allocated space is preserved */
+        g_byte_array_set_size(bytes, 0);
+        e->bytes = bytes;
+        e->cleanup = cleanup;
+        e->size = size;
+        gbinder_writer_pool_size += size;
+        bytes = NULL;
+        cleanup = NULL;
+    }
+    g_mutex_unlock(&gbinder_writer_pool_mutex);
+    /* Unlock */
+
+    if (bytes) {
+        g_byte_array_free(bytes, TRUE);
+        gbinder_cleanup_free(cleanup);
+    }
+}
+
+static
+GBinderWriterChunk*
+gbinder_writer_chunk_new(
+    gsize size)
+{
+    GBinderWriterChunk* chunk = g_malloc(GBINDER_WRITER_CHUNK_HEADER_SIZE +
+        size);
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void*
+gbinder_writer_data_alloc(
+    GBinderWriterData* data,
+    gsize size)
+{
+    if (size) {
+        GBinderWriterChunk* chunk = data->chunks;
+        const gsize aligned = G_ALIGN8(size);
+        void* ptr;
+
+        if (!chunk || (chunk->used + aligned) > chunk->size) {
+            if (aligned > GBINDER_WRITER_CHUNK_SIZE / 4) {
+                /* Don't waste what's left in the current chunk */
+                chunk = gbinder_writer_chunk_new(aligned);
+                if (data->chunks) {
+                    chunk->next = data->chunks->next;
+                    data->chunks->next = chunk;
+                } else {
+                    data->chunks = chunk;
+                }
+            } else {
+                chunk = gbinder_writer_chunk_new(GBINDER_WRITER_CHUNK_SIZE);
+                chunk->next = data->chunks;
+                data->chunks = chunk;
+            }
+        }
+        ptr = GBINDER_WRITER_CHUNK_DATA(chunk) + chunk->used;
+        chunk->used += aligned;
+        return ptr;
+    }
+    return NULL;
+}
+
+void
+gbinder_writer_data_free_chunks(
+    GBinderWriterData* data)
+{
+    GBinderWriterChunk* chunk = data->chunks;
+
+    data->chunks = NULL;
+    while (chunk) {
+        GBinderWriterChunk* next = chunk->next;
+
+        g_free(chunk);
+        chunk = next;
+    }
+}
+
+static
+void*
+gbinder_writer_data_alloc0(
+    GBinderWriterData* data,
+    gsize size)
+{
+    void* ptr = gbinder_writer_data_alloc(data, size);
+
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+static
+void*
+gbinder_writer_data_memdup(
+    GBinderWriterData* data,
+    const void* buf,
+    gsize size)
+{
+    if (buf) {
+        void* ptr = gbinder_writer_data_alloc(data, size);
+
+        if (ptr) {
+            memcpy(ptr, buf, size);
+            return ptr;
+        }
+    }
+    return NULL;
+}
+
 void
 gbinder_writer_data_set_contents(
     GBinderWriterData* data,
@@ -69,6 +333,7 @@ gbinder_writer_data_set_contents(
     gutil_int_array_set_count(data->offsets, 0);
     data->buffers_size = 0;
     gbinder_cleanup_reset(data->cleanup);
+    gbinder_writer_data_free_chunks(data);
     gbinder_writer_data_append_contents(data, buffer, 0, convert);
 }
 
@@ -87,17 +352,24 @@ gbinder_writer_data_append_contents(
         const guint8* bufdata = gbinder_buffer_data(buffer, &bufsize);
         void** objects = gbinder_buffer_objects(buffer);
 
+        /*
+         * The contents reference keeps the memory referenced by buffer
+         * objects alive, those are forwarded without copying. Only the
+         * flat data gets copied because the kernel wants it contiguous
+         * and the mmapped transaction buffer is read-only. At least
+         * allocate the destination in one go.
+         */
         data->cleanup = gbinder_cleanup_add(data->cleanup, (GDestroyNotify)
             gbinder_buffer_contents_unref,
             gbinder_buffer_contents_ref(contents));
         if (objects && *objects) {
             const GBinderIo* io = gbinder_buffer_io(buffer);
+            guint n = 0;
 
             /* GBinderIo must be the same because it's defined by the kernel */
             GASSERT(io == data->io);
-            if (!data->offsets) {
-                data->offsets = gutil_int_array_new();
-            }
+            while (objects[n]) n++;
+            gbinder_writer_data_reserve(data, bufsize - off, n, 0);
             while (*objects) {
                 const guint8* obj = *objects++;
                 gsize objsize, offset = obj - bufdata;
@@ -114,26 +386,29 @@ gbinder_writer_data_append_contents(
                 gutil_int_array_append(data->offsets, dest->len);
 
                 /* Convert remote object into local if necessary */
-                if (convert && io->decode_binder_handle(obj, &handle) &&
+                if (convert &&
+                    GBINDER_IO_CALL(io, decode_binder_handle)(obj, &handle) &&
                     (local = gbinder_object_converter_handle_to_local
                     (convert, handle))) {
                     const guint pos = dest->len;
 
                     g_byte_array_set_size(dest, pos +
                         GBINDER_MAX_BINDER_OBJECT_SIZE);
-                    objsize = io->encode_local_object(dest->data + pos, local);
+                    objsize = GBINDER_IO_CALL(io, encode_local_object)
+                        (dest->data + pos, local);
                     g_byte_array_set_size(dest, pos + objsize);
 
                     /* Keep the reference */
                     data->cleanup = gbinder_cleanup_add(data->cleanup,
                         (GDestroyNotify) gbinder_local_object_unref, local);
                 } else {
-                    objsize = io->object_size(obj);
+                    objsize = GBINDER_IO_CALL(io, object_size)(obj);
                     g_byte_array_append(dest, obj, objsize);
                 }
 
                 /* Size of each buffer has to be 8-byte aligned */
-                data->buffers_size += G_ALIGN8(io->object_data_size(obj));
+                data->buffers_size += G_ALIGN8
+                    (GBINDER_IO_CALL(io, object_data_size)(obj));
                 off += objsize;
             }
         }
@@ -268,6 +543,79 @@ gbinder_writer_data_append_int32(
     *ptr = value;
 }
 
+void
+gbinder_writer_data_reserve(
+    GBinderWriterData* data,
+    gsize size,
+    guint objects,
+    guint buffers)
+{
+    GByteArray* bytes = data->bytes;
+    const guint len = bytes->len;
+    const guint count = objects + buffers;
+    const gsize total = size + objects * GBINDER_MAX_BINDER_OBJECT_SIZE +
+        buffers * GBINDER_MAX_BUFFER_OBJECT_SIZE;
+
+    /* Neither GByteArray nor GUtilIntArray shrink their allocations */
+    if (total) {
+        g_byte_array_set_size(bytes, len + total);
+        g_byte_array_set_size(bytes, len);
+    }
+    if (count) {
+        if (data->offsets) {
+            const guint n = data->offsets->count;
+
+            gutil_int_array_set_count(data->offsets, n + count);
+            gutil_int_array_set_count(data->offsets, n);
+        } else {
+            data->offsets = gutil_int_array_sized_new(count);
+        }
+    }
+}
+
+/*
+ * Slow path of the inline appends. Makes sure that there's room for
+ * at least size bytes and remembers how much is there. Neither GByteArray
+ * nor the pool of GBinderWriterData shrink the allocations, so what we
+ * remember here remains true even if something else writes to the same
+ * data in the meantime.
+ */
+GByteArray*
+gbinder_writer_grow(
+    GBinderWriter* self,
+    gsize size) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        GBinderWriterPriv* priv = gbinder_writer_cast(self);
+        GByteArray* bytes = data->bytes;
+        const guint len = bytes->len;
+        const gsize avail = MAX(size, MAX(len, GBINDER_WRITER_MIN_GROW));
+
+        g_byte_array_set_size(bytes, len + avail);
+        g_byte_array_set_size(bytes, len);
+        priv->bytes = bytes;
+        priv->capacity = len + avail;
+        return bytes;
+    }
+    return NULL;
+}
+
+void
+gbinder_writer_reserve(
+    GBinderWriter* self,
+    gsize size,
+    guint objects,
+    guint buffers) /* since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        gbinder_writer_data_reserve(data, size, objects, buffers);
+    }
+}
+
 void
 gbinder_writer_overwrite_int32(
     GBinderWriter* self,
@@ -469,6 +817,69 @@ gbinder_writer_data_append_string16_empty(
     ptr16[0] = ptr16[1] = ptr16[2] = 0; ptr16[3] = 0xffff;
 }
 
+/*
+ * Converts validated UTF-8 into UTF-16, returns the number of UTF-16 units.
+ * The output buffer must have room for at least num_bytes units.
+ */
+static
+gsize
+gbinder_writer_utf8_to_utf16(
+    gunichar2* out,
+    const guint8* in,
+    gsize num_bytes)
+{
+    const guint8* end = in + num_bytes;
+    gunichar2* ptr = out;
+
+    while (in < end) {
+        /* ASCII fast path, 8 bytes at a time */
+        while ((end - in) >= 8) {
+            guint64 chunk;
+
+            memcpy(&chunk, in, sizeof(chunk));
+            if (chunk & G_GUINT64_CONSTANT(0x8080808080808080)) {
+                break;
+            }
+            ptr[0] = in[0];
+            ptr[1] = in[1];
+            ptr[2] = in[2];
+            ptr[3] = in[3];
+            ptr[4] = in[4];
+            ptr[5] = in[5];
+            ptr[6] = in[6];
+            ptr[7] = in[7];
+            ptr += 8;
+            in += 8;
+        }
+
+        if (in < end) {
+            const guint8 c = *in;
+
+            if (c < 0x80) {
+                *ptr++ = c;
+                in++;
+            } else if (c < 0xe0) {
+                *ptr++ = ((c & 0x1f) << 6) | (in[1] & 0x3f);
+                in += 2;
+            } else if (c < 0xf0) {
+                *ptr++ = ((c & 0x0f) << 12) | ((in[1] & 0x3f) << 6) |
+                    (in[2] & 0x3f);
+                in += 3;
+            } else {
+                /* Surrogate pair */
+                const gunichar u = (((c & 0x07) << 18) |
+                    ((in[1] & 0x3f) << 12) | ((in[2] & 0x3f) << 6) |
+                    (in[3] & 0x3f)) - 0x10000;
+
+                *ptr++ = 0xd800 + (u >> 10);
+                *ptr++ = 0xdc00 + (u & 0x3ff);
+                in += 4;
+            }
+        }
+    }
+    return ptr - out;
+}
+
 void
 gbinder_writer_data_append_string16_len(
     GBinderWriterData* data,
@@ -487,40 +898,29 @@ gbinder_writer_data_append_string16_len(
     if (num_bytes > 0) {
         GByteArray* buf = data->bytes;
         const gsize old_size = buf->len;
-        glong len = g_utf8_strlen(utf8, num_bytes);
-        gsize padded_len = G_ALIGN4((len+1)*2);
+        gsize len, padded_len;
         guint32* len_ptr;
         gunichar2* utf16_ptr;
 
-        /* Preallocate space */
-        g_byte_array_set_size(buf, old_size + padded_len + 4);
+        /*
+         * Each UTF-8 sequence produces no more UTF-16 units than it has
+         * bytes, so num_bytes units (plus NULL terminator) are enough.
+         * Decode directly into the buffer and then trim it.
+         */
+        g_byte_array_set_size(buf, old_size + G_ALIGN4((num_bytes+1)*2) + 4);
         len_ptr = (guint32*)(buf->data + old_size);
         utf16_ptr = (gunichar2*)(len_ptr + 1);
-
-        /* TODO: this could be optimized for ASCII strings, i.e. if
-         * len equals num_bytes */
-        if (len > 0) {
-            glong utf16_len = 0;
-            gunichar2* utf16 = g_utf8_to_utf16(utf8, num_bytes, NULL,
-                &utf16_len, NULL);
-
-            if (utf16) {
-                len = utf16_len;
-                padded_len = G_ALIGN4((len+1)*2);
-                memcpy(utf16_ptr, utf16, (len+1)*2);
-                g_free(utf16);
-            }
-        }
+        len = gbinder_writer_utf8_to_utf16(utf16_ptr, (const guint8*)utf8,
+            num_bytes);
+        padded_len = G_ALIGN4((len+1)*2);
 
         /* Actual length */
         *len_ptr = len;
 
-        /* Zero padding */
-        if (padded_len - (len + 1)*2) {
-            memset(utf16_ptr + (len + 1), 0, padded_len - (len + 1)*2);
-        }
+        /* NULL terminator and zero padding */
+        memset(utf16_ptr + len, 0, padded_len - len*2);
 
-        /* Correct the packet size if necessaary */
+        /* Correct the packet size */
         g_byte_array_set_size(buf, old_size + padded_len + 4);
     } else if (utf8) {
         /* Empty string */
@@ -615,33 +1015,55 @@ gbinder_writer_data_close_fd(
     }
 }
 
+static
 void
-gbinder_writer_data_append_fd(
+gbinder_writer_data_append_fd_object(
     GBinderWriterData* data,
     int fd)
 {
     GByteArray* buf = data->bytes;
     const guint offset = buf->len;
-    /* Duplicate the descriptor so that caller can do whatever with
-     * the one it passed in. */
-    const int dupfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
     guint written;
 
     /* Preallocate enough space */
     g_byte_array_set_size(buf, offset + GBINDER_MAX_BINDER_OBJECT_SIZE);
+    written = GBINDER_IO_CALL(data->io, encode_fd_object)
+        (buf->data + offset, fd);
+    /* Fix the data size */
+    g_byte_array_set_size(buf, offset + written);
+    /* Record the offset */
+    gbinder_writer_data_record_offset(data, offset);
+}
+
+void
+gbinder_writer_data_append_fd(
+    GBinderWriterData* data,
+    int fd)
+{
+    /* Duplicate the descriptor so that caller can do whatever with
+     * the one it passed in. */
+    const int dupfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
     /* Write the original fd if we failed to dup it */
     if (dupfd < 0) {
         GWARN("Error dupping fd %d: %s", fd, strerror(errno));
-        written = data->io->encode_fd_object(buf->data + offset, fd);
+        gbinder_writer_data_append_fd_object(data, fd);
     } else {
-        written = data->io->encode_fd_object(buf->data + offset, dupfd);
+        gbinder_writer_data_adopt_fd(data, dupfd);
+    }
+}
+
+void
+gbinder_writer_data_adopt_fd(
+    GBinderWriterData* data,
+    int fd)
+{
+    gbinder_writer_data_append_fd_object(data, fd);
+    if (fd >= 0) {
+        /* Closed when the data is freed, i.e. after the transaction */
         data->cleanup = gbinder_cleanup_add(data->cleanup,
-            gbinder_writer_data_close_fd, GINT_TO_POINTER(dupfd));
+            gbinder_writer_data_close_fd, GINT_TO_POINTER(fd));
     }
-    /* Fix the data size */
-    g_byte_array_set_size(buf, offset + written);
-    /* Record the offset */
-    gbinder_writer_data_record_offset(data, offset);
 }
 
 void
@@ -656,6 +1078,26 @@ gbinder_writer_append_fd(
     }
 }
 
+/*
+ * Same as gbinder_writer_append_fd() but takes the ownership of the
+ * descriptor instead of duplicating it. The descriptor gets closed
+ * when the request or reply is freed. It's closed right away if the
+ * writer isn't initialized.
+ */
+void
+gbinder_writer_adopt_fd(
+    GBinderWriter* self,
+    int fd) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        gbinder_writer_data_adopt_fd(data, fd);
+    } else if (fd >= 0) {
+        gbinder_writer_data_close_fd(GINT_TO_POINTER(fd));
+    }
+}
+
 void
 gbinder_writer_data_append_fda_object(
     GBinderWriterData* data,
@@ -669,7 +1111,8 @@ gbinder_writer_data_append_fda_object(
     /* Preallocate enough space */
     g_byte_array_set_size(buf, offset + GBINDER_MAX_BINDER_OBJECT_SIZE);
 
-    written = data->io->encode_fda_object(buf->data + offset, fds, parent);
+    written = GBINDER_IO_CALL(data->io, encode_fda_object)
+        (buf->data + offset, fds, parent);
 
     /* Fix the data size */
     g_byte_array_set_size(buf, offset + written);
@@ -715,6 +1158,29 @@ gbinder_writer_append_buffer_object_with_parent(
     return 0;
 }
 
+guint
+gbinder_writer_append_buffer_object_bytes(
+    GBinderWriter* self,
+    GBytes* bytes,
+    const GBinderParent* parent) /* since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        gsize size = 0;
+        const void* buf = bytes ? g_bytes_get_data(bytes, &size) : NULL;
+
+        /* The parcel holds a reference but doesn't copy the data */
+        if (bytes) {
+            data->cleanup = gbinder_cleanup_add(data->cleanup,
+                (GDestroyNotify) g_bytes_unref, g_bytes_ref(bytes));
+        }
+        return gbinder_writer_data_append_buffer_object(data, buf, size,
+            parent);
+    }
+    return 0;
+}
+
 guint
 gbinder_writer_append_buffer_object(
     GBinderWriter* self,
@@ -744,7 +1210,8 @@ gbinder_writer_data_append_buffer_object(
     /* Preallocate enough space */
     g_byte_array_set_size(buf, offset + GBINDER_MAX_BUFFER_OBJECT_SIZE);
     /* Write the object */
-    n = data->io->encode_buffer_object(buf->data + offset, ptr, size, parent);
+    n = GBINDER_IO_CALL(data->io, encode_buffer_object)
+        (buf->data + offset, ptr, size, parent);
     /* Fix the data size */
     g_byte_array_set_size(buf, offset + n);
     /* Record the offset */
@@ -771,6 +1238,45 @@ gbinder_writer_append_parcelable(
     }
 }
 
+gsize
+gbinder_writer_begin_parcelable(
+    GBinderWriter* self) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        gsize start;
+
+        /* Non-null */
+        gbinder_writer_data_append_int32(data, 1);
+
+        /* The size is patched by gbinder_writer_end_parcelable() */
+        start = data->bytes->len;
+        gbinder_writer_data_append_int32(data, 0);
+        return start;
+    }
+    return 0;
+}
+
+void
+gbinder_writer_end_parcelable(
+    GBinderWriter* self,
+    gsize start) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        GByteArray* buf = data->bytes;
+
+        /* The size includes the size field itself */
+        if (start >= sizeof(gint32) && buf->len >= start + sizeof(gint32)) {
+            *((gint32*)(buf->data + start)) = buf->len - start;
+        } else {
+            GWARN("Invalid parcelable start %lu", (gulong)start);
+        }
+    }
+}
+
 /*
  * This is compatible with aidl parcelables, and is not guaranteed to work
  * with any other kind of parcelable.
@@ -821,8 +1327,72 @@ gbinder_writer_append_hidl_string_copy(
     if (G_LIKELY(data)) {
         static const char empty[] = "";
 
-        gbinder_writer_data_append_hidl_string(data, str ? (str[0] ?
-            gbinder_writer_strdup(self, str) : empty) : NULL);
+        if (str && str[0]) {
+            const gsize len = strlen(str);
+
+            /* The length is only computed once */
+            gbinder_writer_data_append_hidl_string_len(data,
+                gbinder_writer_data_memdup(data, str, len + 1), len);
+        } else {
+            gbinder_writer_data_append_hidl_string_len(data,
+                str ? empty : NULL, 0);
+        }
+    }
+}
+
+/*
+ * The string is referenced rather than copied, it must stay alive until
+ * the parcel is freed and str[len] must be NUL. Neither the length nor
+ * the contents are checked.
+ */
+void
+gbinder_writer_append_hidl_string_len(
+    GBinderWriter* self,
+    const char* str,
+    gsize len) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        gbinder_writer_data_append_hidl_string_len(data, str, str ? len : 0);
+    }
+}
+
+/*
+ * References the contents of GBytes (the trailing NUL, if there is one,
+ * is not counted as a part of the string). The reference is released
+ * when the parcel is freed. The data are only copied if they don't end
+ * with NUL. NULL bytes are written as a NULL string.
+ */
+void
+gbinder_writer_append_hidl_string_bytes(
+    GBinderWriter* self,
+    GBytes* bytes) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        static const char empty[] = "";
+        const char* str = NULL;
+        gsize len = 0;
+
+        if (bytes) {
+            str = g_bytes_get_data(bytes, &len);
+            if (len && !str[len - 1]) {
+                len--;
+                data->cleanup = gbinder_cleanup_add(data->cleanup,
+                    (GDestroyNotify) g_bytes_unref, g_bytes_ref(bytes));
+            } else if (len) {
+                char* buf = gbinder_writer_data_alloc(data, len + 1);
+
+                memcpy(buf, str, len);
+                buf[len] = 0;
+                str = buf;
+            } else {
+                str = empty;
+            }
+        }
+        gbinder_writer_data_append_hidl_string_len(data, str, len);
     }
 }
 
@@ -834,18 +1404,16 @@ gbinder_writer_data_append_hidl_vec(
     guint elemsize)
 {
     GBinderParent vec_parent;
-    GBinderHidlVec* vec = g_new0(GBinderHidlVec, 1);
+    GBinderHidlVec* vec = gbinder_writer_data_alloc0(data, sizeof(*vec));
     const gsize total = count * elemsize;
-    void* buf = gutil_memdup(base, total);
+    void* buf = gbinder_writer_data_memdup(data, base, total);
 
     /* Fill in the vector descriptor */
     if (buf) {
         vec->data.ptr = buf;
         vec->count = count;
-        data->cleanup = gbinder_cleanup_add(data->cleanup, g_free, buf);
     }
     vec->owns_buffer = TRUE;
-    data->cleanup = gbinder_cleanup_add(data->cleanup, g_free, vec);
 
     /* Every vector, even the one without data, requires two buffer objects */
     vec_parent.offset = GBINDER_HIDL_VEC_BUFFER_OFFSET;
@@ -868,20 +1436,69 @@ gbinder_writer_append_hidl_vec(
     }
 }
 
+void
+gbinder_writer_append_hidl_vec_bytes(
+    GBinderWriter* self,
+    GBytes* bytes,
+    guint elemsize) /* since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        GBinderParent vec_parent;
+        GBinderHidlVec* vec = gbinder_writer_data_alloc0(data, sizeof(*vec));
+        gsize size = 0;
+        const void* buf = NULL;
+
+        /*
+         * The vector references the contents of GBytes directly, without
+         * copying it. The reference is released when the parcel is freed,
+         * i.e. after the driver is done with the data.
+         */
+        if (bytes && elemsize) {
+            buf = g_bytes_get_data(bytes, &size);
+            size -= size % elemsize;
+            if (size) {
+                data->cleanup = gbinder_cleanup_add(data->cleanup,
+                    (GDestroyNotify) g_bytes_unref, g_bytes_ref(bytes));
+                vec->data.ptr = buf;
+                vec->count = size / elemsize;
+            } else {
+                buf = NULL;
+            }
+        }
+        vec->owns_buffer = TRUE;
+
+        vec_parent.offset = GBINDER_HIDL_VEC_BUFFER_OFFSET;
+        vec_parent.index = gbinder_writer_data_append_buffer_object(data,
+            vec, sizeof(*vec), NULL);
+        gbinder_writer_data_append_buffer_object(data, buf, size, &vec_parent);
+    }
+}
+
 void
 gbinder_writer_data_append_hidl_string(
     GBinderWriterData* data,
     const char* str)
+{
+    gbinder_writer_data_append_hidl_string_len(data, str,
+        str ? strlen(str) : 0);
+}
+
+void
+gbinder_writer_data_append_hidl_string_len(
+    GBinderWriterData* data,
+    const char* str,
+    gsize len)
 {
     GBinderParent str_parent;
-    GBinderHidlString* hidl_string = g_new0(GBinderHidlString, 1);
-    const gsize len = str ? strlen(str) : 0;
+    GBinderHidlString* hidl_string = gbinder_writer_data_alloc0(data,
+        sizeof(*hidl_string));
 
     /* Fill in the string descriptor and store it */
     hidl_string->data.str = str;
     hidl_string->len = len;
     hidl_string->owns_buffer = TRUE;
-    data->cleanup = gbinder_cleanup_add(data->cleanup, g_free, hidl_string);
 
     /* Write the buffer object pointing to the string descriptor */
     str_parent.offset = GBINDER_HIDL_STRING_BUFFER_OFFSET;
@@ -919,7 +1536,7 @@ gbinder_writer_data_append_hidl_string_vec(
     gssize count)
 {
     GBinderParent vec_parent;
-    GBinderHidlVec* vec = g_new0(GBinderHidlVec, 1);
+    GBinderHidlVec* vec;
     GBinderHidlString* strings = NULL;
     int i;
 
@@ -928,15 +1545,22 @@ gbinder_writer_data_append_hidl_string_vec(
         count = gutil_strv_length((char**)strv);
     }
 
+    /*
+     * The vector and string descriptors share one allocation, the
+     * string data itself is referenced, not copied. Reserve space
+     * for all the buffer objects too, it's known in advance.
+     */
+    vec = gbinder_writer_data_alloc0(data, sizeof(*vec) +
+        sizeof(*strings) * count);
+    gbinder_writer_data_reserve(data, 0, 0, 2 + count);
+
     /* Fill in the vector descriptor */
     if (count > 0) {
-        strings = g_new0(GBinderHidlString, count);
+        strings = (GBinderHidlString*)(vec + 1);
         vec->data.ptr = strings;
-        data->cleanup = gbinder_cleanup_add(data->cleanup, g_free, strings);
     }
     vec->count = count;
     vec->owns_buffer = TRUE;
-    data->cleanup = gbinder_cleanup_add(data->cleanup, g_free, vec);
 
     /* Fill in string descriptors */
     for (i = 0; i < count; i++) {
@@ -988,6 +1612,136 @@ gbinder_writer_data_append_hidl_string_vec(
     }
 }
 
+/*
+ * Number of buffer objects needed for the embedded fields of the struct
+ * (or all of them, if it's a vector element), not counting the struct.
+ */
+static
+guint
+gbinder_writer_hidl_schema_buffers(
+    const GBinderHidlSchema* schema,
+    const guint8* ptr)
+{
+    const GBinderHidlField* f;
+    guint n = 0;
+
+    for (f = schema->fields; f && f->type != GBINDER_HIDL_FIELD_END; f++) {
+        const guint8* field = ptr + f->offset;
+
+        switch (f->type) {
+        case GBINDER_HIDL_FIELD_STRING:
+            n++;
+            break;
+        case GBINDER_HIDL_FIELD_VEC:
+            {
+                const GBinderHidlVec* vec = (const GBinderHidlVec*)field;
+                const guint8* elem = vec->data.ptr;
+
+                n++;
+                if (elem && f->schema->fields) {
+                    guint i;
+
+                    for (i = 0; i < vec->count; i++) {
+                        n += gbinder_writer_hidl_schema_buffers(f->schema,
+                            elem + i * f->schema->size);
+                    }
+                }
+            }
+            break;
+        case GBINDER_HIDL_FIELD_STRUCT:
+            n += gbinder_writer_hidl_schema_buffers(f->schema, field);
+            break;
+        case GBINDER_HIDL_FIELD_END:
+            break;
+        }
+    }
+    return n;
+}
+
+/*
+ * Writes the embedded buffers in the same order as HIDL does it, depth
+ * first. Base is the offset of the struct within the parent buffer.
+ */
+static
+void
+gbinder_writer_data_append_hidl_schema_fields(
+    GBinderWriterData* data,
+    const GBinderHidlSchema* schema,
+    const guint8* ptr,
+    guint index,
+    gsize base)
+{
+    const GBinderHidlField* f;
+
+    for (f = schema->fields; f && f->type != GBINDER_HIDL_FIELD_END; f++) {
+        const guint8* field = ptr + f->offset;
+        GBinderParent parent;
+
+        parent.index = index;
+        switch (f->type) {
+        case GBINDER_HIDL_FIELD_STRING:
+            {
+                const GBinderHidlString* str = (const GBinderHidlString*)
+                    field;
+
+                parent.offset = base + f->offset +
+                    GBINDER_HIDL_STRING_BUFFER_OFFSET;
+                gbinder_writer_data_append_buffer_object(data, str->data.str,
+                    str->data.str ? (str->len + 1) : 0, &parent);
+            }
+            break;
+        case GBINDER_HIDL_FIELD_VEC:
+            {
+                const GBinderHidlSchema* es = f->schema;
+                const GBinderHidlVec* vec = (const GBinderHidlVec*)field;
+                const guint8* elem = vec->data.ptr;
+                guint vec_index;
+
+                parent.offset = base + f->offset +
+                    GBINDER_HIDL_VEC_BUFFER_OFFSET;
+                vec_index = gbinder_writer_data_append_buffer_object(data,
+                    elem, elem ? (vec->count * es->size) : 0, &parent);
+                if (elem && es->fields) {
+                    guint i;
+
+                    for (i = 0; i < vec->count; i++) {
+                        gbinder_writer_data_append_hidl_schema_fields(data,
+                            es, elem + i * es->size, vec_index, i * es->size);
+                    }
+                }
+            }
+            break;
+        case GBINDER_HIDL_FIELD_STRUCT:
+            gbinder_writer_data_append_hidl_schema_fields(data, f->schema,
+                field, index, base + f->offset);
+            break;
+        case GBINDER_HIDL_FIELD_END:
+            break;
+        }
+    }
+}
+
+void
+gbinder_writer_append_hidl_schema(
+    GBinderWriter* self,
+    const GBinderHidlSchema* schema,
+    const void* ptr) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data) && G_LIKELY(schema) && G_LIKELY(ptr)) {
+        guint index;
+
+        /* Everything gets allocated at once */
+        gbinder_writer_data_reserve(data, 0, 0, 1 +
+            gbinder_writer_hidl_schema_buffers(schema, ptr));
+        index = gbinder_writer_data_append_buffer_object(data, ptr,
+            schema->size, NULL);
+        gbinder_writer_data_append_hidl_schema_fields(data, schema, ptr,
+            index, 0);
+    }
+}
+
 void
 gbinder_writer_append_local_object(
     GBinderWriter* self,
@@ -1012,7 +1766,8 @@ gbinder_writer_data_append_local_object(
     /* Preallocate enough space */
     g_byte_array_set_size(buf, offset + GBINDER_MAX_BINDER_OBJECT_SIZE);
     /* Write the object */
-    n = data->io->encode_local_object(buf->data + offset, obj);
+    n = GBINDER_IO_CALL(data->io, encode_local_object)
+        (buf->data + offset, obj);
     /* Fix the data size */
     g_byte_array_set_size(buf, offset + n);
     /* Record the offset */
@@ -1061,6 +1816,163 @@ gbinder_writer_append_byte_array(
     }
 }
 
+void
+gbinder_writer_blob_set_limit(
+    int limit)
+{
+    g_atomic_int_set(&gbinder_writer_blob_limit, MAX(limit, 0));
+}
+
+static
+gsize
+gbinder_writer_blob_inplace_limit(
+    void)
+{
+    int limit = g_atomic_int_get(&gbinder_writer_blob_limit);
+
+    if (limit < 0) {
+        limit = MAX(gbinder_config_get_device_int
+            (GBINDER_CONFIG_GROUP_BLOB_INPLACE_LIMIT, NULL,
+                GBINDER_BLOB_INPLACE_LIMIT), 0);
+        g_atomic_int_set(&gbinder_writer_blob_limit, limit);
+    }
+    return limit;
+}
+
+static
+int
+gbinder_writer_blob_fd(
+    const void* blob,
+    gsize size)
+{
+#if GBINDER_FMQ_SUPPORTED
+    const int fd = syscall(__NR_memfd_create, "Blob", MFD_CLOEXEC |
+        MFD_ALLOW_SEALING);
+
+    if (fd >= 0) {
+        if (ftruncate(fd, size) == 0) {
+            void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+
+            if (ptr != MAP_FAILED) {
+                memcpy(ptr, blob, size);
+                munmap(ptr, size);
+
+                /* F_SEAL_WRITE fails if there are writable mappings */
+                if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+                    F_SEAL_WRITE | F_SEAL_SEAL) == 0) {
+                    return fd;
+                }
+            }
+        }
+        GDEBUG("Failed to create %u byte blob: %s", (guint)size,
+            strerror(errno));
+        close(fd);
+    }
+#endif
+    return -1;
+}
+
+void
+gbinder_writer_append_blob(
+    GBinderWriter* self,
+    const void* blob,
+    gsize size) /* Since 1.1.25 */
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    if (G_LIKELY(data)) {
+        const int fd = (blob && size > gbinder_writer_blob_inplace_limit()) ?
+            gbinder_writer_blob_fd(blob, size) : -1;
+
+        if (fd >= 0) {
+            /* The data owns the descriptor from now on */
+            gbinder_writer_data_append_int32(data,
+                GBINDER_BLOB_ASHMEM_IMMUTABLE);
+            gbinder_writer_data_adopt_fd(data, fd);
+        } else {
+            /* Small blobs (and the ones we failed to share) go in place */
+            GByteArray* buf = data->bytes;
+            const gsize padded = G_ALIGN4(size);
+            guint8* ptr;
+
+            gbinder_writer_data_append_int32(data, GBINDER_BLOB_INPLACE);
+            g_byte_array_set_size(buf, buf->len + padded);
+            ptr = buf->data + (buf->len - padded);
+            if (size) {
+                if (blob) {
+                    memcpy(ptr, blob, size);
+                } else {
+                    memset(ptr, 0, size);
+                }
+            }
+            memset(ptr + size, 0, padded - size);
+        }
+    }
+}
+
+static
+void
+gbinder_writer_append_array(
+    GBinderWriter* self,
+    const void* values,
+    gsize count,
+    gsize elem_size)
+{
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    GASSERT(count <= G_MAXINT32);
+    if (G_LIKELY(data) && G_LIKELY(count <= G_MAXINT32)) {
+        GByteArray* buf = data->bytes;
+        const gsize size = values ? (count * elem_size) : 0;
+        guint8* ptr;
+
+        /* Count (-1 for NULL) followed by the values */
+        g_byte_array_set_size(buf, buf->len + sizeof(gint32) + size);
+        ptr = buf->data + (buf->len - sizeof(gint32) - size);
+        *((gint32*)ptr) = values ? (gint32)count : -1;
+        if (size) {
+            memcpy(ptr + sizeof(gint32), values, size);
+        }
+    }
+}
+
+void
+gbinder_writer_append_int32_array(
+    GBinderWriter* self,
+    const gint32* values,
+    gsize count) /* since 1.1.25 */
+{
+    gbinder_writer_append_array(self, values, count, sizeof(*values));
+}
+
+void
+gbinder_writer_append_int64_array(
+    GBinderWriter* self,
+    const gint64* values,
+    gsize count) /* since 1.1.25 */
+{
+    gbinder_writer_append_array(self, values, count, sizeof(*values));
+}
+
+void
+gbinder_writer_append_float_array(
+    GBinderWriter* self,
+    const gfloat* values,
+    gsize count) /* since 1.1.25 */
+{
+    gbinder_writer_append_array(self, values, count, sizeof(*values));
+}
+
+void
+gbinder_writer_append_double_array(
+    GBinderWriter* self,
+    const gdouble* values,
+    gsize count) /* since 1.1.25 */
+{
+    gbinder_writer_append_array(self, values, count, sizeof(*values));
+}
+
 #if GBINDER_FMQ_SUPPORTED
 
 static
@@ -1134,38 +2046,22 @@ gbinder_writer_data_append_remote_object(
     /* Preallocate enough space */
     g_byte_array_set_size(buf, offset + GBINDER_MAX_BINDER_OBJECT_SIZE);
     /* Write the object */
-    n = data->io->encode_remote_object(buf->data + offset, obj);
+    n = GBINDER_IO_CALL(data->io, encode_remote_object)
+        (buf->data + offset, obj);
     /* Fix the data size */
     g_byte_array_set_size(buf, offset + n);
     /* Record the offset */
     gbinder_writer_data_record_offset(data, offset);
 }
 
-static
-void*
-gbinder_writer_alloc(
-    GBinderWriter* self,
-    gsize size,
-    gpointer (*alloc)(gsize),
-    void (*dealloc)())
-{
-    GBinderWriterData* data = gbinder_writer_data(self);
-
-    if (G_LIKELY(data)) {
-        void* ptr = alloc(size);
-
-        data->cleanup = gbinder_cleanup_add(data->cleanup, dealloc, ptr);
-        return ptr;
-    }
-    return NULL;
-}
-
 void*
 gbinder_writer_malloc(
     GBinderWriter* self,
     gsize size) /* since 1.0.19 */
 {
-    return gbinder_writer_alloc(self, size, g_malloc, g_free);
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    return G_LIKELY(data) ? gbinder_writer_data_alloc(data, size) : NULL;
 }
 
 void*
@@ -1173,7 +2069,9 @@ gbinder_writer_malloc0(
     GBinderWriter* self,
     gsize size) /* since 1.0.19 */
 {
-    return gbinder_writer_alloc(self, size, g_malloc0, g_free);
+    GBinderWriterData* data = gbinder_writer_data(self);
+
+    return G_LIKELY(data) ? gbinder_writer_data_alloc0(data, size) : NULL;
 }
 
 char*
@@ -1190,15 +2088,9 @@ gbinder_writer_memdup(
     const void* buf,
     gsize size) /* since 1.0.19 */
 {
-    if (buf) {
-        void* ptr = gbinder_writer_malloc(self, size);
+    GBinderWriterData* data = gbinder_writer_data(self);
 
-        if (ptr) {
-            memcpy(ptr, buf, size);
-            return ptr;
-        }
-    }
-    return NULL;
+    return G_LIKELY(data) ? gbinder_writer_data_memdup(data, buf, size) : NULL;
 }
 
 void
@@ -37,12 +37,15 @@
 
 #include "gbinder_cleanup.h"
 
+typedef struct gbinder_writer_chunk GBinderWriterChunk;
+
 typedef struct gbinder_writer_data {
     const GBinderIo* io;
     GByteArray* bytes;
     GUtilIntArray* offsets;
     gsize buffers_size;
     GBinderCleanup* cleanup;
+    GBinderWriterChunk* chunks;
 } GBinderWriterData;
 
 void
@@ -51,6 +54,54 @@ gbinder_writer_init(
     GBinderWriterData* data)
     GBINDER_INTERNAL;
 
+void
+gbinder_writer_data_init(
+    GBinderWriterData* data,
+    const GBinderIo* io)
+    GBINDER_INTERNAL;
+
+void
+gbinder_writer_data_clear(
+    GBinderWriterData* data)
+    GBINDER_INTERNAL;
+
+/* Only used by unit tests */
+void
+gbinder_writer_pool_set_size(
+    int max_size)
+    GBINDER_INTERNAL;
+
+/* And this one too */
+guint
+gbinder_writer_pool_count(
+    void)
+    GBINDER_INTERNAL;
+
+/* As well as this one */
+void
+gbinder_writer_blob_set_limit(
+    int limit)
+    GBINDER_INTERNAL;
+
+void*
+gbinder_writer_data_alloc(
+    GBinderWriterData* data,
+    gsize size)
+    GBINDER_INTERNAL;
+
+void
+gbinder_writer_data_free_chunks(
+    GBinderWriterData* data)
+    GBINDER_INTERNAL;
+
+void
+gbinder_writer_data_reserve(
+    GBinderWriterData* data,
+    gsize size,
+    guint objects,
+    guint buffers)
+    GBINDER_INTERNAL;
+
 void
 gbinder_writer_data_set_contents(
     GBinderWriterData* data,
@@ -151,6 +202,13 @@ gbinder_writer_data_append_hidl_string(
     const char* str)
     GBINDER_INTERNAL;
 
+void
+gbinder_writer_data_append_hidl_string_len(
+    GBinderWriterData* data,
+    const char* str,
+    gsize len)
+    GBINDER_INTERNAL;
+
 void
 gbinder_writer_data_append_hidl_string_vec(
     GBinderWriterData* data,
@@ -176,6 +234,12 @@ gbinder_writer_data_append_fd(
     int fd)
     GBINDER_INTERNAL;
 
+void
+gbinder_writer_data_adopt_fd(
+    GBinderWriterData* data,
+    int fd)
+    GBINDER_INTERNAL;
+
 #endif /* GBINDER_WRITER_PRIVATE_H */
 
 /*
@@ -0,0 +1,826 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gbinder.h>
+
+#include <gutil_log.h>
+
+#include <glib-unix.h>
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define RET_OK          (0)
+#define RET_NOTFOUND    (1)
+#define RET_INVARG      (2)
+#define RET_ERR         (3)
+
+#define DEFAULT_DEVICE      GBINDER_DEFAULT_BINDER
+#define DEFAULT_NAME        "binder-bench"
+#define DEFAULT_ITERATIONS  (10000)
+#define DEFAULT_THREADS     (4)
+#define DEFAULT_SIZES       "0,64,256,1024,4096,16384,65536"
+#define DEFAULT_TESTS       "latency,oneway,parcel,hidl_vec,fd,threads,fmq"
+#define WARMUP_ITERATIONS   (100)
+
+#define BENCH_IFACE     "libgbinder.bench@1.0"
+#define BENCH_PING      (GBINDER_FIRST_CALL_TRANSACTION)
+#define BENCH_ONEWAY    (GBINDER_FIRST_CALL_TRANSACTION + 1)
+#define BENCH_PARCEL    (GBINDER_FIRST_CALL_TRANSACTION + 2)
+#define BENCH_HIDL_VEC  (GBINDER_FIRST_CALL_TRANSACTION + 3)
+#define BENCH_FD        (GBINDER_FIRST_CALL_TRANSACTION + 4)
+
+#define FMQ_ITEM_SIZE   (64)
+#define FMQ_QUEUE_SIZE  (1024)
+#define FMQ_BATCH       (16)
+#define FMQ_NOT_EMPTY   (0x01)
+#define FMQ_NOT_FULL    (0x02)
+#define FMQ_WAIT_MS     (100)
+
+typedef struct app_options {
+    char* dev;
+    char* name;
+    char* sizes;
+    char* tests;
+    gboolean server;
+    int iterations;
+    int threads;
+} AppOptions;
+
+typedef struct app {
+    const AppOptions* opt;
+    GMainLoop* loop;
+    GBinderServiceManager* sm;
+    GBinderLocalObject* obj;
+    GBinderRemoteObject* remote;
+    GBinderClient* client;
+    guint64 oneway_count;
+    int ret;
+} App;
+
+typedef struct bench_samples {
+    gint64* ns;
+    guint count;
+    guint errors;
+} BenchSamples;
+
+typedef
+GBinderLocalRequest*
+(*BenchRequestFunc)(
+    GBinderClient* client,
+    guint32 code,
+    const void* payload,
+    gsize size);
+
+typedef struct bench_thread {
+    App* app;
+    GThread* thread;
+    BenchSamples samples;
+} BenchThread;
+
+typedef struct bench_fmq_producer {
+    GBinderFmq* fmq;
+    guint64 items;
+} BenchFmqProducer;
+
+static const char pname[] = "binder-bench";
+
+/*==========================================================================*
+ * Utilities
+ *==========================================================================*/
+
+static
+gint64
+bench_now_ns(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gint64)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static
+int
+bench_compare_ns(
+    const void* a,
+    const void* b)
+{
+    const gint64 t1 = *(const gint64*)a;
+    const gint64 t2 = *(const gint64*)b;
+
+    return (t1 < t2) ? (-1) : (t1 > t2) ? 1 : 0;
+}
+
+static
+void
+bench_samples_init(
+    BenchSamples* samples,
+    guint max)
+{
+    memset(samples, 0, sizeof(*samples));
+    samples->ns = g_new(gint64, max);
+}
+
+static
+void
+bench_samples_clear(
+    BenchSamples* samples)
+{
+    g_free(samples->ns);
+    memset(samples, 0, sizeof(*samples));
+}
+
+static
+double
+bench_percentile_us(
+    const BenchSamples* samples,
+    guint p)
+{
+    /* Samples must be sorted */
+    return samples->count ?
+        samples->ns[(samples->count - 1) * p / 100] / 1000.0 : 0.0;
+}
+
+static
+void
+bench_print_latency(
+    BenchSamples* samples,
+    gint64 elapsed_ns)
+{
+    gint64 total = 0;
+    guint i;
+
+    qsort(samples->ns, samples->count, sizeof(gint64), bench_compare_ns);
+    for (i = 0; i < samples->count; i++) {
+        total += samples->ns[i];
+    }
+    printf("\"calls\":%u,\"errors\":%u,\"min_us\":%.3f,\"mean_us\":%.3f,"
+        "\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f,"
+        "\"calls_per_sec\":%.1f", samples->count, samples->errors,
+        bench_percentile_us(samples, 0), samples->count ?
+        (total / 1000.0 / samples->count) : 0.0,
+        bench_percentile_us(samples, 50), bench_percentile_us(samples, 90),
+        bench_percentile_us(samples, 99), bench_percentile_us(samples, 100),
+        elapsed_ns ? (samples->count * 1e9 / elapsed_ns) : 0.0);
+}
+
+/*==========================================================================*
+ * Server
+ *==========================================================================*/
+
+static
+gboolean
+app_signal(
+    gpointer user_data)
+{
+    App* app = user_data;
+
+    GINFO("Caught signal, shutting down...");
+    g_main_loop_quit(app->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+static
+GBinderLocalReply*
+app_server_reply_size(
+    GBinderLocalObject* obj,
+    gsize size,
+    int* status)
+{
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+
+    gbinder_local_reply_append_int32(reply, (guint32)size);
+    *status = GBINDER_STATUS_OK;
+    return reply;
+}
+
+static
+GBinderLocalReply*
+app_server_reply(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    App* app = user_data;
+    GBinderReader reader;
+    gsize size = 0;
+
+    gbinder_remote_request_init_reader(req, &reader);
+    switch (code) {
+    case BENCH_PING:
+        *status = GBINDER_STATUS_OK;
+        return gbinder_local_object_new_reply(obj);
+    case BENCH_ONEWAY:
+        app->oneway_count++;
+        *status = GBINDER_STATUS_OK;
+        return NULL;
+    case BENCH_PARCEL:
+        gbinder_reader_read_byte_array(&reader, &size);
+        return app_server_reply_size(obj, size, status);
+    case BENCH_HIDL_VEC:
+        {
+            gsize count = 0, elemsize = 0;
+
+            gbinder_reader_read_hidl_vec(&reader, &count, &elemsize);
+            return app_server_reply_size(obj, count * elemsize, status);
+        }
+    case BENCH_FD:
+        gbinder_reader_read_byte_array(&reader, &size);
+        return app_server_reply_size(obj,
+            (gbinder_reader_read_fd(&reader) >= 0) ? size : 0, status);
+    }
+    *status = GBINDER_STATUS_FAILED;
+    return NULL;
+}
+
+static
+void
+app_add_service_done(
+    GBinderServiceManager* sm,
+    int status,
+    void* user_data)
+{
+    App* app = user_data;
+
+    if (status == GBINDER_STATUS_OK) {
+        GINFO("Added \"%s\"", app->opt->name);
+        app->ret = RET_OK;
+    } else {
+        GERR("Failed to add \"%s\" (%d)", app->opt->name, status);
+        g_main_loop_quit(app->loop);
+    }
+}
+
+static
+void
+app_server_run(
+    App* app)
+{
+    guint sigtrm = g_unix_signal_add(SIGTERM, app_signal, app);
+    guint sigint = g_unix_signal_add(SIGINT, app_signal, app);
+
+    app->ret = RET_ERR;
+    app->obj = gbinder_servicemanager_new_local_object(app->sm, BENCH_IFACE,
+        app_server_reply, app);
+    app->loop = g_main_loop_new(NULL, TRUE);
+    gbinder_servicemanager_add_service(app->sm, app->opt->name, app->obj,
+        app_add_service_done, app);
+    g_main_loop_run(app->loop);
+
+    if (sigtrm) g_source_remove(sigtrm);
+    if (sigint) g_source_remove(sigint);
+    g_main_loop_unref(app->loop);
+    app->loop = NULL;
+    GINFO("Handled %" G_GUINT64_FORMAT " one-way calls", app->oneway_count);
+    gbinder_local_object_unref(app->obj);
+    app->obj = NULL;
+}
+
+/*==========================================================================*
+ * Client
+ *==========================================================================*/
+
+static
+GBinderLocalRequest*
+bench_request_parcel(
+    GBinderClient* client,
+    guint32 code,
+    const void* payload,
+    gsize size)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request3(client, code, size);
+    GBinderWriter writer;
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_byte_array(&writer, payload, size);
+    return req;
+}
+
+static
+GBinderLocalRequest*
+bench_request_hidl_vec(
+    GBinderClient* client,
+    guint32 code,
+    const void* payload,
+    gsize size)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, code);
+    GBinderWriter writer;
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_hidl_vec(&writer, payload, size, 1);
+    return req;
+}
+
+static
+GBinderLocalRequest*
+bench_request_fd(
+    GBinderClient* client,
+    guint32 code,
+    const void* payload,
+    gsize size)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request3(client, code, size);
+    GBinderWriter writer;
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_byte_array(&writer, payload, size);
+    gbinder_writer_append_fd(&writer, STDERR_FILENO);
+    return req;
+}
+
+static
+gboolean
+bench_call(
+    GBinderClient* client,
+    guint32 code,
+    GBinderLocalRequest* req,
+    BenchSamples* samples)
+{
+    const gint64 start = bench_now_ns();
+    int status = INT_MAX;
+    GBinderRemoteReply* reply = gbinder_client_transact_sync_reply(client,
+        code, req, &status);
+    const gint64 end = bench_now_ns();
+
+    gbinder_remote_reply_unref(reply);
+    if (samples) {
+        if (status == GBINDER_STATUS_OK) {
+            samples->ns[samples->count++] = end - start;
+        } else {
+            samples->errors++;
+        }
+    }
+    return status == GBINDER_STATUS_OK;
+}
+
+static
+void
+bench_warmup(
+    App* app)
+{
+    int i;
+
+    for (i = 0; i < WARMUP_ITERATIONS; i++) {
+        bench_call(app->client, BENCH_PING, NULL, NULL);
+    }
+}
+
+static
+void
+bench_latency(
+    App* app)
+{
+    const guint n = app->opt->iterations;
+    BenchSamples samples;
+    gint64 start;
+    guint i;
+
+    bench_samples_init(&samples, n);
+    bench_warmup(app);
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        bench_call(app->client, BENCH_PING, NULL, &samples);
+    }
+    printf("{\"test\":\"latency\",");
+    bench_print_latency(&samples, bench_now_ns() - start);
+    printf("}\n");
+    bench_samples_clear(&samples);
+}
+
+static
+void
+bench_oneway(
+    App* app)
+{
+    const guint n = app->opt->iterations;
+    guint i, errors = 0;
+    gint64 start, elapsed;
+
+    bench_warmup(app);
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        if (gbinder_client_transact_sync_oneway(app->client, BENCH_ONEWAY,
+            NULL) != GBINDER_STATUS_OK) {
+            errors++;
+        }
+    }
+
+    /* One-way calls are queued, wait until they all have been handled */
+    bench_call(app->client, BENCH_PING, NULL, NULL);
+    elapsed = bench_now_ns() - start;
+    printf("{\"test\":\"oneway\",\"calls\":%u,\"errors\":%u,"
+        "\"seconds\":%.6f,\"calls_per_sec\":%.1f}\n", n, errors,
+        elapsed / 1e9, n * 1e9 / elapsed);
+}
+
+static
+void
+bench_payload(
+    App* app,
+    const char* name,
+    guint32 code,
+    BenchRequestFunc build)
+{
+    const guint n = app->opt->iterations;
+    char** sizes = g_strsplit(app->opt->sizes, ",", -1);
+    char** ptr;
+
+    bench_warmup(app);
+    for (ptr = sizes; *ptr; ptr++) {
+        const gsize size = strtoul(*ptr, NULL, 0);
+        guint8* payload = g_malloc0(MAX(size, 1));
+        BenchSamples samples;
+        gint64 start, elapsed;
+        guint i;
+
+        bench_samples_init(&samples, n);
+        start = bench_now_ns();
+        for (i = 0; i < n; i++) {
+            GBinderLocalRequest* req = build(app->client, code, payload, size);
+
+            bench_call(app->client, code, req, &samples);
+            gbinder_local_request_unref(req);
+        }
+        elapsed = bench_now_ns() - start;
+        printf("{\"test\":\"%s\",\"size\":%lu,", name, (gulong)size);
+        bench_print_latency(&samples, elapsed);
+        printf(",\"mb_per_sec\":%.3f}\n", elapsed ?
+            (size * (double)samples.count * 1e3 / elapsed) : 0.0);
+        bench_samples_clear(&samples);
+        g_free(payload);
+    }
+    g_strfreev(sizes);
+}
+
+static
+gpointer
+bench_thread_proc(
+    gpointer user_data)
+{
+    BenchThread* thread = user_data;
+    App* app = thread->app;
+    const guint n = app->opt->iterations;
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        bench_call(app->client, BENCH_PING, NULL, &thread->samples);
+    }
+    return NULL;
+}
+
+static
+void
+bench_threads(
+    App* app)
+{
+    const guint n = app->opt->iterations;
+    const int max = app->opt->threads;
+    int nthreads = 1;
+
+    bench_warmup(app);
+    while (TRUE) {
+        BenchThread* threads = g_new0(BenchThread, nthreads);
+        BenchSamples all;
+        gint64 start, elapsed;
+        int i;
+
+        bench_samples_init(&all, n * nthreads);
+        start = bench_now_ns();
+        for (i = 0; i < nthreads; i++) {
+            BenchThread* thread = threads + i;
+
+            thread->app = app;
+            bench_samples_init(&thread->samples, n);
+            thread->thread = g_thread_new(pname, bench_thread_proc, thread);
+        }
+        for (i = 0; i < nthreads; i++) {
+            BenchThread* thread = threads + i;
+
+            g_thread_join(thread->thread);
+            memcpy(all.ns + all.count, thread->samples.ns,
+                thread->samples.count * sizeof(gint64));
+            all.count += thread->samples.count;
+            all.errors += thread->samples.errors;
+            bench_samples_clear(&thread->samples);
+        }
+        elapsed = bench_now_ns() - start;
+        printf("{\"test\":\"threads\",\"threads\":%d,", nthreads);
+        bench_print_latency(&all, elapsed);
+        printf("}\n");
+        bench_samples_clear(&all);
+        g_free(threads);
+        if (nthreads >= max) {
+            break;
+        }
+        /* Doubling, but make sure that the maximum is measured too */
+        nthreads = MIN(nthreads * 2, max);
+    }
+}
+
+static
+gpointer
+bench_fmq_producer_proc(
+    gpointer user_data)
+{
+    BenchFmqProducer* producer = user_data;
+    GBinderFmq* fmq = producer->fmq;
+    guint8 buf[FMQ_ITEM_SIZE * FMQ_BATCH];
+    guint64 sent = 0;
+
+    memset(buf, 0x55, sizeof(buf));
+    while (sent < producer->items) {
+        const gsize batch = MIN(FMQ_BATCH, producer->items - sent);
+
+        if (gbinder_fmq_write(fmq, buf, batch)) {
+            sent += batch;
+            gbinder_fmq_wake(fmq, FMQ_NOT_EMPTY);
+        } else {
+            guint32 state = 0;
+
+            gbinder_fmq_wait_timeout(fmq, FMQ_NOT_FULL, &state, FMQ_WAIT_MS);
+        }
+    }
+    return NULL;
+}
+
+static
+void
+bench_fmq(
+    App* app)
+{
+    /*
+     * Both ends live in this process: the library can create and send
+     * a queue descriptor but has no API for mapping a received one.
+     * This still covers the shared memory ring and the event flag.
+     */
+    GBinderFmq* fmq = gbinder_fmq_new(FMQ_ITEM_SIZE, FMQ_QUEUE_SIZE,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+
+    if (fmq) {
+        BenchFmqProducer producer;
+        guint8 buf[FMQ_ITEM_SIZE * FMQ_BATCH];
+        guint64 received = 0;
+        gint64 start, elapsed;
+        GThread* thread;
+
+        producer.fmq = fmq;
+        producer.items = ((guint64)app->opt->iterations) * FMQ_BATCH;
+        start = bench_now_ns();
+        thread = g_thread_new(pname, bench_fmq_producer_proc, &producer);
+        while (received < producer.items) {
+            const gsize batch = MIN(MIN(FMQ_BATCH, producer.items - received),
+                gbinder_fmq_available_to_read(fmq));
+
+            if (batch && gbinder_fmq_read(fmq, buf, batch)) {
+                received += batch;
+                gbinder_fmq_wake(fmq, FMQ_NOT_FULL);
+            } else {
+                guint32 state = 0;
+
+                gbinder_fmq_wait_timeout(fmq, FMQ_NOT_EMPTY, &state,
+                    FMQ_WAIT_MS);
+            }
+        }
+        g_thread_join(thread);
+        elapsed = bench_now_ns() - start;
+        printf("{\"test\":\"fmq\",\"item_size\":%d,\"items\":%"
+            G_GUINT64_FORMAT ",\"seconds\":%.6f,\"items_per_sec\":%.1f,"
+            "\"mb_per_sec\":%.3f}\n", FMQ_ITEM_SIZE, received, elapsed / 1e9,
+            received * 1e9 / elapsed,
+            received * FMQ_ITEM_SIZE * 1e3 / elapsed);
+        gbinder_fmq_unref(fmq);
+    } else {
+        GERR("Failed to create FMQ");
+        app->ret = RET_ERR;
+    }
+}
+
+static
+void
+app_client_run(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+    int status = 0;
+
+    app->remote = gbinder_servicemanager_get_service_sync(app->sm, opt->name,
+        &status);
+    if (app->remote) {
+        char** tests = g_strsplit(opt->tests, ",", -1);
+        char** ptr;
+
+        gbinder_remote_object_ref(app->remote);
+        app->client = gbinder_client_new(app->remote, BENCH_IFACE);
+        if (bench_call(app->client, BENCH_PING, NULL, NULL)) {
+            app->ret = RET_OK;
+            for (ptr = tests; *ptr && app->ret == RET_OK; ptr++) {
+                const char* test = *ptr;
+
+                GDEBUG("Running %s", test);
+                if (!strcmp(test, "latency")) {
+                    bench_latency(app);
+                } else if (!strcmp(test, "oneway")) {
+                    bench_oneway(app);
+                } else if (!strcmp(test, "parcel")) {
+                    bench_payload(app, test, BENCH_PARCEL,
+                        bench_request_parcel);
+                } else if (!strcmp(test, "hidl_vec")) {
+                    bench_payload(app, test, BENCH_HIDL_VEC,
+                        bench_request_hidl_vec);
+                } else if (!strcmp(test, "fd")) {
+                    bench_payload(app, test, BENCH_FD, bench_request_fd);
+                } else if (!strcmp(test, "threads")) {
+                    bench_threads(app);
+                } else if (!strcmp(test, "fmq")) {
+                    bench_fmq(app);
+                } else {
+                    GERR("Unknown test \"%s\"", test);
+                    app->ret = RET_INVARG;
+                }
+                fflush(stdout);
+            }
+        } else {
+            GERR("%s doesn't respond", opt->name);
+            app->ret = RET_ERR;
+        }
+        g_strfreev(tests);
+        gbinder_client_unref(app->client);
+        gbinder_remote_object_unref(app->remote);
+        app->client = NULL;
+        app->remote = NULL;
+    } else {
+        GERR("%s not found", opt->name);
+        app->ret = RET_NOTFOUND;
+    }
+}
+
+/*==========================================================================*
+ * Options
+ *==========================================================================*/
+
+static
+gboolean
+app_log_verbose(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_VERBOSE;
+    return TRUE;
+}
+
+static
+gboolean
+app_log_quiet(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_ERR;
+    return TRUE;
+}
+
+static
+gboolean
+app_init(
+    AppOptions* opt,
+    int argc,
+    char* argv[])
+{
+    gboolean ok = FALSE;
+    GOptionEntry entries[] = {
+        { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_verbose, "Enable verbose output", NULL },
+        { "quiet", 'q', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_quiet, "Be quiet", NULL },
+        { "device", 'd', 0, G_OPTION_ARG_STRING, &opt->dev,
+          "Binder device [" DEFAULT_DEVICE "]", "DEVICE" },
+        { "server", 's', 0, G_OPTION_ARG_NONE, &opt->server,
+          "Run the companion service", NULL },
+        { "iterations", 'n', 0, G_OPTION_ARG_INT, &opt->iterations,
+          "Calls per measurement [" G_STRINGIFY(DEFAULT_ITERATIONS) "]",
+          "COUNT" },
+        { "threads", 't', 0, G_OPTION_ARG_INT, &opt->threads,
+          "Maximum number of client threads [" G_STRINGIFY(DEFAULT_THREADS)
+          "]", "COUNT" },
+        { "sizes", 'S', 0, G_OPTION_ARG_STRING, &opt->sizes,
+          "Payload sizes [" DEFAULT_SIZES "]", "LIST" },
+        { "tests", 'T', 0, G_OPTION_ARG_STRING, &opt->tests,
+          "Tests to run [" DEFAULT_TESTS "]", "LIST" },
+        { NULL }
+    };
+
+    GError* error = NULL;
+    GOptionContext* options = g_option_context_new("[NAME]");
+
+    memset(opt, 0, sizeof(*opt));
+    opt->iterations = DEFAULT_ITERATIONS;
+    opt->threads = DEFAULT_THREADS;
+
+    gutil_log_timestamp = FALSE;
+    gutil_log_set_type(GLOG_TYPE_STDERR, pname);
+    gutil_log_default.level = GLOG_LEVEL_DEFAULT;
+
+    g_option_context_set_summary(options, "Runs the companion service "
+        "(with -s) or the benchmarks against it. Results are printed to\n"
+        "stdout as JSON objects, one per line.");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        if (!opt->dev || !opt->dev[0]) {
+            g_free(opt->dev);
+            opt->dev = g_strdup(DEFAULT_DEVICE);
+        }
+        if (!opt->sizes) opt->sizes = g_strdup(DEFAULT_SIZES);
+        if (!opt->tests) opt->tests = g_strdup(DEFAULT_TESTS);
+        if (opt->iterations > 0 && opt->threads > 0 && argc <= 2) {
+            opt->name = g_strdup((argc == 2) ? argv[1] : DEFAULT_NAME);
+            ok = TRUE;
+        } else {
+            char* help = g_option_context_get_help(options, TRUE, NULL);
+
+            fprintf(stderr, "%s", help);
+            g_free(help);
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    App app;
+    AppOptions opt;
+
+    memset(&app, 0, sizeof(app));
+    app.ret = RET_INVARG;
+    app.opt = &opt;
+    if (app_init(&opt, argc, argv)) {
+        app.sm = gbinder_servicemanager_new(opt.dev);
+        if (gbinder_servicemanager_wait(app.sm, -1)) {
+            if (opt.server) {
+                app_server_run(&app);
+            } else {
+                app_client_run(&app);
+            }
+        } else {
+            GERR("No servicemanager at %s", opt.dev);
+            app.ret = RET_NOTFOUND;
+        }
+        gbinder_servicemanager_unref(app.sm);
+    }
+    g_free(opt.dev);
+    g_free(opt.name);
+    g_free(opt.sizes);
+    g_free(opt.tests);
+    return app.ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -40,10 +40,15 @@
 #define RET_NODEV   (1)
 #define RET_INVARG  (2)
 
+/* Polled by binder-dump --top */
+#define STATS_IFACE "libgbinder.stats@1.0"
+#define STATS_DUMP  (GBINDER_FIRST_CALL_TRANSACTION)
+
 typedef struct app_options {
     const char* src;
     const char* dest;
     char* src_name;
+    char* stats_name;
     const char* dest_name;
     const char** ifaces;
 } AppOptions;
@@ -58,6 +63,56 @@ app_signal(
     return G_SOURCE_CONTINUE;
 }
 
+static
+GBinderLocalReply*
+app_stats_reply(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    if (code == STATS_DUMP) {
+        GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+        GBinderReader reader;
+        gint32 sampling = 0;
+        char* dump;
+
+        /* Zero leaves the sampling interval unchanged */
+        gbinder_remote_request_init_reader(req, &reader);
+        if (gbinder_reader_read_int32(&reader, &sampling) && sampling > 0) {
+            gbinder_stats_set_sampling(sampling);
+        }
+        dump = gbinder_stats_dump();
+        gbinder_local_reply_append_string8(reply, dump);
+        g_free(dump);
+        *status = GBINDER_STATUS_OK;
+        return reply;
+    }
+    *status = GBINDER_STATUS_FAILED;
+    return NULL;
+}
+
+static
+GBinderLocalObject*
+app_stats_new(
+    const AppOptions* opt,
+    GBinderServiceManager* sm)
+{
+    GBinderLocalObject* obj = gbinder_servicemanager_new_local_object(sm,
+        STATS_IFACE, app_stats_reply, NULL);
+
+    if (gbinder_servicemanager_add_service_sync(sm, opt->stats_name, obj) ==
+        GBINDER_STATUS_OK) {
+        GINFO("Statistics are available as \"%s\"", opt->stats_name);
+        gbinder_stats_set_enabled(TRUE);
+    } else {
+        GERR("Failed to add \"%s\"", opt->stats_name);
+    }
+    return obj;
+}
+
 static
 int
 app_run(
@@ -75,6 +130,8 @@ app_run(
             guint sigint = g_unix_signal_add(SIGINT, app_signal, loop);
             GBinderBridge* bridge = gbinder_bridge_new2
                 (opt->src_name, opt->dest_name, opt->ifaces, src, dest);
+            GBinderLocalObject* stats = opt->stats_name ?
+                app_stats_new(opt, src) : NULL;
 
             g_main_loop_run(loop);
 
@@ -82,6 +139,7 @@ app_run(
             if (sigint) g_source_remove(sigint);
             g_main_loop_unref(loop);
             gbinder_bridge_free(bridge);
+            gbinder_local_object_drop(stats);
             gbinder_servicemanager_unref(dest);
             ret = RET_OK;
         } else {
@@ -129,6 +187,8 @@ app_init(
     GOptionEntry entries[] = {
         { "source", 's', 0, G_OPTION_ARG_STRING, &opt->src_name,
           "Register a different name on source", "NAME" },
+        { "stats", 'S', 0, G_OPTION_ARG_STRING, &opt->stats_name,
+          "Collect statistics and register them on source", "NAME" },
         { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
           app_log_verbose, "Enable verbose output", NULL },
         { "quiet", 'q', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
@@ -183,6 +243,7 @@ int main(int argc, char* argv[])
         ret = app_run(&opt);
     }
     g_free(opt.src_name);
+    g_free(opt.stats_name);
     g_free(opt.ifaces);
     return ret;
 }
@@ -36,6 +36,7 @@
 #include <unistd.h>
 #include <binder-call.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define RET_OK          (0)
 #define RET_NOTFOUND    (1)
@@ -574,32 +575,25 @@ free_ast(
 }
 
 static
-void
-app_run(
-    App* app)
+GBinderClient*
+app_client_new(
+    App* app,
+    const char* service)
 {
     const AppOptions* opt = app->opt;
     char* iface = opt->iface ? g_strdup(opt->iface) : NULL;
     int status = 0;
-    int rargc = 1;
-    char* service = opt->argv[rargc++];
-    int code = atoi(opt->argv[rargc++]);
     GBinderClient* client;
     GBinderLocalRequest* req;
     GBinderRemoteReply* reply;
     GBinderRemoteObject* obj;
 
-    if (!code) {
-        GERR("Transaction code must be > GBINDER_FIRST_CALL_TRANSACTION(=1).");
-        return;
-    }
-
     obj = gbinder_servicemanager_get_service_sync(app->sm,
         service, &status);
     if (!obj) {
         GERR("No such service: %s", service);
         g_free(iface);
-        return;
+        return NULL;
     }
 
     if (strstr(service, "/") != NULL) {
@@ -620,37 +614,70 @@ app_run(
 
     if (!iface) {
         GERR("Failed to get interface");
-        return;
+        return NULL;
     }
 
     GDEBUG("Got iface: %s", iface);
 
     client = gbinder_client_new(obj, iface);
     g_free(iface);
+    return client;
+}
 
-    req = gbinder_client_new_request(client);
+/* Parses argv[first..argc-1] and builds the request */
+static
+GBinderLocalRequest*
+app_parse(
+    App* app,
+    GBinderClient* client,
+    int argc,
+    char** argv,
+    int first,
+    struct transaction_and_reply** tree)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request(client);
 
-    app->rargc = rargc;
-    app->code = code;
+    ast = NULL;
+    app->argc = argc;
+    app->argv = argv;
+    app->rargc = first;
 
     cmdline_parse(app);
 
     gbinder_local_request_init_writer(req, &app->writer);
     go_through_ast(app, ast, TRUE);
+    *tree = ast;
+    ast = NULL;
+    return req;
+}
+
+static
+int
+app_transact(
+    App* app,
+    GBinderClient* client,
+    int code,
+    GBinderLocalRequest* req,
+    struct transaction_and_reply* tree,
+    gboolean print)
+{
+    const AppOptions* opt = app->opt;
+    GBinderRemoteReply* reply;
+    int status = 0;
 
     if (opt->oneway) {
-        gbinder_client_transact_sync_oneway(client, code, req);
+        status = gbinder_client_transact_sync_oneway(client, code, req);
         reply = NULL;
     } else {
         reply = gbinder_client_transact_sync_reply(client, code, req, &status);
     }
 
-    gbinder_local_request_unref(req);
-
-    if (!reply) {
+    if (!print) {
+        gbinder_remote_reply_unref(reply);
+    } else if (!reply) {
         printf("NO REPLY\n");
     } else {
-        if (ast && !ast->tree_reply) {
+        if (tree && !tree->tree_reply) {
             guchar b;
 
             gbinder_remote_reply_init_reader(reply, &app->reader);
@@ -661,14 +688,276 @@ app_run(
             printf("\n");
         } else {
             gbinder_remote_reply_init_reader(reply, &app->reader);
-            go_through_ast(app, ast, FALSE);
+            go_through_ast(app, tree, FALSE);
         }
         gbinder_remote_reply_unref(reply);
     }
+    return status;
+}
+
+static
+void
+app_run(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+    int rargc = 1;
+    char* service = opt->argv[rargc++];
+    int code = atoi(opt->argv[rargc++]);
+    GBinderClient* client;
+    GBinderLocalRequest* req;
+    struct transaction_and_reply* tree;
+
+    if (!code) {
+        GERR("Transaction code must be > GBINDER_FIRST_CALL_TRANSACTION(=1).");
+        return;
+    }
+
+    client = app_client_new(app, service);
+    if (!client) {
+        return;
+    }
+
+    app->code = code;
+    req = app_parse(app, client, opt->argc, opt->argv, rargc, &tree);
+    app_transact(app, client, code, req, tree, TRUE);
+    gbinder_local_request_unref(req);
     gbinder_client_unref(client);
-    free_ast(ast);
+    free_ast(tree);
+}
+
+/*==========================================================================*
+ * Batch mode
+ *==========================================================================*/
+
+typedef struct app_batch_call {
+    guint line;
+    int code;
+    GBinderLocalRequest* req;
+    struct transaction_and_reply* tree;
+} AppBatchCall;
+
+typedef struct app_batch {
+    App* app;
+    GBinderClient* client;
+    GPtrArray* calls;
+    gint calls_done;
+    gint errors;
+    gint64 total_usec;
+    GMutex mutex;
+} AppBatch;
+
+typedef struct app_batch_thread {
+    AppBatch* batch;
+    GThread* thread;
+    int index;
+} AppBatchThread;
+
+static
+void
+app_batch_call_free(
+    gpointer data)
+{
+    AppBatchCall* call = data;
+
+    gbinder_local_request_unref(call->req);
+    free_ast(call->tree);
+    g_free(call);
+}
+
+/*
+ * Splits the line at spaces like the shell would, except that quotes
+ * are preserved because they are part of the value syntax.
+ */
+static
+char**
+app_batch_split(
+    const char* line,
+    int* count)
+{
+    GPtrArray* args = g_ptr_array_new();
+    const char* ptr = line;
+
+    while (*ptr) {
+        const char* start;
+        gboolean quoted = FALSE;
+
+        while (g_ascii_isspace(*ptr)) ptr++;
+        if (!*ptr || *ptr == '#') break;
+        start = ptr;
+        while (*ptr && (quoted || !g_ascii_isspace(*ptr))) {
+            if (*ptr == '"') quoted = !quoted;
+            ptr++;
+        }
+        g_ptr_array_add(args, g_strndup(start, ptr - start));
+    }
+    *count = args->len;
+    g_ptr_array_add(args, NULL);
+    return (char**)g_ptr_array_free(args, FALSE);
+}
+
+static
+GPtrArray*
+app_batch_load(
+    App* app,
+    GBinderClient* client,
+    const char* script)
+{
+    GPtrArray* calls = g_ptr_array_new_with_free_func(app_batch_call_free);
+    GError* error = NULL;
+    GIOChannel* in = strcmp(script, "-") ?
+        g_io_channel_new_file(script, "r", &error) :
+        g_io_channel_unix_new(STDIN_FILENO);
+    char* line = NULL;
+    guint lineno = 0;
+
+    if (!in) {
+        GERR("%s", error->message);
+        g_error_free(error);
+        g_ptr_array_free(calls, TRUE);
+        return NULL;
+    }
+
+    while (g_io_channel_read_line(in, &line, NULL, NULL, NULL) ==
+        G_IO_STATUS_NORMAL) {
+        int argc;
+        char** argv = app_batch_split(line, &argc);
+
+        lineno++;
+        if (argc > 0) {
+            AppBatchCall* call = g_new0(AppBatchCall, 1);
+
+            call->line = lineno;
+            call->code = atoi(argv[0]);
+            if (call->code) {
+                /* The parser wants to start after the code */
+                app->code = call->code;
+                call->req = app_parse(app, client, argc, argv, 1,
+                    &call->tree);
+                g_ptr_array_add(calls, call);
+            } else {
+                GERR("%s:%u: transaction code must be >= 1", script, lineno);
+                g_free(call);
+            }
+        }
+        g_strfreev(argv);
+        g_free(line);
+        line = NULL;
+    }
+    g_io_channel_unref(in);
+    return calls;
+}
+
+static
+gpointer
+app_batch_run(
+    gpointer user_data)
+{
+    AppBatchThread* thread = user_data;
+    AppBatch* batch = thread->batch;
+    App* app = batch->app;
+    const AppOptions* opt = app->opt;
+    /* Replies are only decoded by a single thread */
+    const gboolean print = (opt->threads == 1 && !opt->timing);
+    int r;
+    guint i, errors = 0, done = 0;
+    gint64 total = 0;
+
+    for (r = 0; r < opt->repeat; r++) {
+        for (i = 0; i < batch->calls->len; i++) {
+            const AppBatchCall* call = g_ptr_array_index(batch->calls, i);
+            const gint64 start = g_get_monotonic_time();
+            const int status = app_transact(app, batch->client, call->code,
+                call->req, call->tree, print);
+            const gint64 usec = g_get_monotonic_time() - start;
+
+            if (opt->timing) {
+                printf("%d %u %d %d %" G_GINT64_FORMAT "\n", thread->index,
+                    call->line, call->code, status, usec);
+            }
+            if (status != GBINDER_STATUS_OK) {
+                errors++;
+            }
+            total += usec;
+            done++;
+        }
+    }
+
+    /* Lock */
+    g_mutex_lock(&batch->mutex);
+    batch->calls_done += done;
+    batch->errors += errors;
+    batch->total_usec += total;
+    g_mutex_unlock(&batch->mutex);
+    /* Unlock */
+    return NULL;
 }
 
+static
+void
+app_batch(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+    AppBatch batch;
+    AppBatchThread* threads;
+    gint64 start, elapsed;
+    int i;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.app = app;
+    batch.client = app_client_new(app, opt->argv[1]);
+    if (!batch.client) {
+        app->ret = RET_NOTFOUND;
+        return;
+    }
+
+    batch.calls = app_batch_load(app, batch.client, opt->script);
+    if (!batch.calls) {
+        gbinder_client_unref(batch.client);
+        return;
+    }
+
+    g_mutex_init(&batch.mutex);
+    threads = g_new0(AppBatchThread, opt->threads);
+    start = g_get_monotonic_time();
+    if (opt->timing) {
+        printf("# THREAD LINE CODE STATUS USEC\n");
+    }
+    for (i = 0; i < opt->threads; i++) {
+        AppBatchThread* thread = threads + i;
+
+        thread->batch = &batch;
+        thread->index = i;
+        if (opt->threads > 1) {
+            thread->thread = g_thread_new(pname, app_batch_run, thread);
+        } else {
+            app_batch_run(thread);
+        }
+    }
+    for (i = 0; i < opt->threads; i++) {
+        if (threads[i].thread) {
+            g_thread_join(threads[i].thread);
+        }
+    }
+    elapsed = g_get_monotonic_time() - start;
+
+    GINFO("%d calls, %d errors, %.1f calls/sec, %.1f us/call",
+        batch.calls_done, batch.errors, elapsed ?
+        (batch.calls_done * 1e6 / elapsed) : 0.0, batch.calls_done ?
+        ((double)batch.total_usec / batch.calls_done) : 0.0);
+    app->ret = batch.errors ? RET_ERR : RET_OK;
+
+    g_free(threads);
+    g_mutex_clear(&batch.mutex);
+    g_ptr_array_free(batch.calls, TRUE);
+    gbinder_client_unref(batch.client);
+}
+
+/*==========================================================================*
+ * Options
+ *==========================================================================*/
+
 static
 gboolean
 app_log_verbose(
@@ -713,6 +1002,14 @@ app_init(
           "Use a oneway transaction", NULL },
         { "aidl", 'a', 0, G_OPTION_ARG_NONE, &opt->aidl,
           "Treat types as aidl types (default: hidl)", NULL },
+        { "script", 's', 0, G_OPTION_ARG_FILENAME, &opt->script,
+          "Read calls from FILE, one per line (- for stdin)", "FILE" },
+        { "repeat", 'r', 0, G_OPTION_ARG_INT, &opt->repeat,
+          "Run the script COUNT times [1]", "COUNT" },
+        { "threads", 't', 0, G_OPTION_ARG_INT, &opt->threads,
+          "Run the script on COUNT threads at once [1]", "COUNT" },
+        { "timing", 'T', 0, G_OPTION_ARG_NONE, &opt->timing,
+          "Print the time taken by each call", NULL },
         { NULL }
     };
 
@@ -753,11 +1050,20 @@ app_init(
     "\t all of the types can be any of the possible types decribed here.\n\n"
     "The following example calls getSensorsList method on \"android.hardware.sensors@1.0::ISensors/default\"\n"
     "service:\n\n"
-    "\tbinder-call -d /dev/hwbinder android.hardware.sensors@1.0::ISensors/default 1 reply i32 \"[ { i32 i32 hstr hstr i32 i32 hstr f f f i32 i32 i32 hstr i32 i32 } ]\"\n");
+    "\tbinder-call -d /dev/hwbinder android.hardware.sensors@1.0::ISensors/default 1 reply i32 \"[ { i32 i32 hstr hstr i32 i32 hstr f f f i32 i32 i32 hstr i32 i32 } ]\"\n\n"
+    "With --script, only NAME is given on the command line. Each line of the\n"
+    "script contains CODE followed by the arguments and the reply structure,\n"
+    "as described above. Empty lines and lines starting with # are ignored.\n"
+    "All calls are made over the same connection, which makes it possible to\n"
+    "use binder-call as a simple load generator together with --repeat and\n"
+    "--threads. Replies are only printed when running on a single thread\n"
+    "without --timing.\n");
 
     g_option_context_add_main_entries(options, entries, NULL);
 
     memset(opt, 0, sizeof(*opt));
+    opt->repeat = 1;
+    opt->threads = 1;
 
     gutil_log_timestamp = FALSE;
     gutil_log_set_type(GLOG_TYPE_STDERR, pname);
@@ -766,7 +1072,8 @@ app_init(
     if (g_option_context_parse(options, &argc, &argv, &error)) {
         char* help;
 
-        if (argc > 2) {
+        if ((opt->script ? (argc == 2) : (argc > 2)) &&
+            opt->repeat > 0 && opt->threads > 0) {
             opt->argc = argc;
             opt->argv = argv;
             ok = TRUE;
@@ -794,7 +1101,11 @@ int main(int argc, char* argv[])
     if (app_init(&opt, argc, argv)) {
         app.sm = gbinder_servicemanager_new(opt.dev);
         if (app.sm) {
-            app_run(&app);
+            if (opt.script) {
+                app_batch(&app);
+            } else {
+                app_run(&app);
+            }
             gbinder_servicemanager_unref(app.sm);
         } else {
             GERR("servicemanager seems to be missing");
@@ -802,6 +1113,7 @@ int main(int argc, char* argv[])
     }
     g_free(opt.iface);
     g_free(opt.dev);
+    g_free(opt.script);
     return app.ret;
 }
 
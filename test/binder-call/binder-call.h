@@ -40,6 +40,10 @@ typedef struct app_options {
     gboolean oneway;
     gboolean aidl;
     gint transaction;
+    char* script;
+    int repeat;
+    int threads;
+    gboolean timing;
     int argc;
     char** argv;
 } AppOptions;
@@ -51,6 +55,8 @@ typedef struct app {
     GBinderWriter writer;
     GBinderReader reader;
     int code;
+    int argc;   /* What the parser is looking at */
+    char** argv;
     int rargc;
     int ret;
 } App;
@@ -394,6 +394,6 @@ struct transaction_and_reply* make_transaction_and_reply(GList* transaction, GLi
 
 void cmdlineerror(App* app, char const* s)
 {
-    fprintf(stderr, "@%d %s: %s\n", app->rargc - 1, s, app->opt->argv[app->rargc - 1]);
+    fprintf(stderr, "@%d %s: %s\n", app->rargc - 1, s, app->argv[app->rargc - 1]);
 }
 
@@ -34,6 +34,8 @@
 
 #include <gutil_log.h>
 
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define RET_OK          (0)
@@ -46,9 +48,22 @@
 #define GBINDER_TRANSACTION(c2,c3,c4)     GBINDER_FOURCC('_',c2,c3,c4)
 #define GBINDER_DUMP_TRANSACTION          GBINDER_TRANSACTION('D','M','P')
 
+/* Exported by binder-bridge --stats */
+#define STATS_IFACE     "libgbinder.stats@1.0"
+#define STATS_DUMP      (GBINDER_FIRST_CALL_TRANSACTION)
+
+#define TOP_DEFAULT_INTERVAL    (1)
+#define TOP_DEFAULT_ORDER       "calls"
+#define TOP_KEY_SIZE            (256)
+
 typedef struct app_options {
     char* dev;
     const char* service;
+    gboolean top;
+    char* order;
+    int interval;
+    int count;
+    int sampling;
 } AppOptions;
 
 typedef struct app {
@@ -58,6 +73,30 @@ typedef struct app {
     int ret;
 } App;
 
+typedef struct app_top_entry {
+    char dir[8];
+    char dev[TOP_KEY_SIZE];
+    char iface[TOP_KEY_SIZE];
+    guint code;
+    GBinderStatsEntry cur;
+    GBinderStatsEntry prev;
+} AppTopEntry;
+
+typedef struct app_top_row {
+    const AppTopEntry* entry;
+    double calls;
+    double bytes;
+    double errors;
+    guint64 p50;
+    guint64 p99;
+} AppTopRow;
+
+typedef
+int
+(*AppTopCompareFunc)(
+    const void* a,
+    const void* b);
+
 static const char pname[] = "binder-dump";
 
 static
@@ -112,6 +151,316 @@ app_dump_services(
     }
 }
 
+/*==========================================================================*
+ * Top
+ *==========================================================================*/
+
+static
+gboolean
+app_top_parse_line(
+    const char* line,
+    AppTopEntry* e)
+{
+    const char* hist = strstr(line, " hist=");
+    GBinderStatsEntry* s = &e->cur;
+    guint64 avg;
+
+    /* See gbinder_stats_dump() */
+    memset(s, 0, sizeof(*s));
+    if (hist && sscanf(line, "%7s %255s %255s %u calls=%" G_GUINT64_FORMAT
+        " oneway=%" G_GUINT64_FORMAT " errors=%" G_GUINT64_FORMAT
+        " req=%" G_GUINT64_FORMAT " reply=%" G_GUINT64_FORMAT
+        " objects=%" G_GUINT64_FORMAT " total=%" G_GUINT64_FORMAT
+        "us avg=%" G_GUINT64_FORMAT "us max=%" G_GUINT64_FORMAT "us",
+        e->dir, e->dev, e->iface, &e->code, &s->calls, &s->oneway,
+        &s->errors, &s->request_bytes, &s->reply_bytes, &s->objects,
+        &s->total_usec, &avg, &s->max_usec) == 13) {
+        const char* ptr = hist + 6;
+        int i;
+
+        for (i = 0; i < GBINDER_STATS_HISTOGRAM_SIZE && *ptr; i++) {
+            char* end = NULL;
+
+            s->histogram[i] = g_ascii_strtoull(ptr, &end, 10);
+            if (end == ptr) break;
+            ptr = (*end == ',') ? (end + 1) : end;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+void
+app_top_update(
+    GHashTable* table,
+    const char* dump)
+{
+    char** lines = g_strsplit(dump, "\n", -1);
+    char** ptr;
+
+    for (ptr = lines; *ptr; ptr++) {
+        AppTopEntry parsed;
+
+        if (app_top_parse_line(*ptr, &parsed)) {
+            char* key = g_strdup_printf("%s %s %s %u", parsed.dir,
+                parsed.dev, parsed.iface, parsed.code);
+            AppTopEntry* e = g_hash_table_lookup(table, key);
+
+            if (e) {
+                e->prev = e->cur;
+                e->cur = parsed.cur;
+                g_free(key);
+            } else {
+                e = g_new(AppTopEntry, 1);
+                *e = parsed;
+                memset(&e->prev, 0, sizeof(e->prev));
+                g_hash_table_insert(table, key, e);
+            }
+        }
+    }
+    g_strfreev(lines);
+}
+
+static
+int
+app_top_compare_calls(
+    const void* a,
+    const void* b)
+{
+    const AppTopRow* r1 = a;
+    const AppTopRow* r2 = b;
+
+    return (r1->calls > r2->calls) ? (-1) : (r1->calls < r2->calls) ? 1 : 0;
+}
+
+static
+int
+app_top_compare_bytes(
+    const void* a,
+    const void* b)
+{
+    const AppTopRow* r1 = a;
+    const AppTopRow* r2 = b;
+
+    return (r1->bytes > r2->bytes) ? (-1) : (r1->bytes < r2->bytes) ? 1 :
+        app_top_compare_calls(a, b);
+}
+
+static
+int
+app_top_compare_errors(
+    const void* a,
+    const void* b)
+{
+    const AppTopRow* r1 = a;
+    const AppTopRow* r2 = b;
+
+    return (r1->errors > r2->errors) ? (-1) : (r1->errors < r2->errors) ? 1 :
+        app_top_compare_calls(a, b);
+}
+
+static
+int
+app_top_compare_p50(
+    const void* a,
+    const void* b)
+{
+    const AppTopRow* r1 = a;
+    const AppTopRow* r2 = b;
+
+    return (r1->p50 > r2->p50) ? (-1) : (r1->p50 < r2->p50) ? 1 :
+        app_top_compare_calls(a, b);
+}
+
+static
+int
+app_top_compare_p99(
+    const void* a,
+    const void* b)
+{
+    const AppTopRow* r1 = a;
+    const AppTopRow* r2 = b;
+
+    return (r1->p99 > r2->p99) ? (-1) : (r1->p99 < r2->p99) ? 1 :
+        app_top_compare_calls(a, b);
+}
+
+static
+AppTopCompareFunc
+app_top_compare_func(
+    const char* order)
+{
+    static const struct app_top_order {
+        const char* name;
+        AppTopCompareFunc fn;
+    } orders[] = {
+        { "calls", app_top_compare_calls },
+        { "bytes", app_top_compare_bytes },
+        { "errors", app_top_compare_errors },
+        { "p50", app_top_compare_p50 },
+        { "p99", app_top_compare_p99 }
+    };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(orders); i++) {
+        if (!strcmp(order, orders[i].name)) {
+            return orders[i].fn;
+        }
+    }
+    return NULL;
+}
+
+static
+void
+app_top_print(
+    GHashTable* table,
+    AppTopCompareFunc compare,
+    gint64 elapsed_usec)
+{
+    static const GBinderStatsEntry zero;
+    const double sec = elapsed_usec / 1e6;
+    AppTopRow* rows = g_new0(AppTopRow, g_hash_table_size(table));
+    GHashTableIter it;
+    gpointer value;
+    guint i, n = 0;
+
+    g_hash_table_iter_init(&it, table);
+    while (g_hash_table_iter_next(&it, NULL, &value)) {
+        const AppTopEntry* e = value;
+        const GBinderStatsEntry* cur = &e->cur;
+        /* Statistics may have been reset in the meantime */
+        const GBinderStatsEntry* prev = (cur->calls >= e->prev.calls) ?
+            &e->prev : &zero;
+
+        if (cur->calls > prev->calls) {
+            GBinderStatsEntry delta;
+            AppTopRow* row = rows + (n++);
+            int k;
+
+            memset(&delta, 0, sizeof(delta));
+            delta.max_usec = cur->max_usec;
+            for (k = 0; k < GBINDER_STATS_HISTOGRAM_SIZE; k++) {
+                delta.histogram[k] = cur->histogram[k] - prev->histogram[k];
+            }
+            row->entry = e;
+            row->calls = (cur->calls - prev->calls) / sec;
+            row->bytes = (cur->request_bytes + cur->reply_bytes -
+                prev->request_bytes - prev->reply_bytes) / sec;
+            row->errors = (cur->errors - prev->errors) / sec;
+            row->p50 = gbinder_stats_percentile_usec(&delta, 50);
+            row->p99 = gbinder_stats_percentile_usec(&delta, 99);
+        }
+    }
+
+    qsort(rows, n, sizeof(rows[0]), compare);
+    if (isatty(STDOUT_FILENO)) {
+        /* Clear the screen */
+        printf("\033[H\033[2J");
+    }
+    printf("%-4s %-14s %-36s %10s %10s %10s %8s %8s %8s\n", "DIR", "DEVICE",
+        "INTERFACE", "CODE", "CALLS/S", "BYTES/S", "P50US", "P99US",
+        "ERRORS/S");
+    for (i = 0; i < n; i++) {
+        const AppTopRow* row = rows + i;
+        const AppTopEntry* e = row->entry;
+
+        printf("%-4s %-14.14s %-36.36s %10u %10.1f %10.0f %8" G_GUINT64_FORMAT
+            " %8" G_GUINT64_FORMAT " %8.1f\n", e->dir, e->dev, e->iface,
+            e->code, row->calls, row->bytes, row->p50, row->p99, row->errors);
+    }
+    fflush(stdout);
+    g_free(rows);
+}
+
+static
+char*
+app_top_fetch(
+    GBinderClient* client,
+    int sampling)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request(client);
+    GBinderRemoteReply* reply;
+    char* dump = NULL;
+    int status = 0;
+
+    gbinder_local_request_append_int32(req, sampling);
+    reply = gbinder_client_transact_sync_reply(client, STATS_DUMP, req,
+        &status);
+    if (reply) {
+        GBinderReader reader;
+
+        gbinder_remote_reply_init_reader(reply, &reader);
+        dump = g_strdup(gbinder_reader_read_string8(&reader));
+        gbinder_remote_reply_unref(reply);
+    }
+    if (!dump) {
+        GERR("Failed to fetch statistics (%d)", status);
+    }
+    gbinder_local_request_unref(req);
+    return dump;
+}
+
+static
+int
+app_top(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+    AppTopCompareFunc compare = app_top_compare_func(opt->order);
+    GBinderRemoteObject* obj;
+    int status = 0;
+
+    if (!compare) {
+        GERR("Unknown sort order \"%s\"", opt->order);
+        return RET_INVARG;
+    }
+
+    obj = gbinder_servicemanager_get_service_sync(app->sm, opt->service,
+        &status);
+    if (obj) {
+        GBinderClient* client = gbinder_client_new(obj, STATS_IFACE);
+        GHashTable* table = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_free);
+        gint64 last = g_get_monotonic_time();
+        char* dump = app_top_fetch(client, opt->sampling);
+        int ret = RET_OK, i;
+
+        /* The first sample only serves as a baseline */
+        if (dump) {
+            app_top_update(table, dump);
+            g_free(dump);
+        } else {
+            ret = RET_ERR;
+        }
+        for (i = 0; ret == RET_OK && (!opt->count || i < opt->count); i++) {
+            gint64 now;
+
+            g_usleep((gulong)opt->interval * G_USEC_PER_SEC);
+            dump = app_top_fetch(client, 0);
+            now = g_get_monotonic_time();
+            if (dump) {
+                app_top_update(table, dump);
+                app_top_print(table, compare, now - last);
+                g_free(dump);
+                last = now;
+            } else {
+                ret = RET_ERR;
+            }
+        }
+        g_hash_table_destroy(table);
+        gbinder_client_unref(client);
+        return ret;
+    } else {
+        GERR("No such service: %s (%d)", opt->service, status);
+        return RET_NOTFOUND;
+    }
+}
+
+/*==========================================================================*
+ * Dump
+ *==========================================================================*/
+
 static
 void
 app_run(
@@ -119,7 +468,9 @@ app_run(
 {
     const AppOptions* opt = app->opt;
 
-    if (opt->service) {
+    if (opt->top) {
+        app->ret = app_top(app);
+    } else if (opt->service) {
         app->ret = app_dump_service(app, opt->service) ? RET_OK : RET_NOTFOUND;
     } else {
         char** services = gbinder_servicemanager_list_sync(app->sm);
@@ -173,6 +524,18 @@ app_init(
           app_log_quiet, "Be quiet", NULL },
         { "device", 'd', 0, G_OPTION_ARG_STRING, &opt->dev,
           "Binder device [" DEV_DEFAULT "]", "DEVICE" },
+        { "top", 't', 0, G_OPTION_ARG_NONE, &opt->top,
+          "Show live statistics exported by SERVICE", NULL },
+        { "interval", 'i', 0, G_OPTION_ARG_INT, &opt->interval,
+          "Refresh interval in seconds [" G_STRINGIFY(TOP_DEFAULT_INTERVAL)
+          "]", "SEC" },
+        { "count", 'n', 0, G_OPTION_ARG_INT, &opt->count,
+          "Number of refreshes, zero to run forever [0]", "COUNT" },
+        { "order", 'o', 0, G_OPTION_ARG_STRING, &opt->order,
+          "Sort by calls, bytes, errors, p50 or p99 [" TOP_DEFAULT_ORDER "]",
+          "KEY" },
+        { "sampling", 'r', 0, G_OPTION_ARG_INT, &opt->sampling,
+          "Only measure every Nth transaction", "N" },
         { NULL }
     };
 
@@ -180,23 +543,32 @@ app_init(
     GOptionContext* options = g_option_context_new("[SERVICE]");
 
     memset(opt, 0, sizeof(*opt));
+    opt->interval = TOP_DEFAULT_INTERVAL;
 
     gutil_log_timestamp = FALSE;
     gutil_log_set_type(GLOG_TYPE_STDERR, pname);
     gutil_log_default.level = GLOG_LEVEL_DEFAULT;
 
+    g_option_context_set_summary(options, "Dumps SERVICE or all services. "
+        "With --top, periodically polls the statistics\nexported by "
+        "binder-bridge --stats SERVICE and shows per-method rates.");
     g_option_context_add_main_entries(options, entries, NULL);
     if (g_option_context_parse(options, &argc, &argv, &error)) {
         char* help;
 
         if (!opt->dev || !opt->dev[0]) opt->dev = g_strdup(DEV_DEFAULT);
+        if (!opt->order) opt->order = g_strdup(TOP_DEFAULT_ORDER);
         switch (argc) {
         case 2:
             opt->service = argv[1];
             /* no break */
         case 1:
-            ok = TRUE;
-            break;
+            if (!opt->top || (opt->service && opt->interval > 0 &&
+                opt->count >= 0 && opt->sampling >= 0)) {
+                ok = TRUE;
+                break;
+            }
+            /* no break */
         default:
             help = g_option_context_get_help(options, TRUE, NULL);
             fprintf(stderr, "%s", help);
@@ -227,6 +599,7 @@ int main(int argc, char* argv[])
         }
     }
     g_free(opt.dev);
+    g_free(opt.order);
     return app.ret;
 }
 
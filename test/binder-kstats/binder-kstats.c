@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Shows the binder driver's view of one or more processes, next to
+ * what libgbinder knows about its own loopers and the mapping (the
+ * latter only for this process, i.e. PID 0). Reading the driver's
+ * stats file normally requires root.
+ */
+
+#include <gbinder.h>
+
+#include <gutil_log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RET_OK          (0)
+#define RET_NOTFOUND    (1)
+#define RET_INVARG      (2)
+#define RET_ERR         (3)
+
+#define DEFAULT_DEVICE  GBINDER_DEFAULT_BINDER
+
+typedef struct app_options {
+    char* dev;
+    int interval;
+    int count;
+    int* pids;
+    guint npids;
+} AppOptions;
+
+static
+void
+app_print_header(
+    void)
+{
+    printf("%8s %7s %5s %7s %7s %9s %5s %8s %8s %8s %6s %6s %7s %7s %9s\n",
+        "PID", "threads", "ready", "spawn", "pending", "async", "bufs",
+        "tx", "reply", "rx", "failed", "dead", "loopers", "blocked",
+        "pinned");
+}
+
+static
+void
+app_print(
+    int pid,
+    const GBinderStatsKernel* s,
+    const GBinderStatsKernel* prev)
+{
+    char spawn[16];
+
+    /* Cumulative counters are shown as deltas after the first sample */
+    snprintf(spawn, sizeof(spawn), "%u+%u", s->requested_threads,
+        s->started_threads);
+    printf("%8d %7u %5u %7s %7u %9" G_GUINT64_FORMAT " %5u %8"
+        G_GUINT64_FORMAT " %8" G_GUINT64_FORMAT " %8" G_GUINT64_FORMAT
+        " %6" G_GUINT64_FORMAT " %6" G_GUINT64_FORMAT, pid, s->threads,
+        s->ready_threads, spawn, s->pending_transactions,
+        s->free_async_space, s->buffers,
+        s->transactions - prev->transactions,
+        s->replies - prev->replies,
+        s->incoming - prev->incoming,
+        s->failed_replies - prev->failed_replies,
+        s->dead_replies - prev->dead_replies);
+    if (!pid) {
+        printf(" %7u %7u %4" G_GUINT64_FORMAT "/%-4" G_GUINT64_FORMAT "K\n",
+            s->loopers, s->blocked_loopers, s->pinned_bytes / 1024,
+            s->mapped_bytes / 1024);
+    } else {
+        printf(" %7s %7s %9s\n", "-", "-", "-");
+    }
+}
+
+static
+int
+app_run(
+    const AppOptions* opt)
+{
+    GBinderStatsKernel* prev = g_new0(GBinderStatsKernel, opt->npids);
+    GBinderServiceManager* sm = NULL;
+    int ret = RET_OK;
+    int n;
+    guint i;
+
+    for (i = 0; i < opt->npids && !sm; i++) {
+        if (!opt->pids[i]) {
+            /* Make this process show up in the driver's stats */
+            sm = gbinder_servicemanager_new(opt->dev);
+        }
+    }
+
+    app_print_header();
+    for (n = 0; !opt->count || n < opt->count; n++) {
+        if (n) {
+            sleep(opt->interval);
+        }
+        for (i = 0; i < opt->npids; i++) {
+            GBinderStatsKernel stats;
+
+            if (gbinder_stats_get_kernel(opt->dev, opt->pids[i], &stats)) {
+                app_print(opt->pids[i], &stats, prev + i);
+                prev[i] = stats;
+            } else {
+                GERR("No %s stats for PID %d", opt->dev, opt->pids[i]);
+                ret = RET_NOTFOUND;
+            }
+        }
+        if (ret != RET_OK) {
+            break;
+        }
+        fflush(stdout);
+    }
+
+    gbinder_servicemanager_unref(sm);
+    g_free(prev);
+    return ret;
+}
+
+static
+gboolean
+app_log_verbose(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_VERBOSE;
+    return TRUE;
+}
+
+static
+gboolean
+app_log_quiet(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_ERR;
+    return TRUE;
+}
+
+static
+gboolean
+app_init(
+    AppOptions* opt,
+    int argc,
+    char* argv[])
+{
+    gboolean ok = FALSE;
+    GOptionEntry entries[] = {
+        { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_verbose, "Enable verbose output", NULL },
+        { "quiet", 'q', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_quiet, "Be quiet", NULL },
+        { "device", 'd', 0, G_OPTION_ARG_STRING, &opt->dev,
+          "Binder device [" DEFAULT_DEVICE "]", "DEVICE" },
+        { "interval", 'i', 0, G_OPTION_ARG_INT, &opt->interval,
+          "Repeat every SEC seconds [once]", "SEC" },
+        { "count", 'c', 0, G_OPTION_ARG_INT, &opt->count,
+          "Number of samples with -i [unlimited]", "N" },
+        { NULL }
+    };
+
+    GError* error = NULL;
+    GOptionContext* options = g_option_context_new("[PID...]");
+
+    gutil_log_timestamp = FALSE;
+    gutil_log_default.level = GLOG_LEVEL_DEFAULT;
+
+    g_option_context_add_main_entries(options, entries, NULL);
+    g_option_context_set_summary(options, "PID 0 (the default) is this "
+        "process, it also shows libgbinder's own loopers\nand the pinned "
+        "part of the mapping. Transaction counters are deltas between\n"
+        "the samples.");
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        int i;
+
+        if (!opt->dev || !opt->dev[0]) {
+            g_free(opt->dev);
+            opt->dev = g_strdup(DEFAULT_DEVICE);
+        }
+        if (opt->interval <= 0) {
+            opt->interval = 0;
+            opt->count = 1;
+        } else if (opt->count < 0) {
+            opt->count = 0;
+        }
+        ok = TRUE;
+        opt->npids = MAX(argc - 1, 1);
+        opt->pids = g_new0(int, opt->npids);
+        for (i = 1; i < argc && ok; i++) {
+            char* end = NULL;
+            const long pid = strtol(argv[i], &end, 10);
+
+            if (end != argv[i] && !*end && pid >= 0 && pid <= G_MAXINT) {
+                opt->pids[i - 1] = (int)pid;
+            } else {
+                GERR("Invalid PID '%s'", argv[i]);
+                ok = FALSE;
+            }
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    AppOptions opt;
+    int ret = RET_INVARG;
+
+    memset(&opt, 0, sizeof(opt));
+    if (app_init(&opt, argc, argv)) {
+        ret = app_run(&opt);
+    }
+    g_free(opt.pids);
+    g_free(opt.dev);
+    return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -34,6 +34,8 @@
 
 #include <gutil_log.h>
 
+#include <errno.h>
+
 #define RET_OK          (0)
 #define RET_NOTFOUND    (1)
 #define RET_INVARG      (2)
@@ -41,19 +43,54 @@
 
 #define DEV_DEFAULT     GBINDER_DEFAULT_HWBINDER
 
+#define PROBE_DEFAULT_JOBS      (8)
+#define PROBE_DEFAULT_TIMEOUT   (1000) /* ms */
+
+#define AIDL_PING_TRANSACTION       GBINDER_FOURCC('_','P','N','G')
+#define AIDL_INTERFACE_TRANSACTION  GBINDER_FOURCC('_','N','T','F')
+#define AIDL_BASE_INTERFACE         "android.os.IBinder"
+#define HIDL_PING_TRANSACTION       GBINDER_FOURCC(0x0f,'P','N','G')
+#define HIDL_DESCRIPTOR_TRANSACTION GBINDER_FOURCC(0x0f,'D','S','C')
+#define HIDL_BASE_INTERFACE         "android.hidl.base@1.0::IBase"
+
 typedef struct app_options {
     char* dev;
+    char* sm_protocol;
     const char* service;
     gboolean async;
+    gboolean probe;
+    int jobs;
+    int timeout;
 } AppOptions;
 
+typedef struct app_probe AppProbe;
+
 typedef struct app {
     const AppOptions* opt;
     GMainLoop* loop;
     GBinderServiceManager* sm;
+    gboolean hidl;
+    AppProbe* probes;
+    guint probe_count;
+    guint probes_started;
+    guint probes_active;
     int ret;
 } App;
 
+struct app_probe {
+    App* app;
+    const char* name;
+    GBinderClient* client;
+    gulong sm_id;
+    gulong tx_id;
+    guint timeout_id;
+    gint64 start;
+    gint64 usec;
+    char* iface;
+    const char* result; /* NULL until done */
+    int status;
+};
+
 static const char pname[] = "binder-list";
 
 static
@@ -156,6 +193,239 @@ app_sync(
     }
 }
 
+/*==========================================================================*
+ * Probing
+ *==========================================================================*/
+
+static
+void
+app_probe_next(
+    App* app);
+
+static
+void
+app_probe_finish(
+    AppProbe* probe,
+    const char* result,
+    int status)
+{
+    App* app = probe->app;
+
+    probe->usec = g_get_monotonic_time() - probe->start;
+    probe->result = result;
+    probe->status = status;
+    if (probe->timeout_id) {
+        g_source_remove(probe->timeout_id);
+        probe->timeout_id = 0;
+    }
+    if (probe->sm_id) {
+        gbinder_servicemanager_cancel(app->sm, probe->sm_id);
+        probe->sm_id = 0;
+    }
+    if (probe->tx_id) {
+        gbinder_client_cancel(probe->client, probe->tx_id);
+        probe->tx_id = 0;
+    }
+    gbinder_client_unref(probe->client);
+    probe->client = NULL;
+
+    app->probes_active--;
+    app_probe_next(app);
+}
+
+static
+gboolean
+app_probe_timeout(
+    gpointer user_data)
+{
+    AppProbe* probe = user_data;
+
+    probe->timeout_id = 0;
+    app_probe_finish(probe, "timeout", -ETIMEDOUT);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+app_probe_iface_done(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    AppProbe* probe = user_data;
+    GBinderReader reader;
+
+    probe->tx_id = 0;
+    gbinder_remote_reply_init_reader(reply, &reader);
+    if (probe->app->hidl) {
+        gint32 hidl_status = -1;
+
+        if (gbinder_reader_read_int32(&reader, &hidl_status) &&
+            hidl_status == GBINDER_STATUS_OK) {
+            probe->iface = gbinder_reader_read_hidl_string(&reader);
+        }
+    } else {
+        probe->iface = gbinder_reader_read_string16(&reader);
+    }
+
+    /* The service is alive even if it doesn't tell its interface */
+    app_probe_finish(probe, "ok", GBINDER_STATUS_OK);
+}
+
+static
+void
+app_probe_ping_done(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    AppProbe* probe = user_data;
+
+    probe->tx_id = 0;
+    if (status == GBINDER_STATUS_OK) {
+        probe->tx_id = gbinder_client_transact(client, probe->app->hidl ?
+            HIDL_DESCRIPTOR_TRANSACTION : AIDL_INTERFACE_TRANSACTION, 0,
+            NULL, app_probe_iface_done, NULL, probe);
+        if (probe->tx_id) {
+            return;
+        }
+    }
+    app_probe_finish(probe, "error", status ? status : GBINDER_STATUS_FAILED);
+}
+
+static
+void
+app_probe_get_service_done(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* obj,
+    int status,
+    void* user_data)
+{
+    AppProbe* probe = user_data;
+    const gboolean hidl = probe->app->hidl;
+
+    probe->sm_id = 0;
+    if (obj) {
+        probe->client = gbinder_client_new(obj, hidl ?
+            HIDL_BASE_INTERFACE : AIDL_BASE_INTERFACE);
+        probe->tx_id = gbinder_client_transact(probe->client, hidl ?
+            HIDL_PING_TRANSACTION : AIDL_PING_TRANSACTION, 0, NULL,
+            app_probe_ping_done, NULL, probe);
+        if (!probe->tx_id) {
+            app_probe_finish(probe, "error", GBINDER_STATUS_FAILED);
+        }
+    } else {
+        app_probe_finish(probe, "missing", status ? status : (-ENOENT));
+    }
+}
+
+static
+void
+app_probe_next(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+
+    while (app->probes_started < app->probe_count &&
+        app->probes_active < (guint)opt->jobs) {
+        AppProbe* probe = app->probes + (app->probes_started++);
+
+        app->probes_active++;
+        probe->start = g_get_monotonic_time();
+        probe->timeout_id = g_timeout_add(opt->timeout, app_probe_timeout,
+            probe);
+        probe->sm_id = gbinder_servicemanager_get_service(app->sm,
+            probe->name, app_probe_get_service_done, probe);
+        if (!probe->sm_id && !probe->result) {
+            app_probe_finish(probe, "error", GBINDER_STATUS_FAILED);
+        }
+    }
+    if (!app->probes_active && app->loop) {
+        g_main_loop_quit(app->loop);
+    }
+}
+
+static
+void
+app_probe(
+    App* app,
+    char** services)
+{
+    const gint64 start = g_get_monotonic_time();
+    guint i, failed = 0;
+
+    app->probe_count = services ? g_strv_length(services) : 0;
+    app->probes = g_new0(AppProbe, app->probe_count);
+    /* The probe transactions depend on the service manager protocol */
+    app->hidl = !g_strcmp0(gbinder_servicemanager_protocol(app->sm), "hidl");
+    for (i = 0; i < app->probe_count; i++) {
+        app->probes[i].app = app;
+        app->probes[i].name = services[i];
+    }
+
+    app->loop = g_main_loop_new(NULL, TRUE);
+    app_probe_next(app);
+    if (app->probes_active) {
+        g_main_loop_run(app->loop);
+    }
+    g_main_loop_unref(app->loop);
+    app->loop = NULL;
+
+    /* Print the results in the original order */
+    for (i = 0; i < app->probe_count; i++) {
+        AppProbe* probe = app->probes + i;
+
+        printf("%s %s %.1fms", probe->name, probe->result,
+            probe->usec / 1000.0);
+        if (probe->iface) {
+            printf(" %s", probe->iface);
+        } else if (probe->status != GBINDER_STATUS_OK) {
+            printf(" (%d)", probe->status);
+        }
+        printf("\n");
+        if (probe->status != GBINDER_STATUS_OK) {
+            failed++;
+        }
+        g_free(probe->iface);
+    }
+    GINFO("Probed %u service(s) in %.1fms, %u failed", app->probe_count,
+        (g_get_monotonic_time() - start) / 1000.0, failed);
+    app->ret = failed ? RET_ERR : RET_OK;
+
+    g_free(app->probes);
+    app->probes = NULL;
+    app->probe_count = 0;
+}
+
+static
+void
+app_probe_all(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+
+    if (opt->service) {
+        char* services[2];
+
+        services[0] = (char*)opt->service;
+        services[1] = NULL;
+        app_probe(app, services);
+    } else {
+        char** services = gbinder_servicemanager_list_sync(app->sm);
+
+        if (services) {
+            app_probe(app, services);
+            g_strfreev(services);
+        }
+    }
+}
+
+/*==========================================================================*
+ * Options
+ *==========================================================================*/
+
 static
 gboolean
 app_log_verbose(
@@ -197,6 +467,17 @@ app_init(
           "Perform operations asynchronously", NULL },
         { "device", 'd', 0, G_OPTION_ARG_STRING, &opt->dev,
           "Binder device [" DEV_DEFAULT "]", "DEVICE" },
+        { "servicemanager", 'm', 0, G_OPTION_ARG_STRING, &opt->sm_protocol,
+          "Service manager (aidl, aidl2, aidl3, aidl4 or hidl) [from "
+          "config]", "SM" },
+        { "probe", 'p', 0, G_OPTION_ARG_NONE, &opt->probe,
+          "Ping each service and query its interface", NULL },
+        { "jobs", 'j', 0, G_OPTION_ARG_INT, &opt->jobs,
+          "Maximum number of concurrent probes ["
+          G_STRINGIFY(PROBE_DEFAULT_JOBS) "]", "COUNT" },
+        { "timeout", 't', 0, G_OPTION_ARG_INT, &opt->timeout,
+          "Probe timeout in milliseconds ["
+          G_STRINGIFY(PROBE_DEFAULT_TIMEOUT) "]", "MS" },
         { NULL }
     };
 
@@ -204,6 +485,8 @@ app_init(
     GOptionContext* options = g_option_context_new("[SERVICE]");
 
     memset(opt, 0, sizeof(*opt));
+    opt->jobs = PROBE_DEFAULT_JOBS;
+    opt->timeout = PROBE_DEFAULT_TIMEOUT;
 
     gutil_log_timestamp = FALSE;
     gutil_log_set_type(GLOG_TYPE_STDERR, pname);
@@ -219,8 +502,11 @@ app_init(
             opt->service = argv[1];
             /* no break */
         case 1:
-            ok = TRUE;
-            break;
+            if (opt->jobs > 0 && opt->timeout > 0) {
+                ok = TRUE;
+                break;
+            }
+            /* no break */
         default:
             help = g_option_context_get_help(options, TRUE, NULL);
             fprintf(stderr, "%s", help);
@@ -244,9 +530,11 @@ int main(int argc, char* argv[])
     app.ret = RET_INVARG;
     app.opt = &opt;
     if (app_init(&opt, argc, argv)) {
-        app.sm = gbinder_servicemanager_new(opt.dev);
+        app.sm = gbinder_servicemanager_new2(opt.dev, opt.sm_protocol, NULL);
         if (gbinder_servicemanager_wait(app.sm, -1)) {
-            if (opt.async) {
+            if (opt.probe) {
+                app_probe_all(&app);
+            } else if (opt.async) {
                 app_async(&app);
             } else {
                 app_sync(&app);
@@ -255,6 +543,7 @@ int main(int argc, char* argv[])
         }
     }
     g_free(opt.dev);
+    g_free(opt.sm_protocol);
     return app.ret;
 }
 
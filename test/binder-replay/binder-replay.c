@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gbinder.h>
+
+#include <gutil_log.h>
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RET_OK          (0)
+#define RET_NOTFOUND    (1)
+#define RET_INVARG      (2)
+#define RET_ERR         (3)
+
+#define DEFAULT_DEVICE  GBINDER_DEFAULT_BINDER
+
+typedef struct app_options {
+    char* dev;
+    char* name;
+    char* file;
+    gboolean fast;
+    gint handle;
+} AppOptions;
+
+typedef struct app {
+    const AppOptions* opt;
+    GBinderServiceManager* sm;
+    GBinderClient* client;
+    guint replayed;
+    guint skipped;
+    guint errors;
+    int ret;
+} App;
+
+static const char pname[] = "binder-replay";
+
+/*==========================================================================*
+ * Replay
+ *==========================================================================*/
+
+static
+void
+app_replay_record(
+    App* app,
+    const GBinderCaptureRecord* rec)
+{
+    const AppOptions* opt = app->opt;
+    GBinderLocalRequest* req;
+    GBinderWriter writer;
+    int status = INT_MAX;
+
+    /*
+     * Objects have been sanitized at capture time, there's nothing
+     * meaningful that could be sent in their place.
+     */
+    if (rec->dir != GBINDER_CAPTURE_OUTGOING || rec->offsets_count ||
+        (opt->handle >= 0 && rec->handle != (guint32)opt->handle)) {
+        app->skipped++;
+        return;
+    }
+
+    req = gbinder_client_new_request2(app->client, rec->code);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_bytes(&writer, rec + 1, rec->data_size);
+    if (rec->flags & GBINDER_TX_FLAG_ONEWAY) {
+        status = gbinder_client_transact_sync_oneway(app->client,
+            rec->code, req);
+    } else {
+        gbinder_remote_reply_unref(gbinder_client_transact_sync_reply
+            (app->client, rec->code, req, &status));
+    }
+    gbinder_local_request_unref(req);
+
+    GDEBUG("%u 0x%08x %u bytes => %d", rec->handle, rec->code,
+        rec->data_size, status);
+    app->replayed++;
+    if (status != GBINDER_STATUS_OK) {
+        app->errors++;
+    }
+}
+
+static
+void
+app_replay(
+    App* app,
+    const guint8* data,
+    gsize size)
+{
+    const AppOptions* opt = app->opt;
+    const gint64 start = g_get_monotonic_time();
+    gint64 first_usec = 0, elapsed;
+    gsize pos = GBINDER_CAPTURE_MAGIC_SIZE;
+
+    app->ret = RET_OK;
+    while (pos + sizeof(GBinderCaptureRecord) <= size) {
+        const GBinderCaptureRecord* rec = (const void*)(data + pos);
+
+        if (rec->size < sizeof(*rec) + rec->data_size ||
+            rec->size > size - pos) {
+            GERR("Truncated or corrupted record at offset %lu",
+                (gulong)pos);
+            app->ret = RET_ERR;
+            break;
+        }
+
+        if (!opt->fast) {
+            /* Reproduce the original pacing */
+            if (!first_usec) {
+                first_usec = rec->usec;
+            } else {
+                const gint64 due = start + (rec->usec - first_usec);
+                const gint64 now = g_get_monotonic_time();
+
+                if (due > now) {
+                    g_usleep(due - now);
+                }
+            }
+        }
+        app_replay_record(app, rec);
+        pos += rec->size;
+    }
+
+    elapsed = g_get_monotonic_time() - start;
+    printf("%u replayed, %u skipped, %u errors, %.1f calls/sec\n",
+        app->replayed, app->skipped, app->errors, elapsed ?
+        (app->replayed * 1e6 / elapsed) : 0.0);
+    if (app->errors && app->ret == RET_OK) {
+        app->ret = RET_ERR;
+    }
+}
+
+static
+void
+app_run(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+    GError* error = NULL;
+    GMappedFile* map = g_mapped_file_new(opt->file, FALSE, &error);
+
+    if (map) {
+        const guint8* data = (const guint8*)g_mapped_file_get_contents(map);
+        const gsize size = g_mapped_file_get_length(map);
+
+        if (size >= GBINDER_CAPTURE_MAGIC_SIZE &&
+            !memcmp(data, GBINDER_CAPTURE_MAGIC,
+            GBINDER_CAPTURE_MAGIC_SIZE)) {
+            int status = 0;
+            GBinderRemoteObject* remote =
+                gbinder_servicemanager_get_service_sync(app->sm,
+                    opt->name, &status);
+
+            if (remote) {
+                /* Captured data already includes the interface header */
+                app->client = gbinder_client_new(remote, NULL);
+                app_replay(app, data, size);
+                gbinder_client_unref(app->client);
+                app->client = NULL;
+            } else {
+                GERR("%s not found", opt->name);
+                app->ret = RET_NOTFOUND;
+            }
+        } else {
+            GERR("%s is not a capture file", opt->file);
+            app->ret = RET_INVARG;
+        }
+        g_mapped_file_unref(map);
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+        app->ret = RET_INVARG;
+    }
+}
+
+/*==========================================================================*
+ * Options
+ *==========================================================================*/
+
+static
+gboolean
+app_log_verbose(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_VERBOSE;
+    return TRUE;
+}
+
+static
+gboolean
+app_log_quiet(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_ERR;
+    return TRUE;
+}
+
+static
+gboolean
+app_init(
+    AppOptions* opt,
+    int argc,
+    char* argv[])
+{
+    gboolean ok = FALSE;
+    GOptionEntry entries[] = {
+        { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_verbose, "Enable verbose output", NULL },
+        { "quiet", 'q', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_quiet, "Be quiet", NULL },
+        { "device", 'd', 0, G_OPTION_ARG_STRING, &opt->dev,
+          "Binder device [" DEFAULT_DEVICE "]", "DEVICE" },
+        { "fast", 'f', 0, G_OPTION_ARG_NONE, &opt->fast,
+          "Replay as fast as possible, ignoring the timestamps", NULL },
+        { "handle", 'H', 0, G_OPTION_ARG_INT, &opt->handle,
+          "Only replay calls made to this handle", "HANDLE" },
+        { NULL }
+    };
+
+    GError* error = NULL;
+    GOptionContext* options = g_option_context_new("FILE NAME");
+
+    memset(opt, 0, sizeof(*opt));
+    opt->handle = -1;
+
+    gutil_log_timestamp = FALSE;
+    gutil_log_set_type(GLOG_TYPE_STDERR, pname);
+    gutil_log_default.level = GLOG_LEVEL_DEFAULT;
+
+    g_option_context_set_summary(options, "Replays outgoing transactions "
+        "from a capture file against the NAME service.\nTransactions "
+        "carrying objects are skipped.");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        if (!opt->dev || !opt->dev[0]) {
+            g_free(opt->dev);
+            opt->dev = g_strdup(DEFAULT_DEVICE);
+        }
+        if (argc == 3) {
+            opt->file = g_strdup(argv[1]);
+            opt->name = g_strdup(argv[2]);
+            ok = TRUE;
+        } else {
+            char* help = g_option_context_get_help(options, TRUE, NULL);
+
+            fprintf(stderr, "%s", help);
+            g_free(help);
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    App app;
+    AppOptions opt;
+
+    memset(&app, 0, sizeof(app));
+    app.ret = RET_INVARG;
+    app.opt = &opt;
+    if (app_init(&opt, argc, argv)) {
+        app.sm = gbinder_servicemanager_new(opt.dev);
+        if (gbinder_servicemanager_wait(app.sm, -1)) {
+            app_run(&app);
+        } else {
+            GERR("No servicemanager at %s", opt.dev);
+            app.ret = RET_NOTFOUND;
+        }
+        gbinder_servicemanager_unref(app.sm);
+    }
+    g_free(opt.dev);
+    g_free(opt.name);
+    g_free(opt.file);
+    return app.ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
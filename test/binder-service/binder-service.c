@@ -48,18 +48,59 @@
 #define DEFAULT_NAME    "test"
 #define DEFAULT_IFACE   "test@1.0"
 
+/*
+ * Benchmark modes (everything but the demo one) handle any transaction
+ * code, regardless of the interface:
+ *
+ * echo  - replies with the request payload
+ * sink  - discards the payload, one-way calls are expected
+ * fixed - replies with a byte array of the fixed size
+ *
+ * The payload is encoded according to the payload type, which matches
+ * what binder-bench sends: a byte array, a hidl_vec of bytes or a byte
+ * array followed by a file descriptor.
+ */
+typedef enum app_mode {
+    APP_MODE_DEMO,
+    APP_MODE_ECHO,
+    APP_MODE_SINK,
+    APP_MODE_FIXED
+} APP_MODE;
+
+typedef enum app_payload {
+    APP_PAYLOAD_BYTES,
+    APP_PAYLOAD_HIDL_VEC,
+    APP_PAYLOAD_FD
+} APP_PAYLOAD;
+
 typedef struct app_options {
     char* dev;
     char* iface;
     const char* name;
     gboolean async;
+    gboolean looper;
+    APP_MODE mode;
+    APP_PAYLOAD payload;
+    int reply_size;
+    int delay_us;
 } AppOptions;
 
+typedef struct app_code_stats {
+    guint64 calls;
+    guint64 oneway;
+    guint64 bytes;
+    gint64 total_us;
+    gint64 max_us;
+} AppCodeStats;
+
 typedef struct app {
     const AppOptions* opt;
     GMainLoop* loop;
     GBinderServiceManager* sm;
     GBinderLocalObject* obj;
+    GMutex stats_mutex; /* Handlers may run on the looper threads */
+    GHashTable* stats; /* code => AppCodeStats */
+    void* fixed_reply;
     int ret;
 } App;
 
@@ -105,6 +146,166 @@ app_async_free(
     g_free(resp);
 }
 
+static
+void
+app_stats_update(
+    App* app,
+    guint code,
+    guint flags,
+    gsize bytes,
+    gint64 us)
+{
+    AppCodeStats* stats;
+
+    g_mutex_lock(&app->stats_mutex);
+    stats = g_hash_table_lookup(app->stats, GUINT_TO_POINTER(code));
+    if (!stats) {
+        stats = g_new0(AppCodeStats, 1);
+        g_hash_table_insert(app->stats, GUINT_TO_POINTER(code), stats);
+    }
+    stats->calls++;
+    if (flags & GBINDER_TX_FLAG_ONEWAY) {
+        stats->oneway++;
+    }
+    stats->bytes += bytes;
+    stats->total_us += us;
+    if (stats->max_us < us) {
+        stats->max_us = us;
+    }
+    g_mutex_unlock(&app->stats_mutex);
+}
+
+static
+gint
+app_stats_compare(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const guint c1 = GPOINTER_TO_UINT(a);
+    const guint c2 = GPOINTER_TO_UINT(b);
+
+    return (c1 < c2) ? (-1) : (c1 > c2) ? 1 : 0;
+}
+
+static
+void
+app_stats_print(
+    App* app)
+{
+    GList* codes = g_list_sort(g_hash_table_get_keys(app->stats),
+        app_stats_compare);
+    GList* l;
+
+    for (l = codes; l; l = l->next) {
+        const AppCodeStats* stats = g_hash_table_lookup(app->stats, l->data);
+
+        printf("{\"code\":%u,\"calls\":%" G_GUINT64_FORMAT ",\"oneway\":%"
+            G_GUINT64_FORMAT ",\"bytes\":%" G_GUINT64_FORMAT ",\"mean_us\":"
+            "%.3f,\"max_us\":%" G_GINT64_FORMAT "}\n",
+            GPOINTER_TO_UINT(l->data), stats->calls, stats->oneway,
+            stats->bytes, stats->calls ? ((double)stats->total_us /
+            stats->calls) : 0.0, stats->max_us);
+    }
+    g_list_free(codes);
+}
+
+static
+GBinderLocalReply*
+app_reply_complete(
+    App* app,
+    GBinderRemoteRequest* req,
+    GBinderLocalReply* reply,
+    int* status)
+{
+    *status = GBINDER_STATUS_OK;
+    if (reply && app->opt->async) {
+        Response* resp = g_new0(Response, 1);
+
+        resp->reply = reply;
+        resp->req = gbinder_remote_request_ref(req);
+        g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, app_async_resp,
+            resp, app_async_free);
+        gbinder_remote_request_block(resp->req);
+        return NULL;
+    } else {
+        return reply;
+    }
+}
+
+static
+GBinderLocalReply*
+app_bench_echo(
+    GBinderLocalObject* obj,
+    GBinderReader* reader,
+    APP_PAYLOAD payload)
+{
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+    GBinderWriter writer;
+    const void* data;
+    gsize size = 0;
+
+    gbinder_local_reply_init_writer(reply, &writer);
+    if (payload == APP_PAYLOAD_HIDL_VEC) {
+        gsize elemsize = 0;
+
+        /* The data stays alive until the reply is sent */
+        data = gbinder_reader_read_hidl_vec(reader, &size, &elemsize);
+        gbinder_writer_append_hidl_vec(&writer, data, size, elemsize);
+    } else {
+        data = gbinder_reader_read_byte_array(reader, &size);
+        gbinder_writer_append_byte_array(&writer, data, size);
+        if (payload == APP_PAYLOAD_FD) {
+            const int fd = gbinder_reader_read_fd(reader);
+
+            /* The descriptor gets duplicated */
+            if (fd >= 0) {
+                gbinder_writer_append_fd(&writer, fd);
+            }
+        }
+    }
+    return reply;
+}
+
+static
+GBinderLocalReply*
+app_bench_reply(
+    App* app,
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    GBinderReader* reader,
+    guint code,
+    guint flags,
+    int* status)
+{
+    const AppOptions* opt = app->opt;
+    const gint64 start = g_get_monotonic_time();
+    const gsize bytes = gbinder_reader_bytes_remaining(reader);
+    GBinderLocalReply* reply = NULL;
+
+    if (opt->delay_us > 0) {
+        g_usleep(opt->delay_us);
+    }
+    if (!(flags & GBINDER_TX_FLAG_ONEWAY)) {
+        switch (opt->mode) {
+        case APP_MODE_ECHO:
+            reply = app_bench_echo(obj, reader, opt->payload);
+            break;
+        case APP_MODE_FIXED:
+            reply = gbinder_local_object_new_reply(obj);
+            gbinder_local_reply_append_byte_array(reply, app->fixed_reply,
+                opt->reply_size);
+            break;
+        case APP_MODE_SINK:
+        case APP_MODE_DEMO:
+            reply = gbinder_local_object_new_reply(obj);
+            break;
+        }
+    }
+    app_stats_update(app, code, flags, bytes,
+        g_get_monotonic_time() - start);
+    return app_reply_complete(app, req, reply, status);
+}
+
 static
 GBinderLocalReply*
 app_reply(
@@ -119,7 +320,9 @@ app_reply(
     GBinderReader reader;
 
     gbinder_remote_request_init_reader(req, &reader);
-    if (code == GBINDER_FIRST_CALL_TRANSACTION) {
+    if (app->opt->mode != APP_MODE_DEMO && code != BINDER_DUMP_TRANSACTION) {
+        return app_bench_reply(app, obj, req, &reader, code, flags, status);
+    } else if (code == GBINDER_FIRST_CALL_TRANSACTION) {
         const AppOptions* opt = app->opt;
         const char* iface = gbinder_remote_request_interface(req);
 
@@ -129,21 +332,9 @@ app_reply(
 
             GVERBOSE("\"%s\" %u", iface, code);
             GDEBUG("\"%s\"", str);
-            *status = 0;
             gbinder_local_reply_append_string16(reply, str);
             g_free(str);
-            if (opt->async) {
-                Response* resp = g_new0(Response, 1);
-
-                resp->reply = reply;
-                resp->req = gbinder_remote_request_ref(req);
-                g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, app_async_resp,
-                    resp, app_async_free);
-                gbinder_remote_request_block(resp->req);
-                return NULL;
-            } else {
-                return reply;
-            }
+            return app_reply_complete(app, req, reply, status);
         } else {
              GDEBUG("Unexpected interface \"%s\"", iface);
         }
@@ -247,6 +438,56 @@ app_log_quiet(
     return TRUE;
 }
 
+static
+gboolean
+app_parse_mode(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    AppOptions* opt = data;
+
+    if (!strcmp(value, "demo")) {
+        opt->mode = APP_MODE_DEMO;
+    } else if (!strcmp(value, "echo")) {
+        opt->mode = APP_MODE_ECHO;
+    } else if (!strcmp(value, "sink")) {
+        opt->mode = APP_MODE_SINK;
+    } else if (!strcmp(value, "fixed")) {
+        opt->mode = APP_MODE_FIXED;
+    } else {
+        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+            "Invalid mode '%s'", value);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static
+gboolean
+app_parse_payload(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    AppOptions* opt = data;
+
+    if (!strcmp(value, "bytes")) {
+        opt->payload = APP_PAYLOAD_BYTES;
+    } else if (!strcmp(value, "hidl_vec")) {
+        opt->payload = APP_PAYLOAD_HIDL_VEC;
+    } else if (!strcmp(value, "fd")) {
+        opt->payload = APP_PAYLOAD_FD;
+    } else {
+        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+            "Invalid payload type '%s'", value);
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static
 gboolean
 app_init(
@@ -266,11 +507,27 @@ app_init(
           "Local interface [" DEFAULT_IFACE "]", "IFACE" },
         { "async", 'a', 0, G_OPTION_ARG_NONE, &opt->async,
           "Handle calls asynchronously", NULL },
+        { "looper", 'l', 0, G_OPTION_ARG_NONE, &opt->looper,
+          "Handle calls on the looper threads", NULL },
+        { NULL }
+    };
+    GOptionEntry bench_entries[] = {
+        { "mode", 'm', 0, G_OPTION_ARG_CALLBACK, app_parse_mode,
+          "demo, echo, sink or fixed [demo]", "MODE" },
+        { "payload", 'p', 0, G_OPTION_ARG_CALLBACK, app_parse_payload,
+          "Payload type: bytes, hidl_vec or fd [bytes]", "TYPE" },
+        { "reply-size", 's', 0, G_OPTION_ARG_INT, &opt->reply_size,
+          "Reply size in fixed mode [0]", "BYTES" },
+        { "delay", 'D', 0, G_OPTION_ARG_INT, &opt->delay_us,
+          "Handler delay in benchmark modes [0]", "USEC" },
         { NULL }
     };
 
     GError* error = NULL;
     GOptionContext* options = g_option_context_new("[NAME]");
+    GOptionGroup* bench = g_option_group_new("bench",
+        "Benchmark options (per-code stats are printed at exit):",
+        "Show benchmark options", opt, NULL);
 
     memset(opt, 0, sizeof(*opt));
 
@@ -279,11 +536,14 @@ app_init(
     gutil_log_default.level = GLOG_LEVEL_DEFAULT;
 
     g_option_context_add_main_entries(options, entries, NULL);
+    g_option_group_add_entries(bench, bench_entries);
+    g_option_context_add_group(options, bench);
     if (g_option_context_parse(options, &argc, &argv, &error)) {
         char* help;
 
         if (!opt->dev || !opt->dev[0]) opt->dev = g_strdup(DEFAULT_DEVICE);
         if (!opt->iface) opt->iface = g_strdup(DEFAULT_IFACE);
+        if (opt->reply_size < 0) opt->reply_size = 0;
         switch (argc) {
         case 2:
             opt->name = argv[1];
@@ -315,16 +575,27 @@ int main(int argc, char* argv[])
     memset(&app, 0, sizeof(app));
     app.ret = RET_INVARG;
     app.opt = &opt;
+    g_mutex_init(&app.stats_mutex);
+    app.stats = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+        NULL, g_free);
     if (app_init(&opt, argc, argv)) {
+        app.fixed_reply = g_malloc0(MAX(opt.reply_size, 1));
         app.sm = gbinder_servicemanager_new(opt.dev);
         if (gbinder_servicemanager_wait(app.sm, -1)) {
             app.obj = gbinder_servicemanager_new_local_object
                 (app.sm, opt.iface, app_reply, &app);
+            gbinder_local_object_set_looper_dispatch(app.obj, opt.looper);
             app_run(&app);
             gbinder_local_object_unref(app.obj);
             gbinder_servicemanager_unref(app.sm);
+            if (opt.mode != APP_MODE_DEMO) {
+                app_stats_print(&app);
+            }
         }
     }
+    g_hash_table_destroy(app.stats);
+    g_mutex_clear(&app.stats_mutex);
+    g_free(app.fixed_reply);
     g_free(opt.iface);
     g_free(opt.dev);
     return app.ret;
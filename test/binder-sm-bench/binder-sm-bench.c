@@ -0,0 +1,721 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gbinder.h>
+
+#include <gutil_log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define RET_OK          (0)
+#define RET_NOTFOUND    (1)
+#define RET_INVARG      (2)
+#define RET_ERR         (3)
+
+#define DEFAULT_DEVICE      GBINDER_DEFAULT_BINDER
+#define DEFAULT_ITERATIONS  (200)
+#define DEFAULT_NOTIFY      (5)
+#define DEFAULT_COUNTS      "0,10,100"
+#define DEFAULT_TESTS       "list,get_hit,get_miss,add,notify"
+#define WARMUP_ITERATIONS   (10)
+#define NOTIFY_TIMEOUT_SEC  (30)
+
+/* Has to be a valid HIDL name, hwservicemanager checks the chain */
+#define BENCH_IFACE     "libgbinder.smbench@1.0::ISmBench"
+
+typedef struct app_options {
+    char* dev;
+    char* sm_protocol;
+    char* rpc_protocol;
+    char* counts;
+    char* tests;
+    int iterations;
+    int notify;
+} AppOptions;
+
+typedef struct app {
+    const AppOptions* opt;
+    GMainLoop* loop;
+    GBinderServiceManager* sm;
+    GPtrArray* objects;
+    GBinderLocalObject* obj;
+    char* prefix;
+    char* hit_name;
+    char* miss_name;
+    guint seq;
+    gint64 notify_end;
+    guint notify_timeout_id;
+    int ret;
+} App;
+
+typedef struct bench_samples {
+    gint64* ns;
+    guint count;
+    guint errors;
+} BenchSamples;
+
+static const char pname[] = "binder-sm-bench";
+
+/*==========================================================================*
+ * Utilities
+ *==========================================================================*/
+
+static
+gint64
+bench_now_ns(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gint64)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static
+int
+bench_compare_ns(
+    const void* a,
+    const void* b)
+{
+    const gint64 t1 = *(const gint64*)a;
+    const gint64 t2 = *(const gint64*)b;
+
+    return (t1 < t2) ? (-1) : (t1 > t2) ? 1 : 0;
+}
+
+static
+int
+bench_compare_count(
+    const void* a,
+    const void* b)
+{
+    const guint c1 = *(const guint*)a;
+    const guint c2 = *(const guint*)b;
+
+    return (c1 < c2) ? (-1) : (c1 > c2) ? 1 : 0;
+}
+
+static
+void
+bench_samples_init(
+    BenchSamples* samples,
+    guint max)
+{
+    memset(samples, 0, sizeof(*samples));
+    samples->ns = g_new(gint64, max);
+}
+
+static
+void
+bench_samples_clear(
+    BenchSamples* samples)
+{
+    g_free(samples->ns);
+    memset(samples, 0, sizeof(*samples));
+}
+
+static
+void
+bench_samples_add(
+    BenchSamples* samples,
+    gboolean ok,
+    gint64 start)
+{
+    const gint64 end = bench_now_ns();
+
+    if (ok) {
+        samples->ns[samples->count++] = end - start;
+    } else {
+        samples->errors++;
+    }
+}
+
+static
+double
+bench_percentile_us(
+    const BenchSamples* samples,
+    guint p)
+{
+    /* Samples must be sorted */
+    return samples->count ?
+        samples->ns[(samples->count - 1) * p / 100] / 1000.0 : 0.0;
+}
+
+static
+void
+bench_print_latency(
+    BenchSamples* samples,
+    gint64 elapsed_ns)
+{
+    gint64 total = 0;
+    guint i;
+
+    qsort(samples->ns, samples->count, sizeof(gint64), bench_compare_ns);
+    for (i = 0; i < samples->count; i++) {
+        total += samples->ns[i];
+    }
+    printf("\"calls\":%u,\"errors\":%u,\"min_us\":%.3f,\"mean_us\":%.3f,"
+        "\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f,"
+        "\"calls_per_sec\":%.1f", samples->count, samples->errors,
+        bench_percentile_us(samples, 0), samples->count ?
+        (total / 1000.0 / samples->count) : 0.0,
+        bench_percentile_us(samples, 50), bench_percentile_us(samples, 90),
+        bench_percentile_us(samples, 99), bench_percentile_us(samples, 100),
+        elapsed_ns ? (samples->count * 1e9 / elapsed_ns) : 0.0);
+}
+
+static
+void
+bench_report(
+    App* app,
+    const char* test,
+    BenchSamples* samples,
+    gint64 elapsed_ns)
+{
+    printf("{\"test\":\"%s\",\"services\":%u,", test, app->objects->len);
+    bench_print_latency(samples, elapsed_ns);
+    printf("}\n");
+}
+
+/*==========================================================================*
+ * Services
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+bench_service_reply(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    /* Nobody is supposed to call these */
+    *status = GBINDER_STATUS_FAILED;
+    return NULL;
+}
+
+static
+GBinderLocalObject*
+bench_service_new(
+    App* app)
+{
+    return gbinder_servicemanager_new_local_object(app->sm, BENCH_IFACE,
+        bench_service_reply, app);
+}
+
+static
+char*
+bench_service_name(
+    App* app)
+{
+    /* Unique per process and never reused */
+    return g_strdup_printf("%s%u", app->prefix, app->seq++);
+}
+
+static
+gboolean
+bench_register(
+    App* app,
+    guint count)
+{
+    /*
+     * There's no way to unregister a service other than by dropping
+     * the object, and service managers don't all notice that right away.
+     * So the services only ever get added, and the counts are sorted.
+     */
+    while (app->objects->len < count) {
+        GBinderLocalObject* obj = bench_service_new(app);
+        char* name = bench_service_name(app);
+        const int status = gbinder_servicemanager_add_service_sync(app->sm,
+            name, obj);
+
+        if (status == GBINDER_STATUS_OK) {
+            g_ptr_array_add(app->objects, obj);
+            g_free(name);
+        } else {
+            GERR("Failed to add \"%s\" (%d)", name, status);
+            gbinder_local_object_unref(obj);
+            g_free(name);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*==========================================================================*
+ * Benchmarks
+ *==========================================================================*/
+
+static
+gboolean
+bench_list_once(
+    App* app,
+    guint* count)
+{
+    char** services = gbinder_servicemanager_list_sync(app->sm);
+
+    if (services) {
+        *count = g_strv_length(services);
+        g_strfreev(services);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static
+void
+bench_list(
+    App* app)
+{
+    const guint n = app->opt->iterations;
+    BenchSamples samples;
+    guint i, names = 0;
+    gint64 start;
+
+    bench_samples_init(&samples, n);
+    for (i = 0; i < WARMUP_ITERATIONS; i++) {
+        bench_list_once(app, &names);
+    }
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        const gint64 t = bench_now_ns();
+
+        bench_samples_add(&samples, bench_list_once(app, &names), t);
+    }
+
+    /* The total includes the services registered by everybody else */
+    printf("{\"test\":\"list\",\"services\":%u,\"names\":%u,",
+        app->objects->len, names);
+    bench_print_latency(&samples, bench_now_ns() - start);
+    printf("}\n");
+    bench_samples_clear(&samples);
+}
+
+static
+gboolean
+bench_get_once(
+    App* app,
+    const char* name,
+    gboolean expect_found)
+{
+    int status = GBINDER_STATUS_OK;
+    GBinderRemoteObject* obj = gbinder_servicemanager_get_service_sync
+        (app->sm, name, &status);
+
+    /* The reference is owned by the service manager */
+    return expect_found ? (obj != NULL) :
+        (!obj && status != GBINDER_STATUS_DEAD_OBJECT);
+}
+
+static
+void
+bench_get(
+    App* app,
+    const char* test,
+    const char* name,
+    gboolean expect_found)
+{
+    const guint n = app->opt->iterations;
+    BenchSamples samples;
+    gint64 start;
+    guint i;
+
+    bench_samples_init(&samples, n);
+    for (i = 0; i < WARMUP_ITERATIONS; i++) {
+        bench_get_once(app, name, expect_found);
+    }
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        const gint64 t = bench_now_ns();
+
+        bench_samples_add(&samples, bench_get_once(app, name, expect_found), t);
+    }
+    bench_report(app, test, &samples, bench_now_ns() - start);
+    bench_samples_clear(&samples);
+}
+
+static
+void
+bench_add(
+    App* app)
+{
+    /*
+     * Registering the same name over and over again, so that the number
+     * of services stays the same. Both AIDL and HIDL service managers
+     * simply replace the existing entry.
+     */
+    const guint n = app->opt->iterations;
+    BenchSamples samples;
+    gint64 start;
+    guint i;
+
+    bench_samples_init(&samples, n);
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        const gint64 t = bench_now_ns();
+
+        bench_samples_add(&samples, gbinder_servicemanager_add_service_sync
+            (app->sm, app->hit_name, app->obj) == GBINDER_STATUS_OK, t);
+    }
+    bench_report(app, "add", &samples, bench_now_ns() - start);
+    bench_samples_clear(&samples);
+}
+
+static
+void
+bench_notify_registered(
+    GBinderServiceManager* sm,
+    const char* name,
+    void* user_data)
+{
+    App* app = user_data;
+
+    if (!app->notify_end) {
+        app->notify_end = bench_now_ns();
+        g_main_loop_quit(app->loop);
+    }
+}
+
+static
+void
+bench_notify_added(
+    GBinderServiceManager* sm,
+    int status,
+    void* user_data)
+{
+    App* app = user_data;
+
+    if (status != GBINDER_STATUS_OK) {
+        GERR("Failed to add service (%d)", status);
+        g_main_loop_quit(app->loop);
+    }
+}
+
+static
+gboolean
+bench_notify_timeout(
+    gpointer user_data)
+{
+    App* app = user_data;
+
+    GERR("No registration notification in %d sec", NOTIFY_TIMEOUT_SEC);
+    app->notify_timeout_id = 0;
+    g_main_loop_quit(app->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+bench_notify(
+    App* app)
+{
+    /*
+     * Time from adding a service to the registration handler being
+     * invoked. For service managers which don't support notifications
+     * that's how long it takes to detect the new name by polling (see
+     * ServicePollInterval). Each iteration adds a new service, those
+     * count towards the next measurement.
+     */
+    const guint n = app->opt->notify;
+    const guint services = app->objects->len;
+    BenchSamples samples;
+    gint64 start;
+    guint i;
+
+    bench_samples_init(&samples, n);
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        GBinderLocalObject* obj = bench_service_new(app);
+        char* name = bench_service_name(app);
+        gulong id = gbinder_servicemanager_add_registration_handler(app->sm,
+            name, bench_notify_registered, app);
+        gint64 t;
+
+        app->notify_end = 0;
+        app->notify_timeout_id = g_timeout_add_seconds(NOTIFY_TIMEOUT_SEC,
+            bench_notify_timeout, app);
+        t = bench_now_ns();
+        gbinder_servicemanager_add_service(app->sm, name, obj,
+            bench_notify_added, app);
+        g_main_loop_run(app->loop);
+        if (app->notify_end) {
+            samples.ns[samples.count++] = app->notify_end - t;
+        } else {
+            samples.errors++;
+        }
+        if (app->notify_timeout_id) {
+            g_source_remove(app->notify_timeout_id);
+            app->notify_timeout_id = 0;
+        }
+        gbinder_servicemanager_remove_handler(app->sm, id);
+        g_ptr_array_add(app->objects, obj);
+        g_free(name);
+    }
+    printf("{\"test\":\"notify\",\"services\":%u,", services);
+    bench_print_latency(&samples, bench_now_ns() - start);
+    printf("}\n");
+    bench_samples_clear(&samples);
+}
+
+static
+void
+bench_run_tests(
+    App* app,
+    char** tests)
+{
+    char** ptr;
+
+    for (ptr = tests; *ptr && app->ret == RET_OK; ptr++) {
+        const char* test = *ptr;
+
+        GDEBUG("Running %s with %u services", test, app->objects->len);
+        if (!strcmp(test, "list")) {
+            bench_list(app);
+        } else if (!strcmp(test, "get_hit")) {
+            bench_get(app, test, app->hit_name, TRUE);
+        } else if (!strcmp(test, "get_miss")) {
+            bench_get(app, test, app->miss_name, FALSE);
+        } else if (!strcmp(test, "add")) {
+            bench_add(app);
+        } else if (!strcmp(test, "notify")) {
+            bench_notify(app);
+        } else {
+            GERR("Unknown test \"%s\"", test);
+            app->ret = RET_INVARG;
+        }
+        fflush(stdout);
+    }
+}
+
+static
+void
+app_run(
+    App* app)
+{
+    const AppOptions* opt = app->opt;
+    const char* dev = gbinder_servicemanager_device(app->sm);
+    char** tests = g_strsplit(opt->tests, ",", -1);
+    char** list = g_strsplit(opt->counts, ",", -1);
+    const guint ncounts = g_strv_length(list);
+    guint* counts = g_new(guint, ncounts);
+    guint i;
+
+    for (i = 0; i < ncounts; i++) {
+        counts[i] = strtoul(list[i], NULL, 0);
+    }
+    qsort(counts, ncounts, sizeof(guint), bench_compare_count);
+
+    /* hwservicemanager wants fully qualified names */
+    if (opt->sm_protocol ? !strcmp(opt->sm_protocol, "hidl") :
+        !strcmp(dev, GBINDER_DEFAULT_HWBINDER)) {
+        app->prefix = g_strdup_printf("%s/%s-%d-", BENCH_IFACE, pname,
+            (int)getpid());
+    } else {
+        app->prefix = g_strdup_printf("%s-%d-", pname, (int)getpid());
+    }
+    app->hit_name = bench_service_name(app);
+    app->miss_name = g_strconcat(app->prefix, "missing", NULL);
+    app->objects = g_ptr_array_new_with_free_func((GDestroyNotify)
+        gbinder_local_object_unref);
+    app->obj = bench_service_new(app);
+    app->loop = g_main_loop_new(NULL, FALSE);
+
+    /* This one isn't counted, it's there for get_hit and add */
+    if (gbinder_servicemanager_add_service_sync(app->sm, app->hit_name,
+        app->obj) == GBINDER_STATUS_OK) {
+        app->ret = RET_OK;
+        for (i = 0; i < ncounts && app->ret == RET_OK; i++) {
+            if (bench_register(app, counts[i])) {
+                bench_run_tests(app, tests);
+            } else {
+                app->ret = RET_ERR;
+            }
+        }
+    } else {
+        GERR("Failed to add \"%s\"", app->hit_name);
+        app->ret = RET_ERR;
+    }
+
+    g_main_loop_unref(app->loop);
+    g_ptr_array_free(app->objects, TRUE);
+    gbinder_local_object_unref(app->obj);
+    g_free(app->prefix);
+    g_free(app->hit_name);
+    g_free(app->miss_name);
+    g_free(counts);
+    g_strfreev(list);
+    g_strfreev(tests);
+    app->loop = NULL;
+    app->objects = NULL;
+    app->obj = NULL;
+}
+
+/*==========================================================================*
+ * Options
+ *==========================================================================*/
+
+static
+gboolean
+app_log_verbose(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_VERBOSE;
+    return TRUE;
+}
+
+static
+gboolean
+app_log_quiet(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_ERR;
+    return TRUE;
+}
+
+static
+gboolean
+app_init(
+    AppOptions* opt,
+    int argc,
+    char* argv[])
+{
+    gboolean ok = FALSE;
+    GOptionEntry entries[] = {
+        { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_verbose, "Enable verbose output", NULL },
+        { "quiet", 'q', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_quiet, "Be quiet", NULL },
+        { "device", 'd', 0, G_OPTION_ARG_STRING, &opt->dev,
+          "Binder device [" DEFAULT_DEVICE "]", "DEVICE" },
+        { "servicemanager", 'm', 0, G_OPTION_ARG_STRING, &opt->sm_protocol,
+          "Service manager (aidl, aidl2, aidl3, aidl4 or hidl) [from "
+          "config]", "SM" },
+        { "protocol", 'p', 0, G_OPTION_ARG_STRING, &opt->rpc_protocol,
+          "RPC protocol [from config]", "PROTOCOL" },
+        { "iterations", 'n', 0, G_OPTION_ARG_INT, &opt->iterations,
+          "Calls per measurement [" G_STRINGIFY(DEFAULT_ITERATIONS) "]",
+          "COUNT" },
+        { "notify", 'N', 0, G_OPTION_ARG_INT, &opt->notify,
+          "Registrations per notification measurement ["
+          G_STRINGIFY(DEFAULT_NOTIFY) "]", "COUNT" },
+        { "counts", 'c', 0, G_OPTION_ARG_STRING, &opt->counts,
+          "Numbers of services to register [" DEFAULT_COUNTS "]", "LIST" },
+        { "tests", 'T', 0, G_OPTION_ARG_STRING, &opt->tests,
+          "Tests to run [" DEFAULT_TESTS "]", "LIST" },
+        { NULL }
+    };
+
+    GError* error = NULL;
+    GOptionContext* options = g_option_context_new(NULL);
+
+    memset(opt, 0, sizeof(*opt));
+    opt->iterations = DEFAULT_ITERATIONS;
+    opt->notify = DEFAULT_NOTIFY;
+
+    gutil_log_timestamp = FALSE;
+    gutil_log_set_type(GLOG_TYPE_STDERR, pname);
+    gutil_log_default.level = GLOG_LEVEL_DEFAULT;
+
+    g_option_context_set_summary(options, "Measures service manager "
+        "operations with the given numbers of services\nregistered by "
+        "this process. Results are printed to stdout as JSON objects,\n"
+        "one per line.");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        if (!opt->dev || !opt->dev[0]) {
+            g_free(opt->dev);
+            opt->dev = g_strdup(DEFAULT_DEVICE);
+        }
+        if (!opt->counts) opt->counts = g_strdup(DEFAULT_COUNTS);
+        if (!opt->tests) opt->tests = g_strdup(DEFAULT_TESTS);
+        if (opt->iterations > 0 && opt->notify >= 0 && argc == 1) {
+            ok = TRUE;
+        } else {
+            char* help = g_option_context_get_help(options, TRUE, NULL);
+
+            fprintf(stderr, "%s", help);
+            g_free(help);
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    App app;
+    AppOptions opt;
+
+    memset(&app, 0, sizeof(app));
+    app.ret = RET_INVARG;
+    app.opt = &opt;
+    if (app_init(&opt, argc, argv)) {
+        app.sm = gbinder_servicemanager_new2(opt.dev, opt.sm_protocol,
+            opt.rpc_protocol);
+        if (!app.sm) {
+            GERR("Can't open %s", opt.dev);
+        } else if (gbinder_servicemanager_wait(app.sm, -1)) {
+            app_run(&app);
+        } else {
+            GERR("No servicemanager at %s", opt.dev);
+            app.ret = RET_NOTFOUND;
+        }
+        gbinder_servicemanager_unref(app.sm);
+    }
+    g_free(opt.dev);
+    g_free(opt.sm_protocol);
+    g_free(opt.rpc_protocol);
+    g_free(opt.counts);
+    g_free(opt.tests);
+    return app.ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
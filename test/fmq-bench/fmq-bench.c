@@ -0,0 +1,649 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gbinder.h>
+
+#include <gutil_log.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RET_OK          (0)
+#define RET_INVARG      (2)
+#define RET_ERR         (3)
+
+#define DEFAULT_ITEMS       (1000000)
+#define DEFAULT_LATENCY     (10000)
+#define DEFAULT_QUEUE_SIZE  (1024)
+#define DEFAULT_BATCH       (16)
+#define DEFAULT_SPIN_NS     (20000)
+#define DEFAULT_SIZES       "16,64,256,1024"
+#define DEFAULT_TYPES       "sync,unsync"
+#define DEFAULT_MODE        "block"
+
+#define FMQ_NOT_EMPTY   GBINDER_FMQ_NOT_EMPTY
+#define FMQ_NOT_FULL    GBINDER_FMQ_NOT_FULL
+#define FMQ_ACK         (0x04)
+#define FMQ_IDLE_MS     (1000) /* Unsync reader gives up after that */
+
+typedef enum bench_mode {
+    BENCH_MODE_POLL,
+    BENCH_MODE_BLOCK,
+    BENCH_MODE_SPIN
+} BENCH_MODE;
+
+typedef struct app_options {
+    char* sizes;
+    char* types;
+    char* mode_name;
+    BENCH_MODE mode;
+    gboolean align;
+    gboolean huge;
+    int items;
+    int latency;
+    int queue_size;
+    int batch;
+    int spin_ns;
+} AppOptions;
+
+/* Every item starts with this, the rest is padding */
+typedef struct bench_item {
+    gint64 ns;
+    guint64 seq;
+} BenchItem;
+
+typedef struct bench_run {
+    const AppOptions* opt;
+    GBinderFmq* fmq;
+    GBINDER_FMQ_TYPE type;
+    const char* type_name;
+    gsize item_size;
+    guint8* buf;
+} BenchRun;
+
+static const char pname[] = "fmq-bench";
+
+/*==========================================================================*
+ * Utilities
+ *==========================================================================*/
+
+static
+gint64
+bench_now_ns(
+    void)
+{
+    /* CLOCK_MONOTONIC is the same clock in both processes */
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gint64)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static
+int
+bench_compare_ns(
+    const void* a,
+    const void* b)
+{
+    const gint64 t1 = *(const gint64*)a;
+    const gint64 t2 = *(const gint64*)b;
+
+    return (t1 < t2) ? (-1) : (t1 > t2) ? 1 : 0;
+}
+
+static
+double
+bench_percentile_us(
+    const gint64* ns,
+    guint count,
+    guint p)
+{
+    /* Samples must be sorted */
+    return count ? ns[(count - 1) * p / 100] / 1000.0 : 0.0;
+}
+
+static
+void
+bench_print_header(
+    const BenchRun* run,
+    const char* test)
+{
+    printf("{\"test\":\"%s\",\"type\":\"%s\",\"mode\":\"%s\","
+        "\"item_size\":%u,\"queue_size\":%d", test, run->type_name,
+        run->opt->mode_name, (guint)run->item_size, run->opt->queue_size);
+}
+
+static
+void
+bench_stamp(
+    BenchRun* run,
+    gsize first,
+    guint64 seq,
+    gsize count)
+{
+    const gint64 now = bench_now_ns();
+    gsize i;
+
+    for (i = first; i < count; i++) {
+        BenchItem* item = (BenchItem*)(run->buf + i * run->item_size);
+
+        item->ns = now;
+        item->seq = seq + i;
+    }
+}
+
+static
+const BenchItem*
+bench_item(
+    const BenchRun* run,
+    gsize i)
+{
+    return (const BenchItem*)(run->buf + i * run->item_size);
+}
+
+/*==========================================================================*
+ * Transfer
+ *==========================================================================*/
+
+static
+gsize
+bench_write(
+    BenchRun* run,
+    guint64 seq,
+    gsize count)
+{
+    GBinderFmq* fmq = run->fmq;
+
+    bench_stamp(run, 0, seq, count);
+    if (run->opt->mode == BENCH_MODE_POLL) {
+        gsize done = 0;
+
+        /* Keep re-stamping the rest until it fits */
+        while ((done += gbinder_fmq_write_batch(fmq, run->buf + done *
+            run->item_size, count - done)) < count) {
+            bench_stamp(run, done, seq, count);
+        }
+        gbinder_fmq_wake(fmq, FMQ_NOT_EMPTY);
+        return count;
+    } else {
+        return gbinder_fmq_write_blocking(fmq, run->buf, count,
+            FMQ_NOT_FULL, FMQ_NOT_EMPTY, -1) ? 0 : count;
+    }
+}
+
+static
+gsize
+bench_read(
+    BenchRun* run,
+    gsize count,
+    int timeout_ms)
+{
+    GBinderFmq* fmq = run->fmq;
+
+    if (run->opt->mode == BENCH_MODE_POLL) {
+        const gint64 deadline = bench_now_ns() + timeout_ms * 1000000LL;
+
+        do {
+            const gsize n = gbinder_fmq_read_batch(fmq, run->buf, count);
+
+            if (n) {
+                gbinder_fmq_wake(fmq, FMQ_NOT_FULL);
+                return n;
+            }
+        } while (bench_now_ns() < deadline);
+        return 0;
+    } else {
+        return gbinder_fmq_read_blocking(fmq, run->buf, count,
+            FMQ_NOT_FULL, FMQ_NOT_EMPTY, timeout_ms) ? 0 : count;
+    }
+}
+
+static
+gboolean
+bench_wait_ack(
+    BenchRun* run)
+{
+    guint32 state;
+
+    if (run->opt->mode == BENCH_MODE_POLL) {
+        while (gbinder_fmq_try_wait(run->fmq, FMQ_ACK, &state) == -ETIMEDOUT);
+        return TRUE;
+    } else {
+        int ret;
+
+        while ((ret = gbinder_fmq_wait(run->fmq, FMQ_ACK, &state)) ==
+            -EAGAIN);
+        return ret == 0;
+    }
+}
+
+/*==========================================================================*
+ * Consumer (child process)
+ *==========================================================================*/
+
+static
+void
+bench_consume_throughput(
+    BenchRun* run)
+{
+    const AppOptions* opt = run->opt;
+    const guint64 total = opt->items;
+    const int timeout = (run->type == GBINDER_FMQ_TYPE_UNSYNC_WRITE) ?
+        FMQ_IDLE_MS : -1;
+    gint64* lat = g_new(gint64, total);
+    gint64 first_ns = 0, last_ns = 0, sum = 0;
+    guint64 expected = 0, received = 0, lost = 0;
+    guint i, count;
+
+    while (expected < total) {
+        const gsize n = bench_read(run, MIN((guint64)opt->batch,
+            total - expected), timeout);
+        const gint64 now = bench_now_ns();
+        gsize k;
+
+        if (!n) {
+            /* The rest got overwritten by the unsync writer */
+            break;
+        }
+        for (k = 0; k < n; k++) {
+            const BenchItem* item = bench_item(run, k);
+
+            if (!received) {
+                first_ns = item->ns;
+            }
+            if (item->seq > expected) {
+                lost += item->seq - expected;
+            }
+            expected = item->seq + 1;
+            lat[received++] = now - item->ns;
+            last_ns = now;
+        }
+    }
+    lost += total - expected;
+
+    count = (guint)received;
+    qsort(lat, count, sizeof(gint64), bench_compare_ns);
+    for (i = 0; i < count; i++) {
+        sum += lat[i];
+    }
+
+    bench_print_header(run, "throughput");
+    printf(",\"items\":%" G_GUINT64_FORMAT ",\"lost\":%" G_GUINT64_FORMAT
+        ",\"elapsed_ms\":%.3f,\"items_per_sec\":%.1f,\"bytes_per_sec\":%.1f,"
+        "\"mean_us\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f}\n", received,
+        lost, (last_ns - first_ns) / 1e6, (last_ns > first_ns) ?
+        (received * 1e9 / (last_ns - first_ns)) : 0.0, (last_ns > first_ns) ?
+        (received * run->item_size * 1e9 / (last_ns - first_ns)) : 0.0,
+        count ? (sum / 1000.0 / count) : 0.0,
+        bench_percentile_us(lat, count, 50),
+        bench_percentile_us(lat, count, 99));
+    g_free(lat);
+}
+
+static
+void
+bench_consume_latency(
+    BenchRun* run)
+{
+    const guint total = run->opt->latency;
+    gint64* lat = g_new(gint64, total);
+    gint64 sum = 0;
+    guint i, count = 0;
+
+    for (i = 0; i < total; i++) {
+        if (bench_read(run, 1, FMQ_IDLE_MS)) {
+            lat[count++] = bench_now_ns() - bench_item(run, 0)->ns;
+        }
+        gbinder_fmq_wake(run->fmq, FMQ_ACK);
+    }
+
+    qsort(lat, count, sizeof(gint64), bench_compare_ns);
+    for (i = 0; i < count; i++) {
+        sum += lat[i];
+    }
+    bench_print_header(run, "latency");
+    printf(",\"items\":%u,\"lost\":%u,\"min_us\":%.3f,\"mean_us\":%.3f,"
+        "\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f}\n",
+        count, total - count, bench_percentile_us(lat, count, 0), count ?
+        (sum / 1000.0 / count) : 0.0, bench_percentile_us(lat, count, 50),
+        bench_percentile_us(lat, count, 90),
+        bench_percentile_us(lat, count, 99),
+        bench_percentile_us(lat, count, 100));
+    g_free(lat);
+}
+
+static
+void
+bench_consumer(
+    BenchRun* run)
+{
+    /* Let the producer know that we are ready */
+    gbinder_fmq_wake(run->fmq, FMQ_ACK);
+    bench_consume_throughput(run);
+    gbinder_fmq_wake(run->fmq, FMQ_ACK);
+    bench_consume_latency(run);
+    fflush(stdout);
+}
+
+/*==========================================================================*
+ * Producer (parent process)
+ *==========================================================================*/
+
+static
+gboolean
+bench_producer(
+    BenchRun* run)
+{
+    const AppOptions* opt = run->opt;
+    const guint64 total = opt->items;
+    guint64 seq;
+    int i;
+
+    /* Throughput */
+    if (!bench_wait_ack(run)) {
+        return FALSE;
+    }
+    for (seq = 0; seq < total; ) {
+        const gsize n = bench_write(run, seq, MIN((guint64)opt->batch,
+            total - seq));
+
+        if (!n) {
+            GERR("FMQ write failed");
+            return FALSE;
+        }
+        seq += n;
+    }
+
+    /* One item at a time, waiting for the consumer to get it */
+    if (!bench_wait_ack(run)) {
+        return FALSE;
+    }
+    for (i = 0; i < opt->latency; i++) {
+        if (!bench_write(run, i, 1) || !bench_wait_ack(run)) {
+            GERR("FMQ latency round %d failed", i);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static
+gboolean
+bench_run(
+    const AppOptions* opt,
+    GBINDER_FMQ_TYPE type,
+    const char* type_name,
+    gsize item_size)
+{
+    GBINDER_FMQ_FLAGS flags = GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG |
+        GBINDER_FMQ_FLAG_PREFAULT;
+    gboolean ok = FALSE;
+    BenchRun run;
+
+    if (opt->align) flags |= GBINDER_FMQ_FLAG_ALIGN_COUNTERS;
+    if (opt->huge) flags |= GBINDER_FMQ_FLAG_HUGE_PAGES;
+
+    memset(&run, 0, sizeof(run));
+    run.opt = opt;
+    run.type = type;
+    run.type_name = type_name;
+    run.item_size = MAX(item_size, sizeof(BenchItem));
+    run.fmq = gbinder_fmq_new(run.item_size, opt->queue_size, type, flags,
+        -1, 0);
+    if (run.fmq) {
+        pid_t pid;
+
+        /* Both ends are us, so lazy wake is safe */
+        switch (opt->mode) {
+        case BENCH_MODE_POLL:
+            gbinder_fmq_set_spin(run.fmq, 0, GBINDER_FMQ_SPIN_LAZY_WAKE);
+            break;
+        case BENCH_MODE_SPIN:
+            gbinder_fmq_set_spin(run.fmq, opt->spin_ns,
+                GBINDER_FMQ_SPIN_LAZY_WAKE);
+            break;
+        case BENCH_MODE_BLOCK:
+            break;
+        }
+
+        run.buf = g_malloc0(run.item_size * MAX(opt->batch, 1));
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0) {
+            /* The mapping is shared, each process has its own counters */
+            bench_consumer(&run);
+            _exit(0);
+        } else if (pid > 0) {
+            int status = 0;
+
+            ok = bench_producer(&run);
+            if (!ok) {
+                kill(pid, SIGTERM);
+            }
+            if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+                WEXITSTATUS(status)) {
+                ok = FALSE;
+            }
+        } else {
+            GERR("fork failed: %s", strerror(errno));
+        }
+        g_free(run.buf);
+        gbinder_fmq_unref(run.fmq);
+    } else {
+        GERR("Failed to create %s FMQ", type_name);
+    }
+    return ok;
+}
+
+static
+int
+app_run(
+    const AppOptions* opt)
+{
+    char** types = g_strsplit(opt->types, ",", -1);
+    char** sizes = g_strsplit(opt->sizes, ",", -1);
+    char** t;
+    int ret = RET_OK;
+
+    for (t = types; *t && ret == RET_OK; t++) {
+        GBINDER_FMQ_TYPE type;
+        char** s;
+
+        if (!strcmp(*t, "sync")) {
+            type = GBINDER_FMQ_TYPE_SYNC_READ_WRITE;
+        } else if (!strcmp(*t, "unsync")) {
+            type = GBINDER_FMQ_TYPE_UNSYNC_WRITE;
+        } else {
+            GERR("Unknown queue type \"%s\"", *t);
+            ret = RET_INVARG;
+            break;
+        }
+        for (s = sizes; *s && ret == RET_OK; s++) {
+            const int size = atoi(*s);
+
+            if (size <= 0) {
+                GERR("Invalid item size \"%s\"", *s);
+                ret = RET_INVARG;
+            } else if (!bench_run(opt, type, *t, size)) {
+                ret = RET_ERR;
+            }
+            fflush(stdout);
+        }
+    }
+    g_strfreev(types);
+    g_strfreev(sizes);
+    return ret;
+}
+
+/*==========================================================================*
+ * Options
+ *==========================================================================*/
+
+static
+gboolean
+app_log_verbose(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_VERBOSE;
+    return TRUE;
+}
+
+static
+gboolean
+app_log_quiet(
+    const gchar* name,
+    const gchar* value,
+    gpointer data,
+    GError** error)
+{
+    gutil_log_default.level = GLOG_LEVEL_ERR;
+    return TRUE;
+}
+
+static
+gboolean
+app_init(
+    AppOptions* opt,
+    int argc,
+    char* argv[])
+{
+    gboolean ok = FALSE;
+    GOptionEntry entries[] = {
+        { "verbose", 'v', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_verbose, "Enable verbose output", NULL },
+        { "quiet", 'q', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
+          app_log_quiet, "Be quiet", NULL },
+        { "items", 'n', 0, G_OPTION_ARG_INT, &opt->items,
+          "Items per throughput run [" G_STRINGIFY(DEFAULT_ITEMS) "]",
+          "COUNT" },
+        { "latency", 'l', 0, G_OPTION_ARG_INT, &opt->latency,
+          "Items per latency run [" G_STRINGIFY(DEFAULT_LATENCY) "]",
+          "COUNT" },
+        { "queue", 'Q', 0, G_OPTION_ARG_INT, &opt->queue_size,
+          "Queue size in items [" G_STRINGIFY(DEFAULT_QUEUE_SIZE) "]",
+          "COUNT" },
+        { "batch", 'b', 0, G_OPTION_ARG_INT, &opt->batch,
+          "Items per read/write [" G_STRINGIFY(DEFAULT_BATCH) "]", "COUNT" },
+        { "sizes", 'S', 0, G_OPTION_ARG_STRING, &opt->sizes,
+          "Item sizes [" DEFAULT_SIZES "]", "LIST" },
+        { "types", 't', 0, G_OPTION_ARG_STRING, &opt->types,
+          "Queue types [" DEFAULT_TYPES "]", "LIST" },
+        { "mode", 'm', 0, G_OPTION_ARG_STRING, &opt->mode_name,
+          "Waiting mode: poll, block or spin [" DEFAULT_MODE "]", "MODE" },
+        { "spin", 0, 0, G_OPTION_ARG_INT, &opt->spin_ns,
+          "Spin time in spin mode [" G_STRINGIFY(DEFAULT_SPIN_NS) "]", "NS" },
+        { "align", 'a', 0, G_OPTION_ARG_NONE, &opt->align,
+          "Put the counters on separate cache lines", NULL },
+        { "huge-pages", 'H', 0, G_OPTION_ARG_NONE, &opt->huge,
+          "Use huge pages if available", NULL },
+        { NULL }
+    };
+
+    GError* error = NULL;
+    GOptionContext* options = g_option_context_new(NULL);
+
+    memset(opt, 0, sizeof(*opt));
+    opt->items = DEFAULT_ITEMS;
+    opt->latency = DEFAULT_LATENCY;
+    opt->queue_size = DEFAULT_QUEUE_SIZE;
+    opt->batch = DEFAULT_BATCH;
+    opt->spin_ns = DEFAULT_SPIN_NS;
+
+    gutil_log_timestamp = FALSE;
+    gutil_log_set_type(GLOG_TYPE_STDERR, pname);
+    gutil_log_default.level = GLOG_LEVEL_DEFAULT;
+
+    g_option_context_set_summary(options, "Measures FMQ throughput and "
+        "one-way latency between two processes.\nResults are printed to "
+        "stdout as JSON objects, one per line.");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error)) {
+        if (!opt->sizes) opt->sizes = g_strdup(DEFAULT_SIZES);
+        if (!opt->types) opt->types = g_strdup(DEFAULT_TYPES);
+        if (!opt->mode_name) opt->mode_name = g_strdup(DEFAULT_MODE);
+        if (!strcmp(opt->mode_name, "poll")) {
+            opt->mode = BENCH_MODE_POLL;
+            ok = TRUE;
+        } else if (!strcmp(opt->mode_name, "block")) {
+            opt->mode = BENCH_MODE_BLOCK;
+            ok = TRUE;
+        } else if (!strcmp(opt->mode_name, "spin")) {
+            opt->mode = BENCH_MODE_SPIN;
+            ok = TRUE;
+        } else {
+            GERR("Unknown mode \"%s\"", opt->mode_name);
+        }
+        if (ok && (opt->items <= 0 || opt->latency <= 0 || argc > 1 ||
+            opt->queue_size <= 0 || opt->batch <= 0 || opt->spin_ns < 0 ||
+            opt->batch > opt->queue_size)) {
+            char* help = g_option_context_get_help(options, TRUE, NULL);
+
+            fprintf(stderr, "%s", help);
+            g_free(help);
+            ok = FALSE;
+        }
+    } else {
+        GERR("%s", error->message);
+        g_error_free(error);
+    }
+    g_option_context_free(options);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    AppOptions opt;
+    int ret = RET_INVARG;
+
+    if (app_init(&opt, argc, argv)) {
+        ret = app_run(&opt);
+    }
+    g_free(opt.sizes);
+    g_free(opt.types);
+    g_free(opt.mode_name);
+    return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_alloc.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+#ifdef __GLIBC__
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+static __thread gboolean test_alloc_thread_active
+    __attribute__((tls_model("initial-exec")));
+static __thread guint test_alloc_thread_count
+    __attribute__((tls_model("initial-exec")));
+static gint test_alloc_all_active;
+static gint test_alloc_all_count;
+
+static
+void
+__attribute__((constructor))
+test_alloc_init(
+    void)
+{
+    /* Make g_slice go through malloc (it always does since glib 2.76) */
+    setenv("G_SLICE", "always-malloc", FALSE);
+}
+
+static
+void
+test_alloc_count(
+    void)
+{
+    if (test_alloc_thread_active) {
+        test_alloc_thread_count++;
+    }
+    if (g_atomic_int_get(&test_alloc_all_active)) {
+        g_atomic_int_inc(&test_alloc_all_count);
+    }
+}
+
+void*
+malloc(
+    size_t size)
+{
+    test_alloc_count();
+    return __libc_malloc(size);
+}
+
+void*
+calloc(
+    size_t nmemb,
+    size_t size)
+{
+    test_alloc_count();
+    return __libc_calloc(nmemb, size);
+}
+
+void*
+realloc(
+    void* ptr,
+    size_t size)
+{
+    /* Shrinking and freeing are not allocations */
+    if (size) {
+        test_alloc_count();
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void*
+memalign(
+    size_t alignment,
+    size_t size)
+{
+    test_alloc_count();
+    return __libc_memalign(alignment, size);
+}
+
+void*
+aligned_alloc(
+    size_t alignment,
+    size_t size)
+{
+    test_alloc_count();
+    return __libc_memalign(alignment, size);
+}
+
+int
+posix_memalign(
+    void** memptr,
+    size_t alignment,
+    size_t size)
+{
+    void* ptr;
+
+    test_alloc_count();
+    ptr = __libc_memalign(alignment, size);
+    if (ptr || !size) {
+        *memptr = ptr;
+        return 0;
+    }
+    return ENOMEM;
+}
+
+gboolean
+test_alloc_supported(
+    void)
+{
+    return TRUE;
+}
+
+void
+test_alloc_begin(
+    int flags)
+{
+    if (flags & TEST_ALLOC_ALL_THREADS) {
+        g_atomic_int_set(&test_alloc_all_count, 0);
+        g_atomic_int_set(&test_alloc_all_active, TRUE);
+    } else {
+        test_alloc_thread_count = 0;
+        test_alloc_thread_active = TRUE;
+    }
+}
+
+guint
+test_alloc_end(
+    void)
+{
+    if (g_atomic_int_get(&test_alloc_all_active)) {
+        g_atomic_int_set(&test_alloc_all_active, FALSE);
+        return g_atomic_int_get(&test_alloc_all_count);
+    } else {
+        test_alloc_thread_active = FALSE;
+        return test_alloc_thread_count;
+    }
+}
+
+#else /* !__GLIBC__ */
+
+gboolean
+test_alloc_supported(
+    void)
+{
+    return FALSE;
+}
+
+void
+test_alloc_begin(
+    int flags)
+{
+}
+
+guint
+test_alloc_end(
+    void)
+{
+    return 0;
+}
+
+#endif /* !__GLIBC__ */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TEST_ALLOC_H
+#define TEST_ALLOC_H
+
+#include "test_common.h"
+
+/*
+ * Allocation counting. The test executable which has test_alloc.c in its
+ * COMMON_SRC interposes malloc and friends (g_malloc and g_slice end up
+ * there too, the latter being switched to G_SLICE=always-malloc) and
+ * counts the allocations made between test_alloc_begin() and
+ * test_alloc_end(). Normally only the calling thread is counted, which
+ * keeps the unrelated activity on the other threads out of the picture.
+ * Counting is only supported with glibc, test_alloc_end() returns zero
+ * elsewhere.
+ */
+
+#define TEST_ALLOC_ALL_THREADS (0x01)
+
+gboolean
+test_alloc_supported(
+    void);
+
+void
+test_alloc_begin(
+    int flags);
+
+guint
+test_alloc_end(
+    void);
+
+/* Fails the test if the code makes more than budget allocations */
+#define test_assert_alloc_budget(budget, code) G_STMT_START { \
+    guint test_alloc_n_; \
+    test_alloc_begin(0); \
+    code; \
+    test_alloc_n_ = test_alloc_end(); \
+    g_assert_cmpuint(test_alloc_n_, <= ,budget); \
+    } G_STMT_END
+
+#endif /* TEST_ALLOC_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
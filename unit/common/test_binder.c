@@ -43,6 +43,7 @@ GLOG_MODULE_DEFINE2("test_binder", gutil_log_default);
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -56,10 +57,17 @@ static GHashTable* test_node_map = NULL;
 static GPrivate test_looper = G_PRIVATE_INIT(NULL);
 static GPrivate test_tx_state = G_PRIVATE_INIT(NULL);
 static guint32 last_auto_handle = 0;
+static GSList* test_watch_list = NULL;
+static gboolean test_watch_enabled = FALSE;
 
 G_LOCK_DEFINE_STATIC(test_binder);
 static GMainLoop* test_binder_exit_loop = NULL;
 
+typedef struct test_binder_watch {
+    char* path;
+    int fd; /* Our end of the socket pair */
+} TestBinderWatch;
+
 #define PUBLIC (0)
 #define PRIVATE (1)
 #define public_fd  node[PUBLIC].fd
@@ -150,6 +158,7 @@ typedef struct test_binder {
     TestBinderSubmitThread* submit_thread;
     GMutex mutex;
     gboolean passthrough;
+    gint write_read_count;
     TestBinderNode node[2];
 } TestBinder;
 
@@ -219,6 +228,7 @@ typedef  struct binder_buffer_64 {
 #define BC_ACQUIRE              _IOW('c', 5, guint32)
 #define BC_RELEASE              _IOW('c', 6, guint32)
 #define BC_DECREFS              _IOW('c', 7, guint32)
+#define BC_REGISTER_LOOPER       _IO('c', 11)
 #define BC_ENTER_LOOPER          _IO('c', 12)
 #define BC_EXIT_LOOPER           _IO('c', 13)
 #define BC_REQUEST_DEATH_NOTIFICATION_64 _IOW('c', 14, BinderHandleCookie64)
@@ -236,9 +246,13 @@ typedef  struct binder_buffer_64 {
 #define BR_RELEASE_64           _IOR('r', 9, BinderPtrCookie64)
 #define BR_DECREFS_64           _IOR('r', 10, BinderPtrCookie64)
 #define BR_NOOP                  _IO('r', 12)
+#define BR_SPAWN_LOOPER          _IO('r', 13)
 #define BR_DEAD_BINDER_64       _IOR('r', 15, guint64)
 #define BR_CLEAR_DEATH_NOTIFICATION_DONE_64 _IOR('r', 16, guint64)
 #define BR_FAILED_REPLY          _IO('r', 17)
+#define BR_FROZEN_REPLY          _IO('r', 18)
+#define BR_ONEWAY_SPAM_SUSPECT   _IO('r', 19)
+#define BR_TRANSACTION_PENDING_FROZEN _IO('r', 20)
 
 static
 gpointer
@@ -540,6 +554,8 @@ test_binder_cmd_read_flags(
 {
     switch (cmd) {
     case BR_TRANSACTION_COMPLETE:
+    case BR_ONEWAY_SPAM_SUSPECT:
+    case BR_TRANSACTION_PENDING_FROZEN:
         return READ_FLAG_TX_COMPLETION;
     case BR_TRANSACTION_64:
         return READ_FLAG_TX_INCOMING;
@@ -547,6 +563,7 @@ test_binder_cmd_read_flags(
         return READ_FLAG_TX_REPLY;
     case BR_FAILED_REPLY:
     case BR_DEAD_REPLY:
+    case BR_FROZEN_REPLY:
         return READ_FLAG_TX_ERROR;
     default:
         return READ_FLAG_TX_OTHER;
@@ -914,6 +931,7 @@ test_io_handle_write_read_64(
             case BC_FREE_BUFFER_64:
                 test_io_free_buffer(fd, GSIZE_TO_POINTER(*(guint64*)cmddata));
                 break;
+            case BC_REGISTER_LOOPER:
             case BC_ENTER_LOOPER:
                 g_assert(g_private_get(&test_looper) >= 0);
                 looper = g_atomic_int_add(&node->looper_count, 1) + 1;
@@ -993,6 +1011,8 @@ test_io_handle_write_read_64(
             g_assert_cmpint(nbytes, <= ,avail);
             switch (cmd[0]) {
             case BR_TRANSACTION_COMPLETE:
+            case BR_ONEWAY_SPAM_SUSPECT:
+            case BR_TRANSACTION_PENDING_FROZEN:
                 if (node_tx_state) {
                     g_assert(node_tx_state == my_tx_state);
                     switch (test_tx_state_get(my_tx_state)) {
@@ -1030,6 +1050,7 @@ test_io_handle_write_read_64(
                 break;
             case BR_FAILED_REPLY:
             case BR_DEAD_REPLY:
+            case BR_FROZEN_REPLY:
                 if (node_tx_state) {
                     g_assert(node_tx_state == my_tx_state);
                     test_tx_state_set(my_tx_state, TEST_TX_STATE_NONE);
@@ -1166,6 +1187,16 @@ test_binder_set_passthrough(
     binder->passthrough = passthrough;
 }
 
+guint
+test_binder_write_read_count(
+    int fd)
+{
+    TestBinder* binder = test_binder_from_fd(fd);
+
+    g_assert(binder);
+    return g_atomic_int_get(&binder->write_read_count);
+}
+
 void
 test_binder_set_destroy(
     int fd,
@@ -1235,6 +1266,15 @@ test_binder_br_noop(
     test_binder_push_data(fd, &cmd);
 }
 
+void
+test_binder_br_spawn_looper(
+    int fd)
+{
+    guint32 cmd = BR_SPAWN_LOOPER;
+
+    test_binder_push_data(fd, &cmd);
+}
+
 void
 test_binder_br_increfs(
     int fd,
@@ -1317,6 +1357,33 @@ test_binder_br_failed_reply(
     test_binder_push_data(fd, &cmd);
 }
 
+void
+test_binder_br_frozen_reply(
+    int fd)
+{
+    guint32 cmd = BR_FROZEN_REPLY;
+
+    test_binder_push_data(fd, &cmd);
+}
+
+void
+test_binder_br_oneway_spam_suspect(
+    int fd)
+{
+    guint32 cmd = BR_ONEWAY_SPAM_SUSPECT;
+
+    test_binder_push_data(fd, &cmd);
+}
+
+void
+test_binder_br_transaction_pending_frozen(
+    int fd)
+{
+    guint32 cmd = BR_TRANSACTION_PENDING_FROZEN;
+
+    test_binder_push_data(fd, &cmd);
+}
+
 static
 void
 test_binder_fill_transaction_data(
@@ -1353,6 +1420,24 @@ test_binder_br_transaction(
     test_binder_push_data(fd, buf);
 }
 
+void
+test_binder_br_transaction_oneway(
+    int fd,
+    void* target,
+    guint32 code,
+    const GByteArray* bytes)
+{
+    guint32 cmd = BR_TRANSACTION_64;
+    guint8 buf[sizeof(guint32) + sizeof(BinderTransactionData64)];
+    BinderTransactionData64* tr = (void*)(buf + sizeof(cmd));
+
+    memcpy(buf, &cmd, sizeof(cmd));
+    test_binder_fill_transaction_data(tr, (gsize)target, code, bytes);
+    tr->flags |= TF_ONE_WAY;
+
+    test_binder_push_data(fd, buf);
+}
+
 static
 void
 test_binder_br_reply1(
@@ -1604,6 +1689,121 @@ test_binder_fd_new(
     return binder_fd;
 }
 
+static
+void
+test_binder_watch_free(
+    gpointer data)
+{
+    TestBinderWatch* watch = data;
+
+    close(watch->fd);
+    g_free(watch->path);
+    g_free(watch);
+}
+
+/* Drops the watches closed by the other side. Must be called locked. */
+static
+void
+test_binder_watch_prune_locked(
+    void)
+{
+    GSList* l = test_watch_list;
+
+    while (l) {
+        GSList* next = l->next;
+        TestBinderWatch* watch = l->data;
+        struct pollfd pfd;
+
+        memset(&pfd, 0, sizeof(pfd));
+        pfd.fd = watch->fd;
+        if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR))) {
+            GDEBUG("Watch %s is gone", watch->path);
+            test_watch_list = g_slist_delete_link(test_watch_list, l);
+            test_binder_watch_free(watch);
+        }
+        l = next;
+    }
+}
+
+/* Wakes up the watches of the path. Must be called locked. */
+static
+void
+test_binder_watch_notify_locked(
+    const char* path)
+{
+    GSList* l;
+
+    test_binder_watch_prune_locked();
+    for (l = test_watch_list; l; l = l->next) {
+        TestBinderWatch* watch = l->data;
+
+        if (!g_strcmp0(watch->path, path)) {
+            static const char c = 0;
+
+            GDEBUG("%s has been opened", path);
+            if (send(watch->fd, &c, 1, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+                GDEBUG("Failed to wake up the watch: %s", strerror(errno));
+            }
+        }
+    }
+}
+
+void
+test_binder_set_watch_enabled(
+    gboolean enabled)
+{
+    G_LOCK(test_binder);
+    test_watch_enabled = enabled;
+    if (!enabled) {
+        g_slist_free_full(test_watch_list, test_binder_watch_free);
+        test_watch_list = NULL;
+    }
+    G_UNLOCK(test_binder);
+}
+
+guint
+test_binder_watch_count(
+    const char* path)
+{
+    guint count = 0;
+    GSList* l;
+
+    G_LOCK(test_binder);
+    test_binder_watch_prune_locked();
+    for (l = test_watch_list; l; l = l->next) {
+        TestBinderWatch* watch = l->data;
+
+        if (!g_strcmp0(watch->path, path)) {
+            count++;
+        }
+    }
+    G_UNLOCK(test_binder);
+    return count;
+}
+
+int
+gbinder_system_open_watch(
+    const char* path)
+{
+    int fds[2];
+
+    G_LOCK(test_binder);
+    if (test_watch_enabled && path && !socketpair(AF_UNIX, SOCK_STREAM |
+        SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds)) {
+        TestBinderWatch* watch = g_new0(TestBinderWatch, 1);
+
+        watch->path = g_strdup(path);
+        watch->fd = fds[1];
+        test_watch_list = g_slist_append(test_watch_list, watch);
+        G_UNLOCK(test_binder);
+        GDEBUG("Watching %s (%d)", path, fds[0]);
+        return fds[0];
+    }
+    G_UNLOCK(test_binder);
+    errno = ENOENT;
+    return -1;
+}
+
 int
 gbinder_system_open(
     const char* path,
@@ -1621,6 +1821,7 @@ gbinder_system_open(
         TestBinderNode* node;
 
         G_LOCK(test_binder);
+        test_binder_watch_notify_locked(path);
         node = test_node_map ? g_hash_table_lookup(test_node_map, path) : NULL;
         if (!node) {
             int i, fds[2];
@@ -1719,6 +1920,7 @@ gbinder_system_ioctl(
             return 0;
         default:
             if (request == io->write_read_request) {
+                g_atomic_int_inc(&binder->write_read_count);
                 return io->handle_write_read(binder_fd, data);
             } else {
                 errno = EINVAL;
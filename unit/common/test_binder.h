@@ -41,6 +41,10 @@ void
 test_binder_br_noop(
     int fd);
 
+void
+test_binder_br_spawn_looper(
+    int fd);
+
 void
 test_binder_br_increfs(
     int fd,
@@ -82,6 +86,18 @@ void
 test_binder_br_failed_reply(
     int fd);
 
+void
+test_binder_br_frozen_reply(
+    int fd);
+
+void
+test_binder_br_oneway_spam_suspect(
+    int fd);
+
+void
+test_binder_br_transaction_pending_frozen(
+    int fd);
+
 void
 test_binder_br_transaction(
     int fd,
@@ -89,6 +105,13 @@ test_binder_br_transaction(
     guint32 code,
     const GByteArray* bytes);
 
+void
+test_binder_br_transaction_oneway(
+    int fd,
+    void* target,
+    guint32 code,
+    const GByteArray* bytes);
+
 void
 test_binder_br_reply(
     int fd,
@@ -129,6 +152,10 @@ test_binder_set_passthrough(
     int fd,
     gboolean passthrough);
 
+guint
+test_binder_write_read_count(
+    int fd);
+
 int
 test_binder_handle(
     int fd,
@@ -158,6 +185,16 @@ test_binder_set_destroy(
     gpointer ptr,
     GDestroyNotify destroy);
 
+/* Makes gbinder_system_open_watch() work for the test devices */
+void
+test_binder_set_watch_enabled(
+    gboolean enabled);
+
+/* Number of the watches which haven't been closed yet */
+guint
+test_binder_watch_count(
+    const char* path);
+
 void
 test_binder_exit_wait(
     const TestOpt* opt,
@@ -46,6 +46,8 @@
 #include <gutil_log.h>
 #include <gutil_strv.h>
 
+#include <string.h>
+
 /*==========================================================================*
  * Test service manager
  *==========================================================================*/
@@ -332,6 +334,43 @@ test_servicemanager_hidl_list(
     return reply;
 }
 
+static
+GBinderLocalReply*
+test_servicemanager_hidl_list_by_interface(
+    TestServiceManagerHidl* self,
+    GBinderRemoteRequest* req)
+{
+    GHashTableIter it;
+    GBinderReader reader;
+    GBinderWriter writer;
+    GBinderLocalReply* reply =
+        gbinder_local_object_new_reply(GBINDER_LOCAL_OBJECT(self));
+    const char* fqname;
+    gpointer key;
+    char** list = NULL;
+    gsize len;
+
+    gbinder_remote_request_init_reader(req, &reader);
+    g_assert((fqname = gbinder_reader_read_hidl_string_c(&reader)));
+    g_assert(gbinder_reader_at_end(&reader));
+    len = strlen(fqname);
+
+    g_hash_table_iter_init(&it, self->objects);
+    while (g_hash_table_iter_next(&it, &key, NULL)) {
+        const char* fqinstance = key;
+
+        if (!strncmp(fqinstance, fqname, len) && fqinstance[len] == '/') {
+            list = gutil_strv_add(list, fqinstance + len + 1);
+        }
+    }
+
+    gbinder_local_reply_init_writer(reply, &writer);
+    gbinder_writer_append_int32(&writer, 0);
+    gbinder_writer_append_hidl_string_vec(&writer, (const char**) list, -1);
+    gbinder_writer_add_cleanup(&writer, (GDestroyNotify) g_strfreev, list);
+    return reply;
+}
+
 static
 GBinderLocalReply*
 test_servicemanager_hidl_register_for_notifications(
@@ -410,6 +449,9 @@ test_servicemanager_hidl_handler(
     case LIST_TRANSACTION:
         reply = test_servicemanager_hidl_list(self, req);
         break;
+    case LIST_BY_INTERFACE_TRANSACTION:
+        reply = test_servicemanager_hidl_list_by_interface(self, req);
+        break;
     case REGISTER_FOR_NOTIFICATIONS_TRANSACTION:
         reply = test_servicemanager_hidl_register_for_notifications(self, req);
         break;
@@ -0,0 +1,530 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmarks for the pure library costs, running on top of the
+ * emulated binder driver. Each benchmark prints a JSON object to stdout.
+ * The number of iterations can be adjusted with BENCH_ITERATIONS env
+ * variable.
+ */
+
+#include "test_binder.h"
+
+#include "gbinder_buffer_p.h"
+#include "gbinder_driver.h"
+#include "gbinder_ipc.h"
+#include "gbinder_local_object_p.h"
+#include "gbinder_local_request_p.h"
+#include "gbinder_object_registry.h"
+#include "gbinder_output_data.h"
+#include "gbinder_reader_p.h"
+#include "gbinder_remote_object_p.h"
+#include "gbinder_rpc_protocol.h"
+#include "gbinder_writer.h"
+
+#include <gutil_intarray.h>
+#include <gutil_log.h>
+#include <gutil_misc.h>
+
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_ITERATIONS (100000)
+#define BENCH_IFACE "android.hardware.bench@1.0::IBench"
+#define BENCH_HANDOFF_DIVISOR (100)
+
+typedef struct bench_hidl_item {
+    guint32 id;
+    guint32 flags;
+    guint64 value;
+} BenchHidlItem;
+
+typedef struct bench_handoff {
+    GMainLoop* loop;
+    guint count;
+    guint total;
+} BenchHandoff;
+
+static TestOpt test_opt;
+static guint bench_iterations = BENCH_DEFAULT_ITERATIONS;
+static const guint8 bench_blob[64] = { 0x01, 0x02, 0x03 };
+static const BenchHidlItem bench_items[16] = {{ 1, 2, 3 }};
+
+static
+gint64
+bench_now_ns(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gint64)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static
+void
+bench_report(
+    const char* name,
+    guint count,
+    gint64 elapsed_ns)
+{
+    const double ns_per_op = count ? ((double)elapsed_ns / count) : 0.0;
+
+    printf("{\"bench\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.1f,"
+        "\"ops_per_sec\":%.1f}\n", name, count, ns_per_op,
+        elapsed_ns ? (count * 1e9 / elapsed_ns) : 0.0);
+    fflush(stdout);
+    g_test_minimized_result(ns_per_op, "%s %.1f ns/op", name, ns_per_op);
+}
+
+static
+void
+bench_write_aidl(
+    GBinderWriter* writer)
+{
+    gbinder_writer_append_int32(writer, 42);
+    gbinder_writer_append_string16(writer, "android.os.IServiceManager");
+    gbinder_writer_append_string8(writer, "bench");
+    gbinder_writer_append_int64(writer, G_GINT64_CONSTANT(0x123456789));
+    gbinder_writer_append_byte_array(writer, TEST_ARRAY_AND_SIZE(bench_blob));
+    gbinder_writer_append_bool(writer, TRUE);
+}
+
+static
+void
+bench_read_aidl(
+    GBinderReader* reader)
+{
+    gint32 i32;
+    gint64 i64;
+    gsize len;
+    gboolean b;
+
+    gbinder_reader_read_int32(reader, &i32);
+    g_free(gbinder_reader_read_string16(reader));
+    gbinder_reader_read_string8(reader);
+    gbinder_reader_read_int64(reader, &i64);
+    gbinder_reader_read_byte_array(reader, &len);
+    gbinder_reader_read_bool(reader, &b);
+}
+
+static
+void
+bench_write_hidl(
+    GBinderWriter* writer)
+{
+    gbinder_writer_append_int32(writer, 42);
+    gbinder_writer_append_hidl_string(writer, "bench");
+    gbinder_writer_append_hidl_vec(writer, TEST_ARRAY_AND_COUNT(bench_items),
+        sizeof(bench_items[0]));
+}
+
+static
+void
+bench_read_hidl(
+    GBinderReader* reader)
+{
+    gint32 i32;
+    gsize count, elemsize;
+
+    gbinder_reader_read_int32(reader, &i32);
+    gbinder_reader_read_hidl_string_c(reader);
+    gbinder_reader_read_hidl_vec(reader, &count, &elemsize);
+}
+
+static
+GBinderLocalRequest*
+bench_new_request(
+    GBinderIpc* ipc,
+    const char* iface,
+    void (*write)(GBinderWriter* writer))
+{
+    GBinderLocalRequest* req = iface ?
+        gbinder_driver_local_request_new(ipc->driver, iface) :
+        gbinder_local_request_new(gbinder_driver_io(ipc->driver), NULL);
+    GBinderWriter writer;
+
+    gbinder_local_request_init_writer(req, &writer);
+    write(&writer);
+    return req;
+}
+
+static
+GBinderBuffer*
+bench_new_buffer(
+    GBinderIpc* ipc,
+    GBinderLocalRequest* req)
+{
+    /*
+     * Turns the request into what the driver would have handed over,
+     * except that buffer objects keep pointing to the request memory.
+     */
+    GBinderOutputData* out = gbinder_local_request_data(req);
+    GUtilIntArray* offsets = gbinder_output_data_offsets(out);
+    const gsize size = out->bytes->len;
+    guint8* data = gutil_memdup(out->bytes->data, size);
+    void** objects = NULL;
+
+    if (offsets && offsets->count) {
+        guint i;
+
+        objects = g_new(void*, offsets->count + 1);
+        for (i = 0; i < offsets->count; i++) {
+            objects[i] = data + offsets->data[i];
+        }
+        objects[i] = NULL;
+    }
+    return gbinder_buffer_new(ipc->driver, data, size, objects);
+}
+
+/*==========================================================================*
+ * writer
+ *==========================================================================*/
+
+static
+void
+bench_writer(
+    const char* name,
+    const char* dev,
+    void (*write)(GBinderWriter* writer))
+{
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    gint64 start;
+    guint i;
+
+    start = bench_now_ns();
+    for (i = 0; i < bench_iterations; i++) {
+        gbinder_local_request_unref(bench_new_request(ipc, BENCH_IFACE,
+            write));
+    }
+    bench_report(name, bench_iterations, bench_now_ns() - start);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+}
+
+static
+void
+bench_writer_aidl(
+    void)
+{
+    bench_writer("writer/aidl", GBINDER_DEFAULT_BINDER, bench_write_aidl);
+}
+
+static
+void
+bench_writer_hidl(
+    void)
+{
+    bench_writer("writer/hidl", GBINDER_DEFAULT_HWBINDER, bench_write_hidl);
+}
+
+/*==========================================================================*
+ * reader
+ *==========================================================================*/
+
+static
+void
+bench_reader(
+    const char* name,
+    const char* dev,
+    void (*write)(GBinderWriter* writer),
+    void (*read)(GBinderReader* reader))
+{
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    GBinderLocalRequest* req = bench_new_request(ipc, NULL, write);
+    GBinderReaderData data;
+    gint64 start;
+    guint i;
+
+    memset(&data, 0, sizeof(data));
+    data.reg = gbinder_ipc_object_registry(ipc);
+    data.buffer = bench_new_buffer(ipc, req);
+    data.objects = gbinder_buffer_objects(data.buffer);
+
+    start = bench_now_ns();
+    for (i = 0; i < bench_iterations; i++) {
+        GBinderReader reader;
+
+        gbinder_reader_init(&reader, &data, 0, data.buffer->size);
+        read(&reader);
+    }
+    bench_report(name, bench_iterations, bench_now_ns() - start);
+
+    gbinder_buffer_free(data.buffer);
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+}
+
+static
+void
+bench_reader_aidl(
+    void)
+{
+    bench_reader("reader/aidl", GBINDER_DEFAULT_BINDER, bench_write_aidl,
+        bench_read_aidl);
+}
+
+static
+void
+bench_reader_hidl(
+    void)
+{
+    bench_reader("reader/hidl", GBINDER_DEFAULT_HWBINDER, bench_write_hidl,
+        bench_read_hidl);
+}
+
+/*==========================================================================*
+ * forward
+ *==========================================================================*/
+
+static
+void
+bench_forward(
+    const char* name,
+    const char* dev,
+    void (*write)(GBinderWriter* writer))
+{
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    GBinderLocalRequest* req = bench_new_request(ipc, NULL, write);
+    GBinderBuffer* buffer = bench_new_buffer(ipc, req);
+    gint64 start;
+    guint i;
+
+    /* gbinder_writer_data_append_contents() is doing all the work */
+    start = bench_now_ns();
+    for (i = 0; i < bench_iterations; i++) {
+        gbinder_local_request_unref(gbinder_local_request_new_from_data
+            (buffer, NULL));
+    }
+    bench_report(name, bench_iterations, bench_now_ns() - start);
+
+    gbinder_buffer_free(buffer);
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+}
+
+static
+void
+bench_forward_aidl(
+    void)
+{
+    bench_forward("forward/aidl", GBINDER_DEFAULT_BINDER, bench_write_aidl);
+}
+
+static
+void
+bench_forward_hidl(
+    void)
+{
+    bench_forward("forward/hidl", GBINDER_DEFAULT_HWBINDER, bench_write_hidl);
+}
+
+/*==========================================================================*
+ * registry
+ *==========================================================================*/
+
+static
+void
+bench_registry(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderLocalObject* obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+    GBinderRemoteObject* remote[16];
+    gint64 start;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(remote); i++) {
+        remote[i] = gbinder_object_registry_get_remote(reg, i + 1, TRUE);
+    }
+
+    start = bench_now_ns();
+    for (i = 0; i < bench_iterations; i++) {
+        gbinder_remote_object_unref(gbinder_object_registry_get_remote(reg,
+            (i % G_N_ELEMENTS(remote)) + 1, FALSE));
+    }
+    bench_report("registry/remote", bench_iterations, bench_now_ns() - start);
+
+    start = bench_now_ns();
+    for (i = 0; i < bench_iterations; i++) {
+        gbinder_local_object_unref(gbinder_object_registry_get_local(reg,
+            obj));
+    }
+    bench_report("registry/local", bench_iterations, bench_now_ns() - start);
+
+    for (i = 0; i < G_N_ELEMENTS(remote); i++) {
+        gbinder_remote_object_unref(remote[i]);
+    }
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+}
+
+/*==========================================================================*
+ * handoff
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+bench_handoff_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    BenchHandoff* test = user_data;
+
+    /* Invoked on the main thread */
+    if (++(test->count) == test->total) {
+        g_main_loop_quit(test->loop);
+    }
+    *status = GBINDER_STATUS_OK;
+    return NULL;
+}
+
+static
+gboolean
+bench_handoff_unref_ipc(
+    gpointer ipc)
+{
+    gbinder_ipc_unref(ipc);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+bench_handoff_destroyed(
+    gpointer loop,
+    GObject* ipc)
+{
+    test_quit_later((GMainLoop*)loop);
+}
+
+static
+void
+bench_handoff_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device
+        (gbinder_driver_dev(ipc->driver));
+    const char* const ifaces[] = { BENCH_IFACE, NULL };
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderLocalObject* obj;
+    GBinderWriter writer;
+    BenchHandoff test;
+    gint64 start;
+    guint i;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.total = MAX(bench_iterations / BENCH_HANDOFF_DIVISOR, 1);
+    obj = gbinder_local_object_new(ipc, ifaces, bench_handoff_proc, &test);
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, BENCH_IFACE);
+    bench_write_aidl(&writer);
+
+    /* Queue everything up front, then let the looper go */
+    for (i = 0; i < test.total; i++) {
+        test_binder_br_transaction(fd, obj, 1,
+            gbinder_local_request_data(req)->bytes);
+        test_binder_br_transaction_complete(fd); /* For reply */
+    }
+    start = bench_now_ns();
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, test.loop);
+    bench_report("handoff", test.count, bench_now_ns() - start);
+
+    /* Wait until GBinderIpc is destroyed */
+    g_object_weak_ref(G_OBJECT(ipc), bench_handoff_destroyed, test.loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    g_idle_add(bench_handoff_unref_ipc, ipc);
+    test_run(&test_opt, test.loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+bench_handoff(
+    void)
+{
+    test_run_in_context(&test_opt, bench_handoff_run);
+}
+
+/*==========================================================================*
+ * Common
+ *==========================================================================*/
+
+#define BENCH_PREFIX "/bench/"
+#define BENCH_(t) BENCH_PREFIX t
+
+int main(int argc, char* argv[])
+{
+    const char* iterations = getenv("BENCH_ITERATIONS");
+
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+    g_type_init();
+    G_GNUC_END_IGNORE_DEPRECATIONS;
+    g_test_init(&argc, &argv, NULL);
+    if (iterations && atoi(iterations) > 0) {
+        bench_iterations = atoi(iterations);
+    }
+    g_test_add_func(BENCH_("writer/aidl"), bench_writer_aidl);
+    g_test_add_func(BENCH_("writer/hidl"), bench_writer_hidl);
+    g_test_add_func(BENCH_("reader/aidl"), bench_reader_aidl);
+    g_test_add_func(BENCH_("reader/hidl"), bench_reader_hidl);
+    g_test_add_func(BENCH_("forward/aidl"), bench_forward_aidl);
+    g_test_add_func(BENCH_("forward/hidl"), bench_forward_hidl);
+    g_test_add_func(BENCH_("registry"), bench_registry);
+    g_test_add_func(BENCH_("handoff"), bench_handoff);
+    test_init(&test_opt, argc, argv);
+    return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
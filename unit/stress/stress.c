@@ -0,0 +1,746 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Concurrency stress on top of the emulated binder driver. Each scenario
+ * is repeated for every thread count from STRESS_THREADS (comma separated,
+ * 1,2,4,8 by default) and prints one JSON object per run to stdout, the
+ * scaling factor being relative to the first thread count. The amount of
+ * work per thread can be adjusted with STRESS_ITERATIONS.
+ *
+ * A watchdog aborts the process if no progress is made for
+ * STRESS_WATCHDOG_SEC seconds, which is what a lock order inversion
+ * usually looks like. "make helgrind" runs a shorter version under
+ * valgrind which reports the inversions themselves.
+ */
+
+#include "test_binder.h"
+
+#include "gbinder_driver.h"
+#include "gbinder_ipc.h"
+#include "gbinder_local_object_p.h"
+#include "gbinder_local_request_p.h"
+#include "gbinder_object_registry.h"
+#include "gbinder_output_data.h"
+#include "gbinder_remote_object_p.h"
+#include "gbinder_rpc_protocol.h"
+#include "gbinder_writer.h"
+
+#include <gutil_log.h>
+
+#include <stdlib.h>
+#include <time.h>
+
+#define STRESS_DEFAULT_THREADS "1,2,4,8"
+#define STRESS_DEFAULT_ITERATIONS (10000)
+#define STRESS_DEFAULT_WATCHDOG_SEC (10)
+#define STRESS_HANDLES (64)
+#define STRESS_ASYNC_LOOKUPS (16)
+#define STRESS_IFACE "android.hardware.stress@1.0::IStress"
+
+typedef
+void
+(*StressFunc)(
+    guint threads,
+    guint* ops,
+    gint64* elapsed_ns);
+
+typedef struct stress_watchdog {
+    const char* name;
+    GThread* thread;
+    GMutex mutex;
+    GCond cond;
+    gboolean stop;
+} StressWatchdog;
+
+static TestOpt test_opt;
+static guint stress_iterations = STRESS_DEFAULT_ITERATIONS;
+static guint stress_watchdog_sec = STRESS_DEFAULT_WATCHDOG_SEC;
+static guint* stress_threads;
+static guint stress_thread_counts;
+static gint stress_progress; /* Bumped by every completed operation */
+
+/* test_run_in_context() doesn't take parameters */
+static guint stress_run_threads;
+static guint stress_run_ops;
+static gint64 stress_run_elapsed;
+
+static
+gint64
+stress_now_ns(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((gint64)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/*==========================================================================*
+ * Watchdog
+ *==========================================================================*/
+
+static
+gpointer
+stress_watchdog_proc(
+    gpointer data)
+{
+    StressWatchdog* wd = data;
+    gint last = g_atomic_int_get(&stress_progress);
+    guint idle = 0;
+
+    g_mutex_lock(&wd->mutex);
+    while (!wd->stop) {
+        const gint64 deadline = g_get_monotonic_time() + G_TIME_SPAN_SECOND;
+
+        if (!g_cond_wait_until(&wd->cond, &wd->mutex, deadline)) {
+            const gint progress = g_atomic_int_get(&stress_progress);
+
+            if (progress != last) {
+                last = progress;
+                idle = 0;
+            } else if (++idle >= stress_watchdog_sec) {
+                /* Leave the stuck threads in the core dump */
+                fprintf(stderr, "%s: no progress in %u sec, deadlock?\n",
+                    wd->name, idle);
+                abort();
+            }
+        }
+    }
+    g_mutex_unlock(&wd->mutex);
+    return NULL;
+}
+
+static
+void
+stress_watchdog_start(
+    StressWatchdog* wd,
+    const char* name)
+{
+    memset(wd, 0, sizeof(*wd));
+    wd->name = name;
+    g_mutex_init(&wd->mutex);
+    g_cond_init(&wd->cond);
+    wd->thread = g_thread_new("watchdog", stress_watchdog_proc, wd);
+}
+
+static
+void
+stress_watchdog_stop(
+    StressWatchdog* wd)
+{
+    g_mutex_lock(&wd->mutex);
+    wd->stop = TRUE;
+    g_cond_signal(&wd->cond);
+    g_mutex_unlock(&wd->mutex);
+    g_thread_join(wd->thread);
+    g_cond_clear(&wd->cond);
+    g_mutex_clear(&wd->mutex);
+}
+
+/*==========================================================================*
+ * Common
+ *==========================================================================*/
+
+static
+void
+stress_scale(
+    const char* name,
+    StressFunc run)
+{
+    double base = 0.0;
+    guint i;
+
+    for (i = 0; i < stress_thread_counts; i++) {
+        const guint threads = stress_threads[i];
+        StressWatchdog wd;
+        gint64 elapsed_ns = 0;
+        guint ops = 0;
+        double ops_per_sec;
+
+        stress_watchdog_start(&wd, name);
+        run(threads, &ops, &elapsed_ns);
+        stress_watchdog_stop(&wd);
+
+        ops_per_sec = elapsed_ns ? (ops * 1e9 / elapsed_ns) : 0.0;
+        if (!i) {
+            base = ops_per_sec;
+        }
+        printf("{\"stress\":\"%s\",\"threads\":%u,\"ops\":%u,"
+            "\"ops_per_sec\":%.1f,\"scaling\":%.2f}\n", name, threads, ops,
+            ops_per_sec, base ? (ops_per_sec / base) : 0.0);
+        fflush(stdout);
+        g_test_maximized_result(ops_per_sec, "%s/%u %.1f ops/sec", name,
+            threads, ops_per_sec);
+    }
+}
+
+static
+void
+stress_run_in_context(
+    GTestFunc func,
+    guint threads,
+    guint* ops,
+    gint64* elapsed_ns)
+{
+    stress_run_threads = threads;
+    stress_run_ops = 0;
+    stress_run_elapsed = 0;
+    test_run_in_context(&test_opt, func);
+    *ops = stress_run_ops;
+    *elapsed_ns = stress_run_elapsed;
+}
+
+static
+void
+stress_ipc_destroyed(
+    gpointer loop,
+    GObject* ipc)
+{
+    test_quit_later((GMainLoop*)loop);
+}
+
+static
+gboolean
+stress_unref_ipc(
+    gpointer ipc)
+{
+    gbinder_ipc_unref(ipc);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+stress_ipc_exit(
+    GBinderIpc* ipc,
+    GMainLoop* loop)
+{
+    /* Wait until GBinderIpc is destroyed */
+    g_object_weak_ref(G_OBJECT(ipc), stress_ipc_destroyed, loop);
+    g_idle_add(stress_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+}
+
+static
+void
+stress_hold_remotes(
+    GBinderObjectRegistry* reg,
+    GBinderRemoteObject** remote)
+{
+    guint i;
+
+    for (i = 0; i < STRESS_HANDLES; i++) {
+        remote[i] = gbinder_object_registry_get_remote(reg, i + 1, TRUE);
+    }
+}
+
+static
+void
+stress_drop_remotes(
+    GBinderRemoteObject** remote)
+{
+    guint i;
+
+    for (i = 0; i < STRESS_HANDLES; i++) {
+        gbinder_remote_object_unref(remote[i]);
+    }
+}
+
+/*==========================================================================*
+ * registry
+ *
+ * Concurrent lookups of remote and local objects.
+ *==========================================================================*/
+
+typedef struct stress_registry {
+    GBinderObjectRegistry* reg;
+    GBinderLocalObject* obj;
+} StressRegistry;
+
+static
+gpointer
+stress_registry_thread(
+    gpointer data)
+{
+    StressRegistry* test = data;
+    guint i;
+
+    for (i = 0; i < stress_iterations; i++) {
+        gbinder_remote_object_unref(gbinder_object_registry_get_remote
+            (test->reg, (i % STRESS_HANDLES) + 1, FALSE));
+        gbinder_local_object_unref(gbinder_object_registry_get_local
+            (test->reg, test->obj));
+        g_atomic_int_inc(&stress_progress);
+    }
+    return NULL;
+}
+
+static
+void
+stress_registry(
+    guint threads,
+    guint* ops,
+    gint64* elapsed_ns)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderRemoteObject* remote[STRESS_HANDLES];
+    GThread** thread = g_new(GThread*, threads);
+    StressRegistry test;
+    gint64 start;
+    guint i;
+
+    test.reg = gbinder_ipc_object_registry(ipc);
+    test.obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+    stress_hold_remotes(test.reg, remote);
+
+    start = stress_now_ns();
+    for (i = 0; i < threads; i++) {
+        thread[i] = g_thread_new("registry", stress_registry_thread, &test);
+    }
+    for (i = 0; i < threads; i++) {
+        g_thread_join(thread[i]);
+    }
+    *elapsed_ns = stress_now_ns() - start;
+    *ops = threads * stress_iterations;
+
+    stress_drop_remotes(remote);
+    gbinder_local_object_unref(test.obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_free(thread);
+}
+
+static
+void
+stress_registry_test(
+    void)
+{
+    stress_scale("registry", stress_registry);
+}
+
+/*==========================================================================*
+ * dispatch
+ *
+ * Incoming one-way transactions handled directly by the loopers.
+ *==========================================================================*/
+
+typedef struct stress_dispatch {
+    GMainLoop* loop;
+    gint count;
+    gint total;
+} StressDispatch;
+
+static
+GBinderLocalReply*
+stress_dispatch_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    StressDispatch* test = user_data;
+
+    /* Invoked on the looper threads */
+    g_atomic_int_inc(&stress_progress);
+    if (g_atomic_int_add(&test->count, 1) + 1 == test->total) {
+        test_quit_later(test->loop);
+    }
+    *status = GBINDER_STATUS_OK;
+    return NULL;
+}
+
+static
+void
+stress_dispatch_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device
+        (gbinder_driver_dev(ipc->driver));
+    const char* const ifaces[] = { STRESS_IFACE, NULL };
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderLocalObject* obj;
+    GBinderWriter writer;
+    StressDispatch test;
+    gint64 start;
+    guint i;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.total = stress_run_threads * stress_iterations;
+    obj = gbinder_local_object_new(ipc, ifaces, stress_dispatch_proc, &test);
+    gbinder_local_object_set_looper_dispatch(obj, TRUE);
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, STRESS_IFACE);
+    gbinder_writer_append_int32(&writer, 42);
+
+    /* One looper is there anyway, ask for the rest */
+    for (i = 1; i < stress_run_threads; i++) {
+        test_binder_br_spawn_looper(fd);
+    }
+    for (i = 0; i < test.total; i++) {
+        test_binder_br_transaction_oneway(fd, obj, 1,
+            gbinder_local_request_data(req)->bytes);
+    }
+    start = stress_now_ns();
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, test.loop);
+    stress_run_elapsed = stress_now_ns() - start;
+    stress_run_ops = g_atomic_int_get(&test.count);
+    g_assert_cmpint(stress_run_ops, == ,test.total);
+
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    stress_ipc_exit(ipc, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+stress_dispatch(
+    guint threads,
+    guint* ops,
+    gint64* elapsed_ns)
+{
+    stress_run_in_context(stress_dispatch_run, threads, ops, elapsed_ns);
+}
+
+static
+void
+stress_dispatch_test(
+    void)
+{
+    stress_scale("dispatch", stress_dispatch);
+}
+
+/*==========================================================================*
+ * async
+ *
+ * Custom transactions executed by the worker pool, every fourth one
+ * cancelled right away.
+ *==========================================================================*/
+
+typedef struct stress_async {
+    GMainLoop* loop;
+    GBinderObjectRegistry* reg;
+    gint executed;
+    guint done;
+    guint destroyed;
+    guint total;
+} StressAsync;
+
+static
+void
+stress_async_exec(
+    const GBinderIpcTx* tx)
+{
+    StressAsync* test = tx->user_data;
+    guint i;
+
+    /* Invoked on the worker threads, touches the shared registry */
+    for (i = 0; i < STRESS_ASYNC_LOOKUPS; i++) {
+        gbinder_remote_object_unref(gbinder_object_registry_get_remote
+            (test->reg, (i % STRESS_HANDLES) + 1, FALSE));
+    }
+    g_atomic_int_inc(&test->executed);
+    g_atomic_int_inc(&stress_progress);
+}
+
+static
+void
+stress_async_done(
+    const GBinderIpcTx* tx)
+{
+    StressAsync* test = tx->user_data;
+
+    g_assert(!tx->cancelled);
+    test->done++;
+}
+
+static
+void
+stress_async_destroy(
+    void* user_data)
+{
+    StressAsync* test = user_data;
+
+    if (++(test->destroyed) == test->total) {
+        test_quit_later(test->loop);
+    }
+}
+
+static
+void
+stress_async_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderRemoteObject* remote[STRESS_HANDLES];
+    StressAsync test;
+    gint64 start;
+    guint i, cancelled = 0;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.reg = gbinder_ipc_object_registry(ipc);
+    test.total = stress_run_threads * stress_iterations;
+    stress_hold_remotes(test.reg, remote);
+    g_assert(gbinder_ipc_set_max_threads(ipc, stress_run_threads));
+
+    start = stress_now_ns();
+    for (i = 0; i < test.total; i++) {
+        const gulong id = gbinder_ipc_transact_custom(ipc, stress_async_exec,
+            stress_async_done, stress_async_destroy, &test);
+
+        g_assert(id);
+        if (!(i % 4)) {
+            gbinder_ipc_cancel(ipc, id);
+            cancelled++;
+        }
+    }
+    test_run(&test_opt, test.loop);
+    stress_run_elapsed = stress_now_ns() - start;
+    stress_run_ops = test.total;
+
+    /* Cancelled transactions are destroyed without completion */
+    g_assert_cmpuint(test.destroyed, == ,test.total);
+    g_assert_cmpuint(test.done, <= ,test.total - cancelled);
+    g_assert_cmpint(g_atomic_int_get(&test.executed), <= ,test.total);
+
+    stress_drop_remotes(remote);
+    stress_ipc_exit(ipc, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+stress_async(
+    guint threads,
+    guint* ops,
+    gint64* elapsed_ns)
+{
+    stress_run_in_context(stress_async_run, threads, ops, elapsed_ns);
+}
+
+static
+void
+stress_async_test(
+    void)
+{
+    stress_scale("async", stress_async);
+}
+
+/*==========================================================================*
+ * death
+ *
+ * Registry lookups racing with a storm of death notifications.
+ *==========================================================================*/
+
+typedef struct stress_death {
+    GMainLoop* loop;
+    GBinderObjectRegistry* reg;
+    guint dead;
+    gint stop;
+    gint ops;
+} StressDeath;
+
+static
+gpointer
+stress_death_thread(
+    gpointer data)
+{
+    StressDeath* test = data;
+    guint i = 0;
+
+    while (!g_atomic_int_get(&test->stop)) {
+        gbinder_remote_object_unref(gbinder_object_registry_get_remote
+            (test->reg, (i++ % STRESS_HANDLES) + 1, FALSE));
+        g_atomic_int_inc(&test->ops);
+        g_atomic_int_inc(&stress_progress);
+    }
+    return NULL;
+}
+
+static
+void
+stress_death_notify(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    StressDeath* test = user_data;
+
+    g_atomic_int_inc(&stress_progress);
+    if (++(test->dead) == STRESS_HANDLES) {
+        test_quit_later(test->loop);
+    }
+}
+
+static
+void
+stress_death_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderRemoteObject* remote[STRESS_HANDLES];
+    gulong id[STRESS_HANDLES];
+    GThread** thread = g_new(GThread*, stress_run_threads);
+    StressDeath test;
+    gint64 start;
+    guint i;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.reg = gbinder_ipc_object_registry(ipc);
+    stress_hold_remotes(test.reg, remote);
+    for (i = 0; i < STRESS_HANDLES; i++) {
+        id[i] = gbinder_remote_object_add_death_handler(remote[i],
+            stress_death_notify, &test);
+        test_binder_br_dead_binder(fd, i + 1);
+    }
+
+    start = stress_now_ns();
+    for (i = 0; i < stress_run_threads; i++) {
+        thread[i] = g_thread_new("death", stress_death_thread, &test);
+    }
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, test.loop);
+    g_atomic_int_set(&test.stop, TRUE);
+    for (i = 0; i < stress_run_threads; i++) {
+        g_thread_join(thread[i]);
+    }
+    stress_run_elapsed = stress_now_ns() - start;
+    stress_run_ops = g_atomic_int_get(&test.ops);
+    g_assert_cmpuint(test.dead, == ,STRESS_HANDLES);
+
+    for (i = 0; i < STRESS_HANDLES; i++) {
+        g_assert(gbinder_remote_object_is_dead(remote[i]));
+        gbinder_remote_object_remove_handler(remote[i], id[i]);
+    }
+    stress_drop_remotes(remote);
+    stress_ipc_exit(ipc, test.loop);
+    g_main_loop_unref(test.loop);
+    g_free(thread);
+}
+
+static
+void
+stress_death(
+    guint threads,
+    guint* ops,
+    gint64* elapsed_ns)
+{
+    stress_run_in_context(stress_death_run, threads, ops, elapsed_ns);
+}
+
+static
+void
+stress_death_test(
+    void)
+{
+    stress_scale("death", stress_death);
+}
+
+/*==========================================================================*
+ * Common
+ *==========================================================================*/
+
+#define STRESS_PREFIX "/stress/"
+#define STRESS_(t) STRESS_PREFIX t
+
+static
+void
+stress_parse_threads(
+    const char* spec)
+{
+    char** values = g_strsplit(spec, ",", -1);
+    const guint n = g_strv_length(values);
+    guint i;
+
+    stress_threads = g_new(guint, n);
+    stress_thread_counts = 0;
+    for (i = 0; i < n; i++) {
+        const int threads = atoi(values[i]);
+
+        if (threads > 0) {
+            stress_threads[stress_thread_counts++] = threads;
+        }
+    }
+    g_strfreev(values);
+    if (!stress_thread_counts) {
+        g_free(stress_threads);
+        stress_parse_threads(STRESS_DEFAULT_THREADS);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* threads = getenv("STRESS_THREADS");
+    const char* iterations = getenv("STRESS_ITERATIONS");
+    const char* watchdog = getenv("STRESS_WATCHDOG_SEC");
+    int ret;
+
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+    g_type_init();
+    G_GNUC_END_IGNORE_DEPRECATIONS;
+    g_test_init(&argc, &argv, NULL);
+    stress_parse_threads(threads ? threads : STRESS_DEFAULT_THREADS);
+    if (iterations && atoi(iterations) > 0) {
+        stress_iterations = atoi(iterations);
+    }
+    if (watchdog && atoi(watchdog) > 0) {
+        stress_watchdog_sec = atoi(watchdog);
+    }
+    g_test_add_func(STRESS_("registry"), stress_registry_test);
+    g_test_add_func(STRESS_("dispatch"), stress_dispatch_test);
+    g_test_add_func(STRESS_("async"), stress_async_test);
+    g_test_add_func(STRESS_("death"), stress_death_test);
+    test_init(&test_opt, argc, argv);
+    ret = g_test_run();
+    g_free(stress_threads);
+    return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
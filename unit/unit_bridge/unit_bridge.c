@@ -209,6 +209,7 @@ test_null(
     g_assert(!gbinder_bridge_new(NULL, NULL, NULL, NULL));
     g_assert(!gbinder_bridge_new("foo", NULL, NULL, NULL));
     g_assert(!gbinder_bridge_new("foo", ifaces, NULL, NULL));
+    gbinder_bridge_set_looper_dispatch(NULL, TRUE);
     gbinder_bridge_free(NULL);
 }
 
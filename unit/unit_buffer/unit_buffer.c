@@ -32,10 +32,16 @@
 
 #include "test_common.h"
 
+#include "gbinder_config.h"
 #include "gbinder_driver.h"
 #include "gbinder_buffer_p.h"
+#include "gbinder_io.h"
+
+#include <unistd.h>
+#include <fcntl.h>
 
 static TestOpt test_opt;
+static const char TMP_DIR_TEMPLATE[] = "gbinder-test-buffer-XXXXXX";
 
 /*==========================================================================*
  * null
@@ -139,6 +145,192 @@ test_parent(
     gbinder_driver_unref(driver);
 }
 
+/*==========================================================================*
+ * fds
+ *==========================================================================*/
+
+static
+void
+test_fds(
+    void)
+{
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(driver);
+    const int fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    guint8* ptr = g_malloc0(GBINDER_MAX_BINDER_OBJECT_SIZE);
+    void** objects = g_new0(void*, 2);
+    const guint size = io->encode_fd_object(ptr, fd);
+    GBinderBuffer* buf;
+
+    /* Not an fd object, the descriptor stays open */
+    g_assert(fd >= 0);
+    *(guint32*)ptr = 0;
+    objects[0] = ptr;
+    buf = gbinder_buffer_new(driver, ptr, size, objects);
+    gbinder_buffer_free(buf);
+    g_assert(fcntl(fd, F_GETFD) >= 0);
+
+    /* This one gets closed together with the buffer */
+    ptr = g_malloc0(GBINDER_MAX_BINDER_OBJECT_SIZE);
+    objects = g_new0(void*, 2);
+    objects[0] = ptr;
+    io->encode_fd_object(ptr, fd);
+    buf = gbinder_buffer_new(driver, ptr, size, objects);
+    gbinder_buffer_free(buf);
+    g_assert(close(fd) < 0);
+
+    gbinder_driver_unref(driver);
+}
+
+/*==========================================================================*
+ * evict
+ *==========================================================================*/
+
+static
+void
+test_evict(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GBinderDriver* driver;
+    GBinderBuffer* buf;
+    GBinderBuffer* buf2;
+    const gsize big = 64 * 1024;
+    guint8* ptr;
+    guint8* ptr2;
+
+    static const char config[] =
+        "[BufferEvictWatermark]\n"
+        "Default = 1\n";
+
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+    driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert_cmpuint(gbinder_driver_vm_size(driver) / 100, < ,big);
+
+    /* Small buffer stays where it is */
+    ptr = g_malloc0(8);
+    buf = gbinder_buffer_new_evictable(driver, ptr, 8, NULL);
+    g_assert(buf->data == ptr);
+    g_assert(!gbinder_driver_mapping_pressure(driver));
+
+    /* The big one crosses the watermark and gets copied */
+    ptr2 = g_malloc(big);
+    memset(ptr2, 0x55, big);
+    buf2 = gbinder_buffer_new_evictable(driver, ptr2, big, NULL);
+    g_assert(buf2->data != ptr2);
+    g_assert(gbinder_buffer_data(buf2, NULL) == buf2->data);
+    g_assert(((guint8*)buf2->data)[big - 1] == 0x55);
+    g_assert_cmpuint(gbinder_driver_pinned_size(driver), < ,big);
+    gbinder_buffer_free(buf2);
+
+    /* Regular gbinder_buffer_new() never copies anything */
+    ptr2 = g_malloc0(big);
+    buf2 = gbinder_buffer_new(driver, ptr2, big, NULL);
+    g_assert(buf2->data == ptr2);
+    g_assert(gbinder_driver_mapping_pressure(driver));
+    gbinder_buffer_free(buf2);
+    gbinder_buffer_free(buf);
+    g_assert(!gbinder_driver_pinned_size(driver));
+    gbinder_driver_unref(driver);
+
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+/*==========================================================================*
+ * bytes
+ *==========================================================================*/
+
+static
+void
+test_bytes(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GBinderDriver* driver;
+    GBinderBuffer* buf;
+    GBinderBuffer* buf2;
+    GBytes* bytes;
+    GBytes* bytes2;
+    const gsize big = 64 * 1024;
+    const gsize size = 256;
+    guint8* ptr;
+    gsize len = 0;
+
+    static const char config[] =
+        "[BufferEvictWatermark]\n"
+        "Default = 1\n";
+
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+    driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+
+    /* No contents - copied */
+    bytes = gbinder_buffer_contents_bytes(NULL, &len, sizeof(len));
+    g_assert(g_bytes_get_data(bytes, NULL) != &len);
+    g_bytes_unref(bytes);
+
+    /* No pressure - referenced and stays alive after the buffer is gone */
+    ptr = g_malloc(size);
+    memset(ptr, 0x55, size);
+    buf = gbinder_buffer_new(driver, ptr, size, NULL);
+    bytes = gbinder_buffer_contents_bytes(gbinder_buffer_contents(buf),
+        ptr + 1, size - 1);
+    g_assert(g_bytes_get_data(bytes, &len) == ptr + 1);
+    g_assert_cmpuint(len, == ,size - 1);
+
+    /* Small pieces are always copied */
+    bytes2 = gbinder_buffer_contents_bytes(gbinder_buffer_contents(buf),
+        ptr, 4);
+    g_assert(g_bytes_get_data(bytes2, NULL) != ptr);
+    g_bytes_unref(bytes2);
+    gbinder_buffer_free(buf);
+    g_assert(gbinder_driver_pinned_size(driver));
+    g_assert(((guint8*)g_bytes_get_data(bytes, NULL))[0] == 0x55);
+
+    /* Under pressure, the data sitting in the mapping gets copied */
+    buf2 = gbinder_buffer_new(driver, g_malloc0(big), big, NULL);
+    g_assert(gbinder_driver_mapping_pressure(driver));
+    ptr = g_malloc(size);
+    buf = gbinder_buffer_new(driver, ptr, size, NULL);
+    bytes2 = gbinder_buffer_contents_bytes(gbinder_buffer_contents(buf),
+        ptr, size);
+    g_assert(g_bytes_get_data(bytes2, NULL) != ptr);
+    g_bytes_unref(bytes2);
+    gbinder_buffer_free(buf);
+
+    /* But the heap copy (evicted buffer) is referenced */
+    ptr = g_malloc(size);
+    buf = gbinder_buffer_new_evictable(driver, ptr, size, NULL);
+    g_assert(buf->data != ptr);
+    bytes2 = gbinder_buffer_contents_bytes(gbinder_buffer_contents(buf),
+        buf->data, size);
+    g_assert(g_bytes_get_data(bytes2, NULL) == buf->data);
+    gbinder_buffer_free(buf);
+    g_bytes_unref(bytes2);
+
+    gbinder_buffer_free(buf2);
+    g_bytes_unref(bytes);
+    g_assert(!gbinder_driver_pinned_size(driver));
+    gbinder_driver_unref(driver);
+
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -152,6 +344,9 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("null"), test_null);
     g_test_add_func(TEST_("list"), test_list);
     g_test_add_func(TEST_("parent"), test_parent);
+    g_test_add_func(TEST_("fds"), test_fds);
+    g_test_add_func(TEST_("evict"), test_evict);
+    g_test_add_func(TEST_("bytes"), test_bytes);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_binder.h"
+
+#include "gbinder_capture_p.h"
+#include "gbinder_client.h"
+#include "gbinder_driver.h"
+#include "gbinder_io.h"
+#include "gbinder_ipc.h"
+#include "gbinder_object_registry.h"
+#include "gbinder_remote_object_p.h"
+
+#include <gutil_intarray.h>
+#include <gutil_log.h>
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static TestOpt test_opt;
+
+#define TEST_PAYLOAD_SIZE (8)
+
+static
+const GBinderCaptureRecord*
+test_capture_first(
+    GBytes* bytes)
+{
+    gsize size;
+    const guint8* data = g_bytes_get_data(bytes, &size);
+
+    g_assert_cmpuint(size, > ,GBINDER_CAPTURE_MAGIC_SIZE +
+        sizeof(GBinderCaptureRecord));
+    g_assert(!memcmp(data, GBINDER_CAPTURE_MAGIC, GBINDER_CAPTURE_MAGIC_SIZE));
+    return (const GBinderCaptureRecord*)(data + GBINDER_CAPTURE_MAGIC_SIZE);
+}
+
+/* Payload followed by an fd object */
+static
+GByteArray*
+test_capture_data(
+    const GBinderIo* io,
+    GUtilIntArray* offsets)
+{
+    GByteArray* buf = g_byte_array_new();
+    guint8 obj[GBINDER_MAX_BINDER_OBJECT_SIZE];
+    guint i;
+
+    for (i = 0; i < TEST_PAYLOAD_SIZE; i++) {
+        const guint8 b = i + 1;
+
+        g_byte_array_append(buf, &b, 1);
+    }
+    gutil_int_array_append(offsets, buf->len);
+    g_byte_array_append(buf, obj, io->encode_fd_object(obj, 42));
+    return buf;
+}
+
+static
+void
+test_capture_check(
+    const GBinderIo* io,
+    const GBinderCaptureRecord* rec,
+    const GByteArray* orig)
+{
+    const guint8* data = (const guint8*)(rec + 1);
+    const guint32* offsets = (const guint32*)(data + G_ALIGN8(rec->data_size));
+    gsize i;
+
+    g_assert_cmpuint(rec->pointer_size, == ,io->pointer_size);
+    g_assert_cmpuint(rec->data_size, == ,orig->len);
+    g_assert_cmpuint(rec->offsets_count, == ,1);
+    g_assert_cmpuint(rec->size, == ,sizeof(*rec) + G_ALIGN8(orig->len) + 8);
+    g_assert_cmpuint(offsets[0], == ,TEST_PAYLOAD_SIZE);
+
+    /* Payload and object header are intact, the rest is zeroed */
+    g_assert(!memcmp(data, orig->data, TEST_PAYLOAD_SIZE + 8));
+    for (i = TEST_PAYLOAD_SIZE + 8; i < orig->len; i++) {
+        g_assert_cmpuint(data[i], == ,0);
+    }
+}
+
+/*==========================================================================*
+ * null
+ *==========================================================================*/
+
+static
+void
+test_null(
+    void)
+{
+    g_assert(!gbinder_capture_active());
+    g_assert(!gbinder_capture_stop());
+    g_assert(!gbinder_capture_start_ring(0));
+    g_assert(!gbinder_capture_start_file(NULL));
+    g_assert(!gbinder_capture_start_file("/nonexistent/dir/capture"));
+    g_assert(!gbinder_capture_active());
+}
+
+/*==========================================================================*
+ * ring
+ *==========================================================================*/
+
+static
+void
+test_ring(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    GUtilIntArray* offsets = gutil_int_array_new();
+    GByteArray* data = test_capture_data(io, offsets);
+    const GBinderCaptureRecord* rec;
+    void* objects[2];
+    GBytes* out;
+
+    g_assert(gbinder_capture_start_ring(0x10000));
+    g_assert(gbinder_capture_active());
+    gbinder_capture_outgoing(io, 5, 7, GBINDER_TX_FLAG_ONEWAY, data, offsets);
+    objects[0] = data->data + TEST_PAYLOAD_SIZE;
+    objects[1] = NULL;
+    gbinder_capture_incoming(io, 8, 0, data->data, data->len, objects);
+
+    out = gbinder_capture_stop();
+    g_assert(out);
+    g_assert(!gbinder_capture_active());
+    rec = test_capture_first(out);
+    g_assert_cmpuint(g_bytes_get_size(out), == ,GBINDER_CAPTURE_MAGIC_SIZE +
+        2 * rec->size);
+    g_assert_cmpuint(rec->dir, == ,GBINDER_CAPTURE_OUTGOING);
+    g_assert_cmpuint(rec->handle, == ,5);
+    g_assert_cmpuint(rec->code, == ,7);
+    g_assert_cmpuint(rec->flags, == ,GBINDER_TX_FLAG_ONEWAY);
+    test_capture_check(io, rec, data);
+
+    /* Incoming offsets are derived from the object pointers */
+    rec = (const GBinderCaptureRecord*)((const guint8*)rec + rec->size);
+    g_assert_cmpuint(rec->dir, == ,GBINDER_CAPTURE_INCOMING);
+    g_assert_cmpuint(rec->code, == ,8);
+    test_capture_check(io, rec, data);
+
+    /* The captured data doesn't alias the original */
+    g_assert_cmpuint(io->decode_fd_object(data->data + TEST_PAYLOAD_SIZE,
+        data->len - TEST_PAYLOAD_SIZE, NULL), > ,0);
+    g_assert(!gbinder_capture_stop());
+
+    g_bytes_unref(out);
+    g_byte_array_free(data, TRUE);
+    gutil_int_array_free(offsets, TRUE);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * overflow
+ *==========================================================================*/
+
+static
+void
+test_overflow(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    GByteArray* data = g_byte_array_new();
+    const gsize rec_size = sizeof(GBinderCaptureRecord) + TEST_PAYLOAD_SIZE;
+    const GBinderCaptureRecord* rec;
+    GBytes* out;
+    guint i;
+
+    g_byte_array_set_size(data, TEST_PAYLOAD_SIZE);
+    memset(data->data, 0, data->len);
+
+    /* Only two records fit, the oldest one gets dropped */
+    g_assert(gbinder_capture_start_ring(2 * rec_size + 1));
+    for (i = 0; i < 3; i++) {
+        gbinder_capture_outgoing(io, 0, i, 0, data, NULL);
+    }
+
+    out = gbinder_capture_stop();
+    g_assert(out);
+    g_assert_cmpuint(g_bytes_get_size(out), == ,GBINDER_CAPTURE_MAGIC_SIZE +
+        2 * rec_size);
+    rec = test_capture_first(out);
+    g_assert_cmpuint(rec->size, == ,rec_size);
+    g_assert_cmpuint(rec->offsets_count, == ,0);
+    g_assert_cmpuint(rec->code, == ,1);
+    rec = (const GBinderCaptureRecord*)((const guint8*)rec + rec->size);
+    g_assert_cmpuint(rec->code, == ,2);
+
+    g_bytes_unref(out);
+    g_byte_array_free(data, TRUE);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * file
+ *==========================================================================*/
+
+static
+void
+test_file(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    GUtilIntArray* offsets = gutil_int_array_new();
+    GByteArray* data = test_capture_data(io, offsets);
+    GError* error = NULL;
+    char* path = NULL;
+    gchar* contents = NULL;
+    gsize size = 0;
+    const GBinderCaptureRecord* rec;
+    GBytes* bytes;
+    int fd;
+
+    fd = g_file_open_tmp("unit_capture_XXXXXX", &path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpint(fd, >= ,0);
+    close(fd);
+
+    g_assert(gbinder_capture_start_file(path));
+    g_assert(gbinder_capture_active());
+    gbinder_capture_outgoing(io, 3, 4, 0, data, offsets);
+    g_assert(!gbinder_capture_stop()); /* Nothing is returned for files */
+
+    g_assert(g_file_get_contents(path, &contents, &size, &error));
+    g_assert_no_error(error);
+    bytes = g_bytes_new_take(contents, size);
+    rec = test_capture_first(bytes);
+    g_assert_cmpuint(size, == ,GBINDER_CAPTURE_MAGIC_SIZE + rec->size);
+    g_assert_cmpuint(rec->dir, == ,GBINDER_CAPTURE_OUTGOING);
+    g_assert_cmpuint(rec->handle, == ,3);
+    g_assert_cmpuint(rec->code, == ,4);
+    test_capture_check(io, rec, data);
+
+    g_bytes_unref(bytes);
+    g_unlink(path);
+    g_free(path);
+    g_byte_array_free(data, TRUE);
+    gutil_int_array_free(offsets, TRUE);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * client
+ *==========================================================================*/
+
+static
+void
+test_client(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderRemoteObject* obj = gbinder_object_registry_get_remote(reg, 0, TRUE);
+    GBinderClient* client = gbinder_client_new(obj, "foo");
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const GBinderCaptureRecord* rec;
+    GBytes* out;
+    const guint32 code = 11;
+
+    g_assert(gbinder_capture_start_ring(0x10000));
+    test_binder_br_transaction_complete(fd);
+    g_assert_cmpint(gbinder_client_transact_sync_oneway(client, code, NULL),
+        == ,GBINDER_STATUS_OK);
+
+    out = gbinder_capture_stop();
+    g_assert(out);
+    rec = test_capture_first(out);
+    g_assert_cmpuint(g_bytes_get_size(out), == ,GBINDER_CAPTURE_MAGIC_SIZE +
+        rec->size);
+    g_assert_cmpuint(rec->dir, == ,GBINDER_CAPTURE_OUTGOING);
+    g_assert_cmpuint(rec->handle, == ,0);
+    g_assert_cmpuint(rec->code, == ,code);
+    g_assert(rec->flags & GBINDER_TX_FLAG_ONEWAY);
+    g_assert_cmpuint(rec->data_size, > ,0); /* Interface header */
+
+    g_bytes_unref(out);
+    gbinder_client_unref(client);
+    gbinder_remote_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * Common
+ *==========================================================================*/
+
+#define TEST_PREFIX "/capture/"
+#define TEST_(t) TEST_PREFIX t
+
+int main(int argc, char* argv[])
+{
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+    g_type_init();
+    G_GNUC_END_IGNORE_DEPRECATIONS;
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func(TEST_("null"), test_null);
+    g_test_add_func(TEST_("ring"), test_ring);
+    g_test_add_func(TEST_("overflow"), test_overflow);
+    g_test_add_func(TEST_("file"), test_file);
+    g_test_add_func(TEST_("client"), test_client);
+    test_init(&test_opt, argc, argv);
+    return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -34,8 +34,19 @@
 
 #include "gbinder_cleanup.h"
 
+#include <string.h>
+
 static TestOpt test_opt;
 
+#define TEST_MANY (100)
+
+typedef struct test_cleanup_order {
+    int last;
+    int calls;
+} TestCleanupOrder;
+
+static TestCleanupOrder test_order;
+
 static
 void
 test_cleanup_inc(
@@ -44,6 +55,43 @@ test_cleanup_inc(
     (*((int*)data))++;
 }
 
+static
+void
+test_cleanup_order(
+    gpointer data)
+{
+    const int i = GPOINTER_TO_INT(data);
+
+    g_assert_cmpint(i, == ,test_order.last + 1);
+    test_order.last = i;
+    test_order.calls++;
+}
+
+static
+void
+test_cleanup_order2(
+    gpointer data)
+{
+    test_cleanup_order(data);
+}
+
+static
+GBinderCleanup*
+test_cleanup_add_many(
+    GBinderCleanup* cleanup,
+    int n)
+{
+    int i;
+
+    /* Alternate runs of different functions of different length */
+    for (i = 1; i <= n; i++) {
+        cleanup = gbinder_cleanup_add(cleanup, ((i / 3) % 2) ?
+            test_cleanup_order : test_cleanup_order2, GINT_TO_POINTER(i));
+    }
+    memset(&test_order, 0, sizeof(test_order));
+    return cleanup;
+}
+
 /*==========================================================================*
  * null
  *==========================================================================*/
@@ -100,6 +148,34 @@ test_reset(
     g_assert(n2 == 1);
 }
 
+/*==========================================================================*
+ * many
+ *==========================================================================*/
+
+static
+void
+test_many(
+    void)
+{
+    GBinderCleanup* cleanup = test_cleanup_add_many(NULL, TEST_MANY);
+
+    /* Callbacks are invoked in the order they were added */
+    gbinder_cleanup_reset(cleanup);
+    g_assert_cmpint(test_order.calls, == ,TEST_MANY);
+
+    /* Nothing is left after reset */
+    gbinder_cleanup_reset(cleanup);
+    g_assert_cmpint(test_order.calls, == ,TEST_MANY);
+
+    /* Reuse it, with fewer and then with more entries than before */
+    g_assert(test_cleanup_add_many(cleanup, 5) == cleanup);
+    gbinder_cleanup_reset(cleanup);
+    g_assert_cmpint(test_order.calls, == ,5);
+    g_assert(test_cleanup_add_many(cleanup, 2 * TEST_MANY) == cleanup);
+    gbinder_cleanup_free(cleanup);
+    g_assert_cmpint(test_order.calls, == ,2 * TEST_MANY);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -113,6 +189,7 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("null"), test_null);
     g_test_add_func(TEST_("basic"), test_basic);
     g_test_add_func(TEST_("reset"), test_reset);
+    g_test_add_func(TEST_("many"), test_many);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
@@ -34,18 +34,29 @@
 
 #include "gbinder_client_p.h"
 #include "gbinder_driver.h"
+#include "gbinder_fmq_p.h"
 #include "gbinder_ipc.h"
+#include "gbinder_local_object_p.h"
 #include "gbinder_local_reply_p.h"
-#include "gbinder_local_request.h"
+#include "gbinder_local_request_p.h"
 #include "gbinder_object_registry.h"
 #include "gbinder_output_data.h"
+#include "gbinder_reader.h"
 #include "gbinder_remote_object_p.h"
 #include "gbinder_remote_reply.h"
+#include "gbinder_remote_request.h"
 #include "gbinder_writer.h"
 
 #include <gutil_log.h>
 
 #include <errno.h>
+#include <string.h>
+
+#if GBINDER_FMQ_SUPPORTED
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
 
 static TestOpt test_opt;
 
@@ -84,9 +95,13 @@ test_null(
     gbinder_client_unref(NULL);
     g_assert(!gbinder_client_new_request(NULL));
     g_assert(!gbinder_client_new_request2(NULL, 0));
+    g_assert(!gbinder_client_new_request3(NULL, 0, 0));
+    gbinder_client_set_adaptive_size(NULL, TRUE);
     g_assert(!gbinder_client_transact_sync_reply(NULL, 0, NULL, NULL));
     g_assert(gbinder_client_transact_sync_oneway(NULL, 0, NULL) == (-EINVAL));
     g_assert(!gbinder_client_transact(NULL, 0, 0, NULL, NULL, NULL, NULL));
+    g_assert(!gbinder_client_transact_batch(NULL, NULL, 0, NULL, NULL, NULL));
+    g_assert(!gbinder_client_broadcast(NULL, 1, 0, NULL, NULL, NULL, NULL));
     gbinder_client_cancel(NULL, 0);
 }
 
@@ -177,6 +192,54 @@ test_interfaces(
     gbinder_ipc_unref(ipc);
 }
 
+/*==========================================================================*
+ * shared_ifaces
+ *==========================================================================*/
+
+static
+void
+test_shared_ifaces(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderRemoteObject* obj = gbinder_object_registry_get_remote(reg, 0, TRUE);
+    static const GBinderClientIfaceInfo ifaces1[] = {
+        { "11", 11 }, { "22", 22 }
+    };
+    static const GBinderClientIfaceInfo ifaces2[] = {
+        { "11", 11 }, { "22", 23 }
+    };
+    char* iface = g_strdup("11");
+    GBinderClient* c1 = gbinder_client_new2(obj, ifaces1, 2);
+    GBinderClient* c2 = gbinder_client_new2(obj, ifaces1, 2);
+    GBinderClient* c3 = gbinder_client_new2(obj, ifaces2, 2);
+    GBinderClient* c4 = gbinder_client_new(obj, iface);
+    GBinderClient* c5 = gbinder_client_new(obj, "11");
+
+    /* Same interface list => same descriptor */
+    g_assert(c1 != c2);
+    g_assert(gbinder_client_rpc_header(c1, 22) ==
+        gbinder_client_rpc_header(c2, 22));
+    g_assert(gbinder_client_rpc_header(c1, 22) !=
+        gbinder_client_rpc_header(c3, 22));
+    g_assert(gbinder_client_rpc_header(c4, 1) ==
+        gbinder_client_rpc_header(c5, 1));
+    g_free(iface);
+    g_assert_cmpstr(gbinder_client_interface(c4), == ,"11");
+
+    /* Descriptor survives as long as there's a client using it */
+    gbinder_client_unref(c1);
+    g_assert_cmpstr(gbinder_client_interface2(c2, 22), == ,"22");
+    gbinder_client_unref(c2);
+    gbinder_client_unref(c3);
+    gbinder_client_unref(c4);
+    gbinder_client_unref(c5);
+
+    gbinder_remote_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+}
+
 /*==========================================================================*
  * no_header
  *==========================================================================*/
@@ -324,6 +387,103 @@ test_sync_reply(
     gbinder_client_unref(client);
 }
 
+/*==========================================================================*
+ * cache
+ *==========================================================================*/
+
+static
+void
+test_cache_reply(
+    int fd,
+    const GBinderIo* io,
+    const char* str)
+{
+    GBinderLocalReply* reply = gbinder_local_reply_new(io);
+
+    g_assert(gbinder_local_reply_append_string16(reply, str));
+    test_binder_br_noop(fd);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_reply(fd, 0, 1, gbinder_local_reply_data(reply)->bytes);
+    gbinder_local_reply_unref(reply);
+}
+
+static
+void
+test_cache_check(
+    GBinderRemoteReply* reply,
+    const char* expected)
+{
+    char* str = gbinder_remote_reply_read_string16(reply);
+
+    g_assert_cmpstr(str, == ,expected);
+    g_free(str);
+    gbinder_remote_reply_unref(reply);
+}
+
+static
+void
+test_cache(
+    void)
+{
+    GBinderClient* client = test_client_new(0, "foo");
+    GBinderDriver* driver = gbinder_client_ipc(client)->driver;
+    const GBinderIo* io = gbinder_driver_io(driver);
+    int fd = gbinder_driver_fd(driver);
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, 1);
+    GBinderRemoteReply* reply;
+    int status = INT_MAX;
+
+    gbinder_client_set_reply_cache(NULL, 0, 0);
+    gbinder_client_invalidate_cache(NULL);
+    gbinder_client_invalidate_cache(client);
+    gbinder_client_set_reply_cache(client, 1, 0);
+    gbinder_client_set_reply_cache(client, 1, 60000);
+
+    /* The first call goes to the driver */
+    test_cache_reply(fd, io, "foo");
+    reply = gbinder_client_transact_sync_reply(client, 1, req, &status);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    test_cache_check(reply, "foo");
+
+    /* The second one doesn't, nothing is queued for it */
+    status = INT_MAX;
+    reply = gbinder_client_transact_sync_reply(client, 1, req, &status);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    test_cache_check(reply, "foo");
+
+    /* Different request contents make a different key */
+    gbinder_local_request_append_int32(req, 1);
+    test_cache_reply(fd, io, "bar");
+    reply = gbinder_client_transact_sync_reply(client, 1, req, &status);
+    test_cache_check(reply, "bar");
+    reply = gbinder_client_transact_sync_reply(client, 1, req, NULL);
+    test_cache_check(reply, "bar");
+
+    /* Until the cache is invalidated */
+    gbinder_client_invalidate_cache(client);
+    test_cache_reply(fd, io, "baz");
+    reply = gbinder_client_transact_sync_reply(client, 1, req, &status);
+    test_cache_check(reply, "baz");
+
+    /* Other codes are not cached */
+    test_cache_reply(fd, io, "a");
+    test_cache_check(gbinder_client_transact_sync_reply(client, 2, NULL,
+        NULL), "a");
+    test_cache_reply(fd, io, "b");
+    test_cache_check(gbinder_client_transact_sync_reply(client, 2, NULL,
+        NULL), "b");
+
+    /* And this one is no longer cached either */
+    gbinder_client_set_reply_cache(client, 1, 0);
+    test_cache_reply(fd, io, "c");
+    test_cache_check(gbinder_client_transact_sync_reply(client, 1, req,
+        NULL), "c");
+
+    gbinder_local_request_unref(req);
+    gbinder_client_unref(client);
+}
+
 /*==========================================================================*
  * reply
  *==========================================================================*/
@@ -448,6 +608,1832 @@ test_reply_ok3(
     test_reply(test_reply_ok_quit, NULL);
 }
 
+/*==========================================================================*
+ * worker
+ *==========================================================================*/
+
+typedef struct test_worker {
+    GMainLoop* loop;
+    GThread* main_thread;
+    gint replies;
+} TestWorker;
+
+static
+void
+test_worker_reply(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    TestWorker* test = user_data;
+
+    /* Invoked right on the worker thread */
+    g_assert(g_thread_self() != test->main_thread);
+    test_reply_ok_reply(client, reply, status, NULL);
+    g_atomic_int_inc(&test->replies);
+}
+
+static
+void
+test_worker_destroy(
+    void* user_data)
+{
+    TestWorker* test = user_data;
+
+    /* But the destroy notification still comes from the event loop */
+    g_assert(g_thread_self() == test->main_thread);
+    g_assert_cmpint(g_atomic_int_get(&test->replies), == ,1);
+    test_quit_later(test->loop);
+}
+
+static
+void
+test_worker(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    GBinderDriver* driver = gbinder_client_ipc(client)->driver;
+    int fd = gbinder_driver_fd(driver);
+    GBinderLocalReply* reply = gbinder_local_reply_new
+        (gbinder_driver_io(driver));
+    TestWorker test;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.main_thread = g_thread_self();
+
+    g_assert(gbinder_local_reply_append_string16(reply, TEST_REQ_PARAM_STR));
+    test_binder_br_noop(fd);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_reply(fd, 0, 1, gbinder_local_reply_data(reply)->bytes);
+
+    g_assert(gbinder_client_transact(client, 0, GBINDER_TX_FLAG_WORKER, NULL,
+        test_worker_reply, test_worker_destroy, &test));
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.replies, == ,1);
+
+    gbinder_local_reply_unref(reply);
+    gbinder_client_unref(client);
+    g_main_loop_unref(test.loop);
+}
+
+/*==========================================================================*
+ * size_hint
+ *==========================================================================*/
+
+static
+void
+test_size_hint(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    int fd = gbinder_driver_fd(gbinder_client_ipc(client)->driver);
+    GBinderLocalRequest* req = gbinder_client_new_request3(client, 1, 4096);
+    GBinderOutputData* data = gbinder_local_request_data(req);
+    GBinderWriter writer;
+    const guint8* ptr = data->bytes->data;
+    const gsize len = data->bytes->len;
+    guint i;
+
+    /* Writing up to the hint doesn't reallocate the buffer */
+    gbinder_local_request_init_writer(req, &writer);
+    for (i = 0; i < (4096 - len) / 4; i++) {
+        gbinder_writer_append_int32(&writer, i);
+    }
+    g_assert(data->bytes->data == ptr);
+
+    /* Adaptive mode remembers the size of the last request */
+    gbinder_client_set_adaptive_size(client, TRUE);
+    test_binder_br_transaction_complete(fd);
+    g_assert_cmpint(gbinder_client_transact_sync_oneway(client, 1, req), == ,
+        GBINDER_STATUS_OK);
+    gbinder_local_request_unref(req);
+
+    req = gbinder_client_new_request2(client, 1);
+    data = gbinder_local_request_data(req);
+    ptr = data->bytes->data;
+    gbinder_local_request_init_writer(req, &writer);
+    for (i = 0; i < (4096 - len) / 4; i++) {
+        gbinder_writer_append_int32(&writer, i);
+    }
+    g_assert(data->bytes->data == ptr);
+    gbinder_local_request_unref(req);
+
+    /* Other codes don't get the hint */
+    req = gbinder_client_new_request2(client, 2);
+    g_assert(req);
+    gbinder_local_request_unref(req);
+
+    gbinder_client_unref(client);
+}
+
+/*==========================================================================*
+ * batch
+ *==========================================================================*/
+
+static
+void
+test_batch_reply(
+    GBinderClient* client,
+    GBinderRemoteReply* const* replies,
+    const int* status,
+    guint count,
+    void* user_data)
+{
+    char* result;
+
+    g_assert_cmpuint(count, == ,4);
+
+    /* One-way */
+    g_assert_cmpint(status[0], == ,GBINDER_STATUS_OK);
+    g_assert(!replies[0]);
+
+    /* Two-way */
+    g_assert_cmpint(status[1], == ,GBINDER_STATUS_OK);
+    g_assert(replies[1]);
+    result = gbinder_remote_reply_read_string16(replies[1]);
+    g_assert_cmpstr(result, == ,TEST_REQ_PARAM_STR);
+    g_free(result);
+
+    /* Failed one and the one that wasn't sent because of that */
+    g_assert_cmpint(status[2], == ,GBINDER_STATUS_DEAD_OBJECT);
+    g_assert(!replies[2]);
+    g_assert_cmpint(status[3], == ,-ECANCELED);
+    g_assert(!replies[3]);
+}
+
+static
+void
+test_batch(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    GBinderDriver* driver = gbinder_client_ipc(client)->driver;
+    int fd = gbinder_driver_fd(driver);
+    const GBinderIo* io = gbinder_driver_io(driver);
+    GBinderLocalReply* reply = gbinder_local_reply_new(io);
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, 2);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderClientBatchTx txs[4];
+    GBinderOutputData* data;
+
+    memset(txs, 0, sizeof(txs));
+    txs[0].code = 1;
+    txs[0].flags = GBINDER_TX_FLAG_ONEWAY;
+    txs[1].code = 2;
+    txs[1].req = req;
+    txs[2].code = 3;
+    txs[3].code = 4;
+
+    g_assert(!gbinder_client_transact_batch(client, NULL, 1, test_batch_reply,
+        NULL, NULL));
+    g_assert(!gbinder_client_transact_batch(client, txs, 0, test_batch_reply,
+        NULL, NULL));
+
+    g_assert(gbinder_local_reply_append_string16(reply, TEST_REQ_PARAM_STR));
+    data = gbinder_local_reply_data(reply);
+    g_assert(data);
+
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_reply(fd, 0, 2, data->bytes);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_dead_reply(fd);
+
+    g_assert(gbinder_client_transact_batch(client, txs, G_N_ELEMENTS(txs),
+        test_batch_reply, test_reply_destroy, loop));
+    gbinder_local_request_unref(req); /* Batch holds its own reference */
+
+    test_run(&test_opt, loop);
+
+    gbinder_local_reply_unref(reply);
+    gbinder_client_unref(client);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * max_pending
+ *==========================================================================*/
+
+static
+void
+test_max_pending(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    GBinderDriver* driver = gbinder_client_ipc(client)->driver;
+    int fd = gbinder_driver_fd(driver);
+    const GBinderIo* io = gbinder_driver_io(driver);
+    GBinderLocalReply* reply = gbinder_local_reply_new(io);
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, 0);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+
+    gbinder_client_set_max_pending(NULL, 0, 0);
+    gbinder_client_set_max_pending(client, 1, 0);
+    g_assert(gbinder_local_reply_append_string16(reply, TEST_REQ_PARAM_STR));
+
+    test_binder_br_noop(fd);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_reply(fd, 0, 1, gbinder_local_reply_data(reply)->bytes);
+
+    /* The second one doesn't fit */
+    g_assert(gbinder_client_transact(client, 0, 0, req, test_reply_ok_reply,
+        test_reply_destroy, loop));
+    g_assert(!gbinder_client_transact(client, 0, 0, req, NULL, NULL, NULL));
+    test_run(&test_opt, loop);
+
+    /* The limit is gone, let the next one through */
+    gbinder_client_set_max_pending(client, 0, 0);
+    test_binder_br_noop(fd);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_reply(fd, 0, 1, gbinder_local_reply_data(reply)->bytes);
+    g_assert(gbinder_client_transact(client, 0, 0, req, test_reply_ok_reply,
+        test_reply_destroy, loop));
+    test_run(&test_opt, loop);
+
+    gbinder_local_request_unref(req);
+    gbinder_local_reply_unref(reply);
+    gbinder_client_unref(client);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * coalesce
+ *==========================================================================*/
+
+typedef struct test_coalesce {
+    GMutex mutex;
+    GCond cond;
+    gboolean blocked;
+    GMainLoop* loop;
+    int replies;
+    int destroyed;
+} TestCoalesce;
+
+static
+void
+test_coalesce_block(
+    const GBinderIpcTx* tx)
+{
+    TestCoalesce* test = tx->user_data;
+
+    /* Keeps the only tx thread busy */
+    g_mutex_lock(&test->mutex);
+    while (test->blocked) {
+        g_cond_wait(&test->cond, &test->mutex);
+    }
+    g_mutex_unlock(&test->mutex);
+}
+
+static
+void
+test_coalesce_reply(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    TestCoalesce* test = user_data;
+
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    test->replies++;
+}
+
+static
+void
+test_coalesce_destroy(
+    void* user_data)
+{
+    TestCoalesce* test = user_data;
+
+    test->destroyed++;
+    if (test->destroyed == 3) {
+        test_quit_later(test->loop);
+    }
+}
+
+static
+void
+test_coalesce(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    GBinderIpc* ipc = gbinder_client_ipc(client);
+    int fd = gbinder_driver_fd(ipc->driver);
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, 0);
+    const guint32 code = 1;
+    TestCoalesce test;
+    gulong id;
+
+    memset(&test, 0, sizeof(test));
+    g_mutex_init(&test.mutex);
+    g_cond_init(&test.cond);
+    test.blocked = TRUE;
+    test.loop = g_main_loop_new(NULL, FALSE);
+
+    gbinder_client_set_coalesce_oneway(NULL, code, TRUE);
+    gbinder_client_set_coalesce_oneway(client, code, TRUE);
+    gbinder_client_set_coalesce_oneway(client, code, TRUE);
+    g_assert(gbinder_ipc_set_max_threads(ipc, 1));
+    g_assert(gbinder_ipc_transact_custom(ipc, test_coalesce_block, NULL,
+        NULL, &test));
+
+    /* The last two replace the first one */
+    id = gbinder_client_transact(client, code, GBINDER_TX_FLAG_ONEWAY, req,
+        test_coalesce_reply, test_coalesce_destroy, &test);
+    g_assert(id);
+    g_assert_cmpuint(gbinder_client_transact(client, code,
+        GBINDER_TX_FLAG_ONEWAY, req, test_coalesce_reply,
+        test_coalesce_destroy, &test), == ,id);
+    g_assert_cmpuint(gbinder_client_transact(client, code,
+        GBINDER_TX_FLAG_ONEWAY, req, test_coalesce_reply,
+        test_coalesce_destroy, &test), == ,id);
+    g_assert_cmpint(test.destroyed, == ,2);
+
+    /* Only one transaction is sent */
+    test_binder_br_transaction_complete(fd);
+    g_mutex_lock(&test.mutex);
+    test.blocked = FALSE;
+    g_cond_broadcast(&test.cond);
+    g_mutex_unlock(&test.mutex);
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.replies, == ,1);
+
+    gbinder_client_set_coalesce_oneway(client, code, FALSE);
+    gbinder_local_request_unref(req);
+    gbinder_client_unref(client);
+    g_main_loop_unref(test.loop);
+    g_cond_clear(&test.cond);
+    g_mutex_clear(&test.mutex);
+}
+
+/*==========================================================================*
+ * ordered
+ *==========================================================================*/
+
+typedef struct test_ordered {
+    TestCoalesce block;
+    guint32 codes[3];
+    int replies;
+} TestOrdered;
+
+typedef struct test_ordered_call {
+    TestOrdered* test;
+    guint32 code;
+} TestOrderedCall;
+
+static
+void
+test_ordered_reply(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    TestOrderedCall* call = user_data;
+    TestOrdered* test = call->test;
+
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(test->replies, < ,2);
+    test->codes[test->replies++] = call->code;
+    if (call->code == 2) {
+        char* str = gbinder_remote_reply_read_string16(reply);
+
+        g_assert_cmpstr(str, == ,TEST_REQ_PARAM_STR);
+        g_free(str);
+    } else {
+        g_assert(!reply);
+    }
+}
+
+static
+void
+test_ordered_destroy(
+    void* user_data)
+{
+    TestOrderedCall* call = user_data;
+
+    test_coalesce_destroy(&call->test->block);
+}
+
+static
+void
+test_ordered(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    GBinderIpc* ipc = gbinder_client_ipc(client);
+    int fd = gbinder_driver_fd(ipc->driver);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    GBinderLocalReply* reply = gbinder_local_reply_new(io);
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, 0);
+    TestOrderedCall calls[3];
+    TestOrdered test;
+    guint i;
+    gulong id;
+
+    memset(&test, 0, sizeof(test));
+    g_mutex_init(&test.block.mutex);
+    g_cond_init(&test.block.cond);
+    test.block.blocked = TRUE;
+    test.block.loop = g_main_loop_new(NULL, FALSE);
+    for (i = 0; i < G_N_ELEMENTS(calls); i++) {
+        calls[i].test = &test;
+        calls[i].code = i + 1;
+    }
+
+    gbinder_client_set_ordered(NULL, TRUE);
+    gbinder_client_set_ordered(client, TRUE);
+    g_assert(gbinder_local_reply_append_string16(reply, TEST_REQ_PARAM_STR));
+    g_assert(gbinder_ipc_set_max_threads(ipc, 1));
+    g_assert(gbinder_ipc_transact_custom(ipc, test_coalesce_block, NULL,
+        NULL, &test.block));
+
+    /* One-way call followed by a two-way one */
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_reply(fd, 0, 2, gbinder_local_reply_data(reply)->bytes);
+
+    g_assert(gbinder_client_transact(client, 1, GBINDER_TX_FLAG_ONEWAY, req,
+        test_ordered_reply, test_ordered_destroy, calls + 0));
+    g_assert(gbinder_client_transact(client, 2, 0, req,
+        test_ordered_reply, test_ordered_destroy, calls + 1));
+
+    /* The third one gets cancelled before it's sent */
+    id = gbinder_client_transact(client, 3, 0, req, test_ordered_reply,
+        test_ordered_destroy, calls + 2);
+    g_assert(id);
+    gbinder_client_cancel(client, id);
+
+    g_mutex_lock(&test.block.mutex);
+    test.block.blocked = FALSE;
+    g_cond_broadcast(&test.block.cond);
+    g_mutex_unlock(&test.block.mutex);
+    test_run(&test_opt, test.block.loop);
+
+    /* Replies arrive in the order of submission */
+    g_assert_cmpint(test.replies, == ,2);
+    g_assert_cmpuint(test.codes[0], == ,1);
+    g_assert_cmpuint(test.codes[1], == ,2);
+
+    gbinder_client_set_ordered(client, FALSE);
+    gbinder_local_request_unref(req);
+    gbinder_local_reply_unref(reply);
+    gbinder_client_unref(client);
+    g_main_loop_unref(test.block.loop);
+    g_cond_clear(&test.block.cond);
+    g_mutex_clear(&test.block.mutex);
+}
+
+/*==========================================================================*
+ * timeout
+ *==========================================================================*/
+
+static
+void
+test_timeout_reply(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    TestCoalesce* test = user_data;
+
+    g_assert(!reply);
+    g_assert_cmpint(status, == ,-ETIMEDOUT);
+    test->replies++;
+
+    /* Let the blocker go, the expired transaction won't be sent */
+    g_mutex_lock(&test->mutex);
+    test->blocked = FALSE;
+    g_cond_broadcast(&test->cond);
+    g_mutex_unlock(&test->mutex);
+}
+
+static
+void
+test_timeout_destroy(
+    void* user_data)
+{
+    TestCoalesce* test = user_data;
+
+    test->destroyed++;
+    test_quit_later(test->loop);
+}
+
+static
+void
+test_timeout(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    GBinderIpc* ipc = gbinder_client_ipc(client);
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, 0);
+    TestCoalesce test;
+
+    memset(&test, 0, sizeof(test));
+    g_mutex_init(&test.mutex);
+    g_cond_init(&test.cond);
+    test.blocked = TRUE;
+    test.loop = g_main_loop_new(NULL, FALSE);
+
+    gbinder_client_set_timeout(NULL, 0);
+    gbinder_client_set_timeout(client, 10);
+    g_assert(gbinder_ipc_set_max_threads(ipc, 1));
+    g_assert(gbinder_ipc_transact_custom(ipc, test_coalesce_block, NULL,
+        NULL, &test));
+    g_assert(gbinder_client_transact(client, 1, 0, req, test_timeout_reply,
+        test_timeout_destroy, &test));
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.replies, == ,1);
+    g_assert_cmpint(test.destroyed, == ,1);
+
+    gbinder_local_request_unref(req);
+    gbinder_client_unref(client);
+    g_main_loop_unref(test.loop);
+    g_cond_clear(&test.cond);
+    g_mutex_clear(&test.mutex);
+}
+
+/*==========================================================================*
+ * timeout_pending
+ *==========================================================================*/
+
+static
+void
+test_timeout_pending_reply(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    TestCoalesce* test = user_data;
+
+    g_assert(!reply);
+    g_assert_cmpint(status, == ,-ETIMEDOUT);
+    test->replies++;
+}
+
+static
+void
+test_timeout_pending(
+    void)
+{
+    GBinderClient* client = test_client_new(0, TEST_INTERFACE);
+    GBinderIpc* ipc = gbinder_client_ipc(client);
+    GBinderLocalRequest* req = gbinder_client_new_request2(client, 0);
+    TestCoalesce test;
+
+    memset(&test, 0, sizeof(test));
+    g_mutex_init(&test.mutex);
+    g_cond_init(&test.cond);
+    test.blocked = TRUE;
+    test.loop = g_main_loop_new(NULL, FALSE);
+
+    gbinder_client_set_max_pending(client, 1, 0);
+    g_assert(gbinder_ipc_set_max_threads(ipc, 1));
+    g_assert(gbinder_ipc_transact_custom(ipc, test_coalesce_block, NULL,
+        NULL, &test));
+
+    /* The second one doesn't fit */
+    g_assert(gbinder_client_transact_with_timeout(client, 1, 0, req, 10,
+        test_timeout_pending_reply, test_timeout_destroy, &test));
+    g_assert(!gbinder_client_transact_with_timeout(client, 1, 0, req, 10,
+        NULL, NULL, NULL));
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.replies, == ,1);
+    g_assert_cmpint(test.destroyed, == ,1);
+
+    /* The thread is still blocked but the slot has been released */
+    g_assert(gbinder_client_transact_with_timeout(client, 1, 0, req, 10,
+        test_timeout_pending_reply, test_timeout_destroy, &test));
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.replies, == ,2);
+    g_assert_cmpint(test.destroyed, == ,2);
+
+    /* Let the blocker go */
+    g_mutex_lock(&test.mutex);
+    test.blocked = FALSE;
+    g_cond_broadcast(&test.cond);
+    g_mutex_unlock(&test.mutex);
+
+    gbinder_local_request_unref(req);
+    gbinder_client_unref(client);
+    g_main_loop_unref(test.loop);
+    g_cond_clear(&test.cond);
+    g_mutex_clear(&test.mutex);
+}
+
+/*==========================================================================*
+ * local
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+test_local_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+    char* str = gbinder_remote_request_read_string16(req);
+    int* count = user_data;
+
+    g_assert_cmpstr(str, == ,TEST_REQ_PARAM_STR);
+    gbinder_local_reply_append_string16(reply, str);
+    g_free(str);
+    (*count)++;
+    *status = GBINDER_STATUS_OK;
+    return reply;
+}
+
+static
+void
+test_local(
+    void)
+{
+    static const char* const ifaces[] = { TEST_INTERFACE, NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    int count = 0;
+    GBinderLocalObject* obj = gbinder_local_object_new(ipc, ifaces,
+        test_local_handler, &count);
+    GBinderRemoteObject* remote = gbinder_remote_object_new_local(obj);
+    GBinderClient* client = gbinder_client_new(remote, TEST_INTERFACE);
+    GBinderLocalRequest* req = gbinder_client_new_request(client);
+    GBinderRemoteReply* reply;
+    char* str;
+    int status = INT_MAX;
+
+    /* Nothing is written to the driver */
+    g_assert(remote->local == obj);
+    gbinder_local_request_append_string16(req, TEST_REQ_PARAM_STR);
+    reply = gbinder_client_transact_sync_reply(client, 1, req, &status);
+    g_assert(reply);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(count, == ,1);
+    str = gbinder_remote_reply_read_string16(reply);
+    g_assert_cmpstr(str, == ,TEST_REQ_PARAM_STR);
+    gbinder_remote_reply_unref(reply);
+    g_free(str);
+
+    g_assert_cmpint(gbinder_client_transact_sync_oneway(client, 1, req),
+        == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(count, == ,2);
+
+    /* Asynchronous variant completes on the main thread */
+    g_assert(gbinder_client_transact(client, 1, 0, req, test_reply_ok_reply,
+        test_reply_destroy, loop));
+    test_run(&test_opt, loop);
+    g_assert_cmpint(count, == ,3);
+
+    gbinder_local_request_unref(req);
+    gbinder_client_unref(client);
+    gbinder_remote_object_unref(remote);
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * chunked
+ *==========================================================================*/
+
+#define TEST_CHUNKED_CODE (100)
+#define TEST_CHUNKED_TX (1)
+#define TEST_CHUNKED_REJECTED_TX (2)
+#define TEST_CHUNKED_SIZE (1000)
+#define TEST_CHUNKED_REQ_SIZE (4500)
+
+typedef struct test_chunked {
+    GMainLoop* loop;
+    GBinderClient* client;
+    GBinderClient* raw;
+    gsize reply_size;
+    int count;
+} TestChunked;
+
+/* Refuses TEST_CHUNKED_REJECTED_TX before it gets to the handler */
+typedef GBinderLocalObjectClass TestChunkedObjectClass;
+typedef GBinderLocalObject TestChunkedObject;
+G_DEFINE_TYPE(TestChunkedObject, test_chunked_object, \
+        GBINDER_TYPE_LOCAL_OBJECT)
+
+static
+GBINDER_LOCAL_TRANSACTION_SUPPORT
+test_chunked_object_can_handle_transaction(
+    GBinderLocalObject* object,
+    const char* iface,
+    guint code)
+{
+    return (code == TEST_CHUNKED_REJECTED_TX) ?
+        GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED :
+        GBINDER_LOCAL_OBJECT_CLASS(test_chunked_object_parent_class)->
+            can_handle_transaction(object, iface, code);
+}
+
+static
+void
+test_chunked_object_init(
+    TestChunkedObject* self)
+{
+}
+
+static
+void
+test_chunked_object_class_init(
+    TestChunkedObjectClass* klass)
+{
+    klass->can_handle_transaction = test_chunked_object_can_handle_transaction;
+}
+
+static
+void
+test_chunked_fill(
+    guint8* data,
+    gsize size,
+    guint8 seed)
+{
+    gsize i;
+
+    for (i = 0; i < size; i++) {
+        data[i] = (guint8)(seed + i);
+    }
+}
+
+static
+void
+test_chunked_check(
+    const guint8* data,
+    gsize size,
+    guint8 seed)
+{
+    gsize i;
+
+    for (i = 0; i < size; i++) {
+        g_assert_cmpuint(data[i], == ,(guint8)(seed + i));
+    }
+}
+
+static
+GBinderLocalReply*
+test_chunked_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestChunked* test = user_data;
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+    guint8* out = g_malloc(test->reply_size);
+    GBinderReader reader;
+    GBinderWriter writer;
+    const guint8* in;
+    gsize size;
+
+    g_assert_cmpuint(code, == ,TEST_CHUNKED_TX);
+    g_assert(!flags);
+    g_assert_cmpstr(gbinder_remote_request_interface(req), == ,
+        TEST_INTERFACE);
+    gbinder_remote_request_init_reader(req, &reader);
+    in = gbinder_reader_read_byte_array(&reader, &size);
+    g_assert(in);
+    test_chunked_check(in, size, 1);
+    g_assert(gbinder_reader_at_end(&reader));
+
+    gbinder_local_reply_init_writer(reply, &writer);
+    test_chunked_fill(out, test->reply_size, 2);
+    gbinder_writer_append_byte_array(&writer, out, test->reply_size);
+    g_free(out);
+    test->count++;
+    *status = GBINDER_STATUS_OK;
+    return reply;
+}
+
+static
+void
+test_chunked_transact(
+    TestChunked* test,
+    gsize req_size,
+    gboolean force)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request2(test->client,
+        TEST_CHUNKED_TX);
+    guint8* data = g_malloc(req_size);
+    GBinderRemoteReply* reply;
+    GBinderReader reader;
+    GBinderWriter writer;
+    const guint8* out;
+    gsize size;
+    int status = INT_MAX;
+
+    gbinder_local_request_init_writer(req, &writer);
+    test_chunked_fill(data, req_size, 1);
+    gbinder_writer_append_byte_array(&writer, data, req_size);
+    g_free(data);
+    reply = force ?
+        gbinder_client_transact_chunked(test->client, TEST_CHUNKED_TX, req,
+            &status) :
+        gbinder_client_transact_sync_reply(test->client, TEST_CHUNKED_TX, req,
+            &status);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert(reply);
+    gbinder_remote_reply_init_reader(reply, &reader);
+    out = gbinder_reader_read_byte_array(&reader, &size);
+    g_assert(out);
+    g_assert_cmpuint(size, == ,test->reply_size);
+    test_chunked_check(out, size, 2);
+    g_assert(gbinder_reader_at_end(&reader));
+    gbinder_remote_reply_unref(reply);
+    gbinder_local_request_unref(req);
+}
+
+/* Sends the whole request as a single chunk, bypassing the client */
+static
+GBinderRemoteReply*
+test_chunked_put(
+    TestChunked* test,
+    guint32 code,
+    guint32 chunk,
+    int* status)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request2(test->raw, code);
+    GBinderLocalRequest* put = gbinder_client_new_request(test->raw);
+    GBinderRemoteReply* reply;
+    GBinderWriter writer;
+    GByteArray* in;
+    guint8 data[10];
+
+    test_chunked_fill(data, sizeof(data), 1);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_byte_array(&writer, data, sizeof(data));
+    in = gbinder_local_request_data(req)->bytes;
+
+    gbinder_local_request_init_writer(put, &writer);
+    gbinder_writer_append_int32(&writer, GBINDER_CHUNK_PUT);
+    gbinder_writer_append_int32(&writer, code); /* Transfer id */
+    gbinder_writer_append_int32(&writer, code);
+    gbinder_writer_append_int32(&writer, in->len);
+    gbinder_writer_append_int32(&writer, 0);
+    gbinder_writer_append_int32(&writer, chunk);
+    gbinder_writer_append_byte_array(&writer, in->data, in->len);
+    reply = gbinder_client_transact_sync_reply(test->raw, TEST_CHUNKED_CODE,
+        put, status);
+    gbinder_local_request_unref(put);
+    gbinder_local_request_unref(req);
+    return reply;
+}
+
+static
+gpointer
+test_chunked_thread(
+    gpointer user_data)
+{
+    TestChunked* test = user_data;
+    GBinderRemoteReply* reply;
+    GBinderReader reader;
+    guint32 total;
+    gsize size;
+    int status = INT_MAX;
+
+    /* Large request, small reply */
+    test->reply_size = 10;
+    test_chunked_transact(test, TEST_CHUNKED_REQ_SIZE, FALSE);
+    g_assert_cmpint(test->count, == ,1);
+
+    /* Small request, large reply */
+    test->reply_size = 3 * TEST_CHUNKED_SIZE + 1;
+    test_chunked_transact(test, 10, TRUE);
+    g_assert_cmpint(test->count, == ,2);
+
+    /* Empty request, empty reply */
+    test->reply_size = 0;
+    test_chunked_transact(test, 0, TRUE);
+    g_assert_cmpint(test->count, == ,3);
+
+    /* The reply is split into pieces of a sane size */
+    test->reply_size = 2 * GBINDER_LOCAL_OBJECT_MAX_CHUNK_SIZE;
+    reply = test_chunked_put(test, TEST_CHUNKED_TX,
+        4 * GBINDER_LOCAL_OBJECT_MAX_CHUNK_SIZE, &status);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(test->count, == ,4);
+    g_assert(reply);
+    gbinder_remote_reply_init_reader(reply, &reader);
+    g_assert(gbinder_reader_read_uint32(&reader, &total));
+    g_assert_cmpuint(total, > ,test->reply_size);
+    g_assert(gbinder_reader_read_byte_array(&reader, &size));
+    g_assert_cmpuint(size, == ,GBINDER_LOCAL_OBJECT_MAX_CHUNK_SIZE);
+    gbinder_remote_reply_unref(reply);
+
+    /* The reassembled request must be acceptable to the object */
+    g_assert(!test_chunked_put(test, TEST_CHUNKED_REJECTED_TX,
+        TEST_CHUNKED_SIZE, &status));
+    g_assert_cmpint(status, != ,GBINDER_STATUS_OK);
+    g_assert_cmpint(test->count, == ,4);
+
+    test_quit_later(test->loop);
+    return NULL;
+}
+
+static
+void
+test_chunked_run(
+    void)
+{
+    static const char* const ifaces[] = { TEST_INTERFACE, NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderIpc* ipc_obj = gbinder_ipc_new(GBINDER_DEFAULT_BINDER "-private",
+        NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const int fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    GBinderLocalObject* obj;
+    GBinderRemoteObject* remote;
+    TestChunked test;
+    GThread* thread;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    obj = gbinder_local_object_new_with_type(test_chunked_object_get_type(),
+        ipc_obj, ifaces, test_chunked_handler, &test);
+    gbinder_local_object_accept_chunked(obj, TEST_CHUNKED_CODE,
+        2 * TEST_CHUNKED_REQ_SIZE);
+    remote = gbinder_remote_object_new(ipc,
+        test_binder_register_object(fd_obj, obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    test.client = gbinder_client_new(remote, TEST_INTERFACE);
+    test.raw = gbinder_client_new(remote, TEST_INTERFACE);
+    gbinder_client_set_chunking(test.client, TEST_CHUNKED_CODE,
+        TEST_CHUNKED_SIZE);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+
+    /* The handler is invoked on the main thread */
+    thread = g_thread_new("chunked", test_chunked_thread, &test);
+    test_run(&test_opt, test.loop);
+    g_thread_join(thread);
+    g_assert_cmpint(test.count, == ,4);
+
+    test_binder_unregister_objects(fd_obj);
+    gbinder_local_object_drop(obj);
+    gbinder_remote_object_unref(remote);
+    gbinder_client_unref(test.client);
+    gbinder_client_unref(test.raw);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_chunked(
+    void)
+{
+    test_run_in_context(&test_opt, test_chunked_run);
+}
+
+/*==========================================================================*
+ * fmq
+ *==========================================================================*/
+
+#if GBINDER_FMQ_SUPPORTED
+
+#define TEST_FMQ_CODE (100)
+#define TEST_FMQ_TX (1)
+#define TEST_FMQ_FLUSH_TX (2)
+#define TEST_FMQ_SIZE (256)
+#define TEST_FMQ_MAX_CALLS (8)
+
+typedef struct test_fmq {
+    GMainLoop* loop;
+    GBinderClient* client;
+    GBinderLocalObject* token;
+    gint32 values[TEST_FMQ_MAX_CALLS];
+    guint count;
+} TestFmq;
+
+static
+gboolean
+test_fmq_supported(
+    void)
+{
+    /* Some test environments don't know how handle this syscall */
+    const int fd = syscall(__NR_memfd_create, "test", MFD_CLOEXEC);
+
+    if (fd >= 0) {
+        close(fd);
+        return TRUE;
+    } else {
+        GINFO("Skipping tests that rely on memfd_create");
+        return FALSE;
+    }
+}
+
+static
+GBinderLocalReply*
+test_fmq_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestFmq* test = user_data;
+    GBinderReader reader;
+    gint32 value;
+
+    /* Records the values passed to TEST_FMQ_TX */
+    if (code == TEST_FMQ_TX) {
+        g_assert_cmpuint(flags, == ,GBINDER_TX_FLAG_ONEWAY);
+        g_assert_cmpstr(gbinder_remote_request_interface(req), == ,
+            TEST_INTERFACE);
+        gbinder_remote_request_init_reader(req, &reader);
+        g_assert(gbinder_reader_read_int32(&reader, &value));
+        g_assert_cmpuint(test->count, < ,TEST_FMQ_MAX_CALLS);
+        test->values[test->count++] = value;
+    } else {
+        g_assert_cmpuint(code, == ,TEST_FMQ_FLUSH_TX);
+        g_assert(!flags);
+    }
+    *status = GBINDER_STATUS_OK;
+    return NULL;
+}
+
+/* Opens the channel without the help of the client */
+static
+int
+test_fmq_open(
+    TestFmq* test)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request2(test->client,
+        TEST_FMQ_CODE);
+    GBinderFmq* fmq = gbinder_fmq_new(1, TEST_FMQ_SIZE,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+    GBinderWriter writer;
+    int status = INT_MAX;
+
+    g_assert(fmq);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_fmq_descriptor(&writer, fmq);
+    gbinder_writer_append_local_object(&writer, test->token);
+    gbinder_remote_reply_unref(gbinder_client_transact_sync_reply
+        (test->client, TEST_FMQ_CODE, req, &status));
+    gbinder_local_request_unref(req);
+    gbinder_fmq_unref(fmq);
+    return status;
+}
+
+static
+gpointer
+test_fmq_fill_thread(
+    gpointer user_data)
+{
+    TestFmq* test = user_data;
+    int i;
+
+    for (i = 0; i < GBINDER_LOCAL_OBJECT_MAX_FMQ_CHANNELS; i++) {
+        g_assert_cmpint(test_fmq_open(test), == ,GBINDER_STATUS_OK);
+    }
+    g_assert_cmpint(test_fmq_open(test), == ,-EBUSY);
+    test_quit_later(test->loop);
+    return NULL;
+}
+
+static
+gpointer
+test_fmq_reopen_thread(
+    gpointer user_data)
+{
+    TestFmq* test = user_data;
+
+    g_assert_cmpint(test_fmq_open(test), == ,GBINDER_STATUS_OK);
+    test_quit_later(test->loop);
+    return NULL;
+}
+
+static
+void
+test_fmq_token_died(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    GVERBOSE_("");
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+void
+test_fmq_peer_death_run(
+    void)
+{
+    static const char* const ifaces[] = { TEST_INTERFACE, NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderIpc* ipc_obj = gbinder_ipc_new(GBINDER_DEFAULT_BINDER "-private",
+        NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const int fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    GBinderLocalObject* obj;
+    GBinderRemoteObject* remote;
+    GBinderRemoteObject* token;
+    TestFmq test;
+    GThread* thread;
+    gulong id;
+    int h;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    obj = gbinder_local_object_new(ipc_obj, ifaces, test_fmq_handler, &test);
+    gbinder_local_object_accept_fmq_channel(obj, TEST_FMQ_CODE);
+    remote = gbinder_remote_object_new(ipc,
+        test_binder_register_object(fd_obj, obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    test.client = gbinder_client_new(remote, TEST_INTERFACE);
+    test.token = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+
+    /* Use up all the channels */
+    thread = g_thread_new("fmq", test_fmq_fill_thread, &test);
+    test_run(&test_opt, test.loop);
+    g_thread_join(thread);
+
+    /* Kill the writer, its channels get closed before our handler runs */
+    h = test_binder_handle(fd_obj, test.token);
+    g_assert_cmpint(h, > ,0);
+    token = gbinder_object_registry_get_remote
+        (gbinder_ipc_object_registry(ipc_obj), h, REMOTE_REGISTRY_DONT_CREATE);
+    g_assert(token);
+    id = gbinder_remote_object_add_death_handler(token, test_fmq_token_died,
+        test.loop);
+    gbinder_local_object_drop(test.token);
+    test_binder_br_dead_binder(fd_obj, h);
+    test_run(&test_opt, test.loop);
+    g_assert(gbinder_remote_object_is_dead(token));
+    gbinder_remote_object_remove_handler(token, id);
+    gbinder_remote_object_unref(token);
+
+    /* The next writer gets a channel */
+    test.token = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+    thread = g_thread_new("fmq", test_fmq_reopen_thread, &test);
+    test_run(&test_opt, test.loop);
+    g_thread_join(thread);
+
+    test_binder_unregister_objects(fd_obj);
+    gbinder_local_object_drop(obj);
+    gbinder_local_object_drop(test.token);
+    gbinder_remote_object_unref(remote);
+    gbinder_client_unref(test.client);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_fmq_peer_death(
+    void)
+{
+    test_run_in_context(&test_opt, test_fmq_peer_death_run);
+}
+
+static
+int
+test_fmq_send(
+    TestFmq* test,
+    gint32 value,
+    gsize padding,
+    GBinderLocalObject* obj)
+{
+    GBinderLocalRequest* req = gbinder_client_new_request2(test->client,
+        TEST_FMQ_TX);
+    GBinderWriter writer;
+    int status;
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_int32(&writer, value);
+    if (padding) {
+        void* data = g_malloc0(padding);
+
+        gbinder_writer_append_byte_array(&writer, data, padding);
+        g_free(data);
+    }
+    if (obj) {
+        gbinder_writer_append_local_object(&writer, obj);
+    }
+    status = gbinder_client_transact_fmq_oneway(test->client, TEST_FMQ_TX,
+        req);
+    gbinder_local_request_unref(req);
+    return status;
+}
+
+static
+gpointer
+test_fmq_round_trip_thread(
+    gpointer user_data)
+{
+    TestFmq* test = user_data;
+    int status = INT_MAX;
+
+    /* The channel isn't open yet, this one goes through the driver */
+    g_assert_cmpint(test_fmq_send(test, 1, 0, NULL), == ,GBINDER_STATUS_OK);
+
+    /* Open it (twice) and send a few through the queue */
+    g_assert(!gbinder_client_open_fmq_channel(test->client, TEST_FMQ_CODE,
+        0));
+    g_assert(gbinder_client_open_fmq_channel(test->client, TEST_FMQ_CODE,
+        TEST_FMQ_SIZE));
+    g_assert(gbinder_client_open_fmq_channel(test->client, TEST_FMQ_CODE,
+        TEST_FMQ_SIZE));
+    g_assert_cmpint(test_fmq_send(test, 2, 0, NULL), == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(test_fmq_send(test, 3, 0, NULL), == ,GBINDER_STATUS_OK);
+
+    /* Objects and whatever doesn't fit fall back to the driver */
+    g_assert_cmpint(test_fmq_send(test, 4, 0, test->token), == ,
+        GBINDER_STATUS_OK);
+    g_assert_cmpint(test_fmq_send(test, 5, 2 * TEST_FMQ_SIZE, NULL), == ,
+        GBINDER_STATUS_OK);
+
+    /* The queue is drained before this one gets handled */
+    gbinder_remote_reply_unref(gbinder_client_transact_sync_reply
+        (test->client, TEST_FMQ_FLUSH_TX, NULL, &status));
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+
+    test_quit_later(test->loop);
+    return NULL;
+}
+
+static
+void
+test_fmq_round_trip_run(
+    void)
+{
+    static const char* const ifaces[] = { TEST_INTERFACE, NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderIpc* ipc_obj = gbinder_ipc_new(GBINDER_DEFAULT_BINDER "-private",
+        NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const int fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    GBinderLocalObject* obj;
+    GBinderRemoteObject* remote;
+    TestFmq test;
+    GThread* thread;
+    guint i;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    obj = gbinder_local_object_new(ipc_obj, ifaces, test_fmq_handler, &test);
+    gbinder_local_object_accept_fmq_channel(obj, TEST_FMQ_CODE);
+    remote = gbinder_remote_object_new(ipc,
+        test_binder_register_object(fd_obj, obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    test.client = gbinder_client_new(remote, TEST_INTERFACE);
+    test.token = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+
+    /* The handler is invoked on the main thread */
+    thread = g_thread_new("fmq", test_fmq_round_trip_thread, &test);
+    test_run(&test_opt, test.loop);
+    g_thread_join(thread);
+
+    /* Nothing got lost or reordered */
+    g_assert_cmpuint(test.count, == ,5);
+    for (i = 0; i < test.count; i++) {
+        g_assert_cmpint(test.values[i], == ,i + 1);
+    }
+
+    test_binder_unregister_objects(fd_obj);
+    gbinder_local_object_drop(obj);
+    gbinder_local_object_drop(test.token);
+    gbinder_remote_object_unref(remote);
+    gbinder_client_unref(test.client);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_fmq_round_trip(
+    void)
+{
+    test_run_in_context(&test_opt, test_fmq_round_trip_run);
+}
+
+#endif /* GBINDER_FMQ_SUPPORTED */
+
+/*==========================================================================*
+ * lane
+ *==========================================================================*/
+
+typedef struct test_lane {
+    GMainLoop* loop;
+    GMutex mutex;
+    GCond cond;
+    gboolean released;
+    guint32 order[3];
+    guint received;
+} TestLane;
+
+static
+void
+test_lane_block(
+    const GBinderIpcTx* tx)
+{
+    TestLane* test = tx->user_data;
+
+    /* Holds the only worker until the realtime call gets through */
+    g_mutex_lock(&test->mutex);
+    while (!test->released) {
+        g_cond_wait(&test->cond, &test->mutex);
+    }
+    g_mutex_unlock(&test->mutex);
+}
+
+static
+GBinderLocalReply*
+test_lane_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestLane* test = user_data;
+
+    g_assert_cmpuint(test->received, < ,G_N_ELEMENTS(test->order));
+    GDEBUG("Call %u received", code);
+    test->order[test->received++] = code;
+    if (code == 3) {
+        g_mutex_lock(&test->mutex);
+        test->released = TRUE;
+        g_cond_broadcast(&test->cond);
+        g_mutex_unlock(&test->mutex);
+    }
+    if (test->received == G_N_ELEMENTS(test->order)) {
+        test_quit_later(test->loop);
+    }
+    return NULL;
+}
+
+static
+void
+test_lane_run(
+    void)
+{
+    static const char* const ifaces[] = { TEST_INTERFACE, NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderIpc* ipc_obj = gbinder_ipc_new(GBINDER_DEFAULT_BINDER "-private",
+        NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const int fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    const guint32 flags = GBINDER_TX_FLAG_ONEWAY;
+    GBinderLocalObject* obj;
+    GBinderRemoteObject* remote;
+    GBinderClient* client;
+    TestLane test;
+
+    memset(&test, 0, sizeof(test));
+    g_mutex_init(&test.mutex);
+    g_cond_init(&test.cond);
+    test.loop = g_main_loop_new(NULL, FALSE);
+    obj = gbinder_local_object_new(ipc_obj, ifaces, test_lane_handler,
+        &test);
+    remote = gbinder_remote_object_new(ipc,
+        test_binder_register_object(fd_obj, obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    client = gbinder_client_new(remote, TEST_INTERFACE);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+    g_assert(gbinder_ipc_set_max_threads(ipc, 1));
+    gbinder_client_set_lane(NULL, 0);
+
+    /* The first one occupies the worker, the rest gets queued */
+    g_assert(gbinder_ipc_transact_custom(ipc, test_lane_block, NULL,
+        NULL, &test));
+    gbinder_client_set_lane(client, GBINDER_TX_FLAG_BACKGROUND);
+    g_assert(gbinder_client_transact(client, 1, flags, NULL, NULL, NULL,
+        NULL));
+    gbinder_client_set_lane(client, 0);
+    g_assert(gbinder_client_transact(client, 2, flags, NULL, NULL, NULL,
+        NULL));
+
+    /* The lane specified by the caller wins */
+    gbinder_client_set_lane(client, GBINDER_TX_FLAG_BACKGROUND);
+    g_assert(gbinder_client_transact(client, 3, flags |
+        GBINDER_TX_FLAG_REALTIME, NULL, NULL, NULL, NULL));
+    test_run(&test_opt, test.loop);
+
+    /* Realtime one bypasses the queue, background goes last */
+    g_assert_cmpuint(test.order[0], == ,3);
+    g_assert_cmpuint(test.order[1], == ,2);
+    g_assert_cmpuint(test.order[2], == ,1);
+
+    test_binder_unregister_objects(fd_obj);
+    gbinder_local_object_drop(obj);
+    gbinder_remote_object_unref(remote);
+    gbinder_client_unref(client);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+    g_mutex_clear(&test.mutex);
+    g_cond_clear(&test.cond);
+}
+
+static
+void
+test_lane(
+    void)
+{
+    test_run_in_context(&test_opt, test_lane_run);
+}
+
+/*==========================================================================*
+ * single_flight
+ *==========================================================================*/
+
+#define TEST_FLIGHT_TX (3)
+
+typedef struct test_flight {
+    GMainLoop* loop;
+    GBinderClient* client;
+    GBinderLocalObject* ret; /* Returned in the reply, if any */
+    GThread* follower;
+    GBinderRemoteReply* reply[2];
+    int count;
+} TestFlight;
+
+static
+gpointer
+test_flight_follower(
+    gpointer user_data)
+{
+    TestFlight* test = user_data;
+    GBinderLocalRequest* req = gbinder_client_new_request2(test->client,
+        TEST_FLIGHT_TX);
+    int status = INT_MAX;
+
+    gbinder_local_request_append_int32(req, 42);
+    test->reply[1] = gbinder_client_transact_sync_reply(test->client,
+        TEST_FLIGHT_TX, req, &status);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    gbinder_local_request_unref(req);
+    return NULL;
+}
+
+static
+GBinderLocalReply*
+test_flight_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestFlight* test = user_data;
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+    gint32 value = 0;
+
+    g_assert_cmpuint(code, == ,TEST_FLIGHT_TX);
+    g_assert(gbinder_remote_request_read_int32(req, &value));
+    g_assert_cmpint(value, == ,42);
+    if (++test->count == 1) {
+        /* The identical call made in the meantime attaches to this one */
+        test->follower = g_thread_new("follower", test_flight_follower, test);
+        g_usleep(100000);
+    }
+
+    gbinder_local_reply_append_int32(reply, test->count);
+    if (test->ret) {
+        gbinder_local_reply_append_local_object(reply, test->ret);
+    }
+    *status = GBINDER_STATUS_OK;
+    return reply;
+}
+
+static
+gpointer
+test_flight_leader(
+    gpointer user_data)
+{
+    TestFlight* test = user_data;
+    GBinderLocalRequest* req = gbinder_client_new_request2(test->client,
+        TEST_FLIGHT_TX);
+    int status = INT_MAX;
+
+    gbinder_local_request_append_int32(req, 42);
+    test->reply[0] = gbinder_client_transact_sync_reply(test->client,
+        TEST_FLIGHT_TX, req, &status);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    gbinder_local_request_unref(req);
+
+    g_thread_join(test->follower);
+    test_quit_later(test->loop);
+    return NULL;
+}
+
+static
+void
+test_single_flight_common(
+    gboolean objects)
+{
+    static const char* const ifaces[] = { TEST_INTERFACE, NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderIpc* ipc_obj = gbinder_ipc_new(GBINDER_DEFAULT_BINDER "-private",
+        NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const int fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    GBinderLocalObject* obj;
+    GBinderRemoteObject* remote;
+    TestFlight test;
+    GThread* thread;
+    gint32 value = 0;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    obj = gbinder_local_object_new(ipc_obj, ifaces, test_flight_handler,
+        &test);
+    if (objects) {
+        test.ret = gbinder_local_object_new(ipc_obj, ifaces, NULL, NULL);
+    }
+    remote = gbinder_remote_object_new(ipc,
+        test_binder_register_object(fd_obj, obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    test.client = gbinder_client_new(remote, TEST_INTERFACE);
+    gbinder_client_set_single_flight(NULL, 0, TRUE);
+    gbinder_client_set_single_flight(test.client, TEST_FLIGHT_TX, FALSE);
+    gbinder_client_set_single_flight(test.client, TEST_FLIGHT_TX, TRUE);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+
+    /* The handler is invoked on the main thread */
+    thread = g_thread_new("leader", test_flight_leader, &test);
+    test_run(&test_opt, test.loop);
+    g_thread_join(thread);
+
+    g_assert(test.reply[0]);
+    g_assert(test.reply[1]);
+    g_assert(gbinder_remote_reply_read_int32(test.reply[0], &value));
+    g_assert_cmpint(value, == ,1);
+    g_assert(gbinder_remote_reply_read_int32(test.reply[1], &value));
+    if (objects) {
+        /* The follower had to repeat the call */
+        g_assert_cmpint(test.count, == ,2);
+        g_assert_cmpint(value, == ,2);
+    } else {
+        /* Both callers got the same reply */
+        g_assert_cmpint(test.count, == ,1);
+        g_assert_cmpint(value, == ,1);
+    }
+    gbinder_remote_reply_unref(test.reply[0]);
+    gbinder_remote_reply_unref(test.reply[1]);
+
+    test_binder_unregister_objects(fd_obj);
+    gbinder_local_object_drop(obj);
+    if (test.ret) {
+        gbinder_local_object_drop(test.ret);
+    }
+    gbinder_remote_object_unref(remote);
+    gbinder_client_unref(test.client);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_single_flight_run(
+    void)
+{
+    test_single_flight_common(FALSE);
+}
+
+static
+void
+test_single_flight(
+    void)
+{
+    test_run_in_context(&test_opt, test_single_flight_run);
+}
+
+/*==========================================================================*
+ * single_flight/objects
+ *==========================================================================*/
+
+static
+void
+test_single_flight_objects_run(
+    void)
+{
+    test_single_flight_common(TRUE);
+}
+
+static
+void
+test_single_flight_objects(
+    void)
+{
+    test_run_in_context(&test_opt, test_single_flight_objects_run);
+}
+
+/*==========================================================================*
+ * single_flight/main_thread
+ *==========================================================================*/
+
+typedef struct test_flight_main {
+    GMainLoop* loop;
+    GBinderLocalObject* obj;
+    GBinderRemoteRequest* blocked;
+    int count;
+} TestFlightMain;
+
+static
+gboolean
+test_flight_main_complete(
+    gpointer user_data)
+{
+    TestFlightMain* test = user_data;
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(test->obj);
+
+    /* Runs on the main thread */
+    gbinder_local_reply_append_int32(reply, 1);
+    gbinder_remote_request_complete(test->blocked, reply,
+        GBINDER_STATUS_OK);
+    gbinder_remote_request_unref(test->blocked);
+    gbinder_local_reply_unref(reply);
+    test->blocked = NULL;
+    return G_SOURCE_REMOVE;
+}
+
+static
+GBinderLocalReply*
+test_flight_main_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestFlightMain* test = user_data;
+
+    /* Invoked on the looper thread */
+    g_assert_cmpuint(code, == ,TEST_FLIGHT_TX);
+    if (++test->count == 1) {
+        /* The first call can't complete without the main thread */
+        test->blocked = gbinder_remote_request_ref(req);
+        gbinder_remote_request_block(req);
+        g_idle_add(test_flight_main_complete, test);
+        return NULL;
+    } else {
+        GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+
+        gbinder_local_reply_append_int32(reply, test->count);
+        *status = GBINDER_STATUS_OK;
+        return reply;
+    }
+}
+
+static
+void
+test_flight_main_batch_done(
+    GBinderClient* client,
+    GBinderRemoteReply* const* replies,
+    const int* status,
+    guint count,
+    void* user_data)
+{
+    TestFlightMain* test = user_data;
+    gint32 value = 0;
+
+    g_assert_cmpuint(count, == ,1);
+    g_assert_cmpint(status[0], == ,GBINDER_STATUS_OK);
+    g_assert(gbinder_remote_reply_read_int32(replies[0], &value));
+    g_assert_cmpint(value, == ,1);
+    test_quit_later(test->loop);
+}
+
+static
+void
+test_single_flight_main_run(
+    void)
+{
+    static const char* const ifaces[] = { TEST_INTERFACE, NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderIpc* ipc_obj = gbinder_ipc_new(GBINDER_DEFAULT_BINDER "-private",
+        NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const int fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    GBinderRemoteObject* remote;
+    GBinderRemoteReply* reply;
+    GBinderLocalRequest* req;
+    GBinderClientBatchTx tx;
+    GBinderClient* client;
+    TestFlightMain test;
+    int status = INT_MAX;
+    gint32 value = 0;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.obj = gbinder_local_object_new(ipc_obj, ifaces,
+        test_flight_main_handler, &test);
+    gbinder_local_object_set_looper_dispatch(test.obj, TRUE);
+    remote = gbinder_remote_object_new(ipc,
+        test_binder_register_object(fd_obj, test.obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    client = gbinder_client_new(remote, TEST_INTERFACE);
+    gbinder_client_set_single_flight(client, TEST_FLIGHT_TX, TRUE);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+
+    /* The worker leads the flight and then waits for the main thread */
+    req = gbinder_client_new_request2(client, TEST_FLIGHT_TX);
+    gbinder_local_request_append_int32(req, 42);
+    memset(&tx, 0, sizeof(tx));
+    tx.code = TEST_FLIGHT_TX;
+    tx.req = req;
+    g_assert(gbinder_client_transact_batch(client, &tx, 1,
+        test_flight_main_batch_done, NULL, &test));
+    g_usleep(100000);
+
+    /* The main thread doesn't join that flight, it would never land */
+    reply = gbinder_client_transact_sync_reply(client, TEST_FLIGHT_TX, req,
+        &status);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert(gbinder_remote_reply_read_int32(reply, &value));
+    g_assert_cmpint(value, == ,2);
+    gbinder_remote_reply_unref(reply);
+
+    /* Now let the first call complete */
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.count, == ,2);
+    g_assert(!test.blocked);
+
+    test_binder_unregister_objects(fd_obj);
+    gbinder_local_request_unref(req);
+    gbinder_local_object_drop(test.obj);
+    gbinder_remote_object_unref(remote);
+    gbinder_client_unref(client);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_single_flight_main(
+    void)
+{
+    test_run_in_context(&test_opt, test_single_flight_main_run);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -464,13 +2450,37 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("null"), test_null);
     g_test_add_func(TEST_("basic"), test_basic);
     g_test_add_func(TEST_("interfaces"), test_interfaces);
+    g_test_add_func(TEST_("shared_ifaces"), test_shared_ifaces);
     g_test_add_func(TEST_("dead"), test_dead);
     g_test_add_func(TEST_("no_header"), test_no_header);
     g_test_add_func(TEST_("sync_oneway"), test_sync_oneway);
     g_test_add_func(TEST_("sync_reply"), test_sync_reply);
+    g_test_add_func(TEST_("cache"), test_cache);
     g_test_add_func(TEST_("reply/ok1"), test_reply_ok1);
     g_test_add_func(TEST_("reply/ok2"), test_reply_ok2);
     g_test_add_func(TEST_("reply/ok3"), test_reply_ok3);
+    g_test_add_func(TEST_("worker"), test_worker);
+    g_test_add_func(TEST_("size_hint"), test_size_hint);
+    g_test_add_func(TEST_("batch"), test_batch);
+    g_test_add_func(TEST_("max_pending"), test_max_pending);
+    g_test_add_func(TEST_("coalesce"), test_coalesce);
+    g_test_add_func(TEST_("ordered"), test_ordered);
+    g_test_add_func(TEST_("timeout"), test_timeout);
+    g_test_add_func(TEST_("timeout/pending"), test_timeout_pending);
+    g_test_add_func(TEST_("local"), test_local);
+    g_test_add_func(TEST_("chunked"), test_chunked);
+    g_test_add_func(TEST_("lane"), test_lane);
+    g_test_add_func(TEST_("single_flight"), test_single_flight);
+    g_test_add_func(TEST_("single_flight/objects"),
+        test_single_flight_objects);
+    g_test_add_func(TEST_("single_flight/main_thread"),
+        test_single_flight_main);
+#if GBINDER_FMQ_SUPPORTED
+    if (test_fmq_supported()) {
+        g_test_add_func(TEST_("fmq/peer_death"), test_fmq_peer_death);
+        g_test_add_func(TEST_("fmq/round_trip"), test_fmq_round_trip);
+    }
+#endif
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
@@ -409,6 +409,80 @@ test_autorelease(
     g_free(dir);
 }
 
+/*==========================================================================*
+ * cache
+ *==========================================================================*/
+
+static
+void
+test_cache(
+    void)
+{
+    const char* default_file = gbinder_config_file;
+    const char* default_dir = gbinder_config_dir;
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GKeyFile* keyfile;
+    static const char config1[] =
+        "[MaxLoopers]\n"
+        "Default = 3\n";
+    static const char config2[] =
+        "[MaxLoopers]\n"
+        "Default = 7\n"
+        "/dev/binder = 4\n";
+
+    gbinder_config_exit(); /* Reset the state */
+
+    g_assert(g_file_set_contents(file, config1, -1, NULL));
+    gbinder_config_file = file;
+    gbinder_config_dir = NULL;
+    keyfile = gbinder_config_get();
+    g_assert(keyfile);
+    g_assert_cmpint(gbinder_config_get_device_int("MaxLoopers",
+        "/dev/binder", 0), == ,3);
+    g_assert_cmpint(gbinder_config_get_device_int("MaxLoopers",
+        NULL, 0), == ,3);
+    g_assert_cmpint(gbinder_config_get_device_int("MinLoopers",
+        "/dev/binder", 1), == ,1);
+
+    /* The config stays cached across idle loops */
+    test_quit_later_n(loop, 2);
+    test_run(&test_opt, loop);
+    g_assert(keyfile == gbinder_config_get());
+
+    /* The file isn't checked more often than once a second */
+    g_assert(g_file_set_contents(file, config2, -1, NULL));
+    g_assert(keyfile == gbinder_config_get());
+    g_assert_cmpint(gbinder_config_get_device_int("MaxLoopers",
+        "/dev/binder", 0), == ,3);
+
+    /* But then the change gets noticed */
+    g_usleep(G_TIME_SPAN_SECOND + G_TIME_SPAN_MILLISECOND);
+    g_assert_cmpint(gbinder_config_get_device_int("MaxLoopers",
+        "/dev/binder", 0), == ,4);
+    g_assert_cmpint(gbinder_config_get_device_int("MaxLoopers",
+        "/dev/hwbinder", 0), == ,7);
+
+    /* Switching to another file reloads the config right away */
+    gbinder_config_file = NULL;
+    g_assert(!gbinder_config_get());
+    g_assert_cmpint(gbinder_config_get_device_int("MaxLoopers",
+        "/dev/binder", 0), == ,0);
+
+    /* Reset the state again */
+    gbinder_config_exit();
+    gbinder_config_file = default_file;
+    gbinder_config_dir = default_dir;
+    g_main_loop_unref(loop);
+
+    remove(file);
+    g_free(file);
+
+    remove(dir);
+    g_free(dir);
+}
+
 /*==========================================================================*
  * Presets
  *==========================================================================*/
@@ -556,6 +630,7 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("dirs"), test_dirs);
     g_test_add_func(TEST_("bad_config"), test_bad_config);
     g_test_add_func(TEST_("autorelease"), test_autorelease);
+    g_test_add_func(TEST_("cache"), test_cache);
     for (i = 0; i < G_N_ELEMENTS(test_presets_data); i++) {
         const TestPresetsData* test = test_presets_data + i;
         char* path;
@@ -32,14 +32,18 @@
 
 #include "test_binder.h"
 
+#include "gbinder_buffer_p.h"
 #include "gbinder_config.h"
 #include "gbinder_driver.h"
 #include "gbinder_handler.h"
+#include "gbinder_io.h"
 #include "gbinder_local_request_p.h"
 #include "gbinder_output_data.h"
 #include "gbinder_rpc_protocol.h"
+#include "gbinder_writer.h"
 
 #include <poll.h>
+#include <unistd.h>
 
 static TestOpt test_opt;
 
@@ -77,7 +81,8 @@ test_basic(
     g_assert(gbinder_driver_exit_looper(driver));
     g_assert(!gbinder_driver_request_death_notification(driver, NULL));
     g_assert(!gbinder_driver_clear_death_notification(driver, NULL));
-    g_assert(!gbinder_driver_dead_binder_done(NULL, NULL));
+    g_assert(!gbinder_driver_dead_binders_done(NULL, NULL, NULL, 0));
+    g_assert(!gbinder_driver_dead_binders_done(driver, NULL, NULL, 0));
     gbinder_driver_unref(driver);
 
     g_assert(!gbinder_handler_transact(NULL, NULL, NULL, 0, 0, NULL));
@@ -105,6 +110,294 @@ test_noop(
     gbinder_driver_unref(driver);
 }
 
+/*==========================================================================*
+ * deferred
+ *==========================================================================*/
+
+static
+void
+test_deferred(
+    void)
+{
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    const int fd = gbinder_driver_fd(driver);
+
+    /* Replies to these get deferred and flushed at the end of the read */
+    test_binder_br_increfs(fd, NULL);
+    test_binder_br_acquire(fd, NULL);
+    test_binder_br_dead_binder(fd, 0);
+    test_binder_br_noop(fd);
+    g_assert(gbinder_driver_read(driver, NULL, NULL) == 0);
+
+    /* And these are written outside of the read (release is batched) */
+    g_assert(gbinder_driver_decrefs(driver, 0));
+    g_assert(gbinder_driver_release(driver, 0));
+    gbinder_driver_unref(driver);
+}
+
+/*==========================================================================*
+ * free_batch
+ *==========================================================================*/
+
+static
+void
+test_free_batch_buffer(
+    GBinderDriver* driver)
+{
+    static const guint8 data[] = { 0x01, 0x02, 0x03, 0x04 };
+
+    /* The buffer gets released with BC_FREE_BUFFER */
+    gbinder_buffer_free(gbinder_buffer_new(driver,
+        g_memdup(data, sizeof(data)), sizeof(data), NULL));
+}
+
+static
+void
+test_free_batch(
+    void)
+{
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    const int fd = gbinder_driver_fd(driver);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    guint count = test_binder_write_read_count(fd);
+    int i;
+
+    /* These get written all at once by the idle callback */
+    test_free_batch_buffer(driver);
+    test_free_batch_buffer(driver);
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count);
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count + 1);
+    count++;
+
+    /* Large batches get flushed without waiting for the idle callback */
+    for (i = 0; i < 100; i++) {
+        test_free_batch_buffer(driver);
+    }
+    g_assert_cmpuint(test_binder_write_read_count(fd), > ,count);
+    count = test_binder_write_read_count(fd);
+
+    /* And the rest goes along with the next write */
+    g_assert(gbinder_driver_decrefs(driver, 0));
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count + 1);
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count + 1);
+
+    /* Pending frees are flushed when the driver is closed */
+    test_free_batch_buffer(driver);
+    gbinder_driver_close(driver);
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+
+    gbinder_driver_unref(driver);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * release_batch
+ *==========================================================================*/
+
+static
+void
+test_release_batch(
+    void)
+{
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    const int fd = gbinder_driver_fd(driver);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    guint count = test_binder_write_read_count(fd);
+
+    /* Release followed by acquire doesn't go to the driver at all */
+    g_assert(gbinder_driver_release(driver, 1));
+    g_assert(gbinder_driver_acquire(driver, 1));
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count);
+
+    /* Only one of the pending releases gets cancelled */
+    g_assert(gbinder_driver_release(driver, 1));
+    g_assert(gbinder_driver_release(driver, 1));
+    g_assert(gbinder_driver_release(driver, 2));
+    g_assert(gbinder_driver_acquire(driver, 1));
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count);
+
+    /* The rest gets written all at once by the idle callback */
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count + 1);
+
+    /* Or along with the next write */
+    g_assert(gbinder_driver_release(driver, 1));
+    g_assert(gbinder_driver_acquire(driver, 3));
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count + 2);
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpuint(test_binder_write_read_count(fd), == ,count + 2);
+
+    /* Pending releases are flushed when the driver is closed */
+    g_assert(gbinder_driver_release(driver, 2));
+    gbinder_driver_close(driver);
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+
+    gbinder_driver_unref(driver);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * read_buffer
+ *==========================================================================*/
+
+static
+void
+test_read_buffer(
+    void)
+{
+    GBinderDriver* driver;
+    static const char config[] =
+        "[ReadBufferSize]\n"
+        "Default = 512\n"
+        "/dev/binder = 1024\n";
+    int fd, i;
+
+    /* Default size */
+    gbinder_config_exit();
+    driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert(driver);
+    g_assert_cmpuint(gbinder_driver_read_buffer_size(driver), == ,
+        GBINDER_IO_READ_BUFFER_SIZE);
+
+    /* Buffer grows when the driver keeps filling it up */
+    fd = gbinder_driver_fd(driver);
+    for (i = 0; i < 2 * GBINDER_IO_READ_BUFFER_SIZE / 4; i++) {
+        test_binder_br_noop(fd);
+    }
+    g_assert(gbinder_driver_read(driver, NULL, NULL) == 0);
+    g_assert(gbinder_driver_read(driver, NULL, NULL) == 0);
+    g_assert_cmpuint(gbinder_driver_read_buffer_size(driver), == ,
+        2 * GBINDER_IO_READ_BUFFER_SIZE);
+    gbinder_driver_unref(driver);
+
+    /* Configured size */
+    g_assert(g_file_set_contents(gbinder_config_file, config, -1, NULL));
+    gbinder_config_exit();
+    driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert(driver);
+    g_assert_cmpuint(gbinder_driver_read_buffer_size(driver), == , 1024);
+    test_binder_br_noop(gbinder_driver_fd(driver));
+    g_assert(gbinder_driver_read(driver, NULL, NULL) == 0);
+    gbinder_driver_unref(driver);
+
+    driver = gbinder_driver_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    g_assert(driver);
+    g_assert_cmpuint(gbinder_driver_read_buffer_size(driver), == , 512);
+    gbinder_driver_unref(driver);
+
+    gbinder_config_exit();
+    remove(gbinder_config_file);
+}
+
+/*==========================================================================*
+ * mmap_size
+ *==========================================================================*/
+
+static
+void
+test_mmap_size(
+    void)
+{
+    GBinderDriver* driver;
+    GBinderBuffer* buf;
+    const gsize page_size = sysconf(_SC_PAGE_SIZE);
+    static const guint8 data[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+    static const char config[] =
+        "[MmapSize]\n"
+        "Default = 100000\n"
+        "/dev/binder = 100000000\n";
+    gsize size;
+
+    /* Default size */
+    gbinder_config_exit();
+    driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert(driver);
+    g_assert_cmpuint(gbinder_driver_vm_size(driver), == ,
+        1024 * 1024 - 2 * page_size);
+
+    /* Buffers which are alive are accounted for */
+    g_assert_cmpuint(gbinder_driver_pinned_size(driver), == ,0);
+    buf = gbinder_buffer_new(driver, g_memdup(data, sizeof(data)),
+        sizeof(data), NULL);
+    g_assert_cmpuint(gbinder_driver_pinned_size(driver), >= ,sizeof(data));
+    gbinder_buffer_free(buf);
+    g_assert_cmpuint(gbinder_driver_pinned_size(driver), == ,0);
+    gbinder_driver_unref(driver);
+
+    /* Configured size is rounded up to the page size and capped at 4M */
+    g_assert(g_file_set_contents(gbinder_config_file, config, -1, NULL));
+    gbinder_config_exit();
+    driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert(driver);
+    g_assert_cmpuint(gbinder_driver_vm_size(driver), == ,4 * 1024 * 1024);
+    gbinder_driver_unref(driver);
+
+    driver = gbinder_driver_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    g_assert(driver);
+    size = gbinder_driver_vm_size(driver);
+    g_assert_cmpuint(size, >= ,100000);
+    g_assert_cmpuint(size, < ,100000 + page_size);
+    g_assert_cmpuint(size % page_size, == ,0);
+    gbinder_driver_unref(driver);
+
+    gbinder_config_exit();
+    remove(gbinder_config_file);
+}
+
+/*==========================================================================*
+ * offsets
+ *==========================================================================*/
+
+static
+void
+test_offsets_transact(
+    GBinderDriver* driver,
+    guint count)
+{
+    GBinderLocalRequest* req = gbinder_driver_local_request_new(driver, NULL);
+    GBinderWriter writer;
+    guint i;
+
+    gbinder_local_request_init_writer(req, &writer);
+    for (i = 0; i < count; i++) {
+        gbinder_writer_append_local_object(&writer, NULL);
+    }
+    test_binder_br_transaction_complete(gbinder_driver_fd(driver));
+    g_assert_cmpint(gbinder_driver_transact(driver, NULL, NULL, 0, 0, req,
+        NULL), == ,0);
+    gbinder_local_request_unref(req);
+}
+
+static
+void
+test_offsets(
+    void)
+{
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    const guint allocs = gbinder_driver_offsets_allocs();
+
+    /* Reasonable number of objects doesn't allocate offsets */
+    test_offsets_transact(driver, 0);
+    test_offsets_transact(driver, 2);
+    test_offsets_transact(driver, 32);
+    g_assert_cmpuint(gbinder_driver_offsets_allocs(), == ,allocs);
+
+    /* But a large one does */
+    test_offsets_transact(driver, 33);
+    g_assert_cmpuint(gbinder_driver_offsets_allocs(), == ,allocs + 1);
+    gbinder_driver_unref(driver);
+}
+
 /*==========================================================================*
  * local_request
  *==========================================================================*/
@@ -156,6 +449,12 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_PREFIX "basic", test_basic);
     g_test_add_func(TEST_PREFIX "noop", test_noop);
+    g_test_add_func(TEST_PREFIX "deferred", test_deferred);
+    g_test_add_func(TEST_PREFIX "free_batch", test_free_batch);
+    g_test_add_func(TEST_PREFIX "release_batch", test_release_batch);
+    g_test_add_func(TEST_PREFIX "read_buffer", test_read_buffer);
+    g_test_add_func(TEST_PREFIX "mmap_size", test_mmap_size);
+    g_test_add_func(TEST_PREFIX "offsets", test_offsets);
     g_test_add_func(TEST_PREFIX "local_request", test_local_request);
     test_init(&test_opt, argc, argv);
     result = g_test_run();
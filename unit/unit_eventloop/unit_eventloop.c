@@ -33,6 +33,8 @@
 #include "test_common.h"
 #include "gbinder_eventloop_p.h"
 
+#include <poll.h>
+
 static TestOpt test_opt;
 
 static int test_eventloop_timeout_add_called;
@@ -260,6 +262,296 @@ test_invoke(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * slack
+ *==========================================================================*/
+
+static
+gboolean
+test_slack_func(
+    gpointer data)
+{
+    gint64* fired = data;
+
+    *fired = g_get_monotonic_time();
+    return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+test_slack_repeat_func(
+    gpointer data)
+{
+    int* count = data;
+
+    return (++(*count) < 3) ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static
+void
+test_slack(
+    void)
+{
+    const gint64 slack_us = 50 * 1000;
+    gint64 fired1 = 0, fired2 = 0;
+    GBinderEventLoopTimeout* timeout;
+    int count = 0;
+
+    gbinder_eventloop_set(NULL);
+    gbinder_eventloop_set_timer_slack(50);
+
+    /* Both timers get aligned to the same slack window */
+    g_assert(gbinder_timeout_add_slack(1, test_slack_func, &fired1));
+    g_assert(gbinder_timeout_add_slack(2, test_slack_func, &fired2));
+    while (!fired1 || !fired2) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    g_assert_cmpint(fired1 / slack_us, == ,fired2 / slack_us);
+
+    /* Repeating timer gets re-armed */
+    g_assert(gbinder_timeout_add_slack(1, test_slack_repeat_func, &count));
+    while (count < 3) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+
+    /* And can be removed */
+    timeout = gbinder_timeout_add_slack(1, test_unreached_proc, NULL);
+    g_assert(timeout);
+    gbinder_timeout_remove(timeout);
+
+    /* Zero slack means a regular timeout */
+    gbinder_eventloop_set_timer_slack(0);
+    fired1 = 0;
+    g_assert(gbinder_timeout_add_slack(1, test_slack_func, &fired1));
+    while (!fired1) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    gbinder_eventloop_set_timer_slack(-1);
+}
+
+/*==========================================================================*
+ * context
+ *==========================================================================*/
+
+static
+void
+test_context_cb(
+    gpointer data)
+{
+    (*(int*)data)++;
+}
+
+static
+gboolean
+test_context_func(
+    gpointer data)
+{
+    (*(int*)data)++;
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+test_context(
+    void)
+{
+    GMainContext* context = g_main_context_new();
+    GBinderEventLoopCallback* cb;
+    GBinderEventLoopTimeout* timeout;
+    int count = 0, ticks = 0;
+
+    gbinder_eventloop_set(NULL);
+
+    /* Callbacks are dispatched in the specified context only */
+    gbinder_idle_callback_invoke_later_in(test_context_cb, &count, NULL,
+        context);
+    while (g_main_context_iteration(NULL, FALSE));
+    g_assert_cmpint(count, == ,0);
+    while (g_main_context_iteration(context, FALSE));
+    g_assert_cmpint(count, == ,1);
+
+    cb = gbinder_idle_callback_new(test_context_cb, &count, NULL);
+    gbinder_idle_callback_schedule_in(cb, context);
+    while (g_main_context_iteration(NULL, FALSE));
+    g_assert_cmpint(count, == ,1);
+    while (g_main_context_iteration(context, FALSE));
+    g_assert_cmpint(count, == ,2);
+    gbinder_idle_callback_unref(cb);
+
+    /* And timeouts too */
+    g_assert(gbinder_timeout_add_in(1, test_context_func, &ticks, context));
+    while (!ticks) {
+        g_main_context_iteration(context, TRUE);
+    }
+    g_assert_cmpint(ticks, == ,1);
+
+    timeout = gbinder_timeout_add_in(1, test_unreached_proc, NULL, context);
+    g_assert(timeout);
+    gbinder_timeout_remove(timeout);
+    g_usleep(2000);
+    while (g_main_context_iteration(context, FALSE));
+
+    /* NULL context is the default one */
+    timeout = gbinder_timeout_add_in(0, test_context_func, &ticks, NULL);
+    g_assert(timeout);
+    while (ticks < 2) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    g_main_context_unref(context);
+}
+
+/*==========================================================================*
+ * epoll
+ *==========================================================================*/
+
+static
+void
+test_epoll_count_cb(
+    gpointer data)
+{
+    (*(int*)data)++;
+}
+
+static
+gboolean
+test_epoll_count_func(
+    gpointer data)
+{
+    int* count = data;
+
+    return (++(*count) < 3) ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static
+void
+test_epoll_wait(
+    void)
+{
+    struct pollfd pfd;
+
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = gbinder_eventloop_epoll_fd();
+    pfd.events = POLLIN;
+    g_assert_cmpint(poll(&pfd, 1, 1000), == ,1);
+}
+
+static
+void
+test_epoll(
+    void)
+{
+    GBinderEventLoopCallback* cb;
+    GBinderEventLoopTimeout* timeout;
+    int count = 0, destroyed = 0, ticks = 0;
+
+    g_assert(gbinder_eventloop_epoll());
+    g_assert_cmpint(gbinder_eventloop_epoll_fd(), >= ,0);
+    gbinder_eventloop_set(gbinder_eventloop_epoll());
+    g_assert_cmpuint(gbinder_eventloop_epoll_dispatch(), == ,0);
+
+    /* Scheduling twice still invokes the callback once */
+    cb = gbinder_idle_callback_new(test_epoll_count_cb, &count, NULL);
+    gbinder_idle_callback_schedule(cb);
+    gbinder_idle_callback_schedule(cb);
+    g_assert_cmpuint(gbinder_eventloop_epoll_dispatch(), == ,1);
+    g_assert_cmpint(count, == ,1);
+
+    /* Cancelled callback isn't invoked */
+    gbinder_idle_callback_schedule(cb);
+    gbinder_idle_callback_cancel(cb);
+    gbinder_eventloop_epoll_dispatch();
+    g_assert_cmpint(count, == ,1);
+    gbinder_idle_callback_unref(cb);
+
+    /* Non-cancellable callback */
+    gbinder_idle_callback_invoke_later(test_epoll_count_cb, &count,
+        test_epoll_count_cb);
+    g_assert_cmpuint(gbinder_eventloop_epoll_dispatch(), == ,1);
+    g_assert_cmpint(count, == ,3);
+
+    /* Timeout is removed when the function returns G_SOURCE_REMOVE */
+    g_assert(gbinder_timeout_add(1, test_epoll_count_func, &ticks));
+    while (ticks < 3) {
+        test_epoll_wait();
+        gbinder_eventloop_epoll_dispatch();
+    }
+    g_assert_cmpint(ticks, == ,3);
+
+    /* Removed timeout doesn't fire */
+    timeout = gbinder_timeout_add(1, test_unreached_proc, NULL);
+    g_assert(timeout);
+    gbinder_timeout_remove(timeout);
+    g_usleep(2000);
+    gbinder_eventloop_epoll_dispatch();
+
+    /* Scheduled callbacks are dropped by cleanup */
+    cb = gbinder_idle_callback_schedule_new(NULL, &destroyed,
+        test_epoll_count_cb);
+    gbinder_idle_callback_unref(cb);
+    g_assert_cmpint(destroyed, == ,0);
+    gbinder_eventloop_set(NULL);
+    g_assert_cmpint(destroyed, == ,1);
+    g_assert_cmpuint(gbinder_eventloop_epoll_dispatch(), == ,0);
+}
+
+/*==========================================================================*
+ * epoll_thread
+ *==========================================================================*/
+
+typedef struct test_epoll_thread {
+    GMutex mutex;
+    GCond cond;
+    GThread* thread;
+    gboolean done;
+} TestEpollThread;
+
+static
+void
+test_epoll_thread_cb(
+    gpointer data)
+{
+    TestEpollThread* test = data;
+
+    g_mutex_lock(&test->mutex);
+    test->thread = g_thread_self();
+    test->done = TRUE;
+    g_cond_signal(&test->cond);
+    g_mutex_unlock(&test->mutex);
+}
+
+static
+void
+test_epoll_thread(
+    void)
+{
+    TestEpollThread test;
+    const gint64 deadline = g_get_monotonic_time() + 10 * G_TIME_SPAN_SECOND;
+
+    memset(&test, 0, sizeof(test));
+    g_mutex_init(&test.mutex);
+    g_cond_init(&test.cond);
+
+    gbinder_eventloop_set(gbinder_eventloop_epoll());
+    g_assert(gbinder_eventloop_epoll_start());
+    g_assert(gbinder_eventloop_epoll_start()); /* Second time is a noop */
+    gbinder_idle_callback_invoke_later(test_epoll_thread_cb, &test, NULL);
+
+    g_mutex_lock(&test.mutex);
+    while (!test.done) {
+        g_assert(g_cond_wait_until(&test.cond, &test.mutex, deadline));
+    }
+    g_mutex_unlock(&test.mutex);
+
+    /* The callback has been invoked on the dispatcher thread */
+    g_assert(test.thread != g_thread_self());
+    gbinder_eventloop_epoll_stop();
+    gbinder_eventloop_epoll_stop(); /* Second time is a noop */
+    gbinder_eventloop_set(NULL);
+
+    g_mutex_clear(&test.mutex);
+    g_cond_clear(&test.cond);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -274,6 +566,10 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("timeout"), test_timeout);
     g_test_add_func(TEST_("callback"), test_callback);
     g_test_add_func(TEST_("invoke"), test_invoke);
+    g_test_add_func(TEST_("slack"), test_slack);
+    g_test_add_func(TEST_("context"), test_context);
+    g_test_add_func(TEST_("epoll"), test_epoll);
+    g_test_add_func(TEST_("epoll_thread"), test_epoll_thread);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
@@ -38,6 +38,7 @@
 #include "gbinder_log.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/syscall.h>
 #include <unistd.h>
@@ -103,6 +104,11 @@ test_null(
     g_assert(gbinder_fmq_wait(fmq, 0, (guint32*)0x1) == -EINVAL);
     g_assert(gbinder_fmq_wait((GBinderFmq*)0x1, 0, NULL) == -EINVAL);
     g_assert(gbinder_fmq_wake(fmq, 0) == -EINVAL);
+
+    g_assert(gbinder_fmq_read_blocking(fmq, (void*)0x1, 1, 1, 2, 0) ==
+        -EINVAL);
+    g_assert(gbinder_fmq_write_blocking(fmq, (const void*)0x1, 1, 1, 2, 0) ==
+        -EINVAL);
 }
 
 /*==========================================================================*
@@ -399,6 +405,139 @@ test_read_write_external_fd(
     gbinder_fmq_unref(fmq);
 }
 
+/*==========================================================================*
+ * batch
+ *==========================================================================*/
+
+typedef struct test_batch_record {
+    gint64 seq;
+    gint64 value;
+} TestBatchRecord;
+
+static
+void
+test_batch(
+    void)
+{
+    const gsize n = 8;
+    TestBatchRecord in[2 * 8];
+    TestBatchRecord out[2 * 8];
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(TestBatchRecord), n,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE, 0, -1, 0);
+    guint i;
+
+    g_assert(fmq);
+    for (i = 0; i < G_N_ELEMENTS(in); i++) {
+        in[i].seq = i;
+        in[i].value = g_random_int();
+    }
+    memset(out, 0, sizeof(out));
+
+    /* Invalid parameters */
+    g_assert_cmpuint(gbinder_fmq_read_batch(NULL, out, 1), == ,0);
+    g_assert_cmpuint(gbinder_fmq_read_batch(fmq, NULL, 1), == ,0);
+    g_assert_cmpuint(gbinder_fmq_read_batch(fmq, out, 0), == ,0);
+    g_assert_cmpuint(gbinder_fmq_write_batch(NULL, in, 1), == ,0);
+    g_assert_cmpuint(gbinder_fmq_write_batch(fmq, NULL, 1), == ,0);
+    g_assert_cmpuint(gbinder_fmq_write_batch(fmq, in, 0), == ,0);
+
+    /* Empty */
+    g_assert_cmpuint(gbinder_fmq_read_batch(fmq, out, 1), == ,0);
+
+    /* Only as much as fits */
+    g_assert_cmpuint(gbinder_fmq_write_batch(fmq, in, 10), == ,n);
+    g_assert_cmpuint(gbinder_fmq_write_batch(fmq, in + n, 1), == ,0);
+
+    /* Partial read and then wrap around */
+    g_assert_cmpuint(gbinder_fmq_read_batch(fmq, out, 3), == ,3);
+    g_assert_cmpuint(gbinder_fmq_write_batch(fmq, in + n, 5), == ,3);
+    g_assert_cmpuint(gbinder_fmq_read_batch(fmq, out + 3, 100), == ,n);
+    g_assert(!memcmp(in, out, (n + 3) * sizeof(in[0])));
+    g_assert_cmpuint(gbinder_fmq_available_to_read(fmq), == ,0);
+
+    gbinder_fmq_unref(fmq);
+
+    /* Unsynchronized writer doesn't care about the readers */
+    fmq = gbinder_fmq_new(sizeof(TestBatchRecord), n,
+        GBINDER_FMQ_TYPE_UNSYNC_WRITE, 0, -1, 0);
+    g_assert(fmq);
+    g_assert_cmpuint(gbinder_fmq_write_batch(fmq, in, 3), == ,3);
+    g_assert_cmpuint(gbinder_fmq_read_batch(fmq, out, 100), == ,3);
+    g_assert_cmpuint(gbinder_fmq_write_batch(fmq, in, 100), == ,n);
+    gbinder_fmq_unref(fmq);
+}
+
+/*==========================================================================*
+ * readers
+ *==========================================================================*/
+
+static
+void
+test_readers(
+    void)
+{
+    const guint32 in[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    guint32 out[4];
+    GBinderFmq* reader;
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(guint32), 2,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE, 0, -1, 0);
+
+    /* Invalid parameters */
+    g_assert(!gbinder_fmq_new_reader(NULL));
+    g_assert_cmpuint(gbinder_fmq_lost_items(NULL), == ,0);
+    g_assert_cmpuint(gbinder_fmq_resync(NULL, 0), == ,0);
+
+    /* Synchronized queue has only one reader */
+    g_assert(fmq);
+    g_assert(!gbinder_fmq_new_reader(fmq));
+    g_assert(gbinder_fmq_write(fmq, in, 2));
+    g_assert_cmpuint(gbinder_fmq_resync(fmq, 0), == ,0);
+    g_assert_cmpuint(gbinder_fmq_available_to_read(fmq), == ,2);
+    gbinder_fmq_unref(fmq);
+
+    fmq = gbinder_fmq_new(sizeof(guint32), 4,
+        GBINDER_FMQ_TYPE_UNSYNC_WRITE, 0, -1, 0);
+    g_assert(fmq);
+    reader = gbinder_fmq_new_reader(fmq);
+    g_assert(reader);
+
+    /* Both readers see the same data */
+    g_assert(gbinder_fmq_write(fmq, in, 3));
+    g_assert(gbinder_fmq_read(fmq, out, 3));
+    g_assert(!memcmp(out, in, 3 * sizeof(in[0])));
+    g_assert(gbinder_fmq_read(reader, out, 1));
+    g_assert_cmpuint(out[0], == ,1);
+
+    /* The one that has fallen behind loses 2..6 */
+    g_assert(gbinder_fmq_write(fmq, in + 3, 3));
+    g_assert(gbinder_fmq_read(fmq, out, 3));
+    g_assert(!memcmp(out, in + 3, 3 * sizeof(in[0])));
+    g_assert_cmpuint(gbinder_fmq_lost_items(fmq), == ,0);
+    g_assert(!gbinder_fmq_read(reader, out, 1));
+    g_assert_cmpuint(gbinder_fmq_lost_items(reader), == ,5);
+    g_assert_cmpuint(gbinder_fmq_available_to_read(reader), == ,0);
+
+    /* And then picks up the new data */
+    g_assert(gbinder_fmq_write(fmq, in + 6, 2));
+    g_assert_cmpuint(gbinder_fmq_read_batch(reader, out, 4), == ,2);
+    g_assert(!memcmp(out, in + 6, 2 * sizeof(in[0])));
+
+    /* Skip to the most recent item */
+    g_assert(gbinder_fmq_write(fmq, in + 8, 3));
+    g_assert_cmpuint(gbinder_fmq_resync(reader, 1), == ,2);
+    g_assert_cmpuint(gbinder_fmq_resync(reader, 1), == ,0);
+    g_assert(gbinder_fmq_read(reader, out, 1));
+    g_assert_cmpuint(out[0], == ,11);
+    g_assert_cmpuint(gbinder_fmq_lost_items(reader), == ,5);
+
+    /* Or skip everything */
+    g_assert_cmpuint(gbinder_fmq_resync(fmq, 0), == ,5);
+    g_assert_cmpuint(gbinder_fmq_available_to_read(fmq), == ,0);
+
+    gbinder_fmq_unref(reader);
+    gbinder_fmq_unref(fmq);
+}
+
 /*==========================================================================*
  * ref/unref
  *==========================================================================*/
@@ -418,6 +557,117 @@ test_ref(
     gbinder_fmq_unref(fmq);
 }
 
+/*==========================================================================*
+ * align_counters
+ *==========================================================================*/
+
+static
+void
+test_align_counters(
+    void)
+{
+    const gsize n = 4;
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(gint64), n,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG |
+        GBINDER_FMQ_FLAG_ALIGN_COUNTERS, -1, 0);
+    const GBinderMQDescriptor* desc;
+    const GBinderFmqGrantorDescriptor* grantors;
+    gint64 i, value;
+    guint k;
+
+    g_assert(fmq);
+    desc = gbinder_fmq_get_descriptor(fmq);
+    g_assert_cmpuint(desc->grantors.count, == ,4);
+    grantors = desc->grantors.data.ptr;
+    for (k = 0; k < desc->grantors.count; k++) {
+        g_assert_cmpuint(grantors[k].offset % 64, == ,0);
+        if (k > 0) {
+            g_assert_cmpuint(grantors[k].offset, >= ,
+                grantors[k - 1].offset + grantors[k - 1].extent);
+        }
+    }
+
+    /* Fill the queue, then keep it full, refreshing the cached counters */
+    for (i = 0; i < (gint64)n; i++) {
+        g_assert(gbinder_fmq_write(fmq, &i, 1));
+    }
+    for (; i < 4 * (gint64)n; i++) {
+        g_assert(!gbinder_fmq_write(fmq, &i, 1));
+        g_assert(gbinder_fmq_read(fmq, &value, 1));
+        g_assert_cmpint(value, == ,i - n);
+        g_assert(gbinder_fmq_write(fmq, &i, 1));
+    }
+
+    /* And drain it */
+    for (k = 0; k < n; k++) {
+        g_assert(gbinder_fmq_read(fmq, &value, 1));
+        g_assert_cmpint(value, == ,i - n + k);
+    }
+    g_assert(!gbinder_fmq_read(fmq, &value, 1));
+    g_assert_cmpuint(gbinder_fmq_available_to_write(fmq), == ,n);
+    gbinder_fmq_unref(fmq);
+}
+
+/*==========================================================================*
+ * backing_store
+ *==========================================================================*/
+
+#ifndef F_GET_SEALS
+#  define F_GET_SEALS (1024 + 10)
+#  define F_SEAL_SHRINK 0x0002
+#  define F_SEAL_GROW 0x0004
+#endif
+
+static
+void
+test_backing_store(
+    void)
+{
+    static const GBINDER_FMQ_FLAGS flags[] = {
+        GBINDER_FMQ_FLAG_PREFAULT,
+        GBINDER_FMQ_FLAG_HUGE_PAGES,
+        GBINDER_FMQ_FLAG_HUGE_PAGES | GBINDER_FMQ_FLAG_PREFAULT |
+        GBINDER_FMQ_FLAG_ALIGN_COUNTERS
+    };
+    const gsize n = 1000;
+    guint k;
+
+    for (k = 0; k < G_N_ELEMENTS(flags); k++) {
+        GBinderFmq* fmq = gbinder_fmq_new(sizeof(gint64), n,
+            GBINDER_FMQ_TYPE_SYNC_READ_WRITE, flags[k] |
+            GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+        const GBinderMQDescriptor* desc;
+        const GBinderFmqGrantorDescriptor* grantors;
+        int seals;
+        gint64 i, value;
+
+        g_assert(fmq);
+        desc = gbinder_fmq_get_descriptor(fmq);
+        grantors = desc->grantors.data.ptr;
+        if (flags[k] & GBINDER_FMQ_FLAG_HUGE_PAGES) {
+            /* Control block (incl. event flag #3) goes before data #2 */
+            g_assert_cmpuint(desc->grantors.count, == ,4);
+            g_assert_cmpuint(grantors[3].offset, < ,grantors[2].offset);
+        }
+
+        /* The memory is sealed (unless the kernel is too old) */
+        seals = fcntl(gbinder_fds_get_fd(desc->data.fds, 0), F_GET_SEALS);
+        if (seals >= 0) {
+            g_assert_cmpint(seals & (F_SEAL_SHRINK | F_SEAL_GROW), == ,
+                (F_SEAL_SHRINK | F_SEAL_GROW));
+        }
+
+        /* Wrap around a few times */
+        for (i = 0; i < 3 * (gint64)n; i++) {
+            g_assert(gbinder_fmq_write(fmq, &i, 1));
+            g_assert(gbinder_fmq_read(fmq, &value, 1));
+            g_assert_cmpint(value, == ,i);
+        }
+        gbinder_fmq_unref(fmq);
+    }
+}
+
 /*==========================================================================*
  * wait/wake
  *==========================================================================*/
@@ -480,6 +730,378 @@ test_wait_wake(
     gbinder_fmq_unref(fmq);
 }
 
+/*==========================================================================*
+ * wait_any
+ *==========================================================================*/
+
+static
+gpointer
+test_wait_any_waker(
+    gpointer fmq)
+{
+    g_usleep(1000);
+    g_assert_cmpint(gbinder_fmq_wake(fmq, 0x4), == ,0);
+    return NULL;
+}
+
+static
+void
+test_wait_any(
+    void)
+{
+    GBinderFmq* fmqs[3];
+    GBinderFmq* bad[2];
+    const guint32 masks[3] = { 0x1, 0x2, 0x4 };
+    guint32 states[3];
+    guint i;
+    int result;
+
+    for (i = 0; i < G_N_ELEMENTS(fmqs); i++) {
+        fmqs[i] = gbinder_fmq_new(sizeof(gint64), 2,
+            GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+            GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+        g_assert(fmqs[i]);
+    }
+
+    /* Invalid parameters */
+    g_assert_cmpint(gbinder_fmq_wait_any(NULL, masks, states, 1, 0), == ,
+        -EINVAL);
+    g_assert_cmpint(gbinder_fmq_wait_any(fmqs, NULL, states, 1, 0), == ,
+        -EINVAL);
+    g_assert_cmpint(gbinder_fmq_wait_any(fmqs, masks, NULL, 1, 0), == ,
+        -EINVAL);
+    g_assert_cmpint(gbinder_fmq_wait_any(fmqs, masks, states, 0, 0), == ,
+        -EINVAL);
+    bad[0] = fmqs[0];
+    bad[1] = NULL;
+    g_assert_cmpint(gbinder_fmq_wait_any(bad, masks, states, 2, 0), == ,
+        -EINVAL);
+    bad[1] = gbinder_fmq_new(sizeof(gint64), 2,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE, 0, -1, 0);
+    g_assert_cmpint(gbinder_fmq_wait_any(bad, masks, states, 2, 0), == ,
+        -ENOSYS);
+    gbinder_fmq_unref(bad[1]);
+
+    /* Nothing there */
+    g_assert_cmpint(gbinder_fmq_wait_any(fmqs, masks, states, 3, 0), == ,
+        -ETIMEDOUT);
+    g_assert_cmpint(gbinder_fmq_wait_any(fmqs, masks, states, 3, 10), == ,
+        -ETIMEDOUT);
+
+    result = gbinder_fmq_wake(fmqs[0], 0x1);
+    g_assert(result == 0 || result == -ENOSYS);
+    gbinder_fmq_wake(fmqs[1], 0x2);
+    gbinder_fmq_wake(fmqs[2], 0x8); /* Not what we are waiting for */
+    g_assert_cmpint(gbinder_fmq_wait_any(fmqs, masks, states, 3, 0), == ,2);
+    g_assert_cmpuint(states[0], == ,0x1);
+    g_assert_cmpuint(states[1], == ,0x2);
+    g_assert_cmpuint(states[2], == ,0);
+
+    /* Only sleep if FUTEX_WAKE_BITSET is supported */
+    if (result == 0) {
+        GThread* waker = g_thread_new("waker", test_wait_any_waker, fmqs[2]);
+
+        g_assert_cmpint(gbinder_fmq_wait_any(fmqs, masks, states, 3, -1), == ,
+            1);
+        g_assert_cmpuint(states[0], == ,0);
+        g_assert_cmpuint(states[1], == ,0);
+        g_assert_cmpuint(states[2], == ,0x4);
+        g_thread_join(waker);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS(fmqs); i++) {
+        gbinder_fmq_unref(fmqs[i]);
+    }
+}
+
+/*==========================================================================*
+ * blocking
+ *==========================================================================*/
+
+#define TEST_BLOCKING_COUNT (4)
+
+static
+gpointer
+test_blocking_writer(
+    gpointer fmq)
+{
+    gint64 i;
+
+    /* One by one, the reader has to wait until there's enough */
+    for (i = 0; i < TEST_BLOCKING_COUNT; i++) {
+        g_usleep(1000);
+        g_assert_cmpint(gbinder_fmq_write_blocking(fmq, &i, 1,
+            GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, -1), == ,0);
+    }
+    return NULL;
+}
+
+static
+void
+test_blocking(
+    void)
+{
+    const gint64 in[TEST_BLOCKING_COUNT + 1] = { 1, 2, 3, 4, 5 };
+    gint64 out[TEST_BLOCKING_COUNT + 1];
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(gint64), TEST_BLOCKING_COUNT,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+    int result;
+
+    g_assert(fmq);
+
+    /* More than fits in the queue */
+    g_assert_cmpint(gbinder_fmq_read_blocking(fmq, out, G_N_ELEMENTS(out),
+        GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, -1), == ,-EINVAL);
+    g_assert_cmpint(gbinder_fmq_write_blocking(fmq, in, G_N_ELEMENTS(in),
+        GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, -1), == ,-EINVAL);
+
+    /* Nothing to read */
+    g_assert_cmpint(gbinder_fmq_read_blocking(fmq, out, 1,
+        GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, 0), == ,-ETIMEDOUT);
+    g_assert_cmpint(gbinder_fmq_read_blocking(fmq, out, 1,
+        GBINDER_FMQ_NOT_FULL, 0, -1), == ,-ETIMEDOUT);
+
+    /* Only run the tests that sleep if FUTEX_WAKE_BITSET is supported */
+    result = gbinder_fmq_wake(fmq, GBINDER_FMQ_NOT_FULL);
+    g_assert(result == 0 || result == -ENOSYS);
+    if (result == 0) {
+        GThread* writer;
+
+        g_assert_cmpint(gbinder_fmq_read_blocking(fmq, out, 1,
+            GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, 10), == ,-ETIMEDOUT);
+
+        /* Fill the queue */
+        g_assert_cmpint(gbinder_fmq_write_blocking(fmq, in,
+            TEST_BLOCKING_COUNT, GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY,
+            10), == ,0);
+        g_assert_cmpint(gbinder_fmq_write_blocking(fmq, in, 1,
+            GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, 10), == ,-ETIMEDOUT);
+
+        /* And empty it */
+        g_assert_cmpint(gbinder_fmq_read_blocking(fmq, out,
+            TEST_BLOCKING_COUNT, GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY,
+            -1), == ,0);
+        g_assert(!memcmp(in, out, TEST_BLOCKING_COUNT * sizeof(in[0])));
+
+        /* Now with another thread making progress bit by bit */
+        writer = g_thread_new("writer", test_blocking_writer, fmq);
+        g_assert_cmpint(gbinder_fmq_read_blocking(fmq, out,
+            TEST_BLOCKING_COUNT, GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY,
+            -1), == ,0);
+        g_thread_join(writer);
+        g_assert_cmpint(out[0], == ,0);
+        g_assert_cmpint(out[TEST_BLOCKING_COUNT - 1], == ,
+            TEST_BLOCKING_COUNT - 1);
+    }
+    gbinder_fmq_unref(fmq);
+
+    /* Queue without event flag */
+    fmq = gbinder_fmq_new(sizeof(gint64), TEST_BLOCKING_COUNT,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE, 0, -1, 0);
+    g_assert(fmq);
+    g_assert_cmpint(gbinder_fmq_read_blocking(fmq, out, 1,
+        GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, 0), == ,-ENOSYS);
+    g_assert_cmpint(gbinder_fmq_write_blocking(fmq, in, 1,
+        GBINDER_FMQ_NOT_FULL, GBINDER_FMQ_NOT_EMPTY, 0), == ,-ENOSYS);
+    gbinder_fmq_unref(fmq);
+}
+
+/*==========================================================================*
+ * spin
+ *==========================================================================*/
+
+static
+gpointer
+test_spin_waker(
+    gpointer fmq)
+{
+    g_usleep(1000);
+    g_assert_cmpint(gbinder_fmq_wake(fmq, 0x2), == ,0);
+    return NULL;
+}
+
+static
+gpointer
+test_spin_writer(
+    gpointer fmq)
+{
+    const gint64 value = 42;
+
+    /* Make progress without notifying anyone */
+    g_usleep(1000);
+    g_assert(gbinder_fmq_write(fmq, &value, 1));
+    return NULL;
+}
+
+static
+void
+test_spin(
+    void)
+{
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(gint64), 2,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+    const guint spin_ns = 1000000000; /* Long enough to never time out */
+    guint32 state = 0;
+    gint64 value;
+    GThread* thread;
+    int result;
+
+    g_assert(fmq);
+    gbinder_fmq_set_spin(NULL, spin_ns, GBINDER_FMQ_SPIN_NONE);
+
+    /* The spin gets cut by timeout */
+    gbinder_fmq_set_spin(fmq, spin_ns, GBINDER_FMQ_SPIN_NONE);
+    g_assert_cmpint(gbinder_fmq_wait_timeout(fmq, 0x2, &state, 10), == ,
+        -ETIMEDOUT);
+
+    /* Bits get set while spinning */
+    thread = g_thread_new("waker", test_spin_waker, fmq);
+    g_assert_cmpint(gbinder_fmq_wait(fmq, 0x2, &state), == ,0);
+    g_assert_cmpuint(state, == ,0x2);
+    g_thread_join(thread);
+
+    /* Counters move while spinning */
+    thread = g_thread_new("writer", test_spin_writer, fmq);
+    g_assert_cmpint(gbinder_fmq_wait(fmq, 0x2, &state), == ,-EAGAIN);
+    g_assert_cmpuint(state, == ,0);
+    g_thread_join(thread);
+    g_assert(gbinder_fmq_read(fmq, &value, 1));
+    g_assert_cmpint(value, == ,42);
+
+    /* Lazy wake reserves the top bit */
+    gbinder_fmq_set_spin(fmq, 0, GBINDER_FMQ_SPIN_LAZY_WAKE);
+    g_assert_cmpint(gbinder_fmq_wake(fmq, 0x80000000), == ,-EINVAL);
+    g_assert_cmpint(gbinder_fmq_wait_timeout(fmq, 0x80000000, &state, 0),
+        == ,-EINVAL);
+
+    /* Nobody is sleeping, the bit just gets set */
+    g_assert_cmpint(gbinder_fmq_wake(fmq, 0x2), == ,0);
+    g_assert_cmpint(gbinder_fmq_try_wait(fmq, 0x2, &state), == ,0);
+    g_assert_cmpuint(state, == ,0x2);
+
+    /* Only sleep if FUTEX_WAKE_BITSET is supported */
+    gbinder_fmq_set_spin(fmq, 0, GBINDER_FMQ_SPIN_NONE);
+    result = gbinder_fmq_wake(fmq, 0x4);
+    g_assert(result == 0 || result == -ENOSYS);
+    g_assert_cmpint(gbinder_fmq_try_wait(fmq, 0x4, &state), == ,0);
+    if (result == 0) {
+        /* Sleeper gets woken up */
+        gbinder_fmq_set_spin(fmq, 0, GBINDER_FMQ_SPIN_LAZY_WAKE);
+        thread = g_thread_new("waker", test_spin_waker, fmq);
+        do {
+            result = gbinder_fmq_wait(fmq, 0x2, &state);
+        } while (result == -EAGAIN);
+        g_assert_cmpint(result, == ,0);
+        g_assert_cmpuint(state, == ,0x2);
+        g_thread_join(thread);
+    }
+    gbinder_fmq_unref(fmq);
+}
+
+/*==========================================================================*
+ * watch
+ *==========================================================================*/
+
+typedef struct test_watch_data {
+    GMainLoop* loop;
+    GBinderFmq* fmq;
+    guint32 state;
+} TestWatchData;
+
+static
+void
+test_watch_cb(
+    GBinderFmq* fmq,
+    guint32 state,
+    void* user_data)
+{
+    TestWatchData* test = user_data;
+
+    GDEBUG("Watch 0x%02x", state);
+    g_assert(fmq == test->fmq);
+    test->state |= state;
+    g_main_loop_quit(test->loop);
+}
+
+static
+void
+test_watch_unexpected_cb(
+    GBinderFmq* fmq,
+    guint32 state,
+    void* user_data)
+{
+    g_assert_not_reached();
+}
+
+static
+void
+test_watch(
+    void)
+{
+    TestWatchData test;
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(gint64), 2,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+    GBinderFmq* fmq2 = gbinder_fmq_new(sizeof(gint64), 2,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+    GBinderFmq* no_flag = gbinder_fmq_new(sizeof(gint64), 2,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE, 0, -1, 0);
+    gulong id, id2;
+    int result;
+
+    g_assert(fmq);
+    g_assert(fmq2);
+    g_assert(no_flag);
+
+    /* Invalid parameters */
+    g_assert(!gbinder_fmq_add_watch(NULL, 0x1, test_watch_cb, NULL));
+    g_assert(!gbinder_fmq_add_watch(fmq, 0, test_watch_cb, NULL));
+    g_assert(!gbinder_fmq_add_watch(fmq, 0x1, NULL, NULL));
+    g_assert(!gbinder_fmq_add_watch(no_flag, 0x1, test_watch_cb, NULL));
+    gbinder_fmq_remove_watch(NULL, 1);
+    gbinder_fmq_remove_watch(fmq, 0);
+    gbinder_fmq_remove_watch(fmq, 1);
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.fmq = fmq;
+
+    /* The bit is already set when the watch gets added */
+    result = gbinder_fmq_wake(fmq, 0x1);
+    g_assert(result == 0 || result == -ENOSYS);
+    id = gbinder_fmq_add_watch(fmq, 0x1, test_watch_cb, &test);
+    id2 = gbinder_fmq_add_watch(fmq2, 0x1, test_watch_unexpected_cb, NULL);
+    g_assert(id);
+    g_assert(id2);
+    g_assert_cmpuint(id, != ,id2);
+
+    /* Wrong queue */
+    gbinder_fmq_remove_watch(fmq2, id);
+
+    test_run(&test_opt, test.loop);
+    g_assert_cmpuint(test.state, == ,0x1);
+
+    /* Only sleep if FUTEX_WAKE_BITSET is supported */
+    if (result == 0) {
+        test.state = 0;
+        g_assert_cmpint(gbinder_fmq_wake(fmq, 0x1), == ,0);
+        test_run(&test_opt, test.loop);
+        g_assert_cmpuint(test.state, == ,0x1);
+    }
+
+    gbinder_fmq_remove_watch(fmq2, id2);
+    gbinder_fmq_remove_watch(fmq, id);
+    gbinder_fmq_remove_watch(fmq, id);
+
+    gbinder_fmq_unref(fmq);
+    gbinder_fmq_unref(fmq2);
+    gbinder_fmq_unref(no_flag);
+    g_main_loop_unref(test.loop);
+}
+
 /*==========================================================================*
  * zero copy
  *==========================================================================*/
@@ -528,8 +1150,136 @@ test_zero_copy(
     gbinder_fmq_unref(fmq);
 }
 
+/*==========================================================================*
+ * channel
+ *==========================================================================*/
+
+static
+void
+test_channel(
+    void)
+{
+    static const char msg1[] = "hello";
+    static const char msg2[] = "wraps around";
+    GBinderFmqChannelHeader hdr;
+    GBinderFmq* fmq = gbinder_fmq_new(1, 48,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE, GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG,
+        -1, 0);
+    GBinderFmq* peer = gbinder_fmq_new_from_descriptor
+        (gbinder_fmq_get_descriptor(fmq));
+    guint32 code = 0;
+    void* data = NULL;
+    gsize size = 0;
+    int i;
+
+    g_assert(peer);
+    g_assert_cmpint(gbinder_fmq_channel_read(peer, &code, &data, &size), == ,0);
+    g_assert(!gbinder_fmq_channel_write(fmq, 1, NULL, 41));
+
+    /* Both ends share the memory */
+    g_assert(gbinder_fmq_channel_write(fmq, 1, msg1, sizeof(msg1)));
+    g_assert(gbinder_fmq_channel_write(fmq, 2, NULL, 0));
+    g_assert_cmpint(gbinder_fmq_channel_read(peer, &code, &data, &size), == ,1);
+    g_assert_cmpuint(code, == ,1);
+    g_assert_cmpuint(size, == ,sizeof(msg1));
+    g_assert(!memcmp(data, msg1, size));
+    g_free(data);
+    g_assert_cmpint(gbinder_fmq_channel_read(peer, &code, &data, &size), == ,1);
+    g_assert_cmpuint(code, == ,2);
+    g_assert_cmpuint(size, == ,0);
+    g_free(data);
+
+    /* Messages split between the end and the beginning of the ring */
+    for (i = 0; i < 3; i++) {
+        g_assert(gbinder_fmq_channel_write(fmq, 3, msg2, sizeof(msg2)));
+        g_assert_cmpint(gbinder_fmq_channel_read(peer, &code, &data, &size),
+            == ,1);
+        g_assert_cmpuint(code, == ,3);
+        g_assert_cmpuint(size, == ,sizeof(msg2));
+        g_assert(!memcmp(data, msg2, size));
+        g_free(data);
+    }
+
+    /* Header promising more than the queue can hold */
+    hdr.code = 4;
+    hdr.size = 1000;
+    g_assert(gbinder_fmq_write(fmq, &hdr, sizeof(hdr)));
+    g_assert_cmpint(gbinder_fmq_channel_read(peer, &code, &data, &size),
+        == ,-EBADMSG);
+
+    gbinder_fmq_unref(peer);
+    gbinder_fmq_unref(fmq);
+}
+
 #endif /* GBINDER_FMQ_SUPPORTED */
 
+/*==========================================================================*
+ * zero copy tx
+ *==========================================================================*/
+
+static
+void
+test_zero_copy_tx(
+    void)
+{
+    const gint64 in[3] = { 1, 2, 3 };
+    gint64 out[3];
+    GBinderFmqMemTransaction tx;
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(gint64), 4,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE, 0, -1, 0);
+
+    g_assert(fmq);
+    g_assert(!gbinder_fmq_begin_read_tx(NULL, 1, &tx));
+    g_assert(!gbinder_fmq_begin_write_tx(NULL, 1, &tx));
+    g_assert(!gbinder_fmq_begin_read_tx(fmq, 1, NULL));
+    g_assert(!gbinder_fmq_begin_write_tx(fmq, 1, NULL));
+
+    /* Nothing to read, too much to write */
+    g_assert(!gbinder_fmq_begin_read_tx(fmq, 1, &tx));
+    g_assert(!tx.first.ptr);
+    g_assert(!tx.second.ptr);
+    g_assert(!gbinder_fmq_begin_write_tx(fmq, 5, &tx));
+
+    /* Contiguous */
+    g_assert(gbinder_fmq_begin_write_tx(fmq, 3, &tx));
+    g_assert(tx.first.ptr);
+    g_assert_cmpuint(tx.first.items, == ,3);
+    g_assert(!tx.second.ptr);
+    g_assert_cmpuint(tx.second.items, == ,0);
+    memcpy(tx.first.ptr, in, sizeof(in));
+    gbinder_fmq_end_write(fmq, 3);
+    g_assert(gbinder_fmq_read(fmq, out, 3));
+    g_assert(!memcmp(in, out, sizeof(in)));
+
+    /* Now the same number of items wraps around */
+    g_assert(gbinder_fmq_begin_write_tx(fmq, 3, &tx));
+    g_assert_cmpuint(tx.first.items, == ,1);
+    g_assert(tx.second.ptr);
+    g_assert_cmpuint(tx.second.items, == ,2);
+    g_assert(tx.second.ptr < tx.first.ptr);
+    memcpy(tx.first.ptr, in, sizeof(in[0]));
+    memcpy(tx.second.ptr, in + 1, 2 * sizeof(in[0]));
+    gbinder_fmq_end_write(fmq, 3);
+
+    memset(&tx, 0, sizeof(tx));
+    g_assert(gbinder_fmq_begin_read_tx(fmq, 3, &tx));
+    g_assert_cmpuint(tx.first.items, == ,1);
+    g_assert_cmpuint(tx.second.items, == ,2);
+    g_assert_cmpint(((gint64*)tx.first.ptr)[0], == ,1);
+    g_assert_cmpint(((gint64*)tx.second.ptr)[0], == ,2);
+    g_assert_cmpint(((gint64*)tx.second.ptr)[1], == ,3);
+    gbinder_fmq_end_read(fmq, 3);
+    g_assert_cmpuint(gbinder_fmq_available_to_read(fmq), == ,0);
+
+    /* The copying API goes through the same path */
+    g_assert(gbinder_fmq_write(fmq, in, 3));
+    memset(out, 0, sizeof(out));
+    g_assert(gbinder_fmq_read(fmq, out, 3));
+    g_assert(!memcmp(in, out, sizeof(in)));
+
+    gbinder_fmq_unref(fmq);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -578,9 +1328,19 @@ int main(int argc, char* argv[])
         g_test_add_func(TEST_("read_write_counters"), test_read_write_counters);
         g_test_add_func(TEST_("read_write_external_fd"),
             test_read_write_external_fd);
+        g_test_add_func(TEST_("batch"), test_batch);
+        g_test_add_func(TEST_("readers"), test_readers);
         g_test_add_func(TEST_("ref"), test_ref);
+        g_test_add_func(TEST_("align_counters"), test_align_counters);
+        g_test_add_func(TEST_("backing_store"), test_backing_store);
         g_test_add_func(TEST_("wait_wake"), test_wait_wake);
+        g_test_add_func(TEST_("wait_any"), test_wait_any);
+        g_test_add_func(TEST_("blocking"), test_blocking);
+        g_test_add_func(TEST_("spin"), test_spin);
+        g_test_add_func(TEST_("watch"), test_watch);
         g_test_add_func(TEST_("zero_copy"), test_zero_copy);
+        g_test_add_func(TEST_("zero_copy_tx"), test_zero_copy_tx);
+        g_test_add_func(TEST_("channel"), test_channel);
     }
 #else /* GBINDER_FMQ_SUPPORTED */
     g_test_init(&argc, &argv, NULL);
@@ -33,24 +33,31 @@
 #include "test_binder.h"
 
 #include "gbinder_ipc.h"
+#include "gbinder_buffer_p.h"
+#include "gbinder_config.h"
 #include "gbinder_driver.h"
 #include "gbinder_local_object_p.h"
 #include "gbinder_local_reply_p.h"
 #include "gbinder_local_request_p.h"
 #include "gbinder_object_registry.h"
 #include "gbinder_output_data.h"
+#include "gbinder_remote_object_p.h"
 #include "gbinder_remote_reply.h"
-#include "gbinder_remote_request.h"
+#include "gbinder_remote_request_p.h"
 #include "gbinder_rpc_protocol.h"
+#include "gbinder_stats_p.h"
 #include "gbinder_writer.h"
 
 #include <gutil_log.h>
 
 #include <unistd.h>
 #include <errno.h>
+#include <sched.h>
 #include <sys/types.h>
+#include <sys/resource.h>
 
 static TestOpt test_opt;
+static const char TMP_DIR_TEMPLATE[] = "gbinder-test-ipc-XXXXXX";
 
 static
 gboolean
@@ -167,6 +174,220 @@ test_basic(
     test_binder_exit_wait(&test_opt, NULL);
 }
 
+/*==========================================================================*
+ * long_name
+ *==========================================================================*/
+
+static
+void
+test_long_name(
+    void)
+{
+    /* The key doesn't fit into the buffer on stack */
+    static const char dev[] = "/dev/a_very_long_name_of_the_device_which_"
+        "takes_more_than_sixty_four_characters_binder";
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+
+    g_assert(ipc);
+    g_assert_cmpstr(ipc->dev, == ,dev);
+    g_assert(gbinder_ipc_new(dev, NULL) == ipc);
+    g_assert(gbinder_ipc_new(dev, "aidl") == ipc);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_unref(ipc);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, NULL);
+}
+
+/*==========================================================================*
+ * invoke_later
+ *==========================================================================*/
+
+typedef struct test_invoke_later_data {
+    GMainLoop* loop;
+    int calls;
+    int destroyed;
+} TestInvokeLaterData;
+
+static
+void
+test_invoke_later_count(
+    gpointer user_data)
+{
+    TestInvokeLaterData* test = user_data;
+
+    test->calls++;
+}
+
+static
+void
+test_invoke_later_destroy(
+    gpointer user_data)
+{
+    TestInvokeLaterData* test = user_data;
+
+    /* Calls are made in the order of submission */
+    g_assert_cmpint(test->calls, == ,++test->destroyed);
+    if (test->destroyed == 3) {
+        test_quit_later(test->loop);
+    }
+}
+
+static
+void
+test_invoke_later(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    TestInvokeLaterData test;
+    int i;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+
+    /* The second round reuses the recycled entries */
+    for (i = 0; i < 2; i++) {
+        test.calls = test.destroyed = 0;
+        gbinder_ipc_invoke_later(ipc, test_invoke_later_count, &test,
+            test_invoke_later_destroy);
+        gbinder_ipc_invoke_later(ipc, test_invoke_later_count, &test,
+            test_invoke_later_destroy);
+        gbinder_ipc_invoke_later(ipc, test_invoke_later_count, &test,
+            test_invoke_later_destroy);
+        test_run(&test_opt, test.loop);
+        g_assert_cmpint(test.calls, == ,3);
+    }
+
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+/*==========================================================================*
+ * registry
+ *==========================================================================*/
+
+static
+void
+test_registry(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderLocalObject* local[20];
+    GBinderRemoteObject* remote[G_N_ELEMENTS(local)];
+    guint i;
+
+    /* Enough objects to hit every shard more than once */
+    for (i = 0; i < G_N_ELEMENTS(local); i++) {
+        local[i] = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+        remote[i] = gbinder_object_registry_get_remote(reg, i + 1,
+            REMOTE_REGISTRY_CAN_CREATE);
+        g_assert(local[i]);
+        g_assert(remote[i]);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS(local); i++) {
+        GBinderLocalObject* obj = gbinder_object_registry_get_local(reg,
+            local[i]);
+        GBinderRemoteObject* robj = gbinder_object_registry_get_remote(reg,
+            i + 1, REMOTE_REGISTRY_DONT_CREATE);
+
+        g_assert(obj == local[i]);
+        g_assert(robj == remote[i]);
+        gbinder_local_object_unref(obj);
+        gbinder_remote_object_unref(robj);
+        g_assert(gbinder_ipc_find_local_object(ipc, test_basic_find,
+            local[i]) == local[i]);
+        gbinder_local_object_unref(local[i]);
+    }
+
+    /* Once the last reference is gone, objects are no longer found */
+    for (i = 0; i < G_N_ELEMENTS(local); i++) {
+        gbinder_local_object_unref(local[i]);
+        gbinder_remote_object_unref(remote[i]);
+        g_assert(!gbinder_object_registry_get_remote(reg, i + 1,
+            REMOTE_REGISTRY_DONT_CREATE));
+    }
+
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, NULL);
+}
+
+/*==========================================================================*
+ * intern_iface
+ *==========================================================================*/
+
+static
+GBinderRemoteRequest*
+test_intern_iface_request(
+    GBinderIpc* ipc,
+    const char* iface)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
+    GBinderLocalRequest* local = gbinder_local_request_new_iface
+        (gbinder_driver_io(ipc->driver), prot, iface);
+    GByteArray* bytes = gbinder_local_request_data(local)->bytes;
+    GBinderRemoteRequest* req = gbinder_remote_request_new
+        (gbinder_ipc_object_registry(ipc), prot, 0, 0);
+
+    gbinder_remote_request_set_data(req, GBINDER_FIRST_CALL_TRANSACTION,
+        gbinder_buffer_new(ipc->driver, g_memdup(bytes->data, bytes->len),
+        bytes->len, NULL));
+    gbinder_local_request_unref(local);
+    return req;
+}
+
+static
+void
+test_intern_iface(
+    void)
+{
+    static const gunichar2 foo[] = { 'f', 'o', 'o' };
+    static const gunichar2 bad[] = { 'f', 0xd800 };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderRemoteRequest* req1;
+    GBinderRemoteRequest* req2;
+    const char* str;
+    guint i;
+
+    str = gbinder_object_registry_intern_iface(reg, foo, G_N_ELEMENTS(foo));
+    g_assert_cmpstr(str, == ,"foo");
+    g_assert(gbinder_object_registry_intern_iface(reg, foo,
+        G_N_ELEMENTS(foo)) == str);
+    g_assert(!gbinder_object_registry_intern_iface(reg, bad,
+        G_N_ELEMENTS(bad)));
+
+    /* Requests share the interface name */
+    req1 = test_intern_iface_request(ipc, "foo");
+    req2 = test_intern_iface_request(ipc, "foo");
+    g_assert(gbinder_remote_request_interface(req1) == str);
+    g_assert(gbinder_remote_request_interface(req2) == str);
+    gbinder_remote_request_unref(req1);
+    gbinder_remote_request_unref(req2);
+
+    /* The number of interned names is limited */
+    for (i = 0; i < 100; i++) {
+        gunichar2 name[2];
+
+        name[0] = 'x';
+        name[1] = 'a' + i;
+        gbinder_object_registry_intern_iface(reg, name, G_N_ELEMENTS(name));
+    }
+    req1 = test_intern_iface_request(ipc, "bar");
+    g_assert_cmpstr(gbinder_remote_request_interface(req1), == ,"bar");
+    gbinder_remote_request_unref(req1);
+
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, NULL);
+}
+
 /*==========================================================================*
  * async_oneway
  *==========================================================================*/
@@ -207,6 +428,59 @@ test_async_oneway(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * direct_oneway
+ *==========================================================================*/
+
+static
+void
+test_direct_oneway_destroy(
+    gpointer user_data)
+{
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+void
+test_direct_oneway(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    const guint32 flags = GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT;
+    gulong id;
+
+    /* No callback */
+    test_binder_br_transaction_complete(fd);
+    g_assert(gbinder_ipc_transact(ipc, 0, 1, flags, req, NULL, NULL, NULL));
+
+    /* Error without a callback */
+    test_binder_br_dead_reply(fd);
+    g_assert(!gbinder_ipc_transact(ipc, 0, 1, flags, req, NULL, NULL, NULL));
+
+    /* Completion is still delivered via the event loop */
+    test_binder_br_transaction_complete(fd);
+    id = gbinder_ipc_transact(ipc, 0, 1, flags, req,
+        test_async_oneway_done, NULL, loop);
+    g_assert(id);
+    test_run(&test_opt, loop);
+
+    /* Cancelled, only the destroy callback gets invoked */
+    test_binder_br_transaction_complete(fd);
+    id = gbinder_ipc_transact(ipc, 0, 1, flags, req,
+        test_async_oneway_done, test_direct_oneway_destroy, loop);
+    g_assert(id);
+    gbinder_ipc_cancel(ipc, id);
+    test_run(&test_opt, loop);
+
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+    g_main_loop_unref(loop);
+}
+
 /*==========================================================================*
  * sync_oneway
  *==========================================================================*/
@@ -496,6 +770,112 @@ test_transact_failed(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * transact_frozen
+ *==========================================================================*/
+
+static
+void
+test_transact_frozen_done(
+    GBinderIpc* ipc,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    GVERBOSE_("%d", status);
+    g_assert(!reply);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_FROZEN);
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+void
+test_transact_frozen(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    const guint32 flags = GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT;
+    gulong id;
+
+    /* Oneway transactions get queued for the frozen process */
+    test_binder_br_transaction_pending_frozen(fd);
+    g_assert(gbinder_ipc_transact(ipc, 0, 1, flags, req, NULL, NULL, NULL));
+
+    /* But synchronous calls fail */
+    test_binder_br_noop(fd);
+    test_binder_br_frozen_reply(fd);
+    id = gbinder_ipc_transact(ipc, 1, 2, 0, req, test_transact_frozen_done,
+        NULL, loop);
+    g_assert(id);
+    test_run(&test_opt, loop);
+
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * oneway_spam
+ *==========================================================================*/
+
+static
+void
+test_oneway_spam_cb(
+    GBinderIpc* ipc,
+    void* user_data)
+{
+    int* count = user_data;
+
+    GDEBUG("oneway spam");
+    (*count)++;
+}
+
+static
+void
+test_oneway_spam(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    const guint32 flags = GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT;
+    int count = 0;
+    gulong id;
+
+    g_assert(!gbinder_ipc_add_oneway_spam_handler(NULL, NULL, NULL));
+    g_assert(!gbinder_ipc_add_oneway_spam_handler(ipc, NULL, NULL));
+    gbinder_ipc_remove_handler(NULL, 0);
+    gbinder_ipc_remove_handler(ipc, 0);
+    id = gbinder_ipc_add_oneway_spam_handler(ipc, test_oneway_spam_cb,
+        &count);
+    g_assert(id);
+
+    /* The transactions still succeed, notifications get coalesced */
+    test_binder_br_oneway_spam_suspect(fd);
+    g_assert(gbinder_ipc_transact(ipc, 0, 1, flags, req, NULL, NULL, NULL));
+    test_binder_br_oneway_spam_suspect(fd);
+    g_assert(gbinder_ipc_transact(ipc, 0, 1, flags, req, NULL, NULL, NULL));
+    g_assert_cmpint(count, == ,0);
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpint(count, == ,1);
+
+    gbinder_ipc_remove_handler(ipc, id);
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
 /*==========================================================================*
  * transact_status
  *==========================================================================*/
@@ -578,6 +958,126 @@ test_transact_custom(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * thread_config
+ *==========================================================================*/
+
+typedef struct test_thread_config_data {
+    GMainLoop* loop;
+    int nice;
+} TestThreadConfigData;
+
+static
+void
+test_thread_config_exec(
+    const GBinderIpcTx* tx)
+{
+    TestThreadConfigData* test = tx->user_data;
+
+    errno = 0;
+    test->nice = getpriority(PRIO_PROCESS, 0);
+    g_assert(!errno);
+}
+
+static
+void
+test_thread_config_done(
+    const GBinderIpcTx* tx)
+{
+    TestThreadConfigData* test = tx->user_data;
+
+    test_quit_later(test->loop);
+}
+
+static
+int
+test_thread_config_tx(
+    TestThreadConfigData* test)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+
+    test->nice = G_MININT;
+    g_assert(gbinder_ipc_transact_custom(ipc, test_thread_config_exec,
+        test_thread_config_done, NULL, test));
+    test_run(&test_opt, test->loop);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test->loop);
+    return test->nice;
+}
+
+static
+void
+test_thread_config(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    TestThreadConfigData test;
+    GBinderIpc* ipc;
+    int nice;
+
+    /* Lowering the priority is always allowed */
+    static const char config[] =
+        "[TxCpus]\n"
+        "Default = 0-1023\n"
+        "[TxNice]\n"
+        "/dev/binder = 19\n"
+        "[LooperNice]\n"
+        "Default = 19\n"
+        "[LooperRtPriority]\n"
+        "Default = 1000\n"
+        "[LooperStackSize]\n"
+        "Default = 262144\n";
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    errno = 0;
+    nice = getpriority(PRIO_PROCESS, 0);
+    g_assert(!errno);
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    /* Bad values are rejected */
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert(!gbinder_ipc_set_thread_cpus(ipc, GBINDER_IPC_THREADS_COUNT,
+        NULL));
+    g_assert(!gbinder_ipc_set_thread_cpus(ipc, GBINDER_IPC_THREADS_TX, "x"));
+    g_assert(!gbinder_ipc_set_thread_cpus(ipc, GBINDER_IPC_THREADS_TX, "1-"));
+    g_assert(!gbinder_ipc_set_thread_cpus(ipc, GBINDER_IPC_THREADS_TX, "2-1"));
+    g_assert(!gbinder_ipc_set_thread_cpus(ipc, GBINDER_IPC_THREADS_TX,
+        "0,1024"));
+    g_assert(!gbinder_ipc_set_thread_sched(ipc, GBINDER_IPC_THREADS_COUNT,
+        SCHED_OTHER, 0));
+    g_assert(!gbinder_ipc_set_thread_sched(ipc, GBINDER_IPC_THREADS_TX,
+        SCHED_OTHER, 20));
+    g_assert(!gbinder_ipc_set_thread_sched(ipc, GBINDER_IPC_THREADS_TX,
+        SCHED_FIFO, 0));
+    g_assert(gbinder_ipc_set_thread_cpus(ipc, GBINDER_IPC_THREADS_LOOPER,
+        "0,1-3"));
+    gbinder_ipc_unref(ipc);
+
+    /* The worker thread runs with the configured nice value */
+    g_assert_cmpint(test_thread_config_tx(&test), == ,19);
+
+    /*
+     * Without the config, the worker attempts to restore its original
+     * nice value, which may not be allowed without CAP_SYS_NICE.
+     */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+    g_assert_cmpint(test_thread_config_tx(&test), >= ,nice);
+
+    g_main_loop_unref(test.loop);
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
 /*==========================================================================*
  * transact_custom2
  *==========================================================================*/
@@ -890,49 +1390,1535 @@ test_transact_unhandled(
 }
 
 /*==========================================================================*
- * transact_incoming
+ * ping_many
  *==========================================================================*/
 
 static
-GBinderLocalReply*
-test_transact_incoming_proc(
-    GBinderLocalObject* obj,
-    GBinderRemoteRequest* req,
-    guint code,
-    guint flags,
-    int* status,
+void
+test_ping_many_done(
+    GBinderIpc* ipc,
+    const guint8* results,
+    guint count,
     void* user_data)
 {
-    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
-    g_assert(!flags);
-    g_assert(gbinder_remote_request_sender_pid(req) == getpid());
-    g_assert(gbinder_remote_request_sender_euid(req) == geteuid());
-    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
-    g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
-    g_assert(code == 1);
+    g_assert_cmpuint(count, == ,3);
+    g_assert_cmpuint(results[0], == ,GBINDER_PING_ALIVE);
+    g_assert_cmpuint(results[1], == ,GBINDER_PING_DEAD);
+    g_assert_cmpuint(results[2], == ,GBINDER_PING_DEAD);
     test_quit_later((GMainLoop*)user_data);
+}
 
-    *status = GBINDER_STATUS_OK;
-    return gbinder_local_object_new_reply(obj);
+static
+void
+test_ping_many_empty_done(
+    GBinderIpc* ipc,
+    const guint8* results,
+    guint count,
+    void* user_data)
+{
+    g_assert_cmpuint(count, == ,0);
+    test_quit_later((GMainLoop*)user_data);
 }
 
 static
 void
-test_transact_incoming_run(
-    void)
+test_ping_many_cancelled(
+    GBinderIpc* ipc,
+    const guint8* results,
+    guint count,
+    void* user_data)
 {
-    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
-    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    g_assert_not_reached();
+}
+
+static
+void
+test_ping_many_destroy(
+    gpointer user_data)
+{
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+void
+test_ping_many_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderLocalObject* obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderRemoteObject* objects[3];
+    guint handle;
+    gulong id;
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    handle = test_binder_register_object(fd, obj, AUTO_HANDLE);
+    objects[0] = gbinder_object_registry_get_remote(reg, handle, FALSE);
+    objects[1] = gbinder_object_registry_get_remote(reg, handle + 1, FALSE);
+    objects[2] = NULL;
+
+    g_assert(!gbinder_ipc_ping_many(NULL, objects, 3, 0, NULL, NULL, NULL));
+    g_assert(!gbinder_ipc_ping_many(ipc, NULL, 3, 0, NULL, NULL, NULL));
+
+    /* Nothing to ping, but the completion is still asynchronous */
+    g_assert(gbinder_ipc_ping_many(ipc, NULL, 0, 0, test_ping_many_empty_done,
+        NULL, loop));
+    test_run(&test_opt, loop);
+
+    /* Existing and non-existent handle, plus NULL */
+    g_assert(gbinder_ipc_ping_many(ipc, objects, 3, 0, test_ping_many_done,
+        NULL, loop));
+    test_run(&test_opt, loop);
+
+    /* Cancelled, only the destroy callback gets invoked */
+    id = gbinder_ipc_ping_many(ipc, objects, 3, 0, test_ping_many_cancelled,
+        test_ping_many_destroy, loop);
+    g_assert(id);
+    gbinder_ipc_cancel(ipc, id);
+    test_run(&test_opt, loop);
+
+    gbinder_remote_object_unref(objects[0]);
+    gbinder_remote_object_unref(objects[1]);
+    test_binder_unregister_objects(fd);
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_ping_many(
+    void)
+{
+    test_run_in_context(&test_opt, test_ping_many_run);
+}
+
+/*==========================================================================*
+ * tx_lanes
+ *==========================================================================*/
+
+typedef struct test_tx_lanes_data {
+    GMainLoop* loop;
+    GMutex mutex;
+    GCond cond;
+    gboolean released;
+    guint32 order[4];
+    guint received;
+} TestTxLanesData;
+
+static
+void
+test_tx_lanes_block(
+    const GBinderIpcTx* tx)
+{
+    TestTxLanesData* test = tx->user_data;
+
+    /* Holds the only worker until the realtime call gets through */
+    g_mutex_lock(&test->mutex);
+    while (!test->released) {
+        g_cond_wait(&test->cond, &test->mutex);
+    }
+    g_mutex_unlock(&test->mutex);
+}
+
+static
+GBinderLocalReply*
+test_tx_lanes_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestTxLanesData* test = user_data;
+
+    g_assert_cmpuint(test->received, < ,G_N_ELEMENTS(test->order));
+    GDEBUG("Call %u received", code);
+    test->order[test->received++] = code;
+    if (code == 4) {
+        g_mutex_lock(&test->mutex);
+        test->released = TRUE;
+        g_cond_broadcast(&test->cond);
+        g_mutex_unlock(&test->mutex);
+    }
+    if (test->received == G_N_ELEMENTS(test->order)) {
+        test_quit_later(test->loop);
+    }
+    return NULL;
+}
+
+static
+void
+test_tx_lanes_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderLocalObject* obj;
+    TestTxLanesData test;
+    GBinderWriter writer;
+    guint handle;
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_int32(&writer, 0);
+    memset(&test, 0, sizeof(test));
+    g_mutex_init(&test.mutex);
+    g_cond_init(&test.cond);
+    test.loop = g_main_loop_new(NULL, FALSE);
+    obj = gbinder_local_object_new(ipc, NULL, test_tx_lanes_proc, &test);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    handle = test_binder_register_object(fd, obj, AUTO_HANDLE);
+    g_assert(gbinder_ipc_set_max_threads(ipc, 1));
+
+    /* The first one occupies the worker, the rest gets queued */
+    g_assert(gbinder_ipc_transact_custom(ipc, test_tx_lanes_block, NULL,
+        NULL, &test));
+    g_assert(gbinder_ipc_transact(ipc, handle, 1, GBINDER_TX_FLAG_ONEWAY |
+        GBINDER_TX_FLAG_BACKGROUND, req, NULL, NULL, NULL));
+    g_assert(gbinder_ipc_transact(ipc, handle, 2, GBINDER_TX_FLAG_ONEWAY,
+        req, NULL, NULL, NULL));
+    g_assert(gbinder_ipc_transact(ipc, handle, 3, GBINDER_TX_FLAG_ONEWAY,
+        req, NULL, NULL, NULL));
+    g_assert(gbinder_ipc_transact(ipc, handle, 4, GBINDER_TX_FLAG_ONEWAY |
+        GBINDER_TX_FLAG_REALTIME, req, NULL, NULL, NULL));
+    test_run(&test_opt, test.loop);
+
+    /* Realtime one bypasses the queue, background goes last */
+    g_assert_cmpuint(test.order[0], == ,4);
+    g_assert_cmpuint(test.order[1], == ,2);
+    g_assert_cmpuint(test.order[2], == ,3);
+    g_assert_cmpuint(test.order[3], == ,1);
+
+    gbinder_local_request_unref(req);
+    test_binder_unregister_objects(fd);
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+    g_mutex_clear(&test.mutex);
+    g_cond_clear(&test.cond);
+}
+
+static
+void
+test_tx_lanes(
+    void)
+{
+    test_run_in_context(&test_opt, test_tx_lanes_run);
+}
+
+/*==========================================================================*
+ * broadcast
+ *==========================================================================*/
+
+#define TEST_BROADCAST_CODE (42)
+
+typedef struct test_broadcast_data {
+    GMainLoop* loop;
+    int received;
+    gboolean done;
+} TestBroadcastData;
+
+static
+void
+test_broadcast_check_done(
+    TestBroadcastData* test)
+{
+    if (test->done && test->received == 2) {
+        test_quit_later(test->loop);
+    }
+}
+
+static
+GBinderLocalReply*
+test_broadcast_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestBroadcastData* test = user_data;
+    gint32 value = 0;
+
+    g_assert_cmpuint(code, == ,TEST_BROADCAST_CODE);
+    g_assert(flags & GBINDER_TX_FLAG_ONEWAY);
+    g_assert_cmpstr(gbinder_remote_request_interface(req), == ,"test");
+    g_assert(gbinder_remote_request_read_int32(req, &value));
+    g_assert_cmpint(value, == ,TEST_BROADCAST_CODE);
+    test->received++;
+    GDEBUG("Broadcast %d received", test->received);
+    test_broadcast_check_done(test);
+    return NULL;
+}
+
+static
+void
+test_broadcast_done(
+    GBinderIpc* ipc,
+    const int* status,
+    guint count,
+    void* user_data)
+{
+    TestBroadcastData* test = user_data;
+
+    g_assert_cmpuint(count, == ,4);
+    g_assert_cmpint(status[0], == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(status[1], == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(status[2], == ,GBINDER_STATUS_DEAD_OBJECT);
+    g_assert_cmpint(status[3], == ,GBINDER_STATUS_DEAD_OBJECT);
+    test->done = TRUE;
+    test_broadcast_check_done(test);
+}
+
+static
+void
+test_broadcast_cancelled(
+    GBinderIpc* ipc,
+    const int* status,
+    guint count,
+    void* user_data)
+{
+    g_assert_not_reached();
+}
+
+static
+void
+test_broadcast_destroy(
+    gpointer user_data)
+{
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+void
+test_broadcast_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const GBinderRpcProtocol* prot =
+        gbinder_rpc_protocol_for_device(gbinder_driver_dev(ipc->driver));
+    const char* const ifaces[] = { "test", NULL };
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderRemoteObject* objects[4];
+    GBinderLocalObject* obj;
+    TestBroadcastData test;
+    GBinderWriter writer;
+    guint handle;
+    gulong id;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    obj = gbinder_local_object_new(ipc, ifaces, test_broadcast_proc, &test);
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_int32(&writer, TEST_BROADCAST_CODE);
+
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    handle = test_binder_register_object(fd, obj, AUTO_HANDLE);
+    objects[0] = gbinder_object_registry_get_remote(reg, handle, FALSE);
+    objects[1] = objects[0];
+    objects[2] = gbinder_object_registry_get_remote(reg, handle + 1, FALSE);
+    objects[3] = NULL;
+
+    g_assert(!gbinder_ipc_broadcast(NULL, objects, 4, TEST_BROADCAST_CODE,
+        req, NULL, NULL, NULL));
+    g_assert(!gbinder_ipc_broadcast(ipc, NULL, 4, TEST_BROADCAST_CODE,
+        req, NULL, NULL, NULL));
+    g_assert(!gbinder_ipc_broadcast(ipc, objects, 4, TEST_BROADCAST_CODE,
+        NULL, NULL, NULL, NULL));
+
+    /* The same object twice, non-existent handle and NULL */
+    g_assert(gbinder_ipc_broadcast(ipc, objects, 4, TEST_BROADCAST_CODE,
+        req, test_broadcast_done, NULL, &test));
+    test_run(&test_opt, test.loop);
+
+    /* Cancelled, only the destroy callback gets invoked */
+    id = gbinder_ipc_broadcast(ipc, objects + 2, 2, TEST_BROADCAST_CODE,
+        req, test_broadcast_cancelled, test_broadcast_destroy, test.loop);
+    g_assert(id);
+    gbinder_ipc_cancel(ipc, id);
+    test_run(&test_opt, test.loop);
+
+    gbinder_local_request_unref(req);
+    gbinder_remote_object_unref(objects[0]);
+    gbinder_remote_object_unref(objects[2]);
+    test_binder_unregister_objects(fd);
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_broadcast(
+    void)
+{
+    test_run_in_context(&test_opt, test_broadcast_run);
+}
+
+/*==========================================================================*
+ * transact_incoming
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+test_transact_incoming_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
+    g_assert(!flags);
+    g_assert(gbinder_remote_request_sender_pid(req) == getpid());
+    g_assert(gbinder_remote_request_sender_euid(req) == geteuid());
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
+    g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
+    g_assert(code == 1);
+    test_quit_later((GMainLoop*)user_data);
+
+    *status = GBINDER_STATUS_OK;
+    return gbinder_local_object_new_reply(obj);
+}
+
+static
+void
+test_transact_incoming_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const char* dev = gbinder_driver_dev(ipc->driver);
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
+    const char* const ifaces[] = { "test", NULL };
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderLocalObject* obj = gbinder_local_object_new
+        (ipc, ifaces, test_transact_incoming_proc, loop);
+    GBinderLocalRequest* ping = gbinder_local_request_new(io, NULL);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderWriter writer;
+
+    gbinder_local_request_init_writer(ping, &writer);
+    prot->write_ping(&writer);
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+
+    test_binder_br_transaction(fd, obj, prot->ping_tx,
+        gbinder_local_request_data(ping)->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_br_transaction(fd, obj, 1,
+        gbinder_local_request_data(req)->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, loop);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    GDEBUG("waiting for GBinderIpc to get destroyed");
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(ping);
+    gbinder_local_request_unref(req);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_transact_incoming(
+    void)
+{
+    test_run_in_context(&test_opt, test_transact_incoming_run);
+}
+
+/*==========================================================================*
+ * trace_context
+ *==========================================================================*/
+
+#define TEST_TRACE_ID G_GUINT64_CONSTANT(0x123456789abcdef0)
+
+static
+GBinderLocalReply*
+test_trace_context_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    GBinderReader reader;
+
+    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
+
+    /* The trailer is stripped, the reader doesn't see it */
+    gbinder_remote_request_init_reader(req, &reader);
+    g_assert_cmpstr(gbinder_reader_read_string8(&reader), == ,"message");
+    g_assert(gbinder_reader_at_end(&reader));
+
+    if (code == 1) {
+        g_assert(gbinder_remote_request_trace_id(req) == TEST_TRACE_ID);
+    } else {
+        g_assert_cmpuint(code, == ,2);
+        g_assert(!gbinder_remote_request_trace_id(req));
+        test_quit_later((GMainLoop*)user_data);
+    }
+
+    *status = GBINDER_STATUS_OK;
+    return gbinder_local_object_new_reply(obj);
+}
+
+static
+void
+test_trace_context_run(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GBinderIpc* ipc;
+    const GBinderIo* io;
+    const GBinderRpcProtocol* prot;
+    const char* const ifaces[] = { "test", NULL };
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderDriverTraceTrailer trailer;
+    GBinderLocalObject* obj;
+    GBinderLocalRequest* req;
+    GBinderWriter writer;
+    GByteArray* bytes;
+    int fd;
+
+    static const char config[] =
+        "[TraceContext]\n"
+        "/dev/binder = 1\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    io = gbinder_driver_io(ipc->driver);
+    fd = gbinder_driver_fd(ipc->driver);
+    prot = gbinder_rpc_protocol_for_device(gbinder_driver_dev(ipc->driver));
+    obj = gbinder_local_object_new(ipc, ifaces, test_trace_context_proc, loop);
+
+    req = gbinder_local_request_new(io, NULL);
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+
+    /* The first one comes with the trailer, the second one without */
+    trailer.id = TEST_TRACE_ID;
+    trailer.reserved = 0;
+    trailer.magic = GBINDER_DRIVER_TRACE_MAGIC;
+    bytes = g_byte_array_new();
+    g_byte_array_append(bytes, gbinder_local_request_data(req)->bytes->data,
+        gbinder_local_request_data(req)->bytes->len);
+    g_byte_array_append(bytes, (const void*)&trailer, sizeof(trailer));
+
+    test_binder_br_transaction(fd, obj, 1, bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_br_transaction(fd, obj, 2,
+        gbinder_local_request_data(req)->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, loop);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    g_byte_array_free(bytes, TRUE);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+static
+void
+test_trace_context(
+    void)
+{
+    test_run_in_context(&test_opt, test_trace_context_run);
+}
+
+/*==========================================================================*
+ * trace_context_send
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+test_trace_context_send_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    GBinderReader reader;
+
+    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
+
+    /* The trailer is stripped, the reader doesn't see it */
+    gbinder_remote_request_init_reader(req, &reader);
+    g_assert_cmpstr(gbinder_reader_read_string8(&reader), == ,"message");
+    g_assert(gbinder_reader_at_end(&reader));
+
+    if (code == 1) {
+        /* Set by the caller */
+        g_assert(gbinder_remote_request_trace_id(req) == TEST_TRACE_ID);
+    } else {
+        /* Generated by the driver */
+        g_assert_cmpuint(code, == ,2);
+        g_assert(gbinder_remote_request_trace_id(req));
+        g_assert(gbinder_remote_request_trace_id(req) != TEST_TRACE_ID);
+    }
+
+    *status = GBINDER_STATUS_OK;
+    return gbinder_local_object_new_reply(obj);
+}
+
+typedef struct test_trace_context_send {
+    GMainLoop* loop;
+    int count;
+} TestTraceContextSend;
+
+static
+void
+test_trace_context_send_reply(
+    GBinderIpc* ipc,
+    GBinderRemoteReply* reply,
+    int status,
+    void* user_data)
+{
+    TestTraceContextSend* test = user_data;
+
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    if (++test->count == 2) {
+        test_quit_later(test->loop);
+    }
+}
+
+static
+void
+test_trace_context_send_run(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GBinderIpc* ipc;
+    const GBinderIo* io;
+    const GBinderRpcProtocol* prot;
+    const char* const ifaces[] = { "test", NULL };
+    GBinderLocalObject* obj;
+    GBinderLocalRequest* req1;
+    GBinderLocalRequest* req2;
+    GBinderWriter writer;
+    TestTraceContextSend test;
+    guint handle;
+    int fd;
+
+    static const char config[] =
+        "[TraceContext]\n"
+        "/dev/binder = 1\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    io = gbinder_driver_io(ipc->driver);
+    fd = gbinder_driver_fd(ipc->driver);
+    prot = gbinder_rpc_protocol_for_device(gbinder_driver_dev(ipc->driver));
+    obj = gbinder_local_object_new(ipc, ifaces, test_trace_context_send_proc,
+        NULL);
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    handle = test_binder_register_object(fd, obj, AUTO_HANDLE);
+
+    /* The first one carries the caller's id, the second one gets a new one */
+    req1 = gbinder_local_request_new(io, NULL);
+    gbinder_local_request_init_writer(req1, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+    gbinder_local_request_set_trace_id(req1, TEST_TRACE_ID);
+    req2 = gbinder_local_request_new(io, NULL);
+    gbinder_local_request_init_writer(req2, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+    g_assert(gbinder_ipc_transact(ipc, handle, 1, 0, req1,
+        test_trace_context_send_reply, NULL, &test));
+    g_assert(gbinder_ipc_transact(ipc, handle, 2, 0, req2,
+        test_trace_context_send_reply, NULL, &test));
+    test_run(&test_opt, test.loop);
+
+    gbinder_local_request_unref(req1);
+    gbinder_local_request_unref(req2);
+    test_binder_unregister_objects(fd);
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+static
+void
+test_trace_context_send(
+    void)
+{
+    test_run_in_context(&test_opt, test_trace_context_send_run);
+}
+
+/*==========================================================================*
+ * transact_unknown_target
+ *==========================================================================*/
+
+static
+void
+test_transact_unknown_target_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const char* dev = gbinder_driver_dev(ipc->driver);
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
+    const char* const ifaces[] = { "test", NULL };
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderLocalObject* obj = gbinder_local_object_new
+        (ipc, ifaces, test_transact_incoming_proc, loop);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    const GByteArray* bytes;
+    GBinderWriter writer;
+    int i;
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+    bytes = gbinder_local_request_data(req)->bytes;
+
+    /* Calls to unknown objects get rejected, the next one gets through */
+    for (i = 0; i < 3; i++) {
+        test_binder_br_transaction(fd, &i, 1, bytes);
+        test_binder_br_transaction_complete(fd); /* For status reply */
+    }
+    test_binder_br_transaction(fd, obj, 1, bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, loop);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    GDEBUG("waiting for GBinderIpc to get destroyed");
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_transact_unknown_target(
+    void)
+{
+    test_run_in_context(&test_opt, test_transact_unknown_target_run);
+}
+
+/*==========================================================================*
+ * transact_status_reply
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+test_transact_status_reply_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
+    g_assert(!flags);
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
+    g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
+    g_assert(code == 1);
+    test_quit_later((GMainLoop*)user_data);
+
+    *status = EXPECTED_STATUS;
+    return NULL;
+}
+
+static
+void
+test_transact_status_reply_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const char* dev = gbinder_driver_dev(ipc->driver);
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
+    const char* const ifaces[] = { "test", NULL };
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderLocalObject* obj = gbinder_local_object_new
+        (ipc, ifaces, test_transact_status_reply_proc, loop);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+    data = gbinder_local_request_data(req);
+
+    test_binder_br_transaction(fd, obj, 1, data->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE_ONE);
+    test_run(&test_opt, loop);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    GDEBUG("waiting for GBinderIpc to get destroyed");
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_transact_status_reply(
+    void)
+{
+    test_run_in_context(&test_opt, test_transact_status_reply_run);
+}
+
+/*==========================================================================*
+ * transact_async
+ *==========================================================================*/
+
+typedef struct test_transact_async_req {
+    GBinderLocalObject* obj;
+    GBinderRemoteRequest* req;
+    GMainLoop* loop;
+} TestTransactAsyncReq;
+
+static
+void
+test_transact_async_done(
+    gpointer data)
+{
+    TestTransactAsyncReq* test = data;
+
+    gbinder_local_object_unref(test->obj);
+    gbinder_remote_request_unref(test->req);
+    test_quit_later(test->loop);
+    g_free(test);
+}
+
+static
+gboolean
+test_transact_async_reply(
+    gpointer data)
+{
+    TestTransactAsyncReq* test = data;
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(test->obj);
+
+    gbinder_remote_request_complete(test->req, reply, 0);
+    gbinder_local_reply_unref(reply);
+    return G_SOURCE_REMOVE;
+}
+
+static
+GBinderLocalReply*
+test_transact_async_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* loop)
+{
+    TestTransactAsyncReq* test = g_new(TestTransactAsyncReq, 1);
+
+    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
+    g_assert(!flags);
+    g_assert(gbinder_remote_request_sender_pid(req) == getpid());
+    g_assert(gbinder_remote_request_sender_euid(req) == geteuid());
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
+    g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
+    g_assert(code == 1);
+
+    test->obj = gbinder_local_object_ref(obj);
+    test->req = gbinder_remote_request_ref(req);
+    test->loop = (GMainLoop*)loop;
+
+    gbinder_remote_request_block(req);
+    gbinder_remote_request_block(req); /* wrong state; has no effect */
+
+    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, test_transact_async_reply, test,
+        test_transact_async_done);
+    return NULL;
+}
+
+static
+void
+test_transact_async_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const char* dev = gbinder_driver_dev(ipc->driver);
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
+    const char* const ifaces[] = { "test", NULL };
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderLocalObject* obj = gbinder_local_object_new
+        (ipc, ifaces, test_transact_async_proc, loop);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+    data = gbinder_local_request_data(req);
+
+    test_binder_br_transaction(fd, obj, 1, data->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE_ONE);
+    test_run(&test_opt, loop);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    GDEBUG("waiting for GBinderIpc to get destroyed");
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_transact_async(
+    void)
+{
+    test_run_in_context(&test_opt, test_transact_async_run);
+}
+
+/*==========================================================================*
+ * transact_looper
+ *==========================================================================*/
+
+static GThread* test_transact_looper_main_thread = NULL;
+
+static
+GBinderLocalReply*
+test_transact_looper_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* loop)
+{
+    TestTransactAsyncReq* test = g_new(TestTransactAsyncReq, 1);
+
+    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
+    g_assert(g_thread_self() != test_transact_looper_main_thread);
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
+    g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
+    g_assert(code == 1);
+
+    test->obj = gbinder_local_object_ref(obj);
+    test->req = gbinder_remote_request_ref(req);
+    test->loop = (GMainLoop*)loop;
+
+    /* Block here and complete it on the main thread */
+    gbinder_remote_request_block(req);
+    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, test_transact_async_reply, test,
+        test_transact_async_done);
+    return NULL;
+}
+
+static
+void
+test_transact_looper_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const char* dev = gbinder_driver_dev(ipc->driver);
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
+    const char* const ifaces[] = { "test", NULL };
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderLocalObject* obj = gbinder_local_object_new
+        (ipc, ifaces, test_transact_looper_proc, loop);
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderWriter writer;
+
+    test_transact_looper_main_thread = g_thread_self();
+    gbinder_local_object_set_looper_dispatch(NULL, TRUE); /* No effect */
+    gbinder_local_object_set_looper_dispatch(obj, TRUE);
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+
+    test_binder_br_transaction(fd, obj, 1,
+        gbinder_local_request_data(req)->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE_ONE);
+    test_run(&test_opt, loop);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    GDEBUG("waiting for GBinderIpc to get destroyed");
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_transact_looper(
+    void)
+{
+    test_run_in_context(&test_opt, test_transact_looper_run);
+}
+
+/*==========================================================================*
+ * transact_serial
+ *==========================================================================*/
+
+typedef struct test_transact_serial {
+    GThread* main_thread;
+    GMainLoop* loop;
+    guint codes[2];
+    gint count;
+} TestTransactSerial;
+
+static
+GBinderLocalReply*
+test_transact_serial_proc(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestTransactSerial* test = user_data;
+    const int i = g_atomic_int_get(&test->count);
+
+    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
+    g_assert(g_thread_self() != test->main_thread);
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
+    g_assert_cmpint(i, < ,G_N_ELEMENTS(test->codes));
+    test->codes[i] = code;
+    if (g_atomic_int_add(&test->count, 1) + 1 == G_N_ELEMENTS(test->codes)) {
+        test_quit_later(test->loop);
+    }
+    *status = GBINDER_STATUS_OK;
+    return NULL;
+}
+
+static
+void
+test_transact_serial_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
     const int fd = gbinder_driver_fd(ipc->driver);
     const char* dev = gbinder_driver_dev(ipc->driver);
     const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
     const char* const ifaces[] = { "test", NULL };
     GMainLoop* loop = g_main_loop_new(NULL, FALSE);
-    GBinderLocalObject* obj = gbinder_local_object_new
-        (ipc, ifaces, test_transact_incoming_proc, loop);
-    GBinderLocalRequest* ping = gbinder_local_request_new(io, NULL);
-    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    TestTransactSerial test;
+    GBinderLocalObject* obj;
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderWriter writer;
+
+    memset(&test, 0, sizeof(test));
+    test.main_thread = g_thread_self();
+    test.loop = loop;
+    obj = gbinder_local_object_new(ipc, ifaces, test_transact_serial_proc,
+        &test);
+    gbinder_local_object_set_serial_dispatch(NULL, TRUE); /* No effect */
+    gbinder_local_object_set_serial_dispatch(obj, TRUE);
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+
+    /* Two transactions, each followed by the reply completion */
+    test_binder_br_transaction(fd, obj, 1,
+        gbinder_local_request_data(req)->bytes);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_transaction(fd, obj, 2,
+        gbinder_local_request_data(req)->bytes);
+    test_binder_br_transaction_complete(fd);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, loop);
+
+    g_assert_cmpint(test.count, == ,2);
+    g_assert_cmpuint(test.codes[0], == ,1);
+    g_assert_cmpuint(test.codes[1], == ,2);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    GDEBUG("waiting for GBinderIpc to get destroyed");
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_transact_serial(
+    void)
+{
+    test_run_in_context(&test_opt, test_transact_serial_run);
+}
+
+/*==========================================================================*
+ * looper_pool
+ *==========================================================================*/
+
+typedef struct test_looper_pool {
+    GBinderIpc* ipc;
+    GMainLoop* loop;
+    guint expected;
+} TestLooperPool;
+
+static
+gboolean
+test_looper_pool_check(
+    gpointer user_data)
+{
+    TestLooperPool* test = user_data;
+
+    if (gbinder_ipc_looper_count(test->ipc) == test->expected) {
+        GDEBUG("%u looper(s)", test->expected);
+        g_main_loop_quit(test->loop);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+test_looper_pool_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    TestLooperPool test;
+    guint id;
+
+    memset(&test, 0, sizeof(test));
+    test.ipc = ipc;
+    test.loop = loop;
+
+    /* Minimum gets bumped to 1, maximum can't be less than minimum */
+    gbinder_ipc_set_looper_limits(ipc, 0, 0);
+    gbinder_ipc_set_looper_limits(ipc, 1, 3);
+    gbinder_ipc_set_looper_idle_timeout(ipc, 100);
+    gbinder_ipc_looper_check(ipc);
+    g_assert_cmpuint(gbinder_ipc_looper_count(ipc), == ,1);
+
+    /* Kernel asks for one more looper */
+    test_binder_br_spawn_looper(fd);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test.expected = 2;
+    id = g_timeout_add(10, test_looper_pool_check, &test);
+    test_run(&test_opt, loop);
+
+    /* And then it exits because there's nothing to do */
+    test.expected = 1;
+    test_run(&test_opt, loop);
+    g_source_remove(id);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    GDEBUG("waiting for GBinderIpc to get destroyed");
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_looper_pool(
+    void)
+{
+    test_run_in_context(&test_opt, test_looper_pool_run);
+}
+
+/*==========================================================================*
+ * prestart
+ *==========================================================================*/
+
+static
+void
+test_prestart_run(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderIpc* ipc;
+
+    static const char config[] =
+        "[PrestartLoopers]\n"
+        "/dev/binder = 2\n"
+        "[MaxLoopers]\n"
+        "Default = 3\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    /* Loopers are there right away, without any local objects */
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert_cmpuint(gbinder_ipc_looper_count(ipc), == ,2);
+
+    /* Same thing when it's picked from the table */
+    g_assert(gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL) == ipc);
+    g_assert_cmpuint(gbinder_ipc_looper_count(ipc), == ,2);
+    gbinder_ipc_unref(ipc);
+
+    /* Checking again doesn't start any more of them */
+    gbinder_ipc_looper_check(ipc);
+    g_assert_cmpuint(gbinder_ipc_looper_count(ipc), == ,2);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+static
+void
+test_prestart(
+    void)
+{
+    test_run_in_context(&test_opt, test_prestart_run);
+}
+
+/*==========================================================================*
+ * autotune
+ *==========================================================================*/
+
+static
+void
+test_autotune_run(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderStatsTuningEntry entries[2];
+    GBinderIpc* ipc;
+    guint n, i;
+
+    static const char config[] =
+        "[Autotune]\n"
+        "/dev/binder = 60000\n"
+        "[MaxLoopers]\n"
+        "/dev/binder = 3\n"
+        "[TxThreads]\n"
+        "/dev/binder = 2\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    n = gbinder_stats_get_tuning(entries, G_N_ELEMENTS(entries));
+
+    /* Nothing is short and nothing is above the configured values */
+    for (i = 0; i < 10; i++) {
+        gbinder_ipc_tune(ipc);
+    }
+    g_assert(!gbinder_ipc_reply_size_hint(ipc));
+    g_assert_cmpuint(gbinder_stats_get_tuning(entries,
+        G_N_ELEMENTS(entries)), == ,n);
+
+    /* Limits raised above the configured values get lowered back */
+    gbinder_ipc_set_looper_limits(ipc, 1, 5);
+    g_assert(gbinder_ipc_set_max_threads(ipc, 3));
+    for (i = 0; i < 5; i++) {
+        gbinder_ipc_tune(ipc);
+    }
+    g_assert_cmpuint(gbinder_stats_get_tuning(entries,
+        G_N_ELEMENTS(entries)), == ,MIN(n + 2, G_N_ELEMENTS(entries)));
+    g_assert_cmpstr(entries[1].dev, == ,GBINDER_DEFAULT_BINDER);
+    g_assert_cmpint(entries[1].param, == ,GBINDER_STATS_TUNING_LOOPERS);
+    g_assert_cmpuint(entries[1].old_value, == ,5);
+    g_assert_cmpuint(entries[1].new_value, == ,4);
+    g_assert_cmpint(entries[0].param, == ,GBINDER_STATS_TUNING_TX_THREADS);
+    g_assert_cmpuint(entries[0].old_value, == ,3);
+    g_assert_cmpuint(entries[0].new_value, == ,2);
+
+    /* One step at a time, never below the configured value */
+    for (i = 0; i < 20; i++) {
+        gbinder_ipc_tune(ipc);
+    }
+    g_assert_cmpuint(gbinder_stats_get_tuning(entries, 1), == ,1);
+    g_assert_cmpint(entries[0].param, == ,GBINDER_STATS_TUNING_LOOPERS);
+    g_assert_cmpuint(entries[0].old_value, == ,4);
+    g_assert_cmpuint(entries[0].new_value, == ,3);
+
+    /* Now we need to wait until GBinderIpc is destroyed */
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+static
+void
+test_autotune(
+    void)
+{
+    test_run_in_context(&test_opt, test_autotune_run);
+}
+
+/*==========================================================================*
+ * blocking_loopers
+ *==========================================================================*/
+
+static
+void
+test_blocking_loopers_run(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    const char* const ifaces[] = { "test", NULL };
+    GBinderIpc* ipc;
+    const GBinderRpcProtocol* prot;
+    GBinderLocalObject* obj;
+    GBinderLocalRequest* ping;
+    GBinderLocalRequest* req;
+    GBinderWriter writer;
+    const GBinderIo* io;
+    int fd;
+
+    static const char config[] =
+        "[BlockingLoopers]\n"
+        "/dev/binder = 1\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    io = gbinder_driver_io(ipc->driver);
+    fd = gbinder_driver_fd(ipc->driver);
+    prot = gbinder_rpc_protocol_for_device(gbinder_driver_dev(ipc->driver));
+    obj = gbinder_local_object_new(ipc, ifaces, test_transact_incoming_proc,
+        loop);
+    ping = gbinder_local_request_new(io, NULL);
+    req = gbinder_local_request_new(io, NULL);
+
+    gbinder_local_request_init_writer(ping, &writer);
+    prot->write_ping(&writer);
+
+    gbinder_local_request_init_writer(req, &writer);
+    prot->write_rpc_header(&writer, "test");
+    gbinder_writer_append_string8(&writer, "message");
+
+    /* Blocking loopers handle the incoming transactions the same way */
+    test_binder_br_transaction(fd, obj, prot->ping_tx,
+        gbinder_local_request_data(ping)->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_br_transaction(fd, obj, 1,
+        gbinder_local_request_data(req)->bytes);
+    test_binder_br_transaction_complete(fd); /* For reply */
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, loop);
+
+    /* And get kicked out of the driver when GBinderIpc is destroyed */
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(ping);
+    gbinder_local_request_unref(req);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+static
+void
+test_blocking_loopers(
+    void)
+{
+    test_run_in_context(&test_opt, test_blocking_loopers_run);
+}
+
+/*==========================================================================*
+ * shared_idle_looper
+ *==========================================================================*/
+
+static
+void
+test_shared_idle_looper_run(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    const char* const ifaces[] = { "test", NULL };
+    GBinderIpc* ipc;
+    const GBinderRpcProtocol* prot;
+    GBinderLocalObject* obj;
+    GBinderLocalRequest* ping;
+    GBinderLocalRequest* req;
     GBinderWriter writer;
+    const GBinderIo* io;
+    int fd;
+
+    static const char config[] =
+        "[SharedIdleLooper]\n"
+        "/dev/binder = 1\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    io = gbinder_driver_io(ipc->driver);
+    fd = gbinder_driver_fd(ipc->driver);
+    prot = gbinder_rpc_protocol_for_device(gbinder_driver_dev(ipc->driver));
+    obj = gbinder_local_object_new(ipc, ifaces, test_transact_incoming_proc,
+        loop);
+    ping = gbinder_local_request_new(io, NULL);
+    req = gbinder_local_request_new(io, NULL);
 
     gbinder_local_request_init_writer(ping, &writer);
     prot->write_ping(&writer);
@@ -941,6 +2927,10 @@ test_transact_incoming_run(
     prot->write_rpc_header(&writer, "test");
     gbinder_writer_append_string8(&writer, "message");
 
+    /* No loopers until there's something to read */
+    g_assert_cmpuint(gbinder_ipc_looper_count(ipc), == ,0);
+
+    /* Then a looper is started and handles the transactions */
     test_binder_br_transaction(fd, obj, prot->ping_tx,
         gbinder_local_request_data(ping)->bytes);
     test_binder_br_transaction_complete(fd); /* For reply */
@@ -950,8 +2940,7 @@ test_transact_incoming_run(
     test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
     test_run(&test_opt, loop);
 
-    /* Now we need to wait until GBinderIpc is destroyed */
-    GDEBUG("waiting for GBinderIpc to get destroyed");
+    /* The idle looper lets go of the device when GBinderIpc is destroyed */
     g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
     gbinder_local_object_unref(obj);
     gbinder_local_request_unref(ping);
@@ -962,129 +2951,336 @@ test_transact_incoming_run(
     gbinder_ipc_exit();
     test_binder_exit_wait(&test_opt, loop);
     g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
 }
 
 static
 void
-test_transact_incoming(
+test_shared_idle_looper(
     void)
 {
-    test_run_in_context(&test_opt, test_transact_incoming_run);
+    test_run_in_context(&test_opt, test_shared_idle_looper_run);
 }
 
 /*==========================================================================*
- * transact_status_reply
+ * shared_tx_pool
  *==========================================================================*/
 
+typedef struct test_shared_tx_pool_data {
+    GMainLoop* loop;
+    gint running;
+    gint max_running;
+    int executed;
+    int done;
+} TestSharedTxPoolData;
+
 static
-GBinderLocalReply*
-test_transact_status_reply_proc(
-    GBinderLocalObject* obj,
-    GBinderRemoteRequest* req,
-    guint code,
-    guint flags,
-    int* status,
-    void* user_data)
+void
+test_shared_tx_pool_exec(
+    const GBinderIpcTx* tx)
 {
-    GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
-    g_assert(!flags);
-    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
-    g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
-    g_assert(code == 1);
-    test_quit_later((GMainLoop*)user_data);
+    TestSharedTxPoolData* test = tx->user_data;
+    const gint running = g_atomic_int_add(&test->running, 1) + 1;
+
+    if (running > g_atomic_int_get(&test->max_running)) {
+        g_atomic_int_set(&test->max_running, running);
+    }
+    g_usleep(1000);
+    g_atomic_int_add(&test->executed, 1);
+    g_atomic_int_add(&test->running, -1);
+}
 
-    *status = EXPECTED_STATUS;
-    return NULL;
+static
+void
+test_shared_tx_pool_done(
+    const GBinderIpcTx* tx)
+{
+    TestSharedTxPoolData* test = tx->user_data;
+
+    if (++(test->done) == 6) {
+        test_quit_later(test->loop);
+    }
 }
 
 static
 void
-test_transact_status_reply_run(
+test_shared_tx_pool_run(
     void)
 {
-    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
-    const GBinderIo* io = gbinder_driver_io(ipc->driver);
-    const int fd = gbinder_driver_fd(ipc->driver);
-    const char* dev = gbinder_driver_dev(ipc->driver);
-    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
-    const char* const ifaces[] = { "test", NULL };
-    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
-    GBinderLocalObject* obj = gbinder_local_object_new
-        (ipc, ifaces, test_transact_status_reply_proc, loop);
-    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
-    GBinderOutputData* data;
-    GBinderWriter writer;
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GBinderIpc* ipc[2];
+    TestSharedTxPoolData test;
+    int i;
+
+    static const char config[] =
+        "[SharedTxThreads]\n"
+        "Default = 1\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    ipc[0] = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    ipc[1] = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+
+    /* Both devices share the same single thread */
+    for (i = 0; i < 6; i++) {
+        g_assert(gbinder_ipc_transact_custom(ipc[i % 2],
+            test_shared_tx_pool_exec, test_shared_tx_pool_done, NULL, &test));
+    }
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.executed, == ,6);
+    g_assert_cmpint(test.max_running, == ,1);
+
+    gbinder_ipc_unref(ipc[0]);
+    gbinder_ipc_unref(ipc[1]);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    g_main_loop_unref(test.loop);
 
-    gbinder_local_request_init_writer(req, &writer);
-    prot->write_rpc_header(&writer, "test");
-    gbinder_writer_append_string8(&writer, "message");
-    data = gbinder_local_request_data(req);
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
 
-    test_binder_br_transaction(fd, obj, 1, data->bytes);
-    test_binder_br_transaction_complete(fd); /* For reply */
-    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE_ONE);
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+static
+void
+test_shared_tx_pool(
+    void)
+{
+    test_run_in_context(&test_opt, test_shared_tx_pool_run);
+}
+
+/*==========================================================================*
+ * remote_cache
+ *==========================================================================*/
+
+static
+gboolean
+test_remote_cache_check(
+    gpointer data)
+{
+    GMainLoop* loop = data;
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderRemoteObject* obj = gbinder_object_registry_get_remote(reg, 3,
+        REMOTE_REGISTRY_DONT_CREATE);
+
+    if (obj) {
+        gbinder_remote_object_unref(obj);
+    } else {
+        GDEBUG("cache has expired");
+        g_main_loop_quit(loop);
+    }
+    gbinder_ipc_unref(ipc);
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+test_remote_cache_run(
+    void)
+{
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderIpc* ipc;
+    GBinderObjectRegistry* reg;
+    GBinderRemoteObject* obj;
+    guint32 h;
+    guint id;
+
+    static const char config[] =
+        "[RemoteCacheSize]\n"
+        "/dev/binder = 2\n"
+        "[RemoteCacheTimeout]\n"
+        "Default = 100\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    reg = gbinder_ipc_object_registry(ipc);
+
+    /* Receive 3 objects and drop them right away */
+    for (h = 1; h <= 3; h++) {
+        obj = gbinder_object_registry_get_remote(reg, h,
+            REMOTE_REGISTRY_CAN_CREATE);
+        g_assert(obj);
+        gbinder_remote_object_unref(obj);
+    }
+
+    /* The oldest one has been evicted, the other two are still there */
+    g_assert(!gbinder_object_registry_get_remote(reg, 1,
+        REMOTE_REGISTRY_DONT_CREATE));
+    for (h = 2; h <= 3; h++) {
+        obj = gbinder_object_registry_get_remote(reg, h,
+            REMOTE_REGISTRY_DONT_CREATE);
+        g_assert(obj);
+        g_assert_cmpuint(obj->handle, == ,h);
+        gbinder_remote_object_unref(obj);
+    }
+
+    /* Wait for them to expire */
+    id = g_timeout_add(10, test_remote_cache_check, loop);
     test_run(&test_opt, loop);
+    g_source_remove(id);
+    g_assert(!gbinder_object_registry_get_remote(reg, 2,
+        REMOTE_REGISTRY_DONT_CREATE));
 
     /* Now we need to wait until GBinderIpc is destroyed */
-    GDEBUG("waiting for GBinderIpc to get destroyed");
     g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
-    gbinder_local_object_unref(obj);
-    gbinder_local_request_unref(req);
     g_idle_add(test_unref_ipc, ipc);
     test_run(&test_opt, loop);
 
     gbinder_ipc_exit();
     test_binder_exit_wait(&test_opt, loop);
     g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
 }
 
 static
 void
-test_transact_status_reply(
+test_remote_cache(
     void)
 {
-    test_run_in_context(&test_opt, test_transact_status_reply_run);
+    test_run_in_context(&test_opt, test_remote_cache_run);
 }
 
 /*==========================================================================*
- * transact_async
+ * remote_cache_death
  *==========================================================================*/
 
-typedef struct test_transact_async_req {
-    GBinderLocalObject* obj;
-    GBinderRemoteRequest* req;
-    GMainLoop* loop;
-} TestTransactAsyncReq;
+static
+void
+test_remote_cache_death_cb(
+    GBinderRemoteObject* obj,
+    void* loop)
+{
+    GVERBOSE_("%u", obj->handle);
+    test_quit_later((GMainLoop*)loop);
+}
 
 static
 void
-test_transact_async_done(
-    gpointer data)
+test_remote_cache_death_run(
+    void)
 {
-    TestTransactAsyncReq* test = data;
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderIpc* ipc;
+    GBinderObjectRegistry* reg;
+    GBinderRemoteObject* obj;
+    GBinderRemoteObject* obj2;
+    const guint32 h = 1;
+    gulong id;
+    int fd;
+
+    static const char config[] =
+        "[RemoteCacheSize]\n"
+        "/dev/binder = 2\n"
+        "[RemoteCacheTimeout]\n"
+        "Default = 600000\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    reg = gbinder_ipc_object_registry(ipc);
+    fd = gbinder_driver_fd(ipc->driver);
+
+    /* The cache holds the second reference */
+    obj = gbinder_object_registry_get_remote(reg, h,
+        REMOTE_REGISTRY_CAN_CREATE);
+    g_assert(obj);
+    g_assert_cmpint(obj->refcount, == ,2);
+
+    /* The handle gets reused by another object, the cache follows */
+    gbinder_ipc_invalidate_remote_handle(ipc, h);
+    obj2 = gbinder_object_registry_get_remote(reg, h,
+        REMOTE_REGISTRY_CAN_CREATE);
+    g_assert(obj2);
+    g_assert(obj2 != obj);
+    g_assert_cmpint(obj->refcount, == ,1);
+    g_assert_cmpint(obj2->refcount, == ,2);
+    gbinder_remote_object_unref(obj);
+    obj = obj2;
+
+    /* Dead object leaves the cache */
+    id = gbinder_remote_object_add_death_handler(obj,
+        test_remote_cache_death_cb, loop);
+    test_binder_br_dead_binder(fd, h);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, loop);
+    g_assert(obj->dead);
+    g_assert_cmpint(obj->refcount, == ,1);
+    gbinder_remote_object_remove_handler(obj, id);
+    gbinder_remote_object_unref(obj);
 
-    gbinder_local_object_unref(test->obj);
-    gbinder_remote_request_unref(test->req);
-    test_quit_later(test->loop);
-    g_free(test);
+    /* Now we need to wait until GBinderIpc is destroyed */
+    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
+    g_idle_add(test_unref_ipc, ipc);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
 }
 
 static
-gboolean
-test_transact_async_reply(
-    gpointer data)
+void
+test_remote_cache_death(
+    void)
 {
-    TestTransactAsyncReq* test = data;
-    GBinderLocalReply* reply = gbinder_local_object_new_reply(test->obj);
-
-    gbinder_remote_request_complete(test->req, reply, 0);
-    gbinder_local_reply_unref(reply);
-    return G_SOURCE_REMOVE;
+    test_run_in_context(&test_opt, test_remote_cache_death_run);
 }
 
+/*==========================================================================*
+ * transact_async_sync
+ *==========================================================================*/
+
 static
 GBinderLocalReply*
-test_transact_async_proc(
+test_transact_async_sync_proc(
     GBinderLocalObject* obj,
     GBinderRemoteRequest* req,
     guint code,
@@ -1092,7 +3288,7 @@ test_transact_async_proc(
     int* status,
     void* loop)
 {
-    TestTransactAsyncReq* test = g_new(TestTransactAsyncReq, 1);
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
 
     GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
     g_assert(!flags);
@@ -1102,21 +3298,19 @@ test_transact_async_proc(
     g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
     g_assert(code == 1);
 
-    test->obj = gbinder_local_object_ref(obj);
-    test->req = gbinder_remote_request_ref(req);
-    test->loop = (GMainLoop*)loop;
-
+    /* Block and immediately complete the call */
     gbinder_remote_request_block(req);
-    gbinder_remote_request_block(req); /* wrong state; has no effect */
+    gbinder_remote_request_complete(req, reply, 0);
+    gbinder_remote_request_complete(req, reply, 0); /* This one is ignored */
+    gbinder_local_reply_unref(reply);
 
-    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, test_transact_async_reply, test,
-        test_transact_async_done);
+    test_quit_later((GMainLoop*)loop);
     return NULL;
 }
 
 static
 void
-test_transact_async_run(
+test_transact_async_sync_run(
     void)
 {
     GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
@@ -1127,7 +3321,7 @@ test_transact_async_run(
     const char* const ifaces[] = { "test", NULL };
     GMainLoop* loop = g_main_loop_new(NULL, FALSE);
     GBinderLocalObject* obj = gbinder_local_object_new
-        (ipc, ifaces, test_transact_async_proc, loop);
+        (ipc, ifaces, test_transact_async_sync_proc, loop);
     GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
     GBinderOutputData* data;
     GBinderWriter writer;
@@ -1157,82 +3351,163 @@ test_transact_async_run(
 
 static
 void
-test_transact_async(
+test_transact_async_sync(
     void)
 {
-    test_run_in_context(&test_opt, test_transact_async_run);
+    test_run_in_context(&test_opt, test_transact_async_sync_run);
 }
 
 /*==========================================================================*
- * transact_async_sync
+ * transact_local_async
  *==========================================================================*/
 
+#define TEST_LOCAL_ASYNC_VALUE (42)
+
+static
+gboolean
+test_transact_local_async_complete(
+    gpointer data)
+{
+    TestTransactAsyncReq* test = data;
+    GBinderLocalReply* reply = gbinder_local_object_new_reply(test->obj);
+
+    gbinder_local_reply_append_int32(reply, TEST_LOCAL_ASYNC_VALUE);
+    gbinder_remote_request_complete(test->req, reply, 0);
+    gbinder_local_reply_unref(reply);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+test_transact_local_async_free(
+    gpointer data)
+{
+    TestTransactAsyncReq* test = data;
+
+    gbinder_local_object_unref(test->obj);
+    gbinder_remote_request_unref(test->req);
+    g_free(test);
+}
+
 static
 GBinderLocalReply*
-test_transact_async_sync_proc(
+test_transact_local_async_proc(
     GBinderLocalObject* obj,
     GBinderRemoteRequest* req,
     guint code,
     guint flags,
     int* status,
-    void* loop)
+    void* user_data)
 {
-    GBinderLocalReply* reply = gbinder_local_object_new_reply(obj);
+    TestTransactAsyncReq* test = g_new0(TestTransactAsyncReq, 1);
 
     GVERBOSE_("\"%s\" %u", gbinder_remote_request_interface(req), code);
     g_assert(!flags);
-    g_assert(gbinder_remote_request_sender_pid(req) == getpid());
-    g_assert(gbinder_remote_request_sender_euid(req) == geteuid());
     g_assert(!g_strcmp0(gbinder_remote_request_interface(req), "test"));
     g_assert(!g_strcmp0(gbinder_remote_request_read_string8(req), "message"));
     g_assert(code == 1);
 
-    /* Block and immediately complete the call */
+    /* Complete it later, on the next main loop iteration */
+    test->obj = gbinder_local_object_ref(obj);
+    test->req = gbinder_remote_request_ref(req);
     gbinder_remote_request_block(req);
-    gbinder_remote_request_complete(req, reply, 0);
-    gbinder_remote_request_complete(req, reply, 0); /* This one is ignored */
-    gbinder_local_reply_unref(reply);
+    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+        test_transact_local_async_complete, test,
+        test_transact_local_async_free);
+    return NULL;
+}
+
+static
+void
+test_transact_local_async_check(
+    GBinderRemoteReply* reply,
+    int status)
+{
+    gint32 value = 0;
+
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert(reply);
+    g_assert(gbinder_remote_reply_read_int32(reply, &value));
+    g_assert_cmpint(value, == ,TEST_LOCAL_ASYNC_VALUE);
+}
 
+static
+void
+test_transact_local_async_reply(
+    GBinderIpc* ipc,
+    GBinderRemoteReply* reply,
+    int status,
+    void* loop)
+{
+    test_transact_local_async_check(reply, status);
     test_quit_later((GMainLoop*)loop);
+}
+
+typedef struct test_transact_local_async_sync {
+    GMainLoop* loop;
+    GBinderIpc* ipc;
+    GBinderLocalObject* obj;
+    GBinderLocalRequest* req;
+} TestTransactLocalAsyncSync;
+
+static
+gpointer
+test_transact_local_async_thread(
+    gpointer user_data)
+{
+    TestTransactLocalAsyncSync* test = user_data;
+    GBinderRemoteReply* reply;
+    int status = INT_MAX;
+
+    /* Waits for the completion */
+    reply = gbinder_ipc_transact_local_sync(test->ipc, test->obj, 1, 0,
+        test->req, &status, &gbinder_ipc_sync_worker);
+    test_transact_local_async_check(reply, status);
+    gbinder_remote_reply_unref(reply);
+    test_quit_later(test->loop);
     return NULL;
 }
 
 static
 void
-test_transact_async_sync_run(
+test_transact_local_async_run(
     void)
 {
     GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
     const GBinderIo* io = gbinder_driver_io(ipc->driver);
-    const int fd = gbinder_driver_fd(ipc->driver);
     const char* dev = gbinder_driver_dev(ipc->driver);
     const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
     const char* const ifaces[] = { "test", NULL };
     GMainLoop* loop = g_main_loop_new(NULL, FALSE);
     GBinderLocalObject* obj = gbinder_local_object_new
-        (ipc, ifaces, test_transact_async_sync_proc, loop);
+        (ipc, ifaces, test_transact_local_async_proc, NULL);
     GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
-    GBinderOutputData* data;
+    TestTransactLocalAsyncSync test;
     GBinderWriter writer;
+    GThread* thread;
 
     gbinder_local_request_init_writer(req, &writer);
     prot->write_rpc_header(&writer, "test");
     gbinder_writer_append_string8(&writer, "message");
-    data = gbinder_local_request_data(req);
 
-    test_binder_br_transaction(fd, obj, 1, data->bytes);
-    test_binder_br_transaction_complete(fd); /* For reply */
-    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE_ONE);
+    /* Asynchronous in-process call, no driver involved */
+    g_assert(gbinder_ipc_transact_local(ipc, obj, 1, 0, req,
+        test_transact_local_async_reply, NULL, loop));
     test_run(&test_opt, loop);
 
-    /* Now we need to wait until GBinderIpc is destroyed */
-    GDEBUG("waiting for GBinderIpc to get destroyed");
-    g_object_weak_ref(G_OBJECT(ipc), test_quit_when_destroyed, loop);
-    gbinder_local_object_unref(obj);
-    gbinder_local_request_unref(req);
-    g_idle_add(test_unref_ipc, ipc);
+    /* Synchronous one made by a worker thread */
+    memset(&test, 0, sizeof(test));
+    test.loop = loop;
+    test.ipc = ipc;
+    test.obj = obj;
+    test.req = req;
+    thread = g_thread_new("local", test_transact_local_async_thread, &test);
     test_run(&test_opt, loop);
+    g_thread_join(thread);
 
+    gbinder_local_object_unref(obj);
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
     gbinder_ipc_exit();
     test_binder_exit_wait(&test_opt, loop);
     g_main_loop_unref(loop);
@@ -1240,10 +3515,10 @@ test_transact_async_sync_run(
 
 static
 void
-test_transact_async_sync(
+test_transact_local_async(
     void)
 {
-    test_run_in_context(&test_opt, test_transact_async_sync_run);
+    test_run_in_context(&test_opt, test_transact_local_async_run);
 }
 
 /*==========================================================================*
@@ -1350,25 +3625,51 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_("null"), test_null);
     g_test_add_func(TEST_("basic"), test_basic);
+    g_test_add_func(TEST_("long_name"), test_long_name);
+    g_test_add_func(TEST_("invoke_later"), test_invoke_later);
+    g_test_add_func(TEST_("registry"), test_registry);
+    g_test_add_func(TEST_("intern_iface"), test_intern_iface);
     g_test_add_func(TEST_("async_oneway"), test_async_oneway);
+    g_test_add_func(TEST_("direct_oneway"), test_direct_oneway);
     g_test_add_func(TEST_("sync_oneway"), test_sync_oneway);
     g_test_add_func(TEST_("sync_reply_ok"), test_sync_reply_ok);
     g_test_add_func(TEST_("sync_reply_error"), test_sync_reply_error);
     g_test_add_func(TEST_("transact_ok"), test_transact_ok);
     g_test_add_func(TEST_("transact_dead"), test_transact_dead);
     g_test_add_func(TEST_("transact_failed"), test_transact_failed);
+    g_test_add_func(TEST_("transact_frozen"), test_transact_frozen);
+    g_test_add_func(TEST_("oneway_spam"), test_oneway_spam);
     g_test_add_func(TEST_("transact_status"), test_transact_status);
     g_test_add_func(TEST_("transact_custom"), test_transact_custom);
+    g_test_add_func(TEST_("thread_config"), test_thread_config);
     g_test_add_func(TEST_("transact_custom2"), test_transact_custom2);
     g_test_add_func(TEST_("transact_custom3"), test_transact_custom3);
     g_test_add_func(TEST_("transact_cancel"), test_transact_cancel);
     g_test_add_func(TEST_("transact_cancel2"), test_transact_cancel2);
     g_test_add_func(TEST_("transact_2way"), test_transact_2way);
     g_test_add_func(TEST_("transact_incoming"), test_transact_incoming);
+    g_test_add_func(TEST_("trace_context"), test_trace_context);
+    g_test_add_func(TEST_("trace_context/send"), test_trace_context_send);
     g_test_add_func(TEST_("transact_unhandled"), test_transact_unhandled);
+    g_test_add_func(TEST_("ping_many"), test_ping_many);
+    g_test_add_func(TEST_("broadcast"), test_broadcast);
+    g_test_add_func(TEST_("tx_lanes"), test_tx_lanes);
+    g_test_add_func(TEST_("transact_unknown_target"),
+        test_transact_unknown_target);
     g_test_add_func(TEST_("transact_status_reply"), test_transact_status_reply);
     g_test_add_func(TEST_("transact_async"), test_transact_async);
     g_test_add_func(TEST_("transact_async_sync"), test_transact_async_sync);
+    g_test_add_func(TEST_("transact_local_async"), test_transact_local_async);
+    g_test_add_func(TEST_("transact_looper"), test_transact_looper);
+    g_test_add_func(TEST_("transact_serial"), test_transact_serial);
+    g_test_add_func(TEST_("looper_pool"), test_looper_pool);
+    g_test_add_func(TEST_("prestart"), test_prestart);
+    g_test_add_func(TEST_("autotune"), test_autotune);
+    g_test_add_func(TEST_("blocking_loopers"), test_blocking_loopers);
+    g_test_add_func(TEST_("shared_idle_looper"), test_shared_idle_looper);
+    g_test_add_func(TEST_("shared_tx_pool"), test_shared_tx_pool);
+    g_test_add_func(TEST_("remote_cache"), test_remote_cache);
+    g_test_add_func(TEST_("remote_cache/death"), test_remote_cache_death);
     g_test_add_func(TEST_("drop_remote_refs"), test_drop_remote_refs);
     g_test_add_func(TEST_("cancel_on_exit"), test_cancel_on_exit);
     test_init(&test_opt, argc, argv);
@@ -35,6 +35,8 @@
 #include "gbinder_buffer_p.h"
 #include "gbinder_config.h"
 #include "gbinder_driver.h"
+#include "gbinder_fmq_p.h"
+#include "gbinder_io.h"
 #include "gbinder_ipc.h"
 #include "gbinder_local_object_p.h"
 #include "gbinder_local_reply_p.h"
@@ -48,6 +50,7 @@
 #include <gutil_strv.h>
 #include <gutil_log.h>
 
+#include <sched.h>
 #include <errno.h>
 
 static TestOpt test_opt;
@@ -125,6 +128,12 @@ test_null(
     g_assert(!gbinder_local_object_add_strong_refs_changed_handler(NULL,
         NULL, NULL));
     gbinder_local_object_remove_handler(NULL, 0);
+    g_assert(!gbinder_local_object_add_methods(NULL, NULL, 0));
+    gbinder_local_object_set_priority(NULL, GBINDER_LOCAL_PRIORITY_HIGH);
+    gbinder_local_object_set_code_priority(NULL, 0,
+        GBINDER_LOCAL_PRIORITY_HIGH);
+    g_assert_cmpint(gbinder_local_object_priority(NULL, 0), == ,
+        GBINDER_LOCAL_PRIORITY_NORMAL);
     g_assert(gbinder_local_object_can_handle_transaction(NULL, NULL, 0) ==
         GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED);
     g_assert(!gbinder_local_object_handle_transaction(NULL, NULL, 0, 0, NULL));
@@ -207,6 +216,7 @@ test_ping(
     GBinderRemoteRequest* req = gbinder_remote_request_new(reg, prot, 0, 0);
     GBinderLocalObject* obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
     GBinderLocalReply* reply;
+    GBinderLocalReply* reply2;
     GBinderOutputData* out_data;
     static const guint8 result[] = { 0x00, 0x00, 0x00, 0x00 };
 
@@ -229,6 +239,13 @@ test_ping(
     g_assert(out_data->bytes->len == sizeof(result));
     g_assert(!memcmp(out_data->bytes->data, result, sizeof(result)));
 
+    /* The same (cached) reply is returned next time */
+    reply2 = gbinder_local_object_handle_looper_transaction(obj, req,
+        GBINDER_PING_TRANSACTION, 0, &status);
+    g_assert(reply2 == reply);
+    g_assert(status == GBINDER_STATUS_OK);
+    gbinder_local_reply_unref(reply2);
+
     gbinder_ipc_unref(ipc);
     gbinder_local_object_unref(obj);
     gbinder_local_reply_unref(reply);
@@ -605,6 +622,258 @@ test_reply_status(
     gbinder_remote_request_unref(req);
 }
 
+/*==========================================================================*
+ * methods
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+test_methods_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    int* count = user_data;
+
+    g_assert(!g_strcmp0(gbinder_remote_request_interface(req), custom_iface));
+    *status = GBINDER_STATUS_OK;
+    (*count)++;
+    return gbinder_local_object_new_reply(obj);
+}
+
+static
+void
+test_methods(
+    void)
+{
+    static const guint8 req_data [] = { CUSTOM_INTERFACE_HEADER_BYTES };
+    static const GBinderLocalMethod methods[] = {
+        { NULL, CUSTOM_TRANSACTION, 0, test_methods_handler },
+        { custom_iface, CUSTOM_TRANSACTION + 1,
+          GBINDER_LOCAL_METHOD_FLAG_LOOPER, test_methods_handler },
+        { NULL, CUSTOM_TRANSACTION + 2,
+          GBINDER_LOCAL_METHOD_FLAG_ONEWAY, test_methods_handler }
+    };
+    static const GBinderLocalMethod bad_method = {
+        NULL, CUSTOM_TRANSACTION, 0, NULL
+    };
+    const char* const ifaces[] = { custom_iface, NULL };
+    int count = 0, status = INT_MAX;
+    const char* dev = GBINDER_DEFAULT_HWBINDER;
+    const GBinderRpcProtocol* prot = gbinder_rpc_protocol_for_device(dev);
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderRemoteRequest* req = gbinder_remote_request_new(reg, prot, 0, 0);
+    GBinderLocalObject* obj = gbinder_local_object_new(ipc, ifaces,
+        NULL, &count);
+    GBinderLocalReply* reply;
+
+    gbinder_remote_request_set_data(req, CUSTOM_TRANSACTION,
+        gbinder_buffer_new(ipc->driver, g_memdup(req_data, sizeof(req_data)),
+        sizeof(req_data), NULL));
+
+    g_assert(gbinder_local_object_add_methods(obj, NULL, 0));
+    g_assert(!gbinder_local_object_add_methods(obj, &bad_method, 1));
+    g_assert(gbinder_local_object_add_methods(obj, methods,
+        G_N_ELEMENTS(methods)));
+    g_assert(gbinder_local_object_can_handle_transaction(obj, custom_iface,
+        CUSTOM_TRANSACTION) == GBINDER_LOCAL_TRANSACTION_SUPPORTED);
+    g_assert(gbinder_local_object_can_handle_transaction(obj, custom_iface,
+        CUSTOM_TRANSACTION + 1) == GBINDER_LOCAL_TRANSACTION_LOOPER);
+    g_assert(gbinder_local_object_can_handle_transaction(obj, custom_iface,
+        CUSTOM_TRANSACTION + 3) == GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED);
+    g_assert(gbinder_local_object_can_handle_transaction(obj, base_interface,
+        CUSTOM_TRANSACTION) == GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED);
+
+    /* Regular method */
+    reply = gbinder_local_object_handle_transaction(obj, req,
+        CUSTOM_TRANSACTION, 0, &status);
+    g_assert(reply);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(count, == ,1);
+    gbinder_local_reply_unref(reply);
+
+    /* Looper method */
+    reply = gbinder_local_object_handle_looper_transaction(obj, req,
+        CUSTOM_TRANSACTION + 1, 0, &status);
+    g_assert(reply);
+    g_assert_cmpint(count, == ,2);
+    gbinder_local_reply_unref(reply);
+
+    /* One-way method rejects two-way calls without calling the handler */
+    g_assert(!gbinder_local_object_handle_transaction(obj, req,
+        CUSTOM_TRANSACTION + 2, 0, &status));
+    g_assert_cmpint(status, == ,-EBADMSG);
+    g_assert_cmpint(count, == ,2);
+    gbinder_local_reply_unref(gbinder_local_object_handle_transaction(obj,
+        req, CUSTOM_TRANSACTION + 2, GBINDER_TX_FLAG_ONEWAY, &status));
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(count, == ,3);
+
+    /* Unknown code */
+    g_assert(!gbinder_local_object_handle_transaction(obj, req,
+        CUSTOM_TRANSACTION + 3, 0, &status));
+    g_assert_cmpint(status, == ,-EBADMSG);
+    g_assert_cmpint(count, == ,3);
+
+    gbinder_ipc_unref(ipc);
+    gbinder_local_object_unref(obj);
+    gbinder_remote_request_unref(req);
+}
+
+/*==========================================================================*
+ * priority
+ *==========================================================================*/
+
+static
+void
+test_priority(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderLocalObject* obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+
+    /* Everything is NORMAL by default */
+    g_assert_cmpint(gbinder_local_object_priority(obj, CUSTOM_TRANSACTION),
+        == ,GBINDER_LOCAL_PRIORITY_NORMAL);
+
+    /* Invalid values are ignored */
+    gbinder_local_object_set_priority(obj, GBINDER_LOCAL_PRIORITY_HIGH + 1);
+    gbinder_local_object_set_code_priority(obj, CUSTOM_TRANSACTION,
+        GBINDER_LOCAL_PRIORITY_HIGH + 1);
+    g_assert_cmpint(gbinder_local_object_priority(obj, CUSTOM_TRANSACTION),
+        == ,GBINDER_LOCAL_PRIORITY_NORMAL);
+
+    /* Per-code priority overrides the object priority */
+    gbinder_local_object_set_priority(obj, GBINDER_LOCAL_PRIORITY_LOW);
+    gbinder_local_object_set_code_priority(obj, CUSTOM_TRANSACTION,
+        GBINDER_LOCAL_PRIORITY_HIGH);
+    g_assert_cmpint(gbinder_local_object_priority(obj, CUSTOM_TRANSACTION),
+        == ,GBINDER_LOCAL_PRIORITY_HIGH);
+    g_assert_cmpint(gbinder_local_object_priority(obj, CUSTOM_TRANSACTION + 1),
+        == ,GBINDER_LOCAL_PRIORITY_LOW);
+    gbinder_local_object_set_code_priority(obj, CUSTOM_TRANSACTION + 1,
+        GBINDER_LOCAL_PRIORITY_LOW);
+    g_assert_cmpint(gbinder_local_object_priority(obj, CUSTOM_TRANSACTION + 1),
+        == ,GBINDER_LOCAL_PRIORITY_LOW);
+
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * sched
+ *==========================================================================*/
+
+static
+guint32
+test_sched_flags(
+    GBinderLocalObject* obj)
+{
+    guint32 buf[GBINDER_MAX_BINDER_OBJECT_SIZE / sizeof(guint32)];
+
+    /* Flags follow the object type */
+    g_assert(gbinder_local_object_io(obj)->encode_local_object(buf, obj));
+    return buf[1];
+}
+
+static
+void
+test_sched(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderLocalObject* obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+
+    /* No hints by default */
+    g_assert(!gbinder_local_object_sched(NULL));
+    g_assert(!gbinder_local_object_sched(obj));
+    g_assert_cmphex(test_sched_flags(obj), == ,0x17f);
+    gbinder_local_object_set_inherit_rt(NULL, TRUE);
+    gbinder_local_object_set_inherit_rt(obj, FALSE);
+    g_assert(!gbinder_local_object_sched(obj));
+
+    /* Invalid values are rejected */
+    g_assert(!gbinder_local_object_set_min_sched(NULL, SCHED_FIFO, 1));
+    g_assert(!gbinder_local_object_set_min_sched(obj, SCHED_FIFO, 0));
+    g_assert(!gbinder_local_object_set_min_sched(obj, SCHED_RR, 100));
+    g_assert(!gbinder_local_object_set_min_sched(obj, SCHED_OTHER, 20));
+    g_assert(!gbinder_local_object_set_min_sched(obj, SCHED_OTHER, -21));
+    g_assert(!gbinder_local_object_set_min_sched(obj, 42, 0));
+    g_assert(!gbinder_local_object_sched(obj));
+
+    /* RT inheritance alone keeps the minimum priority as is */
+    gbinder_local_object_set_inherit_rt(obj, TRUE);
+    g_assert(gbinder_local_object_sched(obj));
+    g_assert_cmphex(test_sched_flags(obj), == ,0x97f);
+
+    /* Realtime minimum */
+    g_assert(gbinder_local_object_set_min_sched(obj, SCHED_FIFO, 10));
+    g_assert_cmphex(test_sched_flags(obj), == ,0xb0a);
+    gbinder_local_object_set_inherit_rt(obj, FALSE);
+    g_assert_cmphex(test_sched_flags(obj), == ,0x30a);
+
+    /* Negative nice value */
+    g_assert(gbinder_local_object_set_min_sched(obj, SCHED_OTHER, -10));
+    g_assert_cmphex(test_sched_flags(obj), == ,0x1f6);
+
+    gbinder_local_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * fmq_dispatch
+ *==========================================================================*/
+
+#if GBINDER_FMQ_SUPPORTED
+
+static
+void
+test_fmq_dispatch(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderLocalObject* obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+    GBinderLocalObject* obj2 = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+    const guint code = CUSTOM_TRANSACTION;
+
+    g_assert_cmpint(gbinder_local_object_can_handle_transaction(obj, NULL,
+        code), == ,GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED);
+
+    /* The queues are drained on the main thread */
+    gbinder_local_object_set_looper_dispatch(obj, TRUE);
+    gbinder_local_object_accept_fmq_channel(obj, code);
+    g_assert_cmpint(gbinder_local_object_can_handle_transaction(obj, NULL,
+        code), == ,GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED);
+    gbinder_local_object_set_looper_dispatch(obj, FALSE);
+    gbinder_local_object_set_serial_dispatch(obj, TRUE);
+    gbinder_local_object_accept_fmq_channel(obj, code);
+    g_assert_cmpint(gbinder_local_object_can_handle_transaction(obj, NULL,
+        code), == ,GBINDER_LOCAL_TRANSACTION_NOT_SUPPORTED);
+    gbinder_local_object_set_serial_dispatch(obj, FALSE);
+    gbinder_local_object_accept_fmq_channel(obj, code);
+    g_assert_cmpint(gbinder_local_object_can_handle_transaction(obj, NULL,
+        code), == ,GBINDER_LOCAL_TRANSACTION_SUPPORTED);
+
+    /* And can't be moved off it afterwards */
+    gbinder_local_object_accept_fmq_channel(obj2, code);
+    gbinder_local_object_set_looper_dispatch(obj2, TRUE);
+    gbinder_local_object_set_serial_dispatch(obj2, TRUE);
+    g_assert(!gbinder_local_object_looper_dispatch(obj2));
+    g_assert(!gbinder_local_object_serial_dispatch(obj2));
+    g_assert_cmpint(gbinder_local_object_can_handle_transaction(obj2, NULL,
+        code), == ,GBINDER_LOCAL_TRANSACTION_SUPPORTED);
+
+    gbinder_local_object_unref(obj);
+    gbinder_local_object_unref(obj2);
+    gbinder_ipc_unref(ipc);
+}
+
+#endif /* GBINDER_FMQ_SUPPORTED */
+
 /*==========================================================================*
  * increfs
  *==========================================================================*/
@@ -659,15 +928,25 @@ test_increfs(
  * decrefs
  *==========================================================================*/
 
+typedef struct test_decrefs_data {
+    GMainLoop* loop;
+    int fd;
+} TestDecrefsData;
+
 static
 void
 test_decrefs_cb(
     GBinderLocalObject* obj,
     void* user_data)
 {
+    TestDecrefsData* test = user_data;
+
     GVERBOSE_("%d", obj->weak_refs);
-    if (!obj->weak_refs) {
-        test_quit_later((GMainLoop*)user_data);
+    if (obj->weak_refs) {
+        /* Increments and decrements in one batch would cancel out */
+        test_binder_br_decrefs(test->fd, obj);
+    } else {
+        test_quit_later(test->loop);
     }
 }
 
@@ -679,24 +958,26 @@ test_decrefs_run(
     GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
     GBinderLocalObject* obj = gbinder_local_object_new
         (ipc, NULL, NULL, NULL);
-    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
-    int fd = gbinder_driver_fd(ipc->driver);
-    gulong id = gbinder_local_object_add_weak_refs_changed_handler(obj,
-        test_decrefs_cb, loop);
+    TestDecrefsData test;
+    gulong id;
+
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.fd = gbinder_driver_fd(ipc->driver);
+    id = gbinder_local_object_add_weak_refs_changed_handler(obj,
+        test_decrefs_cb, &test);
 
     /* ipc is not an object, will be ignored */
-    test_binder_br_decrefs(fd, ipc);
-    test_binder_br_increfs(fd, obj);
-    test_binder_br_decrefs(fd, obj);
-    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
-    test_run(&test_opt, loop);
+    test_binder_br_decrefs(test.fd, ipc);
+    test_binder_br_increfs(test.fd, obj);
+    test_binder_set_looper_enabled(test.fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, test.loop);
 
     g_assert(obj->weak_refs == 0);
     gbinder_local_object_remove_handler(obj, id);
     gbinder_local_object_unref(obj);
     gbinder_ipc_unref(ipc);
     gbinder_ipc_exit();
-    g_main_loop_unref(loop);
+    g_main_loop_unref(test.loop);
 }
 
 static
@@ -808,6 +1089,96 @@ test_release(
     test_run_in_context(&test_opt, test_release_run);
 }
 
+/*==========================================================================*
+ * callback
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+test_callback_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    *status = GBINDER_STATUS_OK;
+    return NULL;
+}
+
+static
+void
+test_callback_freed(
+    gpointer data,
+    GObject* obj)
+{
+    GVERBOSE_("%p", obj);
+    (*(int*)data)++;
+}
+
+static
+void
+test_callback_gone(
+    gpointer loop,
+    GObject* obj)
+{
+    GVERBOSE_("%p", obj);
+    test_quit_later((GMainLoop*)loop);
+}
+
+static
+void
+test_callback_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    int fd = gbinder_driver_fd(ipc->driver);
+    GBinderLocalObject* obj;
+    int freed = 0;
+
+    g_assert(!gbinder_local_object_new_callback(NULL, NULL,
+        test_callback_handler, NULL));
+    g_assert(!gbinder_local_object_new_callback(ipc, NULL, NULL, NULL));
+
+    /* The one which has never been sent anywhere is freed by drop */
+    obj = gbinder_local_object_new_callback(ipc, "foo",
+        test_callback_handler, NULL);
+    g_assert(obj);
+    g_assert_cmpstr(obj->ifaces[0], == ,"foo");
+    g_object_weak_ref(G_OBJECT(obj), test_callback_freed, &freed);
+    gbinder_local_object_ref(obj);
+    gbinder_local_object_unref(obj);
+    g_assert_cmpint(freed, == ,0);
+    gbinder_local_object_drop(obj);
+    g_assert_cmpint(freed, == ,1);
+
+    /* This one goes away when the kernel is done with it */
+    obj = gbinder_local_object_new_callback(ipc, "foo",
+        test_callback_handler, NULL);
+    g_object_weak_ref(G_OBJECT(obj), test_callback_gone, loop);
+    test_binder_br_increfs(fd, obj);
+    test_binder_br_acquire(fd, obj);
+    test_binder_br_release(fd, obj);
+    test_binder_br_decrefs(fd, obj);
+    gbinder_local_object_unref(obj);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, loop);
+
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_callback(
+    void)
+{
+    test_run_in_context(&test_opt, test_callback_run);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -841,10 +1212,17 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_PREFIX "descriptor_chain", test_descriptor_chain);
     g_test_add_func(TEST_PREFIX "custom_iface", test_custom_iface);
     g_test_add_func(TEST_PREFIX "reply_status", test_reply_status);
+    g_test_add_func(TEST_PREFIX "methods", test_methods);
+    g_test_add_func(TEST_PREFIX "priority", test_priority);
+    g_test_add_func(TEST_PREFIX "sched", test_sched);
+#if GBINDER_FMQ_SUPPORTED
+    g_test_add_func(TEST_PREFIX "fmq_dispatch", test_fmq_dispatch);
+#endif
     g_test_add_func(TEST_PREFIX "increfs", test_increfs);
     g_test_add_func(TEST_PREFIX "decrefs", test_decrefs);
     g_test_add_func(TEST_PREFIX "acquire", test_acquire);
     g_test_add_func(TEST_PREFIX "release", test_release);
+    g_test_add_func(TEST_PREFIX "callback", test_callback);
     test_init(&test_opt, argc, argv);
     result = g_test_run();
 
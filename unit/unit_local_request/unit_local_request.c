@@ -37,7 +37,7 @@
 #include "gbinder_output_data.h"
 #include "gbinder_buffer_p.h"
 #include "gbinder_driver.h"
-#include "gbinder_writer.h"
+#include "gbinder_writer_p.h"
 #include "gbinder_io.h"
 
 #include <gutil_intarray.h>
@@ -137,6 +137,31 @@ test_cleanup(
     g_assert(count == 2);
 }
 
+/*==========================================================================*
+ * trace_id
+ *==========================================================================*/
+
+static
+void
+test_trace_id(
+    void)
+{
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    const guint64 id = G_GUINT64_CONSTANT(0x123456789abcdef0);
+
+    gbinder_local_request_set_trace_id(NULL, id);
+    g_assert(!gbinder_local_request_trace_id(NULL));
+
+    /* Zero by default, which means generate a new one */
+    g_assert(!gbinder_local_request_trace_id(req));
+    gbinder_local_request_set_trace_id(req, id);
+    g_assert(gbinder_local_request_trace_id(req) == id);
+    gbinder_local_request_set_trace_id(req, 0);
+    g_assert(!gbinder_local_request_trace_id(req));
+
+    gbinder_local_request_unref(req);
+}
+
 /*==========================================================================*
  * init_data
  *==========================================================================*/
@@ -583,6 +608,107 @@ test_remote_request_obj(
     gbinder_driver_unref(driver);
 }
 
+/*==========================================================================*
+ * copy
+ *==========================================================================*/
+
+static
+void
+test_copy(
+    void)
+{
+    static const guint8 header[] = { 0x01, 0x02, 0x03, 0x04 };
+    GBytes* init = g_bytes_new_static(header, sizeof(header));
+    GBinderLocalRequest* tmpl = gbinder_local_request_new(&gbinder_io_32,
+        init);
+    GBinderLocalRequest* req;
+    GBinderOutputData* data;
+    GUtilIntArray* offsets;
+    GBinderWriter writer;
+
+    g_assert(!gbinder_local_request_copy(NULL));
+
+    /* Plain data */
+    gbinder_local_request_append_int32(tmpl, 42);
+    req = gbinder_local_request_copy(tmpl);
+    g_assert(req);
+    gbinder_local_request_append_int32(req, 1);
+    data = gbinder_local_request_data(req);
+    g_assert_cmpuint(data->bytes->len, == ,12);
+    g_assert(!memcmp(data->bytes->data, header, sizeof(header)));
+    g_assert_cmpuint(*(guint32*)(data->bytes->data + 4), == ,42);
+    g_assert_cmpuint(*(guint32*)(data->bytes->data + 8), == ,1);
+    g_assert(!gbinder_output_data_offsets(data));
+    /* The template is unaffected */
+    g_assert_cmpuint(gbinder_local_request_data(tmpl)->bytes->len, == ,8);
+    gbinder_local_request_unref(req);
+
+    /* Objects get copied too */
+    gbinder_local_request_append_local_object(tmpl, NULL);
+    req = gbinder_local_request_copy(tmpl);
+    g_assert(req);
+    data = gbinder_local_request_data(req);
+    offsets = gbinder_output_data_offsets(data);
+    g_assert(offsets);
+    g_assert_cmpuint(offsets->count, == ,1);
+    g_assert_cmpuint(offsets->data[0], == ,8);
+    g_assert_cmpuint(data->bytes->len, == ,
+        gbinder_local_request_data(tmpl)->bytes->len);
+    gbinder_local_request_unref(req);
+
+    /* But not buffers */
+    gbinder_local_request_init_writer(tmpl, &writer);
+    gbinder_writer_append_hidl_string(&writer, "foo");
+    g_assert(!gbinder_local_request_copy(tmpl));
+
+    gbinder_local_request_unref(tmpl);
+    g_bytes_unref(init);
+}
+
+/*==========================================================================*
+ * pool
+ *==========================================================================*/
+
+static
+void
+test_pool(
+    void)
+{
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    GBinderOutputData* data = gbinder_local_request_data(req);
+    GByteArray* bytes = data->bytes;
+    int count = 0;
+
+    gbinder_writer_pool_set_size(1024);
+    g_assert_cmpuint(gbinder_writer_pool_count(), == ,0);
+    gbinder_local_request_append_int32(req, 0);
+    gbinder_local_request_cleanup(req, test_int_inc, &count);
+    gbinder_local_request_unref(req);
+    g_assert_cmpint(count, == ,1);
+    g_assert_cmpuint(gbinder_writer_pool_count(), == ,1);
+
+    /* The buffer gets reused, empty */
+    req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    data = gbinder_local_request_data(req);
+    g_assert(data->bytes == bytes);
+    g_assert_cmpuint(data->bytes->len, == ,0);
+    g_assert(!gbinder_output_data_offsets(data));
+    g_assert_cmpuint(gbinder_writer_pool_count(), == ,0);
+    gbinder_local_request_unref(req);
+    g_assert_cmpint(count, == ,1);
+
+    /* This one is too big for the pool */
+    req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    gbinder_local_request_append_string8(req, NULL);
+    g_byte_array_set_size(gbinder_local_request_data(req)->bytes, 2048);
+    gbinder_local_request_unref(req);
+    g_assert_cmpuint(gbinder_writer_pool_count(), == ,1);
+
+    /* Shrinking the pool frees the buffers */
+    gbinder_writer_pool_set_size(0);
+    g_assert_cmpuint(gbinder_writer_pool_count(), == ,0);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -594,6 +720,7 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_PREFIX "null", test_null);
     g_test_add_func(TEST_PREFIX "cleanup", test_cleanup);
+    g_test_add_func(TEST_PREFIX "trace_id", test_trace_id);
     g_test_add_func(TEST_PREFIX "init_data", test_init_data);
     g_test_add_func(TEST_PREFIX "bool", test_bool);
     g_test_add_func(TEST_PREFIX "int32", test_int32);
@@ -608,6 +735,8 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_PREFIX "remote_object", test_remote_object);
     g_test_add_func(TEST_PREFIX "remote_request", test_remote_request);
     g_test_add_func(TEST_PREFIX "remote_request_obj", test_remote_request_obj);
+    g_test_add_func(TEST_PREFIX "copy", test_copy);
+    g_test_add_func(TEST_PREFIX "pool", test_pool);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
@@ -35,6 +35,7 @@
 #include "gbinder_log.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 static TestOpt test_opt;
 
@@ -103,6 +104,40 @@ test_level(
     g_assert_cmpint(GLOG_MODULE_NAME.level, == ,test->level);
 }
 
+/*==========================================================================*
+ * ratelimit
+ *==========================================================================*/
+
+static
+void
+test_ratelimit(
+    void)
+{
+    GBinderLogRateLimit rl;
+    guint suppressed = 0;
+    int i;
+
+    memset(&rl, 0, sizeof(rl));
+    for (i = 0; i < GBINDER_LOG_RATELIMIT_BURST; i++) {
+        g_assert(gbinder_log_ratelimit(&rl, &suppressed));
+        g_assert_cmpuint(suppressed, == ,0);
+    }
+
+    /* The rest gets suppressed until the interval expires */
+    g_assert(!gbinder_log_ratelimit(&rl, &suppressed));
+    g_assert(!gbinder_log_ratelimit(&rl, &suppressed));
+    rl.start -= (gint64)GBINDER_LOG_RATELIMIT_INTERVAL_MS * 1000;
+    g_assert(gbinder_log_ratelimit(&rl, &suppressed));
+    g_assert_cmpuint(suppressed, == ,2);
+    g_assert(gbinder_log_ratelimit(&rl, &suppressed));
+    g_assert_cmpuint(suppressed, == ,0);
+
+    /* Exercise the macro too */
+    for (i = 0; i <= GBINDER_LOG_RATELIMIT_BURST; i++) {
+        GWARN_RATELIMITED("Test %d", i);
+    }
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -129,6 +164,7 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_("empty"), test_empty);
     g_test_add_func(TEST_("invalid"), test_invalid);
+    g_test_add_func(TEST_("ratelimit"), test_ratelimit);
     for (i = 0; i < G_N_ELEMENTS(level_tests); i++) {
         g_test_add_data_func(level_tests[i].test_name, level_tests + i,
             test_level);
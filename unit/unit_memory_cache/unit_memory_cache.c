@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "test_common.h"
+
+#include "gbinder_memory_cache.h"
+
+#include <gutil_log.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+static TestOpt test_opt;
+
+static
+int
+test_memory_fd(
+    char** path,
+    gsize size)
+{
+    const int fd = g_file_open_tmp(NULL, path, NULL);
+    guint8* data = g_malloc(size);
+    gsize i;
+
+    g_assert(fd >= 0);
+    for (i = 0; i < size; i++) {
+        data[i] = (guint8)i;
+    }
+    g_assert(write(fd, data, size) == (gssize)size);
+    g_free(data);
+    return fd;
+}
+
+static
+void
+test_memory_fd_close(
+    int fd,
+    char* path)
+{
+    close(fd);
+    unlink(path);
+    g_free(path);
+}
+
+/*==========================================================================*
+ * null
+ *==========================================================================*/
+
+static
+void
+test_null(
+    void)
+{
+    g_assert(!gbinder_memory_cache_ref(NULL));
+    gbinder_memory_cache_unref(NULL);
+    gbinder_memory_cache_set_max_idle(NULL, 1);
+    g_assert(!gbinder_memory_cache_count(NULL));
+}
+
+/*==========================================================================*
+ * uncached
+ *==========================================================================*/
+
+static
+void
+test_uncached(
+    void)
+{
+    char* path = NULL;
+    const int fd = test_memory_fd(&path, 16);
+    GBytes* b1 = gbinder_memory_cache_map(NULL, fd, 16);
+    GBytes* b2 = gbinder_memory_cache_map(NULL, fd, 8);
+    gsize size = 0;
+    const guint8* data;
+
+    g_assert(b1);
+    g_assert(b2);
+    data = g_bytes_get_data(b2, &size);
+    g_assert_cmpuint(size, == ,8);
+    g_assert_cmpuint(data[7], == ,7);
+    /* Each one is a separate mapping */
+    g_assert(data != g_bytes_get_data(b1, NULL));
+
+    /* Zero size and too large */
+    g_assert(!gbinder_memory_cache_map(NULL, fd, 0));
+    g_assert(!gbinder_memory_cache_map(NULL, fd, 17));
+    g_assert(!gbinder_memory_cache_map(NULL, -1, 1));
+
+    g_bytes_unref(b1);
+    g_bytes_unref(b2);
+    test_memory_fd_close(fd, path);
+}
+
+/*==========================================================================*
+ * shared
+ *==========================================================================*/
+
+static
+void
+test_shared(
+    void)
+{
+    char* path = NULL;
+    const int fd = test_memory_fd(&path, 16);
+    const int fd2 = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    GBinderMemoryCache* cache = gbinder_memory_cache_new(0);
+    GBytes* b1 = gbinder_memory_cache_map(cache, fd, 16);
+    GBytes* b2;
+
+    /* Another descriptor referring to the same file shares the mapping */
+    g_assert(b1);
+    b2 = gbinder_memory_cache_map(cache, fd2, 8);
+    g_assert(b2);
+    g_assert(g_bytes_get_data(b1, NULL) == g_bytes_get_data(b2, NULL));
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,1);
+
+    /* Views outlive the cache and nothing is kept when idle */
+    gbinder_memory_cache_unref(cache);
+    g_bytes_unref(b1);
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,1);
+    g_bytes_unref(b2);
+
+    close(fd2);
+    test_memory_fd_close(fd, path);
+}
+
+/*==========================================================================*
+ * idle
+ *==========================================================================*/
+
+static
+void
+test_idle(
+    void)
+{
+    char* path1 = NULL;
+    char* path2 = NULL;
+    const int fd1 = test_memory_fd(&path1, 16);
+    const int fd2 = test_memory_fd(&path2, 16);
+    GBinderMemoryCache* cache = gbinder_memory_cache_new(1);
+    GBytes* b1 = gbinder_memory_cache_map(cache, fd1, 16);
+    GBytes* b2 = gbinder_memory_cache_map(cache, fd2, 16);
+    const void* ptr1 = g_bytes_get_data(b1, NULL);
+
+    g_assert(b1);
+    g_assert(b2);
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,2);
+
+    /* One idle mapping is kept */
+    g_bytes_unref(b1);
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,2);
+    b1 = gbinder_memory_cache_map(cache, fd1, 16);
+    g_assert(g_bytes_get_data(b1, NULL) == ptr1);
+
+    /* The least recently released one gets dropped */
+    g_bytes_unref(b1);
+    g_bytes_unref(b2);
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,1);
+    gbinder_memory_cache_set_max_idle(cache, 0);
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,0);
+
+    /* Idle mappings are released together with the cache */
+    gbinder_memory_cache_set_max_idle(cache, 2);
+    g_bytes_unref(gbinder_memory_cache_map(cache, fd1, 16));
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,1);
+    gbinder_memory_cache_unref(cache);
+
+    test_memory_fd_close(fd1, path1);
+    test_memory_fd_close(fd2, path2);
+}
+
+/*==========================================================================*
+ * grow
+ *==========================================================================*/
+
+static
+void
+test_grow(
+    void)
+{
+    char* path = NULL;
+    const int fd = test_memory_fd(&path, 16);
+    GBinderMemoryCache* cache = gbinder_memory_cache_new(1);
+    GBytes* b1 = gbinder_memory_cache_map(cache, fd, 8);
+    GBytes* b2 = gbinder_memory_cache_map(cache, fd, 16);
+    GBytes* b3;
+    gsize size = 0;
+
+    /* The short mapping is replaced but stays valid */
+    g_assert(b1);
+    g_assert(b2);
+    g_assert(g_bytes_get_data(b1, NULL) != g_bytes_get_data(b2, NULL));
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,1);
+    g_bytes_unref(b1);
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,1);
+
+    /* Smaller views share the longer mapping */
+    b3 = gbinder_memory_cache_map(cache, fd, 4);
+    g_assert(g_bytes_get_data(b3, &size) == g_bytes_get_data(b2, NULL));
+    g_assert_cmpuint(size, == ,4);
+    g_bytes_unref(b2);
+    g_bytes_unref(b3);
+
+    /* Idle entry gets replaced too */
+    g_assert(ftruncate(fd, 32) == 0);
+    b1 = gbinder_memory_cache_map(cache, fd, 32);
+    g_assert(b1);
+    g_assert_cmpuint(gbinder_memory_cache_count(cache), == ,1);
+    g_bytes_unref(b1);
+
+    gbinder_memory_cache_unref(cache);
+    test_memory_fd_close(fd, path);
+}
+
+/*==========================================================================*
+ * Common
+ *==========================================================================*/
+
+#define TEST_PREFIX "/memory_cache/"
+#define TEST_(t) TEST_PREFIX t
+
+int main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func(TEST_("null"), test_null);
+    g_test_add_func(TEST_("uncached"), test_uncached);
+    g_test_add_func(TEST_("shared"), test_shared);
+    g_test_add_func(TEST_("idle"), test_idle);
+    g_test_add_func(TEST_("grow"), test_grow);
+    test_init(&test_opt, argc, argv);
+    return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -183,8 +183,8 @@ test_basic_reply(
 
 static
 void
-test_basic_run(
-    void)
+test_basic_common(
+    gboolean looper)
 {
     TestConfig config;
     GBinderLocalObject* obj;
@@ -210,6 +210,7 @@ test_basic_run(
     /* remote_proxy(DEV_PRIV) => proxy (DEV) => obj (DEV) => DEV_PRIV */
     g_assert(!gbinder_proxy_object_new(NULL, remote_obj));
     g_assert((proxy = gbinder_proxy_object_new(ipc_proxy, remote_obj)));
+    gbinder_local_object_set_looper_dispatch(&proxy->parent, looper);
     remote_proxy = gbinder_remote_object_new(ipc_obj,
         test_binder_register_object(fd_proxy, &proxy->parent, AUTO_HANDLE),
         REMOTE_OBJECT_CREATE_ALIVE);
@@ -242,6 +243,14 @@ test_basic_run(
     g_main_loop_unref(loop);
 }
 
+static
+void
+test_basic_run(
+    void)
+{
+    test_basic_common(FALSE);
+}
+
 static
 void
 test_basic(
@@ -250,6 +259,145 @@ test_basic(
     test_run_in_context(&test_opt, test_basic_run);
 }
 
+/*==========================================================================*
+ * looper
+ *==========================================================================*/
+
+static
+void
+test_looper_run(
+    void)
+{
+    /* Forwarded synchronously by the looper thread */
+    test_basic_common(TRUE);
+}
+
+static
+void
+test_looper(
+    void)
+{
+    test_run_in_context(&test_opt, test_looper_run);
+}
+
+/*==========================================================================*
+ * oneway
+ *==========================================================================*/
+
+#define TEST_ONEWAY_COUNT (10)
+
+typedef struct test_oneway {
+    GMainLoop* loop;
+    int count;
+} TestOneway;
+
+static
+GBinderLocalReply*
+test_oneway_cb(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestOneway* test = user_data;
+    GBinderReader reader;
+    gint32 param = -1;
+
+    g_assert(flags & GBINDER_TX_FLAG_ONEWAY);
+    g_assert(code == TX_CODE);
+
+    /* Calls must arrive in the order in which they have been made */
+    gbinder_remote_request_init_reader(req, &reader);
+    g_assert(gbinder_reader_read_int32(&reader, &param));
+    g_assert(gbinder_reader_at_end(&reader));
+    g_assert_cmpint(param, == ,test->count);
+    GDEBUG("One-way call #%d handled", param);
+    if (++test->count == TEST_ONEWAY_COUNT) {
+        g_main_loop_quit(test->loop);
+    }
+    *status = GBINDER_STATUS_OK;
+    return NULL;
+}
+
+static
+void
+test_oneway_run(
+    void)
+{
+    TestConfig config;
+    TestOneway test;
+    GBinderLocalObject* obj;
+    GBinderProxyObject* proxy;
+    GBinderRemoteObject* remote_obj;
+    GBinderRemoteObject* remote_proxy;
+    GBinderClient* proxy_client;
+    GBinderIpc* ipc_obj;
+    GBinderIpc* ipc_proxy;
+    int fd_obj, fd_proxy, i;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test_config_init(&config, NULL);
+    ipc_proxy = gbinder_ipc_new(DEV, NULL);
+    ipc_obj = gbinder_ipc_new(DEV_PRIV, NULL);
+    fd_proxy = gbinder_driver_fd(ipc_proxy->driver);
+    fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    obj = gbinder_local_object_new(ipc_obj, TEST_IFACES, test_oneway_cb,
+        &test);
+    remote_obj = gbinder_remote_object_new(ipc_proxy,
+        test_binder_register_object(fd_obj, obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+
+    /* remote_proxy(DEV_PRIV) => proxy (DEV) => obj (DEV) => DEV_PRIV */
+    g_assert((proxy = gbinder_proxy_object_new(ipc_proxy, remote_obj)));
+    remote_proxy = gbinder_remote_object_new(ipc_obj,
+        test_binder_register_object(fd_proxy, &proxy->parent, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    proxy_client = gbinder_client_new(remote_proxy, TEST_IFACE);
+
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_passthrough(fd_proxy, TRUE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_proxy, TEST_LOOPER_ENABLE);
+
+    /* Fire a bunch of one-way calls via proxy */
+    for (i = 0; i < TEST_ONEWAY_COUNT; i++) {
+        GBinderLocalRequest* req = gbinder_client_new_request(proxy_client);
+
+        gbinder_local_request_append_int32(req, i);
+        g_assert(gbinder_client_transact(proxy_client, TX_CODE,
+            GBINDER_TX_FLAG_ONEWAY, req, NULL, NULL, NULL));
+        gbinder_local_request_unref(req);
+    }
+
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.count, == ,TEST_ONEWAY_COUNT);
+
+    test_binder_unregister_objects(fd_obj);
+    test_binder_unregister_objects(fd_proxy);
+    gbinder_local_object_drop(obj);
+    gbinder_local_object_drop(&proxy->parent);
+    gbinder_remote_object_unref(remote_obj);
+    gbinder_remote_object_unref(remote_proxy);
+    gbinder_client_unref(proxy_client);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc_proxy);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    test_config_deinit(&config);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_oneway(
+    void)
+{
+    test_run_in_context(&test_opt, test_oneway_run);
+}
+
 /*==========================================================================*
  * param
  *==========================================================================*/
@@ -694,6 +842,192 @@ test_obj(
     test_run_in_context(&test_opt, test_obj_run);
 }
 
+/*==========================================================================*
+ * obj_cache
+ *==========================================================================*/
+
+typedef struct test_obj_cache {
+    GMainLoop* loop;
+    GBinderLocalObject* ret;
+    GBinderLocalObject* last;
+    int fd;
+} TestObjCache;
+
+static
+GBinderLocalReply*
+test_obj_cache_cb(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    TestObjCache* test = user_data;
+
+    /* Always return the same object */
+    GDEBUG("Request handled");
+    *status = GBINDER_STATUS_OK;
+    return gbinder_local_reply_append_local_object
+        (gbinder_local_object_new_reply(obj), test->ret);
+}
+
+static
+void
+test_obj_cache_reply(
+    GBinderClient* client,
+    GBinderRemoteReply* reply,
+    int status,
+    void* data)
+{
+    TestObjCache* test = data;
+    GBinderRemoteObject* obj;
+    GBinderReader reader;
+
+    GDEBUG("Reply received");
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    gbinder_remote_reply_init_reader(reply, &reader);
+    g_assert((obj = gbinder_reader_read_object(&reader)));
+    g_assert(gbinder_reader_at_end(&reader));
+
+    /* Remember the proxy which has been created for the returned object */
+    g_assert(!test->last);
+    test->last = test_binder_object(test->fd, obj->handle);
+    g_assert(G_TYPE_CHECK_INSTANCE_TYPE(test->last,
+        GBINDER_TYPE_PROXY_OBJECT));
+    gbinder_remote_object_unref(obj);
+    g_main_loop_quit(test->loop);
+}
+
+static
+void
+test_obj_cache_dead(
+    GBinderRemoteObject* obj,
+    void* data)
+{
+    TestObjCache* test = data;
+
+    GDEBUG("Remote object %u is dead", obj->handle);
+    test_quit_later(test->loop);
+}
+
+static
+GBinderProxyObject*
+test_obj_cache_call(
+    TestObjCache* test,
+    GBinderClient* client)
+{
+    GBinderLocalObject* proxy;
+
+    g_assert(gbinder_client_transact(client, TX_CODE, 0, NULL,
+        test_obj_cache_reply, NULL, test));
+    test_run(&test_opt, test->loop);
+    proxy = test->last;
+    test->last = NULL;
+    return GBINDER_PROXY_OBJECT(proxy);
+}
+
+static
+void
+test_obj_cache_run(
+    void)
+{
+    TestConfig config;
+    TestObjCache test;
+    GBinderLocalObject* obj;
+    GBinderProxyObject* proxy;
+    GBinderProxyObject* proxy1;
+    GBinderProxyObject* proxy2;
+    GBinderProxyObject* proxy3;
+    GBinderRemoteObject* remote_obj;
+    GBinderRemoteObject* remote_proxy;
+    GBinderClient* proxy_client;
+    GBinderIpc* ipc_obj;
+    GBinderIpc* ipc_proxy;
+    gpointer weak;
+    gulong id;
+    int fd_obj, fd_proxy;
+
+    test_config_init(&config, NULL);
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+
+    ipc_proxy = gbinder_ipc_new(DEV, NULL);
+    ipc_obj = gbinder_ipc_new(DEV_PRIV, NULL);
+    fd_proxy = gbinder_driver_fd(ipc_proxy->driver);
+    fd_obj = gbinder_driver_fd(ipc_obj->driver);
+    test.fd = fd_obj;
+    test.ret = gbinder_local_object_new(ipc_obj, TEST_IFACES2, NULL, NULL);
+    obj = gbinder_local_object_new(ipc_obj, TEST_IFACES, test_obj_cache_cb,
+        &test);
+    remote_obj = gbinder_remote_object_new(ipc_proxy,
+        test_binder_register_object(fd_obj, obj, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+
+    /* remote_proxy(DEV_PRIV) => proxy (DEV) => obj (DEV) => DEV_PRIV */
+    g_assert((proxy = gbinder_proxy_object_new(ipc_proxy, remote_obj)));
+    remote_proxy = gbinder_remote_object_new(ipc_obj,
+        test_binder_register_object(fd_proxy, &proxy->parent, AUTO_HANDLE),
+        REMOTE_OBJECT_CREATE_ALIVE);
+    proxy_client = gbinder_client_new(remote_proxy, TEST_IFACE);
+
+    test_binder_set_passthrough(fd_obj, TRUE);
+    test_binder_set_passthrough(fd_proxy, TRUE);
+    test_binder_set_looper_enabled(fd_obj, TEST_LOOPER_ENABLE);
+    test_binder_set_looper_enabled(fd_proxy, TEST_LOOPER_ENABLE);
+
+    /* The second reply finds the proxy in the cache */
+    proxy1 = test_obj_cache_call(&test, proxy_client);
+    g_assert(proxy1 != proxy);
+    proxy2 = test_obj_cache_call(&test, proxy_client);
+    g_assert(proxy2 == proxy1);
+    gbinder_local_object_unref(&proxy2->parent);
+
+    /* The cached proxy can't be reused once its remote is dead */
+    id = gbinder_remote_object_add_death_handler(proxy1->remote,
+        test_obj_cache_dead, &test);
+    test_binder_br_dead_binder(fd_proxy, proxy1->remote->handle);
+    test_run(&test_opt, test.loop);
+    g_assert(proxy1->remote->dead);
+    gbinder_remote_object_remove_handler(proxy1->remote, id);
+    proxy2 = test_obj_cache_call(&test, proxy_client);
+    g_assert(proxy2 != proxy1);
+    g_assert(!proxy2->remote->dead);
+
+    /* Releasing the old proxy leaves the new one in the cache */
+    weak = proxy1;
+    g_object_add_weak_pointer(G_OBJECT(proxy1), &weak);
+    gbinder_local_object_unref(&proxy1->parent);
+    proxy3 = test_obj_cache_call(&test, proxy_client);
+    g_assert(proxy3 == proxy2);
+    g_assert(!weak);
+    gbinder_local_object_unref(&proxy3->parent);
+    gbinder_local_object_unref(&proxy2->parent);
+
+    test_binder_unregister_objects(fd_obj);
+    test_binder_unregister_objects(fd_proxy);
+    gbinder_local_object_drop(obj);
+    gbinder_local_object_drop(test.ret);
+    gbinder_local_object_drop(&proxy->parent);
+    gbinder_remote_object_unref(remote_obj);
+    gbinder_remote_object_unref(remote_proxy);
+    gbinder_client_unref(proxy_client);
+    gbinder_ipc_unref(ipc_obj);
+    gbinder_ipc_unref(ipc_proxy);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, test.loop);
+    test_config_deinit(&config);
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_obj_cache(
+    void)
+{
+    test_run_in_context(&test_opt, test_obj_cache_run);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -708,8 +1042,11 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_("null"), test_null);
     g_test_add_func(TEST_("basic"), test_basic);
+    g_test_add_func(TEST_("looper"), test_looper);
+    g_test_add_func(TEST_("oneway"), test_oneway);
     g_test_add_func(TEST_("param"), test_param);
     g_test_add_func(TEST_("obj"), test_obj);
+    g_test_add_func(TEST_("obj_cache"), test_obj_cache);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
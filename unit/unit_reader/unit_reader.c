@@ -31,18 +31,27 @@
  */
 
 #include "test_common.h"
+#include "test_alloc.h"
 
 #include "gbinder_buffer_p.h"
 #include "gbinder_driver.h"
+#include "gbinder_fmq_p.h"
 #include "gbinder_ipc.h"
+#include "gbinder_local_object.h"
+#include "gbinder_local_request_p.h"
+#include "gbinder_output_data.h"
 #include "gbinder_reader_p.h"
 #include "gbinder_remote_object_p.h"
+#include "gbinder_writer.h"
 #include "gbinder_io.h"
 
+#include <gutil_intarray.h>
+
 #include <gutil_misc.h>
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 
 static TestOpt test_opt;
 
@@ -59,6 +68,7 @@ typedef struct binder_buffer_object_64 {
 } BinderObject64;
 
 #define BINDER_TYPE_(c1,c2,c3) GBINDER_FOURCC(c1,c2,c3,0x85)
+#define BINDER_TYPE_BINDER BINDER_TYPE_('s','b','*')
 #define BINDER_TYPE_HANDLE BINDER_TYPE_('s','h','*')
 #define BINDER_TYPE_PTR BINDER_TYPE_('p','t','*')
 #define BINDER_TYPE_FD BINDER_TYPE_('f', 'd', '*')
@@ -145,12 +155,20 @@ test_empty(
     g_assert(!elemsize);
     g_assert(!gbinder_reader_skip_hidl_string(&reader));
     g_assert(!gbinder_reader_read_hidl_string(&reader));
+    g_assert(!gbinder_reader_read_hidl_string_len(&reader, NULL));
+    size = 1;
+    g_assert(!gbinder_reader_read_hidl_string_len(&reader, &size));
+    g_assert(!size);
     g_assert(!gbinder_reader_read_hidl_string_vec(&reader));
     g_assert(!gbinder_reader_skip_buffer(&reader));
     g_assert(!gbinder_reader_read_string8(&reader));
     g_assert(!gbinder_reader_read_string16(&reader));
     g_assert(!gbinder_reader_skip_string16(&reader));
     g_assert(!gbinder_reader_read_byte_array(&reader, &size));
+    g_assert(!gbinder_reader_read_int32_array(&reader, &size));
+    g_assert(!gbinder_reader_read_int64_array(&reader, &size));
+    g_assert(!gbinder_reader_read_float_array(&reader, &size));
+    g_assert(!gbinder_reader_read_double_array(&reader, &size));
 }
 
 /*==========================================================================*
@@ -493,6 +511,109 @@ test_double(
     gbinder_driver_unref(driver);
 }
 
+/*==========================================================================*
+ * cursor
+ *==========================================================================*/
+
+static
+void
+test_cursor(
+    void)
+{
+    const guint8 in[] = {
+        TEST_INT32_BYTES(1),
+        TEST_INT32_BYTES(0xfffe),
+        TEST_INT32_BYTES(-3),
+        TEST_INT64_BYTES(G_GINT64_CONSTANT(0x123456789)),
+        TEST_INT32_BYTES(0x7f),
+        TEST_INT32_BYTES(42)
+    };
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderReaderCursor cursor;
+    GBinderReader reader;
+    GBinderReaderData data;
+    guint32 last = 0;
+
+    g_assert(driver);
+    memset(&data, 0, sizeof(data));
+    data.buffer = gbinder_buffer_new(driver, g_memdup(in, sizeof(in)),
+        sizeof(in), NULL);
+
+    /* Asking for too much */
+    gbinder_reader_init(&reader, &data, 0, sizeof(in));
+    g_assert(!gbinder_reader_cursor_begin(&reader, sizeof(in) + 1, &cursor));
+    g_assert(!gbinder_reader_cursor_end(&reader, &cursor));
+    g_assert_cmpuint(gbinder_reader_bytes_read(&reader), == ,0);
+
+    /* All but the last one */
+    g_assert(gbinder_reader_cursor_begin(&reader, sizeof(in) - 4, &cursor));
+    g_assert(gbinder_reader_cursor_bool(&cursor));
+    g_assert_cmpuint(gbinder_reader_cursor_uint16(&cursor), == ,0xfffe);
+    g_assert_cmpint(gbinder_reader_cursor_int32(&cursor), == ,-3);
+    g_assert_cmpint(gbinder_reader_cursor_int64(&cursor), == ,
+        G_GINT64_CONSTANT(0x123456789));
+    g_assert_cmpuint(gbinder_reader_cursor_uint8(&cursor), == ,0x7f);
+    g_assert(gbinder_reader_cursor_end(&reader, &cursor));
+    g_assert(gbinder_reader_read_uint32(&reader, &last));
+    g_assert_cmpuint(last, == ,42);
+    g_assert(gbinder_reader_at_end(&reader));
+
+    /* Overrun leaves the reader where it was */
+    gbinder_reader_init(&reader, &data, 0, sizeof(in));
+    g_assert(gbinder_reader_cursor_begin(&reader, 4, &cursor));
+    gbinder_reader_cursor_skip(&cursor, 8);
+    g_assert(!gbinder_reader_cursor_end(&reader, &cursor));
+    g_assert_cmpuint(gbinder_reader_bytes_read(&reader), == ,0);
+
+    gbinder_buffer_free(data.buffer);
+    gbinder_driver_unref(driver);
+}
+
+/*==========================================================================*
+ * inline
+ *==========================================================================*/
+
+static
+void
+test_inline(
+    void)
+{
+    const guint8 in[] = {
+        TEST_INT32_BYTES(-1),
+        TEST_INT64_BYTES(G_GINT64_CONSTANT(0x123456789)),
+        TEST_INT32_BYTES(2)
+    };
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderReader reader;
+    GBinderReaderData data;
+    gint32 i32 = 0;
+    guint32 u32 = 0;
+    gint64 i64 = 0;
+    gdouble d = 0;
+
+    g_assert(driver);
+    memset(&data, 0, sizeof(data));
+    data.buffer = gbinder_buffer_new(driver, g_memdup(in, sizeof(in)),
+        sizeof(in), NULL);
+
+    gbinder_reader_init(&reader, &data, 0, sizeof(in));
+    g_assert(gbinder_reader_read_int32_inline(&reader, &i32));
+    g_assert_cmpint(i32, == ,-1);
+    g_assert(gbinder_reader_read_int64_inline(&reader, &i64));
+    g_assert_cmpint(i64, == ,G_GINT64_CONSTANT(0x123456789));
+    g_assert_cmpuint(gbinder_reader_bytes_read(&reader), == ,12);
+
+    /* Not enough data for a double, the slow path fails */
+    g_assert(!gbinder_reader_read_double_inline(&reader, &d));
+    g_assert(gbinder_reader_read_uint32_inline(&reader, &u32));
+    g_assert_cmpuint(u32, == ,2);
+    g_assert(gbinder_reader_at_end(&reader));
+    g_assert(!gbinder_reader_read_uint32_inline(&reader, &u32));
+
+    gbinder_buffer_free(data.buffer);
+    gbinder_driver_unref(driver);
+}
+
 /*==========================================================================*
  * string8
  *==========================================================================*/
@@ -646,6 +767,14 @@ test_string16_null(
     g_assert(gbinder_reader_skip_string16(&reader));
     g_assert(gbinder_reader_at_end(&reader));
 
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_null));
+    g_assert(gbinder_reader_read_string16_equal(&reader, NULL));
+    g_assert(gbinder_reader_at_end(&reader));
+
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_null));
+    g_assert(!gbinder_reader_read_string16_equal(&reader, ""));
+    g_assert(gbinder_reader_at_end(&reader));
+
     gbinder_buffer_free(data.buffer);
     gbinder_driver_unref(driver);
 }
@@ -721,6 +850,85 @@ test_string16(
     g_assert(gbinder_reader_at_end(&reader) == (!test->remaining));
     g_assert(gbinder_reader_bytes_remaining(&reader) == test->remaining);
 
+    gbinder_reader_init(&reader, &data, 0, test->in_size);
+    g_assert(gbinder_reader_read_string16_equal(&reader, test->out) == valid);
+    g_assert(gbinder_reader_at_end(&reader) == (!test->remaining));
+    g_assert(gbinder_reader_bytes_remaining(&reader) == test->remaining);
+
+    if (valid) {
+        gbinder_reader_init(&reader, &data, 0, test->in_size);
+        g_assert(!gbinder_reader_read_string16_equal(&reader, NULL));
+        gbinder_reader_init(&reader, &data, 0, test->in_size);
+        g_assert(!gbinder_reader_read_string16_equal(&reader, "fo"));
+        gbinder_reader_init(&reader, &data, 0, test->in_size);
+        g_assert(!gbinder_reader_read_string16_equal(&reader, "fooo"));
+        gbinder_reader_init(&reader, &data, 0, test->in_size);
+        g_assert(!gbinder_reader_read_string16_equal(&reader, "fob"));
+    }
+
+    gbinder_buffer_free(data.buffer);
+    gbinder_driver_unref(driver);
+}
+
+static const guint8 test_string16_in_utf8 [] = {
+    TEST_INT32_BYTES(4),
+    TEST_INT16_BYTES('x'), TEST_INT16_BYTES(0x00e9),
+    TEST_INT16_BYTES(0xd83d), TEST_INT16_BYTES(0xde00),
+    0x00, 0x00, 0x00, 0x00
+};
+
+static const guint8 test_string16_in_surrogate [] = {
+    TEST_INT32_BYTES(2),
+    TEST_INT16_BYTES('x'), TEST_INT16_BYTES(0xd83d),
+    0x00, 0x00, 0x00, 0x00
+};
+
+static
+void
+test_string16_utf8(
+    void)
+{
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderReader reader;
+    GBinderReaderData data;
+    const char* expected = "x\xc3\xa9\xf0\x9f\x98\x80";
+    char* str;
+
+    g_assert(driver);
+    memset(&data, 0, sizeof(data));
+    data.buffer = gbinder_buffer_new(driver,
+        g_memdup(TEST_ARRAY_AND_SIZE(test_string16_in_utf8)),
+        sizeof(test_string16_in_utf8), NULL);
+
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_utf8));
+    str = gbinder_reader_read_string16(&reader);
+    g_assert_cmpstr(str, == ,expected);
+    g_assert(gbinder_reader_at_end(&reader));
+    g_free(str);
+
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_utf8));
+    g_assert(gbinder_reader_read_string16_equal(&reader, expected));
+    g_assert(gbinder_reader_at_end(&reader));
+
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_utf8));
+    g_assert(!gbinder_reader_read_string16_equal(&reader, "x\xc3\xa9"));
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_utf8));
+    g_assert(!gbinder_reader_read_string16_equal(&reader, "x\xc3"));
+    gbinder_buffer_free(data.buffer);
+
+    /* Unpaired surrogate */
+    data.buffer = gbinder_buffer_new(driver,
+        g_memdup(TEST_ARRAY_AND_SIZE(test_string16_in_surrogate)),
+        sizeof(test_string16_in_surrogate), NULL);
+
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_surrogate));
+    g_assert(!gbinder_reader_read_string16(&reader));
+    g_assert(gbinder_reader_at_end(&reader));
+
+    gbinder_reader_init(&reader, &data, 0, sizeof(test_string16_in_surrogate));
+    g_assert(!gbinder_reader_read_string16_equal(&reader, "x"));
+    g_assert(gbinder_reader_at_end(&reader));
+
     gbinder_buffer_free(data.buffer);
     gbinder_driver_unref(driver);
 }
@@ -1000,6 +1208,22 @@ test_hidl_vec(
     g_assert(elem == test->elemsize);
 
     if (test->data) {
+        GBytes* bytes;
+
+        gbinder_reader_init(&reader, &data, 0, test->in_size);
+        bytes = gbinder_reader_read_hidl_vec_bytes(&reader, &n, &elem);
+        g_assert(bytes);
+        g_assert_cmpuint(g_bytes_get_size(bytes), == ,test->count *
+            test->elemsize);
+        if (test->count) {
+            /* Small pieces get copied */
+            g_assert(!memcmp(g_bytes_get_data(bytes, NULL), test->data,
+                test->count * test->elemsize));
+        }
+        g_assert(n == test->count);
+        g_assert(elem == test->elemsize);
+        g_bytes_unref(bytes);
+
         n = 42;
         gbinder_reader_init(&reader, &data, 0, test->in_size);
         g_assert(gbinder_reader_read_hidl_vec1(&reader, &n, test->elemsize) ==
@@ -1175,7 +1399,7 @@ test_fd_ok(
 
     g_assert(gbinder_reader_read_fd(&reader) == fd);
     gbinder_driver_close_fds(ipc->driver, data.objects,
-        (guint8*)buf->data + buf->size);
+        (guint8*)buf->data + buf->size, NULL, 0);
     /* The above call must have closed the descriptor */
     g_assert(close(fd) < 0);
 
@@ -1184,6 +1408,58 @@ test_fd_ok(
     gbinder_ipc_unref(ipc);
 }
 
+/*==========================================================================*
+ * fd_take
+ *==========================================================================*/
+
+static
+void
+test_fd_take(
+    void)
+{
+    /* Using 64-bit I/O */
+    const int fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    const guint8 input[] = {
+        TEST_INT32_BYTES(BINDER_TYPE_FD),
+        TEST_INT32_BYTES(0x7f | BINDER_FLAG_ACCEPTS_FDS),
+        TEST_INT32_BYTES(fd), TEST_INT32_BYTES(0),
+        TEST_INT64_BYTES(0)
+    };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    void* ptr = g_memdup(input, sizeof(input));
+    void** objects = g_new(void*, 2);
+    GBinderBuffer* buf;
+    GBinderReaderData data;
+    GBinderReader reader;
+    int fd2;
+
+    objects[0] = ptr;
+    objects[1] = NULL;
+    buf = gbinder_buffer_new(ipc->driver, ptr, sizeof(input), objects);
+    memset(&data, 0, sizeof(data));
+    data.buffer = buf;
+    data.reg = gbinder_ipc_object_registry(ipc);
+    data.objects = gbinder_buffer_objects(buf);
+
+    /* The first one takes the fd as is */
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    g_assert_cmpint(gbinder_reader_take_fd(&reader), == ,fd);
+    g_assert(gbinder_reader_at_end(&reader));
+    g_assert_cmpint(gbinder_reader_take_fd(&reader), == ,-1);
+
+    /* It can't be taken twice, the second one gets a dup */
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    fd2 = gbinder_reader_take_fd(&reader);
+    g_assert_cmpint(fd2, >= ,0);
+    g_assert_cmpint(fd2, != ,fd);
+
+    /* Freeing the buffer doesn't close the taken fd */
+    gbinder_buffer_free(buf);
+    g_assert_cmpint(close(fd), == ,0);
+    g_assert_cmpint(close(fd2), == ,0);
+    gbinder_ipc_unref(ipc);
+}
+
 /*==========================================================================*
  * fd_shortbuf
  *==========================================================================*/
@@ -1249,7 +1525,7 @@ test_fd_badtype(
 
     g_assert(gbinder_reader_read_fd(&reader) < 0);
     gbinder_driver_close_fds(ipc->driver, data.objects,
-        (guint8*)buf->data + buf->size);
+        (guint8*)buf->data + buf->size, NULL, 0);
     /* The above call doesn't close the descriptor */
     g_assert(close(fd) == 0);
 
@@ -1295,7 +1571,7 @@ test_dupfd_ok(
     g_assert(fd2 >= 0);
     g_assert(fd2 != fd);
     gbinder_driver_close_fds(ipc->driver, data.objects,
-        (guint8*)buf->data + buf->size);
+        (guint8*)buf->data + buf->size, NULL, 0);
     /* The above call closes fd*/
     g_assert(close(fd) < 0);
     g_assert(close(fd2) == 0);
@@ -1339,7 +1615,7 @@ test_dupfd_badtype(
 
     g_assert(gbinder_reader_read_dup_fd(&reader) < 0);
     gbinder_driver_close_fds(ipc->driver, data.objects,
-        (guint8*)buf->data + buf->size);
+        (guint8*)buf->data + buf->size, NULL, 0);
     /* The above call doesn't close fd*/
     g_assert(close(fd) == 0);
 
@@ -1384,7 +1660,7 @@ test_dupfd_badfd(
     g_assert(close(fd) == 0);
     g_assert(gbinder_reader_read_dup_fd(&reader) < 0);
     gbinder_driver_close_fds(ipc->driver, data.objects,
-        (guint8*)buf->data + buf->size);
+        (guint8*)buf->data + buf->size, NULL, 0);
 
     g_free(data.objects);
     gbinder_buffer_free(buf);
@@ -1410,6 +1686,7 @@ test_hidl_string(
     GBinderRemoteObject* obj = NULL;
     GBinderReaderData data;
     GBinderReader reader;
+    gsize len = 1;
     guint i;
 
     g_assert(ipc);
@@ -1425,6 +1702,11 @@ test_hidl_string(
 
     g_assert(gbinder_reader_read_hidl_string_c(&reader) == result);
 
+    /* Same thing with the length */
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    g_assert(gbinder_reader_read_hidl_string_len(&reader, &len) == result);
+    g_assert_cmpuint(len, == ,result ? strlen(result) : 0);
+
     g_free(data.objects);
     gbinder_remote_object_unref(obj);
     gbinder_buffer_free(buf);
@@ -1801,6 +2083,65 @@ test_parcelable(
     gbinder_driver_unref(driver);
 }
 
+/*==========================================================================*
+ * parcelable_reader
+ *==========================================================================*/
+
+static
+void
+test_parcelable_reader(
+    void)
+{
+    const guint8 input[] = {
+        TEST_INT32_BYTES(1),
+        TEST_INT32_BYTES(sizeof(gint32) * 7),
+        TEST_INT32_BYTES(5),
+        /* Nested parcelable */
+        TEST_INT32_BYTES(1),
+        TEST_INT32_BYTES(sizeof(gint32) * 3),
+        TEST_INT32_BYTES(2),
+        TEST_INT32_BYTES(99), /* Unknown field */
+        TEST_INT32_BYTES(77), /* Unknown field */
+        /* Followed by something else */
+        TEST_INT32_BYTES(42)
+    };
+    const guint8 input_null[] = {
+        TEST_INT32_BYTES(0)
+    };
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderReader reader, outer, inner;
+    GBinderReaderData data;
+    gint32 value = 0;
+
+    memset(&data, 0, sizeof(data));
+    test_init_reader(driver, &data, &reader, TEST_ARRAY_AND_SIZE(input));
+    g_assert(gbinder_reader_read_parcelable_reader(&reader, &outer));
+    g_assert(gbinder_reader_read_int32(&outer, &value));
+    g_assert_cmpint(value, == ,5);
+    g_assert(gbinder_reader_read_parcelable_reader(&outer, &inner));
+    g_assert(gbinder_reader_read_int32(&inner, &value));
+    g_assert_cmpint(value, == ,2);
+    g_assert(!gbinder_reader_at_end(&inner));
+    g_assert(!gbinder_reader_at_end(&outer));
+    g_assert(gbinder_reader_read_int32(&reader, &value));
+    g_assert_cmpint(value, == ,42);
+    g_assert(gbinder_reader_at_end(&reader));
+
+    /* Truncated */
+    gbinder_reader_init(&reader, &data, 0, sizeof(input) - 8);
+    g_assert(!gbinder_reader_read_parcelable_reader(&reader, &outer));
+    g_assert(gbinder_reader_at_end(&outer));
+    gbinder_buffer_free(data.buffer);
+
+    /* Null */
+    test_init_reader(driver, &data, &reader, TEST_ARRAY_AND_SIZE(input_null));
+    g_assert(!gbinder_reader_read_parcelable_reader(&reader, &outer));
+    g_assert(gbinder_reader_at_end(&outer));
+    g_assert(gbinder_reader_at_end(&reader));
+    gbinder_buffer_free(data.buffer);
+    gbinder_driver_unref(driver);
+}
+
 /*==========================================================================*
  * object
  *==========================================================================*/
@@ -1897,6 +2238,67 @@ test_object_invalid(
     gbinder_ipc_unref(ipc);
 }
 
+/*==========================================================================*
+ * object_local
+ *==========================================================================*/
+
+static
+void
+test_object_local(
+    void)
+{
+    /* Using 64-bit I/O */
+    struct test_flat_binder_object_64 {
+        guint32 type;
+        guint32 flags;
+        guint64 binder;
+        guint64 cookie;
+    } input[3];
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderLocalObject* local = gbinder_local_object_new(ipc, NULL, NULL,
+        NULL);
+    GBinderBuffer* buf;
+    GBinderRemoteObject* obj = NULL;
+    GBinderReaderData data;
+    GBinderReader reader;
+
+    /* One of our objects, NULL and something we don't know */
+    memset(input, 0, sizeof(input));
+    input[0].type = input[1].type = input[2].type = BINDER_TYPE_BINDER;
+    input[0].binder = (guint64)(gsize)local;
+    input[2].binder = (guint64)(gsize)&data;
+    buf = gbinder_buffer_new(ipc->driver, g_memdup(input, sizeof(input)),
+        sizeof(input), NULL);
+
+    memset(&data, 0, sizeof(data));
+    data.buffer = buf;
+    data.reg = gbinder_ipc_object_registry(ipc);
+    data.objects = g_new(void*, 4);
+    data.objects[0] = buf->data;
+    data.objects[1] = (guint8*)buf->data + sizeof(input[0]);
+    data.objects[2] = (guint8*)buf->data + 2 * sizeof(input[0]);
+    data.objects[3] = NULL;
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+
+    g_assert(gbinder_reader_read_nullable_object(&reader, &obj));
+    g_assert(obj);
+    g_assert(obj->local == local);
+    g_assert_cmpuint(obj->handle, == ,GBINDER_REMOTE_OBJECT_NO_HANDLE);
+    gbinder_remote_object_unref(obj);
+
+    obj = NULL;
+    g_assert(gbinder_reader_read_nullable_object(&reader, &obj));
+    g_assert(!obj);
+
+    g_assert(!gbinder_reader_read_nullable_object(&reader, &obj));
+    g_assert(!obj);
+
+    g_free(data.objects);
+    gbinder_buffer_free(buf);
+    gbinder_local_object_unref(local);
+    gbinder_ipc_unref(ipc);
+}
+
 /*==========================================================================*
  * vec
  *==========================================================================*/
@@ -1966,7 +2368,9 @@ test_hidl_string_vec(
     GBinderRemoteObject* obj = NULL;
     GBinderReaderData data;
     GBinderReader reader;
+    const char** view;
     char** out;
+    gsize count = 0;
     guint i;
 
     g_assert(ipc);
@@ -1997,6 +2401,23 @@ test_hidl_string_vec(
         g_assert(!result);
     }
 
+    /* Same thing without copying the strings */
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    view = gbinder_reader_read_hidl_string_vec_c(&reader, &count);
+    if (view) {
+        g_assert(result);
+        g_assert_cmpuint(count, == ,g_strv_length((char**)result));
+        for (i = 0; i < count; i++) {
+            /* Points to the same memory as the input */
+            g_assert(view[i] == result[i]);
+        }
+        g_assert(!view[count]);
+    } else {
+        g_assert(!result);
+        g_assert_cmpuint(count, == ,0);
+    }
+
+    g_free(view);
     g_strfreev(out);
     g_free(data.objects);
     gbinder_remote_object_unref(obj);
@@ -2318,6 +2739,642 @@ test_byte_array(
     gbinder_driver_unref(driver);
 }
 
+/*==========================================================================*
+ * array
+ *==========================================================================*/
+
+static
+void
+test_array(
+    void)
+{
+    static const gint32 i32[] = { 1, -2, 3 };
+    static const gint64 i64[] = { G_GINT64_CONSTANT(0x100000000), -1 };
+    static const gfloat f[] = { 1.5f, -2.5f };
+    static const gdouble d[] = { 3.25 };
+    const gint32 null_count = -1;
+    const gint32 bad_count = 42;
+    GByteArray* buf = g_byte_array_new();
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderReader reader;
+    GBinderReaderData data;
+    const gint32* i32_out;
+    const gint64* i64_out;
+    const gfloat* f_out;
+    const gdouble* d_out;
+    gsize count = 1;
+    gint32 n;
+
+    n = G_N_ELEMENTS(i32);
+    g_byte_array_append(buf, (void*)&n, sizeof(n));
+    g_byte_array_append(buf, (void*)i32, sizeof(i32));
+    n = G_N_ELEMENTS(i64);
+    g_byte_array_append(buf, (void*)&n, sizeof(n));
+    g_byte_array_append(buf, (void*)i64, sizeof(i64));
+    n = G_N_ELEMENTS(f);
+    g_byte_array_append(buf, (void*)&n, sizeof(n));
+    g_byte_array_append(buf, (void*)f, sizeof(f));
+    n = G_N_ELEMENTS(d);
+    g_byte_array_append(buf, (void*)&n, sizeof(n));
+    g_byte_array_append(buf, (void*)d, sizeof(d));
+    g_byte_array_append(buf, (void*)&null_count, sizeof(null_count));
+    g_byte_array_append(buf, (void*)&bad_count, sizeof(bad_count));
+    g_byte_array_append(buf, (void*)i32, sizeof(i32));
+
+    memset(&data, 0, sizeof(data));
+    data.buffer = gbinder_buffer_new(driver, g_memdup(buf->data, buf->len),
+        buf->len, NULL);
+    gbinder_reader_init(&reader, &data, 0, buf->len);
+
+    /* The data is not copied */
+    i32_out = gbinder_reader_read_int32_array(&reader, &count);
+    g_assert(i32_out == (void*)((guint8*)data.buffer->data + 4));
+    g_assert_cmpuint(count, == ,G_N_ELEMENTS(i32));
+    g_assert(!memcmp(i32_out, i32, sizeof(i32)));
+
+    i64_out = gbinder_reader_read_int64_array(&reader, &count);
+    g_assert(i64_out);
+    g_assert_cmpuint(count, == ,G_N_ELEMENTS(i64));
+    g_assert(!memcmp(i64_out, i64, sizeof(i64)));
+
+    f_out = gbinder_reader_read_float_array(&reader, &count);
+    g_assert(f_out);
+    g_assert_cmpuint(count, == ,G_N_ELEMENTS(f));
+    g_assert(!memcmp(f_out, f, sizeof(f)));
+
+    d_out = gbinder_reader_read_double_array(&reader, NULL);
+    g_assert(d_out);
+    g_assert(!memcmp(d_out, d, sizeof(d)));
+
+    /* NULL array */
+    count = 1;
+    g_assert(gbinder_reader_read_int32_array(&reader, &count));
+    g_assert(!count);
+
+    /* Not enough data */
+    g_assert(!gbinder_reader_read_int32_array(&reader, &count));
+    g_assert(!count);
+    g_assert_cmpuint(gbinder_reader_bytes_remaining(&reader), == ,
+        sizeof(bad_count) + sizeof(i32));
+
+    gbinder_buffer_free(data.buffer);
+    gbinder_driver_unref(driver);
+    g_byte_array_free(buf, TRUE);
+}
+
+/*==========================================================================*
+ * byte_array_bytes
+ *==========================================================================*/
+
+static
+void
+test_byte_array_bytes(
+    void)
+{
+    const gint32 len = 100;
+    const gint32 null_len = -1;
+    const gint32 zero_len = 0;
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GByteArray* buf = g_byte_array_new();
+    GBinderReaderData data;
+    GBinderReader reader;
+    GBytes* bytes;
+    GBytes* empty;
+    const guint8* ptr;
+    gsize size = 0;
+    gint32 i;
+
+    g_byte_array_append(buf, (void*)&len, sizeof(len));
+    for (i = 0; i < len; i++) {
+        const guint8 b = (guint8)i;
+
+        g_byte_array_append(buf, &b, 1);
+    }
+    g_byte_array_append(buf, (void*)&null_len, sizeof(null_len));
+    g_byte_array_append(buf, (void*)&zero_len, sizeof(zero_len));
+    g_byte_array_append(buf, (void*)&len, sizeof(len));
+
+    memset(&data, 0, sizeof(data));
+    data.buffer = gbinder_buffer_new(driver, g_memdup(buf->data, buf->len),
+        buf->len, NULL);
+    gbinder_reader_init(&reader, &data, 0, buf->len);
+
+    /* The data is referenced, not copied */
+    bytes = gbinder_reader_read_byte_array_bytes(&reader);
+    g_assert(bytes);
+    ptr = g_bytes_get_data(bytes, &size);
+    g_assert(ptr == (guint8*)data.buffer->data + sizeof(len));
+    g_assert_cmpuint(size, == ,len);
+
+    /* NULL and empty arrays */
+    empty = gbinder_reader_read_byte_array_bytes(&reader);
+    g_assert(empty);
+    g_assert_cmpuint(g_bytes_get_size(empty), == ,0);
+    g_bytes_unref(empty);
+    empty = gbinder_reader_read_byte_array_bytes(&reader);
+    g_assert(empty);
+    g_assert_cmpuint(g_bytes_get_size(empty), == ,0);
+    g_bytes_unref(empty);
+
+    /* Not enough data */
+    g_assert(!gbinder_reader_read_byte_array_bytes(&reader));
+    g_assert_cmpuint(gbinder_reader_bytes_remaining(&reader), == ,
+        sizeof(len));
+
+    /* GBytes outlive the buffer */
+    gbinder_buffer_free(data.buffer);
+    g_assert(!memcmp(ptr, buf->data + sizeof(len), len));
+    g_bytes_unref(bytes);
+    g_assert(!gbinder_driver_pinned_size(driver));
+
+    gbinder_driver_unref(driver);
+    g_byte_array_free(buf, TRUE);
+}
+
+/*==========================================================================*
+ * alloc_budget
+ *==========================================================================*/
+
+static
+void
+test_alloc_budget(
+    void)
+{
+    static const guint8 bytes[] = { 1, 2, 3, 4, 5 };
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderLocalRequest* req = gbinder_local_request_new
+        (gbinder_driver_io(driver), NULL);
+    GBinderOutputData* out;
+    GBinderReaderData data;
+    GBinderReader reader;
+    GBinderWriter writer;
+    const char* str = NULL;
+    const void* ptr = NULL;
+    gboolean b = FALSE;
+    gint32 i32 = 0;
+    gint64 i64 = 0;
+    gsize len = 0;
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_int32(&writer, 42);
+    gbinder_writer_append_int64(&writer, 4242);
+    gbinder_writer_append_bool(&writer, TRUE);
+    gbinder_writer_append_string8(&writer, "foo");
+    gbinder_writer_append_string16(&writer, "bar");
+    gbinder_writer_append_string16(&writer, "baz");
+    gbinder_writer_append_byte_array(&writer, bytes, sizeof(bytes));
+    out = gbinder_local_request_data(req);
+
+    memset(&data, 0, sizeof(data));
+    data.buffer = gbinder_buffer_new(driver, g_memdup(out->bytes->data,
+        out->bytes->len), out->bytes->len, NULL);
+
+    /* Make sure that allocations are actually counted */
+    test_alloc_begin(0);
+    g_free(g_malloc(1));
+    g_assert_cmpuint(test_alloc_end(), == ,test_alloc_supported() ? 1 : 0);
+
+    /* Parsing a parcel of a fixed shape doesn't allocate anything */
+    test_assert_alloc_budget(0,
+        gbinder_reader_init(&reader, &data, 0, out->bytes->len);
+        g_assert(gbinder_reader_read_int32(&reader, &i32));
+        g_assert(gbinder_reader_read_int64(&reader, &i64));
+        g_assert(gbinder_reader_read_bool(&reader, &b));
+        str = gbinder_reader_read_string8(&reader);
+        g_assert(gbinder_reader_read_string16_utf16(&reader, &len));
+        g_assert(gbinder_reader_skip_string16(&reader));
+        ptr = gbinder_reader_read_byte_array(&reader, &len);
+        g_assert(gbinder_reader_at_end(&reader)));
+
+    g_assert_cmpint(i32, == ,42);
+    g_assert_cmpint(i64, == ,4242);
+    g_assert(b);
+    g_assert_cmpstr(str, == ,"foo");
+    g_assert_cmpuint(len, == ,sizeof(bytes));
+    g_assert(!memcmp(ptr, bytes, sizeof(bytes)));
+
+    gbinder_buffer_free(data.buffer);
+    gbinder_local_request_unref(req);
+    gbinder_driver_unref(driver);
+}
+
+/*==========================================================================*
+ * blob
+ *==========================================================================*/
+
+static
+void
+test_blob(
+    void)
+{
+    static const guint8 blob[] = { 1, 2, 3, 4, 5, 6 };
+    const guint8 inplace[] = {
+        TEST_INT32_BYTES(0),
+        1, 2, 3, 4, 5, 6, 0, 0,
+        TEST_INT32_BYTES(42)
+    };
+    GBinderDriver* driver = gbinder_driver_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderReaderData data;
+    GBinderReader reader;
+    GBytes* bytes;
+    gsize size = 0;
+
+    g_assert(driver);
+    memset(&data, 0, sizeof(data));
+    data.buffer = gbinder_buffer_new(driver,
+        g_memdup(TEST_ARRAY_AND_SIZE(inplace)), sizeof(inplace), NULL);
+
+    /* Doesn't fit, the position remains unchanged */
+    gbinder_reader_init(&reader, &data, 0, sizeof(inplace));
+    g_assert(!gbinder_reader_read_blob(&reader, sizeof(inplace)));
+    g_assert_cmpuint(gbinder_reader_bytes_read(&reader), == ,0);
+
+    /* The in-place blob is copied */
+    bytes = gbinder_reader_read_blob(&reader, sizeof(blob));
+    g_assert(bytes);
+    g_assert(!memcmp(g_bytes_get_data(bytes, &size), blob, sizeof(blob)));
+    g_assert_cmpuint(size, == ,sizeof(blob));
+    g_bytes_unref(bytes);
+
+    /* Unknown blob type */
+    g_assert(!gbinder_reader_read_blob(&reader, 0));
+    g_assert_cmpuint(gbinder_reader_bytes_read(&reader), == ,12);
+
+    gbinder_buffer_free(data.buffer);
+    gbinder_driver_unref(driver);
+}
+
+static
+void
+test_blob_shared(
+    void)
+{
+    static const guint8 blob[] = { 1, 2, 3, 4, 5, 6 };
+    char* path = NULL;
+    const int fd = g_file_open_tmp(NULL, &path, NULL);
+    /* Using 64-bit I/O */
+    const guint8 input[] = {
+        TEST_INT32_BYTES(1),
+        TEST_INT32_BYTES(BINDER_TYPE_FD),
+        TEST_INT32_BYTES(0x7f | BINDER_FLAG_ACCEPTS_FDS),
+        TEST_INT32_BYTES(fd), TEST_INT32_BYTES(0),
+        TEST_INT64_BYTES(0)
+    };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderBuffer* buf = gbinder_buffer_new(ipc->driver,
+        g_memdup(input, sizeof(input)), sizeof(input), NULL);
+    GBinderReaderData data;
+    GBinderReader reader;
+    GBytes* bytes;
+    gsize size = 0;
+
+    g_assert(fd >= 0);
+    g_assert(write(fd, blob, sizeof(blob)) == sizeof(blob));
+    memset(&data, 0, sizeof(data));
+    data.buffer = buf;
+    data.reg = gbinder_ipc_object_registry(ipc);
+    data.objects = g_new(void*, 2);
+    data.objects[0] = (guint8*)buf->data + 4;
+    data.objects[1] = NULL;
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+
+    /* Larger than the file */
+    g_assert(!gbinder_reader_read_blob(&reader, sizeof(blob) + 1));
+    g_assert_cmpuint(gbinder_reader_bytes_read(&reader), == ,0);
+
+    /* This one gets mapped */
+    bytes = gbinder_reader_read_blob(&reader, sizeof(blob));
+    g_assert(bytes);
+    g_assert(gbinder_reader_at_end(&reader));
+    gbinder_driver_close_fds(ipc->driver, data.objects,
+        (guint8*)buf->data + buf->size, NULL, 0);
+
+    /* The mapping survives the descriptor */
+    g_assert(!memcmp(g_bytes_get_data(bytes, &size), blob, sizeof(blob)));
+    g_assert_cmpuint(size, == ,sizeof(blob));
+    g_bytes_unref(bytes);
+
+    unlink(path);
+    g_free(path);
+    g_free(data.objects);
+    gbinder_buffer_free(buf);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * hidl_memory
+ *==========================================================================*/
+
+/* Turns the request into something that looks like received data */
+static
+guint
+test_reader_data_init(
+    GBinderReaderData* data,
+    GBinderIpc* ipc,
+    GBinderLocalRequest* req)
+{
+    GBinderOutputData* out = gbinder_local_request_data(req);
+    GUtilIntArray* offsets = gbinder_output_data_offsets(out);
+    const guint count = offsets ? offsets->count : 0;
+    GBinderBuffer* buf = gbinder_buffer_new(ipc->driver,
+        g_memdup(out->bytes->data, out->bytes->len), out->bytes->len, NULL);
+    guint i;
+
+    memset(data, 0, sizeof(*data));
+    data->buffer = buf;
+    data->reg = gbinder_ipc_object_registry(ipc);
+    data->objects = g_new0(void*, count + 1);
+    for (i = 0; i < count; i++) {
+        data->objects[i] = (guint8*)buf->data + offsets->data[i];
+    }
+    return count;
+}
+
+static
+void
+test_hidl_memory(
+    void)
+{
+    static const guint8 blob[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    static const char name[] = "test";
+    char* path = NULL;
+    const int fd = g_file_open_tmp(NULL, &path, NULL);
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64,
+        NULL);
+    int fds_buf[(sizeof(GBinderFds) / sizeof(int)) + 1];
+    GBinderFds* fds = (GBinderFds*)fds_buf;
+    GBinderHidlMemory mem;
+    GBinderParent parent;
+    GBinderWriter writer;
+    GBinderReaderData data;
+    GBinderReader reader;
+    GBinderBuffer* buf;
+    GBytes* b1;
+    GBytes* b2;
+    gsize size = 0;
+
+    g_assert(fd >= 0);
+    g_assert(write(fd, blob, sizeof(blob)) == sizeof(blob));
+
+    /* Write it the way HIDL does */
+    fds->version = GBINDER_HIDL_FDS_VERSION;
+    fds->num_fds = 1;
+    fds->num_ints = 0;
+    fds_buf[G_N_ELEMENTS(fds_buf) - 1] = fd;
+    memset(&mem, 0, sizeof(mem));
+    mem.data.fds = fds;
+    mem.size = sizeof(blob);
+    mem.name.data.str = name;
+    mem.name.len = sizeof(name) - 1;
+    gbinder_local_request_init_writer(req, &writer);
+    parent.index = gbinder_writer_append_buffer_object(&writer,
+        &mem, sizeof(mem));
+    parent.offset = GBINDER_HIDL_MEMORY_PTR_OFFSET;
+    gbinder_writer_append_fds(&writer, fds, &parent);
+    parent.offset = GBINDER_HIDL_MEMORY_NAME_OFFSET;
+    gbinder_writer_append_buffer_object_with_parent(&writer,
+        name, sizeof(name), &parent);
+
+    g_assert_cmpuint(test_reader_data_init(&data, ipc, req), == ,4);
+    buf = data.buffer;
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    b1 = gbinder_reader_read_hidl_memory(&reader);
+    g_assert(b1);
+    g_assert(gbinder_reader_at_end(&reader));
+    g_assert(!memcmp(g_bytes_get_data(b1, &size), blob, sizeof(blob)));
+    g_assert_cmpuint(size, == ,sizeof(blob));
+
+    /* Reading the same memory again reuses the mapping */
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    b2 = gbinder_reader_read_hidl_memory(&reader);
+    g_assert(b2);
+    g_assert(g_bytes_get_data(b1, NULL) == g_bytes_get_data(b2, NULL));
+    g_bytes_unref(b1);
+    g_bytes_unref(b2);
+
+    /* Missing fd array */
+    data.objects[2] = NULL;
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    g_assert(!gbinder_reader_read_hidl_memory(&reader));
+
+    /* Not a hidl_memory at all */
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    g_assert(gbinder_reader_skip_buffer(&reader));
+    g_assert(!gbinder_reader_read_hidl_memory(&reader));
+
+    g_free(data.objects);
+    gbinder_buffer_free(buf);
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+    close(fd);
+    unlink(path);
+    g_free(path);
+}
+
+/*==========================================================================*
+ * fmq
+ *==========================================================================*/
+
+#if GBINDER_FMQ_SUPPORTED
+
+static
+void
+test_fmq(
+    void)
+{
+    const guint32 in[] = { 1, 2, 3 };
+    guint32 out[G_N_ELEMENTS(in)];
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64,
+        NULL);
+    GBinderFmq* fmq = gbinder_fmq_new(sizeof(guint32), 4,
+        GBINDER_FMQ_TYPE_SYNC_READ_WRITE,
+        GBINDER_FMQ_FLAG_CONFIGURE_EVENT_FLAG, -1, 0);
+    GBinderFmq* imported;
+    GBinderWriter writer;
+    GBinderReaderData data;
+    GBinderReader reader;
+    GBinderBuffer* buf;
+    guint32 state = 0;
+
+    g_assert(fmq);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_fmq_descriptor(&writer, fmq);
+
+    /* Descriptor, grantors, native handle and the fd array */
+    g_assert_cmpuint(test_reader_data_init(&data, ipc, req), == ,4);
+    buf = data.buffer;
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    imported = gbinder_reader_read_fmq(&reader);
+    g_assert(imported);
+    g_assert(gbinder_reader_at_end(&reader));
+
+    /* The fds have been duplicated, the parcel can go */
+    g_free(data.objects);
+    gbinder_buffer_free(buf);
+    gbinder_local_request_unref(req);
+
+    /* Both ends map the same queue */
+    g_assert(gbinder_fmq_write(fmq, in, G_N_ELEMENTS(in)));
+    g_assert_cmpuint(gbinder_fmq_available_to_read(imported), == ,
+        G_N_ELEMENTS(in));
+    g_assert(gbinder_fmq_read(imported, out, G_N_ELEMENTS(out)));
+    g_assert(!memcmp(in, out, sizeof(in)));
+    g_assert_cmpuint(gbinder_fmq_available_to_write(fmq), == ,4);
+    g_assert_cmpint(gbinder_fmq_wake(imported, 1), == ,0);
+    g_assert_cmpint(gbinder_fmq_try_wait(fmq, 1, &state), == ,0);
+    g_assert_cmpuint(state, == ,1);
+    gbinder_fmq_unref(imported);
+
+    /* Not an MQDescriptor */
+    req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_buffer_object(&writer, in, sizeof(in));
+    test_reader_data_init(&data, ipc, req);
+    buf = data.buffer;
+    gbinder_reader_init(&reader, &data, 0, buf->size);
+    g_assert(!gbinder_reader_read_fmq(&reader));
+
+    g_free(data.objects);
+    gbinder_buffer_free(buf);
+    gbinder_local_request_unref(req);
+    gbinder_fmq_unref(fmq);
+    gbinder_ipc_unref(ipc);
+}
+
+#endif /* GBINDER_FMQ_SUPPORTED */
+
+/*==========================================================================*
+ * hidl_schema
+ *==========================================================================*/
+
+typedef struct test_schema_bar {
+    gint32 x;
+    gint32 pad;
+    GBinderHidlString name;
+} TestSchemaBar;
+
+typedef struct test_schema_inner {
+    GBinderHidlString str;
+} TestSchemaInner;
+
+typedef struct test_schema_foo {
+    gint32 id;
+    gint32 pad;
+    GBinderHidlString name;
+    GBinderHidlVec bars;
+    TestSchemaInner inner;
+    GBinderHidlVec ints;
+} TestSchemaFoo;
+
+static const GBinderHidlField test_schema_bar_fields[] = {
+    GBINDER_HIDL_FIELD(STRING, TestSchemaBar, name, NULL),
+    GBINDER_HIDL_FIELDS_END
+};
+static const GBinderHidlSchema test_schema_bar = {
+    sizeof(TestSchemaBar), test_schema_bar_fields
+};
+static const GBinderHidlField test_schema_inner_fields[] = {
+    GBINDER_HIDL_FIELD(STRING, TestSchemaInner, str, NULL),
+    GBINDER_HIDL_FIELDS_END
+};
+static const GBinderHidlSchema test_schema_inner = {
+    sizeof(TestSchemaInner), test_schema_inner_fields
+};
+static const GBinderHidlSchema test_schema_int = {
+    sizeof(gint32), NULL
+};
+static const GBinderHidlField test_schema_foo_fields[] = {
+    GBINDER_HIDL_FIELD(STRING, TestSchemaFoo, name, NULL),
+    GBINDER_HIDL_FIELD(VEC, TestSchemaFoo, bars, &test_schema_bar),
+    GBINDER_HIDL_FIELD(STRUCT, TestSchemaFoo, inner, &test_schema_inner),
+    GBINDER_HIDL_FIELD(VEC, TestSchemaFoo, ints, &test_schema_int),
+    GBINDER_HIDL_FIELDS_END
+};
+static const GBinderHidlSchema test_schema_foo = {
+    sizeof(TestSchemaFoo), test_schema_foo_fields
+};
+
+static
+void
+test_hidl_string_init(
+    GBinderHidlString* str,
+    const char* value)
+{
+    memset(str, 0, sizeof(*str));
+    str->data.str = value;
+    str->len = value ? strlen(value) : 0;
+}
+
+static
+void
+test_hidl_schema(
+    void)
+{
+    static const gint32 ints[] = { 1, 2, 3 };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64,
+        NULL);
+    TestSchemaBar bars[2];
+    TestSchemaFoo foo;
+    const TestSchemaFoo* in;
+    const TestSchemaBar* in_bars;
+    GBinderReaderData data;
+    GBinderReader reader;
+    GBinderWriter writer;
+
+    memset(bars, 0, sizeof(bars));
+    memset(&foo, 0, sizeof(foo));
+    bars[0].x = 10;
+    test_hidl_string_init(&bars[0].name, "a");
+    bars[1].x = 20;
+    test_hidl_string_init(&bars[1].name, NULL);
+    foo.id = 42;
+    test_hidl_string_init(&foo.name, "foo");
+    foo.bars.data.ptr = bars;
+    foo.bars.count = G_N_ELEMENTS(bars);
+    test_hidl_string_init(&foo.inner.str, "inner");
+    foo.ints.data.ptr = ints;
+    foo.ints.count = G_N_ELEMENTS(ints);
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_hidl_schema(&writer, &test_schema_foo, &foo);
+    gbinder_writer_append_int32(&writer, 0);
+
+    /* foo, name, bars, 2 bar names, inner, ints */
+    g_assert_cmpuint(test_reader_data_init(&data, ipc, req), == ,7);
+    gbinder_reader_init(&reader, &data, 0, data.buffer->size);
+    in = gbinder_reader_read_hidl_schema(&reader, &test_schema_foo);
+    g_assert(in);
+    g_assert(gbinder_reader_read_int32(&reader, NULL));
+    g_assert(gbinder_reader_at_end(&reader));
+    g_assert_cmpint(in->id, == ,42);
+    g_assert_cmpstr(in->name.data.str, == ,"foo");
+    g_assert_cmpstr(in->inner.str.data.str, == ,"inner");
+    g_assert_cmpuint(in->bars.count, == ,2);
+    in_bars = in->bars.data.ptr;
+    g_assert_cmpint(in_bars[1].x, == ,20);
+    g_assert_cmpstr(in_bars[0].name.data.str, == ,"a");
+    g_assert(!in_bars[1].name.data.str);
+    g_assert(!memcmp(in->ints.data.ptr, ints, sizeof(ints)));
+
+    /* Wrong schema */
+    gbinder_reader_init(&reader, &data, 0, data.buffer->size);
+    g_assert(!gbinder_reader_read_hidl_schema(&reader, &test_schema_bar));
+    g_assert(!gbinder_reader_read_hidl_schema(&reader, NULL));
+
+    /* Missing embedded buffer */
+    data.objects[4] = NULL;
+    gbinder_reader_init(&reader, &data, 0, data.buffer->size);
+    g_assert(!gbinder_reader_read_hidl_schema(&reader, &test_schema_foo));
+
+    g_free(data.objects);
+    gbinder_buffer_free(data.buffer);
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+}
+
 /*==========================================================================*
  * copy
  *==========================================================================*/
@@ -2418,6 +3475,8 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("int64"), test_int64);
     g_test_add_func(TEST_("float"), test_float);
     g_test_add_func(TEST_("double"), test_double);
+    g_test_add_func(TEST_("cursor"), test_cursor);
+    g_test_add_func(TEST_("inline"), test_inline);
 
     for (i = 0; i < G_N_ELEMENTS(test_string8_tests); i++) {
         const TestStringData* test = test_string8_tests + i;
@@ -2428,6 +3487,7 @@ int main(int argc, char* argv[])
     }
 
     g_test_add_func(TEST_("string16/null"), test_string16_null);
+    g_test_add_func(TEST_("string16/utf8"), test_string16_utf8);
     for (i = 0; i < G_N_ELEMENTS(test_string16_tests); i++) {
         const TestStringData* test = test_string16_tests + i;
         char* path = g_strconcat(TEST_("string16/"), test->name, NULL);
@@ -2469,6 +3529,7 @@ int main(int argc, char* argv[])
     }
 
     g_test_add_func(TEST_("fd/ok"), test_fd_ok);
+    g_test_add_func(TEST_("fd/take"), test_fd_take);
     g_test_add_func(TEST_("fd/shortbuf"), test_fd_shortbuf);
     g_test_add_func(TEST_("fd/badtype"), test_fd_badtype);
     g_test_add_func(TEST_("dupfd/ok"), test_dupfd_ok);
@@ -2483,9 +3544,11 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("hidl_string/7"), test_hidl_string7);
     g_test_add_func(TEST_("buffer"), test_buffer);
     g_test_add_func(TEST_("parcelable"), test_parcelable);
+    g_test_add_func(TEST_("parcelable_reader"), test_parcelable_reader);
     g_test_add_func(TEST_("object/valid"), test_object);
     g_test_add_func(TEST_("object/invalid"), test_object_invalid);
     g_test_add_func(TEST_("object/no_reg"), test_object_no_reg);
+    g_test_add_func(TEST_("object/local"), test_object_local);
     g_test_add_func(TEST_("vec"), test_vec);
     g_test_add_func(TEST_("hidl_string_vec/1"), test_hidl_string_vec1);
     g_test_add_func(TEST_("hidl_string_vec/2"), test_hidl_string_vec2);
@@ -2493,6 +3556,25 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("hidl_string_vec/4"), test_hidl_string_vec4);
     g_test_add_func(TEST_("hidl_string_vec/5"), test_hidl_string_vec5);
     g_test_add_func(TEST_("byte_array"), test_byte_array);
+    g_test_add_func(TEST_("array"), test_array);
+    g_test_add_func(TEST_("byte_array_bytes"), test_byte_array_bytes);
+    g_test_add_func(TEST_("alloc_budget"), test_alloc_budget);
+    g_test_add_func(TEST_("blob"), test_blob);
+    g_test_add_func(TEST_("blob_shared"), test_blob_shared);
+    g_test_add_func(TEST_("hidl_memory"), test_hidl_memory);
+#if GBINDER_FMQ_SUPPORTED
+    {
+        int test_fd = syscall(__NR_memfd_create, "test", MFD_CLOEXEC);
+
+        if (test_fd < 0 && errno == ENOSYS) {
+            GINFO("Skipping tests that rely on memfd_create");
+        } else {
+            close(test_fd);
+            g_test_add_func(TEST_("fmq"), test_fmq);
+        }
+    }
+#endif /* GBINDER_FMQ_SUPPORTED */
+    g_test_add_func(TEST_("hidl_schema"), test_hidl_schema);
     g_test_add_func(TEST_("copy"), test_copy);
     test_init(&test_opt, argc, argv);
     return g_test_run();
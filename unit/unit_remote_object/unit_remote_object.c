@@ -140,6 +140,199 @@ test_dead(
     test_run_in_context(&test_opt, test_dead_run);
 }
 
+/*==========================================================================*
+ * dead_batch
+ *==========================================================================*/
+
+typedef struct test_dead_batch {
+    GMainLoop* loop;
+    int count;
+} TestDeadBatch;
+
+static
+void
+test_dead_batch_done(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    TestDeadBatch* test = user_data;
+
+    GVERBOSE_("%u", obj->handle);
+    test->count++;
+    if (test->count == 3) {
+        test_quit_later(test->loop);
+    }
+}
+
+static
+void
+test_dead_batch_run(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderRemoteObject* obj[3];
+    gulong id[G_N_ELEMENTS(obj)];
+    TestDeadBatch test;
+    guint i;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    for (i = 0; i < G_N_ELEMENTS(obj); i++) {
+        obj[i] = gbinder_object_registry_get_remote(reg, i + 1, TRUE);
+        id[i] = gbinder_remote_object_add_death_handler(obj[i],
+            test_dead_batch_done, &test);
+        test_binder_br_dead_binder(fd, i + 1);
+    }
+    /* The same death twice is only reported once */
+    test_binder_br_dead_binder(fd, 1);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, test.loop);
+    g_assert_cmpint(test.count, == ,3);
+
+    for (i = 0; i < G_N_ELEMENTS(obj); i++) {
+        g_assert(gbinder_remote_object_is_dead(obj[i]));
+        /* Dead handles are gone from the registry */
+        g_assert(!gbinder_object_registry_get_remote(reg, i + 1, FALSE));
+        gbinder_remote_object_remove_handler(obj[i], id[i]);
+        gbinder_remote_object_unref(obj[i]);
+    }
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_dead_batch(
+    void)
+{
+    test_run_in_context(&test_opt, test_dead_batch_run);
+}
+
+/*==========================================================================*
+ * handlers
+ *==========================================================================*/
+
+typedef struct test_handlers {
+    GMainLoop* loop;
+    GBinderRemoteObject* obj;
+    gulong id[3];
+    gulong added_id;
+    int count[3];
+    int added_count;
+} TestHandlers;
+
+static
+void
+test_handlers_added(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    TestHandlers* test = user_data;
+
+    test->added_count++;
+}
+
+static
+void
+test_handlers_first(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    TestHandlers* test = user_data;
+
+    g_assert(obj == test->obj);
+    test->count[0]++;
+    /* Remove the second one before it gets called, add another one */
+    gbinder_remote_object_remove_handler(obj, test->id[1]);
+    test->id[1] = 0;
+    test->added_id = gbinder_remote_object_add_death_handler(obj,
+        test_handlers_added, test);
+}
+
+static
+void
+test_handlers_second(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    TestHandlers* test = user_data;
+
+    test->count[1]++;
+}
+
+static
+void
+test_handlers_third(
+    GBinderRemoteObject* obj,
+    void* user_data)
+{
+    TestHandlers* test = user_data;
+
+    test->count[2]++;
+    test_quit_later(test->loop);
+}
+
+static
+void
+test_handlers_run(
+    void)
+{
+    const guint h = 1;
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    TestHandlers test;
+
+    memset(&test, 0, sizeof(test));
+    test.loop = g_main_loop_new(NULL, FALSE);
+    test.obj = gbinder_object_registry_get_remote(reg, h, TRUE);
+    g_assert(!test.obj->handlers);
+    test.id[0] = gbinder_remote_object_add_death_handler(test.obj,
+        test_handlers_first, &test);
+    test.id[1] = gbinder_remote_object_add_death_handler(test.obj,
+        test_handlers_second, &test);
+    test.id[2] = gbinder_remote_object_add_death_handler(test.obj,
+        test_handlers_third, &test);
+    g_assert(test.id[0]);
+    g_assert(test.id[1]);
+    g_assert(test.id[2]);
+    g_assert(test.id[0] != test.id[1]);
+    g_assert(test.id[1] != test.id[2]);
+
+    test_binder_br_dead_binder(fd, h);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    test_run(&test_opt, test.loop);
+    g_assert(gbinder_remote_object_is_dead(test.obj));
+
+    /* The one added during emission wasn't invoked */
+    g_assert_cmpint(test.count[0], == ,1);
+    g_assert_cmpint(test.count[1], == ,0);
+    g_assert_cmpint(test.count[2], == ,1);
+    g_assert_cmpint(test.added_count, == ,0);
+    g_assert(test.added_id);
+
+    gbinder_remote_object_remove_handler(test.obj, test.id[0]);
+    gbinder_remote_object_remove_handler(test.obj, test.id[2]);
+    gbinder_remote_object_remove_handler(test.obj, test.id[2]); /* Again */
+    gbinder_remote_object_remove_handler(test.obj, test.added_id);
+    g_assert(!test.obj->handlers);
+    gbinder_remote_object_unref(test.obj);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(test.loop);
+}
+
+static
+void
+test_handlers(
+    void)
+{
+    test_run_in_context(&test_opt, test_handlers_run);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -155,6 +348,8 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_PREFIX "null", test_null);
     g_test_add_func(TEST_PREFIX "basic", test_basic);
     g_test_add_func(TEST_PREFIX "dead", test_dead);
+    g_test_add_func(TEST_PREFIX "dead_batch", test_dead_batch);
+    g_test_add_func(TEST_PREFIX "handlers", test_handlers);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
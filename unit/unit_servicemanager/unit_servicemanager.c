@@ -38,15 +38,18 @@
 #include "gbinder_remote_object_p.h"
 #include "gbinder_ipc.h"
 #include "gbinder_local_object_p.h"
+#include "gbinder_local_request_p.h"
 #include "gbinder_servicemanager_p.h"
 #include "gbinder_object_registry.h"
 #include "gbinder_rpc_protocol.h"
+#include "gbinder_system.h"
 
 #include <gutil_strv.h>
 #include <gutil_macros.h>
 #include <gutil_log.h>
 
 #include <errno.h>
+#include <fcntl.h>
 
 static TestOpt test_opt;
 static const char TMP_DIR_TEMPLATE[] = "gbinder-test-servicemanager-XXXXXX";
@@ -148,6 +151,7 @@ typedef struct test_servicemanager {
     GBinderRemoteObject* remote;
     char** services;
     gboolean reject_name;
+    int get_count;
 } TestServiceManager;
 
 #define TEST_SERVICEMANAGER(obj) \
@@ -176,6 +180,7 @@ test_servicemanager_get_service(
 {
     TestServiceManager* self = TEST_SERVICEMANAGER(sm);
 
+    self->get_count++;
     if (gutil_strv_contains(self->services, name)) {
         if (!self->remote) {
             self->remote = gbinder_object_registry_get_remote
@@ -421,6 +426,10 @@ test_null(
     g_assert(!gbinder_servicemanager_new_local_object(NULL, NULL, NULL, NULL));
     g_assert(!gbinder_servicemanager_ref(NULL));
     g_assert(!gbinder_servicemanager_device(NULL));
+    g_assert(!gbinder_servicemanager_protocol(NULL));
+    g_assert(!gbinder_servicemanager_buffer_space(NULL));
+    g_assert(!gbinder_servicemanager_buffer_pinned(NULL));
+    gbinder_servicemanager_set_main_context(NULL, NULL);
     g_assert(!gbinder_servicemanager_is_present(NULL));
     g_assert(!gbinder_servicemanager_wait(NULL, 0));
     g_assert(!gbinder_servicemanager_list(NULL, NULL, NULL));
@@ -507,6 +516,9 @@ test_basic(
         test_transact_func, NULL);
     g_assert(obj);
     g_assert_cmpstr(gbinder_servicemanager_device(sm), == ,dev);
+    g_assert_cmpstr(gbinder_servicemanager_protocol(sm), == ,"hidl");
+    g_assert(gbinder_servicemanager_buffer_space(sm));
+    g_assert_cmpuint(gbinder_servicemanager_buffer_pinned(sm), == ,0);
     gbinder_local_object_unref(obj);
 
     g_assert(gbinder_servicemanager_ref(sm) == sm);
@@ -619,6 +631,7 @@ test_config(
     test_setup_ping(ipc);
     sm = gbinder_servicemanager_new(legacy_name);
     g_assert(TEST_IS_DEFSERVICEMANAGER(sm));
+    g_assert_cmpstr(gbinder_servicemanager_protocol(sm), == ,"aidl");
     gbinder_servicemanager_unref(sm);
     gbinder_ipc_unref(ipc);
 
@@ -937,6 +950,135 @@ test_reanimate(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * presence_watch
+ *==========================================================================*/
+
+typedef struct test_presence_watch {
+    char* dir;
+    char* file;
+    GBinderIpc* ipc;
+    GBinderServiceManager* sm;
+} TestPresenceWatch;
+
+static
+void
+test_presence_watch_init(
+    TestPresenceWatch* test,
+    const char* dev)
+{
+    /* Make sure that only the watch can trigger the ping */
+    static const char config[] =
+        "[PresenceCheckMinDelay]\n"
+        "Default = 600000\n";
+
+    memset(test, 0, sizeof(*test));
+    gbinder_servicemanager_exit();
+    gbinder_config_exit();
+    test->dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    test->file = g_build_filename(test->dir, "test.conf", NULL);
+    g_assert(g_file_set_contents(test->file, config, -1, NULL));
+    gbinder_config_file = test->file;
+    test_binder_set_watch_enabled(TRUE);
+
+    /* This makes presence detection PING fail */
+    test->ipc = gbinder_ipc_new(dev, NULL);
+    test_binder_br_reply_status(gbinder_driver_fd(test->ipc->driver), -1);
+    test->sm = gbinder_servicemanager_new(dev);
+    g_assert(test->sm);
+    g_assert(!gbinder_servicemanager_is_present(test->sm));
+
+    /* Watcher thread must be running now */
+    g_assert_cmpuint(test_binder_watch_count(dev), == ,1);
+}
+
+static
+void
+test_presence_watch_deinit(
+    TestPresenceWatch* test)
+{
+    gbinder_servicemanager_unref(test->sm);
+    gbinder_ipc_unref(test->ipc);
+    gbinder_ipc_exit();
+    test_binder_set_watch_enabled(FALSE);
+    gbinder_servicemanager_exit();
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+    remove(test->file);
+    remove(test->dir);
+    g_free(test->file);
+    g_free(test->dir);
+}
+
+static
+void
+test_presence_watch(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_HWBINDER;
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    TestPresenceWatch test;
+    int fd, node;
+    gulong id;
+
+    test_presence_watch_init(&test, dev);
+    fd = gbinder_driver_fd(test.ipc->driver);
+    id = gbinder_servicemanager_add_presence_handler(test.sm, test_quit, loop);
+    g_assert(id);
+
+    /* This makes the next PING succeed */
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_reply(fd, 0, 0, NULL);
+
+    /* Opening the device pings the service manager right away */
+    node = gbinder_system_open(dev, O_RDWR | O_CLOEXEC);
+    g_assert_cmpint(node, >= ,0);
+    test_run(&test_opt, loop);
+    g_assert(gbinder_servicemanager_is_present(test.sm));
+    gbinder_system_close(node);
+
+    /* The watch is stopped once service manager is back */
+    g_assert_cmpuint(test_binder_watch_count(dev), == ,0);
+
+    gbinder_servicemanager_remove_handler(test.sm, id);
+    test_presence_watch_deinit(&test);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * presence_watch_unref
+ *==========================================================================*/
+
+static
+void
+test_presence_watch_unref(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_HWBINDER;
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    TestPresenceWatch test;
+    int node;
+
+    test_presence_watch_init(&test, dev);
+
+    /* Wake up the watcher thread and drop the service manager */
+    node = gbinder_system_open(dev, O_RDWR | O_CLOEXEC);
+    g_assert_cmpint(node, >= ,0);
+    gbinder_servicemanager_unref(test.sm);
+    test.sm = NULL;
+
+    /* The thread must have stopped and closed its end of the watch */
+    g_assert_cmpuint(test_binder_watch_count(dev), == ,0);
+
+    /* The poke (if it got queued) finds nothing to ping */
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    gbinder_system_close(node);
+
+    test_presence_watch_deinit(&test);
+    g_main_loop_unref(loop);
+}
+
 /*==========================================================================*
  * reuse
  *==========================================================================*/
@@ -1098,6 +1240,86 @@ test_list(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * list_by_interface
+ *==========================================================================*/
+
+#define TEST_LIST_IFACE "foo@1.0::IFoo"
+
+static
+gboolean
+test_list_by_interface_func(
+    GBinderServiceManager* sm,
+    char** services,
+    void* user_data)
+{
+    g_assert_cmpuint(gutil_strv_length(services), == ,2);
+    g_assert_cmpstr(services[0], == ,TEST_LIST_IFACE "/default");
+    g_assert_cmpstr(services[1], == ,TEST_LIST_IFACE "/slot1");
+    test_quit_later((GMainLoop*)user_data);
+    return FALSE;
+}
+
+static
+void
+test_list_by_interface(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceManager* sm;
+    TestHwServiceManager* test;
+    char** list;
+
+    test_setup_ping(ipc);
+    sm = gbinder_servicemanager_new(dev);
+    test = TEST_SERVICEMANAGER(sm);
+    test->services = gutil_strv_add(test->services, TEST_LIST_IFACE);
+    test->services = gutil_strv_add(test->services, TEST_LIST_IFACE "/");
+    test->services = gutil_strv_add(test->services, TEST_LIST_IFACE
+        "/default");
+    test->services = gutil_strv_add(test->services, TEST_LIST_IFACE "2/x");
+    test->services = gutil_strv_add(test->services, TEST_LIST_IFACE
+        "/slot1");
+    test->services = gutil_strv_add(test->services, "bar");
+
+    /* Invalid parameters */
+    g_assert(!gbinder_servicemanager_list_by_interface_sync(NULL,
+        TEST_LIST_IFACE));
+    g_assert(!gbinder_servicemanager_list_by_interface_sync(sm, NULL));
+    g_assert(!gbinder_servicemanager_list_by_interface(NULL,
+        TEST_LIST_IFACE, test_list_by_interface_func, loop));
+    g_assert(!gbinder_servicemanager_list_by_interface(sm, NULL,
+        test_list_by_interface_func, loop));
+    g_assert(!gbinder_servicemanager_list_by_interface(sm,
+        TEST_LIST_IFACE, NULL, NULL));
+
+    /* Only "iface/instance" names are picked */
+    list = gbinder_servicemanager_list_by_interface_sync(sm,
+        TEST_LIST_IFACE);
+    g_assert_cmpuint(gutil_strv_length(list), == ,2);
+    g_assert_cmpstr(list[0], == ,TEST_LIST_IFACE "/default");
+    g_assert_cmpstr(list[1], == ,TEST_LIST_IFACE "/slot1");
+    g_strfreev(list);
+
+    /* Nothing matches */
+    list = gbinder_servicemanager_list_by_interface_sync(sm, "baz");
+    g_assert(list);
+    g_assert(!list[0]);
+    g_strfreev(list);
+
+    /* Same thing asynchronously */
+    g_assert(gbinder_servicemanager_list_by_interface(sm, TEST_LIST_IFACE,
+        test_list_by_interface_func, loop));
+    test_run(&test_opt, loop);
+
+    gbinder_servicemanager_unref(sm);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(loop);
+}
+
 /*==========================================================================*
  * get
  *==========================================================================*/
@@ -1162,6 +1384,310 @@ test_get(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * cache
+ *==========================================================================*/
+
+static
+void
+test_cache(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceManager* sm;
+    TestHwServiceManager* test;
+    GBinderRemoteObject* remote;
+    GBinderLocalObject* obj;
+    GBinderIpc* ipc;
+    int status = -1;
+
+    static const char config[] =
+        "[ServiceCache]\n"
+        "Default = 1\n";
+
+    /* Reset the state */
+    gbinder_servicemanager_exit();
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(dev, NULL);
+    test_setup_ping(ipc);
+    sm = gbinder_servicemanager_new(dev);
+    test = TEST_SERVICEMANAGER(sm);
+    obj = gbinder_servicemanager_new_local_object(sm, "foo.bar",
+       test_transact_func, NULL);
+    g_assert(gbinder_servicemanager_add_service_sync(sm, "foo", obj) ==
+        GBINDER_STATUS_OK);
+    gbinder_local_object_unref(obj);
+
+    /* Second lookup doesn't go to the service manager */
+    remote = gbinder_servicemanager_get_service_sync(sm, "foo", &status);
+    g_assert(remote);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(test->get_count, == ,1);
+    status = -1;
+    g_assert(gbinder_servicemanager_get_service_sync(sm, "foo", &status) ==
+        remote);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(test->get_count, == ,1);
+
+    /* Neither does the asynchronous one */
+    g_assert(gbinder_servicemanager_get_service(sm, "foo", test_get_func,
+        loop));
+    test_run(&test_opt, loop);
+    g_assert_cmpint(test->get_count, == ,1);
+
+    /* Registration invalidates the cache entry */
+    gbinder_servicemanager_service_registered(sm, "foo");
+    g_assert(gbinder_servicemanager_get_service_sync(sm, "foo", NULL));
+    g_assert_cmpint(test->get_count, == ,2);
+    g_assert(gbinder_servicemanager_get_service_sync(sm, "foo", NULL));
+    g_assert_cmpint(test->get_count, == ,2);
+
+    /* And so does the death of the object */
+    gbinder_remote_object_commit_suicide(remote);
+    g_assert(gbinder_servicemanager_get_service_sync(sm, "foo", NULL));
+    g_assert_cmpint(test->get_count, == ,3);
+
+    /* Names which aren't found aren't cached */
+    g_assert(!gbinder_servicemanager_get_service_sync(sm, "bar", &status));
+    g_assert_cmpint(status, == ,-ENOENT);
+    g_assert(!gbinder_servicemanager_get_service_sync(sm, "bar", &status));
+    g_assert_cmpint(test->get_count, == ,5);
+
+    gbinder_servicemanager_unref(sm);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_servicemanager_exit();
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+/*==========================================================================*
+ * get_services
+ *==========================================================================*/
+
+static
+void
+test_get_services_never(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    void* user_data)
+{
+    g_assert_not_reached();
+}
+
+static
+void
+test_get_services_partial(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    void* user_data)
+{
+    g_assert_cmpuint(count, == ,2);
+    g_assert(objects[0]);
+    g_assert(!objects[1]);
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+void
+test_get_services_all(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* const* objects,
+    guint count,
+    void* user_data)
+{
+    g_assert_cmpuint(count, == ,2);
+    g_assert(objects[0]);
+    g_assert(objects[1]);
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+gboolean
+test_get_services_add_bar(
+    gpointer user_data)
+{
+    GBinderServiceManager* sm = user_data;
+    TestHwServiceManager* test = TEST_SERVICEMANAGER(sm);
+
+    GDEBUG("Registering bar");
+    test->services = gutil_strv_add(test->services, "bar");
+    gbinder_servicemanager_service_registered(sm, "bar");
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+test_get_services(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    const char* none[] = { NULL };
+    const char* names[] = { "foo", "bar", NULL };
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceManager* sm;
+    GBinderLocalObject* obj;
+    gulong id;
+
+    test_setup_ping(ipc);
+    sm = gbinder_servicemanager_new(dev);
+    obj = gbinder_servicemanager_new_local_object(sm, "foo.bar",
+       test_transact_func, NULL);
+    g_assert(gbinder_servicemanager_add_service_sync(sm, "foo", obj) ==
+        GBINDER_STATUS_OK);
+    gbinder_local_object_unref(obj);
+
+    /* Invalid parameters */
+    g_assert(!gbinder_servicemanager_get_services(NULL, names, 0,
+        test_get_services_never, NULL));
+    g_assert(!gbinder_servicemanager_get_services(sm, NULL, 0,
+        test_get_services_never, NULL));
+    g_assert(!gbinder_servicemanager_get_services(sm, none, 0,
+        test_get_services_never, NULL));
+    g_assert(!gbinder_servicemanager_get_services(sm, names, 0,
+        NULL, NULL));
+
+    /* Cancelled batch never completes */
+    id = gbinder_servicemanager_get_services(sm, names, 0,
+        test_get_services_never, NULL);
+    g_assert(id);
+    gbinder_servicemanager_cancel(sm, id);
+
+    /* Without waiting, the missing name is reported right away */
+    g_assert(gbinder_servicemanager_get_services(sm, names, 0,
+        test_get_services_partial, loop));
+    test_run(&test_opt, loop);
+
+    /* Or after the deadline */
+    g_assert(gbinder_servicemanager_get_services(sm, names, 100,
+        test_get_services_partial, loop));
+    test_run(&test_opt, loop);
+
+    /* Until then, missing names are picked up as they get registered */
+    g_assert(gbinder_servicemanager_get_services(sm, names, 10000,
+        test_get_services_all, loop));
+    g_timeout_add(100, test_get_services_add_bar, sm);
+    test_run(&test_opt, loop);
+
+    gbinder_servicemanager_unref(sm);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * ping_many
+ *==========================================================================*/
+
+static
+void
+test_ping_many_done(
+    GBinderServiceManager* sm,
+    const guint8* results,
+    guint count,
+    void* user_data)
+{
+    g_assert_cmpuint(count, == ,2);
+    g_assert_cmpuint(results[0], == ,GBINDER_PING_ALIVE);
+    g_assert_cmpuint(results[1], == ,GBINDER_PING_DEAD);
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+void
+test_ping_many_never(
+    GBinderServiceManager* sm,
+    const guint8* results,
+    guint count,
+    void* user_data)
+{
+    g_assert_not_reached();
+}
+
+static
+void
+test_ping_many_run(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GBinderServiceManager* sm;
+    GBinderLocalObject* obj;
+    GBinderRemoteObject* objects[2];
+    guint handle;
+    gulong id;
+
+    test_setup_ping(ipc);
+    sm = gbinder_servicemanager_new(dev);
+    obj = gbinder_local_object_new(ipc, NULL, NULL, NULL);
+    test_binder_set_passthrough(fd, TRUE);
+    test_binder_set_looper_enabled(fd, TEST_LOOPER_ENABLE);
+    handle = test_binder_register_object(fd, obj, AUTO_HANDLE);
+    objects[0] = gbinder_object_registry_get_remote(reg, handle, FALSE);
+    objects[1] = gbinder_object_registry_get_remote(reg, handle + 1, FALSE);
+
+    /* Invalid parameters */
+    g_assert(!gbinder_servicemanager_ping_many(NULL, objects, 2, 0,
+        test_ping_many_never, NULL));
+    g_assert(!gbinder_servicemanager_ping_many(sm, NULL, 2, 0,
+        test_ping_many_never, NULL));
+    g_assert(!gbinder_servicemanager_ping_many(sm, objects, 0, 0,
+        test_ping_many_never, NULL));
+    g_assert(!gbinder_servicemanager_ping_many(sm, objects, 2, 0,
+        NULL, NULL));
+
+    /* Existing and non-existent handle */
+    g_assert(gbinder_servicemanager_ping_many(sm, objects, 2, 0,
+        test_ping_many_done, loop));
+    test_run(&test_opt, loop);
+
+    /* Cancelled ping never completes */
+    id = gbinder_servicemanager_ping_many(sm, objects, 2, 0,
+        test_ping_many_never, NULL);
+    g_assert(id);
+    gbinder_servicemanager_cancel(sm, id);
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+
+    gbinder_remote_object_unref(objects[0]);
+    gbinder_remote_object_unref(objects[1]);
+    test_binder_unregister_objects(fd);
+    gbinder_local_object_unref(obj);
+    gbinder_servicemanager_unref(sm);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_ping_many(
+    void)
+{
+    test_run_in_context(&test_opt, test_ping_many_run);
+}
+
 /*==========================================================================*
  * add
  *==========================================================================*/
@@ -1210,6 +1736,65 @@ test_add(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * oneway_spam
+ *==========================================================================*/
+
+static
+void
+test_oneway_spam(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    const guint32 flags = GBINDER_TX_FLAG_ONEWAY | GBINDER_TX_FLAG_DIRECT;
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceManager* sm;
+    int count = 0, count2 = 0;
+    gulong id, id2;
+
+    test_setup_ping(ipc);
+    sm = gbinder_servicemanager_new(dev);
+    g_assert(!gbinder_servicemanager_add_oneway_spam_handler(NULL, test_inc,
+        &count));
+    g_assert(!gbinder_servicemanager_add_oneway_spam_handler(sm, NULL,
+        NULL));
+    id = gbinder_servicemanager_add_oneway_spam_handler(sm, test_inc,
+        &count);
+    id2 = gbinder_servicemanager_add_oneway_spam_handler(sm, test_inc,
+        &count2);
+    g_assert(id);
+    g_assert(id2);
+
+    /* Both handlers get notified */
+    test_binder_br_oneway_spam_suspect(fd);
+    g_assert(gbinder_ipc_transact(ipc, 0, 1, flags, req, NULL, NULL, NULL));
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpint(count, == ,1);
+    g_assert_cmpint(count2, == ,1);
+
+    /* The removed one doesn't */
+    gbinder_servicemanager_remove_handler(sm, id2);
+    test_binder_br_oneway_spam_suspect(fd);
+    g_assert(gbinder_ipc_transact(ipc, 0, 1, flags, req, NULL, NULL, NULL));
+    test_quit_later(loop);
+    test_run(&test_opt, loop);
+    g_assert_cmpint(count, == ,2);
+    g_assert_cmpint(count2, == ,1);
+
+    gbinder_servicemanager_remove_handler(sm, id);
+    gbinder_servicemanager_unref(sm);
+    gbinder_local_request_unref(req);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    test_binder_exit_wait(&test_opt, loop);
+    g_main_loop_unref(loop);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -1233,11 +1818,18 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("wait_async"), test_wait_async);
     g_test_add_func(TEST_("death"), test_death);
     g_test_add_func(TEST_("reanimate"), test_reanimate);
+    g_test_add_func(TEST_("presence_watch"), test_presence_watch);
+    g_test_add_func(TEST_("presence_watch_unref"), test_presence_watch_unref);
     g_test_add_func(TEST_("reuse"), test_reuse);
     g_test_add_func(TEST_("notify"), test_notify);
     g_test_add_func(TEST_("list"), test_list);
+    g_test_add_func(TEST_("list_by_interface"), test_list_by_interface);
     g_test_add_func(TEST_("get"), test_get);
+    g_test_add_func(TEST_("cache"), test_cache);
+    g_test_add_func(TEST_("get_services"), test_get_services);
+    g_test_add_func(TEST_("ping_many"), test_ping_many);
     g_test_add_func(TEST_("add"), test_add);
+    g_test_add_func(TEST_("oneway_spam"), test_oneway_spam);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
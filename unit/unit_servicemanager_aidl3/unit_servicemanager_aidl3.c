@@ -32,6 +32,7 @@
 
 #include "test_binder.h"
 
+#include "gbinder_client.h"
 #include "gbinder_driver.h"
 #include "gbinder_config.h"
 #include "gbinder_ipc.h"
@@ -40,6 +41,7 @@
 #include "gbinder_rpc_protocol.h"
 #include "gbinder_local_object_p.h"
 #include "gbinder_local_reply.h"
+#include "gbinder_local_request.h"
 #include "gbinder_remote_request.h"
 #include "gbinder_remote_object.h"
 #include "gbinder_writer.h"
@@ -76,16 +78,29 @@ enum servicemanager_aidl_tx {
     GET_SERVICE_TRANSACTION = GBINDER_FIRST_CALL_TRANSACTION,
     CHECK_SERVICE_TRANSACTION,
     ADD_SERVICE_TRANSACTION,
-    LIST_SERVICES_TRANSACTION
+    LIST_SERVICES_TRANSACTION,
+    REGISTER_FOR_NOTIFICATIONS_TRANSACTION,
+    UNREGISTER_FOR_NOTIFICATIONS_TRANSACTION
 };
 
+static const char SVCMGR_CALLBACK_IFACE[] = "android.os.IServiceCallback";
+
 const char* const servicemanager_aidl_ifaces[] = { SVCMGR_IFACE, NULL };
 
+typedef enum test_list_mode {
+    TEST_LIST_DEFAULT,
+    TEST_LIST_BY_INDEX,         /* Rejects the single-shot request */
+    TEST_LIST_NEGATIVE_COUNT,
+    TEST_LIST_BAD_NAME          /* The last name is truncated */
+} TEST_LIST_MODE;
+
 typedef GBinderLocalObjectClass ServiceManagerAidl3Class;
 typedef struct service_manager_aidl3 {
     GBinderLocalObject parent;
     GHashTable* objects;
+    GHashTable* callbacks;
     gboolean handle_on_looper_thread;
+    TEST_LIST_MODE list_mode;
 } ServiceManagerAidl3;
 
 #define SERVICE_MANAGER_AIDL3_TYPE (service_manager_aidl3_get_type())
@@ -146,7 +161,27 @@ servicemanager_aidl3_handler(
         if (str && remote_obj && stability == 0b001100 &&
             gbinder_reader_read_uint32(&reader, &allow_isolated) &&
             gbinder_reader_read_uint32(&reader, &dumpsys_priority)) {
+            GBinderRemoteObject* cb = g_hash_table_lookup(self->callbacks,
+                str);
+
             GDEBUG("Adding '%s'", str);
+            if (cb) {
+                GBinderClient* client = gbinder_client_new(cb,
+                    SVCMGR_CALLBACK_IFACE);
+                GBinderLocalRequest* notify = gbinder_client_new_request
+                    (client);
+                GBinderWriter writer;
+
+                /* oneway void onRegistration(String name, IBinder binder) */
+                GDEBUG("Notifying %p", cb);
+                gbinder_local_request_init_writer(notify, &writer);
+                gbinder_writer_append_string16(&writer, str);
+                gbinder_writer_append_remote_object(&writer, remote_obj);
+                gbinder_client_transact(client, GBINDER_FIRST_CALL_TRANSACTION,
+                    GBINDER_TX_FLAG_ONEWAY, notify, NULL, NULL, NULL);
+                gbinder_local_request_unref(notify);
+                gbinder_client_unref(client);
+            }
             g_hash_table_replace(self->objects, str, remote_obj);
             remote_obj = NULL;
             str = NULL;
@@ -159,23 +194,82 @@ servicemanager_aidl3_handler(
     case LIST_SERVICES_TRANSACTION:
         gbinder_remote_request_init_reader(req, &reader);
         if (gbinder_reader_read_uint32(&reader, &dumpsys_priority)) {
-            if (g_hash_table_size(self->objects) == 1) {
-                GList* keys = g_hash_table_get_keys(self->objects);
-                GList* l = g_list_nth(keys, 0);
+            const guint32 pos = dumpsys_priority;
+            GList* keys = g_list_sort(g_hash_table_get_keys(self->objects),
+                (GCompareFunc) g_strcmp0);
+            GBinderWriter writer;
+            GList* l;
+
+            if (gbinder_reader_read_uint32(&reader, &dumpsys_priority)) {
+                /* Pre-Android 11 request, one name per transaction */
+                l = g_list_nth(keys, pos);
+                if (l) {
+                    reply = gbinder_local_object_new_reply(obj);
+                    gbinder_local_reply_append_string16(reply, l->data);
+                    *status = GBINDER_STATUS_OK;
+                }
+            } else if (self->list_mode == TEST_LIST_BY_INDEX) {
+                GDEBUG("Rejecting single-shot list request");
+            } else if (self->list_mode == TEST_LIST_NEGATIVE_COUNT) {
+                reply = gbinder_local_object_new_reply(obj);
+                gbinder_local_reply_init_writer(reply, &writer);
+                gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
+                gbinder_writer_append_int32(&writer, -1);
+                *status = GBINDER_STATUS_OK;
+            } else if (self->list_mode == TEST_LIST_BAD_NAME) {
+                reply = gbinder_local_object_new_reply(obj);
+                gbinder_local_reply_init_writer(reply, &writer);
+                gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
+                gbinder_writer_append_int32(&writer, g_list_length(keys) + 1);
+                for (l = keys; l; l = l->next) {
+                    gbinder_writer_append_string16(&writer, l->data);
+                }
+                /* Length of the last name but no characters */
+                gbinder_writer_append_int32(&writer, 100);
+                *status = GBINDER_STATUS_OK;
+            } else if (g_list_length(keys) == 1) {
                 gint32 srv_size = 1;
-                GBinderWriter writer;
 
                 reply = gbinder_local_object_new_reply(obj);
                 gbinder_local_reply_init_writer(reply, &writer);
                 gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
                 gbinder_writer_append_int32(&writer, srv_size);
-                gbinder_writer_append_string16(&writer, l->data);
-                g_list_free(keys);
+                gbinder_writer_append_string16(&writer, keys->data);
                 *status = GBINDER_STATUS_OK;
             } else {
                 GDEBUG("Incorrect number of services %u",
-                    g_hash_table_size(self->objects));
+                    g_list_length(keys));
             }
+            g_list_free(keys);
+        }
+        break;
+    case REGISTER_FOR_NOTIFICATIONS_TRANSACTION:
+        gbinder_remote_request_init_reader(req, &reader);
+        str = gbinder_reader_read_string16(&reader);
+        remote_obj = gbinder_reader_read_object(&reader);
+        if (str && remote_obj && gbinder_reader_read_int32(&reader,
+            &stability) && stability == SYSTEM) {
+            GDEBUG("Watching '%s'", str);
+            g_hash_table_replace(self->callbacks, str, remote_obj);
+            remote_obj = NULL;
+            str = NULL;
+            reply = gbinder_local_object_new_reply(obj);
+            gbinder_local_reply_append_int32(reply, GBINDER_STATUS_OK);
+            *status = GBINDER_STATUS_OK;
+        }
+        g_free(str);
+        gbinder_remote_object_unref(remote_obj);
+        break;
+    case UNREGISTER_FOR_NOTIFICATIONS_TRANSACTION:
+        gbinder_remote_request_init_reader(req, &reader);
+        str = gbinder_reader_read_string16(&reader);
+        if (str) {
+            GDEBUG("Unwatching '%s'", str);
+            g_hash_table_remove(self->callbacks, str);
+            reply = gbinder_local_object_new_reply(obj);
+            gbinder_local_reply_append_int32(reply, GBINDER_STATUS_OK);
+            *status = GBINDER_STATUS_OK;
+            g_free(str);
         }
         break;
     default:
@@ -249,6 +343,7 @@ service_manager_aidl3_finalize(
     ServiceManagerAidl3* self = SERVICE_MANAGER_AIDL3(object);
 
     g_hash_table_destroy(self->objects);
+    g_hash_table_destroy(self->callbacks);
     G_OBJECT_CLASS(service_manager_aidl3_parent_class)->finalize(object);
 }
 
@@ -259,6 +354,8 @@ service_manager_aidl3_init(
 {
     self->objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
         (GDestroyNotify) gbinder_remote_object_unref);
+    self->callbacks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) gbinder_remote_object_unref);
 }
 
 static
@@ -446,6 +543,168 @@ test_list()
     test_run_in_context(&test_opt, test_list_run);
 }
 
+/*==========================================================================*
+ * list/by_index
+ *==========================================================================*/
+
+static
+void
+test_list_by_index_run()
+{
+    TestContext test;
+    char** list;
+
+    test_context_init(&test);
+    test.service->list_mode = TEST_LIST_BY_INDEX;
+
+    /* Nothing is there yet */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert(list);
+    g_assert(!list[0]);
+    g_strfreev(list);
+
+    /* Register the same object under two names */
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "a", test.object), == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "b", test.object), == ,GBINDER_STATUS_OK);
+
+    /* Single-shot request fails, names are fetched one by one */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert_cmpuint(gutil_strv_length(list), == ,2);
+    g_assert_cmpstr(list[0], == ,"a");
+    g_assert_cmpstr(list[1], == ,"b");
+    g_strfreev(list);
+
+    test_context_deinit(&test);
+}
+
+static
+void
+test_list_by_index()
+{
+    test_run_in_context(&test_opt, test_list_by_index_run);
+}
+
+/*==========================================================================*
+ * list/negative_count
+ *==========================================================================*/
+
+static
+void
+test_list_negative_count_run()
+{
+    TestContext test;
+    char** list;
+
+    test_context_init(&test);
+    test.service->list_mode = TEST_LIST_NEGATIVE_COUNT;
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "name", test.object), == ,GBINDER_STATUS_OK);
+
+    /* Negative count is treated as an empty list */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert(list);
+    g_assert(!list[0]);
+    g_strfreev(list);
+
+    test_context_deinit(&test);
+}
+
+static
+void
+test_list_negative_count()
+{
+    test_run_in_context(&test_opt, test_list_negative_count_run);
+}
+
+/*==========================================================================*
+ * list/bad_name
+ *==========================================================================*/
+
+static
+void
+test_list_bad_name_run()
+{
+    TestContext test;
+    char** list;
+
+    test_context_init(&test);
+    test.service->list_mode = TEST_LIST_BAD_NAME;
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "a", test.object), == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "b", test.object), == ,GBINDER_STATUS_OK);
+
+    /* The list stops at the malformed name */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert_cmpuint(gutil_strv_length(list), == ,2);
+    g_assert_cmpstr(list[0], == ,"a");
+    g_assert_cmpstr(list[1], == ,"b");
+    g_strfreev(list);
+
+    test_context_deinit(&test);
+}
+
+static
+void
+test_list_bad_name()
+{
+    test_run_in_context(&test_opt, test_list_bad_name_run);
+}
+
+/*==========================================================================*
+ * notify
+ *==========================================================================*/
+
+static
+void
+test_notify_cb(
+    GBinderServiceManager* sm,
+    const char* name,
+    void* user_data)
+{
+    g_assert_cmpstr(name, == ,"name");
+    GDEBUG("'%s' is registered", name);
+    g_main_loop_quit(user_data);
+}
+
+static
+void
+test_notify_run()
+{
+    TestContext test;
+    const char* name = "name";
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    gulong id;
+
+    test_context_init(&test);
+
+    /* The watch is registered with the service manager */
+    id = gbinder_servicemanager_add_registration_handler(test.client, name,
+        test_notify_cb, loop);
+    g_assert(id);
+    g_assert_cmpuint(g_hash_table_size(test.service->callbacks), == ,1);
+    g_assert(g_hash_table_contains(test.service->callbacks, name));
+
+    /* Register object and wait for the notification */
+    GDEBUG("Registering object '%s' => %p", name, test.object);
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        name, test.object), == ,GBINDER_STATUS_OK);
+    test_run(&test_opt, loop);
+
+    gbinder_servicemanager_remove_handler(test.client, id);
+    test_context_deinit(&test);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_notify()
+{
+    test_run_in_context(&test_opt, test_notify_run);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -460,6 +719,10 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_("get"), test_get);
     g_test_add_func(TEST_("list"), test_list);
+    g_test_add_func(TEST_("list/by_index"), test_list_by_index);
+    g_test_add_func(TEST_("list/negative_count"), test_list_negative_count);
+    g_test_add_func(TEST_("list/bad_name"), test_list_bad_name);
+    g_test_add_func(TEST_("notify"), test_notify);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
@@ -42,6 +42,8 @@
 #include "gbinder_local_reply.h"
 #include "gbinder_remote_request.h"
 #include "gbinder_remote_object.h"
+#include "gbinder_servicename.h"
+#include "gbinder_client.h"
 #include "gbinder_writer.h"
 
 #include <gutil_strv.h>
@@ -72,20 +74,36 @@ gbinder_servicemanager_hidl_get_type()
 
 #define SVCMGR_HANDLE (0)
 static const char SVCMGR_IFACE[] = "android.os.IServiceManager";
+static const char SVCMGR_CLIENT_CALLBACK_IFACE[] =
+    "android.os.IClientCallback";
 enum servicemanager_aidl_tx {
     GET_SERVICE_TRANSACTION = GBINDER_FIRST_CALL_TRANSACTION,
     CHECK_SERVICE_TRANSACTION,
     ADD_SERVICE_TRANSACTION,
-    LIST_SERVICES_TRANSACTION
+    LIST_SERVICES_TRANSACTION,
+    REGISTER_CLIENT_CALLBACK_TRANSACTION = GBINDER_FIRST_CALL_TRANSACTION + 9,
+    TRY_UNREGISTER_SERVICE_TRANSACTION
 };
 
+#define EX_ILLEGAL_STATE (-5)
+
 const char* const servicemanager_aidl_ifaces[] = { SVCMGR_IFACE, NULL };
 
+typedef enum test_list_mode {
+    TEST_LIST_DEFAULT,
+    TEST_LIST_BY_INDEX,         /* Rejects the single-shot request */
+    TEST_LIST_NEGATIVE_COUNT,
+    TEST_LIST_BAD_NAME          /* The last name is truncated */
+} TEST_LIST_MODE;
+
 typedef GBinderLocalObjectClass ServiceManagerAidl4Class;
 typedef struct service_manager_aidl4 {
     GBinderLocalObject parent;
     GHashTable* objects;
+    GHashTable* client_callbacks;
+    gboolean has_clients;
     gboolean handle_on_looper_thread;
+    TEST_LIST_MODE list_mode;
 } ServiceManagerAidl4;
 
 #define SERVICE_MANAGER_AIDL4_TYPE (service_manager_aidl4_get_type())
@@ -174,25 +192,109 @@ servicemanager_aidl4_handler(
     case LIST_SERVICES_TRANSACTION:
         gbinder_remote_request_init_reader(req, &reader);
         if (gbinder_reader_read_uint32(&reader, &dumpsys_priority)) {
-            if (g_hash_table_size(self->objects) == 1) {
-                GList* keys = g_hash_table_get_keys(self->objects);
-                GList* l = g_list_nth(keys, 0);
+            const guint32 pos = dumpsys_priority;
+            GList* keys = g_list_sort(g_hash_table_get_keys(self->objects),
+                (GCompareFunc) g_strcmp0);
+            GBinderWriter writer;
+            GList* l;
+
+            if (gbinder_reader_read_uint32(&reader, &dumpsys_priority)) {
+                /* Pre-Android 11 request, one name per transaction */
+                l = g_list_nth(keys, pos);
+                if (l) {
+                    reply = gbinder_local_object_new_reply(obj);
+                    gbinder_local_reply_append_string16(reply, l->data);
+                    *status = GBINDER_STATUS_OK;
+                }
+            } else if (self->list_mode == TEST_LIST_BY_INDEX) {
+                GDEBUG("Rejecting single-shot list request");
+            } else if (self->list_mode == TEST_LIST_NEGATIVE_COUNT) {
+                reply = gbinder_local_object_new_reply(obj);
+                gbinder_local_reply_init_writer(reply, &writer);
+                gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
+                gbinder_writer_append_int32(&writer, -1);
+                *status = GBINDER_STATUS_OK;
+            } else if (self->list_mode == TEST_LIST_BAD_NAME) {
+                reply = gbinder_local_object_new_reply(obj);
+                gbinder_local_reply_init_writer(reply, &writer);
+                gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
+                gbinder_writer_append_int32(&writer, g_list_length(keys) + 1);
+                for (l = keys; l; l = l->next) {
+                    gbinder_writer_append_string16(&writer, l->data);
+                }
+                /* Length of the last name but no characters */
+                gbinder_writer_append_int32(&writer, 100);
+                *status = GBINDER_STATUS_OK;
+            } else if (g_list_length(keys) == 1) {
                 gint32 srv_size = 1;
-                GBinderWriter writer;
 
                 reply = gbinder_local_object_new_reply(obj);
                 gbinder_local_reply_init_writer(reply, &writer);
                 gbinder_writer_append_int32(&writer, GBINDER_STATUS_OK);
                 gbinder_writer_append_int32(&writer, srv_size);
-                gbinder_writer_append_string16(&writer, l->data);
-                g_list_free(keys);
+                gbinder_writer_append_string16(&writer, keys->data);
                 *status = GBINDER_STATUS_OK;
             } else {
                 GDEBUG("Incorrect number of services %u",
-                    g_hash_table_size(self->objects));
+                    g_list_length(keys));
             }
+            g_list_free(keys);
         }
         break;
+    case REGISTER_CLIENT_CALLBACK_TRANSACTION:
+        gbinder_remote_request_init_reader(req, &reader);
+        str = gbinder_reader_read_string16(&reader);
+        remote_obj = gbinder_reader_read_object(&reader);
+        if (str && remote_obj &&
+            gbinder_reader_read_uint32(&reader, (guint32*)&category) &&
+            g_hash_table_lookup(self->objects, str) == remote_obj) {
+            GBinderRemoteObject* cb = gbinder_reader_read_object(&reader);
+            GBinderClient* client = gbinder_client_new(cb,
+                SVCMGR_CLIENT_CALLBACK_IFACE);
+            GBinderLocalRequest* notify = gbinder_client_new_request(client);
+            GBinderWriter writer;
+
+            /* oneway void onClients(IBinder registered, boolean hasClients) */
+            GDEBUG("Client callback for '%s'", str);
+            gbinder_local_request_init_writer(notify, &writer);
+            gbinder_writer_append_remote_object(&writer, remote_obj);
+            gbinder_writer_append_int32(&writer, (SYSTEM << 24) | 1);
+            gbinder_writer_append_bool(&writer, self->has_clients);
+            gbinder_client_transact(client, GBINDER_FIRST_CALL_TRANSACTION,
+                GBINDER_TX_FLAG_ONEWAY, notify, NULL, NULL, NULL);
+            gbinder_local_request_unref(notify);
+            gbinder_client_unref(client);
+            g_hash_table_replace(self->client_callbacks, str, cb);
+            str = NULL;
+            reply = gbinder_local_object_new_reply(obj);
+            gbinder_local_reply_append_int32(reply, GBINDER_STATUS_OK);
+            *status = GBINDER_STATUS_OK;
+        }
+        g_free(str);
+        gbinder_remote_object_unref(remote_obj);
+        break;
+    case TRY_UNREGISTER_SERVICE_TRANSACTION:
+        gbinder_remote_request_init_reader(req, &reader);
+        str = gbinder_reader_read_string16(&reader);
+        remote_obj = gbinder_reader_read_object(&reader);
+        if (str && remote_obj &&
+            g_hash_table_lookup(self->objects, str) == remote_obj) {
+            reply = gbinder_local_object_new_reply(obj);
+            if (self->has_clients ||
+                !g_hash_table_contains(self->client_callbacks, str)) {
+                GDEBUG("Not unregistering '%s'", str);
+                gbinder_local_reply_append_int32(reply, EX_ILLEGAL_STATE);
+            } else {
+                GDEBUG("Unregistering '%s'", str);
+                g_hash_table_remove(self->client_callbacks, str);
+                g_hash_table_remove(self->objects, str);
+                gbinder_local_reply_append_int32(reply, GBINDER_STATUS_OK);
+            }
+            *status = GBINDER_STATUS_OK;
+        }
+        g_free(str);
+        gbinder_remote_object_unref(remote_obj);
+        break;
     default:
         GDEBUG("Unhandled command %u", code);
         break;
@@ -264,6 +366,7 @@ service_manager_aidl4_finalize(
     ServiceManagerAidl4* self = SERVICE_MANAGER_AIDL4(object);
 
     g_hash_table_destroy(self->objects);
+    g_hash_table_destroy(self->client_callbacks);
     G_OBJECT_CLASS(service_manager_aidl4_parent_class)->finalize(object);
 }
 
@@ -274,6 +377,8 @@ service_manager_aidl4_init(
 {
     self->objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
         (GDestroyNotify) gbinder_remote_object_unref);
+    self->client_callbacks = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) gbinder_remote_object_unref);
 }
 
 static
@@ -461,6 +566,180 @@ test_list()
     test_run_in_context(&test_opt, test_list_run);
 }
 
+/*==========================================================================*
+ * list/by_index
+ *==========================================================================*/
+
+static
+void
+test_list_by_index_run()
+{
+    TestContext test;
+    char** list;
+
+    test_context_init(&test);
+    test.service->list_mode = TEST_LIST_BY_INDEX;
+
+    /* Nothing is there yet */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert(list);
+    g_assert(!list[0]);
+    g_strfreev(list);
+
+    /* Register the same object under two names */
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "a", test.object), == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "b", test.object), == ,GBINDER_STATUS_OK);
+
+    /* Single-shot request fails, names are fetched one by one */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert_cmpuint(gutil_strv_length(list), == ,2);
+    g_assert_cmpstr(list[0], == ,"a");
+    g_assert_cmpstr(list[1], == ,"b");
+    g_strfreev(list);
+
+    test_context_deinit(&test);
+}
+
+static
+void
+test_list_by_index()
+{
+    test_run_in_context(&test_opt, test_list_by_index_run);
+}
+
+/*==========================================================================*
+ * list/negative_count
+ *==========================================================================*/
+
+static
+void
+test_list_negative_count_run()
+{
+    TestContext test;
+    char** list;
+
+    test_context_init(&test);
+    test.service->list_mode = TEST_LIST_NEGATIVE_COUNT;
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "name", test.object), == ,GBINDER_STATUS_OK);
+
+    /* Negative count is treated as an empty list */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert(list);
+    g_assert(!list[0]);
+    g_strfreev(list);
+
+    test_context_deinit(&test);
+}
+
+static
+void
+test_list_negative_count()
+{
+    test_run_in_context(&test_opt, test_list_negative_count_run);
+}
+
+/*==========================================================================*
+ * list/bad_name
+ *==========================================================================*/
+
+static
+void
+test_list_bad_name_run()
+{
+    TestContext test;
+    char** list;
+
+    test_context_init(&test);
+    test.service->list_mode = TEST_LIST_BAD_NAME;
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "a", test.object), == ,GBINDER_STATUS_OK);
+    g_assert_cmpint(gbinder_servicemanager_add_service_sync(test.client,
+        "b", test.object), == ,GBINDER_STATUS_OK);
+
+    /* The list stops at the malformed name */
+    list = gbinder_servicemanager_list_sync(test.client);
+    g_assert_cmpuint(gutil_strv_length(list), == ,2);
+    g_assert_cmpstr(list[0], == ,"a");
+    g_assert_cmpstr(list[1], == ,"b");
+    g_strfreev(list);
+
+    test_context_deinit(&test);
+}
+
+static
+void
+test_list_bad_name()
+{
+    test_run_in_context(&test_opt, test_list_bad_name_run);
+}
+
+/*==========================================================================*
+ * lazy
+ *==========================================================================*/
+
+static
+void
+test_lazy_clients(
+    GBinderServiceName* name,
+    gboolean has_clients,
+    void* user_data)
+{
+    GDEBUG("'%s' has %s clients", name->name, has_clients ? "some" : "no");
+    g_assert(!has_clients);
+    g_main_loop_quit(user_data);
+}
+
+static
+void
+test_lazy_run()
+{
+    TestContext test;
+    const char* name = "name";
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceName* sn;
+
+    test_context_init(&test);
+    sn = gbinder_servicename_new(test.client, test.object, name);
+
+    /* Not registered yet */
+    g_assert(!gbinder_servicename_set_lazy(NULL, test_lazy_clients, loop));
+    g_assert(!gbinder_servicename_try_unregister(NULL));
+    g_assert(!gbinder_servicename_try_unregister(sn));
+
+    /* The callback gets registered together with the name */
+    g_assert(gbinder_servicename_set_lazy(sn, test_lazy_clients, loop));
+    test_run(&test_opt, loop);
+    g_assert(g_hash_table_contains(test.service->client_callbacks, name));
+
+    /* Can't unregister while it has clients */
+    test.service->has_clients = TRUE;
+    g_assert(!gbinder_servicename_try_unregister(sn));
+    g_assert(g_hash_table_contains(test.service->objects, name));
+
+    /* Now it's gone */
+    test.service->has_clients = FALSE;
+    g_assert(gbinder_servicename_try_unregister(sn));
+    g_assert(!g_hash_table_contains(test.service->objects, name));
+    g_assert(gbinder_servicename_try_unregister(sn));
+
+    /* Turning it off is always OK */
+    g_assert(gbinder_servicename_set_lazy(sn, NULL, NULL));
+
+    gbinder_servicename_unref(sn);
+    test_context_deinit(&test);
+    g_main_loop_unref(loop);
+}
+
+static
+void
+test_lazy()
+{
+    test_run_in_context(&test_opt, test_lazy_run);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -475,6 +754,10 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_("get"), test_get);
     g_test_add_func(TEST_("list"), test_list);
+    g_test_add_func(TEST_("list/by_index"), test_list_by_index);
+    g_test_add_func(TEST_("list/negative_count"), test_list_negative_count);
+    g_test_add_func(TEST_("list/bad_name"), test_list_bad_name);
+    g_test_add_func(TEST_("lazy"), test_lazy);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
@@ -326,6 +326,21 @@ test_list_run()
     g_assert_cmpuint(gutil_strv_length(test.list), == ,1);
     g_assert_cmpstr(test.list[0], == ,name);
 
+    /* Only the instances of the requested interface get listed */
+    g_assert(gbinder_servicemanager_list_by_interface(sm,
+        "android.hidl.base@1.0::IBase", test_list_cb, &test));
+    test_run(&test_opt, test.loop);
+    g_assert_cmpuint(gutil_strv_length(test.list), == ,1);
+    g_assert_cmpstr(test.list[0], == ,name);
+
+    g_assert(gbinder_servicemanager_list_by_interface(sm,
+        "android.hidl.base@1.0::IFoo", test_list_cb, &test));
+    test_run(&test_opt, test.loop);
+    g_assert(test.list);
+    g_assert(!test.list[0]);
+    g_assert(!gbinder_servicemanager_list_by_interface(sm, NULL,
+        test_list_cb, &test));
+
     test_binder_unregister_objects(fd);
     gbinder_local_object_unref(obj);
     test_servicemanager_hidl_free(smsvc);
@@ -464,6 +464,73 @@ test_retry(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * batch
+ *==========================================================================*/
+
+static
+gboolean
+test_batch_check(
+    gpointer user_data)
+{
+    TestServiceManager* test = user_data;
+    gboolean done;
+
+    g_mutex_lock(&test->mutex);
+    done = gutil_strv_contains(test->services, "test1") &&
+        gutil_strv_contains(test->services, "test2");
+    g_mutex_unlock(&test->mutex);
+    if (done) {
+        g_main_loop_quit(g_object_get_data(G_OBJECT(test), "loop"));
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+test_batch(
+    void)
+{
+    const char* const ifaces[] = { "interface", NULL };
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    const int fd = gbinder_driver_fd(ipc->driver);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderLocalObject* obj;
+    GBinderServiceManager* sm;
+    TestServiceManager* test;
+    GBinderServiceName* sn1;
+    GBinderServiceName* sn2;
+    guint id;
+
+    test_setup_ping(ipc);
+    sm = gbinder_servicemanager_new(dev);
+    test = TEST_SERVICEMANAGER(sm);
+    g_object_set_data(G_OBJECT(test), "loop", loop);
+    obj = gbinder_local_object_new(ipc, ifaces, NULL, NULL);
+
+    /* The first add fails, the failed name gets retried */
+    test->add_fail = 1;
+    sn1 = gbinder_servicename_new(sm, obj, "test1");
+    sn2 = gbinder_servicename_new(sm, obj, "test2");
+    g_assert(sn1);
+    g_assert(sn2);
+
+    /* Need looper for death notifications */
+    test_binder_set_looper_enabled(fd, TRUE);
+    id = g_timeout_add(10, test_batch_check, test);
+    test_run(&test_opt, loop);
+
+    g_source_remove(id);
+    gbinder_servicename_unref(sn1);
+    gbinder_servicename_unref(sn2);
+    gbinder_local_object_unref(obj);
+    gbinder_servicemanager_unref(sm);
+    gbinder_ipc_unref(ipc);
+    gbinder_ipc_exit();
+    g_main_loop_unref(loop);
+}
+
 /*==========================================================================*
  * cancel
  *==========================================================================*/
@@ -542,6 +609,7 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("present_err"), test_present_err);
     g_test_add_func(TEST_("not_present"), test_not_present);
     g_test_add_func(TEST_("retry"), test_retry);
+    g_test_add_func(TEST_("batch"), test_batch);
     g_test_add_func(TEST_("cancel"), test_cancel);
     test_init(&test_opt, argc, argv);
     return g_test_run();
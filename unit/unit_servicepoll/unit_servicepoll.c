@@ -32,8 +32,11 @@
 
 #include "test_binder.h"
 
+#include "gbinder_config.h"
+#include "gbinder_client_p.h"
 #include "gbinder_driver.h"
 #include "gbinder_ipc.h"
+#include "gbinder_remote_object.h"
 #include "gbinder_servicemanager_p.h"
 #include "gbinder_servicepoll.h"
 #include "gbinder_rpc_protocol.h"
@@ -44,6 +47,7 @@
 #include <errno.h>
 
 static TestOpt test_opt;
+static const char TMP_DIR_TEMPLATE[] = "gbinder-test-servicepoll-XXXXXX";
 
 static
 void
@@ -100,8 +104,17 @@ test_servicemanager_get_service(
     int* status,
     const GBinderIpcSyncApi* api)
 {
-    *status = (-ENOENT);
-    return NULL;
+    TestServiceManager* self = TEST_SERVICEMANAGER(manager);
+    GBinderRemoteObject* obj = NULL;
+
+    /* Any object would do, the service manager itself is at hand */
+    g_mutex_lock(&self->mutex);
+    if (gutil_strv_contains(self->services, name)) {
+        obj = gbinder_remote_object_ref(manager->client->remote);
+    }
+    g_mutex_unlock(&self->mutex);
+    *status = GBINDER_STATUS_OK;
+    return obj;
 }
 
 static
@@ -231,6 +244,7 @@ test_null(
     g_assert(!gbinder_servicepoll_manager(NULL));
     g_assert(!gbinder_servicepoll_is_known_name(NULL, ""));
     g_assert(!gbinder_servicepoll_add_handler(NULL, NULL, NULL));
+    g_assert(!gbinder_servicepoll_add_removal_handler(NULL, NULL, NULL));
     gbinder_servicepoll_remove_handler(NULL, 0);
     gbinder_servicepoll_unref(NULL);
 }
@@ -255,6 +269,9 @@ test_basic(
     poll = gbinder_servicepoll_new(manager, NULL);
     g_assert(poll);
     g_assert(gbinder_servicepoll_manager(poll) == manager);
+    /* The same poll is shared */
+    g_assert(gbinder_servicepoll_new(manager, NULL) == poll);
+    gbinder_servicepoll_unref(poll);
     g_assert(!gbinder_servicepoll_is_known_name(poll, "foo"));
     g_assert(!gbinder_servicepoll_add_handler(poll, NULL, NULL));
     gbinder_servicepoll_remove_handler(poll, 0); /* this does nothing */
@@ -481,6 +498,209 @@ test_already_there(
     g_main_loop_unref(loop);
 }
 
+/*==========================================================================*
+ * removed
+ *==========================================================================*/
+
+static
+void
+test_removed_proc(
+    GBinderServicePoll* poll,
+    const char* name_removed,
+    void* user_data)
+{
+    GDEBUG("\"%s\" removed", name_removed);
+    g_assert_cmpstr(name_removed, == ,"bar");
+    test_quit_later((GMainLoop*)user_data);
+}
+
+static
+gboolean
+test_removed_bar(
+    gpointer user_data)
+{
+    TestServiceManager* test = user_data;
+
+    g_mutex_lock(&test->mutex);
+    GDEBUG("services = [\"foo\"]");
+    g_strfreev(test->services);
+    test->services = g_strsplit("foo", ",", -1);
+    g_mutex_unlock(&test->mutex);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+test_removed(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    GBinderIpc* ipc = gbinder_ipc_new(dev, NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceManager* manager;
+    TestServiceManager* test;
+    GBinderServicePoll* poll;
+    gulong id;
+
+    test_setup_ping(ipc);
+    manager = gbinder_servicemanager_new(dev);
+    test = TEST_SERVICEMANAGER(manager);
+    test->services = g_strsplit("bar,foo", ",", -1);
+
+    gbinder_servicepoll_interval_ms = 100;
+    poll = gbinder_servicepoll_new(manager, NULL);
+    g_timeout_add(2 * gbinder_servicepoll_interval_ms,
+        test_removed_bar, test);
+
+    id = gbinder_servicepoll_add_removal_handler(poll, test_removed_proc,
+        loop);
+    g_assert(id);
+
+    test_run(&test_opt, loop);
+
+    g_assert(gbinder_servicepoll_is_known_name(poll, "foo"));
+    g_assert(!gbinder_servicepoll_is_known_name(poll, "bar"));
+    gbinder_servicepoll_remove_handler(poll, id);
+    gbinder_servicepoll_unref(poll);
+    gbinder_servicemanager_unref(manager);
+    gbinder_ipc_unref(ipc);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * interval
+ *==========================================================================*/
+
+static
+void
+test_interval(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    const guint default_interval_ms = gbinder_servicepoll_interval_ms;
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceManager* manager;
+    TestServiceManager* test;
+    GBinderServicePoll* poll;
+    GBinderIpc* ipc;
+    gulong id;
+
+    static const char config[] =
+        "[ServicePollInterval]\n"
+        "Default = 100000\n"
+        "/dev/binder = 100\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(dev, NULL);
+    test_setup_ping(ipc);
+    manager = gbinder_servicemanager_new(dev);
+    test = TEST_SERVICEMANAGER(manager);
+
+    /* The per-device value overrides the built-in one */
+    gbinder_servicepoll_interval_ms = 100000;
+    poll = gbinder_servicepoll_new(manager, NULL);
+    g_timeout_add(200, test_notify1_foo, test);
+    id = gbinder_servicepoll_add_handler(poll, test_notify_proc, loop);
+    g_assert(id);
+
+    test_run(&test_opt, loop);
+
+    g_assert(gbinder_servicepoll_is_known_name(poll, "foo"));
+    gbinder_servicepoll_remove_handler(poll, id);
+    gbinder_servicepoll_unref(poll);
+    gbinder_servicemanager_unref(manager);
+    gbinder_ipc_unref(ipc);
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_servicepoll_interval_ms = default_interval_ms;
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
+/*==========================================================================*
+ * watched_only
+ *==========================================================================*/
+
+static
+void
+test_watched_only(
+    void)
+{
+    const char* dev = GBINDER_DEFAULT_BINDER;
+    char* dir = g_dir_make_tmp(TMP_DIR_TEMPLATE, NULL);
+    char* file = g_build_filename(dir, "test.conf", NULL);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    GBinderServiceManager* manager;
+    TestServiceManager* test;
+    GBinderServicePoll* poll;
+    GBinderIpc* ipc;
+    gulong id;
+
+    static const char config[] =
+        "[ServicePollInterval]\n"
+        "/dev/binder = 100\n"
+        "[ServicePollWatchedOnly]\n"
+        "/dev/binder = 1\n";
+
+    /* Reset the state */
+    gbinder_config_exit();
+    g_assert(g_file_set_contents(file, config, -1, NULL));
+    gbinder_config_file = file;
+
+    ipc = gbinder_ipc_new(dev, NULL);
+    test_setup_ping(ipc);
+    manager = gbinder_servicemanager_new(dev);
+    test = TEST_SERVICEMANAGER(manager);
+
+    /* Only the watched names are checked */
+    poll = gbinder_servicepoll_new(manager, NULL);
+    gbinder_servicepoll_watch_name(poll, "foo");
+    gbinder_servicepoll_watch_name(poll, "foo");
+    g_timeout_add(200, test_notify1_bar, test);
+    g_timeout_add(400, test_notify1_foo, test);
+    id = gbinder_servicepoll_add_handler(poll, test_notify_proc, loop);
+    g_assert(id);
+
+    test_run(&test_opt, loop);
+
+    g_assert(gbinder_servicepoll_is_known_name(poll, "foo"));
+    g_assert(!gbinder_servicepoll_is_known_name(poll, "bar"));
+
+    /* The name is forgotten when the last watch goes away */
+    gbinder_servicepoll_unwatch_name(poll, "foo");
+    g_assert(gbinder_servicepoll_is_known_name(poll, "foo"));
+    gbinder_servicepoll_unwatch_name(poll, "foo");
+    g_assert(!gbinder_servicepoll_is_known_name(poll, "foo"));
+    gbinder_servicepoll_unwatch_name(poll, "foo"); /* Does nothing */
+
+    gbinder_servicepoll_remove_handler(poll, id);
+    gbinder_servicepoll_unref(poll);
+    gbinder_servicemanager_unref(manager);
+    gbinder_ipc_unref(ipc);
+    g_main_loop_unref(loop);
+
+    /* Clear the state */
+    gbinder_config_exit();
+    gbinder_config_file = NULL;
+
+    remove(file);
+    remove(dir);
+    g_free(file);
+    g_free(dir);
+}
+
 /*==========================================================================*
  * Common
  *==========================================================================*/
@@ -498,6 +718,9 @@ int main(int argc, char* argv[])
     g_test_add_func(TEST_("notify1"), test_notify1);
     g_test_add_func(TEST_("notify2"), test_notify2);
     g_test_add_func(TEST_("already_there"), test_already_there);
+    g_test_add_func(TEST_("removed"), test_removed);
+    g_test_add_func(TEST_("interval"), test_interval);
+    g_test_add_func(TEST_("watched_only"), test_watched_only);
     test_init(&test_opt, argc, argv);
     return g_test_run();
 }
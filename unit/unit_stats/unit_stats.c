@@ -0,0 +1,813 @@
+/*
+ * Copyright (C) 2026 Jolla Ltd.
+ *
+ * You may use this file under the terms of BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *   3. Neither the names of the copyright holders nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test_binder.h"
+
+#include "gbinder_buffer_p.h"
+#include "gbinder_client.h"
+#include "gbinder_driver.h"
+#include "gbinder_ipc.h"
+#include "gbinder_local_reply_p.h"
+#include "gbinder_local_request_p.h"
+#include "gbinder_object_registry.h"
+#include "gbinder_output_data.h"
+#include "gbinder_remote_object_p.h"
+#include "gbinder_remote_reply.h"
+#include "gbinder_stats_p.h"
+
+#include <gutil_log.h>
+
+#include <limits.h>
+#include <string.h>
+
+static TestOpt test_opt;
+
+typedef struct test_stats_find {
+    const char* iface;
+    guint32 code;
+    GBINDER_STATS_DIR dir;
+    GBinderStatsEntry entry;
+    gboolean found;
+} TestStatsFind;
+
+static
+void
+test_stats_find_cb(
+    const GBinderStatsEntry* entry,
+    void* user_data)
+{
+    TestStatsFind* find = user_data;
+
+    if (!g_strcmp0(entry->iface, find->iface) &&
+        entry->code == find->code && entry->dir == find->dir) {
+        g_assert(!find->found);
+        find->entry = *entry;
+        find->found = TRUE;
+    }
+}
+
+static
+void
+test_stats_nop_cb(
+    const GBinderStatsEntry* entry,
+    void* user_data)
+{
+}
+
+static
+gboolean
+test_stats_find(
+    TestStatsFind* find,
+    const char* iface,
+    guint32 code,
+    GBINDER_STATS_DIR dir)
+{
+    memset(find, 0, sizeof(*find));
+    find->iface = iface;
+    find->code = code;
+    find->dir = dir;
+    gbinder_stats_foreach(test_stats_find_cb, find);
+    return find->found;
+}
+
+/*==========================================================================*
+ * null
+ *==========================================================================*/
+
+static
+void
+test_null(
+    void)
+{
+    char* dump;
+
+    gbinder_stats_reset();
+    g_assert_cmpuint(gbinder_stats_foreach(NULL, NULL), == ,0);
+    g_assert_cmpuint(gbinder_stats_foreach(test_stats_nop_cb, NULL), == ,0);
+    dump = gbinder_stats_dump();
+    g_assert_cmpstr(dump, == ,"");
+    g_free(dump);
+}
+
+/*==========================================================================*
+ * basic
+ *==========================================================================*/
+
+static
+void
+test_basic(
+    void)
+{
+    TestStatsFind find;
+    char* dump;
+
+    g_assert(!gbinder_stats_enabled());
+    gbinder_stats_set_enabled(TRUE);
+    g_assert(gbinder_stats_enabled());
+
+    gbinder_stats_record("/dev/test", "foo", 1, GBINDER_STATS_OUTGOING, 0,
+        GBINDER_STATUS_OK, 100, 20, 1, 0);
+    gbinder_stats_record("/dev/test", "foo", 1, GBINDER_STATS_OUTGOING,
+        GBINDER_TX_FLAG_ONEWAY, GBINDER_STATUS_FAILED, 50, 0, 0, 5);
+    gbinder_stats_record("/dev/test", "foo", 2, GBINDER_STATS_INCOMING, 0,
+        GBINDER_STATUS_OK, 10, 10, 0, -1);
+    gbinder_stats_record("/dev/test", NULL, 1, GBINDER_STATS_OUTGOING, 0,
+        GBINDER_STATUS_OK, 1, 1, 0, 1000);
+    g_assert_cmpuint(gbinder_stats_foreach(test_stats_nop_cb, NULL), == ,3);
+
+    g_assert(test_stats_find(&find, "foo", 1, GBINDER_STATS_OUTGOING));
+    g_assert_cmpstr(find.entry.dev, == ,"/dev/test");
+    g_assert_cmpuint(find.entry.calls, == ,2);
+    g_assert_cmpuint(find.entry.oneway, == ,1);
+    g_assert_cmpuint(find.entry.errors, == ,1);
+    g_assert_cmpuint(find.entry.request_bytes, == ,150);
+    g_assert_cmpuint(find.entry.reply_bytes, == ,20);
+    g_assert_cmpuint(find.entry.objects, == ,1);
+    g_assert_cmpuint(find.entry.total_usec, == ,5);
+    g_assert_cmpuint(find.entry.max_usec, == ,5);
+    g_assert_cmpuint(find.entry.histogram[0], == ,1);
+    g_assert_cmpuint(find.entry.histogram[3], == ,1); /* [4,8) */
+
+    /* Negative time is treated as zero */
+    g_assert(test_stats_find(&find, "foo", 2, GBINDER_STATS_INCOMING));
+    g_assert_cmpuint(find.entry.total_usec, == ,0);
+    g_assert_cmpuint(find.entry.histogram[0], == ,1);
+
+    g_assert(test_stats_find(&find, NULL, 1, GBINDER_STATS_OUTGOING));
+    g_assert_cmpuint(find.entry.histogram[10], == ,1); /* [512,1024) */
+
+    /* The slowest one goes first */
+    dump = gbinder_stats_dump();
+    GDEBUG("\n%s", dump);
+    g_assert(g_str_has_prefix(dump, "out /dev/test - 1 calls=1 "));
+    g_assert(strstr(dump, "\nout /dev/test foo 1 calls=2 oneway=1 errors=1 "
+        "req=150 reply=20 objects=1 total=5us avg=2us max=5us hist=1,0,0,1\n"));
+    g_assert(strstr(dump, "\nin /dev/test foo 2 calls=1 "));
+    g_free(dump);
+
+    gbinder_stats_reset();
+    g_assert_cmpuint(gbinder_stats_foreach(test_stats_nop_cb, NULL), == ,0);
+    gbinder_stats_set_enabled(FALSE);
+    g_assert(!gbinder_stats_enabled());
+}
+
+/*==========================================================================*
+ * forwarded
+ *==========================================================================*/
+
+static
+void
+test_forwarded(
+    void)
+{
+    TestStatsFind find;
+    char* dump;
+
+    gbinder_stats_set_enabled(TRUE);
+    gbinder_stats_record("/dev/test", "foo", 1, GBINDER_STATS_FORWARDED, 0,
+        GBINDER_STATUS_OK, 8, 4, 0, 100);
+    gbinder_stats_record("/dev/test", "foo", 1, GBINDER_STATS_INCOMING, 0,
+        GBINDER_STATUS_OK, 8, 0, 0, 2);
+    g_assert_cmpuint(gbinder_stats_foreach(test_stats_nop_cb, NULL), == ,2);
+
+    /* Forwarded calls are counted separately from incoming ones */
+    g_assert(test_stats_find(&find, "foo", 1, GBINDER_STATS_FORWARDED));
+    g_assert_cmpuint(find.entry.calls, == ,1);
+    g_assert_cmpuint(find.entry.request_bytes, == ,8);
+    g_assert_cmpuint(find.entry.reply_bytes, == ,4);
+    g_assert_cmpuint(find.entry.total_usec, == ,100);
+
+    dump = gbinder_stats_dump();
+    GDEBUG("\n%s", dump);
+    g_assert(g_str_has_prefix(dump, "fwd /dev/test foo 1 calls=1 "));
+    g_assert(strstr(dump, "\nin /dev/test foo 1 calls=1 "));
+    g_free(dump);
+
+    gbinder_stats_reset();
+    gbinder_stats_set_enabled(FALSE);
+}
+
+/*==========================================================================*
+ * client
+ *==========================================================================*/
+
+static
+void
+test_client(
+    void)
+{
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    GBinderRemoteObject* obj = gbinder_object_registry_get_remote(reg, 0, TRUE);
+    GBinderClient* client;
+    GBinderDriver* driver = ipc->driver;
+    const int fd = gbinder_driver_fd(driver);
+    GBinderLocalReply* reply = gbinder_local_reply_new
+        (gbinder_driver_io(driver));
+    GBinderLocalRequest* req;
+    GBinderRemoteReply* tx_reply;
+    GBinderOutputData* data;
+    TestStatsFind find;
+    const guint32 code = 1;
+    int status = INT_MAX;
+
+    /* Nothing is collected while disabled */
+    gbinder_stats_reset();
+    client = gbinder_client_new(obj, "foo");
+    test_binder_br_transaction_complete(fd);
+    g_assert_cmpint(gbinder_client_transact_sync_oneway(client, code, NULL),
+        == ,GBINDER_STATUS_OK);
+    g_assert_cmpuint(gbinder_stats_foreach(test_stats_nop_cb, NULL), == ,0);
+
+    gbinder_stats_set_enabled(TRUE);
+    g_assert(gbinder_local_reply_append_int32(reply, 0));
+    data = gbinder_local_reply_data(reply);
+
+    test_binder_br_noop(fd);
+    test_binder_br_transaction_complete(fd);
+    test_binder_br_noop(fd);
+    test_binder_br_reply(fd, 0, code, data->bytes);
+
+    req = gbinder_client_new_request(client);
+    tx_reply = gbinder_client_transact_sync_reply(client, code, req, &status);
+    g_assert(tx_reply);
+    g_assert_cmpint(status, == ,GBINDER_STATUS_OK);
+    gbinder_remote_reply_unref(tx_reply);
+
+    g_assert(test_stats_find(&find, "foo", code, GBINDER_STATS_OUTGOING));
+    g_assert_cmpstr(find.entry.dev, == ,GBINDER_DEFAULT_BINDER);
+    g_assert_cmpuint(find.entry.calls, == ,1);
+    g_assert_cmpuint(find.entry.oneway, == ,0);
+    g_assert_cmpuint(find.entry.errors, == ,0);
+    g_assert_cmpuint(find.entry.request_bytes, == ,
+        gbinder_local_request_data(req)->bytes->len);
+    g_assert_cmpuint(find.entry.reply_bytes, == ,data->bytes->len);
+
+    /* The built-in request is tagged too */
+    test_binder_br_transaction_complete(fd);
+    g_assert_cmpint(gbinder_client_transact_sync_oneway(client, code, NULL),
+        == ,GBINDER_STATUS_OK);
+    g_assert(test_stats_find(&find, "foo", code, GBINDER_STATS_OUTGOING));
+    g_assert_cmpuint(find.entry.calls, == ,2);
+    g_assert_cmpuint(find.entry.oneway, == ,1);
+
+    gbinder_stats_set_enabled(FALSE);
+    gbinder_stats_reset();
+    gbinder_local_request_unref(req);
+    gbinder_local_reply_unref(reply);
+    gbinder_client_unref(client);
+    gbinder_remote_object_unref(obj);
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * sampling
+ *==========================================================================*/
+
+static
+void
+test_sampling(
+    void)
+{
+    TestStatsFind find;
+    int i, n;
+
+    gbinder_stats_reset();
+    g_assert_cmpuint(gbinder_stats_sampling(), == ,1);
+    gbinder_stats_set_enabled(TRUE);
+
+    /* Every transaction is measured by default */
+    for (i = 0; i < 4; i++) {
+        g_assert(gbinder_stats_begin());
+    }
+
+    /* Only every 4th one is with sampling */
+    gbinder_stats_set_sampling(4);
+    g_assert_cmpuint(gbinder_stats_sampling(), == ,4);
+    for (i = 0, n = 0; i < 16; i++) {
+        if (gbinder_stats_begin()) {
+            n++;
+        }
+    }
+    g_assert_cmpint(n, == ,4);
+
+    /* And counters are scaled up */
+    gbinder_stats_record("/dev/test", "foo", 1, GBINDER_STATS_OUTGOING,
+        GBINDER_TX_FLAG_ONEWAY, -1, 10, 0, 1, 3);
+    g_assert(test_stats_find(&find, "foo", 1, GBINDER_STATS_OUTGOING));
+    g_assert_cmpuint(find.entry.calls, == ,4);
+    g_assert_cmpuint(find.entry.oneway, == ,4);
+    g_assert_cmpuint(find.entry.errors, == ,4);
+    g_assert_cmpuint(find.entry.request_bytes, == ,40);
+    g_assert_cmpuint(find.entry.objects, == ,4);
+    g_assert_cmpuint(find.entry.total_usec, == ,12);
+    g_assert_cmpuint(find.entry.max_usec, == ,3);
+    g_assert_cmpuint(find.entry.histogram[2], == ,4);
+
+    /* Zero is the same as one */
+    gbinder_stats_set_sampling(0);
+    g_assert_cmpuint(gbinder_stats_sampling(), == ,1);
+
+    /* Nothing is measured while disabled */
+    gbinder_stats_set_enabled(FALSE);
+    g_assert(!gbinder_stats_begin());
+    gbinder_stats_reset();
+}
+
+/*==========================================================================*
+ * percentile
+ *==========================================================================*/
+
+static
+void
+test_percentile(
+    void)
+{
+    GBinderStatsEntry entry;
+
+    memset(&entry, 0, sizeof(entry));
+    g_assert_cmpuint(gbinder_stats_percentile_usec(NULL, 50), == ,0);
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 50), == ,0);
+
+    /* 90 calls under 1us, 9 in [4,8) and one very long */
+    entry.histogram[0] = 90;
+    entry.histogram[3] = 9;
+    entry.histogram[GBINDER_STATS_HISTOGRAM_SIZE - 1] = 1;
+    entry.max_usec = 100000000;
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 0), == ,1);
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 50), == ,1);
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 90), == ,1);
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 91), == ,8);
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 99), == ,8);
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 100), == ,
+        entry.max_usec);
+    g_assert_cmpuint(gbinder_stats_percentile_usec(&entry, 200), == ,
+        entry.max_usec);
+}
+
+/*==========================================================================*
+ * memory
+ *==========================================================================*/
+
+static
+void
+test_memory_get(
+    GBINDER_STATS_MEM type,
+    GBinderStatsMemEntry* entry)
+{
+    memset(entry, 0xaa, sizeof(*entry));
+    g_assert(gbinder_stats_get_memory(type, entry));
+    g_assert_cmpuint(entry->max_count, >= ,entry->count);
+    g_assert_cmpuint(entry->max_bytes, >= ,entry->bytes);
+}
+
+static
+void
+test_memory(
+    void)
+{
+    static const guint8 bytes[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    GBinderIpc* ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    GBinderObjectRegistry* reg = gbinder_ipc_object_registry(ipc);
+    const GBinderIo* io = gbinder_driver_io(ipc->driver);
+    GBinderStatsMemEntry before, after;
+    GBinderRemoteObject* obj;
+    GBinderLocalRequest* req;
+    GBinderLocalReply* reply;
+    GBinderBuffer* buf;
+
+    g_assert(!gbinder_stats_get_memory(GBINDER_STATS_MEM_COUNT, &before));
+    g_assert(!gbinder_stats_get_memory(GBINDER_STATS_MEM_BUFFERS, NULL));
+
+    /* Disabling transaction statistics doesn't affect accounting */
+    gbinder_stats_set_enabled(FALSE);
+    gbinder_stats_reset();
+
+    test_memory_get(GBINDER_STATS_MEM_BUFFERS, &before);
+    buf = gbinder_buffer_new(ipc->driver, g_memdup(bytes, sizeof(bytes)),
+        sizeof(bytes), NULL);
+    test_memory_get(GBINDER_STATS_MEM_BUFFERS, &after);
+    g_assert_cmpuint(after.count, == ,before.count + 1);
+    g_assert_cmpuint(after.bytes, == ,before.bytes + sizeof(bytes));
+    g_assert_cmpuint(after.max_bytes, >= ,before.bytes + sizeof(bytes));
+    gbinder_buffer_free(buf);
+    test_memory_get(GBINDER_STATS_MEM_BUFFERS, &after);
+    g_assert_cmpuint(after.count, == ,before.count);
+    g_assert_cmpuint(after.bytes, == ,before.bytes);
+
+    /* High-water mark stays until reset */
+    g_assert_cmpuint(after.max_bytes, >= ,before.bytes + sizeof(bytes));
+    gbinder_stats_reset_memory_peaks();
+    test_memory_get(GBINDER_STATS_MEM_BUFFERS, &after);
+    g_assert_cmpuint(after.max_count, == ,after.count);
+    g_assert_cmpuint(after.max_bytes, == ,after.bytes);
+
+    test_memory_get(GBINDER_STATS_MEM_LOCAL_REQUESTS, &before);
+    req = gbinder_local_request_new(io, NULL);
+    test_memory_get(GBINDER_STATS_MEM_LOCAL_REQUESTS, &after);
+    g_assert_cmpuint(after.count, == ,before.count + 1);
+    gbinder_local_request_unref(req);
+    test_memory_get(GBINDER_STATS_MEM_LOCAL_REQUESTS, &after);
+    g_assert_cmpuint(after.count, == ,before.count);
+
+    test_memory_get(GBINDER_STATS_MEM_LOCAL_REPLIES, &before);
+    reply = gbinder_local_reply_new(io);
+    test_memory_get(GBINDER_STATS_MEM_LOCAL_REPLIES, &after);
+    g_assert_cmpuint(after.count, == ,before.count + 1);
+    gbinder_local_reply_unref(reply);
+    test_memory_get(GBINDER_STATS_MEM_LOCAL_REPLIES, &after);
+    g_assert_cmpuint(after.count, == ,before.count);
+
+    test_memory_get(GBINDER_STATS_MEM_REMOTE_OBJECTS, &before);
+    obj = gbinder_object_registry_get_remote(reg, 1, TRUE);
+    test_memory_get(GBINDER_STATS_MEM_REMOTE_OBJECTS, &after);
+    g_assert_cmpuint(after.count, == ,before.count + 1);
+    gbinder_remote_object_unref(obj);
+    test_memory_get(GBINDER_STATS_MEM_REMOTE_OBJECTS, &after);
+    g_assert_cmpuint(after.count, == ,before.count);
+
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * probes
+ *==========================================================================*/
+
+static
+void
+test_probes_done(
+    const GBinderIpcTx* tx)
+{
+    test_quit_later((GMainLoop*)tx->user_data);
+}
+
+static
+void
+test_probes(
+    void)
+{
+    GBinderStatsProbeEntry entry;
+    GBinderIpc* ipc;
+    GMainLoop* loop;
+    gint64 start;
+
+    g_assert(!gbinder_stats_get_probe(GBINDER_STATS_PROBE_COUNT, &entry));
+    g_assert(!gbinder_stats_get_probe(GBINDER_STATS_PROBE_TX_QUEUE, NULL));
+
+    /* Nothing is collected while disabled */
+    gbinder_stats_set_enabled(FALSE);
+    gbinder_stats_reset();
+    g_assert(!gbinder_stats_probe_enter(GBINDER_STATS_PROBE_DISPATCH));
+    gbinder_stats_probe_exit(GBINDER_STATS_PROBE_DISPATCH, 0);
+    g_assert(gbinder_stats_get_probe(GBINDER_STATS_PROBE_DISPATCH, &entry));
+    g_assert_cmpuint(entry.count, == ,0);
+    g_assert_cmpuint(entry.depth, == ,0);
+
+    gbinder_stats_set_enabled(TRUE);
+    start = gbinder_stats_probe_enter(GBINDER_STATS_PROBE_DISPATCH);
+    g_assert(start);
+    g_assert(gbinder_stats_get_probe(GBINDER_STATS_PROBE_DISPATCH, &entry));
+    g_assert_cmpuint(entry.count, == ,0);
+    g_assert_cmpuint(entry.depth, == ,1);
+    g_assert_cmpuint(entry.max_depth, == ,1);
+
+    /* Reset doesn't forget what's in progress */
+    gbinder_stats_reset();
+    g_assert(gbinder_stats_get_probe(GBINDER_STATS_PROBE_DISPATCH, &entry));
+    g_assert_cmpuint(entry.depth, == ,1);
+    gbinder_stats_probe_exit(GBINDER_STATS_PROBE_DISPATCH, start);
+    g_assert(gbinder_stats_get_probe(GBINDER_STATS_PROBE_DISPATCH, &entry));
+    g_assert_cmpuint(entry.count, == ,1);
+    g_assert_cmpuint(entry.depth, == ,0);
+    g_assert_cmpuint(entry.max_depth, == ,1);
+    g_assert_cmpuint(entry.total_usec, <= ,entry.max_usec);
+
+    /* Transaction queue */
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    loop = g_main_loop_new(NULL, FALSE);
+    g_assert(gbinder_ipc_transact_custom(ipc, NULL, test_probes_done, NULL,
+        loop));
+    test_run(&test_opt, loop);
+    g_assert(gbinder_stats_get_probe(GBINDER_STATS_PROBE_TX_QUEUE, &entry));
+    g_assert_cmpuint(entry.count, == ,1);
+    g_assert_cmpuint(entry.depth, == ,0);
+    g_assert_cmpuint(entry.max_depth, == ,1);
+
+    gbinder_stats_set_enabled(FALSE);
+    gbinder_stats_reset();
+    gbinder_ipc_unref(ipc);
+    g_main_loop_unref(loop);
+}
+
+/*==========================================================================*
+ * handlers
+ *==========================================================================*/
+
+static
+void
+test_handlers_slow(
+    const GBinderStatsHandlerEntry* entry,
+    void* user_data)
+{
+    GBinderStatsHandlerEntry* slow = user_data;
+
+    *slow = *entry;
+}
+
+static
+void
+test_handlers(
+    void)
+{
+    GBinderStatsHandlerEntry entries[GBINDER_STATS_HANDLER_HISTORY + 1];
+    GBinderStatsHandlerEntry slow;
+    guint i;
+
+    g_assert(!gbinder_stats_handler_profiling());
+    g_assert(!gbinder_stats_handler_begin());
+    g_assert_cmpuint(gbinder_stats_get_handlers(NULL, 1), == ,0);
+    g_assert_cmpuint(gbinder_stats_get_handlers(entries, 1), == ,0);
+
+    gbinder_stats_set_handler_profiling(TRUE);
+    g_assert(gbinder_stats_handler_profiling());
+    g_assert(gbinder_stats_handler_begin());
+
+    /* Only the slow one is reported */
+    memset(&slow, 0, sizeof(slow));
+    gbinder_stats_set_slow_handler(1000000, test_handlers_slow, &slow);
+    gbinder_stats_handler("/dev/test", "foo", 1, 0, 0, g_get_monotonic_time());
+    g_assert(!slow.dev);
+    gbinder_stats_handler("/dev/test", "foo", 2, GBINDER_TX_FLAG_ONEWAY,
+        0x1234, g_get_monotonic_time() - 2000000);
+    g_assert_cmpstr(slow.dev, == ,"/dev/test");
+    g_assert_cmpstr(slow.iface, == ,"foo");
+    g_assert_cmpuint(slow.code, == ,2);
+    g_assert_cmpuint(slow.flags, == ,GBINDER_TX_FLAG_ONEWAY);
+    g_assert_cmpuint(slow.usec, >= ,2000000);
+    g_assert_cmpuint(slow.trace_id, == ,0x1234);
+
+    /* Newest first */
+    g_assert_cmpuint(gbinder_stats_get_handlers(entries,
+        G_N_ELEMENTS(entries)), == ,2);
+    g_assert_cmpuint(entries[0].code, == ,2);
+    g_assert_cmpuint(entries[1].code, == ,1);
+    g_assert_cmpuint(entries[1].usec, < ,1000000);
+    g_assert_cmpuint(gbinder_stats_get_handlers(entries, 1), == ,1);
+    g_assert_cmpuint(entries[0].code, == ,2);
+
+    /* The history has a limited size */
+    gbinder_stats_set_slow_handler(0, NULL, NULL);
+    for (i = 0; i < G_N_ELEMENTS(entries); i++) {
+        gbinder_stats_handler("/dev/test", NULL, 100 + i, 0, 0,
+            g_get_monotonic_time());
+    }
+    g_assert_cmpuint(gbinder_stats_get_handlers(entries,
+        G_N_ELEMENTS(entries)), == ,GBINDER_STATS_HANDLER_HISTORY);
+    g_assert(!entries[0].iface);
+    g_assert_cmpuint(entries[0].code, == ,100 + GBINDER_STATS_HANDLER_HISTORY);
+    g_assert_cmpuint(entries[GBINDER_STATS_HANDLER_HISTORY - 1].code, == ,101);
+
+    gbinder_stats_reset();
+    g_assert_cmpuint(gbinder_stats_get_handlers(entries,
+        G_N_ELEMENTS(entries)), == ,0);
+    gbinder_stats_set_handler_profiling(FALSE);
+    g_assert(!gbinder_stats_handler_profiling());
+}
+
+/*==========================================================================*
+ * startup
+ *==========================================================================*/
+
+static
+void
+test_startup(
+    void)
+{
+    GBinderDriver* driver;
+    GBinderIpc* ipc;
+    guint64 usec = 0, usec2 = 0;
+
+    g_assert(!gbinder_stats_get_startup(GBINDER_STATS_STARTUP_COUNT, &usec));
+
+    /* Opening the device doesn't map it */
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert(ipc);
+    g_assert(gbinder_stats_get_startup(GBINDER_STATS_STARTUP_IPC, NULL));
+    g_assert(gbinder_stats_get_startup(GBINDER_STATS_STARTUP_OPEN, NULL));
+    driver = gbinder_driver_new(GBINDER_DEFAULT_HWBINDER, NULL);
+    g_assert(driver);
+    g_assert(gbinder_driver_increfs(driver, 0));
+    g_assert(gbinder_stats_get_startup(GBINDER_STATS_STARTUP_MMAP, NULL));
+    gbinder_driver_unref(driver);
+    gbinder_ipc_unref(ipc);
+
+    /* Only the first occurrence counts */
+    gbinder_stats_startup(GBINDER_STATS_STARTUP_LOOPER,
+        g_get_monotonic_time() - 1000);
+    g_assert(gbinder_stats_get_startup(GBINDER_STATS_STARTUP_LOOPER, &usec));
+    gbinder_stats_startup(GBINDER_STATS_STARTUP_LOOPER,
+        g_get_monotonic_time() - 2000000);
+    g_assert(gbinder_stats_get_startup(GBINDER_STATS_STARTUP_LOOPER, &usec2));
+    g_assert_cmpuint(usec, == ,usec2);
+
+    /* And it survives the reset */
+    gbinder_stats_reset();
+    g_assert(gbinder_stats_get_startup(GBINDER_STATS_STARTUP_LOOPER, &usec2));
+    g_assert_cmpuint(usec, == ,usec2);
+}
+
+/*==========================================================================*
+ * tuning
+ *==========================================================================*/
+
+static
+void
+test_tuning(
+    void)
+{
+    GBinderStatsTuningEntry entries[GBINDER_STATS_TUNING_HISTORY + 1];
+    guint i;
+
+    g_assert_cmpuint(gbinder_stats_get_tuning(NULL, 1), == ,0);
+    g_assert_cmpuint(gbinder_stats_get_tuning(entries, 1), == ,0);
+
+    /* Newest first */
+    gbinder_stats_tuning("/dev/test", GBINDER_STATS_TUNING_LOOPERS, 5, 6);
+    gbinder_stats_tuning("/dev/test", GBINDER_STATS_TUNING_REPLY_SIZE, 0, 64);
+    g_assert_cmpuint(gbinder_stats_get_tuning(entries,
+        G_N_ELEMENTS(entries)), == ,2);
+    g_assert_cmpstr(entries[0].dev, == ,"/dev/test");
+    g_assert_cmpint(entries[0].param, == ,GBINDER_STATS_TUNING_REPLY_SIZE);
+    g_assert_cmpuint(entries[0].old_value, == ,0);
+    g_assert_cmpuint(entries[0].new_value, == ,64);
+    g_assert_cmpint(entries[1].param, == ,GBINDER_STATS_TUNING_LOOPERS);
+    g_assert_cmpuint(entries[1].old_value, == ,5);
+    g_assert_cmpuint(entries[1].new_value, == ,6);
+    g_assert_cmpint(entries[0].time, >= ,entries[1].time);
+
+    /* Not affected by reset */
+    gbinder_stats_reset();
+    g_assert_cmpuint(gbinder_stats_get_tuning(entries, 1), == ,1);
+
+    /* The history has a limited size */
+    for (i = 0; i < G_N_ELEMENTS(entries); i++) {
+        gbinder_stats_tuning("/dev/test", GBINDER_STATS_TUNING_TX_THREADS,
+            i, i + 1);
+    }
+    g_assert_cmpuint(gbinder_stats_get_tuning(entries,
+        G_N_ELEMENTS(entries)), == ,GBINDER_STATS_TUNING_HISTORY);
+    g_assert_cmpuint(entries[0].new_value, == ,G_N_ELEMENTS(entries));
+}
+
+/*==========================================================================*
+ * kernel
+ *==========================================================================*/
+
+static
+void
+test_kernel(
+    void)
+{
+    static const char text[] =
+        "binder stats:\n"
+        "BC_TRANSACTION: 100\n"
+        "proc 123\n"
+        "context binder\n"
+        "  threads: 9\n"
+        "proc 123\n"
+        "context hwbinder\n"
+        "  threads: 3\n"
+        "  requested threads: 1+2/15\n"
+        "  ready threads 2\n"
+        "  free async space 520192\n"
+        "  nodes: 4\n"
+        "  refs: 5 s 5 w 5\n"
+        "  buffers: 6\n"
+        "  pages: 0:1:253\n"
+        "  pending transactions: 7\n"
+        "  BC_TRANSACTION: 10\n"
+        "  BC_TRANSACTION_SG: 1\n"
+        "  BC_REPLY: 20\n"
+        "  BR_TRANSACTION: 20\n"
+        "  BR_FAILED_REPLY: 2\n"
+        "  BR_DEAD_REPLY: 1\n"
+        "  BR_ONEWAY_SPAM_SUSPECT: 3\n"
+        "proc 456\n"
+        "context hwbinder\n"
+        "  threads: 1\n"
+        "proc 123\n"
+        "context binder\n"
+        "  threads: 2\n"
+        "  requested threads: 0+1/15\n"
+        "  BC_TRANSACTION: 5\n";
+    GBinderStatsKernel stats;
+    GBinderIpc* ipc;
+
+    g_assert(!gbinder_stats_get_kernel(NULL, 0, &stats));
+    g_assert(!gbinder_stats_get_kernel(GBINDER_DEFAULT_BINDER, 0, NULL));
+
+    /* Wrong pid or context */
+    g_assert(!gbinder_stats_parse_kernel(text, "hwbinder", 1, &stats));
+    g_assert(!gbinder_stats_parse_kernel(text, "vndbinder", 123, &stats));
+
+    g_assert(gbinder_stats_parse_kernel(text, "hwbinder", 123, &stats));
+    g_assert_cmpuint(stats.threads, == ,3);
+    g_assert_cmpuint(stats.requested_threads, == ,1);
+    g_assert_cmpuint(stats.started_threads, == ,2);
+    g_assert_cmpuint(stats.max_threads, == ,15);
+    g_assert_cmpuint(stats.ready_threads, == ,2);
+    g_assert_cmpuint(stats.free_async_space, == ,520192);
+    g_assert_cmpuint(stats.nodes, == ,4);
+    g_assert_cmpuint(stats.refs, == ,5);
+    g_assert_cmpuint(stats.buffers, == ,6);
+    g_assert_cmpuint(stats.pending_transactions, == ,7);
+    g_assert_cmpuint(stats.transactions, == ,11);
+    g_assert_cmpuint(stats.replies, == ,20);
+    g_assert_cmpuint(stats.incoming, == ,20);
+    g_assert_cmpuint(stats.failed_replies, == ,2);
+    g_assert_cmpuint(stats.dead_replies, == ,1);
+    g_assert_cmpuint(stats.frozen_replies, == ,0);
+    g_assert_cmpuint(stats.spam_suspects, == ,3);
+
+    /* Two sections, the numbers add up */
+    g_assert(gbinder_stats_parse_kernel(text, "binder", 123, &stats));
+    g_assert_cmpuint(stats.threads, == ,11);
+    g_assert_cmpuint(stats.started_threads, == ,1);
+    g_assert_cmpuint(stats.max_threads, == ,15);
+    g_assert_cmpuint(stats.transactions, == ,5);
+
+    /* The libgbinder side */
+    memset(&stats, 0, sizeof(stats));
+    ipc = gbinder_ipc_new(GBINDER_DEFAULT_BINDER, NULL);
+    g_assert(ipc);
+    g_assert(gbinder_ipc_kernel_stats(GBINDER_DEFAULT_BINDER, &stats));
+    g_assert_cmpuint(stats.loopers, == ,0);
+    g_assert_cmpuint(stats.blocked_loopers, == ,0);
+    g_assert(!gbinder_ipc_kernel_stats("/dev/nobinder", &stats));
+    gbinder_ipc_unref(ipc);
+}
+
+/*==========================================================================*
+ * Common
+ *==========================================================================*/
+
+#define TEST_PREFIX "/stats/"
+#define TEST_(t) TEST_PREFIX t
+
+int main(int argc, char* argv[])
+{
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+    g_type_init();
+    G_GNUC_END_IGNORE_DEPRECATIONS;
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func(TEST_("null"), test_null);
+    g_test_add_func(TEST_("basic"), test_basic);
+    g_test_add_func(TEST_("forwarded"), test_forwarded);
+    g_test_add_func(TEST_("client"), test_client);
+    g_test_add_func(TEST_("sampling"), test_sampling);
+    g_test_add_func(TEST_("percentile"), test_percentile);
+    g_test_add_func(TEST_("memory"), test_memory);
+    g_test_add_func(TEST_("probes"), test_probes);
+    g_test_add_func(TEST_("handlers"), test_handlers);
+    g_test_add_func(TEST_("startup"), test_startup);
+    g_test_add_func(TEST_("tuning"), test_tuning);
+    g_test_add_func(TEST_("kernel"), test_kernel);
+    test_init(&test_opt, argc, argv);
+    return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -42,7 +42,9 @@
 #include <gutil_log.h>
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 static TestOpt test_opt;
 
@@ -88,11 +90,14 @@ test_null(
     gbinder_writer_append_bool(NULL, FALSE);
     gbinder_writer_append_bool(&writer, FALSE);
     gbinder_writer_append_fd(NULL, 0);
+    gbinder_writer_adopt_fd(NULL, -1);
     gbinder_writer_append_bytes(NULL, NULL, 0);
     gbinder_writer_append_bytes(&writer, NULL, 0);
     gbinder_writer_append_hidl_vec(NULL, NULL, 0, 0);
     gbinder_writer_append_hidl_string(NULL, NULL);
     gbinder_writer_append_hidl_string_copy(NULL, NULL);
+    gbinder_writer_append_hidl_string_len(NULL, NULL, 0);
+    gbinder_writer_append_hidl_string_bytes(NULL, NULL);
     gbinder_writer_append_hidl_string(&writer, NULL);
     gbinder_writer_append_hidl_string_vec(NULL, NULL, 0);
     gbinder_writer_append_hidl_string_vec(&writer, NULL, 0);
@@ -101,12 +106,18 @@ test_null(
     gbinder_writer_append_buffer_object_with_parent(NULL, NULL, 0, NULL);
     gbinder_writer_append_buffer_object_with_parent(&writer, NULL, 0, NULL);
     gbinder_writer_append_parcelable(NULL, NULL, 0);
+    g_assert(!gbinder_writer_begin_parcelable(NULL));
+    gbinder_writer_end_parcelable(NULL, 0);
     gbinder_writer_append_local_object(NULL, NULL);
     gbinder_writer_append_local_object(&writer, NULL);
     gbinder_writer_append_remote_object(NULL, NULL);
     gbinder_writer_append_remote_object(&writer, NULL);
     gbinder_writer_append_byte_array(NULL, NULL, 0);
     gbinder_writer_append_byte_array(&writer, NULL, 0);
+    gbinder_writer_append_int32_array(NULL, NULL, 0);
+    gbinder_writer_append_int64_array(NULL, NULL, 0);
+    gbinder_writer_append_float_array(NULL, NULL, 0);
+    gbinder_writer_append_double_array(NULL, NULL, 0);
     gbinder_writer_add_cleanup(NULL, NULL, 0);
     gbinder_writer_add_cleanup(NULL, g_free, 0);
     gbinder_writer_overwrite_int32(NULL, 0, 0);
@@ -169,6 +180,93 @@ test_cleanup(
     g_assert_cmpint(cleanup_count, == ,2);
 }
 
+/*==========================================================================*
+ * alloc
+ *==========================================================================*/
+
+static
+void
+test_alloc(
+    void)
+{
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    GBinderWriter writer;
+    guint8* small[100];
+    guint8* big;
+    gsize i;
+
+    gbinder_local_request_init_writer(req, &writer);
+    g_assert(!gbinder_writer_malloc(&writer, 0));
+    g_assert(!gbinder_writer_malloc0(&writer, 0));
+
+    /* Enough to take several chunks */
+    for (i = 0; i < G_N_ELEMENTS(small); i++) {
+        small[i] = gbinder_writer_malloc(&writer, i + 1);
+        g_assert(small[i]);
+        g_assert(!(GPOINTER_TO_SIZE(small[i]) & 7));
+        memset(small[i], i, i + 1);
+    }
+
+    /* This one is bigger than the chunk size */
+    big = gbinder_writer_malloc0(&writer, 4096);
+    g_assert(big);
+    for (i = 0; i < 4096; i++) {
+        g_assert(!big[i]);
+    }
+    memset(big, 0xff, 4096);
+
+    /* Nothing got overwritten */
+    for (i = 0; i < G_N_ELEMENTS(small); i++) {
+        gsize k;
+
+        for (k = 0; k <= i; k++) {
+            g_assert_cmpuint(small[i][k], == ,i);
+        }
+    }
+    gbinder_local_request_unref(req);
+}
+
+/*==========================================================================*
+ * reserve
+ *==========================================================================*/
+
+static
+void
+test_reserve(
+    void)
+{
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    GBinderOutputData* data = gbinder_local_request_data(req);
+    GBinderWriter writer;
+    const guint8* ptr;
+    guint i;
+
+    gbinder_writer_reserve(NULL, 1, 1, 1); /* No effect */
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_reserve(&writer, 0, 0, 0); /* No effect either */
+    g_assert(!gbinder_output_data_offsets(data));
+
+    gbinder_writer_reserve(&writer, 1024, 2, 2);
+    g_assert_cmpuint(data->bytes->len, == ,0);
+    g_assert(gbinder_output_data_offsets(data));
+    g_assert_cmpuint(gbinder_output_data_offsets(data)->count, == ,0);
+
+    /* Reserved space is not reallocated */
+    gbinder_writer_append_int32(&writer, 0);
+    ptr = data->bytes->data;
+    for (i = 1; i < 256; i++) {
+        gbinder_writer_append_int32(&writer, i);
+    }
+    g_assert(data->bytes->data == ptr);
+    g_assert_cmpuint(data->bytes->len, == ,1024);
+
+    /* Reserving more for the existing offsets array */
+    gbinder_writer_append_local_object(&writer, NULL);
+    gbinder_writer_reserve(&writer, 0, 10, 0);
+    g_assert_cmpuint(gbinder_output_data_offsets(data)->count, == ,1);
+    gbinder_local_request_unref(req);
+}
+
 /*==========================================================================*
  * int8
  *==========================================================================*/
@@ -260,6 +358,55 @@ test_int32(
     gbinder_local_request_unref(req);
 }
 
+/*==========================================================================*
+ * inline
+ *==========================================================================*/
+
+static
+void
+test_inline(
+    void)
+{
+    GBinderLocalRequest* req1 = gbinder_local_request_new(&gbinder_io_32, NULL);
+    GBinderLocalRequest* req2 = gbinder_local_request_new(&gbinder_io_32, NULL);
+    GBinderOutputData* data1;
+    GBinderOutputData* data2;
+    GBinderWriter writer1;
+    GBinderWriter writer2;
+    GBinderWriter dummy;
+    int i;
+
+    /* Not initialized */
+    memset(&dummy, 0, sizeof(dummy));
+    gbinder_writer_append_int32_inline(&dummy, 0);
+    g_assert(!gbinder_writer_grow(&dummy, 4));
+
+    /* Enough to hit the slow path more than once */
+    gbinder_local_request_init_writer(req1, &writer1);
+    gbinder_local_request_init_writer(req2, &writer2);
+    for (i = 0; i < 100; i++) {
+        gbinder_writer_append_int32(&writer1, i);
+        gbinder_writer_append_int64(&writer1, i);
+        gbinder_writer_append_float(&writer1, i);
+        gbinder_writer_append_double(&writer1, i);
+        gbinder_writer_append_bool(&writer1, i & 1);
+        gbinder_writer_append_int32_inline(&writer2, i);
+        gbinder_writer_append_int64_inline(&writer2, i);
+        gbinder_writer_append_float_inline(&writer2, i);
+        gbinder_writer_append_double_inline(&writer2, i);
+        gbinder_writer_append_bool_inline(&writer2, i & 1);
+    }
+
+    data1 = gbinder_local_request_data(req1);
+    data2 = gbinder_local_request_data(req2);
+    g_assert_cmpuint(data1->bytes->len, == ,data2->bytes->len);
+    g_assert(!memcmp(data1->bytes->data, data2->bytes->data,
+        data1->bytes->len));
+
+    gbinder_local_request_unref(req1);
+    gbinder_local_request_unref(req2);
+}
+
 /*==========================================================================*
  * int64
  *==========================================================================*/
@@ -453,11 +600,36 @@ static const guint8 string16_tests_data_xy[] = {
     0x00, 0x00, 0x00, 0x00
 };
 
+static const guint8 string16_tests_data_ascii[] = {
+    TEST_INT32_BYTES(10),
+    TEST_INT16_BYTES('0'), TEST_INT16_BYTES('1'),
+    TEST_INT16_BYTES('2'), TEST_INT16_BYTES('3'),
+    TEST_INT16_BYTES('4'), TEST_INT16_BYTES('5'),
+    TEST_INT16_BYTES('6'), TEST_INT16_BYTES('7'),
+    TEST_INT16_BYTES('8'), TEST_INT16_BYTES('9'),
+    0x00, 0x00, 0x00, 0x00
+};
+
+static const guint8 string16_tests_data_utf8[] = {
+    TEST_INT32_BYTES(13),
+    TEST_INT16_BYTES(0x00e9), TEST_INT16_BYTES(0x20ac),
+    TEST_INT16_BYTES(0xd83d), TEST_INT16_BYTES(0xde00),
+    TEST_INT16_BYTES('0'), TEST_INT16_BYTES('1'),
+    TEST_INT16_BYTES('2'), TEST_INT16_BYTES('3'),
+    TEST_INT16_BYTES('4'), TEST_INT16_BYTES('5'),
+    TEST_INT16_BYTES('6'), TEST_INT16_BYTES('7'),
+    TEST_INT16_BYTES('8'), 0x00, 0x00
+};
+
 static const TestString16Data test_string16_tests[] = {
     { "null", NULL, TEST_ARRAY_AND_SIZE(string16_tests_data_null) },
     { "empty", "", TEST_ARRAY_AND_SIZE(string16_tests_data_empty) },
     { "1", "x", TEST_ARRAY_AND_SIZE(string16_tests_data_x) },
-    { "2", "xy", TEST_ARRAY_AND_SIZE(string16_tests_data_xy) }
+    { "2", "xy", TEST_ARRAY_AND_SIZE(string16_tests_data_xy) },
+    { "ascii", "0123456789", TEST_ARRAY_AND_SIZE(string16_tests_data_ascii) },
+    { "utf8", "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80" "012345678",
+      TEST_ARRAY_AND_SIZE(string16_tests_data_utf8) },
+    { "invalid", "x\xff", TEST_ARRAY_AND_SIZE(string16_tests_data_x) }
 };
 
 static
@@ -688,6 +860,76 @@ test_hidl_string_copy(
     test_hidl_string_xxx(test_data, gbinder_writer_append_hidl_string_copy);
 }
 
+static
+void
+test_hidl_string_append_len(
+    GBinderWriter* writer,
+    const char* str)
+{
+    gbinder_writer_append_hidl_string_len(writer, str, str ? strlen(str) : 0);
+}
+
+static
+void
+test_hidl_string_len(
+    gconstpointer test_data)
+{
+    test_hidl_string_xxx(test_data, test_hidl_string_append_len);
+}
+
+static
+void
+test_hidl_string_append_bytes(
+    GBinderWriter* writer,
+    const char* str)
+{
+    if (str) {
+        /* Including NUL, referenced as is */
+        GBytes* bytes = g_bytes_new_static(str, strlen(str) + 1);
+
+        gbinder_writer_append_hidl_string_bytes(writer, bytes);
+        g_bytes_unref(bytes);
+    } else {
+        gbinder_writer_append_hidl_string_bytes(writer, NULL);
+    }
+}
+
+static
+void
+test_hidl_string_bytes(
+    gconstpointer test_data)
+{
+    test_hidl_string_xxx(test_data, test_hidl_string_append_bytes);
+}
+
+static
+void
+test_hidl_string_bytes2(
+    void)
+{
+    static const char foo[] = "foo";
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+    GBytes* bytes;
+
+    /* No NUL at the end (gets copied) and empty */
+    gbinder_local_request_init_writer(req, &writer);
+    bytes = g_bytes_new_static(foo, strlen(foo));
+    gbinder_writer_append_hidl_string_bytes(&writer, bytes);
+    g_bytes_unref(bytes);
+    bytes = g_bytes_new_static(foo, 0);
+    gbinder_writer_append_hidl_string_bytes(&writer, bytes);
+    g_bytes_unref(bytes);
+
+    data = gbinder_local_request_data(req);
+    g_assert_cmpuint(gbinder_output_data_offsets(data)->count, == ,4);
+    /* 2 GBinderHidlStrings + "foo" and "" aligned at 8 bytes boundary */
+    g_assert_cmpuint(gbinder_output_data_buffers_size(data), == ,
+        2 * sizeof(GBinderHidlString) + 16);
+    gbinder_local_request_unref(req);
+}
+
 static
 void
 test_hidl_string2(
@@ -783,6 +1025,62 @@ test_hidl_string_vec(
     gbinder_local_request_unref(req);
 }
 
+/*==========================================================================*
+ * hidl_schema
+ *==========================================================================*/
+
+typedef struct test_hidl_schema_data {
+    gint32 id;
+    gint32 pad;
+    GBinderHidlString name;
+    GBinderHidlVec ints;
+} TestHidlSchemaData;
+
+static
+void
+test_hidl_schema(
+    void)
+{
+    static const gint32 ints[] = { 1, 2, 3 };
+    static const GBinderHidlSchema int_schema = { sizeof(gint32), NULL };
+    static const GBinderHidlField fields[] = {
+        GBINDER_HIDL_FIELD(STRING, TestHidlSchemaData, name, NULL),
+        GBINDER_HIDL_FIELD(VEC, TestHidlSchemaData, ints, &int_schema),
+        GBINDER_HIDL_FIELDS_END
+    };
+    static const GBinderHidlSchema schema = {
+        sizeof(TestHidlSchemaData), fields
+    };
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    TestHidlSchemaData value;
+    GBinderOutputData* data;
+    GBinderWriter writer;
+    GUtilIntArray* offsets;
+
+    memset(&value, 0, sizeof(value));
+    value.name.data.str = "foo";
+    value.name.len = 3;
+    value.ints.data.ptr = ints;
+    value.ints.count = G_N_ELEMENTS(ints);
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_hidl_schema(&writer, NULL, &value);
+    gbinder_writer_append_hidl_schema(&writer, &schema, NULL);
+    gbinder_writer_append_hidl_schema(&writer, &schema, &value);
+    data = gbinder_local_request_data(req);
+    offsets = gbinder_output_data_offsets(data);
+    g_assert(offsets);
+    g_assert_cmpuint(offsets->count, == ,3);
+    g_assert_cmpuint(offsets->data[0], == ,0);
+    g_assert_cmpuint(offsets->data[1], == ,BUFFER_OBJECT_SIZE_64);
+    g_assert_cmpuint(offsets->data[2], == ,2*BUFFER_OBJECT_SIZE_64);
+    /* The struct + "foo" and 3 ints, each aligned at 8 bytes boundary */
+    g_assert_cmpuint(gbinder_output_data_buffers_size(data), == ,
+        sizeof(value) + 8 + 16);
+
+    gbinder_local_request_unref(req);
+}
+
 /*==========================================================================*
  * buffer
  *==========================================================================*/
@@ -819,6 +1117,86 @@ test_buffer(
     gbinder_local_request_unref(req);
 }
 
+/*==========================================================================*
+ * bytes
+ *==========================================================================*/
+
+static
+void
+test_bytes_free(
+    gpointer data)
+{
+    (*((int*)data))++;
+}
+
+static
+void
+test_bytes(
+    void)
+{
+    static const guint8 buf[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    int freed = 0;
+    GBytes* bytes = g_bytes_new_with_free_func(buf, sizeof(buf),
+        test_bytes_free, &freed);
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+    GUtilIntArray* offsets;
+    const GBinderHidlVec* vec;
+
+    gbinder_writer_append_buffer_object_bytes(NULL, bytes, NULL);
+    gbinder_writer_append_hidl_vec_bytes(NULL, bytes, 1);
+
+    /* Plain buffer object */
+    gbinder_local_request_init_writer(req, &writer);
+    g_assert_cmpuint(gbinder_writer_append_buffer_object_bytes(&writer,
+        bytes, NULL), == ,0);
+    data = gbinder_local_request_data(req);
+    offsets = gbinder_output_data_offsets(data);
+    g_assert(offsets);
+    g_assert_cmpuint(offsets->count, == ,1);
+    g_assert_cmpuint(gbinder_output_data_buffers_size(data), == ,16);
+    /* The data is not copied */
+    g_assert(*(guint64*)(data->bytes->data + 8) == (guintptr)buf);
+    g_bytes_unref(bytes);
+    g_assert(!freed);
+    gbinder_local_request_unref(req);
+    g_assert_cmpint(freed, == ,1);
+
+    /* HIDL vector, the tail which doesn't fit a whole element is dropped */
+    freed = 0;
+    bytes = g_bytes_new_with_free_func(buf, sizeof(buf),
+        test_bytes_free, &freed);
+    req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_hidl_vec_bytes(&writer, bytes, 4);
+    data = gbinder_local_request_data(req);
+    offsets = gbinder_output_data_offsets(data);
+    g_assert(offsets);
+    g_assert_cmpuint(offsets->count, == ,2);
+    g_assert_cmpuint(gbinder_output_data_buffers_size(data), == ,
+        sizeof(GBinderHidlVec) + 8);
+    vec = (void*)(guintptr)*(guint64*)(data->bytes->data + 8);
+    g_assert(vec->data.ptr == buf);
+    g_assert_cmpuint(vec->count, == ,2);
+    g_assert(*(guint64*)(data->bytes->data + offsets->data[1] + 8) ==
+        (guintptr)buf);
+    g_bytes_unref(bytes);
+    g_assert(!freed);
+    gbinder_local_request_unref(req);
+    g_assert_cmpint(freed, == ,1);
+
+    /* Empty vector */
+    req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_hidl_vec_bytes(&writer, NULL, 4);
+    data = gbinder_local_request_data(req);
+    g_assert_cmpuint(gbinder_output_data_offsets(data)->count, == ,2);
+    g_assert_cmpuint(gbinder_output_data_buffers_size(data), == ,
+        sizeof(GBinderHidlVec));
+    gbinder_local_request_unref(req);
+}
+
 /*==========================================================================*
  * parent
  *==========================================================================*/
@@ -910,6 +1288,48 @@ test_parcelable(
     gbinder_local_request_unref(req);
 }
 
+/*==========================================================================*
+ * parcelable_nested
+ *==========================================================================*/
+
+static
+void
+test_parcelable_nested(
+    void)
+{
+    const guint8 encoded[] = {
+        TEST_INT32_BYTES(1),
+        TEST_INT32_BYTES(sizeof(gint32) * 5),
+        TEST_INT32_BYTES(10),
+        TEST_INT32_BYTES(1),
+        TEST_INT32_BYTES(sizeof(gint32) * 2),
+        TEST_INT32_BYTES(20)
+    };
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+    gsize outer, inner;
+
+    gbinder_local_request_init_writer(req, &writer);
+    outer = gbinder_writer_begin_parcelable(&writer);
+    gbinder_writer_append_int32(&writer, 10);
+    inner = gbinder_writer_begin_parcelable(&writer);
+    gbinder_writer_append_int32(&writer, 20);
+    gbinder_writer_end_parcelable(&writer, inner);
+    gbinder_writer_end_parcelable(&writer, outer);
+
+    /* Garbage is ignored */
+    gbinder_writer_end_parcelable(&writer, 0);
+    gbinder_writer_end_parcelable(&writer, sizeof(encoded));
+
+    data = gbinder_local_request_data(req);
+    g_assert(!gbinder_output_data_buffers_size(data));
+    g_assert_cmpuint(data->bytes->len, == ,sizeof(encoded));
+    g_assert(!memcmp(data->bytes->data, encoded, sizeof(encoded)));
+
+    gbinder_local_request_unref(req);
+}
+
 /*==========================================================================*
  * fd
  * fd_invalid
@@ -980,6 +1400,46 @@ test_fd_close_error(
     gbinder_local_request_unref(req);
 }
 
+/*==========================================================================*
+ * adopt_fd
+ *==========================================================================*/
+
+static
+void
+test_adopt_fd(
+    void)
+{
+    const GBinderIo* io = &gbinder_io_32;
+    GBinderLocalRequest* req = gbinder_local_request_new(io, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+    int fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    int written = -1;
+
+    g_assert_cmpint(fd, >= ,0);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_adopt_fd(&writer, fd);
+    gbinder_writer_adopt_fd(&writer, -1);
+    data = gbinder_local_request_data(req);
+    g_assert(data->bytes->len == 2 * BINDER_OBJECT_SIZE_32);
+
+    /* The descriptor is written as is, no dup */
+    g_assert(io->decode_fd_object(data->bytes->data, data->bytes->len,
+        &written));
+    g_assert_cmpint(written, == ,fd);
+    g_assert(fcntl(fd, F_GETFD) >= 0);
+
+    /* And closed together with the request */
+    gbinder_local_request_unref(req);
+    g_assert(fcntl(fd, F_GETFD) < 0);
+
+    /* Closed right away if there's nowhere to write it */
+    fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    g_assert_cmpint(fd, >= ,0);
+    gbinder_writer_adopt_fd(NULL, fd);
+    g_assert(fcntl(fd, F_GETFD) < 0);
+}
+
 /*==========================================================================*
  * local_object
  *==========================================================================*/
@@ -1085,6 +1545,136 @@ test_byte_array(
 }
 
 
+/*==========================================================================*
+ * array
+ *==========================================================================*/
+
+static
+void
+test_array(
+    void)
+{
+    static const gint32 i32[] = { 1, -2, 3 };
+    static const gint64 i64[] = { G_GINT64_CONSTANT(0x100000000), -1 };
+    static const gfloat f[] = { 1.5f, -2.5f };
+    static const gdouble d[] = { 3.25 };
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_64, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+    const guint8* ptr;
+
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_int32_array(&writer, i32, G_N_ELEMENTS(i32));
+    gbinder_writer_append_int64_array(&writer, i64, G_N_ELEMENTS(i64));
+    gbinder_writer_append_float_array(&writer, f, G_N_ELEMENTS(f));
+    gbinder_writer_append_double_array(&writer, d, G_N_ELEMENTS(d));
+    gbinder_writer_append_int32_array(&writer, i32, 0);
+    gbinder_writer_append_int32_array(&writer, NULL, 42);
+
+    data = gbinder_local_request_data(req);
+    g_assert(!gbinder_output_data_offsets(data));
+    g_assert(!gbinder_output_data_buffers_size(data));
+    g_assert_cmpuint(data->bytes->len, == ,6 * 4 +
+        sizeof(i32) + sizeof(i64) + sizeof(f) + sizeof(d));
+
+    ptr = data->bytes->data;
+    g_assert_cmpint(*(gint32*)ptr, == ,G_N_ELEMENTS(i32));
+    g_assert(!memcmp(ptr + 4, i32, sizeof(i32)));
+    ptr += 4 + sizeof(i32);
+    g_assert_cmpint(*(gint32*)ptr, == ,G_N_ELEMENTS(i64));
+    g_assert(!memcmp(ptr + 4, i64, sizeof(i64)));
+    ptr += 4 + sizeof(i64);
+    g_assert_cmpint(*(gint32*)ptr, == ,G_N_ELEMENTS(f));
+    g_assert(!memcmp(ptr + 4, f, sizeof(f)));
+    ptr += 4 + sizeof(f);
+    g_assert_cmpint(*(gint32*)ptr, == ,G_N_ELEMENTS(d));
+    g_assert(!memcmp(ptr + 4, d, sizeof(d)));
+    ptr += 4 + sizeof(d);
+    /* Empty and NULL arrays */
+    g_assert_cmpint(((gint32*)ptr)[0], == ,0);
+    g_assert_cmpint(((gint32*)ptr)[1], == ,-1);
+    gbinder_local_request_unref(req);
+}
+
+/*==========================================================================*
+ * blob
+ *==========================================================================*/
+
+static
+void
+test_blob(
+    void)
+{
+    static const guint8 blob[] = { 1, 2, 3, 4, 5, 6 };
+    static const guint8 padded[] = { 1, 2, 3, 4, 5, 6, 0, 0 };
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    GBinderOutputData* data;
+    GBinderWriter writer;
+    const guint8* ptr;
+
+    gbinder_writer_append_blob(NULL, blob, sizeof(blob));
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_blob(&writer, blob, sizeof(blob));
+    gbinder_writer_append_blob(&writer, NULL, 0);
+
+    /* Small blobs are written in place */
+    data = gbinder_local_request_data(req);
+    g_assert(!gbinder_output_data_offsets(data));
+    g_assert_cmpuint(data->bytes->len, == ,4 + sizeof(padded) + 4);
+    ptr = data->bytes->data;
+    g_assert_cmpint(*(gint32*)ptr, == ,0);
+    g_assert(!memcmp(ptr + 4, padded, sizeof(padded)));
+    g_assert_cmpint(*(gint32*)(ptr + 4 + sizeof(padded)), == ,0);
+    gbinder_local_request_unref(req);
+}
+
+#if GBINDER_FMQ_SUPPORTED
+
+static
+void
+test_blob_shared(
+    void)
+{
+    static const guint8 blob[] = { 1, 2, 3, 4, 5, 6 };
+    GBinderLocalRequest* req = gbinder_local_request_new(&gbinder_io_32, NULL);
+    GBinderOutputData* data;
+    GUtilIntArray* offsets;
+    GBinderWriter writer;
+    const guint8* ptr;
+    void* map;
+    int fd;
+
+    /* Everything above the limit goes to shared memory */
+    gbinder_writer_blob_set_limit(sizeof(blob) - 1);
+    gbinder_local_request_init_writer(req, &writer);
+    gbinder_writer_append_blob(&writer, blob, sizeof(blob));
+    gbinder_writer_blob_set_limit(GBINDER_BLOB_INPLACE_LIMIT);
+
+    data = gbinder_local_request_data(req);
+    offsets = gbinder_output_data_offsets(data);
+    g_assert(offsets);
+    g_assert_cmpuint(offsets->count, == ,1);
+    g_assert_cmpuint(offsets->data[0], == ,4);
+    g_assert_cmpuint(data->bytes->len, == ,4 + BINDER_OBJECT_SIZE_32);
+    ptr = data->bytes->data;
+    g_assert_cmpint(*(gint32*)ptr, == ,1);
+
+    /* The descriptor is in the handle field of the object */
+    fd = *(gint32*)(ptr + 12);
+    g_assert_cmpint(fd, >= ,0);
+    map = mmap(NULL, sizeof(blob), PROT_READ, MAP_SHARED, fd, 0);
+    g_assert(map != MAP_FAILED);
+    g_assert(!memcmp(map, blob, sizeof(blob)));
+    munmap(map, sizeof(blob));
+
+    /* And the memory is sealed against writing */
+    g_assert(mmap(NULL, sizeof(blob), PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0) == MAP_FAILED);
+    gbinder_local_request_unref(req);
+}
+
+#endif /* GBINDER_FMQ_SUPPORTED */
+
 /*==========================================================================*
  * fmq descriptor
  *==========================================================================*/
@@ -1169,9 +1759,12 @@ int main(int argc, char* argv[])
     g_test_init(&argc, &argv, NULL);
     g_test_add_func(TEST_("null"), test_null);
     g_test_add_func(TEST_("cleanup"), test_cleanup);
+    g_test_add_func(TEST_("alloc"), test_alloc);
+    g_test_add_func(TEST_("reserve"), test_reserve);
     g_test_add_func(TEST_("int8"), test_int8);
     g_test_add_func(TEST_("int16"), test_int16);
     g_test_add_func(TEST_("int32"), test_int32);
+    g_test_add_func(TEST_("inline"), test_inline);
     g_test_add_func(TEST_("int64"), test_int64);
     g_test_add_func(TEST_("float"), test_float);
     g_test_add_func(TEST_("double"), test_double);
@@ -1204,15 +1797,25 @@ int main(int argc, char* argv[])
     }
 
     g_test_add_func(TEST_("hidl_string/2strings"), test_hidl_string2);
+    g_test_add_func(TEST_("hidl_string_bytes/no_nul"),
+        test_hidl_string_bytes2);
+    g_test_add_func(TEST_("hidl_schema"), test_hidl_schema);
     for (i = 0; i < G_N_ELEMENTS(test_hidl_string_tests); i++) {
         const TestHidlStringData* test = test_hidl_string_tests + i;
         char* path = g_strconcat(TEST_("hidl_string/"), test->name, NULL);
         char* path2 = g_strconcat(TEST_("hidl_string_copy/"), test->name, NULL);
+        char* path3 = g_strconcat(TEST_("hidl_string_len/"), test->name, NULL);
+        char* path4 = g_strconcat(TEST_("hidl_string_bytes/"), test->name,
+            NULL);
 
         g_test_add_data_func(path, test, test_hidl_string);
         g_test_add_data_func(path2, test, test_hidl_string_copy);
+        g_test_add_data_func(path3, test, test_hidl_string_len);
+        g_test_add_data_func(path4, test, test_hidl_string_bytes);
         g_free(path);
         g_free(path2);
+        g_free(path3);
+        g_free(path4);
     }
 
     for (i = 0; i < G_N_ELEMENTS(test_hidl_string_vec_tests); i++) {
@@ -1224,14 +1827,19 @@ int main(int argc, char* argv[])
     }
 
     g_test_add_func(TEST_("buffer"), test_buffer);
+    g_test_add_func(TEST_("bytes"), test_bytes);
     g_test_add_func(TEST_("parent"), test_parent);
     g_test_add_func(TEST_("parcelable"), test_parcelable);
+    g_test_add_func(TEST_("parcelable_nested"), test_parcelable_nested);
     g_test_add_func(TEST_("fd"), test_fd);
     g_test_add_func(TEST_("fd_invalid"), test_fd_invalid);
     g_test_add_func(TEST_("fd_close_error"), test_fd_close_error);
+    g_test_add_func(TEST_("adopt_fd"), test_adopt_fd);
     g_test_add_func(TEST_("local_object"), test_local_object);
     g_test_add_func(TEST_("remote_object"), test_remote_object);
     g_test_add_func(TEST_("byte_array"), test_byte_array);
+    g_test_add_func(TEST_("array"), test_array);
+    g_test_add_func(TEST_("blob"), test_blob);
     g_test_add_func(TEST_("bytes_written"), test_bytes_written);
 
 #if GBINDER_FMQ_SUPPORTED
@@ -1242,6 +1850,7 @@ int main(int argc, char* argv[])
             GINFO("Skipping tests that rely on memfd_create");
         } else {
             close(test_fd);
+            g_test_add_func(TEST_("blob_shared"), test_blob_shared);
             g_test_add_func(TEST_("fmq_descriptor"), test_fmq_descriptor);
         }
     }